@@ -0,0 +1,423 @@
+/**
+******************************************************************************
+* @file    HomeKitAccessoryDB.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide the accessory attribute database template and
+  the /accessories response streamed from it.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "HomeKitAccessoryDB.h"
+#include "SHAUtils.h"
+
+#define db_log(M, ...) custom_log("HomeKitAccessoryDB", M, ##__VA_ARGS__)
+#define db_log_trace() custom_log_trace("HomeKitAccessoryDB")
+
+extern struct _hapAccessory_t hapObjects[];
+extern void HKReadCharacteristicBatch(hk_char_request_t *requests, int count, mico_Context_t * const inContext);
+extern void HKBonjourUpdateConfigNumber( mico_Context_t * const inContext );
+
+typedef enum {
+  kHKDBSlotValue,
+  kHKDBSlotEvent,
+} hk_db_slot_kind_t;
+
+typedef struct _hk_db_slot_t {
+  uint32_t      offset;                 /* Template bytes before the slot */
+  uint8_t       kind;
+  uint8_t       aid;
+  uint8_t       serviceID;
+  uint8_t       characteristicID;
+  uint16_t      iid;
+} hk_db_slot_t;
+
+typedef struct _hk_accessory_db_t {
+  int           refCount;               /* The cache and every response being sent */
+  uint32_t      configNumber;
+  char          *text;
+  uint32_t      textLen;
+  hk_db_slot_t  *slots;
+  int           slotCount;
+} hk_accessory_db_t;
+
+/* A template replaced while a response is still sent from it is freed by that response */
+static mico_mutex_t         dbMutex = NULL;
+static hk_accessory_db_t    *cachedDB = NULL;
+static uint32_t             configNumber = 1;
+
+/* Serialization */
+
+static void _DBAppendString(struct printbuf *pb, const char *string)
+{
+  json_object *stringObject;
+
+  if(string == NULL || (stringObject = json_object_new_string(string)) == NULL){
+    sprintbuf(pb, "null");
+    return;
+  }
+  /* Same escaping as the rest of the JSON responses */
+  sprintbuf(pb, "%s", json_object_to_json_string(stringObject));
+  json_object_put(stringObject);
+}
+
+static void _DBAppendValue(struct printbuf *pb, valueType type, value_union value)
+{
+  switch(type){
+    case ValueType_bool:
+      sprintbuf(pb, "%s", value.boolValue? "true" : "false");
+      break;
+    case ValueType_int:
+      sprintbuf(pb, "%d", value.intValue);
+      break;
+    case ValueType_float:
+      sprintbuf(pb, "%g", value.floatValue);
+      break;
+    case ValueType_string:
+      _DBAppendString(pb, value.stringValue);
+      break;
+    case ValueType_date:
+      _DBAppendString(pb, value.dateValue);
+      break;
+    default:
+      sprintbuf(pb, "null");
+      break;
+  }
+}
+
+static void _DBAppendLimit(struct printbuf *pb, const char *key, valueType type, int intValue, float floatValue)
+{
+  if(type == ValueType_int)
+    sprintbuf(pb, ",\"%s\":%d", key, intValue);
+  else if(type == ValueType_float)
+    sprintbuf(pb, ",\"%s\":%g", key, (double)floatValue);
+}
+
+static int _DBCountSlots(struct _hapAccessory_t inHapObject[])
+{
+  int accessoryIndex, serviceIndex, characteristicIndex, count = 0;
+  struct _hapCharacteristic_t *pCharacteristic;
+
+  for(accessoryIndex = 0; accessoryIndex < NumberofAccessories; accessoryIndex++){
+    for(serviceIndex = 0; serviceIndex < MAXServicePerAccessory; serviceIndex++){
+      if(inHapObject[accessoryIndex].services[serviceIndex].type == 0)
+        break;
+      for(characteristicIndex = 0; characteristicIndex < MAXCharacteristicPerService; characteristicIndex++){
+        pCharacteristic = &inHapObject[accessoryIndex].services[serviceIndex].characteristic[characteristicIndex];
+        if(pCharacteristic->type == 0)
+          continue;
+        if(pCharacteristic->secureRead && !pCharacteristic->hasStaticValue && pCharacteristic->valueType != ValueType_null)
+          count++;
+        if(pCharacteristic->hasEvents)
+          count++;
+      }
+    }
+  }
+  return count;
+}
+
+static void _DBAddSlot(hk_accessory_db_t *db, struct printbuf *pb, hk_db_slot_kind_t kind, int aid, int serviceID, int characteristicID, int iid)
+{
+  hk_db_slot_t *slot = &db->slots[db->slotCount++];
+
+  slot->offset = pb->bpos;
+  slot->kind = kind;
+  slot->aid = aid;
+  slot->serviceID = serviceID;
+  slot->characteristicID = characteristicID;
+  slot->iid = iid;
+}
+
+/* Same layout and numbering as the database was always sent with, values and "ev" are slots */
+static hk_accessory_db_t *_DBBuild(struct _hapAccessory_t inHapObject[], uint32_t inConfigNumber)
+{
+  hk_accessory_db_t *db = NULL;
+  struct printbuf *pb = NULL;
+  int accessoryIndex, serviceIndex, characteristicIndex;
+  int iid, slotCount;
+  struct _hapCharacteristic_t *pCharacteristic;
+  bool firstService, firstCharacteristic;
+  uint32_t startTime = mico_get_time();
+
+  slotCount = _DBCountSlots(inHapObject);
+
+  db = calloc(1, sizeof(hk_accessory_db_t));
+  require(db, error);
+  db->slots = malloc(Max(slotCount, 1) * sizeof(hk_db_slot_t));
+  require(db->slots, error);
+  pb = printbuf_new();
+  require(pb, error);
+
+  sprintbuf(pb, "{\"accessories\":[");
+  for(accessoryIndex = 0; accessoryIndex < NumberofAccessories; accessoryIndex++){
+    sprintbuf(pb, "%s{\"aid\":%d,\"services\":[", accessoryIndex? ",":"", accessoryIndex + 1);
+    firstService = true;
+
+    for(serviceIndex = 0, iid = 1; serviceIndex < MAXServicePerAccessory; serviceIndex++){
+      if(inHapObject[accessoryIndex].services[serviceIndex].type == 0)
+        break;
+      sprintbuf(pb, "%s{\"type\":", firstService? "":",");
+      _DBAppendString(pb, inHapObject[accessoryIndex].services[serviceIndex].type);
+      sprintbuf(pb, ",\"iid\":%d,\"characteristics\":[", iid++);
+      firstService = false;
+      firstCharacteristic = true;
+
+      for(characteristicIndex = 0; characteristicIndex < MAXCharacteristicPerService; characteristicIndex++){
+        pCharacteristic = &inHapObject[accessoryIndex].services[serviceIndex].characteristic[characteristicIndex];
+        if(pCharacteristic->type == 0)
+          continue;
+
+        sprintbuf(pb, "%s{\"type\":", firstCharacteristic? "":",");
+        _DBAppendString(pb, pCharacteristic->type);
+        sprintbuf(pb, ",\"iid\":%d", iid);
+        firstCharacteristic = false;
+
+        if(pCharacteristic->secureRead){
+          sprintbuf(pb, ",\"value\":");
+          if(pCharacteristic->hasStaticValue || pCharacteristic->valueType == ValueType_null)
+            _DBAppendValue(pb, pCharacteristic->valueType, pCharacteristic->value);
+          else
+            _DBAddSlot(db, pb, kHKDBSlotValue, accessoryIndex + 1, serviceIndex + 1, characteristicIndex + 1, iid);
+        }
+
+        sprintbuf(pb, ",\"perms\":[%s%s%s]", pCharacteristic->secureRead? "\"pr\"":"",
+                  (pCharacteristic->secureRead && pCharacteristic->secureWrite)? ",":"", pCharacteristic->secureWrite? "\"pw\"":"");
+
+        if(pCharacteristic->hasEvents){
+          sprintbuf(pb, ",\"ev\":");
+          _DBAddSlot(db, pb, kHKDBSlotEvent, accessoryIndex + 1, serviceIndex + 1, characteristicIndex + 1, iid);
+        }
+
+        if(pCharacteristic->hasMinimumValue)
+          _DBAppendLimit(pb, "minValue", pCharacteristic->valueType, pCharacteristic->minimumValue.intValue, pCharacteristic->minimumValue.floatValue);
+        if(pCharacteristic->hasMaximumValue)
+          _DBAppendLimit(pb, "maxValue", pCharacteristic->valueType, pCharacteristic->maximumValue.intValue, pCharacteristic->maximumValue.floatValue);
+        if(pCharacteristic->hasMinimumStep)
+          _DBAppendLimit(pb, "minStep", pCharacteristic->valueType, pCharacteristic->minimumStep.intValue, pCharacteristic->minimumStep.floatValue);
+        if(pCharacteristic->hasMaxLength)
+          sprintbuf(pb, ",\"maxLen\":%d", pCharacteristic->maxLength);
+        if(pCharacteristic->hasMaxDataLength)
+          sprintbuf(pb, ",\"maxDataLen\":%d", pCharacteristic->maxDataLength);
+        if(pCharacteristic->description){
+          sprintbuf(pb, ",\"description\":");
+          _DBAppendString(pb, pCharacteristic->description);
+        }
+        if(pCharacteristic->format){
+          sprintbuf(pb, ",\"format\":");
+          _DBAppendString(pb, pCharacteristic->format);
+        }
+        if(pCharacteristic->unit){
+          sprintbuf(pb, ",\"unit\":");
+          _DBAppendString(pb, pCharacteristic->unit);
+        }
+        sprintbuf(pb, "}");
+        iid++;
+      }
+      sprintbuf(pb, "]}");
+    }
+    sprintbuf(pb, "]}");
+  }
+  sprintbuf(pb, "]}");
+
+  /* printbuf grows in steps, keep only what the template needs */
+  db->textLen = pb->bpos;
+  db->text = realloc(pb->buf, pb->bpos + 1);
+  if(db->text == NULL) db->text = pb->buf;
+  pb->buf = NULL;
+  printbuf_free(pb);
+
+  db->refCount = 1;
+  db->configNumber = inConfigNumber;
+  db_log("Accessory database %u built in %d ms, %d bytes, %d value slots", inConfigNumber,
+         mico_get_time() - startTime, db->textLen, db->slotCount);
+  return db;
+
+error:
+  db_log("Accessory database build failed, memory remains %d", mico_memory_info()->free_memory);
+  if(pb) printbuf_free(pb);
+  if(db){
+    if(db->slots) free(db->slots);
+    free(db);
+  }
+  return NULL;
+}
+
+/* Template cache */
+
+static void _DBRelease(hk_accessory_db_t *db)
+{
+  bool last;
+
+  if(db == NULL)
+    return;
+  mico_rtos_lock_mutex(&dbMutex);
+  last = (--db->refCount == 0);
+  mico_rtos_unlock_mutex(&dbMutex);
+
+  if(last){
+    free(db->text);
+    free(db->slots);
+    free(db);
+  }
+}
+
+static hk_accessory_db_t *_DBAcquire(void)
+{
+  hk_accessory_db_t *db, *oldDB = NULL;
+
+  mico_rtos_lock_mutex(&dbMutex);
+  if(cachedDB == NULL || cachedDB->configNumber != configNumber){
+    oldDB = cachedDB;
+    cachedDB = _DBBuild(hapObjects, configNumber);
+  }
+  db = cachedDB;
+  if(db) db->refCount++;
+  mico_rtos_unlock_mutex(&dbMutex);
+
+  _DBRelease(oldDB);
+  return db;
+}
+
+OSStatus HKAccessoryDBInit(mico_Context_t * const inContext)
+{
+  OSStatus err = kNoErr;
+  application_config_t *appConfig = &inContext->flashContentInRam.appConfig;
+  uint8_t digest[20];
+
+  if(dbMutex == NULL){
+    err = mico_rtos_init_mutex(&dbMutex);
+    require_noerr(err, exit);
+  }
+
+  configNumber = appConfig->haConfigNumber;
+  cachedDB = _DBBuild(hapObjects, configNumber);
+  require_action(cachedDB, exit, err = kNoMemoryErr);
+
+  /* Everything the configuration number stands for is in the template */
+  SHA1_compat(cachedDB->text, cachedDB->textLen, digest);
+  if(memcmp(digest, appConfig->haDBDigest, sizeof(digest)) != 0){
+    memcpy(appConfig->haDBDigest, digest, sizeof(digest));
+    HKAccessoryDBInvalidate(inContext);
+  }
+
+exit:
+  return err;
+}
+
+void HKAccessoryDBInvalidate(mico_Context_t * const inContext)
+{
+  hk_accessory_db_t *oldDB;
+
+  mico_rtos_lock_mutex(&dbMutex);
+  /* C# is 1 to 65535 */
+  configNumber = (configNumber >= 0xFFFF)? 1 : configNumber + 1;
+  oldDB = cachedDB;
+  cachedDB = NULL;
+  mico_rtos_unlock_mutex(&dbMutex);
+
+  _DBRelease(oldDB);
+
+  db_log("Accessory database changed, configuration number %u", configNumber);
+  inContext->flashContentInRam.appConfig.haConfigNumber = configNumber;
+  MICOUpdateConfiguration(inContext);
+  HKBonjourUpdateConfigNumber(inContext);
+}
+
+uint32_t HKAccessoryDBConfigNumber(void)
+{
+  return configNumber;
+}
+
+/* Response */
+
+static void _DBAppendSlot(struct printbuf *pb, const hk_db_slot_t *slot, const hk_char_request_t *read, HK_Notify_t *notifyList)
+{
+  if(slot->kind == kHKDBSlotEvent){
+    sprintbuf(pb, "%s", HKNotificationFind(slot->aid, slot->iid, notifyList) == kNoErr? "true" : "false");
+    return;
+  }
+
+  if(read->status != kHKNoErr){
+    sprintbuf(pb, "null");
+    return;
+  }
+  _DBAppendValue(pb, hapObjects[slot->aid-1].services[slot->serviceID-1].characteristic[slot->characteristicID-1].valueType, read->value);
+}
+
+OSStatus HKAccessoryDBSend(int sockfd, HK_Notify_t *notifyList, security_session_t *session, mico_Context_t * const inContext)
+{
+  OSStatus err = kNoErr;
+  hk_accessory_db_t *db;
+  struct printbuf *values = NULL;
+  uint32_t *valueEnd = NULL;
+  iovec_t *iov = NULL;
+  hk_char_request_t *reads = NULL;
+  uint32_t textStart = 0, valueStart = 0;
+  int i, iovCount = 0, readCount = 0;
+
+  db = _DBAcquire();
+  require_action(db, exit, err = kNoMemoryErr);
+
+  values = printbuf_new();
+  require_action(values, exit, err = kNoMemoryErr);
+  valueEnd = malloc(Max(db->slotCount, 1) * sizeof(uint32_t));
+  require_action(valueEnd, exit, err = kNoMemoryErr);
+  iov = malloc((2 * db->slotCount + 1) * sizeof(iovec_t));
+  require_action(iov, exit, err = kNoMemoryErr);
+  reads = calloc(Max(db->slotCount, 1), sizeof(hk_char_request_t));
+  require_action(reads, exit, err = kNoMemoryErr);
+
+  /* Every value is read in one batch */
+  for(i = 0; i < db->slotCount; i++){
+    if(db->slots[i].kind != kHKDBSlotValue)
+      continue;
+    reads[readCount].aid = db->slots[i].aid;
+    reads[readCount].iid = db->slots[i].iid;
+    reads[readCount].serviceID = db->slots[i].serviceID;
+    reads[readCount++].characteristicID = db->slots[i].characteristicID;
+  }
+  HKReadCharacteristicBatch(reads, readCount, inContext);
+
+  /* Format every live value first, values can move while the buffer grows */
+  for(i = 0, readCount = 0; i < db->slotCount; i++){
+    _DBAppendSlot(values, &db->slots[i], db->slots[i].kind == kHKDBSlotValue? &reads[readCount++] : NULL, notifyList);
+    valueEnd[i] = values->bpos;
+  }
+
+  for(i = 0; i < db->slotCount; i++){
+    iov[iovCount].iov_base = db->text + textStart;
+    iov[iovCount++].iov_len = db->slots[i].offset - textStart;
+    iov[iovCount].iov_base = values->buf + valueStart;
+    iov[iovCount++].iov_len = valueEnd[i] - valueStart;
+    textStart = db->slots[i].offset;
+    valueStart = valueEnd[i];
+  }
+  iov[iovCount].iov_base = db->text + textStart;
+  iov[iovCount++].iov_len = db->textLen - textStart;
+
+  db_log("Accessory database %u sent, %d bytes of values, memory remains %d", db->configNumber,
+         valueStart, mico_memory_info()->free_memory);
+  err = HKSendResponseMessagev(sockfd, kStatusOK, iov, iovCount, session);
+  require_noerr(err, exit);
+
+exit:
+  if(reads) free(reads);
+  if(iov) free(iov);
+  if(valueEnd) free(valueEnd);
+  if(values) printbuf_free(values);
+  _DBRelease(db);
+  return err;
+}
@@ -0,0 +1,53 @@
+/**
+******************************************************************************
+* @file    HomeKitAccessoryDB.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This header contains function prototypes for the cached accessory
+  attribute database served on /accessories.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#ifndef __HOMEKITACCESSORYDB_h__
+#define __HOMEKITACCESSORYDB_h__
+
+#include "Common.h"
+#include "MICODefine.h"
+#include "HomeKitProfiles.h"
+#include "HomeKitHTTPUtils.h"
+#include "HomeKitNotify.h"
+
+/* Everything in the accessory database that only changes with the configuration (types,
+   iids, perms, metadata and static values) is serialized once into a template. A request
+   only formats the readable values and the "ev" flags of its connection into the value
+   slots of the template, and the response is sent straight from the template and those
+   values. The template is built again on the first request after the configuration
+   number changes. */
+
+/* Called once before Bonjour starts. Builds the template and compares its digest with the
+   one stored with the configuration number, a different database (new firmware) changes
+   the number */
+OSStatus HKAccessoryDBInit(mico_Context_t * const inContext);
+
+/* Changes, saves and announces the configuration number, call after accessories, services
+   or characteristics are added, removed or have their metadata changed */
+void HKAccessoryDBInvalidate(mico_Context_t * const inContext);
+
+uint32_t HKAccessoryDBConfigNumber(void);
+
+/* Sends the whole database as the response to GET /accessories */
+OSStatus HKAccessoryDBSend(int sockfd, HK_Notify_t *notifyList, security_session_t *session, mico_Context_t * const inContext);
+
+#endif
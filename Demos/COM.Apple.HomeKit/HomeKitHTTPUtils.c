@@ -38,6 +38,12 @@
 
 #define kMIMEType_HAP_JSON   "application/hap+json"
 
+/* HAP limits the plaintext of one encrypted frame */
+#define kHKFrameMaxPayloadLen   1024
+
+/* Frames encrypted before they are written, bounds the buffer needed for large responses */
+#define kHKSendMaxFrames        4
+
 extern bool verify_otp(void);
 
 #define hkhttp_utils_log(M, ...) custom_log("HKHTTPUtils", M, ##__VA_ARGS__)
@@ -53,30 +59,72 @@ security_session_t *HKSNewSecuritySession(void)
 }
 
 int HKSecureSocketSend( int sockfd, void *buf, size_t len, security_session_t *session)
+{
+  iovec_t iov;
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  return HKSecureSocketSendv( sockfd, &iov, 1, session );
+}
+
+/* Gather the pieces into HAP frames of at most kHKFrameMaxPayloadLen bytes, encrypt them in place
+   and send up to kHKSendMaxFrames frames with a single write */
+int HKSecureSocketSendv( int sockfd, const iovec_t *inVec, int inVecCount, security_session_t *session)
 {
   OSStatus       err = kNoErr;
-  uint8_t*       encryptedData = NULL;
+  uint8_t*       frames = NULL;
+  uint8_t*       frame;
   uint64_t       encryptedDataLen;
+  size_t         total = 0, frameLen, n, vecOffset = 0;
+  int            i, vec = 0, frameCount;
 
   if(session->established == false)
-    return SocketSend( sockfd, buf, len );
-
-  encryptedData = malloc(len + crypto_aead_chacha20poly1305_ABYTES + sizeof(uint16_t));
-  require_action(encryptedData, exit, err = kNoMemoryErr);
-  *(uint16_t *)encryptedData = len;
-  err =  crypto_aead_chacha20poly1305_encrypt(encryptedData + sizeof(uint16_t), &encryptedDataLen, (uint8_t *)buf, len,
-                                              (const uint8_t *)encryptedData, sizeof(uint16_t), 
-                                              NULL, (uint8_t *)(&session->outputSeqNo),
-                                              (const unsigned char *)session->OutputKey);
-  session->outputSeqNo++;
-  require_noerr_string(err, exit, "crypto_aead_chacha20poly1305_encrypt failed");
-  require_string(encryptedDataLen - crypto_aead_chacha20poly1305_ABYTES == len, exit, "encryptedDataLen is not properly set");
-
-  err = SocketSend( sockfd, encryptedData, encryptedDataLen + sizeof(uint16_t) );
-  require_noerr( err, exit );
+    return SocketSendv( sockfd, inVec, inVecCount );
+
+  for(i = 0; i < inVecCount; i++)
+    total += inVec[i].iov_len;
+  require_action(total, exit, err = kParamErr);
+
+  frameCount = min((int)((total + kHKFrameMaxPayloadLen - 1)/kHKFrameMaxPayloadLen), kHKSendMaxFrames);
+  frames = malloc(min(total, (size_t)frameCount * kHKFrameMaxPayloadLen) + frameCount * (crypto_aead_chacha20poly1305_ABYTES + sizeof(uint16_t)));
+  require_action(frames, exit, err = kNoMemoryErr);
+
+  frame = frames;
+  while(total){
+    frameLen = min(total, kHKFrameMaxPayloadLen);
+    *(uint16_t *)frame = frameLen;
+    for(n = 0; n < frameLen; ){
+      size_t copyLen = min(frameLen - n, inVec[vec].iov_len - vecOffset);
+      memcpy(frame + sizeof(uint16_t) + n, (const uint8_t *)inVec[vec].iov_base + vecOffset, copyLen);
+      n += copyLen;
+      vecOffset += copyLen;
+      if(vecOffset == inVec[vec].iov_len){
+        vec++;
+        vecOffset = 0;
+      }
+    }
+
+    err =  crypto_aead_chacha20poly1305_encrypt(frame + sizeof(uint16_t), &encryptedDataLen, frame + sizeof(uint16_t), frameLen,
+                                                (const uint8_t *)frame, sizeof(uint16_t), 
+                                                NULL, (uint8_t *)(&session->outputSeqNo),
+                                                (const unsigned char *)session->OutputKey);
+    session->outputSeqNo++;
+    require_noerr_string(err, exit, "crypto_aead_chacha20poly1305_encrypt failed");
+    require_string(encryptedDataLen - crypto_aead_chacha20poly1305_ABYTES == frameLen, exit, "encryptedDataLen is not properly set");
+
+    frame += sizeof(uint16_t) + encryptedDataLen;
+    total -= frameLen;
+
+    if(--frameCount == 0 || total == 0){
+      err = SocketSend( sockfd, frames, frame - frames );
+      require_noerr( err, exit );
+      frame = frames;
+      frameCount = kHKSendMaxFrames;
+    }
+  }
 
   exit:
-    if(encryptedData) free(encryptedData);
+    if(frames) free(frames);
     return err;
 }
 
@@ -331,6 +379,7 @@ OSStatus HKSendResponseMessage(int sockfd, int status, uint8_t *payload, int pay
   size_t httpResponseLen = 0;
   const char *buffer = NULL;
   int bufferLen;
+  iovec_t iov[2];
 
   buffer = (const char *)payload;
   bufferLen = payloadLen;
@@ -340,18 +389,50 @@ OSStatus HKSendResponseMessage(int sockfd, int status, uint8_t *payload, int pay
   require_noerr( err, exit );
   require( httpResponse, exit );
 
-  err = HKSecureSocketSend( sockfd, httpResponse, httpResponseLen, session );
+  iov[0].iov_base = httpResponse;
+  iov[0].iov_len = httpResponseLen;
+  iov[1].iov_base = buffer;
+  iov[1].iov_len = bufferLen;
+  err = HKSecureSocketSendv( sockfd, iov, bufferLen? 2:1, session );
   require_noerr( err, exit );
-  if(bufferLen){
-    err = HKSecureSocketSend( sockfd, (uint8_t *)buffer, bufferLen, session );
-    require_noerr( err, exit ); 
-  }
 
 exit:
   if(httpResponse) free(httpResponse);
   return err;
 }
 
+/* Same as HKSendResponseMessage with the payload in pieces, so large bodies never need one buffer */
+OSStatus HKSendResponseMessagev(int sockfd, int status, const iovec_t *payload, int payloadCount, security_session_t *session )
+{
+  OSStatus err;
+  uint8_t *httpResponse = NULL;
+  size_t httpResponseLen = 0;
+  size_t payloadLen = 0;
+  iovec_t *iov = NULL;
+  int i;
+
+  for(i = 0; i < payloadCount; i++)
+    payloadLen += payload[i].iov_len;
+
+  err = CreateHTTPRespondMessageNoCopy( status, kMIMEType_HAP_JSON, payloadLen, &httpResponse, &httpResponseLen );
+  require_noerr( err, exit );
+  require( httpResponse, exit );
+
+  iov = malloc( (payloadCount + 1) * sizeof(iovec_t) );
+  require_action( iov, exit, err = kNoMemoryErr );
+
+  iov[0].iov_base = httpResponse;
+  iov[0].iov_len = httpResponseLen;
+  memcpy( &iov[1], payload, payloadCount * sizeof(iovec_t) );
+  err = HKSecureSocketSendv( sockfd, iov, payloadCount + 1, session );
+  require_noerr( err, exit );
+
+exit:
+  if(iov) free(iov);
+  if(httpResponse) free(httpResponse);
+  return err;
+}
+
 OSStatus HKSendNotifyMessage( int sockfd, uint8_t *payload, int payloadLen, security_session_t *session )
 {
   OSStatus err;
@@ -359,6 +440,7 @@ OSStatus HKSendNotifyMessage( int sockfd, uint8_t *payload, int payloadLen, secu
   size_t httpResponseLen = 0;
   const char *buffer = NULL;
   int bufferLen;
+  iovec_t iov[2];
   require_action( session->established == true, exit, err = kAuthenticationErr );
 
   buffer = (const char *)payload;
@@ -384,12 +466,12 @@ OSStatus HKSendNotifyMessage( int sockfd, uint8_t *payload, int payloadLen, secu
   
   httpResponseLen = strlen( (char*)httpResponse );
 
-  err = HKSecureSocketSend( sockfd, httpResponse, httpResponseLen, session );
+  iov[0].iov_base = httpResponse;
+  iov[0].iov_len = httpResponseLen;
+  iov[1].iov_base = buffer;
+  iov[1].iov_len = bufferLen;
+  err = HKSecureSocketSendv( sockfd, iov, bufferLen? 2:1, session );
   require_noerr( err, exit );
-  if(bufferLen){
-    err = HKSecureSocketSend( sockfd, (uint8_t *)buffer, bufferLen, session );
-    require_noerr( err, exit ); 
-  }
 
 exit:
   if(httpResponse) free(httpResponse);
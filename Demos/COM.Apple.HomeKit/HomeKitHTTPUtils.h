@@ -27,6 +27,7 @@
 #include "Common.h"
 
 #include "HTTPUtils.h"
+#include "SocketUtils.h"
 
 typedef struct _security_session_t {
   bool          established;
@@ -43,6 +44,8 @@ security_session_t *HKSNewSecuritySession(void);
 
 int HKSecureSocketSend( int sockfd, void *buf, size_t len, security_session_t *session);
 
+int HKSecureSocketSendv( int sockfd, const iovec_t *inVec, int inVecCount, security_session_t *session);
+
 int HKSecureRead(security_session_t *session, int sockfd, void *buf, size_t len);
 
 int HKSocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader, security_session_t *session );
@@ -51,6 +54,8 @@ int HKSocketReadHTTPBody  ( int inSock, HTTPHeader_t *inHeader, security_session
 
 OSStatus HKSendResponseMessage(int sockfd, int status, uint8_t *payload, int payloadLen, security_session_t *session );
 
+OSStatus HKSendResponseMessagev(int sockfd, int status, const iovec_t *payload, int payloadCount, security_session_t *session );
+
 OSStatus HKSendNotifyMessage( int sockfd, uint8_t *payload, int payloadLen, security_session_t *session );
 
 
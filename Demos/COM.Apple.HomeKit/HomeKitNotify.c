@@ -0,0 +1,435 @@
+/**
+******************************************************************************
+* @file    HomeKitNotify.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide characteristic change publication and the event
+  notification sessions of the HomeKit connections.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "HomeKitNotify.h"
+
+#define notify_log(M, ...) custom_log("HomeKitNotify", M, ##__VA_ARGS__)
+#define notify_log_trace() custom_log_trace("HomeKitNotify")
+
+struct _hk_notify_session_t {
+  bool                inUse;
+  mico_queue_t        wakeQueue;        /* Holds at most one token, readable through eventFd */
+  int                 eventFd;
+  HK_Notify_t         *notifyList;
+  uint32_t            pendingCount;
+  bool                pendingOverflow;
+  uint32_t            firstChange;      /* mico_get_time() of the oldest pending change */
+  hk_notify_change_t  pending[HK_NOTIFY_MAX_PENDING];
+};
+
+/* Subscription lists are written by their session thread and read by publishers,
+   both under this mutex */
+static mico_mutex_t         notifyMutex = NULL;
+static hk_notify_session_t  sessions[HK_NOTIFY_MAX_SESSIONS];
+
+static hk_notify_metrics_t  metrics;
+static uint32_t             latencySamples[HK_NOTIFY_LATENCY_SAMPLES];
+static uint32_t             latencySampleCount = 0;
+
+OSStatus HKNotifyInit(void)
+{
+  OSStatus err = kNoErr;
+
+  if(notifyMutex == NULL)
+    err = mico_rtos_init_mutex(&notifyMutex);
+  return err;
+}
+
+/* Publication */
+
+static void _SessionAddChange(hk_notify_session_t *session, int aid, int iid, uint32_t now)
+{
+  uint32_t i;
+
+  if(session->pendingOverflow)
+    return;
+
+  for(i = 0; i < session->pendingCount; i++){
+    if(session->pending[i].aid == aid && session->pending[i].iid == iid){
+      metrics.coalescedCount++;
+      return;
+    }
+  }
+
+  if(session->pendingCount == HK_NOTIFY_MAX_PENDING){
+    session->pendingOverflow = true;
+    metrics.overflowCount++;
+    return;
+  }
+
+  session->pending[session->pendingCount].aid = aid;
+  session->pending[session->pendingCount].iid = iid;
+  session->pending[session->pendingCount].time = now;
+  session->pendingCount++;
+}
+
+void HKCharacteristicChanged(int aid, int iid)
+{
+  hk_notify_session_t *session;
+  uint32_t now = mico_get_time();
+  uint8_t token = 0;
+  bool wake;
+
+  if(notifyMutex == NULL)
+    return;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  metrics.changeCount++;
+  for(session = sessions; session < sessions + HK_NOTIFY_MAX_SESSIONS; session++){
+    if(session->inUse == false || HKNotificationFind(aid, iid, session->notifyList) != kNoErr)
+      continue;
+
+    wake = (session->pendingCount == 0 && session->pendingOverflow == false);
+    if(wake)
+      session->firstChange = now;
+    _SessionAddChange(session, aid, iid, now);
+    /* A full queue means the session has been woken already */
+    if(wake && mico_rtos_push_to_queue(&session->wakeQueue, &token, 0) == kNoErr)
+      metrics.wakeCount++;
+  }
+  mico_rtos_unlock_mutex(&notifyMutex);
+}
+
+/* Sessions */
+
+hk_notify_session_t *HKNotifySessionCreate(void)
+{
+  hk_notify_session_t *session = NULL;
+  int i;
+
+  require(notifyMutex, exit);
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  for(i = 0; i < HK_NOTIFY_MAX_SESSIONS; i++){
+    if(sessions[i].inUse == false){
+      session = &sessions[i];
+      memset(session, 0x0, sizeof(hk_notify_session_t));
+      session->inUse = true;
+      session->eventFd = -1;
+      break;
+    }
+  }
+  mico_rtos_unlock_mutex(&notifyMutex);
+  require(session, exit);
+
+  require_noerr(mico_rtos_init_queue(&session->wakeQueue, "HK notify", sizeof(uint8_t), 1), error);
+  session->eventFd = mico_create_event_fd(session->wakeQueue);
+  require(session->eventFd >= 0, error);
+
+exit:
+  return session;
+
+error:
+  HKNotifySessionDelete(session);
+  session = NULL;
+  goto exit;
+}
+
+void HKNotifySessionDelete(hk_notify_session_t *session)
+{
+  HK_Notify_t *notifyList;
+  mico_queue_t wakeQueue;
+  int eventFd;
+
+  hk_notify_metrics_t connectionMetrics;
+
+  if(session == NULL)
+    return;
+
+  HKNotifyGetMetrics(&connectionMetrics);
+  notify_log("Events %d, latency p50 %d ms, p90 %d ms, p99 %d ms, max %d ms, coalesced %d", connectionMetrics.eventCount,
+             connectionMetrics.latencyP50, connectionMetrics.latencyP90, connectionMetrics.latencyP99,
+             connectionMetrics.latencyMax, connectionMetrics.coalescedCount);
+
+  /* Publishers skip the session and a new one can take the slot from here on */
+  mico_rtos_lock_mutex(&notifyMutex);
+  notifyList = session->notifyList;
+  wakeQueue = session->wakeQueue;
+  eventFd = session->eventFd;
+  session->notifyList = NULL;
+  session->inUse = false;
+  mico_rtos_unlock_mutex(&notifyMutex);
+
+  HKNotificationClean(&notifyList);
+  if(eventFd >= 0)
+    mico_delete_event_fd(eventFd);
+  if(wakeQueue)
+    mico_rtos_deinit_queue(&wakeQueue);
+}
+
+int HKNotifySessionEventFd(hk_notify_session_t *session)
+{
+  return session->eventFd;
+}
+
+HK_Notify_t **HKNotifySessionList(hk_notify_session_t *session)
+{
+  return &session->notifyList;
+}
+
+bool HKNotifySessionReady(hk_notify_session_t *session, uint32_t *waitTime)
+{
+  uint8_t token;
+  uint32_t firstChange, elapsed;
+  bool pending;
+
+  while(mico_rtos_pop_from_queue(&session->wakeQueue, &token, 0) == kNoErr);
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  pending = (session->pendingCount > 0 || session->pendingOverflow);
+  firstChange = session->firstChange;
+  mico_rtos_unlock_mutex(&notifyMutex);
+
+  if(pending == false){
+    *waitTime = MICO_WAIT_FOREVER;
+    return false;
+  }
+
+  elapsed = mico_get_time() - firstChange;
+  if(elapsed >= HK_NOTIFY_COALESCE_TIME){
+    *waitTime = 0;
+    return true;
+  }
+  *waitTime = HK_NOTIFY_COALESCE_TIME - elapsed;
+  return false;
+}
+
+OSStatus HKNotifySessionTake(hk_notify_session_t *session, hk_notify_change_t **changes, uint32_t *count)
+{
+  OSStatus err = kNoErr;
+  HK_Notify_t *notify;
+  uint32_t total = 0;
+
+  *changes = NULL;
+  *count = 0;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  if(session->pendingOverflow){
+    /* Too many changes to track, report every subscribed characteristic instead */
+    for(notify = session->notifyList; notify; notify = notify->next)
+      total++;
+  }else{
+    total = session->pendingCount;
+  }
+  require_quiet(total, exit);
+
+  *changes = malloc(total * sizeof(hk_notify_change_t));
+  require_action(*changes, exit, err = kNoMemoryErr);
+
+  if(session->pendingOverflow){
+    for(notify = session->notifyList; notify; notify = notify->next){
+      (*changes)[*count].aid = notify->aid;
+      (*changes)[*count].iid = notify->iid;
+      (*changes)[*count].time = session->firstChange;
+      (*count)++;
+    }
+  }else{
+    memcpy(*changes, session->pending, total * sizeof(hk_notify_change_t));
+    *count = total;
+  }
+
+exit:
+  if(err == kNoErr){
+    session->pendingCount = 0;
+    session->pendingOverflow = false;
+  }
+  mico_rtos_unlock_mutex(&notifyMutex);
+  return err;
+}
+
+void HKNotifySessionDiscard(hk_notify_session_t *session, int aid, int iid)
+{
+  uint32_t i;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  for(i = 0; i < session->pendingCount; i++){
+    if(session->pending[i].aid == aid && session->pending[i].iid == iid){
+      session->pending[i] = session->pending[--session->pendingCount];
+      break;
+    }
+  }
+  mico_rtos_unlock_mutex(&notifyMutex);
+}
+
+/* Metrics */
+
+void HKNotifyRecordEvent(const hk_notify_change_t *changes, uint32_t count)
+{
+  uint32_t now = mico_get_time();
+  uint32_t i, latency;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  metrics.eventCount++;
+  metrics.characteristicCount += count;
+  for(i = 0; i < count; i++){
+    latency = now - changes[i].time;
+    latencySamples[latencySampleCount++ % HK_NOTIFY_LATENCY_SAMPLES] = latency;
+    if(latency > metrics.latencyMax) metrics.latencyMax = latency;
+  }
+  mico_rtos_unlock_mutex(&notifyMutex);
+}
+
+static int _CompareLatency(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+void HKNotifyGetMetrics(hk_notify_metrics_t *outMetrics)
+{
+  uint32_t *samples;
+  uint32_t count;
+
+  memset(outMetrics, 0x0, sizeof(hk_notify_metrics_t));
+  if(notifyMutex == NULL)
+    return;
+
+  samples = malloc(sizeof(latencySamples));
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  memcpy(outMetrics, &metrics, sizeof(hk_notify_metrics_t));
+  count = Min(latencySampleCount, HK_NOTIFY_LATENCY_SAMPLES);
+  if(samples)
+    memcpy(samples, latencySamples, count * sizeof(uint32_t));
+  mico_rtos_unlock_mutex(&notifyMutex);
+
+  if(samples && count){
+    qsort(samples, count, sizeof(uint32_t), _CompareLatency);
+    outMetrics->latencyP50 = samples[(count - 1) * 50 / 100];
+    outMetrics->latencyP90 = samples[(count - 1) * 90 / 100];
+    outMetrics->latencyP99 = samples[(count - 1) * 99 / 100];
+  }
+  if(samples) free(samples);
+}
+
+/* Subscriptions */
+
+OSStatus HKNotificationAdd( int aid, int iid, value_union value, HK_Notify_t** notifyList )
+{
+  OSStatus err = kNoErr;
+  HK_Notify_t *notify = (HK_Notify_t *)malloc(sizeof(HK_Notify_t));
+  HK_Notify_t *tmp;
+  require_action(notify, exit, err = kNoMemoryErr);
+  notify->aid = aid;
+  notify->iid = iid;
+  notify->value = value;
+  notify->next = NULL;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  tmp = * notifyList;
+  if(* notifyList == NULL){
+    * notifyList = notify;
+  }else{
+    if(tmp->aid == aid && tmp->iid == iid){
+      free(notify);
+      memcpy(&tmp->value, &value, sizeof(value_union));
+      goto unlock;   //Nodify already exist
+    }
+    while(tmp->next!=NULL){
+      tmp = tmp->next;
+      if(tmp->aid == aid && tmp->iid == iid){
+        memcpy(&tmp->value, &value, sizeof(value_union));
+        free(notify);
+        goto unlock;   //Nodify already exist
+      }
+    }
+    tmp->next = notify;
+  }
+unlock:
+  mico_rtos_unlock_mutex(&notifyMutex);
+exit:
+  return err;
+}
+
+OSStatus HKNotificationRemove( int aid, int iid, HK_Notify_t** notifyList )
+{
+  OSStatus err = kNoErr;
+  HK_Notify_t *temp2;
+  HK_Notify_t *temp;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  temp = *notifyList;
+  require_action(temp, exit, err = kDeletedErr);
+  do{
+    if(temp->aid == aid && temp->iid == iid){
+      if(temp == *notifyList){  //first element
+        * notifyList = temp->next;
+        free(temp);
+      }else{
+        temp2->next = temp->next;
+        free(temp);
+      }
+       break;
+    }
+    require_action(temp->next!=NULL, exit, err = kNotFoundErr);
+    temp2 = temp;
+    temp = temp->next;
+  }while(temp!=NULL);
+
+exit:
+  mico_rtos_unlock_mutex(&notifyMutex);
+  return err;
+}
+
+OSStatus HKNotifyGetNext( 
+        HK_Notify_t *   notifyList, 
+        int *           outAID, 
+        int *           outIID, 
+        value_union *   value, 
+        HK_Notify_t **  outNextNotifyList )
+{
+  if(notifyList == NULL) return kNotFoundErr;
+  *outAID = notifyList->aid;
+  *outIID = notifyList->iid;
+  *value = notifyList->value;
+  *outNextNotifyList = notifyList->next;
+  return kNoErr;
+}
+
+OSStatus HKNotificationFind( int aid, int iid, HK_Notify_t* notifyList )
+{
+  HK_Notify_t* _notifyList;
+
+  for(_notifyList = notifyList; _notifyList != NULL; _notifyList = _notifyList->next){
+    if(_notifyList->aid == aid && _notifyList->iid == iid)
+      return kNoErr;
+  }
+  return kNotFoundErr;
+}
+
+OSStatus HKNotificationClean( HK_Notify_t** notifyList )
+{
+  HK_Notify_t* temp;
+  HK_Notify_t* temp2;
+
+  mico_rtos_lock_mutex(&notifyMutex);
+  temp = *notifyList;
+  while(temp != NULL){
+    temp2 = temp->next;
+    free(temp);
+    temp = temp2;
+  }
+  * notifyList = NULL;
+  mico_rtos_unlock_mutex(&notifyMutex);
+  return kNoErr;
+}
@@ -0,0 +1,127 @@
+/**
+******************************************************************************
+* @file    HomeKitNotify.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This header contains function prototypes for characteristic
+  change publication and event notification sessions.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#ifndef __HOMEKITNOTIFY_h__
+#define __HOMEKITNOTIFY_h__
+
+#include "Common.h"
+#include "HomeKitProfiles.h"
+
+/* Accessory code calls HKCharacteristicChanged whenever a characteristic value changes, also
+   when the change comes from a controller write. Only the sessions subscribed to that aid/iid
+   are woken, through the event fd of their session, and every change published within
+   HK_NOTIFY_COALESCE_TIME of the first one goes out in the same EVENT message. The controller
+   that wrote a value gets no event for it. */
+
+/* Connections that can receive events at the same time */
+#ifndef HK_NOTIFY_MAX_SESSIONS
+#define HK_NOTIFY_MAX_SESSIONS        8
+#endif
+
+/* Changes of different characteristics kept per session until the next EVENT message, more
+   than that sends every subscribed characteristic */
+#ifndef HK_NOTIFY_MAX_PENDING
+#define HK_NOTIFY_MAX_PENDING         16
+#endif
+
+/* A session waits this long (ms) after the first change before sending the EVENT message */
+#ifndef HK_NOTIFY_COALESCE_TIME
+#define HK_NOTIFY_COALESCE_TIME       20
+#endif
+
+/* A session that could not take its changes for lack of memory tries again after this long (ms),
+   the changes stay pending in the meantime */
+#ifndef HK_NOTIFY_RETRY_TIME
+#define HK_NOTIFY_RETRY_TIME          100
+#endif
+
+/* Latency of the last changes delivered, used for the percentiles in the metrics */
+#ifndef HK_NOTIFY_LATENCY_SAMPLES
+#define HK_NOTIFY_LATENCY_SAMPLES     64
+#endif
+
+typedef struct _HK_Notify{
+  int aid;
+  int iid;
+  value_union value;
+  struct _HK_Notify *next;
+} HK_Notify_t;
+
+typedef struct _hk_notify_change_t {
+  int           aid;
+  int           iid;
+  uint32_t      time;                   /* mico_get_time() of the first change since the last EVENT */
+} hk_notify_change_t;
+
+typedef struct _hk_notify_session_t hk_notify_session_t;
+
+typedef struct _hk_notify_metrics_t {
+  uint32_t      changeCount;            /* HKCharacteristicChanged calls */
+  uint32_t      wakeCount;              /* Sessions woken */
+  uint32_t      coalescedCount;         /* Changes merged into a change already pending */
+  uint32_t      overflowCount;          /* Pending lists that overflowed */
+  uint32_t      eventCount;             /* EVENT messages sent */
+  uint32_t      characteristicCount;    /* Characteristics in those messages */
+  uint32_t      latencyP50;             /* ms, from the change to its EVENT message being sent */
+  uint32_t      latencyP90;
+  uint32_t      latencyP99;
+  uint32_t      latencyMax;
+} hk_notify_metrics_t;
+
+/* Called once before the HomeKit server accepts connections */
+OSStatus HKNotifyInit(void);
+
+/* Publication, can be called from any thread but not from an interrupt. The ByID variant
+   takes the service and characteristic indexes used by HKReadCharacteristicValue. */
+void HKCharacteristicChanged(int aid, int iid);
+void HKCharacteristicChangedByID(int aid, int serviceID, int characteristicID);
+
+/* Sessions, one per connection, only used by the thread that owns the connection */
+hk_notify_session_t *HKNotifySessionCreate(void);
+void HKNotifySessionDelete(hk_notify_session_t *session);
+int HKNotifySessionEventFd(hk_notify_session_t *session);
+HK_Notify_t **HKNotifySessionList(hk_notify_session_t *session);
+
+/* Returns true if the pending changes should be sent now, otherwise sets waitTime to the ms
+   until they should be, or MICO_WAIT_FOREVER if nothing is pending */
+bool HKNotifySessionReady(hk_notify_session_t *session, uint32_t *waitTime);
+
+/* Moves the pending changes, or every subscription after an overflow, to a new array in
+   changes that the caller frees. Nothing is taken if it cannot be allocated. */
+OSStatus HKNotifySessionTake(hk_notify_session_t *session, hk_notify_change_t **changes, uint32_t *count);
+
+/* Drops a pending change made by the session's own controller */
+void HKNotifySessionDiscard(hk_notify_session_t *session, int aid, int iid);
+
+/* Called by the session after sending an EVENT message */
+void HKNotifyRecordEvent(const hk_notify_change_t *changes, uint32_t count);
+
+void HKNotifyGetMetrics(hk_notify_metrics_t *metrics);
+
+/* Subscriptions of a session, add also updates the value of an existing subscription */
+OSStatus HKNotificationAdd( int aid, int iid, value_union value, HK_Notify_t** notifyList );
+OSStatus HKNotificationRemove( int aid, int iid, HK_Notify_t** notifyList );
+OSStatus HKNotificationFind( int aid, int iid, HK_Notify_t* notifyList );
+OSStatus HKNotificationClean( HK_Notify_t** notifyList );
+OSStatus HKNotifyGetNext( HK_Notify_t *notifyList, int *outAID, int *outIID, value_union *value, HK_Notify_t **outNextNotifyList );
+
+#endif
@@ -0,0 +1,274 @@
+/**
+******************************************************************************
+* @file    HomeKitPairCache.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide the pair verify session resume cache and the
+  RAM cache of controller long-term public keys.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "HomeKitPairCache.h"
+#include "SecurityUtils.h"
+
+#define cache_log(M, ...) custom_log("HomeKitPairCache", M, ##__VA_ARGS__)
+#define cache_log_trace() custom_log_trace("HomeKitPairCache")
+
+typedef struct _hk_resume_session_t {
+  bool          valid;
+  uint32_t      createTime;
+  char          controllerIdentifier[kHKControllerIdentifierLen];
+  uint8_t       sessionID[kHKResumeSessionIDLen];
+  uint8_t       sharedSecret[kHKSharedSecretLen];
+} hk_resume_session_t;
+
+typedef struct _hk_ltpk_entry_t {
+  bool          valid;
+  uint32_t      lastUsed;
+  char          controllerIdentifier[kHKControllerIdentifierLen];
+  uint8_t       controllerLTPK[kHKLTPKLen];
+} hk_ltpk_entry_t;
+
+/* Entries are small and are accessed from every HomeKit client thread, so they are
+   protected by suspending the scheduler rather than a mutex that needs creating first */
+static hk_resume_session_t  resumeSessions[HK_RESUME_CACHE_SIZE];
+static hk_ltpk_entry_t      ltpkCache[HK_LTPK_CACHE_SIZE];
+
+static hk_pair_verify_metrics_t metrics;
+static uint32_t fullVerifyTimeTotal = 0;
+static uint32_t resumeTimeTotal = 0;
+
+/* Session resume cache */
+
+static void _ResumeSessionClear(hk_resume_session_t *session)
+{
+  memzero_secure(session, sizeof(hk_resume_session_t));
+}
+
+OSStatus HKResumeSessionSave(const char *controllerIdentifier, const uint8_t sessionID[kHKResumeSessionIDLen],
+                             const uint8_t sharedSecret[kHKSharedSecretLen])
+{
+  OSStatus err = kNoErr;
+  hk_resume_session_t *slot = NULL;
+  uint32_t now = mico_get_time();
+  int i;
+
+  require_action(controllerIdentifier && sessionID && sharedSecret, exit, err = kParamErr);
+
+  mico_rtos_suspend_all_thread();
+  /* One resumable session per controller, otherwise reuse a free slot or evict the oldest */
+  for(i = 0; i < HK_RESUME_CACHE_SIZE; i++){
+    if(resumeSessions[i].valid && strncmp(resumeSessions[i].controllerIdentifier, controllerIdentifier, kHKControllerIdentifierLen) == 0){
+      slot = &resumeSessions[i];
+      break;
+    }
+  }
+  for(i = 0; slot == NULL && i < HK_RESUME_CACHE_SIZE; i++){
+    if(resumeSessions[i].valid == false)
+      slot = &resumeSessions[i];
+  }
+  if(slot == NULL){
+    slot = &resumeSessions[0];
+    for(i = 1; i < HK_RESUME_CACHE_SIZE; i++){
+      if((uint32_t)(now - resumeSessions[i].createTime) > (uint32_t)(now - slot->createTime))
+        slot = &resumeSessions[i];
+    }
+  }
+
+  slot->valid = true;
+  slot->createTime = now;
+  strncpy(slot->controllerIdentifier, controllerIdentifier, kHKControllerIdentifierLen - 1);
+  slot->controllerIdentifier[kHKControllerIdentifierLen - 1] = 0x0;
+  memcpy(slot->sessionID, sessionID, kHKResumeSessionIDLen);
+  memcpy(slot->sharedSecret, sharedSecret, kHKSharedSecretLen);
+  mico_rtos_resume_all_thread();
+
+exit:
+  return err;
+}
+
+OSStatus HKResumeSessionTake(const uint8_t sessionID[kHKResumeSessionIDLen], char controllerIdentifier[kHKControllerIdentifierLen],
+                             uint8_t sharedSecret[kHKSharedSecretLen])
+{
+  OSStatus err = kNotFoundErr;
+  uint32_t now = mico_get_time();
+  int i;
+
+  mico_rtos_suspend_all_thread();
+  for(i = 0; i < HK_RESUME_CACHE_SIZE; i++){
+    if(resumeSessions[i].valid == false)
+      continue;
+    if(memcmp_constant_time(resumeSessions[i].sessionID, sessionID, kHKResumeSessionIDLen) != 0)
+      continue;
+
+    if((uint32_t)(now - resumeSessions[i].createTime) < HK_RESUME_SESSION_LIFETIME){
+      memcpy(controllerIdentifier, resumeSessions[i].controllerIdentifier, kHKControllerIdentifierLen);
+      memcpy(sharedSecret, resumeSessions[i].sharedSecret, kHKSharedSecretLen);
+      err = kNoErr;
+    }else{
+      err = kTimeoutErr;
+    }
+    /* Session IDs can only be used once */
+    _ResumeSessionClear(&resumeSessions[i]);
+    break;
+  }
+  mico_rtos_resume_all_thread();
+
+  return err;
+}
+
+void HKResumeSessionRemoveController(const char *controllerIdentifier)
+{
+  int i;
+
+  mico_rtos_suspend_all_thread();
+  for(i = 0; i < HK_RESUME_CACHE_SIZE; i++){
+    if(resumeSessions[i].valid && strncmp(resumeSessions[i].controllerIdentifier, controllerIdentifier, kHKControllerIdentifierLen) == 0)
+      _ResumeSessionClear(&resumeSessions[i]);
+  }
+  mico_rtos_resume_all_thread();
+}
+
+void HKResumeSessionFlush(void)
+{
+  mico_rtos_suspend_all_thread();
+  memzero_secure(resumeSessions, sizeof(resumeSessions));
+  mico_rtos_resume_all_thread();
+}
+
+/* Controller LTPK cache */
+
+static hk_ltpk_entry_t *_LTPKCacheLookup(const char *controllerIdentifier)
+{
+  int i;
+
+  for(i = 0; i < HK_LTPK_CACHE_SIZE; i++){
+    if(ltpkCache[i].valid && strncmp(ltpkCache[i].controllerIdentifier, controllerIdentifier, kHKControllerIdentifierLen) == 0)
+      return &ltpkCache[i];
+  }
+  return NULL;
+}
+
+bool HKLTPKCacheFind(const char *controllerIdentifier, uint8_t controllerLTPK[kHKLTPKLen])
+{
+  hk_ltpk_entry_t *entry;
+
+  mico_rtos_suspend_all_thread();
+  entry = _LTPKCacheLookup(controllerIdentifier);
+  if(entry){
+    entry->lastUsed = mico_get_time();
+    memcpy(controllerLTPK, entry->controllerLTPK, kHKLTPKLen);
+    metrics.ltpkCacheHitCount++;
+  }else{
+    metrics.ltpkCacheMissCount++;
+  }
+  mico_rtos_resume_all_thread();
+
+  return (entry != NULL);
+}
+
+void HKLTPKCacheInsert(const char *controllerIdentifier, const uint8_t controllerLTPK[kHKLTPKLen])
+{
+  hk_ltpk_entry_t *entry;
+  uint32_t now = mico_get_time();
+  int i;
+
+  mico_rtos_suspend_all_thread();
+  entry = _LTPKCacheLookup(controllerIdentifier);
+  for(i = 0; entry == NULL && i < HK_LTPK_CACHE_SIZE; i++){
+    if(ltpkCache[i].valid == false)
+      entry = &ltpkCache[i];
+  }
+  if(entry == NULL){
+    entry = &ltpkCache[0];
+    for(i = 1; i < HK_LTPK_CACHE_SIZE; i++){
+      if((uint32_t)(now - ltpkCache[i].lastUsed) > (uint32_t)(now - entry->lastUsed))
+        entry = &ltpkCache[i];
+    }
+  }
+
+  entry->valid = true;
+  entry->lastUsed = now;
+  strncpy(entry->controllerIdentifier, controllerIdentifier, kHKControllerIdentifierLen - 1);
+  entry->controllerIdentifier[kHKControllerIdentifierLen - 1] = 0x0;
+  memcpy(entry->controllerLTPK, controllerLTPK, kHKLTPKLen);
+  mico_rtos_resume_all_thread();
+}
+
+void HKLTPKCacheUpdate(const char *controllerIdentifier, const uint8_t controllerLTPK[kHKLTPKLen])
+{
+  hk_ltpk_entry_t *entry;
+
+  mico_rtos_suspend_all_thread();
+  entry = _LTPKCacheLookup(controllerIdentifier);
+  if(entry)
+    memcpy(entry->controllerLTPK, controllerLTPK, kHKLTPKLen);
+  mico_rtos_resume_all_thread();
+}
+
+void HKLTPKCacheRemove(const char *controllerIdentifier)
+{
+  hk_ltpk_entry_t *entry;
+
+  mico_rtos_suspend_all_thread();
+  entry = _LTPKCacheLookup(controllerIdentifier);
+  if(entry)
+    memset(entry, 0, sizeof(hk_ltpk_entry_t));
+  mico_rtos_resume_all_thread();
+}
+
+void HKLTPKCacheFlush(void)
+{
+  mico_rtos_suspend_all_thread();
+  memset(ltpkCache, 0, sizeof(ltpkCache));
+  mico_rtos_resume_all_thread();
+}
+
+/* Metrics */
+
+void HKPairVerifyRecordResumeRequest(void)
+{
+  mico_rtos_suspend_all_thread();
+  metrics.resumeRequestCount++;
+  mico_rtos_resume_all_thread();
+}
+
+void HKPairVerifyRecordHandshake(bool resumed, uint32_t elapsed)
+{
+  mico_rtos_suspend_all_thread();
+  if(resumed){
+    metrics.resumeHitCount++;
+    resumeTimeTotal += elapsed;
+    if(elapsed > metrics.resumeTimeMax) metrics.resumeTimeMax = elapsed;
+  }else{
+    metrics.fullVerifyCount++;
+    fullVerifyTimeTotal += elapsed;
+    if(elapsed > metrics.fullVerifyTimeMax) metrics.fullVerifyTimeMax = elapsed;
+  }
+  mico_rtos_resume_all_thread();
+
+  cache_log("Pair verify %s in %u ms, resumed %u/%u", resumed? "resumed":"completed", elapsed,
+            metrics.resumeHitCount, metrics.resumeRequestCount);
+}
+
+void HKPairVerifyGetMetrics(hk_pair_verify_metrics_t *outMetrics)
+{
+  mico_rtos_suspend_all_thread();
+  memcpy(outMetrics, &metrics, sizeof(hk_pair_verify_metrics_t));
+  outMetrics->fullVerifyTimeAvg = metrics.fullVerifyCount? fullVerifyTimeTotal/metrics.fullVerifyCount : 0;
+  outMetrics->resumeTimeAvg = metrics.resumeHitCount? resumeTimeTotal/metrics.resumeHitCount : 0;
+  mico_rtos_resume_all_thread();
+}
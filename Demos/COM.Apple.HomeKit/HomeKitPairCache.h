@@ -0,0 +1,80 @@
+/**
+******************************************************************************
+* @file    HomeKitPairCache.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This header contains function prototypes for the pair verify
+  session resume cache and the RAM cache of controller long-term public keys.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#ifndef __HOMEKITPAIRCACHE_h__
+#define __HOMEKITPAIRCACHE_h__
+
+#include "Common.h"
+
+/* Resumable pair verify sessions, the oldest one is dropped when the cache is full */
+#ifndef HK_RESUME_CACHE_SIZE
+#define HK_RESUME_CACHE_SIZE          8
+#endif
+
+/* A cached session can only be resumed within this time after it was established */
+#ifndef HK_RESUME_SESSION_LIFETIME
+#define HK_RESUME_SESSION_LIFETIME    ( 24 * 60 * 60 * 1000 )
+#endif
+
+/* Controller LTPKs kept in RAM so pair verify does not read the pair list from flash */
+#ifndef HK_LTPK_CACHE_SIZE
+#define HK_LTPK_CACHE_SIZE            4
+#endif
+
+#define kHKResumeSessionIDLen         8
+#define kHKSharedSecretLen            32
+#define kHKControllerIdentifierLen    64
+#define kHKLTPKLen                    32
+
+typedef struct _hk_pair_verify_metrics_t {
+  uint32_t      fullVerifyCount;        /* Full Curve25519/Ed25519 handshakes completed */
+  uint32_t      resumeRequestCount;     /* Pair resume requests received */
+  uint32_t      resumeHitCount;         /* Pair resume requests accepted */
+  uint32_t      ltpkCacheHitCount;
+  uint32_t      ltpkCacheMissCount;
+  uint32_t      fullVerifyTimeAvg;      /* ms, from M1 received to M4 sent */
+  uint32_t      fullVerifyTimeMax;
+  uint32_t      resumeTimeAvg;          /* ms, from M1 received to M2 sent */
+  uint32_t      resumeTimeMax;
+} hk_pair_verify_metrics_t;
+
+/* Session resume cache. Session IDs are single use, a successful resume replaces the entry. */
+OSStatus HKResumeSessionSave(const char *controllerIdentifier, const uint8_t sessionID[kHKResumeSessionIDLen],
+                             const uint8_t sharedSecret[kHKSharedSecretLen]);
+OSStatus HKResumeSessionTake(const uint8_t sessionID[kHKResumeSessionIDLen], char controllerIdentifier[kHKControllerIdentifierLen],
+                             uint8_t sharedSecret[kHKSharedSecretLen]);
+void HKResumeSessionRemoveController(const char *controllerIdentifier);
+void HKResumeSessionFlush(void);
+
+/* Controller LTPK cache */
+bool HKLTPKCacheFind(const char *controllerIdentifier, uint8_t controllerLTPK[kHKLTPKLen]);
+void HKLTPKCacheInsert(const char *controllerIdentifier, const uint8_t controllerLTPK[kHKLTPKLen]);
+void HKLTPKCacheUpdate(const char *controllerIdentifier, const uint8_t controllerLTPK[kHKLTPKLen]);
+void HKLTPKCacheRemove(const char *controllerIdentifier);
+void HKLTPKCacheFlush(void);
+
+/* Metrics */
+void HKPairVerifyRecordHandshake(bool resumed, uint32_t elapsed);
+void HKPairVerifyRecordResumeRequest(void);
+void HKPairVerifyGetMetrics(hk_pair_verify_metrics_t *metrics);
+
+#endif
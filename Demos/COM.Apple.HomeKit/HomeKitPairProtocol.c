@@ -9,15 +9,19 @@
 #include "HTTPUtils.h"
 #include "HomeKitTLV.h"
 #include "TLVUtils.h"
-#include "MICOSRPServer.h"
+#include "SRPUtils.h"
 #include "StringUtils.h"
+#include "SecurityUtils.h"
+#include "RandomUtils.h"
 #include "Curve25519/curve25519-donna.h"
 #include "MICOCrypto/crypto_stream_chacha20.h"
 #include "MICOCrypto/crypto_aead_chacha20poly1305.h"
 #include "MICOCrypto/crypto_sign.h"
 #include "SHAUtils/sha.h"
 #include "HomeKitPairProtocol.h"
+#include "HomeKitPairCache.h"
 #include "SHAUtils.h"
+#include "CryptoProvider.h"
 
 #define pair_log(M, ...) custom_log("HomeKitPair", M, ##__VA_ARGS__)
 #define pair_log_trace() custom_log_trace("HomeKitPair")
@@ -43,7 +47,8 @@ typedef enum
   Pair_Verify,
   Pair_Add,
   Pair_Remove,
-  Pair_List
+  Pair_List,
+  Pair_Resume
 } HKPairMethold_t;
 
 const char * hkdfSetupSalt  =        "Pair-Setup-Encrypt-Salt";
@@ -67,11 +72,19 @@ const char * hkdfC2AInfo =           "Control-Write-Encryption-Key";
 const char * hkdfA2CKeySalt =        "Control-Salt";
 const char * hkdfA2CInfo =           "Control-Read-Encryption-Key";
 
+const char * hkdfResumeIDSalt =      "Pair-Verify-ResumeSessionID-Salt";
+const char * hkdfResumeIDInfo =      "Pair-Verify-ResumeSessionID-Info";
+const char * hkdfResumeRequestInfo = "Pair-Resume-Request-Info";
+const char * hkdfResumeRespondInfo = "Pair-Resume-Response-Info";
+const char * hkdfResumeSecretInfo =  "Pair-Resume-Shared-Secret-Info";
+
 const char * AEAD_Nonce_Setup04 =   "PS-Msg04";
 const char * AEAD_Nonce_Setup05 =   "PS-Msg05";
 const char * AEAD_Nonce_Setup06 =   "PS-Msg06";
 const char * AEAD_Nonce_Verify02 =  "PV-Msg02";
 const char * AEAD_Nonce_Verify03 =  "PV-Msg03";
+const char * AEAD_Nonce_Resume01 =  "PR-Msg01";
+const char * AEAD_Nonce_Resume02 =  "PR-Msg02";
 
 const char *stateDescription[7] = {"", "kTLVType_State = M1", "kTLVType_State = M2", "kTLVType_State = M3",
                                    "kTLVType_State = M4", "kTLVType_State = M5", "kTLVType_State = M6"};
@@ -87,6 +100,9 @@ static size_t         _len_verifier = 0;
 static const uint8_t  *_salt = NULL;
 static size_t         _len_salt = 0;
 
+/* Verifier with N, k*v and v in Montgomery form, built on the first pair setup and reused until the password changes */
+static SRPVerifierRef _srpVerifier = NULL;
+
 static HAPairSetupState_t haPairSetupState = eState_M1_SRPStartRequest;
 const char* hkSRPUser = "Pair-Setup";
 
@@ -101,12 +117,15 @@ OSStatus _HandleState_WaitingForVerifyStartRequest( HTTPHeader_t* inHeader, pair
 OSStatus _HandleState_WaitingForVerifyStartRespond(int inFd, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext);
 OSStatus _HandleState_WaitingForVerifyFinishRequest(HTTPHeader_t* inHeader, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext );
 OSStatus _HandleState_WaitingForVerifyFinishRespond(int inFd, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext);
+OSStatus _HandleState_HandleResumeRespond(int inFd, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext);
 
 
 void HKSetPassword (const uint8_t * password, const size_t passwordLen)
 {
   _password = password;
   _len_password = passwordLen;
+  SRPVerifierDelete( _srpVerifier );
+  _srpVerifier = NULL;
 }
 
 void HKSetVerifier (const uint8_t * verifier, const size_t verifierLen, const uint8_t * salt, const size_t saltLen )
@@ -115,6 +134,41 @@ void HKSetVerifier (const uint8_t * verifier, const size_t verifierLen, const ui
   _len_verifier = verifierLen;
   _salt = salt;
   _len_salt = saltLen;
+  SRPVerifierDelete( _srpVerifier );
+  _srpVerifier = NULL;
+}
+
+static OSStatus _HKPrepareSRPVerifier( void )
+{
+  OSStatus err = kNoErr;
+
+  if( _srpVerifier ) return kNoErr;
+
+  if( _verifier )
+    err = SRPVerifierCreate( kSRPGroup_3072, kSRPHash_SHA512, hkSRPUser, _salt, _len_salt,
+                             _verifier, _len_verifier, &_srpVerifier );
+  else if( _password )
+    err = SRPVerifierCreateWithPassword( kSRPGroup_3072, kSRPHash_SHA512, hkSRPUser,
+                                         _password, _len_password, &_srpVerifier );
+  else
+    err = kParamErr;
+  return err;
+}
+
+static OSStatus _HKSendTLVResponse( int inFd, const uint8_t *inTLV, size_t inTLVLen )
+{
+  OSStatus err;
+  uint8_t *httpResponse = NULL;
+  size_t httpResponseLen = 0;
+
+  err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, inTLVLen, &httpResponse, &httpResponseLen );
+  require_noerr( err, exit );
+  err = SocketSendHTTPMessage( inFd, httpResponse, httpResponseLen, inTLV, inTLVLen );
+  require_noerr( err, exit );
+
+exit:
+  if(httpResponse) free(httpResponse);
+  return err;
 }
 
 
@@ -125,11 +179,14 @@ void HKCleanPairSetupInfo(pairInfo_t **info, mico_Context_t * const inContext){
       inContext->appStatus.haPairSetupRunning = false;
     }
       
-    srp_server_delete(&(*info)->SRPServer );
+    SRPServerDelete((*info)->SRPServer );
     //if((*info)->SRPUser) free((*info)->SRPUser);
     if((*info)->SRPControllerPublicKey) free((*info)->SRPControllerPublicKey);
     if((*info)->SRPControllerProof) free((*info)->SRPControllerProof);
-    if((*info)->HKDF_Key) free((*info)->HKDF_Key);
+    if((*info)->HKDF_Key){
+      memzero_secure((*info)->HKDF_Key, 32);
+      free((*info)->HKDF_Key);
+    }
     free((*info));   
     *info = 0; 
   }
@@ -149,12 +206,15 @@ void HKCleanPairVerifyInfo(pairVerifyInfo_t **verifyInfo){
     if(*verifyInfo){
     if((*verifyInfo)->pControllerCurve25519PK) free((*verifyInfo)->pControllerCurve25519PK);
     if((*verifyInfo)->pAccessoryCurve25519PK) free((*verifyInfo)->pAccessoryCurve25519PK);
-    if((*verifyInfo)->pAccessoryCurve25519SK) free((*verifyInfo)->pAccessoryCurve25519SK);
-    if((*verifyInfo)->pSharedSecret) free((*verifyInfo)->pSharedSecret);
-    if((*verifyInfo)->pHKDFKey) free((*verifyInfo)->pHKDFKey);
-    if((*verifyInfo)->A2CKey) free((*verifyInfo)->A2CKey);
-    if((*verifyInfo)->C2AKey) free((*verifyInfo)->C2AKey);
+    /* Key material is wiped before it goes back to the heap */
+    if((*verifyInfo)->pAccessoryCurve25519SK) { memzero_secure((*verifyInfo)->pAccessoryCurve25519SK, 32); free((*verifyInfo)->pAccessoryCurve25519SK); }
+    if((*verifyInfo)->pSharedSecret) { memzero_secure((*verifyInfo)->pSharedSecret, 32); free((*verifyInfo)->pSharedSecret); }
+    if((*verifyInfo)->pHKDFKey) { memzero_secure((*verifyInfo)->pHKDFKey, 32); free((*verifyInfo)->pHKDFKey); }
+    if((*verifyInfo)->A2CKey) { memzero_secure((*verifyInfo)->A2CKey, 32); free((*verifyInfo)->A2CKey); }
+    if((*verifyInfo)->C2AKey) { memzero_secure((*verifyInfo)->C2AKey, 32); free((*verifyInfo)->C2AKey); }
     if((*verifyInfo)->pControllerIdentifier) free((*verifyInfo)->pControllerIdentifier);
+    if((*verifyInfo)->pResumeSessionID) free((*verifyInfo)->pResumeSessionID);
+    if((*verifyInfo)->pResumeRequestData) free((*verifyInfo)->pResumeRequestData);
     
     free((*verifyInfo));   
     *verifyInfo = 0; 
@@ -165,41 +225,20 @@ OSStatus HKPairSetupEngine( int inFd, HTTPHeader_t* inHeader, pairInfo_t** inInf
 {
   OSStatus err = kNoErr;
 
-  uint8_t *outTLVResponse = NULL;
+  uint8_t outTLVResponse[2 * TLV8ItemSize(sizeof(uint8_t))];
   size_t outTLVResponseLen = 0;
-  uint8_t *tlvPtr;
-
-  uint8_t *httpResponse = NULL;
-  size_t httpResponseLen = 0;
 
 
   if(pairErrorNum>=10){
-    outTLVResponse = NULL;
-
-    /* Build tlv: state and encrypted data */
-    outTLVResponseLen = 0;
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M2_SRPStartRespond;
-
-    *tlvPtr++ = kTLVType_Error;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = kTLVError_MaxTries;
+    /* Build tlv: state and error */
+    err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_State, eState_M2_SRPStartRespond );
+    require_noerr( err, exit );
+    err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_Error, kTLVError_MaxTries );
+    require_noerr( err, exit );
 
     haPairSetupState = eState_M1_SRPStartRequest;
 
-    err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, outTLVResponseLen, &httpResponse, &httpResponseLen );
-    require_noerr( err, exit );
-    err = SocketSend( inFd, httpResponse, httpResponseLen );
-    require_noerr( err, exit );
-    err = SocketSend(inFd, outTLVResponse, outTLVResponseLen);
+    err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
     require_noerr( err, exit );
     goto exit;
   }
@@ -249,7 +288,6 @@ OSStatus _HandleState_WaitingForSRPStartRequest( HTTPHeader_t* inHeader, pairInf
   uint8_t                     eid;
   const uint8_t *             ptr;
   size_t                      len;
-  char *                      tmp;
 
   OSStatus err = kNoErr;
 
@@ -268,21 +306,14 @@ OSStatus _HandleState_WaitingForSRPStartRequest( HTTPHeader_t* inHeader, pairInf
 
   while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
   {
-    tmp = calloc( len + 1, sizeof( uint8_t ) );
-    require_action( tmp, exit, err = kNoMemoryErr );
-    memcpy( tmp, ptr, len );
-
     switch( eid )
     {
       case kTLVType_State:
-        require_action(haPairSetupState == *(uint8_t *)tmp, exit, err = kStateErr);
-        free(tmp);
+        require_action(len == sizeof(uint8_t) && haPairSetupState == *ptr, exit, err = kStateErr);
       break;
         case kTLVType_Method:
-        free(tmp);
         break;
       default:
-        free( tmp );
         pair_log( "Warning: Ignoring unsupported pair setup EID 0x%02X", eid );
         break;
     }
@@ -299,132 +330,86 @@ OSStatus _HandleState_HandleSRPStartRespond(int inFd, pairInfo_t* inInfo, mico_C
 {
   pair_log_trace();
   OSStatus err;
-  int i, j;
   uint8_t *outTLVResponse = NULL;
+  size_t outTLVResponseSize;
   size_t outTLVResponseLen = 0;
-  uint8_t *tlvPtr;
   char *tempString = NULL;
-  uint8_t *httpResponse = NULL;
-  size_t httpResponseLen = 0;
+  const uint8_t *bytes_s, *bytes_B;
+  size_t len_s, len_B;
 
-  require_action(_verifier||_password, exit, err = kParamErr);
-  inInfo->SRPServer = srp_server_setup( SRP_SHA512, SRP_NG_3072, inInfo->SRPUser, 
-                                        _password, _len_password, 
-                                        _verifier, _len_verifier,
-                                        _salt, _len_salt,
-                                        0, 0);
-  require(inInfo->SRPServer, exit);
+  err = _HKPrepareSRPVerifier( );
+  require_noerr(err, exit);
+  err = SRPServerCreate( _srpVerifier, &inInfo->SRPServer );
+  require_noerr(err, exit);
+  bytes_s = SRPVerifierGetSalt( _srpVerifier, &len_s );
+  bytes_B = SRPServerGetPublicKey( inInfo->SRPServer, &len_B );
 
 #ifdef DEBUG
-  tempString = DataToHexString( inInfo->SRPServer->bytes_v, inInfo->SRPServer->len_v );
-  require_action( tempString, exit, err = kNoMemoryErr );
-  pair_log("Verifier length: %d: %s", inInfo->SRPServer->len_v, tempString);
-  free(tempString);
-  tempString = DataToHexString( inInfo->SRPServer->bytes_s, inInfo->SRPServer->len_s );
+  tempString = DataToHexString( bytes_s, len_s );
   require_action( tempString, exit, err = kNoMemoryErr );
-  pair_log("Salt length: %d: %s", inInfo->SRPServer->len_s, tempString);
+  pair_log("Salt length: %d: %s", len_s, tempString);
   free(tempString);
 #endif
 
-  outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-  for(i = inInfo->SRPServer->len_B/kHATLV_MaxStringSize; i>0; i--)
-    outTLVResponseLen += kHATLV_MaxStringSize + kHATLV_TypeLengthSize;
-  outTLVResponseLen += inInfo->SRPServer->len_B%kHATLV_MaxStringSize + kHATLV_TypeLengthSize;
-  outTLVResponseLen += inInfo->SRPServer->len_s + kHATLV_TypeLengthSize;
-
-  outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
+  outTLVResponseSize = TLV8ItemSize(sizeof(uint8_t)) + TLV8ItemSize(len_s) + TLV8ItemSize(len_B);
+  outTLVResponse = malloc( outTLVResponseSize );
   require_action( outTLVResponse, exit, err = kNoMemoryErr );
 
-  tlvPtr = outTLVResponse;
-
   /* Send pair state - M2 */
-  *tlvPtr++ = kTLVType_State;
-  *tlvPtr++ = sizeof(uint8_t);
-  *tlvPtr++ = (uint8_t)eState_M2_SRPStartRespond;
+  err = TLVAppendUInt8( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_State, eState_M2_SRPStartRespond );
+  require_noerr( err, exit );
   
   /* Send 16+ bytes of random salt */
-  *tlvPtr++ = kTLVType_Salt;
-  *tlvPtr++ = inInfo->SRPServer->len_s;
-  memcpy( tlvPtr, inInfo->SRPServer->bytes_s, inInfo->SRPServer->len_s );
-  tlvPtr += inInfo->SRPServer->len_s;
-
-  /* Send accessory's SRP public key */
-  j = inInfo->SRPServer->len_B/kHATLV_MaxStringSize;
-  for(i = 0; i < j; i++){
-    *tlvPtr++ = kTLVType_PublicKey;
-    *tlvPtr++ = kHATLV_MaxStringSize;
-    memcpy( tlvPtr, inInfo->SRPServer->bytes_B+i*kHATLV_MaxStringSize, kHATLV_MaxStringSize );
-    tlvPtr += kHATLV_MaxStringSize;
-  }
-  *tlvPtr++ = kTLVType_PublicKey;
-  *tlvPtr++ = inInfo->SRPServer->len_B%kHATLV_MaxStringSize;
-  memcpy( tlvPtr, inInfo->SRPServer->bytes_B+kHATLV_MaxStringSize*j, inInfo->SRPServer->len_B%kHATLV_MaxStringSize );
-  tlvPtr += inInfo->SRPServer->len_B%kHATLV_MaxStringSize;
-  
-  /* Send */
-  err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, outTLVResponseLen, &httpResponse, &httpResponseLen );
+  err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_Salt, bytes_s, len_s );
   require_noerr( err, exit );
-  err = SocketSend( inFd, httpResponse, httpResponseLen );
+
+  /* Send accessory's SRP public key, it is split into 255 bytes fragments */
+  err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_PublicKey, bytes_B, len_B );
   require_noerr( err, exit );
-  err = SocketSend( inFd, outTLVResponse, outTLVResponseLen );
+  
+  /* Send */
+  err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
   require_noerr( err, exit );
 
   haPairSetupState = eState_M3_SRPVerifyRequest;
 
 exit:
   if(outTLVResponse) free(outTLVResponse);
-  if(httpResponse) free(httpResponse);
   return err;
 }
 
 OSStatus _HandleState_WaitingForSRPVerifyRequest( HTTPHeader_t* inHeader, pairInfo_t* inInfo, mico_Context_t * const inContext )
 {
   pair_log_trace();
-  const uint8_t *             src = (const uint8_t *) inHeader->extraDataPtr;
-  const uint8_t * const       end = src + inHeader->extraDataLen;
+  uint8_t *                   src = (uint8_t *) inHeader->extraDataPtr;
+  uint8_t * const             end = src + inHeader->extraDataLen;
   uint8_t                     eid;
-  const uint8_t *             ptr;
+  uint8_t *                   ptr;
   size_t                      len;
-  char *                      tmp;
   OSStatus err = kNoErr;
 
-  while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
+  /* Fragments of the public key are joined in the request buffer, each value is copied once */
+  while( TLVGetNextInPlace( src, end, &eid, &ptr, &len, &src ) == kNoErr )
   {
 
     switch( eid )
     {
       case kTLVType_State:
-        tmp = calloc( len, sizeof( uint8_t ) );
-        require_action( tmp, exit, err = kNoMemoryErr );
-        memcpy( tmp, ptr, len );
-        require_action(haPairSetupState == *(uint8_t *)tmp, exit, err = kStateErr);
-        free(tmp);
+        require_action(len == sizeof(uint8_t) && haPairSetupState == *ptr, exit, err = kStateErr);
       break;
         case kTLVType_PublicKey:
-        if(inInfo->SRPControllerPublicKey == NULL){
-          inInfo->SRPControllerPublicKey = calloc( len, sizeof( uint8_t ) );
-          require_action( inInfo->SRPControllerPublicKey, exit, err = kNoMemoryErr );
-          memcpy( inInfo->SRPControllerPublicKey, ptr, len );
-          inInfo->SRPControllerPublicKeyLen = len;
-        }else{
-          inInfo->SRPControllerPublicKey = realloc( inInfo->SRPControllerPublicKey, inInfo->SRPControllerPublicKeyLen+len );
-          require_action( inInfo->SRPControllerPublicKey, exit, err = kNoMemoryErr );
-          memcpy( inInfo->SRPControllerPublicKey+inInfo->SRPControllerPublicKeyLen, ptr, len );
-          inInfo->SRPControllerPublicKeyLen += len;
-        }
+        require_action( inInfo->SRPControllerPublicKey == NULL, exit, err = kMalformedErr );
+        inInfo->SRPControllerPublicKey = malloc( len );
+        require_action( inInfo->SRPControllerPublicKey, exit, err = kNoMemoryErr );
+        memcpy( inInfo->SRPControllerPublicKey, ptr, len );
+        inInfo->SRPControllerPublicKeyLen = len;
         break;
       case kTLVType_Proof:
-        if(inInfo->SRPControllerProof == NULL){
-          inInfo->SRPControllerProof = calloc( len, sizeof( uint8_t ) );
-          require_action( inInfo->SRPControllerProof, exit, err = kNoMemoryErr );
-          memcpy( inInfo->SRPControllerProof, ptr, len );
-          inInfo->SRPControllerProofLen = len;
-        }else{
-          inInfo->SRPControllerProof = realloc( inInfo->SRPControllerProof, inInfo->SRPControllerProofLen+len );
-          require_action( inInfo->SRPControllerProof, exit, err = kNoMemoryErr );
-          memcpy( inInfo->SRPControllerProof+inInfo->SRPControllerProofLen, ptr, len );
-          inInfo->SRPControllerProofLen += len;
-        }
+        require_action( inInfo->SRPControllerProof == NULL, exit, err = kMalformedErr );
+        inInfo->SRPControllerProof = malloc( len );
+        require_action( inInfo->SRPControllerProof, exit, err = kNoMemoryErr );
+        memcpy( inInfo->SRPControllerProof, ptr, len );
+        inInfo->SRPControllerProofLen = len;
         break;
       default:
         pair_log( "Warning: Ignoring unsupported pair setup EID 0x%02X", eid );
@@ -446,54 +431,48 @@ OSStatus _HandleState_HandleSRPVerifyRespond(int inFd, pairInfo_t* inInfo, mico_
   pair_log_trace();
   OSStatus err = kNoErr;
   uint8_t *outTLVResponse = NULL;
+  size_t outTLVResponseSize;
   size_t outTLVResponseLen = 0;
-  uint8_t *tlvPtr;
+  uint8_t stateErrorTLV[2 * TLV8ItemSize(sizeof(uint8_t))];
   uint8_t signMFiChallenge[32];
   uint8_t signMFiChallengeSHA[20];
-  SHA_CTX ctx;
+  CryptoRequest shaRequest;
   uint8_t *MFiProof = NULL;
   size_t  MFiProofLen;
   uint8_t *outCertificatePtr = NULL;
   size_t outCertificateLen;
   uint8_t *encryptedData = NULL;
   unsigned long long encryptedDataLen;
-  int i, j;
-
-  uint8_t *httpResponse = NULL;
-  size_t httpResponseLen = 0;
 
   const uint8_t * bytes_HAMK = 0;
+  size_t len_HAMK = 0;
 
   pair_log( "Checking password..." );
-  err = srp_server_generate_session_key( inInfo->SRPServer, inInfo->SRPControllerPublicKey, inInfo->SRPControllerPublicKeyLen );
+  err = SRPServerSetClientPublicKey( inInfo->SRPServer, inInfo->SRPControllerPublicKey, inInfo->SRPControllerPublicKeyLen );
   require_noerr(err, exit);
 
-  srp_server_verify_session( inInfo->SRPServer,  inInfo->SRPControllerProof,  &bytes_HAMK );
+  /* A wrong setup code is answered with kTLVError_Authentication below, not dropped */
+  if ( SRPServerVerifyProof( inInfo->SRPServer, inInfo->SRPControllerProof, inInfo->SRPControllerProofLen, &bytes_HAMK, &len_HAMK ) == kNoErr )
+    inInfo->SRPSessionKey = SRPServerGetSessionKey( inInfo->SRPServer, &inInfo->SRPSessionKeyLen );
 
   if ( !bytes_HAMK ){
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M4_SRPVerifyRespond;
-
-    *tlvPtr++ = kTLVType_Error;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = kTLVError_Authentication;
+    err = TLVAppendUInt8( stateErrorTLV, sizeof(stateErrorTLV), &outTLVResponseLen, kTLVType_State, eState_M4_SRPVerifyRespond );
+    require_noerr( err, exit );
+    err = TLVAppendUInt8( stateErrorTLV, sizeof(stateErrorTLV), &outTLVResponseLen, kTLVType_Error, kTLVError_Authentication );
+    require_noerr( err, exit );
     pair_log("Send: kTLVType_Error: 0x%x", kTLVError_Authentication);
     haPairSetupState = eState_M1_SRPStartRequest;
+
+    err = _HKSendTLVResponse( inFd, stateErrorTLV, outTLVResponseLen );
+    require_noerr( err, exit );
+    goto exit;
   }
   else{
     /* Generate session key */
     inInfo->HKDF_Key = malloc(32);
     require_action(inInfo->HKDF_Key, exit, err = kNoMemoryErr);
     err = hkdf(SHA512,  (const unsigned char *)hkdfSetupSalt, strlen(hkdfSetupSalt),
-                        inInfo->SRPServer->session_key, inInfo->SRPServer->len_session_key,
+                        inInfo->SRPSessionKey, inInfo->SRPSessionKeyLen,
                         (const unsigned char *)hkdfSetupInfo, strlen(hkdfSetupInfo), inInfo->HKDF_Key, 32);
     require_noerr(err, exit);
 
@@ -503,12 +482,16 @@ OSStatus _HandleState_HandleSRPVerifyRespond(int inFd, pairInfo_t* inInfo, mico_
       require_noerr(err, exit);
 
       err = hkdf(SHA512,  (const unsigned char *)hkdfMFiSalt, strlen(hkdfMFiSalt),
-                          inInfo->SRPServer->session_key, inInfo->SRPServer->len_session_key,
+                          inInfo->SRPSessionKey, inInfo->SRPSessionKeyLen,
                           (const unsigned char *)hkdfMFiInfo, strlen(hkdfMFiInfo), signMFiChallenge, 32);
       require_noerr(err, exit);  
-      SHA1_Init( &ctx );
-      SHA1_Update( &ctx, signMFiChallenge, 32 );
-      SHA1_Final( (uint8_t *)&signMFiChallengeSHA, &ctx );
+      memset( &shaRequest, 0x0, sizeof( shaRequest ) );
+      shaRequest.op = kCryptoOp_SHA1;
+      shaRequest.src = signMFiChallenge;
+      shaRequest.srcLen = 32;
+      shaRequest.dst = signMFiChallengeSHA;
+      err = CryptoPerform( &shaRequest );
+      require_noerr(err, exit);
 
       err =  MicoMFiAuthCreateSignature( signMFiChallengeSHA, 20 , &MFiProof,  &MFiProofLen);
       require_noerr(err, exit);
@@ -516,36 +499,17 @@ OSStatus _HandleState_HandleSRPVerifyRespond(int inFd, pairInfo_t* inInfo, mico_
       err = MicoMFiAuthCopyCertificate( &outCertificatePtr, &outCertificateLen );
       require_noerr(err, exit);
 
-      /* Build MFi sub-TLV */
-      outTLVResponseLen = 0;
-      outTLVResponseLen += MFiProofLen + kHATLV_TypeLengthSize;
-      for(i = outCertificateLen/kHATLV_MaxStringSize; i>0; i--)
-        outTLVResponseLen += kHATLV_MaxStringSize + kHATLV_TypeLengthSize;
-      outTLVResponseLen += outCertificateLen%kHATLV_MaxStringSize + kHATLV_TypeLengthSize;
-
-      outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
+      /* Build MFi sub-TLV, the certificate is split into 255 bytes fragments */
+      outTLVResponseSize = TLV8ItemSize(MFiProofLen) + TLV8ItemSize(outCertificateLen);
+      outTLVResponse = malloc( outTLVResponseSize );
       require_action( outTLVResponse, exit, err = kNoMemoryErr );
 
-      tlvPtr = outTLVResponse;
-      *tlvPtr++ = kTLVType_Signature;
-      *tlvPtr++ = MFiProofLen;
-      memcpy(tlvPtr, MFiProof, MFiProofLen);
-      tlvPtr+= MFiProofLen;
-
-      j = outCertificateLen/kHATLV_MaxStringSize;
-      for(i = 0; i < j; i++){
-        *tlvPtr++ = kTLVType_Certificate;
-        *tlvPtr++ = kHATLV_MaxStringSize;
-        memcpy( tlvPtr, outCertificatePtr+i*kHATLV_MaxStringSize, kHATLV_MaxStringSize );
-        tlvPtr += kHATLV_MaxStringSize;
-      }
-
-      *tlvPtr++ = kTLVType_Certificate;
-      *tlvPtr++ = outCertificateLen%kHATLV_MaxStringSize;
-      memcpy( tlvPtr, outCertificatePtr+kHATLV_MaxStringSize*j, outCertificateLen%kHATLV_MaxStringSize );
-      tlvPtr += outCertificateLen%kHATLV_MaxStringSize;  
+      err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_Signature, MFiProof, MFiProofLen );
+      require_noerr( err, exit );
+      err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_Certificate, outCertificatePtr, outCertificateLen );
+      require_noerr( err, exit );
   
-      encryptedData = calloc(outTLVResponseLen + 16, sizeof(uint8_t));
+      encryptedData = malloc( outTLVResponseLen + crypto_aead_chacha20poly1305_ABYTES );
       require_action(encryptedData, exit, err = kNoMemoryErr);
 
       err =  crypto_aead_chacha20poly1305_encrypt(encryptedData, &encryptedDataLen, outTLVResponse, outTLVResponseLen,
@@ -560,56 +524,33 @@ OSStatus _HandleState_HandleSRPVerifyRespond(int inFd, pairInfo_t* inInfo, mico_
     }
 
     outTLVResponseLen = 0;
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-    outTLVResponseLen += inInfo->SRPServer->len_AMK + kHATLV_TypeLengthSize;
-    if(inContext->appStatus.useMFiAuth == true){
-      for(i = encryptedDataLen/kHATLV_MaxStringSize; i>0; i--)
-        outTLVResponseLen += kHATLV_MaxStringSize + kHATLV_TypeLengthSize;
-      outTLVResponseLen += encryptedDataLen%kHATLV_MaxStringSize + kHATLV_TypeLengthSize;
-    }
+    outTLVResponseSize = TLV8ItemSize(sizeof(uint8_t)) + TLV8ItemSize(len_HAMK);
+    if(inContext->appStatus.useMFiAuth == true)
+      outTLVResponseSize += TLV8ItemSize(encryptedDataLen);
 
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
+    outTLVResponse = malloc( outTLVResponseSize );
     require_action( outTLVResponse, exit, err = kNoMemoryErr );
 
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M4_SRPVerifyRespond;
+    err = TLVAppendUInt8( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_State, eState_M4_SRPVerifyRespond );
+    require_noerr( err, exit );
 
-    *tlvPtr++ = kTLVType_Proof;
-    *tlvPtr++ = inInfo->SRPServer->len_AMK;
-    memcpy( tlvPtr, bytes_HAMK, inInfo->SRPServer->len_AMK );
-    tlvPtr += inInfo->SRPServer->len_AMK;
+    err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_Proof, bytes_HAMK, len_HAMK );
+    require_noerr( err, exit );
 
     if(inContext->appStatus.useMFiAuth == true){
-      j = encryptedDataLen/kHATLV_MaxStringSize;
-      for(i = 0; i < j; i++){
-        *tlvPtr++ = kTLVType_EncryptedData;
-        *tlvPtr++ = kHATLV_MaxStringSize;
-        memcpy( tlvPtr, encryptedData+i*kHATLV_MaxStringSize, kHATLV_MaxStringSize );
-        tlvPtr += kHATLV_MaxStringSize;
-      }
-
-      *tlvPtr++ = kTLVType_EncryptedData;
-      *tlvPtr++ = encryptedDataLen%kHATLV_MaxStringSize;
-      memcpy( tlvPtr, encryptedData+kHATLV_MaxStringSize*j, encryptedDataLen%kHATLV_MaxStringSize );
-      tlvPtr += encryptedDataLen%kHATLV_MaxStringSize;
+      err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_EncryptedData, encryptedData, encryptedDataLen );
+      require_noerr( err, exit );
     }
 
     haPairSetupState = eState_M5_ExchangeRequest;
   }
 
-  err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, outTLVResponseLen, &httpResponse, &httpResponseLen );
-  require_noerr( err, exit );
-  err = SocketSend( inFd, httpResponse, httpResponseLen );
-  require_noerr( err, exit );
-  err = SocketSend(inFd, outTLVResponse, outTLVResponseLen);
+  err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
   require_noerr( err, exit );
 
 exit:
   if(outTLVResponse) free(outTLVResponse);
   if(encryptedData) free(encryptedData);
-  if(httpResponse) free(httpResponse);
   if(MFiProof) free(MFiProof);
   if(outCertificatePtr) free(outCertificatePtr);
 
@@ -621,46 +562,38 @@ OSStatus _HandleState_WaitingForExchangeRequest( HTTPHeader_t* inHeader, pairInf
 {
   pair_log_trace();
   UNUSED_PARAMETER(inContext);
-  const uint8_t *             src = (const uint8_t *) inHeader->extraDataPtr;
-  const uint8_t *             end = src + inHeader->extraDataLen;
+  uint8_t *                   src = (uint8_t *) inHeader->extraDataPtr;
+  uint8_t * const             end = src + inHeader->extraDataLen;
   uint8_t                     eid;
-  const uint8_t *             ptr;
+  uint8_t *                   ptr;
   size_t                      len;
-  char *                      tmp;
   OSStatus                    err = kNoErr;
-  unsigned char *             encryptedData = NULL;
-  unsigned long long          encryptedDataLen;
-  unsigned char *             authTag = NULL;
+  const uint8_t *             encryptedData = NULL;
+  size_t                      encryptedDataLen = 0;
 
-  unsigned char *             decryptedData = NULL;
+  uint8_t *                   decryptedData = NULL;
   unsigned long long          decryptedDataLen = 0;
 
-  char *                      controllerIdentifier = NULL;
+  char                        controllerIdentifier[kHKControllerIdentifierLen];
   size_t                      controllerIdentifierLen = 0;
-  uint8_t *                   controllerLTPK = NULL;
+  uint8_t                     controllerLTPK[kHKLTPKLen];
 
-  uint8_t *                   signature = NULL;
+  const uint8_t *             signature;
+  uint8_t *                   signedData = NULL;
 
   uint8_t                     signHKDF[32];
 
-  pair_list_in_flash_t        *pairList = NULL;
-
-  while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
+  /* Encrypted data is decrypted straight from the request buffer */
+  while( TLVGetNextInPlace( src, end, &eid, &ptr, &len, &src ) == kNoErr )
   {
 
     switch( eid )
     {
       case kTLVType_State:
-        tmp = calloc( len, sizeof( uint8_t ) );
-        require_action( tmp, exit, err = kNoMemoryErr );
-        memcpy( tmp, ptr, len );
-        require_action(haPairSetupState == *(uint8_t *)tmp, exit, err = kStateErr);
-        free(tmp);
+        require_action(len == sizeof(uint8_t) && haPairSetupState == *ptr, exit, err = kStateErr);
       break;
       case kTLVType_EncryptedData:
-        encryptedData = calloc( len, sizeof( uint8_t ) );
-        require_action( encryptedData, exit, err = kNoMemoryErr );
-        memcpy( encryptedData, ptr, len );
+        encryptedData = ptr;
         encryptedDataLen = len;
         break;
       default:
@@ -668,6 +601,7 @@ OSStatus _HandleState_WaitingForExchangeRequest( HTTPHeader_t* inHeader, pairInf
         break;
     }
   }
+  require_action( encryptedDataLen > crypto_aead_chacha20poly1305_ABYTES, exit, err = kMalformedErr );
 
   decryptedData = malloc( encryptedDataLen-crypto_aead_chacha20poly1305_ABYTES );
   require_action(decryptedData, exit, err = kNoMemoryErr);
@@ -676,51 +610,32 @@ OSStatus _HandleState_WaitingForExchangeRequest( HTTPHeader_t* inHeader, pairInf
                                               (const unsigned char *)AEAD_Nonce_Setup05, (const unsigned char *)inInfo->HKDF_Key);
   require_noerr_action(err, exit, pair_log("crypto_aead_chacha20poly1305_decrypt failed"));
 
-  free(encryptedData);
-  encryptedData = NULL;
-
   /* Parse sub-tlv */ 
-  src = (const uint8_t *) decryptedData;
-  end = src + decryptedDataLen;
-  while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
-  {
-    tmp = calloc( len + 1, sizeof( uint8_t ) ); // +1 can give an end to a C string
-    require_action( tmp, exit, err = kNoMemoryErr );
-    memcpy( tmp, ptr, len );
+  err = TLVCopy( decryptedData, decryptedData + decryptedDataLen, kTLVType_Identifier,
+                 controllerIdentifier, sizeof(controllerIdentifier) - 1, &controllerIdentifierLen );
+  require_noerr_action( err, exit, err = kMalformedErr );
+  controllerIdentifier[controllerIdentifierLen] = 0x0; // give an end to the C string
 
-    switch( eid )
-    {
-      case kTLVType_Identifier:
-        controllerIdentifier = tmp;
-        controllerIdentifierLen = len;
-        break;
-      case kTLVType_PublicKey:
-        controllerLTPK = (uint8_t *)tmp;
-        break;
-      case kTLVType_Signature:
-        signature = (uint8_t *)tmp;
-        break;
-      default:
-        pair_log( "Warning: Ignoring unsupported pair setup EID 0x%02X", eid );
-        break;
-    }
-  }  
+  err = TLVCopy( decryptedData, decryptedData + decryptedDataLen, kTLVType_PublicKey, controllerLTPK, sizeof(controllerLTPK), &len );
+  require_action( err == kNoErr && len == kHKLTPKLen, exit, err = kMalformedErr );
 
-  free(decryptedData);
-  decryptedData = NULL;
+  err = TLVFind( decryptedData, decryptedData + decryptedDataLen, kTLVType_Signature, &signature, &len );
+  require_action( err == kNoErr && len == 64, exit, err = kMalformedErr );
 
   /* Check aead sign */
   err = hkdf(SHA512,  (const unsigned char *)hkdfSetupCSignSalt, strlen(hkdfSetupCSignSalt),
-                      inInfo->SRPServer->session_key, inInfo->SRPServer->len_session_key,
+                      inInfo->SRPSessionKey, inInfo->SRPSessionKeyLen,
                       (const unsigned char *)hkdfSetupCSignInfo, strlen(hkdfSetupCSignInfo), signHKDF, 32);
   require_noerr(err, exit);  
 
-  signature = realloc(signature, 64 + 32 + controllerIdentifierLen + 32);
-  memcpy(signature+64,    signHKDF, 32);
-  memcpy(signature+64+32, controllerIdentifier, controllerIdentifierLen);
-  memcpy(signature+64+32+controllerIdentifierLen, controllerLTPK, 32);
+  signedData = malloc(64 + 32 + controllerIdentifierLen + 32);
+  require_action(signedData, exit, err = kNoMemoryErr);
+  memcpy(signedData,       signature, 64);
+  memcpy(signedData+64,    signHKDF, 32);
+  memcpy(signedData+64+32, controllerIdentifier, controllerIdentifierLen);
+  memcpy(signedData+64+32+controllerIdentifierLen, controllerLTPK, 32);
 
-  err = crypto_sign_open(NULL, NULL, signature, 64 + 32 + controllerIdentifierLen + 32, controllerLTPK);
+  err = crypto_sign_open(NULL, NULL, signedData, 64 + 32 + controllerIdentifierLen + 32, controllerLTPK);
   require_noerr_string(err, exit, "Signature verify failed");
 
   /* Insert pair info */
@@ -730,13 +645,8 @@ OSStatus _HandleState_WaitingForExchangeRequest( HTTPHeader_t* inHeader, pairInf
   haPairSetupState = eState_M6_ExchangeRespond;
 
 exit:
-  if(encryptedData) free(encryptedData);
   if(decryptedData) free(decryptedData);
-  if(controllerIdentifier) free(controllerIdentifier);
-  if(controllerLTPK) free(controllerLTPK);
-  if(signature) free(signature);
-  if(authTag) free(authTag);
-  if(pairList) free(pairList);
+  if(signedData) free(signedData);
   return err; 
 }
 
@@ -745,14 +655,16 @@ OSStatus _HandleState_HandleExchangeRespond(int inFd, pairInfo_t** inInfo, mico_
   pair_log_trace();
   OSStatus err = kNoErr;
   uint8_t *outTLVResponse = NULL;
+  size_t outTLVResponseSize;
   size_t outTLVResponseLen = 0;
-  uint8_t *tlvPtr;
+  uint8_t errorTLV[TLV8ItemSize(sizeof(uint8_t))];
+  uint8_t subTLV[TLV8ItemSize(kHKControllerIdentifierLen) + TLV8ItemSize(32) + TLV8ItemSize(64)];
+  size_t subTLVLen = 0;
 
-  uint8_t *httpResponse = NULL;
-  size_t httpResponseLen = 0;
   uint8_t  signHKDF[32];
   uint8_t LTPK[32];
-  unsigned char *       encryptedData = NULL;
+  uint8_t LTPKSeed[crypto_sign_SEEDBYTES];
+  uint8_t *encryptedData;
   unsigned long long  encryptedDataLen;
   uint8_t *signature = NULL;
   unsigned long long signatureLen;
@@ -763,28 +675,29 @@ OSStatus _HandleState_HandleExchangeRespond(int inFd, pairInfo_t** inInfo, mico_
   if((*inInfo)->pairListFull == true){
     pair_log("Pair list is full!");
 
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_Error;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = kTLVError_MaxPeers;
+    err = TLVAppendUInt8( errorTLV, sizeof(errorTLV), &outTLVResponseLen, kTLVType_Error, kTLVError_MaxPeers );
+    require_noerr( err, exit );
     pair_log("Send: kTLVType_Status: 0x%x", kTLVError_MaxPeers);
+
+    err = _HKSendTLVResponse( inFd, errorTLV, outTLVResponseLen );
+    require_noerr( err, exit );
   }else{
 
     if(inContext->flashContentInRam.appConfig.haPairSetupFinished){
       memcpy(LTPK, inContext->flashContentInRam.appConfig.LTSK + 32, 32);
     }else{
-      err = crypto_sign_keypair(LTPK, inContext->flashContentInRam.appConfig.LTSK);
+      /* Ed25519 seed from the DRBG rather than the library's own read of the platform RNG */
+      err = RandomBytes(LTPKSeed, sizeof(LTPKSeed));
+      require_noerr(err, exit);
+      err = crypto_sign_seed_keypair(LTPK, inContext->flashContentInRam.appConfig.LTSK, LTPKSeed);
+      memzero_secure(LTPKSeed, sizeof(LTPKSeed));
       require_noerr(err, exit);     
     }
 
     accessoryName = __strdup_trans_dot(inContext->micoStatus.mac);
 
     err = hkdf(SHA512,  (const unsigned char *)hkdfSetupASignSalt, strlen(hkdfSetupASignSalt),
-                      (*inInfo)->SRPServer->session_key, (*inInfo)->SRPServer->len_session_key,
+                      (*inInfo)->SRPSessionKey, (*inInfo)->SRPSessionKeyLen,
                       (const unsigned char *)hkdfSetupASignInfo, strlen(hkdfSetupASignInfo), signHKDF, 32);
     require_noerr(err, exit);  
 
@@ -806,69 +719,42 @@ OSStatus _HandleState_HandleExchangeRespond(int inFd, pairInfo_t** inInfo, mico_
     require_string(signatureLen == 64+XYZLen, exit, "crypto sign failed");
 
     /* Build sub-tlv: identifier, LTPK and signature */
-    outTLVResponseLen += strlen(accessoryName) + kHATLV_TypeLengthSize; //identifier
-    outTLVResponseLen += 32 + kHATLV_TypeLengthSize;  //LTPK
-    outTLVResponseLen += 64 + kHATLV_TypeLengthSize;  //signature
-
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_Identifier;
-    *tlvPtr++ = strlen(accessoryName);
-    memcpy( tlvPtr, accessoryName, strlen(accessoryName) );
-    tlvPtr += strlen(accessoryName);
+    err = TLVAppend( subTLV, sizeof(subTLV), &subTLVLen, kTLVType_Identifier, accessoryName, strlen(accessoryName) );
+    require_noerr( err, exit );
     free(accessoryName);
     accessoryName = NULL;
 
-    *tlvPtr++ = kTLVType_PublicKey;
-    *tlvPtr++ = 32;
-    memcpy( tlvPtr, LTPK, 32 );
-    tlvPtr += 32;
+    err = TLVAppend( subTLV, sizeof(subTLV), &subTLVLen, kTLVType_PublicKey, LTPK, 32 );
+    require_noerr( err, exit );
+
+    err = TLVAppend( subTLV, sizeof(subTLV), &subTLVLen, kTLVType_Signature, signature, 64 );
+    require_noerr( err, exit );
 
-    *tlvPtr++ = kTLVType_Signature;
-    *tlvPtr++ = 64;
-    memcpy( tlvPtr, signature, 64 );
+    /* Build tlv: state and encrypted data, the sub-tlv is encrypted straight into the response */
+    outTLVResponseSize = TLV8ItemSize(sizeof(uint8_t)) + TLV8ItemSize(subTLVLen + crypto_aead_chacha20poly1305_ABYTES);
+    outTLVResponse = malloc( outTLVResponseSize );
+    require_action( outTLVResponse, exit, err = kNoMemoryErr );
 
-    encryptedData = calloc(outTLVResponseLen + 16, sizeof(uint8_t));
+    err = TLVAppendUInt8( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_State, eState_M6_ExchangeRespond );
+    require_noerr( err, exit );
+    err = TLVAppendReserve( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_EncryptedData,
+                            subTLVLen + crypto_aead_chacha20poly1305_ABYTES, &encryptedData );
+    require_noerr( err, exit );
 
     require_action((*inInfo)->HKDF_Key, exit, err = kParamErr);
-    err =  crypto_aead_chacha20poly1305_encrypt(encryptedData, &encryptedDataLen, outTLVResponse, outTLVResponseLen,
+    err =  crypto_aead_chacha20poly1305_encrypt(encryptedData, &encryptedDataLen, subTLV, subTLVLen,
                                                 NULL, 0, NULL, (const unsigned char *)AEAD_Nonce_Setup06,
                                                 (const unsigned char *)(*inInfo)->HKDF_Key);
 
     require_noerr_action(err, exit, pair_log("crypto_aead_chacha20poly1305_encrypt failed"));
-    require_action(encryptedDataLen - crypto_aead_chacha20poly1305_ABYTES == outTLVResponseLen, exit, pair_log("encryptedDataLen is not properly set"));
-    free(outTLVResponse);
-    outTLVResponse = NULL;
-
-    /* Build tlv: state and encrypted data */
-    outTLVResponseLen = 0;
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-    outTLVResponseLen += encryptedDataLen + kHATLV_TypeLengthSize;
-
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M6_ExchangeRespond;
+    require_action(encryptedDataLen - crypto_aead_chacha20poly1305_ABYTES == subTLVLen, exit, pair_log("encryptedDataLen is not properly set"));
 
-    *tlvPtr++ = kTLVType_EncryptedData;
-    *tlvPtr++ = encryptedDataLen;
-    memcpy( tlvPtr, encryptedData, encryptedDataLen);
+    err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
+    require_noerr( err, exit );
   }
 
   haPairSetupState = eState_M1_SRPStartRequest;
 
-  err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, outTLVResponseLen, &httpResponse, &httpResponseLen );
-  require_noerr( err, exit );
-  err = SocketSend( inFd, httpResponse, httpResponseLen );
-  require_noerr( err, exit );
-  err = SocketSend(inFd, outTLVResponse, outTLVResponseLen);
-  require_noerr( err, exit );
-
   /*Save accessory's LPSK*/
   if((*inInfo)->pairListFull != true){
     inContext->flashContentInRam.appConfig.haPairSetupFinished = true;
@@ -881,11 +767,9 @@ OSStatus _HandleState_HandleExchangeRespond(int inFd, pairInfo_t** inInfo, mico_
 
 exit:
   if(outTLVResponse) free(outTLVResponse);
-  if(httpResponse) free(httpResponse);
   if(signature) free(signature);
   if(accessoryName) free(accessoryName);
   if(XYZ) free(XYZ);
-  if(encryptedData) free(encryptedData);
   return err;
 
 }
@@ -898,8 +782,18 @@ OSStatus HKPairVerifyEngine( int inFd, HTTPHeader_t* inHeader, pairVerifyInfo_t*
 
   switch ( inInfo->haPairVerifyState ){
     case eState_M1_VerifyStartRequest:
+      inInfo->startTime = mico_get_time();
       err = _HandleState_WaitingForVerifyStartRequest( inHeader, inInfo, inContext );
       require_noerr_action( err, exit, inInfo->haPairVerifyState = eState_M1_VerifyStartRequest);
+      if( inInfo->method == Pair_Resume ){
+        HKPairVerifyRecordResumeRequest( );
+        if( _HandleState_HandleResumeRespond( inFd, inInfo, inContext ) == kNoErr ){
+          HKPairVerifyRecordHandshake( true, mico_get_time() - inInfo->startTime );
+          break;
+        }
+        /* Unknown or expired session, the controller's public key is used for a full pair verify */
+        pair_log( "Pair resume rejected, continue with pair verify" );
+      }
       err =  _HandleState_WaitingForVerifyStartRespond( inFd , inInfo, inContext );
       require_noerr_action( err, exit, inInfo->haPairVerifyState = eState_M1_VerifyStartRequest);
       break;
@@ -930,28 +824,46 @@ OSStatus _HandleState_WaitingForVerifyStartRequest( HTTPHeader_t* inHeader, pair
   uint8_t                     eid;
   const uint8_t *             ptr;
   size_t                      len;
-  char *                      tmp = NULL;
 
+  /* Only the values kept in pairVerifyInfo_t are copied */
   while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
   {
-    tmp = calloc( len+1, sizeof( uint8_t ) );
-    require_action( tmp, exit, err = kNoMemoryErr );
-    memcpy( tmp, ptr, len );
-
     switch( eid )
     {
       case kTLVType_State:
-        require_action(inInfo->haPairVerifyState == *(uint8_t *)tmp, exit, err = kStateErr);
-        free(tmp);
+        require_action(len == sizeof(uint8_t) && inInfo->haPairVerifyState == *ptr, exit, err = kStateErr);
         break;
       case kTLVType_PublicKey:
-        inInfo->pControllerCurve25519PK = (uint8_t *)tmp;
+        require_action(len == 32 && inInfo->pControllerCurve25519PK == NULL, exit, err = kMalformedErr);
+        inInfo->pControllerCurve25519PK = malloc( len );
+        require_action( inInfo->pControllerCurve25519PK, exit, err = kNoMemoryErr );
+        memcpy( inInfo->pControllerCurve25519PK, ptr, len );
+        break;
+      case kTLVType_Method:
+        require_action(len == sizeof(uint8_t), exit, err = kMalformedErr);
+        inInfo->method = *ptr;
+        break;
+      case kTLVType_SessionID:
+        if( len == kHKResumeSessionIDLen && inInfo->pResumeSessionID == NULL ){
+          inInfo->pResumeSessionID = malloc( len );
+          require_action( inInfo->pResumeSessionID, exit, err = kNoMemoryErr );
+          memcpy( inInfo->pResumeSessionID, ptr, len );
+        }
+        break;
+      case kTLVType_EncryptedData:
+        if( len && inInfo->pResumeRequestData == NULL ){
+          inInfo->pResumeRequestData = malloc( len );
+          require_action( inInfo->pResumeRequestData, exit, err = kNoMemoryErr );
+          memcpy( inInfo->pResumeRequestData, ptr, len );
+          inInfo->resumeRequestDataLen = len;
+        }
         break;
       default:
         pair_log( "Warning: Ignoring unsupported pair setup EID 0x%02X", eid );
         break;
     }
   }
+  require_action( inInfo->pControllerCurve25519PK, exit, err = kMalformedErr );
   inInfo->haPairVerifyState = eState_M2_VerifyStartRespond;
 
 exit:
@@ -963,15 +875,15 @@ OSStatus _HandleState_WaitingForVerifyStartRespond(int inFd, pairVerifyInfo_t* i
   pair_log_trace();
   OSStatus            err = kNoErr;
   uint8_t             *outTLVResponse = NULL;
+  size_t              outTLVResponseSize;
   size_t              outTLVResponseLen = 0;
-  uint8_t             *tlvPtr;
-  uint8_t             *httpResponse = NULL;
-  size_t              httpResponseLen = 0;
+  uint8_t             subTLV[TLV8ItemSize(kHKControllerIdentifierLen) + TLV8ItemSize(64)];
+  size_t              subTLVLen = 0;
   uint8_t             *ABC = NULL;
   size_t              ABCLen = 0;
   uint8_t             *signature = NULL;
   unsigned long long  signatureLen = 0;
-  unsigned char       *encryptedData = NULL;
+  uint8_t             *encryptedData;
   unsigned long long  encryptedDataLen = 0;
   char                *accessoryName = NULL;
 
@@ -986,7 +898,7 @@ OSStatus _HandleState_WaitingForVerifyStartRespond(int inFd, pairVerifyInfo_t* i
 
 
   /* Generate new, random Curve25519 key pair */
-  err = PlatformRandomBytes( inInfo->pAccessoryCurve25519SK, 32 );
+  err = RandomBytes( inInfo->pAccessoryCurve25519SK, 32 );
   require_noerr( err, exit );
   curve25519_donna( inInfo->pAccessoryCurve25519PK, inInfo->pAccessoryCurve25519SK, NULL );
 
@@ -1014,24 +926,13 @@ OSStatus _HandleState_WaitingForVerifyStartRespond(int inFd, pairVerifyInfo_t* i
   ABC = NULL;
 
   /* Build sub-TLV */
-  outTLVResponseLen = 0;
-  outTLVResponseLen += strlen(accessoryName) + kHATLV_TypeLengthSize;
-  outTLVResponseLen += 64 + kHATLV_TypeLengthSize;
-
-  outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-  require_action( outTLVResponse, exit, err = kNoMemoryErr );
-  tlvPtr = outTLVResponse;
-
-  *tlvPtr++ = kTLVType_Identifier;
-  *tlvPtr++ = strlen(accessoryName);
-  memcpy(tlvPtr, accessoryName, strlen(accessoryName));
-  tlvPtr += strlen(accessoryName);
+  err = TLVAppend( subTLV, sizeof(subTLV), &subTLVLen, kTLVType_Identifier, accessoryName, strlen(accessoryName) );
+  require_noerr( err, exit );
   free(accessoryName);
   accessoryName = NULL;
 
-  *tlvPtr++ = kTLVType_Signature;
-  *tlvPtr++ = 64;
-  memcpy( tlvPtr, signature, 64 );
+  err = TLVAppend( subTLV, sizeof(subTLV), &subTLVLen, kTLVType_Signature, signature, 64 );
+  require_noerr( err, exit );
   free(signature);
   signature = NULL;
 
@@ -1041,47 +942,27 @@ OSStatus _HandleState_WaitingForVerifyStartRespond(int inFd, pairVerifyInfo_t* i
                       (const unsigned char *)hkdfVerifyInfo, strlen(hkdfVerifyInfo), inInfo->pHKDFKey, 32);
   require_noerr_string(err, exit, "Generate HKDK key failed");
 
-  /* Encrypt sub-TLV and generate an auth tag*/
-  encryptedData = calloc(outTLVResponseLen+16, sizeof(uint8_t));
-  require_action(encryptedData, exit, err = kNoMemoryErr);
+  /* Respond with TLV item, the sub-TLV is encrypted straight into it with an auth tag */
+  outTLVResponseSize = TLV8ItemSize(sizeof(uint8_t)) + TLV8ItemSize(32) + TLV8ItemSize(subTLVLen + crypto_aead_chacha20poly1305_ABYTES);
+  outTLVResponse = malloc( outTLVResponseSize );
+  require_action( outTLVResponse, exit, err = kNoMemoryErr );
+
+  err = TLVAppendUInt8( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_State, eState_M2_VerifyStartRespond );
+  require_noerr( err, exit );
+  err = TLVAppend( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_PublicKey, inInfo->pAccessoryCurve25519PK, 32 );
+  require_noerr( err, exit );
+  err = TLVAppendReserve( outTLVResponse, outTLVResponseSize, &outTLVResponseLen, kTLVType_EncryptedData,
+                          subTLVLen + crypto_aead_chacha20poly1305_ABYTES, &encryptedData );
+  require_noerr( err, exit );
 
-  err =  crypto_aead_chacha20poly1305_encrypt(encryptedData, &encryptedDataLen, outTLVResponse, outTLVResponseLen,
+  err =  crypto_aead_chacha20poly1305_encrypt(encryptedData, &encryptedDataLen, subTLV, subTLVLen,
                                               NULL, 0, NULL, (const unsigned char *)AEAD_Nonce_Verify02,
                                               (const unsigned char *)inInfo->pHKDFKey);
 
   require_noerr_action(err, exit, pair_log("crypto_aead_chacha20poly1305_encrypt failed"));
-  require_action(encryptedDataLen - crypto_aead_chacha20poly1305_ABYTES == outTLVResponseLen, exit, pair_log("encryptedDataLen is not properly set"));
-  free(outTLVResponse);
-  outTLVResponse = NULL;
-
-  /* Respond with TLV item */
-  outTLVResponseLen = 0;
-  outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-  outTLVResponseLen += 32 + kHATLV_TypeLengthSize;
-  outTLVResponseLen += encryptedDataLen + kHATLV_TypeLengthSize;
-
-  outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-  require_action( outTLVResponse, exit, err = kNoMemoryErr );
+  require_action(encryptedDataLen - crypto_aead_chacha20poly1305_ABYTES == subTLVLen, exit, pair_log("encryptedDataLen is not properly set"));
 
-  tlvPtr = outTLVResponse;
-  *tlvPtr++ = kTLVType_State;
-  *tlvPtr++ = sizeof(uint8_t);
-  *tlvPtr++ = eState_M2_VerifyStartRespond;
-
-  *tlvPtr++ = kTLVType_PublicKey;
-  *tlvPtr++ = 32;
-  memcpy( tlvPtr, inInfo->pAccessoryCurve25519PK, 32);
-  tlvPtr += 32;
-
-  *tlvPtr++ = kTLVType_EncryptedData;
-  *tlvPtr++ = encryptedDataLen;
-  memcpy( tlvPtr, encryptedData, encryptedDataLen );
-
-  err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, outTLVResponseLen, &httpResponse, &httpResponseLen );
-  require_noerr( err, exit );
-  err = SocketSend( inFd, httpResponse, httpResponseLen );
-  require_noerr( err, exit );
-  err = SocketSend(inFd, outTLVResponse, outTLVResponseLen);
+  err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
   require_noerr( err, exit );
   inInfo->haPairVerifyState = eState_M3_VerifyFinishRequest;
 
@@ -1089,9 +970,7 @@ exit:
   if(accessoryName) free(accessoryName);
   if(ABC) free(ABC);
   if(signature) free(signature);
-  if(encryptedData) free(encryptedData);
   if(outTLVResponse) free(outTLVResponse);
-  if(httpResponse) free(httpResponse);
   return err;
 }
 
@@ -1100,34 +979,30 @@ OSStatus _HandleState_WaitingForVerifyFinishRequest(HTTPHeader_t* inHeader, pair
   pair_log_trace();
   OSStatus                    err = kNoErr;
   (void)                      inContext;
-  const uint8_t *             src = (const uint8_t *) inHeader->extraDataPtr;
-  const uint8_t *             end = src + inHeader->extraDataLen;
+  uint8_t *                   src = (uint8_t *) inHeader->extraDataPtr;
+  uint8_t * const             end = src + inHeader->extraDataLen;
   uint8_t                     eid;
-  const uint8_t *             ptr;
+  uint8_t *                   ptr;
   size_t                      len;
-  char *                      tmp = NULL;
-  uint8_t *                   encryptedData = NULL;
+  const uint8_t *             encryptedData = NULL;
   size_t                      encryptedDataLen = 0;
   uint8_t *                   decryptedData = NULL;
   unsigned long long          decryptedDataLen = 0;
-  uint8_t *                   signature = NULL;
-  char *                      controllerIdentifier = NULL;
+  const uint8_t *             signature;
+  uint8_t *                   signedData = NULL;
+  const uint8_t *             controllerIdentifier;
   size_t                      controllerIdentifierLen = 0;
 
-  while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
+  /* Encrypted data is decrypted straight from the request buffer */
+  while( TLVGetNextInPlace( src, end, &eid, &ptr, &len, &src ) == kNoErr )
   {
-    tmp = calloc( len, sizeof( uint8_t ) );
-    require_action( tmp, exit, err = kNoMemoryErr );
-    memcpy( tmp, ptr, len );
-
     switch( eid )
     {
       case kTLVType_State:
-        require_action(inInfo->haPairVerifyState == *(uint8_t *)tmp, exit, err = kStateErr);
-        free(tmp);
+        require_action(len == sizeof(uint8_t) && inInfo->haPairVerifyState == *ptr, exit, err = kStateErr);
         break;
       case kTLVType_EncryptedData:
-        encryptedData = (uint8_t *)tmp;
+        encryptedData = ptr;
         encryptedDataLen = len;
         break;
       default:
@@ -1135,6 +1010,7 @@ OSStatus _HandleState_WaitingForVerifyFinishRequest(HTTPHeader_t* inHeader, pair
         break;
     }
   }
+  require_action( encryptedDataLen > crypto_aead_chacha20poly1305_ABYTES, exit, err = kMalformedErr );
 
   decryptedData = malloc( encryptedDataLen-crypto_aead_chacha20poly1305_ABYTES );
   require_action(decryptedData, exit, err = kNoMemoryErr);
@@ -1143,73 +1019,40 @@ OSStatus _HandleState_WaitingForVerifyFinishRequest(HTTPHeader_t* inHeader, pair
                                               (const unsigned char *)AEAD_Nonce_Verify03, (const unsigned char *)inInfo->pHKDFKey);
   require_noerr_action(err, exit, pair_log("crypto_aead_chacha20poly1305_decrypt failed"));
 
-  src = (const uint8_t *) decryptedData;
-  end = src + decryptedDataLen;
-  while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
-  {
-    tmp = calloc( len+1, sizeof( uint8_t ) ); //+1 to give an end to C string
-    require_action( tmp, exit, err = kNoMemoryErr );
-    memcpy( tmp, ptr, len );
-
-    switch( eid )
-    {
-      case kTLVType_Identifier:
-        controllerIdentifier = tmp;
-        inInfo->pControllerLTPK = HMFindLTPK(controllerIdentifier);
-        inInfo->pControllerIdentifier = malloc(len+1);
-        memcpy(inInfo->pControllerIdentifier, tmp, len+1);
-        controllerIdentifierLen = len;
-        break;
-      case kTLVType_Signature:
-        signature = (uint8_t *)tmp;
-        break;
-      default:
-        pair_log( "Warning: Ignoring unsupported pair setup EID 0x%02X", eid );
-        break;
-    }
-  }
-
-  signature = realloc(signature, 64 + 32 + controllerIdentifierLen + 32);
-  require_action(signature, exit, err=kNoMemoryErr);
-  memcpy(signature+64,                            inInfo->pControllerCurve25519PK,  32);
-  memcpy(signature+64+32,                         controllerIdentifier,             controllerIdentifierLen);
-  memcpy(signature+64+32+controllerIdentifierLen, inInfo->pAccessoryCurve25519PK,   32);
-
-  err = crypto_sign_open(NULL, NULL, signature, 64 + 32 + controllerIdentifierLen + 32, inInfo->pControllerLTPK);
+  err = TLVFind( decryptedData, decryptedData + decryptedDataLen, kTLVType_Identifier, &controllerIdentifier, &controllerIdentifierLen );
+  require_action( err == kNoErr && controllerIdentifierLen < kHKControllerIdentifierLen, exit, err = kMalformedErr );
+  inInfo->pControllerIdentifier = malloc(controllerIdentifierLen+1);
+  require_action(inInfo->pControllerIdentifier, exit, err = kNoMemoryErr);
+  memcpy(inInfo->pControllerIdentifier, controllerIdentifier, controllerIdentifierLen);
+  inInfo->pControllerIdentifier[controllerIdentifierLen] = 0x0; //give an end to C string
+  inInfo->pControllerLTPK = HMFindLTPK(inInfo->pControllerIdentifier);
+
+  err = TLVFind( decryptedData, decryptedData + decryptedDataLen, kTLVType_Signature, &signature, &len );
+  require_action( err == kNoErr && len == 64, exit, err = kMalformedErr );
+
+  signedData = malloc(64 + 32 + controllerIdentifierLen + 32);
+  require_action(signedData, exit, err=kNoMemoryErr);
+  memcpy(signedData,                               signature,                        64);
+  memcpy(signedData+64,                            inInfo->pControllerCurve25519PK,  32);
+  memcpy(signedData+64+32,                         controllerIdentifier,             controllerIdentifierLen);
+  memcpy(signedData+64+32+controllerIdentifierLen, inInfo->pAccessoryCurve25519PK,   32);
+
+  require_action_string(inInfo->pControllerLTPK, exit, err = kNotFoundErr, "Controller is not paired");
+  err = crypto_sign_open(NULL, NULL, signedData, 64 + 32 + controllerIdentifierLen + 32, inInfo->pControllerLTPK);
   require_noerr_string(err, exit, "Signature verify failed");
   pair_log("Signature verify success");
+  HKLTPKCacheInsert(inInfo->pControllerIdentifier, inInfo->pControllerLTPK);
 
 exit:
-  if(encryptedData) free(encryptedData);
   if(decryptedData) free(decryptedData);
-  if(controllerIdentifier) free(controllerIdentifier);
-  if(signature) free(signature);
+  if(signedData) free(signedData);
   return err;
 }
 
-OSStatus _HandleState_WaitingForVerifyFinishRespond(int inFd, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext)
+static OSStatus _HKDeriveControlKeys(pairVerifyInfo_t* inInfo)
 {
-  pair_log_trace();
   OSStatus err = kNoErr;
-  (void)inContext;
-  uint8_t *outTLVResponse = NULL;
-  size_t outTLVResponseLen = 0;
-  uint8_t *tlvPtr;
-
-  uint8_t *httpResponse = NULL;
-  size_t httpResponseLen = 0;
-
-  outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-  outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-  require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-  tlvPtr = outTLVResponse;
-  *tlvPtr++ = kTLVType_State;
-  *tlvPtr++ = sizeof(uint8_t);
-  *tlvPtr++ = eState_M4_SRPVerifyRespond;
 
-  inInfo->verifySuccess = true;
   inInfo->A2CKey = malloc(32);
   require_action(inInfo->A2CKey, exit, err = kNoMemoryErr);
   err = hkdf(SHA512,  (const unsigned char *) hkdfA2CKeySalt, strlen(hkdfA2CKeySalt),
@@ -1224,16 +1067,130 @@ OSStatus _HandleState_WaitingForVerifyFinishRespond(int inFd, pairVerifyInfo_t*
                             (const unsigned char *)hkdfC2AInfo, strlen(hkdfC2AInfo), inInfo->C2AKey, 32);
   require_noerr(err, exit);
 
-  err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_Pairing_TLV8, outTLVResponseLen, &httpResponse, &httpResponseLen );
+exit:
+  return err;
+}
+
+OSStatus _HandleState_WaitingForVerifyFinishRespond(int inFd, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext)
+{
+  pair_log_trace();
+  OSStatus err = kNoErr;
+  (void)inContext;
+  uint8_t outTLVResponse[TLV8ItemSize(sizeof(uint8_t))];
+  size_t outTLVResponseLen = 0;
+  uint8_t sessionID[kHKResumeSessionIDLen];
+
+  err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_State, eState_M4_SRPVerifyRespond );
   require_noerr( err, exit );
-  err = SocketSend( inFd, httpResponse, httpResponseLen );
+
+  inInfo->verifySuccess = true;
+  err = _HKDeriveControlKeys(inInfo);
+  require_noerr(err, exit);
+
+  err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
   require_noerr( err, exit );
-  err = SocketSend( inFd, outTLVResponse, outTLVResponseLen );
+
+  /* Both sides derive the same session ID, so the controller can resume without another key exchange */
+  if( hkdf(SHA512,  (const unsigned char *) hkdfResumeIDSalt, strlen(hkdfResumeIDSalt),
+                    inInfo->pSharedSecret, 32,
+                    (const unsigned char *)hkdfResumeIDInfo, strlen(hkdfResumeIDInfo), sessionID, kHKResumeSessionIDLen) == 0 )
+    HKResumeSessionSave(inInfo->pControllerIdentifier, sessionID, inInfo->pSharedSecret);
+  HKPairVerifyRecordHandshake( false, mico_get_time() - inInfo->startTime );
+
+exit:
+  return err;
+}
+
+/* Pair resume: the controller proves it holds the shared secret of a cached session with an empty
+   AEAD message, the accessory answers with a new session ID and both derive a fresh shared secret.
+   No Curve25519 or Ed25519 operation and no flash access is needed. */
+OSStatus _HandleState_HandleResumeRespond(int inFd, pairVerifyInfo_t* inInfo, mico_Context_t * const inContext)
+{
+  pair_log_trace();
+  OSStatus            err = kNoErr;
+  (void)              inContext;
+  char                controllerIdentifier[kHKControllerIdentifierLen];
+  uint8_t             sharedSecret[kHKSharedSecretLen];
+  uint8_t             newSessionID[kHKResumeSessionIDLen];
+  uint8_t             salt[32 + kHKResumeSessionIDLen];
+  uint8_t             key[32];
+  uint8_t             authTag[crypto_aead_chacha20poly1305_ABYTES];
+  unsigned long long  authTagLen = 0;
+  unsigned long long  emptyLen = 0;
+  uint8_t             outTLVResponse[2 * TLV8ItemSize(sizeof(uint8_t)) + TLV8ItemSize(kHKResumeSessionIDLen) +
+                                 TLV8ItemSize(crypto_aead_chacha20poly1305_ABYTES)];
+  size_t              outTLVResponseLen = 0;
+
+  require_action_quiet( inInfo->pResumeSessionID && inInfo->pResumeRequestData, exit, err = kParamErr );
+  require_action_quiet( inInfo->resumeRequestDataLen == crypto_aead_chacha20poly1305_ABYTES, exit, err = kSizeErr );
+
+  err = HKResumeSessionTake( inInfo->pResumeSessionID, controllerIdentifier, sharedSecret );
+  require_noerr_quiet( err, exit );
+  require_action_quiet( HMFindLTPK( controllerIdentifier ), exit, err = kNotFoundErr );
+
+  /* Check the request with the key derived from the cached secret */
+  memcpy( salt,      inInfo->pControllerCurve25519PK, 32 );
+  memcpy( salt + 32, inInfo->pResumeSessionID,        kHKResumeSessionIDLen );
+  err = hkdf(SHA512,  salt, sizeof(salt), sharedSecret, kHKSharedSecretLen,
+                      (const unsigned char *)hkdfResumeRequestInfo, strlen(hkdfResumeRequestInfo), key, 32);
+  require_noerr( err, exit );
+  err = crypto_aead_chacha20poly1305_decrypt( authTag, &emptyLen, NULL, inInfo->pResumeRequestData, inInfo->resumeRequestDataLen,
+                                              NULL, 0, (const unsigned char *)AEAD_Nonce_Resume01, key );
+  require_noerr_action( err, exit, err = kAuthenticationErr );
+
+  /* New session ID, response proof and the shared secret of the resumed session */
+  err = RandomBytes( newSessionID, kHKResumeSessionIDLen );
+  require_noerr( err, exit );
+  memcpy( salt + 32, newSessionID, kHKResumeSessionIDLen );
+  err = hkdf(SHA512,  salt, sizeof(salt), sharedSecret, kHKSharedSecretLen,
+                      (const unsigned char *)hkdfResumeRespondInfo, strlen(hkdfResumeRespondInfo), key, 32);
+  require_noerr( err, exit );
+  err = crypto_aead_chacha20poly1305_encrypt( authTag, &authTagLen, (const unsigned char *)"", 0, NULL, 0, NULL,
+                                              (const unsigned char *)AEAD_Nonce_Resume02, key );
+  require_noerr( err, exit );
+  require_action( authTagLen == crypto_aead_chacha20poly1305_ABYTES, exit, err = kSizeErr );
+
+  inInfo->pSharedSecret = malloc( kHKSharedSecretLen );
+  require_action( inInfo->pSharedSecret, exit, err = kNoMemoryErr );
+  err = hkdf(SHA512,  salt, sizeof(salt), sharedSecret, kHKSharedSecretLen,
+                      (const unsigned char *)hkdfResumeSecretInfo, strlen(hkdfResumeSecretInfo), inInfo->pSharedSecret, kHKSharedSecretLen);
+  require_noerr( err, exit );
+
+  inInfo->pControllerIdentifier = __strdup( controllerIdentifier );
+  require_action( inInfo->pControllerIdentifier, exit, err = kNoMemoryErr );
+  err = _HKDeriveControlKeys( inInfo );
   require_noerr( err, exit );
 
+  err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_State, eState_M2_VerifyStartRespond );
+  require_noerr( err, exit );
+  err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_Method, Pair_Resume );
+  require_noerr( err, exit );
+  err = TLVAppend( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_SessionID, newSessionID, kHKResumeSessionIDLen );
+  require_noerr( err, exit );
+  err = TLVAppend( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_EncryptedData, authTag, crypto_aead_chacha20poly1305_ABYTES );
+  require_noerr( err, exit );
+
+  err = _HKSendTLVResponse( inFd, outTLVResponse, outTLVResponseLen );
+  require_noerr( err, exit );
+
+  HKResumeSessionSave( controllerIdentifier, newSessionID, inInfo->pSharedSecret );
+  inInfo->verifySuccess = true;
+  pair_log( "Pair verify resumed" );
+
 exit:
-  if(outTLVResponse) free(outTLVResponse);
-  if(httpResponse) free(httpResponse);
+  if( err != kNoErr ){
+    /* Leave pairVerifyInfo_t as it was so a full pair verify can continue */
+    if(inInfo->pSharedSecret) { memzero_secure(inInfo->pSharedSecret, kHKSharedSecretLen); free(inInfo->pSharedSecret); }
+    if(inInfo->pControllerIdentifier) free(inInfo->pControllerIdentifier);
+    if(inInfo->A2CKey) { memzero_secure(inInfo->A2CKey, 32); free(inInfo->A2CKey); }
+    if(inInfo->C2AKey) { memzero_secure(inInfo->C2AKey, 32); free(inInfo->C2AKey); }
+    inInfo->pSharedSecret = NULL;
+    inInfo->pControllerIdentifier = NULL;
+    inInfo->A2CKey = NULL;
+    inInfo->C2AKey = NULL;
+  }
+  memzero_secure( sharedSecret, sizeof(sharedSecret) );
+  memzero_secure( key, sizeof(key) );
   return err;
 }
 
@@ -1244,6 +1201,7 @@ OSStatus HKSendPairResponseMessage(int sockfd, int status, uint8_t *payload, int
   size_t httpResponseLen = 0;
   const char *buffer = NULL;
   int bufferLen;
+  iovec_t iov[2];
 
   buffer = (const char *)payload;
   bufferLen = payloadLen;
@@ -1253,164 +1211,149 @@ OSStatus HKSendPairResponseMessage(int sockfd, int status, uint8_t *payload, int
   require_noerr( err, exit );
   require( httpResponse, exit );
 
-  err = HKSecureSocketSend( sockfd, httpResponse, httpResponseLen, session );
+  iov[0].iov_base = httpResponse;
+  iov[0].iov_len = httpResponseLen;
+  iov[1].iov_base = buffer;
+  iov[1].iov_len = bufferLen;
+  err = HKSecureSocketSendv( sockfd, iov, bufferLen? 2:1, session );
   require_noerr( err, exit );
-  if(bufferLen){
-    err = HKSecureSocketSend( sockfd, (uint8_t *)buffer, bufferLen, session );
-    require_noerr( err, exit ); 
-  }
 
 exit:
   if(httpResponse) free(httpResponse);
   return err;
 }
 
+static OSStatus _HKSendPairingStatus( int inFd, uint8_t inError, security_session_t *session )
+{
+  OSStatus err;
+  uint8_t outTLVResponse[2 * TLV8ItemSize(sizeof(uint8_t))];
+  size_t outTLVResponseLen = 0;
+
+  err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_State, eState_M2_PairingRespond );
+  require_noerr( err, exit );
+  if( inError != kTLVError_NoErr ){
+    err = TLVAppendUInt8( outTLVResponse, sizeof(outTLVResponse), &outTLVResponseLen, kTLVType_Error, inError );
+    require_noerr( err, exit );
+  }
+
+  err = HKSendPairResponseMessage( inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
+
+exit:
+  return err;
+}
+
+/* With a NULL inBuf only *ioLen is advanced, see TLVAppend */
+static OSStatus _HKAppendPairList( const pair_list_in_flash_t *inPairList, uint8_t *inBuf, size_t inBufSize, size_t *ioLen )
+{
+  OSStatus err;
+  bool needSeparator = false;
+  uint32_t i;
+
+  err = TLVAppendUInt8( inBuf, inBufSize, ioLen, kTLVType_State, eState_M2_PairingRespond );
+  require_noerr( err, exit );
+
+  for(i=0; i<MAXPairNumber; i++){
+    if(inPairList->pairInfo[i].controllerName[0] == 0)
+      continue;
+
+    if(needSeparator){
+      err = TLVAppend( inBuf, inBufSize, ioLen, kTLVType_Separator, NULL, 0 );
+      require_noerr( err, exit );
+    }
+    else
+      needSeparator = true;
+
+    err = TLVAppend( inBuf, inBufSize, ioLen, kTLVType_Identifier, inPairList->pairInfo[i].controllerName,
+                     strnlen(inPairList->pairInfo[i].controllerName, MaxControllerNameLen) );
+    require_noerr( err, exit );
+    err = TLVAppend( inBuf, inBufSize, ioLen, kTLVType_PublicKey, inPairList->pairInfo[i].controllerLTPK, 32 );
+    require_noerr( err, exit );
+    err = TLVAppendUInt8( inBuf, inBufSize, ioLen, kTLVType_Permissions, (uint8_t)inPairList->pairInfo[i].permission );
+    require_noerr( err, exit );
+  }
+
+exit:
+  return err;
+}
+
 OSStatus HKPairAddRemoveEngine( int inFd, HTTPHeader_t* inHeader, security_session_t *session  )
 {
   pair_log_trace();
   OSStatus err = kNoErr;
   uint8_t methold;
+  char                        identifierBuf[kHKControllerIdentifierLen];
+  uint8_t                     LTPKBuf[kHKLTPKLen];
   char *                      controllerIdentifier = NULL;
   uint8_t *                   controllerLTPK = NULL;
   uint32_t        permissions = 0x0;
-  uint32_t i;
-  uint8_t *httpResponse = NULL;
-    uint8_t *outTLVResponse = NULL;
+  uint8_t *outTLVResponse = NULL;
+  size_t outTLVResponseSize = 0;
   size_t outTLVResponseLen = 0;
-  uint8_t *tlvPtr;
   pair_list_in_flash_t        *pairList = NULL;
-  bool needSeparator = false;
 
   const uint8_t *             src = (const uint8_t *) inHeader->extraDataPtr;
   const uint8_t * const       end = src + inHeader->extraDataLen;
   uint8_t                     eid;
   const uint8_t *             ptr;
   size_t                      len;
-  char *                      tmp;
 
   while( TLVGetNext( src, end, &eid, &ptr, &len, &src ) == kNoErr )
   {
-    tmp = calloc( len + 1, sizeof( uint8_t ) );
-    require_action( tmp, exit, err = kNoMemoryErr );
-    memcpy( tmp, ptr, len );
-
     switch( eid )
     {
       case kTLVType_State:
-        require_action(1 == *(uint8_t *)tmp, exit, err = kStateErr);
-        free(tmp);
+        require_action(len == sizeof(uint8_t) && 1 == *ptr, exit, err = kStateErr);
         break;
       case kTLVType_Method:
-        methold = *(uint8_t *)tmp;
-        free(tmp);
+        require_action(len == sizeof(uint8_t), exit, err = kMalformedErr);
+        methold = *ptr;
         break;
       case kTLVType_Identifier:
-        controllerIdentifier = tmp;
+        require_action(len < sizeof(identifierBuf), exit, err = kMalformedErr);
+        memcpy( identifierBuf, ptr, len );
+        identifierBuf[len] = 0x0;
+        controllerIdentifier = identifierBuf;
         break;
       case kTLVType_PublicKey:
-        controllerLTPK = (uint8_t *)tmp;
+        require_action(len == sizeof(LTPKBuf), exit, err = kMalformedErr);
+        memcpy( LTPKBuf, ptr, len );
+        controllerLTPK = LTPKBuf;
         break;
       case kTLVType_Permissions:
-        permissions = *(uint8_t *)tmp;
-        free(tmp);
+        require_action(len == sizeof(uint8_t), exit, err = kMalformedErr);
+        permissions = *ptr;
         break;
       default:
-        free( tmp );
         pair_log( "Warning: Ignoring unsupported pair setup EID 0x%02X", eid );
         break;
     }
   }
 
   if( HMFindAdmin(session->controllerIdentifier) == false){ //Require admin
-        outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-        outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-        outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-        require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-        tlvPtr = outTLVResponse;
-        *tlvPtr++ = kTLVType_State;
-        *tlvPtr++ = sizeof(uint8_t);
-        *tlvPtr++ = eState_M2_PairingRespond;
-
-        *tlvPtr++ = kTLVType_Error;
-        *tlvPtr++ = sizeof(uint8_t);
-        *tlvPtr++ = kTLVError_UnknowErr;
-
-        err = HKSendPairResponseMessage(inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
-        goto exit;        
-      }
+    err = _HKSendPairingStatus( inFd, kTLVError_UnknowErr, session );
+    goto exit;
+  }
 
   if(methold == Pair_Add){
     require_action(controllerIdentifier && controllerLTPK, exit, err = kParamErr);
 
     if(HKInsertPairInfo(controllerIdentifier, controllerLTPK, (permissions&0x1)) == kNoSpaceErr){
-      outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-      outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-      outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-      require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-      tlvPtr = outTLVResponse;
-      *tlvPtr++ = kTLVType_State;
-      *tlvPtr++ = sizeof(uint8_t);
-      *tlvPtr++ = eState_M2_PairingRespond;
-
-      *tlvPtr++ = kTLVType_Error;
-      *tlvPtr++ = sizeof(uint8_t);
-      *tlvPtr++ = kTLVError_MaxPeers;
-
-      err = HKSendPairResponseMessage(inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
+      err = _HKSendPairingStatus( inFd, kTLVError_MaxPeers, session );
       goto exit;
     }
 
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M2_PairingRespond;
-
-    err = HKSendPairResponseMessage(inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
+    err = _HKSendPairingStatus( inFd, kTLVError_NoErr, session );
     require_noerr( err, exit );
 
   }else if(methold == Pair_Remove){
     require_action(controllerIdentifier, exit, err = kParamErr);
 
     if( HMRemoveLTPK(controllerIdentifier) != kNoErr ){ //Remove
-      outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-      outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-      outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-      require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-      tlvPtr = outTLVResponse;
-      *tlvPtr++ = kTLVType_State;
-      *tlvPtr++ = sizeof(uint8_t);
-      *tlvPtr++ = eState_M2_PairingRespond;
-
-      *tlvPtr++ = kTLVType_Error;
-      *tlvPtr++ = sizeof(uint8_t);
-      *tlvPtr++ = kTLVError_UnknowErr;
-
-      err = HKSendPairResponseMessage(inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
+      err = _HKSendPairingStatus( inFd, kTLVError_UnknowErr, session );
       goto exit;    
     }
 
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;
-
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
-    require_action( outTLVResponse, exit, err = kNoMemoryErr );
-
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M2_PairingRespond;
-
-    err = HKSendPairResponseMessage(inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
+    err = _HKSendPairingStatus( inFd, kTLVError_NoErr, session );
     
     require_noerr( err, exit );
 
@@ -1422,54 +1365,15 @@ OSStatus HKPairAddRemoveEngine( int inFd, HTTPHeader_t* inHeader, security_sessi
     err = HMReadPairList(pairList);
     require_noerr(err, exit);
 
-    outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize; //M2
-
-    needSeparator = false;
-    for(i=0; i<MAXPairNumber; i++){
-      if(pairList->pairInfo[i].controllerName[0] != 0){
-        if(needSeparator)
-          outTLVResponseLen += kHATLV_TypeLengthSize; //Separates
-        else
-          needSeparator = true;
-        outTLVResponseLen += strlen(pairList->pairInfo[i].controllerName) + kHATLV_TypeLengthSize; //Identifier
-        outTLVResponseLen += 32 + kHATLV_TypeLengthSize;  //Public key
-        outTLVResponseLen += sizeof(uint8_t) + kHATLV_TypeLengthSize;  //Permission
-      }
-    }
+    /* First pass sizes the response, second pass writes it */
+    err = _HKAppendPairList( pairList, NULL, 0, &outTLVResponseSize );
+    require_noerr( err, exit );
 
-    outTLVResponse = calloc( outTLVResponseLen, sizeof( uint8_t ) );
+    outTLVResponse = malloc( outTLVResponseSize );
     require_action( outTLVResponse, exit, err = kNoMemoryErr );
 
-    tlvPtr = outTLVResponse;
-    *tlvPtr++ = kTLVType_State;
-    *tlvPtr++ = sizeof(uint8_t);
-    *tlvPtr++ = eState_M2_PairingRespond;
-
-    needSeparator = false;
-    for(i=0; i<MAXPairNumber; i++){
-      if(pairList->pairInfo[i].controllerName[0] != 0){
-        if(needSeparator){
-          *tlvPtr++ = kTLVType_Separator;
-          *tlvPtr++ = 0x0;
-        }
-        else
-          needSeparator = true;
-
-        *tlvPtr++ = kTLVType_Identifier;
-        *tlvPtr++ = strlen(pairList->pairInfo[i].controllerName);
-        strncpy((char *)tlvPtr, pairList->pairInfo[i].controllerName, 64);
-        tlvPtr+= strlen(pairList->pairInfo[i].controllerName);
-
-        *tlvPtr++ = kTLVType_PublicKey;
-        *tlvPtr++ = 32;
-        memcpy(tlvPtr, pairList->pairInfo[i].controllerLTPK, 32);
-        tlvPtr+= 32;
-
-        *tlvPtr++ = kTLVType_Permissions;
-        *tlvPtr++ = sizeof(uint8_t);
-        *tlvPtr+= pairList->pairInfo[i].permission;
-      }
-    }
+    err = _HKAppendPairList( pairList, outTLVResponse, outTLVResponseSize, &outTLVResponseLen );
+    require_noerr( err, exit );
 
     err = HKSendPairResponseMessage(inFd, kStatusOK, outTLVResponse, outTLVResponseLen, session );
     
@@ -1485,9 +1389,6 @@ OSStatus HKPairAddRemoveEngine( int inFd, HTTPHeader_t* inHeader, security_sessi
 exit: 
   if(pairList) free(pairList);
   if(outTLVResponse) free(outTLVResponse);
-  if(controllerIdentifier)  free(controllerIdentifier);
-  if(controllerLTPK)  free(controllerLTPK);
-  if(httpResponse) free(httpResponse);
   pair_log("Memory check 3: %d", mico_memory_info()->free_memory);
   return err;
 }
@@ -4,7 +4,7 @@
 #include "Common.h"
 #include "HTTPUtils.h"
 #include "MICODefine.h"
-#include "MICOSRPServer.h"
+#include "SRPUtils.h"
 #include "HomeKitHTTPUtils.h"
 
 
@@ -12,11 +12,13 @@
 /*Pair setup info*/
 typedef struct _pairInfo_t {
   char              *SRPUser;
-  srp_server_t      *SRPServer;
+  SRPServerRef      SRPServer;
   uint8_t           *SRPControllerPublicKey;
   ssize_t           SRPControllerPublicKeyLen;
   uint8_t           *SRPControllerProof;
   ssize_t           SRPControllerProofLen;
+  const uint8_t     *SRPSessionKey;
+  size_t            SRPSessionKeyLen;
   uint8_t           *HKDF_Key;
   bool              pairListFull;
 } pairInfo_t;
@@ -35,6 +37,11 @@ typedef struct _pairVerifyInfo_t {
   uint8_t                   *pHKDFKey;
   uint8_t                   *A2CKey;
   uint8_t                   *C2AKey;
+  uint8_t                   method;
+  uint8_t                   *pResumeSessionID;
+  uint8_t                   *pResumeRequestData;
+  size_t                    resumeRequestDataLen;
+  uint32_t                  startTime;
 } pairVerifyInfo_t;
 
 void HKSetPassword (const uint8_t * password, const size_t passwordLen);
@@ -20,6 +20,7 @@
   */ 
 
 #include "HomeKitPairlist.h"
+#include "HomeKitPairCache.h"
 #include "Debug.h"
 #include "MicoPlatform.h"
 #include "platform_config.h"
@@ -46,6 +47,9 @@ OSStatus HMClearPairList(void)
   err = MicoFlashFinalize(MICO_FLASH_FOR_EX_PARA);
   require_noerr(err, exit);
 
+  HKLTPKCacheFlush();
+  HKResumeSessionFlush();
+
 exit:
   if(pairList) free(pairList);
   return err;
@@ -123,6 +127,8 @@ OSStatus HKInsertPairInfo(char controllerIdentifier[64], uint8_t controllerLTPK[
   else
     pairList->pairInfo[i].permission = pairList->pairInfo[i].permission&0xFFFFFFFE;
   err = HMUpdatePairList(pairList);
+  if(err == kNoErr)
+    HKLTPKCacheUpdate(controllerIdentifier, controllerLTPK);
 
 exit: 
   if(pairList) free(pairList);
@@ -137,6 +143,10 @@ uint8_t * HMFindLTPK(char * name)
   uint8_t *controllerLTPK = NULL;
   uint32_t i;
 
+  /* Controllers that verified recently are in RAM, skip reading the whole pair list */
+  if(HKLTPKCacheFind(name, foundControllerLTPK) == true)
+    return foundControllerLTPK;
+
   pair_list_in_flash_t *pairList = malloc(sizeof(pair_list_in_flash_t));
   HMReadPairList(pairList);
 
@@ -177,6 +187,9 @@ OSStatus HMRemoveLTPK(char * name)
   uint32_t i;
   OSStatus err = kNoErr;
 
+  HKLTPKCacheRemove(name);
+  HKResumeSessionRemoveController(name);
+
   pair_list_in_flash_t *pairList = malloc(sizeof(pair_list_in_flash_t));
   HMReadPairList(pairList);
 
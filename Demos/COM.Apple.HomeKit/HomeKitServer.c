@@ -30,6 +30,9 @@
 #include "HomeKitPairProtocol.h"
 #include "HomeKitProfiles.h"
 #include "URLUtils.h"
+#include "MICOTrace.h"
+#include "HomeKitNotify.h"
+#include "HomeKitAccessoryDB.h"
 
 #define ha_log(M, ...) custom_log("HomeKit", M, ##__VA_ARGS__)
 #define ha_log_trace() custom_log_trace("HomeKit")
@@ -81,6 +84,7 @@ typedef struct _HK_Context_t {
   pairInfo_t          *pairInfo;
   pairVerifyInfo_t    *pairVerifyInfo;
   security_session_t  *session;
+  hk_notify_session_t *notifySession;
 } HK_Context_t;
 
 typedef struct _HK_Char_ID_t {
@@ -90,24 +94,20 @@ typedef struct _HK_Char_ID_t {
   int          characteristicID;
 } HK_Char_ID_t;
 
-typedef struct _HK_Notify{
-  int aid;
-  int iid;
-  value_union value;
-  struct _HK_Notify *next;
-} HK_Notify_t;
-
 extern void HKCharacteristicInit(mico_Context_t * const inContext);
 extern HkStatus HKReadCharacteristicValue(int accessoryID, int serviceID, int characteristicID, value_union *value, mico_Context_t * const inContext);
 extern void HKWriteCharacteristicValue(int accessoryID, int serviceID, int characteristicID, value_union value, bool moreComing, mico_Context_t * const inContext);
-extern HkStatus HKReadCharacteristicStatus(int accessoryID, int serviceID, int characteristicID, mico_Context_t * const inContext);
+extern void HKReadCharacteristicBatch(hk_char_request_t *requests, int count, mico_Context_t * const inContext);
+extern void HKWriteCharacteristicBatch(hk_char_request_t *requests, int count, mico_Context_t * const inContext);
 extern HkStatus HKExcuteUnpairedIdentityRoutine( mico_Context_t * const inContext );
 
 
 static void homeKitClient_thread(void *inFd);
+static OSStatus HKBuildAttributeIndex(struct _hapAccessory_t inHapObject[]);
 static mico_Context_t *Context;
 static OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notify_t** notifyList, HK_Context_t *inHkContext, mico_Context_t * const inContext);
-static OSStatus HKCreateHAPAttriDataBase( struct _hapAccessory_t *inHapObject,  HK_Notify_t* notifyList, json_object **OutHapObjectJson,  mico_Context_t * const inContext);
+
+MICO_TRACE_HISTOGRAM( hk_request_histogram, "hk request" );
 static OSStatus HKCreateHAPReadRespond( struct _hapAccessory_t inHapObject[],  json_object **OutHapObjectJson, 
                                                 int accessoryID, int serviceID, int characteristicID, mico_Context_t * const inContext);
 static OSStatus HKCreateHAPWriteRespond( struct _hapAccessory_t inHapObject[],  json_object *inputHapObjectJson, json_object **OutHapObjectJson,
@@ -134,7 +134,11 @@ void homeKitListener_thread(void *inContext)
   HKSetVerifier(verifier, sizeof(verifier), salt, sizeof(salt));
 
   Context->appStatus.haPairSetupRunning = false;
+  err = HKNotifyInit();
+  require_noerr( err, exit );
   HKCharacteristicInit(inContext);
+  err = HKBuildAttributeIndex(hapObjects);
+  require_noerr( err, exit );
   /*Establish a TCP server fd that accept the tcp clients connections*/ 
   homeKitlistener_fd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
   require_action(IsValidSocket( homeKitlistener_fd ), exit, err = kNoResourcesErr );
@@ -176,138 +180,177 @@ exit:
     return;
 }
 
-void FindCharacteristicByIID(struct _hapAccessory_t inHapObject[], int aid, int iid, int *serviceID, int *characteristicID)
+/* Flattened attribute table, built once after HKCharacteristicInit. Instance IDs are dense and
+   start at 1 in every accessory, so entry iid-1 of an accessory's table describes that iid and a
+   lookup is a bounds check and an array access. Numbering is the same as in /accessories. */
+typedef struct _HK_Attribute_t {
+  uint8_t                       serviceID;          /* 1 based */
+  uint8_t                       characteristicID;   /* 1 based, 0 for the service itself */
+  struct _hapCharacteristic_t   *characteristic;    /* NULL for a service */
+} HK_Attribute_t;
+
+static HK_Attribute_t *hkAttributes[NumberofAccessories];
+static int hkAttributeCount[NumberofAccessories];
+static uint16_t hkServiceIID[NumberofAccessories][MAXServicePerAccessory];
+
+static OSStatus HKBuildAttributeIndex(struct _hapAccessory_t inHapObject[])
 {
-  int serviceIndex, characteristicIndex, tmpIID;
-  tmpIID = 1;
-  *serviceID = 0;
-  *characteristicID = 0;
-
-  for(serviceIndex = 0; serviceIndex < MAXServicePerAccessory; serviceIndex++){
-    if(inHapObject[aid-1].services[serviceIndex].type == 0 || tmpIID > iid)
-      return;
-    if(tmpIID == iid){
-      *serviceID = serviceIndex + 1;
-      return;
-    }
-    tmpIID ++;
+  OSStatus err = kNoErr;
+  int accessoryIndex, serviceIndex, characteristicIndex, count;
+  HK_Attribute_t *attribute;
 
-    for(characteristicIndex = 0; characteristicIndex < MAXCharacteristicPerService; characteristicIndex++){
-      if(inHapObject[aid-1].services[serviceIndex].characteristic[characteristicIndex].type == 0 )
+  for(accessoryIndex = 0; accessoryIndex < NumberofAccessories; accessoryIndex++){
+    /* Count first, so the table is allocated once and exactly */
+    for(count = 0, serviceIndex = 0; serviceIndex < MAXServicePerAccessory; serviceIndex++){
+      if(inHapObject[accessoryIndex].services[serviceIndex].type == 0)
         break;
-      if(tmpIID > iid)
-        return;
-      if(tmpIID == iid){
-        *serviceID = serviceIndex + 1;
-        *characteristicID = characteristicIndex + 1;;
-        return;
+      count++;
+      for(characteristicIndex = 0; characteristicIndex < MAXCharacteristicPerService; characteristicIndex++){
+        if(inHapObject[accessoryIndex].services[serviceIndex].characteristic[characteristicIndex].type)
+          count++;
       }
-      tmpIID ++;
     }
-  }
-}
 
-OSStatus HKNotificationAdd( int aid, int iid, value_union value, HK_Notify_t** notifyList )
-{
-  OSStatus err = kNoErr;
-  HK_Notify_t *notify = (HK_Notify_t *)malloc(sizeof(HK_Notify_t));
-  HK_Notify_t *tmp = * notifyList;
-  require_action(notify, exit, err = kNoMemoryErr);
-  notify->aid = aid;
-  notify->iid = iid;
-  notify->value = value;
-  notify->next = NULL;
-  if(* notifyList == NULL){
-    * notifyList = notify;
-  }else{
-    if(tmp->aid == aid && tmp->iid == iid){
-      free(notify);
-      memcpy(&tmp->value, &value, sizeof(value_union));
-      return kNoErr;   //Nodify already exist
-    }
-    while(tmp->next!=NULL){
-      tmp = tmp->next;
-      if(tmp->aid == aid && tmp->iid == iid){
-        memcpy(&tmp->value, &value, sizeof(value_union));
-        free(notify);
-        return kNoErr;   //Nodify already exist
+    if(hkAttributes[accessoryIndex]) free(hkAttributes[accessoryIndex]);
+    hkAttributes[accessoryIndex] = calloc(count, sizeof(HK_Attribute_t));
+    require_action(hkAttributes[accessoryIndex] || count == 0, exit, err = kNoMemoryErr);
+    hkAttributeCount[accessoryIndex] = count;
+    memset(hkServiceIID[accessoryIndex], 0x0, sizeof(hkServiceIID[accessoryIndex]));
+
+    attribute = hkAttributes[accessoryIndex];
+    for(serviceIndex = 0; serviceIndex < MAXServicePerAccessory; serviceIndex++){
+      if(inHapObject[accessoryIndex].services[serviceIndex].type == 0)
+        break;
+      hkServiceIID[accessoryIndex][serviceIndex] = attribute - hkAttributes[accessoryIndex] + 1;
+      attribute->serviceID = serviceIndex + 1;
+      attribute++;
+      for(characteristicIndex = 0; characteristicIndex < MAXCharacteristicPerService; characteristicIndex++){
+        if(inHapObject[accessoryIndex].services[serviceIndex].characteristic[characteristicIndex].type == 0)
+          continue;
+        attribute->serviceID = serviceIndex + 1;
+        attribute->characteristicID = characteristicIndex + 1;
+        attribute->characteristic = &inHapObject[accessoryIndex].services[serviceIndex].characteristic[characteristicIndex];
+        attribute++;
       }
     }
-    tmp->next = notify;
+    ha_log("Accessory %d: %d attributes indexed", accessoryIndex + 1, count);
   }
+
 exit:
   return err;
 }
 
-OSStatus HKNotificationRemove( int aid, int iid, HK_Notify_t** notifyList )
+static const HK_Attribute_t *HKAttributeByIID(int aid, int iid)
 {
-  OSStatus err = kNoErr;
-  HK_Notify_t *temp2;
-  HK_Notify_t *temp = *notifyList;
-  require_action(temp, exit, err = kDeletedErr);
-  do{
-    if(temp->aid == aid && temp->iid == iid){
-      if(temp == *notifyList){  //first element
-        * notifyList = temp->next;
-        free(temp);
-      }else{
-        temp2->next = temp->next;
-        free(temp);
-      }
-       break;
-    }
-    require_action(temp->next!=NULL, exit, err = kNotFoundErr);
-    temp2 = temp;
-    temp = temp->next;
-  }while(temp!=NULL);
-
-exit:
-  return err;
+  if(aid < 1 || aid > NumberofAccessories || iid < 1 || iid > hkAttributeCount[aid-1])
+    return NULL;
+  return &hkAttributes[aid-1][iid-1];
 }
 
-OSStatus HKNotifyGetNext( 
-        HK_Notify_t *   notifyList, 
-        int *           outAID, 
-        int *           outIID, 
-        value_union *   value, 
-        HK_Notify_t **  outNextNotifyList )
+static struct _hapCharacteristic_t *HKCharacteristicByIID(int aid, int iid)
 {
-  if(notifyList == NULL) return kNotFoundErr;
-  *outAID = notifyList->aid;
-  *outIID = notifyList->iid;
-  *value = notifyList->value;
-  *outNextNotifyList = notifyList->next;
-  return kNoErr;
+  const HK_Attribute_t *attribute = HKAttributeByIID(aid, iid);
+  return attribute? attribute->characteristic : NULL;
 }
 
-OSStatus HKNotificationFind( int aid, int iid, HK_Notify_t* notifyList )
+void FindCharacteristicByIID(struct _hapAccessory_t inHapObject[], int aid, int iid, int *serviceID, int *characteristicID)
 {
-  OSStatus err = kNotFoundErr;
-  int _aid, _iid;
-  value_union _value;
-  HK_Notify_t* _notifyList = notifyList;
+  const HK_Attribute_t *attribute = HKAttributeByIID(aid, iid);
+  UNUSED_PARAMETER(inHapObject);
 
-  while(HKNotifyGetNext( _notifyList, &_aid, &_iid, &_value, &_notifyList) == kNoErr){
-    if(_aid == aid && _iid == iid)
-      return kNoErr;
+  *serviceID = attribute? attribute->serviceID : 0;
+  *characteristicID = attribute? attribute->characteristicID : 0;
+}
+
+int HKFindIIDByCharacteristic(struct _hapAccessory_t inHapObject[], int aid, int serviceID, int characteristicID)
+{
+  int iid;
+  const HK_Attribute_t *attribute;
+  UNUSED_PARAMETER(inHapObject);
+
+  if(aid < 1 || aid > NumberofAccessories || serviceID < 1 || serviceID > MAXServicePerAccessory)
+    return 0;
+  iid = hkServiceIID[aid-1][serviceID-1];
+  if(iid == 0 || characteristicID == 0)
+    return iid;
+
+  /* Characteristics without a type have no iid, so the offset is only an upper bound */
+  for(iid += Min(characteristicID, hkAttributeCount[aid-1] - iid); iid > 0; iid--){
+    attribute = &hkAttributes[aid-1][iid-1];
+    if(attribute->serviceID != serviceID)
+      return 0;
+    if(attribute->characteristicID == characteristicID)
+      return iid;
   }
-  return err;
+  return 0;
 }
 
-OSStatus HKNotificationClean( HK_Notify_t** notifyList )
+void HKCharacteristicChangedByID(int aid, int serviceID, int characteristicID)
 {
-  HK_Notify_t* temp = *notifyList;
-  HK_Notify_t* temp2;
-  if(*notifyList == NULL) return kNoErr;
-  do{
-    temp2 = temp->next;
-    free(temp);
-    temp = temp2;
-  }while(temp!=NULL);    
+  int iid = HKFindIIDByCharacteristic(hapObjects, aid, serviceID, characteristicID);
+
+  if(iid)
+    HKCharacteristicChanged(aid, iid);
+}
+
+/* Adds a changed characteristic to the EVENT message, unless it changed back before the message is sent */
+static OSStatus _HKCreateEventPerCharacteristic(int aid, int iid, json_object *outCharacteristics, HK_Notify_t **notifyList, mico_Context_t * const inContext)
+{
+  OSStatus err = kNoErr;
+  int serviceID, characteristicID;
+  value_union value, newValue;
+  HK_Notify_t *temp = *notifyList;
+  int _aid = 0, _iid = 0;
+  struct _hapCharacteristic_t *pCharacteristic;
+  json_object *outCharacteristic, *value_obj = NULL;
+
+  /* Unsubscribed in the meantime */
+  while(HKNotifyGetNext( temp, &_aid, &_iid, &value, &temp) == kNoErr){
+    if(_aid == aid && _iid == iid)
+      break;
+  }
+  require_quiet(_aid == aid && _iid == iid, exit);
+
+  FindCharacteristicByIID(hapObjects, aid, iid, &serviceID, &characteristicID);
+  pCharacteristic = HKCharacteristicByIID(aid, iid);
+  require_quiet(pCharacteristic, exit);
+  require_quiet(HKReadCharacteristicValue(aid, serviceID, characteristicID, &newValue, inContext) == kHKNoErr, exit);
+
+  /* Strings are pointers to the live value, so they cannot be compared with the last one sent */
+  switch(pCharacteristic->valueType){
+    case ValueType_bool:
+      require_quiet(value.boolValue != newValue.boolValue, exit);
+      value_obj = json_object_new_boolean(newValue.boolValue);
+      break;
+    case ValueType_int:
+      require_quiet(value.intValue != newValue.intValue, exit);
+      value_obj = json_object_new_int(newValue.intValue);
+      break;
+    case ValueType_float:
+      require_quiet(value.floatValue != newValue.floatValue, exit);
+      value_obj = json_object_new_double(newValue.floatValue);
+      break;
+    case ValueType_string:
+      value_obj = json_object_new_string(newValue.stringValue);
+      break;
+    case ValueType_date:
+      value_obj = json_object_new_string(newValue.dateValue);
+      break;
+    default:
+      goto exit;
+  }
+  require_action(value_obj, exit, err = kNoMemoryErr);
+
+  outCharacteristic = json_object_new_object();
+  require_action(outCharacteristic, exit, err = kNoMemoryErr; json_object_put(value_obj));
+  json_object_object_add( outCharacteristic, "aid", json_object_new_int(aid));
+  json_object_object_add( outCharacteristic, "iid", json_object_new_int(iid));
+  json_object_object_add( outCharacteristic, "value", value_obj);
+  json_object_array_add( outCharacteristics, outCharacteristic );
+  HKNotificationAdd( aid, iid, newValue, notifyList );
 
 exit:
-  * notifyList = NULL;
-  return kNoErr;
+  return err;
 }
 
 void homeKitClient_thread(void *inFd)
@@ -315,129 +358,95 @@ void homeKitClient_thread(void *inFd)
   ha_log_trace();
   OSStatus err;
   int clientFd = *(int *)inFd;
+  int eventFd;
   struct timeval_t t;
   HTTPHeader_t *httpHeader = NULL;
   int selectResult;
   fd_set      readfds;
   HK_Context_t hkContext;
-  int aid, iid, serviceID, characteristicID;
-  value_union value, newValue;
-  struct _hapCharacteristic_t pCharacteristic;
-  json_object *outEventJsonObject = NULL, *outCharacteristics, *outCharacteristic;
+  HK_Notify_t **notifyList;
+  hk_notify_change_t *changes = NULL;
+  uint32_t changeCount, idx, waitTime;
+  bool takeRetry = false;
+  json_object *outEventJsonObject = NULL, *outCharacteristics;
   const char *buffer = NULL;
 
   memset(&hkContext, 0x0, sizeof(HK_Context_t));
   hkContext.session = HKSNewSecuritySession();
   require_action(hkContext.session, exit, err = kNoMemoryErr);
 
+  hkContext.notifySession = HKNotifySessionCreate();
+  require_action(hkContext.notifySession, exit, err = kNoResourcesErr);
+  notifyList = HKNotifySessionList(hkContext.notifySession);
+  eventFd = HKNotifySessionEventFd(hkContext.notifySession);
+
   httpHeader = calloc(1, sizeof( HTTPHeader_t ) );
   require_action( httpHeader, exit, err = kNoMemoryErr );
 
-  HK_Notify_t *notifyList = NULL, *temp;
-
-  bool isChanged;
-
-  t.tv_sec = 1;
-  t.tv_usec = 0;  //Check for notify every 1 second
   ha_log("Free memory1: %d", mico_memory_info()->free_memory);
 
   while(1){
     if(hkContext.session->established == true && hkContext.session->recvedDataLen > 0){
-       err = HKhandleIncomeingMessage(clientFd, httpHeader, &notifyList, &hkContext, Context);
+       err = HKhandleIncomeingMessage(clientFd, httpHeader, notifyList, &hkContext, Context);
     }else{
+      /* Sleep until a request arrives or a subscribed characteristic changes, then give
+         the changes that follow HK_NOTIFY_COALESCE_TIME to join the same EVENT message */
+      HKNotifySessionReady(hkContext.notifySession, &waitTime);
+      if(takeRetry == true){
+        /* Changes are still pending, wait a little for memory before taking them again */
+        waitTime = HK_NOTIFY_RETRY_TIME;
+        takeRetry = false;
+      }
+      t.tv_sec = waitTime / 1000;
+      t.tv_usec = (waitTime % 1000) * 1000;
+
       FD_ZERO(&readfds);
       FD_SET(clientFd, &readfds);
-      selectResult = select(clientFd + 1, &readfds, NULL, NULL, &t);
+      FD_SET(eventFd, &readfds);
+      selectResult = select(Max(clientFd, eventFd) + 1, &readfds, NULL, NULL, waitTime == MICO_WAIT_FOREVER? NULL : &t);
       require( selectResult >= 0, exit );
       if(FD_ISSET(clientFd, &readfds)){
-        err = HKhandleIncomeingMessage(clientFd, httpHeader, &notifyList, &hkContext, Context);
+        err = HKhandleIncomeingMessage(clientFd, httpHeader, notifyList, &hkContext, Context);
         require_noerr(err, exit);
       }
 
       if(hkContext.session->established == false) // No nofification in no paired session
         continue;
 
+      if(HKNotifySessionReady(hkContext.notifySession, &waitTime) == false)
+        continue;
+
+      err = HKNotifySessionTake(hkContext.notifySession, &changes, &changeCount);
+      if(err == kNoMemoryErr){
+        ha_log("No memory for pending notifications, retry in %d ms", HK_NOTIFY_RETRY_TIME);
+        takeRetry = true;
+        continue;
+      }
+      require_noerr(err, exit);
+
       outEventJsonObject = json_object_new_object();
       require_action(outEventJsonObject, exit, err = kNoMemoryErr);
       outCharacteristics = json_object_new_array();
       require_action(outCharacteristics, exit, err = kNoMemoryErr);
       json_object_object_add( outEventJsonObject, "characteristics", outCharacteristics);
-      temp = notifyList;
-
-      while(HKNotifyGetNext( temp, &aid, &iid, &value, &temp) == kNoErr){
-        FindCharacteristicByIID(hapObjects, aid, iid, &serviceID, &characteristicID);   
-        if(HKReadCharacteristicValue(aid, serviceID, characteristicID, &newValue, Context)==kHKNoErr){
-          pCharacteristic = ((hapObjects[aid-1]).services[serviceID-1]).characteristic[characteristicID-1];
-
-          switch(pCharacteristic.valueType){
-            case ValueType_bool:
-              if( value.boolValue != newValue.boolValue ){
-                outCharacteristic = json_object_new_object();
-                json_object_object_add( outCharacteristic, "aid", json_object_new_int(aid));
-                json_object_object_add( outCharacteristic, "iid", json_object_new_int(iid));
-                json_object_object_add( outCharacteristic, "value", json_object_new_boolean(newValue.boolValue));
-                json_object_array_add( outCharacteristics, outCharacteristic );
-                HKNotificationAdd( aid, iid, newValue, &notifyList );
-              }
-              break;
-            case ValueType_int:
-              if( value.intValue != newValue.intValue ){
-                outCharacteristic = json_object_new_object();
-                json_object_object_add( outCharacteristic, "aid", json_object_new_int(aid));
-                json_object_object_add( outCharacteristic, "iid", json_object_new_int(iid));
-                json_object_object_add( outCharacteristic, "value", json_object_new_int(newValue.intValue));
-                json_object_array_add( outCharacteristics, outCharacteristic );
-                HKNotificationAdd( aid, iid, newValue, &notifyList );
-              }
-              break;
-            case ValueType_float:
-              if( value.floatValue != newValue.floatValue ){
-                outCharacteristic = json_object_new_object();
-                json_object_object_add( outCharacteristic, "aid", json_object_new_int(aid));
-                json_object_object_add( outCharacteristic, "iid", json_object_new_int(iid));
-                json_object_object_add( outCharacteristic, "value", json_object_new_double(newValue.floatValue));
-                json_object_array_add( outCharacteristics, outCharacteristic );
-                HKNotificationAdd( aid, iid, newValue, &notifyList );
-              }
-              break;
-            case ValueType_string:
-              if( !strcmp(value.stringValue, newValue.stringValue) ){
-                outCharacteristic = json_object_new_object();
-                json_object_object_add( outCharacteristic, "aid", json_object_new_int(aid));
-                json_object_object_add( outCharacteristic, "iid", json_object_new_int(iid));
-                json_object_object_add( outCharacteristic, "value", json_object_new_string(newValue.stringValue));
-                json_object_array_add( outCharacteristics, outCharacteristic );
-                HKNotificationAdd( aid, iid, newValue, &notifyList );
-              }
-              break;
-            case ValueType_date:
-              if( !strcmp(value.dateValue, newValue.dateValue) ){
-                outCharacteristic = json_object_new_object();
-                json_object_object_add( outCharacteristic, "aid", json_object_new_int(aid));
-                json_object_object_add( outCharacteristic, "iid", json_object_new_int(iid));
-                json_object_object_add( outCharacteristic, "value", json_object_new_string(newValue.dateValue));
-                json_object_array_add( outCharacteristics, outCharacteristic );
-                HKNotificationAdd( aid, iid, newValue, &notifyList );
-              }
-              break;
-            default:
-              break;
-          }
-        }
+
+      for(idx = 0; idx < changeCount; idx++){
+        err = _HKCreateEventPerCharacteristic(changes[idx].aid, changes[idx].iid, outCharacteristics, notifyList, Context);
+        require_noerr(err, exit);
       }
-            
+
       if(json_object_array_length(outCharacteristics)){
         buffer = json_object_to_json_string(outEventJsonObject);
         ha_log("Notification json cstring generated, memory remains %d, %s", mico_memory_info()->free_memory, buffer);  
         err = HKSendNotifyMessage( clientFd, (uint8_t *)buffer, strlen(buffer), hkContext.session );
         require_noerr(err, exit);
-
+        HKNotifyRecordEvent(changes, changeCount);
       }
       
       json_object_put(outEventJsonObject);
       outEventJsonObject = NULL;
-          //err = HKSendResponseMessage(sockfd, status, (uint8_t *)buffer->buf, strlen(buffer->buf), inHkContext);
-          //require_noerr(err, exit);
+      free(changes);
+      changes = NULL;
     }
   }
 
@@ -445,8 +454,9 @@ exit:
   SocketClose(&clientFd);
   HTTPHeaderClear( httpHeader );
   if(httpHeader)    free(httpHeader);
-  HKNotificationClean( &notifyList );
+  HKNotifySessionDelete( hkContext.notifySession );
   if(outEventJsonObject) json_object_put(outEventJsonObject);
+  if(changes) free(changes);
   HKCleanPairSetupInfo(&hkContext.pairInfo, Context);
   HKCleanPairVerifyInfo(&hkContext.pairVerifyInfo);
   free(hkContext.session);
@@ -459,168 +469,6 @@ exit:
 
 
 
-static HkStatus HKCreateHAPAttriDataBase( struct _hapAccessory_t inHapObject[], HK_Notify_t* notifyList, json_object **OutHapObjectJson, mico_Context_t * const inContext)
-{
-  HkStatus err = kNoErr;
-  uint32_t accessoryIndex, serviceIndex, characteristicIndex;
-  uint32_t aid = 1;
-  uint32_t iid = 1;
-  struct _hapCharacteristic_t             pCharacteristic;
-  bool hasConstraint = false;
-  value_union value;
-  bool event;
-
-  json_object *hapJsonObject, *accessories, *accessory, *services, *service, *characteristics, *characteristic, *properties;
-  json_object *constraints, *metaData;
-
-  hapJsonObject = json_object_new_object();
-  accessories = json_object_new_array();
-  json_object_object_add( hapJsonObject, "accessories", accessories ); 
-
-  for(accessoryIndex = 0; accessoryIndex < NumberofAccessories; accessoryIndex++){
-
-    accessory = json_object_new_object();
-    json_object_array_add (accessories, accessory);
-
-    json_object_object_add( accessory, "aid", json_object_new_int(aid++) );   
-    services = json_object_new_array();
-    json_object_object_add( accessory, "services", services);
-
-    for(serviceIndex = 0, iid = 1; serviceIndex < MAXServicePerAccessory; serviceIndex++){
-      if(inHapObject[accessoryIndex].services[serviceIndex].type == 0)
-        break;
-      service = json_object_new_object();
-
-      json_object_object_add( service, "type", json_object_new_string(inHapObject[0].services[serviceIndex].type));
-      json_object_object_add( service, "iid",  json_object_new_int(iid++));
-
-      characteristics = json_object_new_array();
-
-      json_object_object_add( service, "characteristics",  characteristics);
-
-      for(characteristicIndex = 0; characteristicIndex < MAXCharacteristicPerService; characteristicIndex++){
-        pCharacteristic = inHapObject[accessoryIndex].services[serviceIndex].characteristic[characteristicIndex];
-        if(pCharacteristic.type){
-          characteristic = json_object_new_object();
-          json_object_array_add( characteristics, characteristic ); 
-          /*Type*/
-          json_object_object_add( characteristic, "type", json_object_new_string(pCharacteristic.type));
-
-          /*Instance ID*/
-          json_object_object_add( characteristic, "iid", json_object_new_int(iid++));
-
-          HKReadCharacteristicValue(accessoryIndex+1, serviceIndex+1, characteristicIndex+1, &value, inContext);
-          /*Value*/
-          if( pCharacteristic.secureRead == true ){
-            if(pCharacteristic.hasStaticValue)
-              value = pCharacteristic.value;
-
-            switch(pCharacteristic.valueType){
-              case ValueType_bool:
-                json_object_object_add( characteristic, "value", json_object_new_boolean(value.boolValue));
-                break;
-              case ValueType_int:
-                json_object_object_add( characteristic, "value", json_object_new_int(value.intValue));
-                break;
-              case ValueType_float:
-                json_object_object_add( characteristic, "value", json_object_new_double(value.floatValue));
-                break;
-              case ValueType_string:
-                json_object_object_add( characteristic, "value", json_object_new_string(value.stringValue));
-                break;
-              case ValueType_date:
-                json_object_object_add( characteristic, "value", json_object_new_string(value.dateValue));
-                break;
-              case ValueType_null:
-                json_object_object_add( characteristic, "value", NULL);
-                break;
-              default:
-                break;
-            }
-          }
-
-          properties = json_object_new_array();
-          if(pCharacteristic.secureRead)
-            json_object_array_add( properties, json_object_new_string("pr") );
-          if(pCharacteristic.secureWrite)
-            json_object_array_add( properties, json_object_new_string("pw") );
-          json_object_object_add( characteristic, "perms", properties);
-
-          if(pCharacteristic.hasEvents){
-            if(HKNotificationFind(aid, iid, notifyList)==kNoErr)
-              json_object_object_add( characteristic, "ev", json_object_new_boolean(true));
-            else
-              json_object_object_add( characteristic, "ev", json_object_new_boolean(false));
-          }
-
-          if(pCharacteristic.hasMinimumValue){
-            switch(pCharacteristic.valueType){
-              case ValueType_int:
-                json_object_object_add( characteristic, "minValue",  json_object_new_int(pCharacteristic.minimumValue.intValue) );
-                break;
-              case ValueType_float:
-                json_object_object_add( characteristic, "minValue",  json_object_new_double(pCharacteristic.minimumValue.floatValue) );
-                break;
-              default:
-                break;
-            }
-          }
-
-          if(pCharacteristic.hasMaximumValue){
-            switch(pCharacteristic.valueType){
-              case ValueType_int:
-                json_object_object_add( characteristic, "maxValue",  json_object_new_int(pCharacteristic.maximumValue.intValue) );
-                break;
-              case ValueType_float:
-                json_object_object_add( characteristic, "maxValue",  json_object_new_double(pCharacteristic.maximumValue.floatValue) );
-                break;
-              default:
-                break;
-            }
-          }
-
-          if(pCharacteristic.hasMinimumStep){
-            switch(pCharacteristic.valueType){
-              case ValueType_int:
-                json_object_object_add( characteristic, "minStep",  json_object_new_int(pCharacteristic.minimumStep.intValue) );
-                break;
-              case ValueType_float:
-                json_object_object_add( characteristic, "minStep",  json_object_new_double(pCharacteristic.minimumStep.floatValue) );
-                break;
-              default:
-                break;
-            }
-          }
-               
-          if(pCharacteristic.hasMaxLength)
-            json_object_object_add( characteristic, "maxLen",     json_object_new_int(pCharacteristic.maxLength));
-
-          if(pCharacteristic.hasMaxDataLength)
-            json_object_object_add( characteristic, "maxDataLen",     json_object_new_int(pCharacteristic.maxDataLength));
-
-          if(pCharacteristic.description)
-            json_object_object_add( characteristic, "description", json_object_new_string(pCharacteristic.description));
-
-          if(pCharacteristic.format)
-            json_object_object_add( characteristic, "format", json_object_new_string(pCharacteristic.format));
-
-          if(pCharacteristic.unit)
-            json_object_object_add( characteristic, "unit", json_object_new_string(pCharacteristic.unit));
-        }
-      }
-      
-      json_object_array_add( services, service ); 
-    }    
-  }
-  
-  *OutHapObjectJson = hapJsonObject;
-
-  return err;
-
-}
-
-
-
 OSStatus IDGetNext( 
         const uint8_t *     inSrc, 
         const uint8_t *     inEnd, 
@@ -642,36 +490,43 @@ OSStatus IDGetNext(
 
 
 
-HkStatus _HKCreateReadResponsePerCharacteristic(struct _hapAccessory_t inHapObject[], HK_Char_ID_t id, 
+/* Counts the characteristic, and adds it when the batch is allocated */
+static void _HKAddReadRequest(HK_Char_ID_t id, hk_char_request_t *requests, int *count)
+{
+  if(requests){
+    memset(&requests[*count], 0x0, sizeof(hk_char_request_t));
+    requests[*count].aid = id.aid;
+    requests[*count].iid = id.iid;
+    requests[*count].serviceID = id.serviceID;
+    requests[*count].characteristicID = id.characteristicID;
+  }
+  (*count)++;
+}
+
+/* Value and status come from HKReadCharacteristicBatch */
+HkStatus _HKCreateReadResponsePerCharacteristic(const hk_char_request_t *request, 
                                                 bool needMeta, bool needperms, bool needType, bool needEv, HK_Notify_t* notifyList,
-                                                json_object *inHapReadRespondJson, mico_Context_t * const inContext)
+                                                json_object *inHapReadRespondJson)
 {
-  HkStatus hkErr = kNoErr;
-  value_union value;
-  bool event;
+  HkStatus hkErr = request->status;
+  value_union value = request->value;
   static json_object *characteristic;
-  struct _hapCharacteristic_t pCharacteristic = ((inHapObject[id.aid-1]).services[id.serviceID-1]).characteristic[id.characteristicID-1];
+  struct _hapCharacteristic_t *pCharacteristic = HKCharacteristicByIID(request->aid, request->iid);
   
   characteristic = json_object_new_object();
   json_object_array_add(inHapReadRespondJson, characteristic);
-  json_object_object_add( characteristic, "aid", json_object_new_int(id.aid));
-  json_object_object_add( characteristic, "iid", json_object_new_int(id.iid));
+  json_object_object_add( characteristic, "aid", json_object_new_int(request->aid));
+  json_object_object_add( characteristic, "iid", json_object_new_int(request->iid));
 
-  if(pCharacteristic.secureRead == false){
-    hkErr = kHKReadFromWOErr;
-  }else if(id.serviceID == 0)
-    hkErr = kHKNotExistErr;
-  else{
-    if(pCharacteristic.hasStaticValue)
-      value = pCharacteristic.value;
-    else
-      hkErr = HKReadCharacteristicValue(id.aid, id.serviceID, id.characteristicID, &value, inContext);    
+  if(pCharacteristic == NULL){
+    json_object_object_add( characteristic, "status", json_object_new_int(kHKNotExistErr));
+    return kHKNotExistErr;
   }
 
   json_object_object_add( characteristic, "status", json_object_new_int(hkErr)); //If no err occure, remove this key before send the respond
 
   if(hkErr == kNoErr){
-    switch(pCharacteristic.valueType ){
+    switch(pCharacteristic->valueType ){
       case ValueType_bool:
         json_object_object_add( characteristic, "value", json_object_new_boolean(value.boolValue));
         break;
@@ -695,77 +550,77 @@ HkStatus _HKCreateReadResponsePerCharacteristic(struct _hapAccessory_t inHapObje
   }
 
   if(needMeta){
-     if(pCharacteristic.hasMinimumValue){
-      switch(pCharacteristic.valueType){
+     if(pCharacteristic->hasMinimumValue){
+      switch(pCharacteristic->valueType){
         case ValueType_int:
-          json_object_object_add( characteristic, "minValue",  json_object_new_int(pCharacteristic.minimumValue.intValue) );
+          json_object_object_add( characteristic, "minValue",  json_object_new_int(pCharacteristic->minimumValue.intValue) );
           break;
         case ValueType_float:
-          json_object_object_add( characteristic, "minValue",  json_object_new_double(pCharacteristic.minimumValue.floatValue) );
+          json_object_object_add( characteristic, "minValue",  json_object_new_double(pCharacteristic->minimumValue.floatValue) );
           break;
         default:
           break;
       }
     }
 
-    if(pCharacteristic.hasMaximumValue){
-      switch(pCharacteristic.valueType){
+    if(pCharacteristic->hasMaximumValue){
+      switch(pCharacteristic->valueType){
         case ValueType_int:
-          json_object_object_add( characteristic, "maxValue",  json_object_new_int(pCharacteristic.maximumValue.intValue) );
+          json_object_object_add( characteristic, "maxValue",  json_object_new_int(pCharacteristic->maximumValue.intValue) );
           break;
         case ValueType_float:
-          json_object_object_add( characteristic, "maxValue",  json_object_new_double(pCharacteristic.maximumValue.floatValue) );
+          json_object_object_add( characteristic, "maxValue",  json_object_new_double(pCharacteristic->maximumValue.floatValue) );
           break;
         default:
           break;
       }
     }
 
-    if(pCharacteristic.hasMinimumStep){
-      switch(pCharacteristic.valueType){
+    if(pCharacteristic->hasMinimumStep){
+      switch(pCharacteristic->valueType){
         case ValueType_int:
-          json_object_object_add( characteristic, "minStep",  json_object_new_int(pCharacteristic.minimumStep.intValue) );
+          json_object_object_add( characteristic, "minStep",  json_object_new_int(pCharacteristic->minimumStep.intValue) );
           break;
         case ValueType_float:
-          json_object_object_add( characteristic, "minStep",  json_object_new_double(pCharacteristic.minimumStep.floatValue) );
+          json_object_object_add( characteristic, "minStep",  json_object_new_double(pCharacteristic->minimumStep.floatValue) );
           break;
         default:
           break;
       }
     }
          
-    if(pCharacteristic.hasMaxLength)
-      json_object_object_add( characteristic, "maxLen",     json_object_new_int(pCharacteristic.maxLength));
+    if(pCharacteristic->hasMaxLength)
+      json_object_object_add( characteristic, "maxLen",     json_object_new_int(pCharacteristic->maxLength));
 
-    if(pCharacteristic.hasMaxDataLength)
-      json_object_object_add( characteristic, "maxDataLen",     json_object_new_int(pCharacteristic.maxDataLength));
+    if(pCharacteristic->hasMaxDataLength)
+      json_object_object_add( characteristic, "maxDataLen",     json_object_new_int(pCharacteristic->maxDataLength));
 
-    if(pCharacteristic.description)
-      json_object_object_add( characteristic, "description", json_object_new_string(pCharacteristic.description));
+    if(pCharacteristic->description)
+      json_object_object_add( characteristic, "description", json_object_new_string(pCharacteristic->description));
 
-    if(pCharacteristic.format)
-      json_object_object_add( characteristic, "format", json_object_new_string(pCharacteristic.format));
+    if(pCharacteristic->format)
+      json_object_object_add( characteristic, "format", json_object_new_string(pCharacteristic->format));
 
-    if(pCharacteristic.unit)
-      json_object_object_add( characteristic, "unit", json_object_new_string(pCharacteristic.unit));   
+    if(pCharacteristic->unit)
+      json_object_object_add( characteristic, "unit", json_object_new_string(pCharacteristic->unit));   
   }
 
   if(needperms){
     json_object *properties = json_object_new_array();
-    if(pCharacteristic.secureRead)
+    if(pCharacteristic->secureRead)
       json_object_array_add( properties, json_object_new_string("pr") );
-    if(pCharacteristic.secureWrite)
+    if(pCharacteristic->secureWrite)
       json_object_array_add( properties, json_object_new_string("pw") );
     json_object_object_add( characteristic, "perms", properties);
   }
 
   if(needType){
-    json_object_object_add( characteristic, "type", json_object_new_string(pCharacteristic.type));
+    json_object_object_add( characteristic, "type", json_object_new_string(pCharacteristic->type));
   }
 
   if(needEv){
-    if(pCharacteristic.hasEvents){
-      if(HKNotificationFind(id.aid, id.iid, notifyList)==kNoErr)
+    if(pCharacteristic->hasEvents){
+      if(HKNotificationFind(request->aid, request->iid, notifyList)==kNoErr)
         json_object_object_add( characteristic, "ev", json_object_new_boolean(true));
       else
         json_object_object_add( characteristic, "ev", json_object_new_boolean(false));
@@ -775,92 +630,99 @@ HkStatus _HKCreateReadResponsePerCharacteristic(struct _hapAccessory_t inHapObje
   return hkErr;
 }
 
-void _HKCreateWritePerCharacteristic(struct _hapAccessory_t inHapObject[], HK_Char_ID_t id, json_object *value_obj, bool moreComing, mico_Context_t * const inContext)
+/* Adds a write to the batch, strings point into value_obj until the batch is written */
+void _HKCreateWritePerCharacteristic(HK_Char_ID_t id, json_object *value_obj, hk_char_request_t *request)
 {
-  struct _hapCharacteristic_t pCharacteristic;
-  value_union value;
+  struct _hapCharacteristic_t *pCharacteristic = HKCharacteristicByIID(id.aid, id.iid);
+
+  memset(request, 0x0, sizeof(hk_char_request_t));
+  request->aid = id.aid;
+  request->iid = id.iid;
+  request->serviceID = id.serviceID;
+  request->characteristicID = id.characteristicID;
 
-  if(id.serviceID == 0 || id.characteristicID == 0)
+  if(pCharacteristic == NULL)
     return;
-  
-  pCharacteristic = ((inHapObject[id.aid-1]).services[id.serviceID-1]).characteristic[id.characteristicID-1];
-  
-  if( pCharacteristic.secureWrite == true && id.serviceID && id.characteristicID ){
-    switch(pCharacteristic.valueType ){
-      case ValueType_bool:
-        value.boolValue = json_object_get_boolean(value_obj);
-        break;
-      case ValueType_int:
-        value.intValue = json_object_get_int(value_obj);
-        break;
-      case ValueType_float:
-        value.floatValue = json_object_get_double(value_obj);
-        break;
-      case ValueType_string:
-        value.stringValue = (char *)json_object_get_string(value_obj);
-        break;
-      case ValueType_date:
-        value.stringValue = (char *)json_object_get_string(value_obj);
-        break;
-      case ValueType_null:
-        break;
-      default:
-        break;
-    }      
-    HKWriteCharacteristicValue(id.aid, id.serviceID, id.characteristicID, value, moreComing, inContext);    
+
+  switch(pCharacteristic->valueType ){
+    case ValueType_bool:
+      request->value.boolValue = json_object_get_boolean(value_obj);
+      break;
+    case ValueType_int:
+      request->value.intValue = json_object_get_int(value_obj);
+      break;
+    case ValueType_float:
+      request->value.floatValue = json_object_get_double(value_obj);
+      break;
+    case ValueType_string:
+      request->value.stringValue = (char *)json_object_get_string(value_obj);
+      break;
+    case ValueType_date:
+      request->value.stringValue = (char *)json_object_get_string(value_obj);
+      break;
+    case ValueType_null:
+      break;
+    default:
+      break;
   }
 }
 
-void _HKCreateWriteEVPerCharacteristic(struct _hapAccessory_t inHapObject[], HK_Char_ID_t id, json_object *value_obj, HK_Notify_t** notifyList, mico_Context_t * const inContext)
+/* The controller that wrote a value gets no event for it, but remembers it to detect the next change */
+static void _HKCreateWriteNotifyPerCharacteristic(const hk_char_request_t *write, HK_Notify_t** notifyList, hk_notify_session_t *notifySession)
 {
-  struct _hapCharacteristic_t pCharacteristic;
-  bool enableNotify = json_object_get_boolean(value_obj);
+  struct _hapCharacteristic_t *pCharacteristic;
   value_union value;
 
-  if(id.serviceID == 0 || id.characteristicID == 0)
+  if(write->serviceID == 0 || write->characteristicID == 0)
     return;
 
-  pCharacteristic = ((inHapObject[id.aid-1]).services[id.serviceID-1]).characteristic[id.characteristicID-1];
-  
-  if( pCharacteristic.hasEvents == true && id.serviceID && id.characteristicID ){
-    if(enableNotify){
-      FindCharacteristicByIID(hapObjects, id.aid, id.iid, &id.serviceID, &id.characteristicID);
-      HKReadCharacteristicValue(id.aid, id.serviceID, id.characteristicID, &value, inContext);
-      HKNotificationAdd(id.aid, id.iid, value, notifyList);
-    }else{
-      HKNotificationRemove(id.aid, id.iid, notifyList);
-    }
-  }
+  HKNotifySessionDiscard(notifySession, write->aid, write->iid);
+  if(write->status != kHKNoErr || HKNotificationFind(write->aid, write->iid, *notifyList) != kNoErr)
+    return;
+
+  /* Strings point into the request and are never compared, so only the other types are remembered */
+  pCharacteristic = HKCharacteristicByIID(write->aid, write->iid);
+  value = write->value;
+  if(pCharacteristic && (pCharacteristic->valueType == ValueType_string || pCharacteristic->valueType == ValueType_date))
+    value.stringValue = NULL;
+  HKNotificationAdd(write->aid, write->iid, value, notifyList);
+}
+
+/* Unsubscribes at once, a new subscription is queued to read its first value in the batch after the writes */
+static void _HKCreateWriteEVPerCharacteristic(HK_Char_ID_t id, json_object *value_obj, hk_char_request_t *subscribes, int *subscribeCount, HK_Notify_t** notifyList)
+{
+  struct _hapCharacteristic_t *pCharacteristic = HKCharacteristicByIID(id.aid, id.iid);
+
+  if(pCharacteristic == NULL || pCharacteristic->hasEvents == false)
+    return;
+
+  if(json_object_get_boolean(value_obj))
+    _HKAddReadRequest(id, subscribes, subscribeCount);
+  else
+    HKNotificationRemove(id.aid, id.iid, notifyList);
 }
 
 
-HkStatus _HKCreateWriteResponsePerCharacteristic(struct _hapAccessory_t inHapObject[], HK_Char_ID_t id, json_object *inHapReadRespondJson, bool check_value, bool check_event, mico_Context_t * const inContext)
+/* write is the result of HKWriteCharacteristicBatch, NULL if only "ev" was written */
+HkStatus _HKCreateWriteResponsePerCharacteristic(HK_Char_ID_t id, json_object *inHapReadRespondJson, const hk_char_request_t *write, bool check_event)
 {
   HkStatus hkErr = kNoErr;
-  value_union value;
-  bool event;
-  int httpStatus = kStatusOK;
   static json_object *characteristic;
-  struct _hapCharacteristic_t pCharacteristic = ((inHapObject[id.aid-1]).services[id.serviceID-1]).characteristic[id.characteristicID-1];
+  struct _hapCharacteristic_t *pCharacteristic = HKCharacteristicByIID(id.aid, id.iid);
   
   characteristic = json_object_new_object();
   json_object_array_add(inHapReadRespondJson, characteristic);
   json_object_object_add( characteristic, "aid", json_object_new_int(id.aid));
   json_object_object_add( characteristic, "iid", json_object_new_int(id.iid));
 
-  if(id.serviceID == 0 || id.characteristicID == 0)
+  if(pCharacteristic == NULL)
     return kHKNotExistErr;
 
-  if(check_value){
-    if(pCharacteristic.secureWrite == false){
-      hkErr = kHKWriteToROErr;
-    }else{
-      hkErr = HKReadCharacteristicStatus(id.aid, id.serviceID, id.characteristicID, inContext);    
-    }    
-  }
+  if(write)
+    hkErr = write->status;
   
   if(check_event){
-    if(!pCharacteristic.hasEvents && hkErr == kHKNoErr){
+    if(!pCharacteristic->hasEvents && hkErr == kHKNoErr){
       hkErr = kHKNotifyUnsupportErr;
     }
   }
@@ -879,8 +741,11 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
   printbuf *buffer = NULL;
   uint32_t idx;
   size_t arrayLen;
+  uint32_t traceStart = MICO_TRACE_TIMESTAMP();
+  MICO_TRACE_BEGIN("hk request");
   err = HKSocketReadHTTPHeader( sockfd, httpHeader, inHkContext->session );
   int accessoryID, serviceID, characteristicID;
+  const HK_Attribute_t *attribute;
   json_object *characteristics, *characteristic, *outCharacteristics, *outCharacteristic, *event_obj;
   json_object *value_obj = NULL;
   json_object *inhapJsonObject = NULL, *outhapJsonObject = NULL;
@@ -889,6 +754,8 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
   int status = kStatusOK;
   int aid, iid;
   HK_Char_ID_t id;
+  hk_char_request_t *requests = NULL, *subscribes, *write;
+  int requestCount, subscribeCount, pass;
 
   switch ( err )
   {
@@ -952,13 +819,7 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
 
           require_action( inHkContext->session->established == true, exit, err = kAuthenticationErr; status = kStatusAuthenticationErr );
 
-          err = HKCreateHAPAttriDataBase(hapObjects, *notifyList, &outhapJsonObject, inContext);
-          require_noerr( err, exit );
-          buffer = json_object_to_json_string_ex(outhapJsonObject);
-          ha_log("Json cstring generated, memory remains %d, %s", mico_memory_info()->free_memory, buffer->buf);
-          json_object_put(outhapJsonObject);
-          outhapJsonObject = NULL;
-          err = HKSendResponseMessage(sockfd, status, (uint8_t *)buffer->buf, strlen(buffer->buf), inHkContext->session);
+          err = HKAccessoryDBSend(sockfd, *notifyList, inHkContext->session, inContext);
           require_noerr(err, exit);
         }
         /*Read or write characteristics*/
@@ -988,29 +849,39 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
             bool needType = typePtr? *(uint8_t *)((uint8_t *)typePtr+strlen("type="))-0x30 :false;
 
 
-            const uint8_t *         src = (const uint8_t *) idPtr + strlen("id=");
+            const uint8_t * const   start = (const uint8_t *) idPtr + strlen("id=");
+            const uint8_t *         src;
             const uint8_t * const   end = idPtrEnd;
 
-            while( IDGetNext( src, end, &id.aid, &id.iid, &src ) == kNoErr ) //Not support ev, perm...
-            {
-              FindCharacteristicByIID(hapObjects, id.aid, id.iid, &id.serviceID, &id.characteristicID);
-              if(id.characteristicID == 0){ //Read every haracteristic in one service
-                for(id.characteristicID = 1; id.characteristicID <= MAXCharacteristicPerService; id.characteristicID++){
-                  if(hapObjects[id.aid-1].services[id.serviceID-1].characteristic[id.characteristicID-1].type == 0 )
-                    break;
-
-                  if(_HKCreateReadResponsePerCharacteristic(hapObjects, id, 
-                                                            needMeta, needPerms, needType, needEv, *notifyList,
-                                                            outCharacteristics, inContext)!=kHKNoErr)
-                    status = kStatusPartialContent;
-                  id.characteristicID ++;
+            /* Count the characteristics first, then collect them and read them in one batch */
+            for(pass = 0; pass < 2; pass++){
+              requestCount = 0;
+              src = start;
+              while( IDGetNext( src, end, &id.aid, &id.iid, &src ) == kNoErr ) //Not support ev, perm...
+              {
+                FindCharacteristicByIID(hapObjects, id.aid, id.iid, &id.serviceID, &id.characteristicID);
+                if(id.serviceID && id.characteristicID == 0){ //Read every haracteristic in one service, they follow the service iid
+                  for(attribute = HKAttributeByIID(id.aid, ++id.iid); attribute && attribute->characteristicID; attribute = HKAttributeByIID(id.aid, ++id.iid)){
+                    id.characteristicID = attribute->characteristicID;
+                    _HKAddReadRequest(id, requests, &requestCount);
+                  }
+                }else{ //Read single haracteristic
+                  _HKAddReadRequest(id, requests, &requestCount);
                 }
-              }else{ //Read single haracteristic
-                if(_HKCreateReadResponsePerCharacteristic(hapObjects, id, 
-                                                          needMeta, needPerms, needType, needEv, *notifyList,
-                                                          outCharacteristics, inContext)!=kHKNoErr)
-                  status = kStatusPartialContent;
               }
+              if(requests == NULL){
+                requests = calloc(Max(requestCount, 1), sizeof(hk_char_request_t));
+                require_action(requests, exit, err = kNoMemoryErr);
+              }
+            }
+
+            HKReadCharacteristicBatch(requests, requestCount, inContext);
+
+            for(idx = 0; idx < (uint32_t)requestCount; idx++){
+              if(_HKCreateReadResponsePerCharacteristic(&requests[idx], 
+                                                        needMeta, needPerms, needType, needEv, *notifyList,
+                                                        outCharacteristics)!=kHKNoErr)
+                status = kStatusPartialContent;
             }
             
             /* Remove status object if no error occured */
@@ -1044,8 +915,14 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
           outCharacteristics = json_object_new_array();
           json_object_object_add( outhapJsonObject, "characteristics", outCharacteristics);
 
-          /* Parse every value and write*/
+          /* Parse every value and subscription, then write all values and read the new subscriptions in two batches */
           arrayLen = json_object_array_length(characteristics);
+          requests = calloc(2 * Max(arrayLen, 1), sizeof(hk_char_request_t));
+          require_action(requests, exit, err = kNoMemoryErr);
+          subscribes = &requests[Max(arrayLen, 1)];
+          requestCount = 0;
+          subscribeCount = 0;
+
           for(idx = 0; idx < arrayLen; idx++){
 
             characteristic = json_object_array_get_idx(characteristics, idx);
@@ -1056,17 +933,23 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
             value_obj = json_object_object_get(characteristic, "value");
             event_obj = json_object_object_get(characteristic, "ev");
 
-            if(value_obj){
-              _HKCreateWritePerCharacteristic(hapObjects, id, value_obj, idx < arrayLen-1, inContext);
-          }
+            if(value_obj)
+              _HKCreateWritePerCharacteristic(id, value_obj, &requests[requestCount++]);
             if(event_obj){
               require_action(json_object_is_type(event_obj, json_type_boolean), exit, err = kMalformedErr);
-              _HKCreateWriteEVPerCharacteristic(hapObjects, id, event_obj, notifyList, inContext);
+              _HKCreateWriteEVPerCharacteristic(id, event_obj, subscribes, &subscribeCount, notifyList);
             }
           }
 
-          /* Read the write respond */
-          for(idx = 0; idx < arrayLen; idx++){
+          HKWriteCharacteristicBatch(requests, requestCount, inContext);
+
+          /* A subscription starts from the value after the writes */
+          HKReadCharacteristicBatch(subscribes, subscribeCount, inContext);
+          for(idx = 0; idx < (uint32_t)subscribeCount; idx++)
+            HKNotificationAdd(subscribes[idx].aid, subscribes[idx].iid, subscribes[idx].value, notifyList);
+
+          /* Read the write respond, writes are in the same order as in the request */
+          for(idx = 0, requestCount = 0; idx < arrayLen; idx++){
             characteristic = json_object_array_get_idx(characteristics, idx);
             id.aid = json_object_get_int(json_object_object_get(characteristic, "aid"));
             id.iid = json_object_get_int(json_object_object_get(characteristic, "iid"));
@@ -1075,7 +958,12 @@ OSStatus HKhandleIncomeingMessage(int sockfd, HTTPHeader_t *httpHeader, HK_Notif
             value_obj = json_object_object_get(characteristic, "value");
             event_obj = json_object_object_get(characteristic, "ev");
 
-            if(_HKCreateWriteResponsePerCharacteristic(hapObjects, id, outCharacteristics, value_obj, event_obj, inContext)!=kHKNoErr)
+            /* Every value is applied by now */
+            write = value_obj? &requests[requestCount++] : NULL;
+            if(write)
+              _HKCreateWriteNotifyPerCharacteristic(write, notifyList, inHkContext->notifySession);
+
+            if(_HKCreateWriteResponsePerCharacteristic(id, outCharacteristics, write, event_obj != NULL)!=kHKNoErr)
               status = kStatusPartialContent;               
           }
 
@@ -1144,7 +1032,10 @@ exit:
   HTTPHeaderClear( httpHeader );
   if(outhapJsonObject) json_object_put(outhapJsonObject);
   if(inhapJsonObject) json_object_put(inhapJsonObject);
+  if(requests) free(requests);
   if(buffer) printbuf_free(buffer);
+  MICO_TRACE_END("hk request");
+  MICO_TRACE_HISTOGRAM_ADD(hk_request_histogram, traceStart);
   return err;
 
 }
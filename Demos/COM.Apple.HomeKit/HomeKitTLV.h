@@ -48,6 +48,8 @@
 
 // [bytes] Last fragment of data
 #define kTLVType_FragmentLast           0x0D
+// [bytes] Identifier of a pair verify session that can be resumed
+#define kTLVType_SessionID              0x0E
 
 // [null] Zero-length TLV that separates different TLVs in a list.
 #define kTLVType_Separator              0xFF
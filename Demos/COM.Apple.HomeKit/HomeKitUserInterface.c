@@ -1,6 +1,7 @@
 #include "Common.h"
 #include "MICODefine.h"
 #include "HomeKitProfiles.h"
+#include "HomeKitNotify.h"
 #include "StringUtils.h"
 #include "MDNSUtils.h"
 #include "rgb_led.h"
@@ -230,22 +231,26 @@ void HKWriteCharacteristicValue(int accessoryID, int serviceID, int characterist
 
     if(inContext->appStatus.service.on_status == kHKBusyErr){
       inContext->appStatus.service.on = inContext->appStatus.service.on_new;
-      inContext->appStatus.service.on_status = kNoErr;      
+      inContext->appStatus.service.on_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 1);
     }
 
     if(inContext->appStatus.service.brightness_status == kHKBusyErr){
       inContext->appStatus.service.brightness = inContext->appStatus.service.brightness_new;
       inContext->appStatus.service.brightness_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 2);
     }
 
     if(inContext->appStatus.service.hue_status == kHKBusyErr){
       inContext->appStatus.service.hue = inContext->appStatus.service.hue_new; 
       inContext->appStatus.service.hue_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 3);
     }
 
     if(inContext->appStatus.service.saturation_status == kHKBusyErr){
       inContext->appStatus.service.saturation = inContext->appStatus.service.saturation_new;
       inContext->appStatus.service.saturation_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 4);
     }
     
     if( inContext->appStatus.service.on == false)
@@ -261,32 +266,37 @@ void HKWriteCharacteristicValue(int accessoryID, int serviceID, int characterist
     if(inContext->appStatus.service.heating_cooling_target_status == kHKBusyErr){
       strncpy(inContext->appStatus.service.heating_cooling_target, inContext->appStatus.service.heating_cooling_target_new, 16);
       inContext->appStatus.service.heating_cooling_target_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 2);
     }
 
     if(inContext->appStatus.service.temperature_target_status == kHKBusyErr){
       inContext->appStatus.service.temperature_target = inContext->appStatus.service.temperature_target_new;  
       inContext->appStatus.service.temperature_target_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 4);
     }
 
     if(inContext->appStatus.service.temperature_units_status == kHKBusyErr){
       strncpy(inContext->appStatus.service.temperature_units, inContext->appStatus.service.temperature_units_new, 16);
       inContext->appStatus.service.temperature_units_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 5);
     }
 
     if(inContext->appStatus.service.relative_humidity_target_status == kHKBusyErr){
       inContext->appStatus.service.relative_humidity_target = inContext->appStatus.service.relative_humidity_target_new;  
       inContext->appStatus.service.relative_humidity_target_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 7);
     }
 
     if(inContext->appStatus.service.heating_threshold_status == kHKBusyErr){
       inContext->appStatus.service.heating_threshold = inContext->appStatus.service.heating_threshold_new;  
       inContext->appStatus.service.heating_threshold_status = kNoErr;
+      HKCharacteristicChangedByID(1, 2, 8);
     }
 
     if(inContext->appStatus.service.cooling_threshold_status == kHKBusyErr){
       inContext->appStatus.service.cooling_threshold = inContext->appStatus.service.cooling_threshold_new;  
       inContext->appStatus.service.cooling_threshold_status = kNoErr;
-      
+      HKCharacteristicChangedByID(1, 2, 9);
     }
 #endif   
   }
@@ -4,6 +4,10 @@
 #include "MICODefine.h"
 #include "platform_config.h"
 
+extern HkStatus HKReadCharacteristicValue(int accessoryID, int serviceID, int characteristicID, value_union *value, mico_Context_t * const inContext);
+extern void HKWriteCharacteristicValue(int accessoryID, int serviceID, int characteristicID, value_union value, bool moreComing, mico_Context_t * const inContext);
+extern HkStatus HKReadCharacteristicStatus(int accessoryID, int serviceID, int characteristicID, mico_Context_t * const inContext);
+
 const struct _hapAccessory_t hapObjects[NumberofAccessories] = 
 {
   {
@@ -225,3 +229,100 @@ const struct _hapAccessory_t hapObjects[NumberofAccessories] =
     }
   }
 };
+
+/* Batch transactions. The server hands every read or write of one request to the accessory
+   in a single call, so an accessory that talks to its hardware over a slow link (a UART
+   MCU for example) can serve them in one exchange by implementing HKReadCharacteristicValues
+   and HKWriteCharacteristicValues. The defaults below fall back to the single characteristic
+   functions. */
+
+static const struct _hapCharacteristic_t *_ProfileCharacteristic(const hk_char_request_t *request)
+{
+  const struct _hapCharacteristic_t *pCharacteristic;
+
+  if(request->aid < 1 || request->aid > NumberofAccessories)
+    return NULL;
+  if(request->serviceID < 1 || request->serviceID > MAXServicePerAccessory)
+    return NULL;
+  if(request->characteristicID < 1 || request->characteristicID > MAXCharacteristicPerService)
+    return NULL;
+
+  pCharacteristic = &hapObjects[request->aid-1].services[request->serviceID-1].characteristic[request->characteristicID-1];
+  return pCharacteristic->type? pCharacteristic : NULL;
+}
+
+WEAK void HKReadCharacteristicValues(hk_char_request_t *requests, int count, mico_Context_t * const inContext)
+{
+  int idx;
+
+  for(idx = 0; idx < count; idx++){
+    if(requests[idx].status == kHKBusyErr)
+      requests[idx].status = HKReadCharacteristicValue(requests[idx].aid, requests[idx].serviceID, requests[idx].characteristicID, &requests[idx].value, inContext);
+  }
+}
+
+/* Values are only applied with the last write, which is when moreComing is false */
+WEAK void HKWriteCharacteristicValues(hk_char_request_t *requests, int count, mico_Context_t * const inContext)
+{
+  int idx, last = -1;
+
+  for(idx = 0; idx < count; idx++){
+    if(requests[idx].status == kHKBusyErr)
+      last = idx;
+  }
+
+  for(idx = 0; idx <= last; idx++){
+    if(requests[idx].status == kHKBusyErr)
+      HKWriteCharacteristicValue(requests[idx].aid, requests[idx].serviceID, requests[idx].characteristicID, requests[idx].value, idx < last, inContext);
+  }
+
+  for(idx = 0; idx <= last; idx++){
+    if(requests[idx].status == kHKBusyErr)
+      requests[idx].status = HKReadCharacteristicStatus(requests[idx].aid, requests[idx].serviceID, requests[idx].characteristicID, inContext);
+  }
+}
+
+void HKReadCharacteristicBatch(hk_char_request_t *requests, int count, mico_Context_t * const inContext)
+{
+  const struct _hapCharacteristic_t *pCharacteristic;
+  int idx, pending = 0;
+
+  for(idx = 0; idx < count; idx++){
+    pCharacteristic = _ProfileCharacteristic(&requests[idx]);
+    if(pCharacteristic == NULL){
+      requests[idx].status = kHKNotExistErr;
+    }else if(pCharacteristic->secureRead == false){
+      requests[idx].status = kHKReadFromWOErr;
+    }else if(pCharacteristic->hasStaticValue){
+      requests[idx].value = pCharacteristic->value;
+      requests[idx].status = kHKNoErr;
+    }else{
+      requests[idx].status = kHKBusyErr;
+      pending++;
+    }
+  }
+
+  if(pending)
+    HKReadCharacteristicValues(requests, count, inContext);
+}
+
+void HKWriteCharacteristicBatch(hk_char_request_t *requests, int count, mico_Context_t * const inContext)
+{
+  const struct _hapCharacteristic_t *pCharacteristic;
+  int idx, pending = 0;
+
+  for(idx = 0; idx < count; idx++){
+    pCharacteristic = _ProfileCharacteristic(&requests[idx]);
+    if(pCharacteristic == NULL){
+      requests[idx].status = kHKNotExistErr;
+    }else if(pCharacteristic->secureWrite == false){
+      requests[idx].status = kHKWriteToROErr;
+    }else{
+      requests[idx].status = kHKBusyErr;
+      pending++;
+    }
+  }
+
+  if(pending)
+    HKWriteCharacteristicValues(requests, count, inContext);
+}
@@ -116,6 +116,19 @@ struct _hapAccessory_t {
   struct _hapService_t  services[MAXServicePerAccessory];
 };
 
+/* One characteristic of a batch read or write. The server fills the IDs (and the value to
+   write), HKReadCharacteristicBatch/HKWriteCharacteristicBatch answer what the profile
+   can answer and leave the rest in kHKBusyErr for the accessory, which sets the status
+   (and the value read) of every entry it handles. */
+typedef struct _hk_char_request_t {
+  int          aid;
+  int          iid;
+  int          serviceID;
+  int          characteristicID;
+  value_union  value;
+  HkStatus     status;
+} hk_char_request_t;
+
 
 #endif
 
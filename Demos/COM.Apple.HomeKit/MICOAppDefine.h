@@ -34,7 +34,7 @@
 #define SERIAL_NUMBER       "20140606"
 #define PROTOCOL            "com.apple.homekit"
 #define LOCAL_PORT          8080
-#define CONFIGURATION_VERSION    0x00010002 // if changed default configuration, add this num
+#define CONFIGURATION_VERSION    0x00010003 // if changed default configuration, add this num
 
 /* Wi-Fi configuration mode */
 //#define MICO_CONFIG_MODE CONFIG_MODE_EASYLINK_WITH_SOFTAP
@@ -65,6 +65,8 @@ typedef struct
   /*Homekit*/
   bool              haPairSetupFinished;
   uint8_t           LTSK[64]; 
+  uint32_t          haConfigNumber;           /* C# in the Bonjour TXT record */
+  uint8_t           haDBDigest[20];           /* SHA-1 of the accessory database haConfigNumber belongs to */
 
 } application_config_t;
 
@@ -23,6 +23,7 @@
 #include "MICODefine.h"
 #include "MICOAppDefine.h"
 #include "HomeKitPairList.h"
+#include "HomeKitAccessoryDB.h"
 
 #include "StringUtils.h"
 
@@ -38,6 +39,8 @@ void appRestoreDefault_callback(mico_Context_t *inContext)
   inContext->flashContentInRam.appConfig.configDataVer = CONFIGURATION_VERSION;
   inContext->flashContentInRam.appConfig.haPairSetupFinished = false;
   memset(inContext->flashContentInRam.appConfig.LTSK, 0x0, 64);
+  inContext->flashContentInRam.appConfig.haConfigNumber = 1;
+  memset(inContext->flashContentInRam.appConfig.haDBDigest, 0x0, 20);
   HMClearPairList();
 }
 
@@ -55,6 +58,10 @@ OSStatus MICOStartApplication( mico_Context_t * const inContext )
   else
     inContext->appStatus.useMFiAuth = false;
 
+  /*The configuration number is announced by Bonjour*/
+  err = HKAccessoryDBInit( inContext );
+  require_noerr_action( err, exit, app_log("ERROR: Unable to build the accessory database.") );
+
   /*Bonjour for service searching*/
   if(inContext->flashContentInRam.micoSystemConfig.bonjourEnable == true)
     MICOStartBonjourService( Station, inContext );
@@ -26,6 +26,7 @@
 
 #include "MDNSUtils.h"
 #include "StringUtils.h"
+#include "HomeKitAccessoryDB.h"
 #include "MDNSUtils.h"
 
 static int _bonjourStarted = false;
@@ -84,7 +85,7 @@ OSStatus MICOStartBonjourService( WiFi_Interface interface, mico_Context_t * con
   init.service_port = HA_SERVER_PORT;
   init.interface = interface;
 
-  sprintf(temp_txt, "C#=%d.", 0x01);
+  sprintf(temp_txt, "C#=%u.", (unsigned int)HKAccessoryDBConfigNumber());
 
   if(inContext->appStatus.useMFiAuth == true)
     sprintf(temp_txt, "%sff=%d.", temp_txt, 0x01);
@@ -136,39 +137,21 @@ exit:
 
 void HKBonjourUpdateStateNumber( mico_Context_t * const inContext )
 {
-  char temp_txt[500]; 
-  char *temp_txt2;
-
-  sprintf(temp_txt, "C#=%d.", 0x01);
-
-  if(inContext->appStatus.useMFiAuth == true)
-    sprintf(temp_txt, "%sff=%d.", temp_txt, 0x01);
-  else
-    sprintf(temp_txt, "%sff=%d.", temp_txt, 0x00);
-
-  temp_txt2 = __strdup_trans_dot(inContext->micoStatus.mac);
-  sprintf(temp_txt, "%sid=%s.", temp_txt, temp_txt2);
-  free(temp_txt2);
-
-  temp_txt2 = __strdup_trans_dot(MODEL);
-  sprintf(temp_txt, "%smd=%s.", temp_txt, temp_txt2);
-  free(temp_txt2);
+  char temp_txt[12]; 
 
-  temp_txt2 = __strdup_trans_dot(HA_PV);
-  sprintf(temp_txt, "%spv=%s.", temp_txt, temp_txt2);
-  free(temp_txt2);
-
-  sprintf(temp_txt, "%ss#=%d.", temp_txt, ++(inContext->appStatus.statusNumber));
-
-  sprintf(temp_txt, "%ssf=%d.", temp_txt, 0x05);
-  
-  sprintf( temp_txt, "%sci=%d.", temp_txt, CATEGORY_IDENTIFIER );
-
-  temp_txt2 = __strdup_trans_dot(HA_SV);
-  sprintf(temp_txt, "%ssv=%s.", temp_txt, temp_txt2);
-  free(temp_txt2);
+  /* Only s# changes, so only the TXT record is announced again */
+  sprintf(temp_txt, "%d", ++(inContext->appStatus.statusNumber));
+  bonjour_update_txt_value("s#", temp_txt);
+}
 
-  sprintf(temp_txt, "%sSeed=%u.", temp_txt, inContext->flashContentInRam.micoSystemConfig.seed);
+void HKBonjourUpdateConfigNumber( mico_Context_t * const inContext )
+{
+  char temp_txt[12]; 
 
-  bonjour_update_txt_record(temp_txt) ;
+  (void)inContext;
+  /* The TXT record is created with the current number when Bonjour starts */
+  if(_bonjourStarted == false)
+    return;
+  sprintf(temp_txt, "%u", (unsigned int)HKAccessoryDBConfigNumber());
+  bonjour_update_txt_value("C#", temp_txt);
 }
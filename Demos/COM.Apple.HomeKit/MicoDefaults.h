@@ -40,6 +40,9 @@ extern "C"
  /* Application thread stack size */
 #define MICO_DEFAULT_APPLICATION_STACK_SIZE         (2500)
 
+/* Record logs into a RAM ring and print them from a low priority thread, see MICOLog.h */
+//#define MICO_LOG_DEFERRED
+
 #ifdef __cplusplus
 } /*extern "C" */
 #endif
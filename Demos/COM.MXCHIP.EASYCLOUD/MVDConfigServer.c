@@ -32,10 +32,12 @@
 #include "MICO.h"
 #include "MICODefine.h"
 #include "SocketUtils.h"
+#include "HTTPUtils.h"
 #include "Platform.h"
 
 #include "EasyCloudUtils.h"
 #include "MicoVirtualDevice.h"
+#include "MICOConfigReport.h"
 
 
 #define config_log(M, ...) custom_log("CONFIG SERVER", M, ##__VA_ARGS__)
@@ -56,7 +58,6 @@
 #define kCONFIGURLDevFWUpdate          "/dev-fw_update"
 
 extern OSStatus     ConfigIncommingJsonMessage( const char *input, mico_Context_t * const inContext );
-extern json_object* ConfigCreateReportJsonMessage( mico_Context_t * const inContext );
 extern OSStatus getMVDActivateRequestData(const char *input, MVDActivateRequestData_t *activateData);
 extern OSStatus getMVDAuthorizeRequestData(const char *input, MVDAuthorizeRequestData_t *authorizeData);
 extern OSStatus getMVDResetRequestData(const char *input, MVDResetRequestData_t *devResetData);
@@ -215,6 +216,7 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, ECS_HTTPHeader_t* inHeader,
   uint8_t *httpResponse = NULL;
   size_t httpResponseLen = 0;
   json_object* report = NULL;
+  mico_config_report_t *configReport = NULL;
   config_log_trace();
   
   MVDActivateRequestData_t devActivateRequestData;
@@ -237,17 +239,14 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, ECS_HTTPHeader_t* inHeader,
 
   //config_log("recv=%s", inHeader->buf);
   if(ECS_HTTPHeaderMatchURL( inHeader, kCONFIGURLRead ) == kNoErr){    
-    report = ConfigCreateReportJsonMessage( inContext );
-    require( report, exit );
-    json_str = json_object_to_json_string(report);
-    require_action( json_str, exit, err = kNoMemoryErr );
+    configReport = MICOConfigReportRetain( inContext );
+    require_action( configReport, exit, err = kNoMemoryErr );
+    json_str = configReport->json;
     config_log("Send config object=%s", json_str);
     err =  ECS_CreateSimpleHTTPMessageNoCopy( ECS_kMIMEType_JSON, strlen(json_str), &httpResponse, &httpResponseLen );
     require_noerr( err, exit );
     require( httpResponse, exit );
-    err = SocketSend( fd, httpResponse, httpResponseLen );
-    require_noerr( err, exit );
-    err = SocketSend( fd, (uint8_t *)json_str, strlen(json_str) );
+    err = SocketSendHTTPMessage( fd, httpResponse, httpResponseLen, (uint8_t *)json_str, strlen(json_str) );
     require_noerr( err, exit );
     config_log("Current configuration sent");
     SocketClose(&fd);
@@ -460,6 +459,7 @@ exit:
       
   if(httpResponse)  free(httpResponse);
   if(report)        json_object_put(report);
+  if(configReport)  MICOConfigReportRelease(configReport);
 
   return err;
 }
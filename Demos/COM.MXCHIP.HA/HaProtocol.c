@@ -2,10 +2,13 @@
 #include "MICOAppDefine.h"
 #include "HAProtocol.h"
 #include "SocketUtils.h"
+#include "ChecksumUtils.h"
 #include "debug.h"
 #include "MicoPlatform.h"
 #include "platform_common_config.h"
 #include "MICONotificationCenter.h"
+#include "MICOWorkQueue.h"
+#include "MICOTrace.h"
 #include <stdio.h>
 
 #define ha_log(M, ...) custom_log("HA Command", M, ##__VA_ARGS__)
@@ -15,13 +18,17 @@
 static uint32_t network_state = 0;
 static mico_mutex_t _mutex;
 
-static int _recved_uart_loopback_fd = -1;
+/* UART data waiting in client queues, new packets are dropped above this */
+#define MAX_SOCK_MSG_LEN (10*1024)
+static int sockmsg_len = 0;
 
-static uint16_t _calc_sum(void *data, uint32_t len);
+/* From the UART read to the TCP write, including the time spent in the client queue */
+MICO_TRACE_HISTOGRAM(uart_to_tcp_histogram, "uart to tcp");
+
+static void _set_cmd(uint8_t *inBuf, int inLen, uint16_t cmd, uint16_t cmd_status);
 static OSStatus _ota_process(uint8_t *inBuf, int inBufLen, int *inSocketFd, mico_Context_t * const inContext);
-static mico_thread_t    _report_status_thread_handler = NULL;
-static mico_semaphore_t _report_status_sem = NULL;
-static void _report_status_thread(void *inContext);
+static mico_work_t      _report_status_work;
+static void _report_status(void *inContext);
 
 void haNotify_WifiStatusHandler(int event, mico_Context_t * const inContext)
 {
@@ -78,7 +85,7 @@ static void _get_status(mxchip_state_t *cmd, mico_Context_t * const inContext)
   strncpy(cmd->status.dns, inContext->micoStatus.dnsServer, maxIpLen);
   strncpy(cmd->status.mac, inContext->micoStatus.mac, 18);
 
-  cksum = _calc_sum(cmd, sizeof(mxchip_state_t) - 2);
+  cksum = InternetChecksum(cmd, sizeof(mxchip_state_t) - 2);
   cmd->cksum = cksum;
 }
 
@@ -97,7 +104,7 @@ void set_network_state(int state, int on)
   }
   
   if ((state == STA_CONNECT) || (state == REMOTE_CONNECT)){
-    mico_rtos_set_semaphore(&_report_status_sem);
+    MICOQueueWork(&_report_status_work);
   }  
   mico_rtos_unlock_mutex(&_mutex);
 }
@@ -107,20 +114,15 @@ OSStatus haProtocolInit(mico_Context_t * const inContext)
 {
   ha_log_trace();
   OSStatus err = kUnknownErr;
-  struct sockaddr_t addr;
-
+  int i;
 
   mico_rtos_init_mutex(&_mutex);
-  mico_rtos_init_semaphore(&_report_status_sem, 1);
+  MICOInitWork(&_report_status_work, _report_status, (void*)inContext);
 
-  _recved_uart_loopback_fd = socket(AF_INET, SOCK_DGRM, IPPROTO_UDP);
-  addr.s_ip = IPADDR_LOOPBACK;
-  addr.s_port = RECVED_UART_DATA_LOOPBACK_PORT;
-  bind(_recved_uart_loopback_fd, &addr, sizeof(addr));
+  for(i=0; i < MAX_QUEUE_NUM; i++)
+    inContext->appStatus.socket_out_queue[i] = NULL;
+  mico_rtos_init_mutex(&inContext->appStatus.queue_mtx);
   
-  err = mico_rtos_create_thread(&_report_status_thread_handler, MICO_APPLICATION_PRIORITY, "Report", _report_status_thread, 0x500, (void*)inContext );
-  require_noerr_action( err, exit, ha_log("ERROR: Unable to start the status report thread.") );
-
   /* Regisist notifications */
   err = MICOAddNotification( mico_notify_WIFI_STATUS_CHANGED, (void *)haNotify_WifiStatusHandler );
   require_noerr( err, exit ); 
@@ -128,15 +130,13 @@ exit:
   return err;
 }
 
-void _report_status_thread(void *inContext)
+/* Runs on the MICO work queue, changes that arrive before it runs are reported once */
+void _report_status(void *inContext)
 {
   mxchip_state_t cmd;
 
-  while(1){
-    mico_rtos_get_semaphore(&_report_status_sem, MICO_WAIT_FOREVER);
-    _get_status(&cmd, inContext);
-    MicoUartSend(UART_FOR_APP,(uint8_t *)&cmd, sizeof(mxchip_state_t));
-  }
+  _get_status(&cmd, inContext);
+  MicoUartSend(UART_FOR_APP,(uint8_t *)&cmd, sizeof(mxchip_state_t));
 }
 
 OSStatus haWlanCommandProcess(unsigned char *inBuf, int *inBufLen, int inSocketFd, mico_Context_t * const inContext)
@@ -154,13 +154,12 @@ OSStatus haWlanCommandProcess(unsigned char *inBuf, int *inBufLen, int inSocketF
     require_action(inBuf[idx+1] == 0x0, exit, err = kFormatErr);
     cmdLen  = inBuf[idx+6] + (inBuf[idx+7]<<8) + HA_CMD_HEAD_SIZE + 2;
     if(cmdLen > *inBufLen - idx) goto needsMoreData;
-    err = check_sum(inBuf+idx+HA_CMD_HEAD_SIZE, cmdLen);
+    err = check_sum(inBuf+idx, cmdLen);
     require_noerr(err, exit);
 
     p_reply = (mxchip_cmd_head_t *)(inBuf+idx);
-    p_reply->cmd_status = CMD_OK;
     cmd = p_reply->cmd;
-    p_reply->cmd |= 0x8000;
+    _set_cmd(inBuf+idx, cmdLen, cmd | 0x8000, CMD_OK);
     switch (cmd) {
       case CMD_READ_VERSION:
       case CMD_READ_CONFIG:
@@ -273,37 +272,142 @@ exit:
 }
 #endif
 
+/* UART data is copied once into a socket_msg_t and the same message is pushed to the out queue
+   of every connected client, the last client that has sent it frees it. Reference counts and
+   sockmsg_len are only changed with queue_mtx held */
+static void _socket_msg_free(socket_msg_t *msg)
+{
+  msg->ref--;
+  if (msg->ref == 0) {
+    sockmsg_len -= (sizeof(socket_msg_t) - 1 + msg->len);
+    free(msg);
+  }
+}
+
+static OSStatus _publish_uart_data(uint8_t *inBuf, int inLen, mico_Context_t * const inContext)
+{
+  OSStatus err = kNoErr;
+  int i;
+  mico_queue_t *p_queue;
+  socket_msg_t *msg;
+
+  require_action_quiet(sockmsg_len <= MAX_SOCK_MSG_LEN, exit, err = kNoMemoryErr);
+  msg = (socket_msg_t*)malloc(sizeof(socket_msg_t) - 1 + inLen);
+  require_action(msg, exit, err = kNoMemoryErr);
+  msg->ref = 1;
+  msg->len = inLen;
+  msg->trace_start = MICO_TRACE_TIMESTAMP();
+  memcpy(msg->data, inBuf, inLen);
+
+  mico_rtos_lock_mutex(&inContext->appStatus.queue_mtx);
+  sockmsg_len += (sizeof(socket_msg_t) - 1 + inLen);
+  for(i=0; i < MAX_QUEUE_NUM; i++) {
+    p_queue = inContext->appStatus.socket_out_queue[i];
+    if(p_queue == NULL)
+      continue;
+    msg->ref++;
+    /* A client that has MAX_QUEUE_LENGTH packets waiting misses this one */
+    if (mico_rtos_push_to_queue(p_queue, &msg, 0) != kNoErr)
+      msg->ref--;
+  }
+  _socket_msg_free(msg);
+  mico_rtos_unlock_mutex(&inContext->appStatus.queue_mtx);
+
+exit:
+  return err;
+}
+
+OSStatus socket_queue_create(mico_Context_t * const inContext, mico_queue_t *queue)
+{
+  OSStatus err;
+  int i;
+
+  *queue = NULL;
+  err = mico_rtos_init_queue(queue, "sockqueue", sizeof(socket_msg_t *), MAX_QUEUE_LENGTH);
+  require_noerr_action(err, exit, *queue = NULL);
+
+  err = kNoResourcesErr;
+  mico_rtos_lock_mutex(&inContext->appStatus.queue_mtx);
+  for(i=0; i < MAX_QUEUE_NUM; i++) {
+    if(inContext->appStatus.socket_out_queue[i] == NULL) {
+      inContext->appStatus.socket_out_queue[i] = queue;
+      err = kNoErr;
+      break;
+    }
+  }
+  mico_rtos_unlock_mutex(&inContext->appStatus.queue_mtx);
+
+  if (err != kNoErr) {
+    mico_rtos_deinit_queue(queue);
+    *queue = NULL;
+  }
+
+exit:
+  return err;
+}
+
+void socket_queue_delete(mico_Context_t * const inContext, mico_queue_t *queue)
+{
+  int i;
+  socket_msg_t *msg;
+
+  mico_rtos_lock_mutex(&inContext->appStatus.queue_mtx);
+  for(i=0; i < MAX_QUEUE_NUM; i++) {
+    if (queue == inContext->appStatus.socket_out_queue[i])
+      inContext->appStatus.socket_out_queue[i] = NULL;
+  }
+  while(kNoErr == mico_rtos_pop_from_queue(queue, &msg, 0))
+    _socket_msg_free(msg);
+  mico_rtos_unlock_mutex(&inContext->appStatus.queue_mtx);
+
+  mico_rtos_deinit_queue(queue);
+  *queue = NULL;
+}
+
+/* Send every message waiting in the queue with one SocketSendv, so a burst of short UART
+   reads goes out in as few TCP segments as possible */
+OSStatus socket_queue_send(mico_Context_t * const inContext, int fd, mico_queue_t *queue)
+{
+  OSStatus err = kNoErr;
+  socket_msg_t *msg[MAX_QUEUE_LENGTH];
+  iovec_t iov[MAX_QUEUE_LENGTH];
+  int count = 0, i;
+
+  while (count < MAX_QUEUE_LENGTH && kNoErr == mico_rtos_pop_from_queue(queue, &msg[count], 0)) {
+    iov[count].iov_base = msg[count]->data;
+    iov[count].iov_len = msg[count]->len;
+    count++;
+  }
+
+  if (count > 0) {
+    MICO_TRACE_BEGIN("tcp send");
+    err = SocketSendv(fd, iov, count);
+    MICO_TRACE_END("tcp send");
+  }
+
+  mico_rtos_lock_mutex(&inContext->appStatus.queue_mtx);
+  for (i = 0; i < count; i++) {
+    MICO_TRACE_HISTOGRAM_ADD(uart_to_tcp_histogram, msg[i]->trace_start);
+    _socket_msg_free(msg[i]);
+  }
+  mico_rtos_unlock_mutex(&inContext->appStatus.queue_mtx);
+  return err;
+}
+
 OSStatus haUartCommandProcess(uint8_t *inBuf, int inLen, mico_Context_t * const inContext)
 {
   ha_log_trace();
   OSStatus err = kNoErr;
-  int i, control;
+  int control;
   mxchip_cmd_head_t *cmd_header;
   uint16_t cksum;
-    struct sockaddr_t addr;
 
   cmd_header = (mxchip_cmd_head_t *)inBuf;
 
   switch(cmd_header->cmd) {
     case CMD_COM2NET:
-        cmd_header->cmd |= 0x8000;
-
-        addr.s_ip = IPADDR_LOOPBACK;
-
-
-        for(i=0; i < MAX_Local_Client_Num; i++) {
-          if( inContext->appStatus.loopBack_PortList[i] != 0 ){
-            addr.s_port = inContext->appStatus.loopBack_PortList[i];
-            sendto(_recved_uart_loopback_fd, inBuf, inLen, 0, &addr, sizeof(addr));
-          }
-        }
-
-        if(is_network_state(REMOTE_CONNECT)==1){
-          addr.s_ip = IPADDR_LOOPBACK;
-          addr.s_port = REMOTE_TCP_CLIENT_LOOPBACK_PORT;
-          sendto(_recved_uart_loopback_fd, inBuf, inLen, 0, &addr, sizeof(addr));
-        }
-        
+        _set_cmd(inBuf, inLen, cmd_header->cmd | 0x8000, cmd_header->cmd_status);
+        err = _publish_uart_data(inBuf, inLen, inContext);
         break;
         
     case CMD_GET_STATUS:
@@ -341,7 +445,7 @@ OSStatus haUartCommandProcess(uint8_t *inBuf, int inLen, mico_Context_t * const
         cmd_header->cmd |= 0x8000;
         cmd_header->cmd_status = 1;
         cmd_header->datalen = 0;
-        cksum = _calc_sum(inBuf, 8);
+        cksum = InternetChecksum(inBuf, 8);
         inBuf[8] = cksum & 0x00ff;
         inBuf[9] = (cksum & 0x0ff00) >> 8;
         err = MicoUartSend(UART_FOR_APP, inBuf, 10);
@@ -354,46 +458,30 @@ exit:
 }
 
 
+/* Packet format: BB 00 CMD(2B) Status(2B) datalen(2B) data(x) checksum(2B), the checksum
+   is the Internet checksum of everything before it, little endian */
 OSStatus check_sum(void *inData, uint32_t inLen)  
 {
   ha_log_trace();
-
-  uint16_t *sum;
   uint8_t *p = (uint8_t *)inData;
 
-  return kNoErr; 
-  // TODO: real cksum
-  p += inLen - 2;
-
-  sum = (uint16_t *)p;
-
-  if (_calc_sum(inData, inLen - 2) != *sum) {  // check sum error    
+  if (inLen < HA_CMD_HEAD_SIZE + 2)
+    return kSizeErr;
+  if (InternetChecksum(p, inLen - 2) != ReadLittle16(p + inLen - 2))
     return kChecksumErr;
-  }
   return kNoErr;
 }
 
-uint16_t _calc_sum(void *inData, uint32_t inLen)
+/* Changes the header of a packet that is forwarded and patches its checksum to match, cmd
+   and cmd_status are at even offsets so only these words are summed again */
+static void _set_cmd(uint8_t *inBuf, int inLen, uint16_t cmd, uint16_t cmd_status)
 {
-  ha_log_trace();
-  uint32_t cksum=0;
-  uint16_t *p=inData;
-
-  while (inLen > 1)
-  {
-    cksum += *p++;
-    inLen -=2;
-  }
-  if (inLen)
-  {
-    cksum += *(uint8_t *)p;
-  }
-  cksum = (cksum >> 16) + (cksum & 0xffff);
-  cksum += (cksum >>16);
-
-  return ~cksum;
+  mxchip_cmd_head_t *cmd_header = (mxchip_cmd_head_t *)inBuf;
+  uint16_t cksum = ReadLittle16(inBuf + inLen - 2);
+
+  cksum = ChecksumAdjust16(cksum, cmd_header->cmd, cmd);
+  cksum = ChecksumAdjust16(cksum, cmd_header->cmd_status, cmd_status);
+  cmd_header->cmd = cmd;
+  cmd_header->cmd_status = cmd_status;
+  WriteLittle16(inBuf + inLen - 2, cksum);
 }
-
-
-
-
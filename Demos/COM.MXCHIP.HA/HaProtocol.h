@@ -74,6 +74,12 @@ OSStatus haWlanCommandProcess(unsigned char *inBuf, int *inBufLen, int inSocketF
 OSStatus haUartCommandProcess(uint8_t *inBuf, int inLen, mico_Context_t * const inContext);
 OSStatus check_sum(void *inData, uint32_t inLen);  
 
+/* Per client out queues of UART data, readable through mico_create_event_fd. The queue
+   is NULL when it has not been created or has been deleted */
+OSStatus socket_queue_create(mico_Context_t * const inContext, mico_queue_t *queue);
+void socket_queue_delete(mico_Context_t * const inContext, mico_queue_t *queue);
+OSStatus socket_queue_send(mico_Context_t * const inContext, int fd, mico_queue_t *queue);
+
 
 void set_network_state(int state, int on);
 
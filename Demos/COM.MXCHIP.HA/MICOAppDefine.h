@@ -18,16 +18,14 @@
 /*User provided configurations*/
 #define CONFIGURATION_VERSION         0x0000031 // if changed default configuration, add this num
 #define MAX_Local_Client_Num          8
+#define MAX_QUEUE_NUM                 (MAX_Local_Client_Num + 1)  // 1 remote client, local clients
+#define MAX_QUEUE_LENGTH              8  // each queue max 8 msg
 #define DEAFULT_REMOTE_SERVER         "192.168.2.254"
 #define DEFAULT_REMOTE_SERVER_PORT    8080
 #define UART_BUFFER_LENGTH            2048
 
 #define BONJOUR_SERVICE                     "_easylink._tcp.local."
 
-#define LOCAL_TCP_SERVER_LOOPBACK_PORT     1000
-#define REMOTE_TCP_CLIENT_LOOPBACK_PORT    1002
-#define RECVED_UART_DATA_LOOPBACK_PORT     1003
-
 /*Application's configuration stores in flash*/
 typedef struct
 {
@@ -48,10 +46,19 @@ typedef struct
 #define wlanBufferLen       1024
 #define UartRecvBufferLen   1024
 
+/* One UART packet shared by every client queue, freed when the last client has sent it */
+typedef struct _socket_msg {
+  int ref;
+  int len;
+  uint32_t trace_start; /* MICO_TRACE_TIMESTAMP() when read from UART */
+  uint8_t data[1];
+} socket_msg_t;
+
 /*Running status*/
 typedef struct _current_app_status_t {
-  /*Local clients port list*/
-  uint32_t          loopBack_PortList[MAX_Local_Client_Num];
+  /*Out queues of connected clients, NULL if not used*/
+  mico_queue_t*     socket_out_queue[MAX_QUEUE_NUM];
+  mico_mutex_t      queue_mtx;
 } current_app_status_t;
 
 
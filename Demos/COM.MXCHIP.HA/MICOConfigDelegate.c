@@ -25,6 +25,7 @@
 #include "MICODefine.h"
 #include "MICOAppDefine.h"
 #include "MICOConfigMenu.h"
+#include "MICOConfigTLV.h"
 
 #include "HaProtocol.h"
 #include "Platform.h"
@@ -378,4 +379,19 @@ OSStatus ConfigIncommingJsonMessage( const char *input, mico_Context_t * const i
 
 exit:
   return err; 
+}
+
+/* Binary counterpart of the keys above, served by /config-read-tlv and /config-write-tlv */
+static const mico_config_tlv_field_t appConfigFields[] =
+{
+  CONFIG_TLV_FIELD( 0x01, kConfigTLVFormat_Bool,   appConfig.remoteServerEnable, NULL ),
+  CONFIG_TLV_FIELD( 0x02, kConfigTLVFormat_String, appConfig.remoteServerDomain, NULL ),
+  CONFIG_TLV_FIELD( 0x03, kConfigTLVFormat_UInt,   appConfig.remoteServerPort,   NULL ),
+  CONFIG_TLV_FIELD( 0x04, kConfigTLVFormat_UInt,   appConfig.USART_BaudRate,     NULL ),
+};
+
+const mico_config_tlv_field_t *appConfigTLVSchema( size_t *outCount )
+{
+  *outCount = sizeof( appConfigFields ) / sizeof( appConfigFields[0] );
+  return appConfigFields;
 }
\ No newline at end of file
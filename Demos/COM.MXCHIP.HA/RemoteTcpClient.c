@@ -3,6 +3,7 @@
 
 #include "HaProtocol.h"
 #include "SocketUtils.h"
+#include "DNSUtils.h"
 #include "MICONotificationCenter.h"
 
 #define client_log(M, ...) custom_log("TCP client", M, ##__VA_ARGS__)
@@ -39,14 +40,14 @@ void remoteTcpClient_thread(void *inContext)
   mico_Context_t *Context = inContext;
   struct sockaddr_t addr;
   fd_set readfds;
-  char ipstr[16];
+  fd_set writeSet;
   struct timeval_t t;
   int currentRecved = 0;
-  int remoteTcpClient_loopBack_fd = -1;
   int remoteTcpClient_fd = -1;
   uint8_t *inDataBuffer = NULL;
-  uint8_t *outDataBuffer = NULL;
-  
+  int eventFd = -1;
+  mico_queue_t queue = NULL;
+  int socketErr;
   
   mico_rtos_init_semaphore(&_wifiConnected_sem, 1);
   
@@ -56,16 +57,6 @@ void remoteTcpClient_thread(void *inContext)
   
   inDataBuffer = malloc(wlanBufferLen);
   require_action(inDataBuffer, exit, err = kNoMemoryErr);
-  outDataBuffer = malloc(wlanBufferLen);
-  require_action(inDataBuffer, exit, err = kNoMemoryErr);
-  
-  /*Loopback fd, recv data from other thread */
-  remoteTcpClient_loopBack_fd = socket( AF_INET, SOCK_DGRM, IPPROTO_UDP );
-  require_action(IsValidSocket( remoteTcpClient_loopBack_fd ), exit, err = kNoResourcesErr );
-  addr.s_ip = IPADDR_LOOPBACK;
-  addr.s_port = REMOTE_TCP_CLIENT_LOOPBACK_PORT;
-  err = bind( remoteTcpClient_loopBack_fd, &addr, sizeof(addr) );
-  require_noerr( err, exit );
   
   t.tv_sec = 4;
   t.tv_usec = 0;
@@ -75,30 +66,45 @@ void remoteTcpClient_thread(void *inContext)
       if(_wifiConnected == false){
         require_action_quiet(mico_rtos_get_semaphore(&_wifiConnected_sem, 200000) == kNoErr, Continue, err = kTimeoutErr);
       }
-      err = gethostbyname((char *)Context->flashContentInRam.appConfig.remoteServerDomain, (uint8_t *)ipstr, 16);
+      err = DNSResolve(Context->flashContentInRam.appConfig.remoteServerDomain, &addr.s_ip);
       require_noerr(err, ReConnWithDelay);
       
       remoteTcpClient_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-      addr.s_ip = inet_addr(ipstr); 
       addr.s_port = Context->flashContentInRam.appConfig.remoteServerPort;
       
       err = connect(remoteTcpClient_fd, &addr, sizeof(addr));
-      require_noerr_quiet(err, ReConnWithDelay);
+      /* The server may have moved, look the name up again before the next attempt */
+      require_noerr_action_quiet(err, ReConnWithDelay, DNSCacheRemove(Context->flashContentInRam.appConfig.remoteServerDomain));
       
+      /*Out queue, UART data is only pushed while the server is connected */
+      err = socket_queue_create(Context, &queue);
+      require_noerr(err, ReConnWithDelay);
+      eventFd = mico_create_event_fd(queue);
+      require_action(eventFd >= 0, ReConnWithDelay, err = kNoResourcesErr);
+
       set_network_state(REMOTE_CONNECT, 1);
       client_log("Remote server connected at port: %d, fd: %d",  Context->flashContentInRam.appConfig.remoteServerPort,
                  remoteTcpClient_fd);
     }else{
       FD_ZERO(&readfds);
       FD_SET(remoteTcpClient_fd, &readfds);
-      FD_SET(remoteTcpClient_loopBack_fd, &readfds);
+      FD_SET(eventFd, &readfds);
+      FD_ZERO(&writeSet);
+      FD_SET(remoteTcpClient_fd, &writeSet);
       
-      select(1, &readfds, NULL, NULL, &t);
+      select(1, &readfds, &writeSet, NULL, &t);
       
-      /*recv UART data using loopback fd*/
-      if (FD_ISSET( remoteTcpClient_loopBack_fd, &readfds) ) {
-        len = recv( remoteTcpClient_loopBack_fd, outDataBuffer, wlanBufferLen, 0 );
-        SocketSend( remoteTcpClient_fd, outDataBuffer, len );
+      /*Send UART data when there is data and the socket can be written */
+      if (FD_ISSET( eventFd, &readfds ) && FD_ISSET( remoteTcpClient_fd, &writeSet )) {
+        if (socket_queue_send(Context, remoteTcpClient_fd, &queue) != kNoErr) {
+          len = sizeof(socketErr);
+          getsockopt(remoteTcpClient_fd, SOL_SOCKET, SO_ERROR, &socketErr, &len);
+          if (socketErr != ENOMEM) {
+            client_log("Write error, fd: %d, errno %d", remoteTcpClient_fd, socketErr);
+            set_network_state(REMOTE_CONNECT, 0);
+            goto ReConnWithDelay;
+          }
+        }
       }
       
       /*recv wlan data using remote client fd*/
@@ -117,6 +123,12 @@ void remoteTcpClient_thread(void *inContext)
       continue;
       
     ReConnWithDelay:
+      if(eventFd >= 0){
+        mico_delete_event_fd(eventFd);
+        eventFd = -1;
+      }
+      if(queue != NULL)
+        socket_queue_delete(Context, &queue);
       if(remoteTcpClient_fd != -1){
         SocketClose(&remoteTcpClient_fd);
       }
@@ -125,9 +137,6 @@ void remoteTcpClient_thread(void *inContext)
   }
 exit:
   if(inDataBuffer) free(inDataBuffer);
-  if(outDataBuffer) free(outDataBuffer);
-  if(remoteTcpClient_loopBack_fd != -1)
-    SocketClose(&remoteTcpClient_loopBack_fd);
   client_log("Exit: Remote TCP client exit with err = %d", err);
   mico_rtos_delete_thread(NULL);
   return;
@@ -6,6 +6,7 @@
 #include "MicoPlatform.h"
 #include "platform.h"
 #include "MICONotificationCenter.h"
+#include "MICOTrace.h"
 
 #define uart_recv_log(M, ...) custom_log("UART RECV", M, ##__VA_ARGS__)
 #define uart_recv_log_trace() custom_log_trace("UART RECV")
@@ -26,6 +27,7 @@ void uartRecv_thread(void *inContext)
     recvlen = _uart_get_one_packet(inDataBuffer, UartRecvBufferLen);
     if (recvlen <= 0)
       continue; 
+    MICO_TRACE_INSTANT("uart packet", recvlen);
     haUartCommandProcess(inDataBuffer, recvlen, Context);
   }
   
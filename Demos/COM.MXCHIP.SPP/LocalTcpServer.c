@@ -96,8 +96,7 @@ void localTcpClient_thread(void *inFd)
   struct timeval_t t;
   int eventFd = -1;
   mico_queue_t queue;
-  socket_msg_t *msg;
-  int sent_len, errno;
+  int errno;
 
   inDataBuffer = malloc(wlanBufferLen);
   require_action(inDataBuffer, exit, err = kNoMemoryErr);
@@ -124,21 +123,15 @@ void localTcpClient_thread(void *inFd)
     select(24, &readfds, &writeSet, NULL, &t);
     /* send UART data */
     if ((FD_ISSET( eventFd, &readfds )) && (FD_ISSET( clientFd, &writeSet ))) { // have data and can write
-        if(kNoErr == mico_rtos_pop_from_queue( &queue, &msg, 0)) {
-           sent_len = write(clientFd, msg->data, msg->len);
-           if (sent_len <= 0) {
-              len = sizeof(errno);
-              getsockopt(clientFd, SOL_SOCKET, SO_ERROR, &errno, &len);
-              socket_msg_free(msg);
-              server_log("write error, fd: %d, errno %d", clientFd, errno );
-              if (errno != ENOMEM) {
-                  goto exit_with_queue;
-              }
-           } else {
-                  socket_msg_free(msg);
-              }
-           }
+        if (socket_queue_send(clientFd, &queue) != kNoErr) {
+            len = sizeof(errno);
+            getsockopt(clientFd, SOL_SOCKET, SO_ERROR, &errno, &len);
+            server_log("write error, fd: %d, errno %d", clientFd, errno );
+            if (errno != ENOMEM) {
+                goto exit_with_queue;
+            }
         }
+    }
 
     /*Read data from tcp clients and process these data using HA protocol */ 
     if (FD_ISSET(clientFd, &readfds)) {
@@ -90,6 +90,7 @@ typedef struct
 typedef struct _socket_msg {
   int ref;
   int len;
+  uint32_t trace_start; /* MICO_TRACE_TIMESTAMP() when read from UART */
   uint8_t data[1];
 } socket_msg_t;
 
@@ -23,6 +23,7 @@
 #include "MICODefine.h"
 #include "SppProtocol.h"
 #include "SocketUtils.h"
+#include "DNSUtils.h"
 #include "MICONotificationCenter.h"
 
 #define client_log(M, ...) custom_log("TCP client", M, ##__VA_ARGS__)
@@ -60,14 +61,12 @@ void remoteTcpClient_thread(void *inContext)
   struct sockaddr_t addr;
   fd_set readfds;
   fd_set writeSet;
-  char ipstr[16];
   struct timeval_t t;
   int remoteTcpClient_fd = -1;
   uint8_t *inDataBuffer = NULL;
   int eventFd = -1;
   mico_queue_t queue;
-  socket_msg_t *msg;
-  int sent_len, errno;
+  int errno;
   
   mico_rtos_init_semaphore(&_wifiConnected_sem, 1);
   
@@ -84,15 +83,15 @@ void remoteTcpClient_thread(void *inContext)
       if(_wifiConnected == false){
         require_action_quiet(mico_rtos_get_semaphore(&_wifiConnected_sem, 200000) == kNoErr, Continue, err = kTimeoutErr);
       }
-      err = gethostbyname((char *)Context->flashContentInRam.appConfig.remoteServerDomain, (uint8_t *)ipstr, 16);
+      err = DNSResolve(Context->flashContentInRam.appConfig.remoteServerDomain, &addr.s_ip);
       require_noerr(err, ReConnWithDelay);
       
       remoteTcpClient_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-      addr.s_ip = inet_addr(ipstr); 
       addr.s_port = Context->flashContentInRam.appConfig.remoteServerPort;
       
       err = connect(remoteTcpClient_fd, &addr, sizeof(addr));
-      require_noerr_quiet(err, ReConnWithDelay);
+      /* The server may have moved, look the name up again before the next attempt */
+      require_noerr_action_quiet(err, ReConnWithDelay, DNSCacheRemove(Context->flashContentInRam.appConfig.remoteServerDomain));
       client_log("Remote server connected at port: %d, fd: %d",  Context->flashContentInRam.appConfig.remoteServerPort,
                  remoteTcpClient_fd);
       
@@ -115,21 +114,14 @@ void remoteTcpClient_thread(void *inContext)
       select(1, &readfds, &writeSet, NULL, &t);
       /* send UART data */
       if ((FD_ISSET( eventFd, &readfds )) && (FD_ISSET(remoteTcpClient_fd, &writeSet ))) {// have data and can write
-        if (kNoErr == mico_rtos_pop_from_queue( &queue, &msg, 0)) {
-           sent_len = write(remoteTcpClient_fd, msg->data, msg->len);
-           if (sent_len <= 0) {
-            len = sizeof(errno);
-            getsockopt(remoteTcpClient_fd, SOL_SOCKET, SO_ERROR, &errno, &len);
-      
-            socket_msg_free(msg);
-            if (errno != ENOMEM) {
-                client_log("write error, fd: %d, errno %d", remoteTcpClient_fd,errno );
-                goto ReConnWithDelay;
-            }
-           } else {
-                    socket_msg_free(msg);
-                }
-            }
+        if (socket_queue_send(remoteTcpClient_fd, &queue) != kNoErr) {
+          len = sizeof(errno);
+          getsockopt(remoteTcpClient_fd, SOL_SOCKET, SO_ERROR, &errno, &len);
+          if (errno != ENOMEM) {
+            client_log("write error, fd: %d, errno %d", remoteTcpClient_fd,errno );
+            goto ReConnWithDelay;
+          }
+        }
       }
       /*recv wlan data using remote client fd*/
       if (FD_ISSET(remoteTcpClient_fd, &readfds)) {
@@ -27,6 +27,7 @@
 #include "MicoPlatform.h"
 #include "platform_config.h"
 #include "MICONotificationCenter.h"
+#include "MICOTrace.h"
 #include <stdio.h>
 
 #define MAX_SOCK_MSG_LEN (10*1024)
@@ -37,6 +38,9 @@ int sockmsg_len = 0;
 void socket_msg_take(socket_msg_t*msg);
 void socket_msg_free(socket_msg_t*msg);
 
+/* From the UART read to the TCP write, including the time spent in the client queue */
+MICO_TRACE_HISTOGRAM(uart_to_tcp_histogram, "uart to tcp");
+
 
 OSStatus sppProtocolInit(mico_Context_t * const inContext)
 {
@@ -81,6 +85,8 @@ OSStatus sppUartCommandProcess(uint8_t *inBuf, int inLen, mico_Context_t * const
     return kNoMemoryErr;
   sockmsg_len += (sizeof(socket_msg_t) - 1 + inLen);
   real_msg->len = inLen;
+  real_msg->trace_start = MICO_TRACE_TIMESTAMP();
+  MICO_TRACE_INSTANT("uart data", inLen);
   memcpy(real_msg->data, inBuf, inLen);
   real_msg->ref = 0;
   
@@ -138,6 +144,34 @@ int socket_queue_create(mico_Context_t * const inContext, mico_queue_t *queue)
     return -1;
 }
 
+/* Send every message waiting in the queue with one SocketSendv, so a burst of short UART
+   reads goes out in as few TCP segments as possible */
+OSStatus socket_queue_send(int fd, mico_queue_t *queue)
+{
+    OSStatus err = kNoErr;
+    socket_msg_t *msg[MAX_QUEUE_LENGTH];
+    iovec_t iov[MAX_QUEUE_LENGTH];
+    int count = 0, i;
+
+    while (count < MAX_QUEUE_LENGTH && kNoErr == mico_rtos_pop_from_queue( queue, &msg[count], 0)) {
+        iov[count].iov_base = msg[count]->data;
+        iov[count].iov_len = msg[count]->len;
+        count++;
+    }
+
+    if (count > 0) {
+        MICO_TRACE_BEGIN("tcp send");
+        err = SocketSendv(fd, iov, count);
+        MICO_TRACE_END("tcp send");
+    }
+
+    for (i = 0; i < count; i++) {
+        MICO_TRACE_HISTOGRAM_ADD(uart_to_tcp_histogram, msg[i]->trace_start);
+        socket_msg_free(msg[i]);
+    }
+    return err;
+}
+
 int socket_queue_delete(mico_Context_t * const inContext, mico_queue_t *queue)
 {
     int i;
@@ -36,5 +36,6 @@ int socket_queue_create(mico_Context_t * const inContext, mico_queue_t *queue);
 int socket_queue_delete(mico_Context_t * const inContext, mico_queue_t *queue);
 void socket_msg_free(socket_msg_t*msg);
 void socket_msg_take(socket_msg_t*msg);
+OSStatus socket_queue_send(int fd, mico_queue_t *queue);
 
 #endif
@@ -26,6 +26,7 @@
 #include "MVDCloudInterfaces.h"   
 #include "EasyCloudService.h"
 #include "MicoVirtualDevice.h"
+#include "MICOConfigReport.h"
 #include "MVDMsgProtocol.h"
 
 
@@ -66,6 +67,8 @@ void cloudServiceStatusChangedHandler(void* context, easycloud_service_status_t
     cloud_if_log("cloud service disconnected!");
     inContext->appStatus.virtualDevStatus.isCloudConnected = false;
   }
+  /* Shown in the config report */
+  MICOConfigReportInvalidate();
 }
 
 OSStatus MVDCloudInterfacePrintVersion(void)
@@ -39,6 +39,7 @@
 #include "StringUtils.h"
 #include "HTTPUtils.h"
 #include "SocketUtils.h"
+#include "MICOConfigReport.h"
 
 #include "Airkiss.h"
 
@@ -128,6 +129,7 @@ void AirkissNotify_DHCPCompleteHandler(IPStatusTypedef *pnet, mico_Context_t * c
   strcpy((char *)inContext->micoStatus.netMask, pnet->mask);
   strcpy((char *)inContext->micoStatus.gateWay, pnet->gate);
   strcpy((char *)inContext->micoStatus.dnsServer, pnet->dns);
+  MICOConfigReportInvalidate();
 exit:
   return;
 }
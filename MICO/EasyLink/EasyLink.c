@@ -37,6 +37,7 @@
 #include "StringUtils.h"
 #include "HTTPUtils.h"
 #include "SocketUtils.h"
+#include "MICOConfigReport.h"
 
 #include "EasyLink.h"
 #include "SoftAp/EasyLinkSoftAP.h"
@@ -61,7 +62,6 @@ static HTTPHeader_t *httpHeader = NULL;
 static bool EasylinkFailed = false;
 
 extern OSStatus     ConfigIncommingJsonMessage    ( const char *input, mico_Context_t * const inContext );
-extern json_object* ConfigCreateReportJsonMessage ( mico_Context_t * const inContext );
 extern void         ConfigWillStart               ( mico_Context_t * const inContext );
 extern void         ConfigWillStop                ( mico_Context_t * const inContext );
 extern void         ConfigEasyLinkIsSuccess       ( mico_Context_t * const inContext );
@@ -122,6 +122,7 @@ void EasyLinkNotify_DHCPCompleteHandler(IPStatusTypedef *pnet, mico_Context_t *
   strcpy((char *)inContext->micoStatus.netMask, pnet->mask);
   strcpy((char *)inContext->micoStatus.gateWay, pnet->gate);
   strcpy((char *)inContext->micoStatus.dnsServer, pnet->dns);
+  MICOConfigReportInvalidate();
 exit:
   return;
 }
@@ -208,6 +209,7 @@ void EasyLinkNotify_EasyLinkGetExtraDataHandler(int datalen, char* data, mico_Co
     strcpy((char *)inContext->micoStatus.netMask, inContext->flashContentInRam.micoSystemConfig.netMask);
     strcpy((char *)inContext->micoStatus.gateWay, inContext->flashContentInRam.micoSystemConfig.gateWay);
     strcpy((char *)inContext->micoStatus.dnsServer, inContext->flashContentInRam.micoSystemConfig.dnsServer);
+    MICOConfigReportInvalidate();
     inet_ntoa( address, inContext->flashContentInRam.micoSystemConfig.easylinkServerIP);
     easylink_log("Get auth info: %s, EasyLink server ip address: %s, local IP info:%s %s %s %s ", data, address, inContext->flashContentInRam.micoSystemConfig.localIp,\
     inContext->flashContentInRam.micoSystemConfig.netMask, inContext->flashContentInRam.micoSystemConfig.gateWay,inContext->flashContentInRam.micoSystemConfig.dnsServer);
@@ -320,8 +322,7 @@ OSStatus _connectFTCServer( mico_Context_t * const inContext, int *fd)
 {
   OSStatus    err;
   struct      sockaddr_t addr;
-  json_object *easylink_report = NULL;
-  const char  *json_str;
+  mico_config_report_t *easylink_report = NULL;
   
   size_t      httpResponseLen = 0;
 
@@ -333,19 +334,15 @@ OSStatus _connectFTCServer( mico_Context_t * const inContext, int *fd)
 
   easylink_log("Connect to FTC server success, fd: %d", *fd);
 
-  easylink_report = ConfigCreateReportJsonMessage( inContext );
+  easylink_report = MICOConfigReportRetain( inContext );
   require( easylink_report, exit );
 
-  json_str = json_object_to_json_string(easylink_report);
-  require( json_str, exit );
-
-  easylink_log("Send config object=%s", json_str);
-  err =  CreateHTTPMessage( "POST", kEasyLinkURLAuth, kMIMEType_JSON, (uint8_t *)json_str, strlen(json_str), &httpResponse, &httpResponseLen );
+  easylink_log("Send config object=%s", easylink_report->json);
+  err =  CreateHTTPMessage( "POST", kEasyLinkURLAuth, kMIMEType_JSON, (uint8_t *)easylink_report->json, easylink_report->len, &httpResponse, &httpResponseLen );
+  MICOConfigReportRelease(easylink_report);
   require_noerr( err, exit );
   require( httpResponse, exit );
 
-  json_object_put(easylink_report);
-
   err = SocketSend( *fd, httpResponse, httpResponseLen );
   free(httpResponse);
   require_noerr( err, exit );
@@ -3,6 +3,9 @@
 #include "MICOCli.h"
 #include "stdarg.h"
 #include "platform_config.h"
+#include "MICOSystemMonitor.h"
+#include "MICOLog.h"
+#include "MICOTrace.h"
 
 #ifdef MICO_CLI_ENABLE
 int cli_printf(const char *msg, ...);
@@ -402,6 +405,121 @@ static void cli_exit_handler(char *pcWriteBuffer, int xWriteBufferLen,int argc,
   // exit command not excuted
 }
 
+static void system_monitor_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc, char **argv)
+{
+  mico_system_monitor_reset_t reset;
+  mico_system_monitor_t monitors[MAXIMUM_NUMBER_OF_SYSTEM_MONITORS];
+  mico_system_sample_t samples[MICO_SYSTEM_MONITOR_HISTORY];
+  uint32_t count, i;
+  
+  if (MICOSystemMonitorGetLastReset(&reset) == kNoErr)
+    cmd_printf("Last reset: monitor \"%s\" %d ms late at %d ms\r\n", reset.name, reset.overdue, reset.uptime);
+  
+  count = MICOSystemMonitorGetMonitors(monitors, sizeof(monitors)/sizeof(mico_system_monitor_t));
+  for (i = 0; i < count; i++)
+    cmd_printf("Monitor %s: permitted %d ms, longest checkin %d ms\r\n", monitors[i].name? monitors[i].name : "-",
+               monitors[i].longest_permitted_delay, monitors[i].longest_checkin);
+  
+  count = MICOSystemMonitorGetSamples(samples, MICO_SYSTEM_MONITOR_HISTORY);
+  cmd_printf("time      heap  min   chunks cpu   work notify\r\n");
+  for (i = 0; i < count; i++) {
+    cmd_printf("%-9d %-5d %-5d %-6d ", samples[i].time, samples[i].heap_free, samples[i].heap_min_free, samples[i].heap_chunks);
+    if (samples[i].cpu_load == MICO_SYSTEM_MONITOR_NO_CPU_LOAD)
+      cmd_printf("-     ");
+    else
+      cmd_printf("%2d.%d%% ", samples[i].cpu_load/10, samples[i].cpu_load%10);
+    cmd_printf("%-4d %d\r\n", samples[i].work_pending, samples[i].notify_pending);
+  }
+}
+
+
+typedef struct {
+  char *pcWriteBuffer;
+  int xWriteBufferLen;
+} cli_output_t;
+
+static void log_module_print(const char *module, int level, void *arg)
+{
+  cli_output_t *output = (cli_output_t *)arg;
+  char *pcWriteBuffer = output->pcWriteBuffer;
+  int xWriteBufferLen = output->xWriteBufferLen;
+  
+  cmd_printf("  %-20s %d\r\n", module, level);
+  output->pcWriteBuffer = pcWriteBuffer;
+  output->xWriteBufferLen = xWriteBufferLen;
+}
+
+static void log_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc, char **argv)
+{
+  mico_log_stats_t stats;
+  cli_output_t output;
+  OSStatus err;
+  
+  if (argc == 3) {
+    err = MicoLogSetLevel(strcasecmp(argv[1], "all") ? argv[1] : NULL, atoi(argv[2]));
+    if (err != kNoErr)
+      cmd_printf("Unable to set level, error %d\r\n", err);
+    return;
+  }
+  if (argc != 1) {
+    cmd_printf("Usage: log [<module>|all <level 0-4>]\r\n");
+    return;
+  }
+  
+  MicoLogGetStats(&stats);
+  cmd_printf("Records %d, dropped %d, filtered %d, truncated %d, buffer high water %d\r\n",
+             stats.records, stats.dropped, stats.filtered, stats.truncated, stats.buffer_high_water);
+  cmd_printf("Cycles per call %d, max %d\r\n", stats.cycles_avg, stats.cycles_max);
+  cmd_printf("Module levels (0 off, 1 error, 2 warn, 3 info, 4 debug):\r\n");
+  output.pcWriteBuffer = pcWriteBuffer;
+  output.xWriteBufferLen = xWriteBufferLen;
+  MicoLogForEachModule(log_module_print, &output);
+}
+
+#define TRACE_CLI_EVENTS 16
+
+static void trace_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc, char **argv)
+{
+  mico_trace_histogram_t histogram[4];
+  mico_trace_event_t *events = NULL;
+  static const char *types[] = { "begin", "end", "instant", "counter" };
+  uint32_t count, i, b;
+  
+  if (argc == 2 && !strcasecmp(argv[1], "start")) {
+    MicoTraceStart();
+  } else if (argc == 2 && !strcasecmp(argv[1], "stop")) {
+    MicoTraceStop();
+  } else if (argc == 2 && !strcasecmp(argv[1], "clear")) {
+    MicoTraceClear();
+  } else if (argc == 2 && !strcasecmp(argv[1], "dump")) {
+    /* The output buffer only holds the newest few events, /trace on the config server returns all of them */
+    events = malloc(MICO_TRACE_BUFFER_EVENTS * sizeof(mico_trace_event_t));
+    if (events == NULL) {
+      cmd_printf("No memory\r\n");
+      return;
+    }
+    count = MicoTraceGetEvents(events, MICO_TRACE_BUFFER_EVENTS);
+    i = (count > TRACE_CLI_EVENTS) ? count - TRACE_CLI_EVENTS : 0;
+    cmd_printf("%d events, cycles relative to the first one shown\r\n", count);
+    for (b = i; i < count; i++)
+      cmd_printf("%-9d %-10u %08x %-7s %s %d\r\n", events[i].time, (unsigned int)(events[i].cycles - events[b].cycles),
+                 (unsigned int)(uintptr_t)events[i].thread, types[events[i].type], events[i].name, events[i].value);
+    free(events);
+  } else if (argc == 1) {
+    count = MicoTraceGetHistograms(histogram, sizeof(histogram)/sizeof(mico_trace_histogram_t));
+    if (count == 0)
+      cmd_printf("No histograms\r\n");
+    for (i = 0; i < count; i++) {
+      cmd_printf("%s: count %d, avg %d us, max %d us\r\n", histogram[i].name, histogram[i].count,
+                 histogram[i].count ? histogram[i].total/histogram[i].count : 0, histogram[i].max);
+      for (b = 0; b < MICO_TRACE_HISTOGRAM_BUCKETS; b++)
+        if (histogram[i].buckets[b])
+          cmd_printf("  >=%-7d us %d\r\n", b ? 1 << b : 0, histogram[i].buckets[b]);
+    }
+  } else {
+    cmd_printf("Usage: trace [dump|start|stop|clear]\r\n");
+  }
+}
 
 static const struct cli_command built_ins[] = {
   {"help", NULL, help_command},
@@ -428,6 +546,9 @@ static const struct cli_command built_ins[] = {
   {"memdump", "<addr> <length>", memory_dump_Command}, 
   {"memset", "<addr> <value 1> [<value 2> ... <value n>]", memory_set_Command}, 
   {"memp", "print memp list", memp_dump_Command},
+  {"sysmon", "show system monitor samples and last reset", system_monitor_Command},
+  {"log", "[<module>|all <level 0-4>] show or set log levels", log_Command},
+  {"trace", "[dump|start|stop|clear] show latency histograms or trace events", trace_Command},
   {"wifidriver", "show wifi driver status", driver_state_Command}, // bus credite, flow control...
   {"reboot", "reboot MiCO system", reboot},
 };
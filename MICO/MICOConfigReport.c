@@ -0,0 +1,147 @@
+/**
+******************************************************************************
+* @file    MICOConfigReport.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Cache of the serialized configuration report sent to config
+*          clients.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "MICODefine.h"
+#include "MICOConfigReport.h"
+#include "RandomUtils.h"
+
+#define report_log(M, ...) custom_log("Config report", M, ##__VA_ARGS__)
+
+extern json_object* ConfigCreateReportJsonMessage( mico_Context_t * const inContext );
+
+/* The cached report, the generation and the statistics are only touched with the scheduler
+   suspended. The report itself is built outside, it locks flashContentInRam_mutex. */
+static mico_config_report_t *_report = NULL;
+static uint32_t _generation = 0;
+static uint32_t _boot_id = 0;         /* Keeps ETags of different boots apart, the seed is the same */
+static mico_config_report_stats_t _stats;
+
+static mico_config_report_t *_config_report_build( mico_Context_t * const inContext, uint32_t generation )
+{
+  mico_config_report_t *report = NULL;
+  json_object *object = NULL;
+  const char *json_str;
+  size_t len;
+
+  object = ConfigCreateReportJsonMessage( inContext );
+  require( object, exit );
+  json_str = json_object_to_json_string( object );
+  require( json_str, exit );
+
+  len = strlen( json_str );
+  report = malloc( sizeof(mico_config_report_t) + len );
+  require( report, exit );
+  report->refCount = 1;
+  report->seed = inContext->flashContentInRam.micoSystemConfig.seed;
+  report->generation = generation;
+  report->len = len;
+  memcpy( report->json, json_str, len + 1 );
+
+exit:
+  if( object ) json_object_put( object );
+  return report;
+}
+
+mico_config_report_t *MICOConfigReportRetain( mico_Context_t * const inContext )
+{
+  mico_config_report_t *report = NULL, *old = NULL;
+  uint32_t generation, start;
+
+  mico_rtos_suspend_all_thread();
+  if( _report && _report->generation == _generation && _report->seed == inContext->flashContentInRam.micoSystemConfig.seed ){
+    report = _report;
+    report->refCount++;
+    _stats.hits++;
+  }
+  generation = _generation;
+  mico_rtos_resume_all_thread();
+  if( report ) return report;
+
+  if( _boot_id == 0 )
+    _boot_id = RandomUInt32() | 1;
+  start = mico_get_time();
+  report = _config_report_build( inContext, generation );
+  require( report, exit );
+
+  mico_rtos_suspend_all_thread();
+  _stats.builds++;
+  if( mico_get_time() - start > _stats.build_time_max )
+    _stats.build_time_max = mico_get_time() - start;
+  /* Not cached if it was invalidated while being built, the caller still gets it */
+  if( generation == _generation ){
+    old = _report;
+    _report = report;
+    report->refCount++;
+  }
+  mico_rtos_resume_all_thread();
+  if( old ) MICOConfigReportRelease( old );
+
+exit:
+  return report;
+}
+
+void MICOConfigReportRelease( mico_config_report_t *report )
+{
+  bool last;
+
+  if( report == NULL ) return;
+  mico_rtos_suspend_all_thread();
+  last = ( --report->refCount == 0 );
+  mico_rtos_resume_all_thread();
+  if( last ) free( report );
+}
+
+void MICOConfigReportETag( const mico_config_report_t *report, char *etag, size_t etagSize )
+{
+  snprintf( etag, etagSize, "\"%x-%x\"", (unsigned int)report->seed, (unsigned int)(_boot_id + report->generation) );
+}
+
+void MICOConfigReportInvalidate( void )
+{
+  mico_config_report_t *old;
+
+  mico_rtos_suspend_all_thread();
+  old = _report;
+  _report = NULL;
+  _generation++;
+  _stats.invalidations++;
+  mico_rtos_resume_all_thread();
+  MICOConfigReportRelease( old );
+}
+
+void MICOConfigReportGetStats( mico_config_report_stats_t *stats )
+{
+  mico_rtos_suspend_all_thread();
+  memcpy( stats, &_stats, sizeof(mico_config_report_stats_t) );
+  mico_rtos_resume_all_thread();
+}
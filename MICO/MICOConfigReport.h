@@ -0,0 +1,78 @@
+/**
+******************************************************************************
+* @file    MICOConfigReport.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide function prototypes for the cache of the
+*          serialized configuration report sent to config clients.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MICOCONFIGREPORT_H__
+#define __MICOCONFIGREPORT_H__
+
+#include "Common.h"
+#include "MICODefine.h"
+
+/* ConfigCreateReportJsonMessage builds the whole menu tree of the application. The result only
+   changes with the configuration, or with the status shown in it (IP addresses, cloud
+   connection), so the serialized report is kept together with the seed it was built from and
+   served again until MICOConfigReportInvalidate is called or the seed changes.
+
+   MICOUpdateConfiguration and the restore functions invalidate the report, so do the
+   DHCP handlers. Code that changes anything else shown in the report without saving the
+   configuration must call MICOConfigReportInvalidate itself. */
+
+typedef struct _mico_config_report_t
+{
+  uint32_t      refCount;
+  int32_t       seed;                 /**< micoSystemConfig.seed it was built from */
+  uint32_t      generation;           /**< Invalidations before it was built */
+  size_t        len;                  /**< strlen of json */
+  char          json[1];
+} mico_config_report_t;
+
+typedef struct
+{
+  uint32_t      hits;                 /**< Reports served from the cache */
+  uint32_t      builds;               /**< Reports built by ConfigCreateReportJsonMessage */
+  uint32_t      invalidations;
+  uint32_t      build_time_max;       /**< ms, longest build */
+} mico_config_report_stats_t;
+
+/* Returns the current report, building it first if necessary, or NULL if it cannot be built.
+   The report stays valid until it is released, even if it is replaced in the meantime. */
+mico_config_report_t *MICOConfigReportRetain( mico_Context_t * const inContext );
+
+void MICOConfigReportRelease( mico_config_report_t *report );
+
+/* ETag for HTTP clients, different for every report that was built */
+void MICOConfigReportETag( const mico_config_report_t *report, char *etag, size_t etagSize );
+
+void MICOConfigReportInvalidate( void );
+
+void MICOConfigReportGetStats( mico_config_report_stats_t *stats );
+
+#endif
@@ -37,6 +37,11 @@
 #include "HTTPUtils.h"
 #include "MICONotificationCenter.h"
 #include "StringUtils.h"
+#include "MICOSystemMonitor.h"
+#include "MICOTrace.h"
+#include "MICOConfigReport.h"
+#include "MICOConfigTLV.h"
+#include "stdarg.h"
 
 #define config_log(M, ...) custom_log("CONFIG SERVER", M, ##__VA_ARGS__)
 #define config_log_trace() custom_log_trace("CONFIG SERVER")
@@ -45,17 +50,25 @@
 #define kCONFIGURLWrite         "/config-write"
 #define kCONFIGURLWriteByUAP    "/config-write-uap"  /* Don't reboot but connect to AP immediately */
 #define kCONFIGURLOTA           "/OTA"
+#define kCONFIGURLReadTLV       "/config-read-tlv"   /* Binary versions of /config-read and /config-write, see MICOConfigTLV.h */
+#define kCONFIGURLWriteTLV      "/config-write-tlv"
+#define kCONFIGURLSystemMonitor "/system-monitor"
+#define kCONFIGURLTrace         "/trace"
+#define kCONFIGURLTraceHistogram "/trace-histograms"
 
 #define kMIMEType_MXCHIP_OTA    "application/ota-stream"
 
+#define kCRLFNewLine            "\r\n"
+#define kCRLFLineEnding         "\r\n\r\n"
+
 typedef struct _configContext_t{
   uint32_t flashStorageAddress;
   bool     isFlashLocked;
+  uint32_t requestCount;   /* Requests served on this connection */
 } configContext_t;
 
 extern OSStatus     ConfigIncommingJsonMessage( const char *input, mico_Context_t * const inContext );
 extern OSStatus     ConfigIncommingJsonMessageUAP( const char *input, mico_Context_t * const inContext );
-extern json_object* ConfigCreateReportJsonMessage( mico_Context_t * const inContext );
 
 static void localConfiglistener_thread(void *inContext);
 static void localConfig_thread(void *inFd);
@@ -64,6 +77,10 @@ static OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeade
 static void _easylinkConnectWiFi( mico_Context_t * const inContext);
 static OSStatus onReceivedData(struct _HTTPHeader_t * httpHeader, uint32_t pos, uint8_t * data, size_t len, void * userContext );
 static void onClearHTTPHeader(struct _HTTPHeader_t * httpHeader, void * userContext );
+static json_object* _SystemMonitorCreateReportJsonMessage( void );
+static OSStatus _SendTraceExport( int fd, HTTPHeader_t* inHeader, OSStatus (*exporter)( mico_trace_writer_t, void * ) );
+static OSStatus _LocalConfigSendResponse( int fd, HTTPHeader_t* inHeader, int status, const char *contentType, const char *etag,
+                                          const uint8_t *body, size_t bodyLen );
 
 OSStatus MICOStartConfigServer ( mico_Context_t * const inContext )
 {
@@ -123,28 +140,33 @@ void localConfig_thread(void *inFd)
 {
   OSStatus err;
   int clientFd = *(int *)inFd;
-  int clientFdIsSet;
+  int clientFdIsSet, selectResult;
   fd_set readfds;
   struct timeval_t t;
   HTTPHeader_t *httpHeader = NULL;
-  configContext_t httpContext = {0, false};
+  configContext_t httpContext = {0, false, 0};
 
   config_log_trace();
   httpHeader = HTTPHeaderCreateWithCallback(onReceivedData, onClearHTTPHeader, &httpContext);
   require_action( httpHeader, exit, err = kNoMemoryErr );
   HTTPHeaderClear( httpHeader );
 
-  t.tv_sec = 60;
-  t.tv_usec = 0;
   config_log("Free memory %d bytes", MicoGetMemoryInfo()->free_memory) ; 
 
+  /* Connections are persistent unless the client asks otherwise. Requests that arrived
+     together with the previous one are kept in httpHeader and served in order before
+     waiting for more */
   while(1){
     FD_ZERO(&readfds);
     FD_SET(clientFd, &readfds);
     clientFdIsSet = 0;
 
     if(httpHeader->len == 0){
-      require(select(1, &readfds, NULL, NULL, &t) >= 0, exit);
+      t.tv_sec = CONFIG_SERVICE_IDLE_TIMEOUT;
+      t.tv_usec = 0;
+      selectResult = select(clientFd + 1, &readfds, NULL, NULL, &t);
+      require_action(selectResult >= 0, exit, err = kConnectionErr);
+      require_action(selectResult > 0, exit, err = kTimeoutErr; config_log("Close idle connection"));
       clientFdIsSet = FD_ISSET(clientFd, &readfds);
     }
   
@@ -157,6 +179,7 @@ void localConfig_thread(void *inFd)
           // Read the rest of the HTTP body if necessary
           //do{
           err = SocketReadHTTPBody( clientFd, httpHeader );
+          httpContext.requestCount++;
           
           if(httpHeader->dataEndedbyClose == true){
             err = _LocalConfigRespondInComingMessage( clientFd, httpHeader, Context );
@@ -181,7 +204,7 @@ void localConfig_thread(void *inFd)
           //Exit if connection is closed
           //require_noerr(err, exit); 
       
-          // Reuse HTTPHeader
+          // Reuse HTTPHeader, pipelined requests already read stay in it
           HTTPHeaderClear( httpHeader );
         break;
 
@@ -287,22 +310,49 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
   uint8_t *httpResponse = NULL;
   size_t httpResponseLen = 0;
   json_object* report = NULL;
+  mico_config_report_t *configReport = NULL;
+  char etag[24];
+  uint8_t *tlv = NULL;
+  size_t tlvLen = 0;
+  const char *  value;
+  size_t        valueSize;
   config_log_trace();
 
   if(HTTPHeaderMatchURL( inHeader, kCONFIGURLRead ) == kNoErr){    
-    report = ConfigCreateReportJsonMessage( inContext );
-    require( report, exit );
+    /* The report is cached until the configuration or the status shown in it changes, a client
+       polling the configuration gets a 304 as long as it is the same */
+    configReport = MICOConfigReportRetain( inContext );
+    require_action( configReport, exit, err = kNoMemoryErr );
+    MICOConfigReportETag( configReport, etag, sizeof(etag) );
+    if(HTTPGetHeaderField( inHeader->buf, inHeader->len, "If-None-Match", NULL, NULL, &value, &valueSize, NULL ) == kNoErr
+       && strnicmpx( value, valueSize, etag ) == 0){
+      err = _LocalConfigSendResponse( fd, inHeader, kStatusNotModified, NULL, etag, NULL, 0 );
+      require_noerr( err, exit );
+      goto exit;
+    }
+    config_log("Send config object=%s", configReport->json);
+    err = _LocalConfigSendResponse( fd, inHeader, kStatusOK, kMIMEType_JSON, etag, (uint8_t *)configReport->json, configReport->len );
+    require_noerr( err, exit );
+    config_log("Current configuration sent");
+    goto exit;
+  }
+  else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLSystemMonitor ) == kNoErr){
+    report = _SystemMonitorCreateReportJsonMessage( );
+    require_action( report, exit, err = kNoMemoryErr );
     json_str = json_object_to_json_string(report);
     require_action( json_str, exit, err = kNoMemoryErr );
-    config_log("Send config object=%s", json_str);
-    err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_JSON, strlen(json_str), &httpResponse, &httpResponseLen );
+    err = _LocalConfigSendResponse( fd, inHeader, kStatusOK, kMIMEType_JSON, NULL, (uint8_t *)json_str, strlen(json_str) );
     require_noerr( err, exit );
-    require( httpResponse, exit );
-    err = SocketSend( fd, httpResponse, httpResponseLen );
+    goto exit;
+  }
+  else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLTraceHistogram ) == kNoErr){
+    err = _SendTraceExport( fd, inHeader, MicoTraceExportHistogramJson );
     require_noerr( err, exit );
-    err = SocketSend( fd, (uint8_t *)json_str, strlen(json_str) );
+    goto exit;
+  }
+  else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLTrace ) == kNoErr){
+    err = _SendTraceExport( fd, inHeader, MicoTraceExportChromeJson );
     require_noerr( err, exit );
-    config_log("Current configuration sent");
     goto exit;
   }
   else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLWrite ) == kNoErr){
@@ -347,6 +397,36 @@ else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLWriteByUAP ) == kNoErr){
     }
     goto exit;
   }
+  else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLReadTLV ) == kNoErr){
+    err = MICOConfigTLVCreateReport( inContext, &tlv, &tlvLen );
+    require_noerr( err, exit );
+    err = _LocalConfigSendResponse( fd, inHeader, kStatusOK, kMIMEType_MXCHIP_TLV, NULL, tlv, tlvLen );
+    require_noerr( err, exit );
+    goto exit;
+  }
+  else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLWriteTLV ) == kNoErr){
+    if(inHeader->contentLength > 0){
+      config_log("Recv new TLV configuration, apply and reset");
+      err = MICOConfigTLVApply( (const uint8_t *)inHeader->extraDataPtr, inHeader->contentLength, inContext );
+      if(err != kNoErr){
+        _LocalConfigSendResponse( fd, inHeader, kStatusBadRequest, NULL, NULL, NULL, 0 );
+        goto exit;
+      }
+      inContext->flashContentInRam.micoSystemConfig.configured = allConfigured;
+      MICOUpdateConfiguration(inContext);
+
+      err =  CreateSimpleHTTPOKMessage( &httpResponse, &httpResponseLen );
+      require_noerr( err, exit );
+      require( httpResponse, exit );
+      err = SocketSend( fd, httpResponse, httpResponseLen );
+      SocketClose(&fd);
+      inContext->micoStatus.sys_state = eState_Software_Reset;
+      if(inContext->micoStatus.sys_state_change_sem != NULL )
+        mico_rtos_set_semaphore(&inContext->micoStatus.sys_state_change_sem);
+      mico_thread_sleep(MICO_WAIT_FOREVER);
+    }
+    goto exit;
+  }
 #ifdef MICO_FLASH_FOR_UPDATE
   else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLOTA ) == kNoErr){
     if(inHeader->contentLength > 0){
@@ -369,17 +449,224 @@ else if(HTTPHeaderMatchURL( inHeader, kCONFIGURLWriteByUAP ) == kNoErr){
   }
 #endif
   else{
-    return kNotFoundErr;
+    /* Answer instead of dropping the connection, so requests pipelined behind it are still served */
+    err = _LocalConfigSendResponse( fd, inHeader, kStatusNotFound, NULL, NULL, NULL, 0 );
+    require_noerr( err, exit );
+    goto exit;
   };
 
  exit:
   if(inHeader->persistent == false)  //Return an err to close socket and exit the current thread
     err = kConnectionErr;
+  else if(((configContext_t *)inHeader->userContext)->requestCount >= CONFIG_SERVICE_MAX_REQUESTS)
+    err = kConnectionErr;
   if(httpResponse)  free(httpResponse);
   if(report)        json_object_put(report);
+  if(configReport)  MICOConfigReportRelease(configReport);
+  if(tlv)           free(tlv);
+
+  return err;
+
+}
+
+static json_object* _SystemMonitorCreateReportJsonMessage( void )
+{
+  json_object *report = NULL, *array = NULL, *item = NULL;
+  mico_system_monitor_reset_t reset;
+  mico_config_report_stats_t reportStats;
+  mico_system_monitor_t monitors[MAXIMUM_NUMBER_OF_SYSTEM_MONITORS];
+  mico_system_sample_t *samples = NULL;
+  uint32_t count, i;
+
+  /* Too big for the client thread stack */
+  samples = malloc( MICO_SYSTEM_MONITOR_HISTORY * sizeof(mico_system_sample_t) );
+  require( samples, exit );
+
+  report = json_object_new_object();
+  require( report, exit );
+
+  if( MICOSystemMonitorGetLastReset( &reset ) == kNoErr ){
+    item = json_object_new_object();
+    require( item, error );
+    json_object_object_add( report, "last_reset", item );
+    json_object_object_add( item, "monitor", json_object_new_string( reset.name ) );
+    json_object_object_add( item, "overdue", json_object_new_int( reset.overdue ) );
+    json_object_object_add( item, "uptime", json_object_new_int( reset.uptime ) );
+    json_object_object_add( item, "heap_free", json_object_new_int( reset.last_sample.heap_free ) );
+  }
+
+  MICOConfigReportGetStats( &reportStats );
+  item = json_object_new_object();
+  require( item, error );
+  json_object_object_add( report, "config_report", item );
+  json_object_object_add( item, "hits", json_object_new_int( reportStats.hits ) );
+  json_object_object_add( item, "builds", json_object_new_int( reportStats.builds ) );
+  json_object_object_add( item, "invalidations", json_object_new_int( reportStats.invalidations ) );
+  json_object_object_add( item, "build_time_max", json_object_new_int( reportStats.build_time_max ) );
+
+  array = json_object_new_array();
+  require( array, error );
+  json_object_object_add( report, "monitors", array );
+  count = MICOSystemMonitorGetMonitors( monitors, MAXIMUM_NUMBER_OF_SYSTEM_MONITORS );
+  for( i = 0; i < count; i++ ){
+    item = json_object_new_object();
+    require( item, error );
+    json_object_array_add( array, item );
+    json_object_object_add( item, "name", json_object_new_string( monitors[i].name? monitors[i].name : "" ) );
+    json_object_object_add( item, "permitted", json_object_new_int( monitors[i].longest_permitted_delay ) );
+    json_object_object_add( item, "longest_checkin", json_object_new_int( monitors[i].longest_checkin ) );
+  }
+
+  array = json_object_new_array();
+  require( array, error );
+  json_object_object_add( report, "samples", array );
+  count = MICOSystemMonitorGetSamples( samples, MICO_SYSTEM_MONITOR_HISTORY );
+  for( i = 0; i < count; i++ ){
+    item = json_object_new_object();
+    require( item, error );
+    json_object_array_add( array, item );
+    json_object_object_add( item, "time", json_object_new_int( samples[i].time ) );
+    json_object_object_add( item, "heap_free", json_object_new_int( samples[i].heap_free ) );
+    json_object_object_add( item, "heap_min_free", json_object_new_int( samples[i].heap_min_free ) );
+    json_object_object_add( item, "heap_chunks", json_object_new_int( samples[i].heap_chunks ) );
+    if( samples[i].cpu_load != MICO_SYSTEM_MONITOR_NO_CPU_LOAD )
+      json_object_object_add( item, "cpu_load", json_object_new_int( samples[i].cpu_load ) );
+    json_object_object_add( item, "work_pending", json_object_new_int( samples[i].work_pending ) );
+    json_object_object_add( item, "notify_pending", json_object_new_int( samples[i].notify_pending ) );
+  }
+
+exit:
+  if( samples ) free( samples );
+  return report;
+
+error:
+  json_object_put( report );
+  report = NULL;
+  goto exit;
+}
+
+#define TRACE_SEND_BUFFER_SIZE 512
+
+typedef struct {
+  int       fd;       /* -1 only counts the length */
+  size_t    len;
+  size_t    used;
+  uint8_t   *buffer;
+} trace_send_context_t;
+
+static OSStatus _TraceSendWriter( void *context, const char *data, size_t len )
+{
+  OSStatus err = kNoErr;
+  trace_send_context_t *send = context;
+  size_t copy;
+
+  send->len += len;
+  while( send->fd >= 0 && len > 0 ){
+    copy = Min( len, TRACE_SEND_BUFFER_SIZE - send->used );
+    memcpy( send->buffer + send->used, data, copy );
+    send->used += copy;
+    data += copy;
+    len -= copy;
+    if( send->used == TRACE_SEND_BUFFER_SIZE ){
+      err = SocketSend( send->fd, send->buffer, send->used );
+      require_noerr( err, exit );
+      send->used = 0;
+    }
+  }
+
+exit:
+  return err;
+}
+
+/* Exports are streamed, the first pass only measures the Content-Length. Recording is
+   stopped in between so both passes see the same events. */
+static OSStatus _SendTraceExport( int fd, HTTPHeader_t* inHeader, OSStatus (*exporter)( mico_trace_writer_t, void * ) )
+{
+  OSStatus err = kNoErr;
+  trace_send_context_t send = { -1, 0, 0, NULL };
+  bool running = MicoTraceStop();
+
+  err = exporter( _TraceSendWriter, &send );
+  require_noerr( err, exit );
 
+  /* Only the header, the body follows in TRACE_SEND_BUFFER_SIZE pieces */
+  err = _LocalConfigSendResponse( fd, inHeader, kStatusOK, kMIMEType_JSON, NULL, NULL, send.len );
+  require_noerr( err, exit );
+
+  send.buffer = malloc( TRACE_SEND_BUFFER_SIZE );
+  require_action( send.buffer, exit, err = kNoMemoryErr );
+  send.fd = fd;
+  err = exporter( _TraceSendWriter, &send );
+  require_noerr( err, exit );
+  if( send.used )
+    err = SocketSend( fd, send.buffer, send.used );
+
+exit:
+  if( running )       MicoTraceStart();
+  if( send.buffer )   free( send.buffer );
   return err;
+}
+
+/* Sends the response header, and the body if inBody is not NULL. The connection headers
+   tell the client whether it may send the next request on this connection: the config
+   thread closes it after CONFIG_SERVICE_MAX_REQUESTS requests, or after
+   CONFIG_SERVICE_IDLE_TIMEOUT seconds without one. */
+#define kLocalConfigResponseHeaderSize  256
+
+/* Appends to the response header at inLen. Returns the new length, or inSize once the
+   header does not fit so every later append is a no-op and the caller fails with kSizeErr. */
+static int _LocalConfigAppendHeader( char *inBuf, int inLen, int inSize, const char *inFormat, ... )
+{
+  va_list args;
+  int n;
+
+  if( inLen >= inSize ) return inSize;
+  va_start( args, inFormat );
+  n = vsnprintf( inBuf + inLen, inSize - inLen, inFormat, args );
+  va_end( args );
+  if( n < 0 || n >= inSize - inLen ) return inSize;
+  return inLen + n;
+}
 
+static OSStatus _LocalConfigSendResponse( int fd, HTTPHeader_t* inHeader, int status, const char *contentType, const char *etag,
+                                          const uint8_t *inBody, size_t inBodyLen )
+{
+  OSStatus err = kNoMemoryErr;
+  configContext_t *context = (configContext_t *)inHeader->userContext;
+  bool keepAlive = inHeader->persistent && context->requestCount < CONFIG_SERVICE_MAX_REQUESTS;
+  char *httpResponse = NULL;
+  int httpResponseLen = 0;
+
+  httpResponse = malloc( kLocalConfigResponseHeaderSize );
+  require( httpResponse, exit );
+
+  httpResponseLen = _LocalConfigAppendHeader( httpResponse, httpResponseLen, kLocalConfigResponseHeaderSize, "%s %d %s%s",
+                                              "HTTP/1.1", status, getStatusString(status), kCRLFNewLine );
+  if( status != kStatusNotModified ){
+    if( contentType )
+      httpResponseLen = _LocalConfigAppendHeader( httpResponse, httpResponseLen, kLocalConfigResponseHeaderSize, "%s %s%s",
+                                                  "Content-Type:", contentType, kCRLFNewLine );
+    httpResponseLen = _LocalConfigAppendHeader( httpResponse, httpResponseLen, kLocalConfigResponseHeaderSize, "%s %d%s",
+                                                "Content-Length:", (int)inBodyLen, kCRLFNewLine );
+  }
+  if( etag )
+    httpResponseLen = _LocalConfigAppendHeader( httpResponse, httpResponseLen, kLocalConfigResponseHeaderSize, "%s %s%s",
+                                                "ETag:", etag, kCRLFNewLine );
+  if( keepAlive )
+    httpResponseLen = _LocalConfigAppendHeader( httpResponse, httpResponseLen, kLocalConfigResponseHeaderSize, "%s%s%s %s%d, %s%d%s",
+                                                "Connection: keep-alive", kCRLFNewLine,
+                                                "Keep-Alive:", "timeout=", CONFIG_SERVICE_IDLE_TIMEOUT,
+                                                "max=", (int)(CONFIG_SERVICE_MAX_REQUESTS - context->requestCount), kCRLFLineEnding );
+  else
+    httpResponseLen = _LocalConfigAppendHeader( httpResponse, httpResponseLen, kLocalConfigResponseHeaderSize, "%s%s",
+                                                "Connection: close", kCRLFLineEnding );
+  require_action( httpResponseLen < kLocalConfigResponseHeaderSize, exit, err = kSizeErr );
+
+  err = SocketSendHTTPMessage( fd, (uint8_t *)httpResponse, httpResponseLen, inBody, inBody? inBodyLen : 0 );
+
+exit:
+  if( httpResponse ) free( httpResponse );
+  return err;
 }
 
 static void _easylinkConnectWiFi( mico_Context_t * const inContext)
@@ -0,0 +1,286 @@
+/**
+******************************************************************************
+* @file    MICOConfigTLV.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Binary TLV16 configuration protocol served next to the JSON
+*          config endpoints.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "MICODefine.h"
+#include "MICOConfigTLV.h"
+
+#define tlv_log(M, ...) custom_log("Config TLV", M, ##__VA_ARGS__)
+
+#define CONFIG_TLV_MAX_CHANGED    4
+
+typedef struct
+{
+  flash_content_t *config;
+  void            (*changed[CONFIG_TLV_MAX_CHANGED])( flash_content_t *config );
+  int             changedCount;
+} config_tlv_write_t;
+
+/* Same as "Wi-Fi" and "Password" in ConfigIncommingJsonMessage: the key is derived from the
+   password again, and channel and BSSID of the old network are dropped */
+static void _ConfigTLVWlanChanged( flash_content_t *config )
+{
+  mico_sys_config_t *sys = &config->micoSystemConfig;
+
+  sys->user_keyLength = strnlen( sys->user_key, maxKeyLen );
+  memcpy( sys->key, sys->user_key, maxKeyLen );
+  sys->keyLength = sys->user_keyLength;
+  sys->security = SECURITY_TYPE_AUTO;
+  sys->channel = 0;
+  memset( sys->bssid, 0x0, 6 );
+}
+
+static const mico_config_tlv_field_t _systemFields[] =
+{
+  CONFIG_TLV_FIELD( kConfigTLVSystemName,         kConfigTLVFormat_String, micoSystemConfig.name,               NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemSSID,         kConfigTLVFormat_String, micoSystemConfig.ssid,               _ConfigTLVWlanChanged ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemPassword,     kConfigTLVFormat_String, micoSystemConfig.user_key,           _ConfigTLVWlanChanged ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemDHCP,         kConfigTLVFormat_Bool,   micoSystemConfig.dhcpEnable,         NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemIP,           kConfigTLVFormat_String, micoSystemConfig.localIp,            NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemNetMask,      kConfigTLVFormat_String, micoSystemConfig.netMask,            NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemGateway,      kConfigTLVFormat_String, micoSystemConfig.gateWay,            NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemDNSServer,    kConfigTLVFormat_String, micoSystemConfig.dnsServer,          NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemRFPowerSave,  kConfigTLVFormat_Bool,   micoSystemConfig.rfPowerSaveEnable,  NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemMCUPowerSave, kConfigTLVFormat_Bool,   micoSystemConfig.mcuPowerSaveEnable, NULL ),
+  CONFIG_TLV_FIELD( kConfigTLVSystemBonjour,      kConfigTLVFormat_Bool,   micoSystemConfig.bonjourEnable,      NULL ),
+};
+
+WEAK const mico_config_tlv_field_t *appConfigTLVSchema( size_t *outCount )
+{
+  *outCount = 0;
+  return NULL;
+}
+
+/* The application schema is only known at run time */
+static void _ConfigTLVRoot( mico_config_tlv_field_t root[2] )
+{
+  size_t appCount = 0;
+
+  memset( root, 0x0, 2 * sizeof(mico_config_tlv_field_t) );
+  root[0].type = kConfigTLVSystem;
+  root[0].format = kConfigTLVFormat_Container;
+  root[0].children = _systemFields;
+  root[0].childCount = sizeof( _systemFields ) / sizeof( _systemFields[0] );
+  root[1].type = kConfigTLVApp;
+  root[1].format = kConfigTLVFormat_Container;
+  root[1].children = appConfigTLVSchema( &appCount );
+  root[1].childCount = (uint8_t)appCount;
+}
+
+static const mico_config_tlv_field_t *_ConfigTLVFind( const mico_config_tlv_field_t *fields, size_t count, uint8_t type )
+{
+  size_t i;
+
+  for( i = 0; i < count; i++ ){
+    if( fields[i].type == type )
+      return &fields[i];
+  }
+  return NULL;
+}
+
+static OSStatus _ConfigTLVWriteField( config_tlv_write_t *write, const mico_config_tlv_field_t *field, const uint8_t *data, size_t len )
+{
+  OSStatus err = kNoErr;
+  uint8_t *dst = (uint8_t *)write->config + field->offset;
+  uint32_t value = 0;
+  size_t i;
+
+  switch( field->format ){
+    case kConfigTLVFormat_Bool:
+      require_action( len == 1 && data[0] <= 1, exit, err = kFormatErr );
+      *(bool *)dst = data[0];
+      break;
+
+    case kConfigTLVFormat_UInt:
+      require_action( len >= 1 && len <= 4, exit, err = kFormatErr );
+      for( i = 0; i < len; i++ )
+        value |= (uint32_t)data[i] << ( 8 * i );
+      require_action( field->size >= 4 || ( value >> ( 8 * field->size ) ) == 0, exit, err = kRangeErr );
+      if( field->size == 1 )      *(uint8_t *)dst = (uint8_t)value;
+      else if( field->size == 2 ) *(uint16_t *)dst = (uint16_t)value;
+      else                        *(uint32_t *)dst = value;
+      break;
+
+    case kConfigTLVFormat_String:
+      require_action( len <= field->size, exit, err = kSizeErr );
+      memset( dst, 0x0, field->size );
+      memcpy( dst, data, len );
+      break;
+
+    default:
+      err = kFormatErr;
+      goto exit;
+  }
+
+  if( field->changed ){
+    for( i = 0; i < (size_t)write->changedCount && write->changed[i] != field->changed; i++ );
+    if( i == (size_t)write->changedCount ){
+      require_action( write->changedCount < CONFIG_TLV_MAX_CHANGED, exit, err = kNoResourcesErr );
+      write->changed[write->changedCount++] = field->changed;
+    }
+  }
+
+exit:
+  return err;
+}
+
+static OSStatus _ConfigTLVWriteList( config_tlv_write_t *write, const mico_config_tlv_field_t *fields, size_t count,
+                                     const uint8_t *src, const uint8_t *end )
+{
+  OSStatus err = kNoErr;
+  const mico_config_tlv_field_t *field;
+  const uint8_t *data;
+  size_t len;
+  uint8_t type;
+
+  while( ( err = TLV16GetNext( src, end, &type, &data, &len, &src ) ) == kNoErr ){
+    field = _ConfigTLVFind( fields, count, type );
+    if( field == NULL ){
+      tlv_log("Skip unknown type 0x%02X", type);
+      continue;
+    }
+    if( field->format == kConfigTLVFormat_Container )
+      err = _ConfigTLVWriteList( write, field->children, field->childCount, data, data + len );
+    else
+      err = _ConfigTLVWriteField( write, field, data, len );
+    require_noerr_action( err, exit, tlv_log("Invalid item 0x%02X, err = %d", type, err) );
+  }
+  /* kNotFoundErr is the end of the list, a truncated item is an error */
+  require_action( err == kNotFoundErr && src == end, exit, err = kMalformedErr );
+  err = kNoErr;
+
+exit:
+  return err;
+}
+
+OSStatus MICOConfigTLVApply( const uint8_t *inData, size_t inLen, mico_Context_t * const inContext )
+{
+  OSStatus err = kNoErr;
+  config_tlv_write_t write;
+  mico_config_tlv_field_t root[2];
+  int i;
+
+  _ConfigTLVRoot( root );
+  memset( &write, 0x0, sizeof(write) );
+  /* Written to a copy, a message with an invalid item leaves the configuration untouched */
+  write.config = malloc( sizeof(flash_content_t) );
+  require_action( write.config, exit, err = kNoMemoryErr );
+
+  mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+  memcpy( write.config, &inContext->flashContentInRam, sizeof(flash_content_t) );
+  err = _ConfigTLVWriteList( &write, root, 2, inData, inData + inLen );
+  if( err == kNoErr ){
+    for( i = 0; i < write.changedCount; i++ )
+      write.changed[i]( write.config );
+    memcpy( &inContext->flashContentInRam, write.config, sizeof(flash_content_t) );
+  }
+  mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+
+exit:
+  if( write.config ) free( write.config );
+  return err;
+}
+
+static OSStatus _ConfigTLVReadList( const flash_content_t *config, const mico_config_tlv_field_t *fields, size_t count,
+                                    uint8_t *buf, size_t bufSize, size_t *ioLen )
+{
+  OSStatus err = kNoErr;
+  const uint8_t *src;
+  uint8_t value[4];
+  uint32_t number;
+  size_t container, i, j;
+
+  for( i = 0; i < count; i++ ){
+    src = (const uint8_t *)config + fields[i].offset;
+    switch( fields[i].format ){
+      case kConfigTLVFormat_Bool:
+        value[0] = *(const bool *)src ? 1 : 0;
+        err = TLV16Append( buf, bufSize, ioLen, fields[i].type, value, 1 );
+        break;
+
+      case kConfigTLVFormat_UInt:
+        if( fields[i].size == 1 )      number = *(const uint8_t *)src;
+        else if( fields[i].size == 2 ) number = *(const uint16_t *)src;
+        else                           number = *(const uint32_t *)src;
+        for( j = 0; j < fields[i].size && j < 4; j++ )
+          value[j] = (uint8_t)( number >> ( 8 * j ) );
+        err = TLV16Append( buf, bufSize, ioLen, fields[i].type, value, j );
+        break;
+
+      case kConfigTLVFormat_String:
+        err = TLV16Append( buf, bufSize, ioLen, fields[i].type, src, strnlen( (const char *)src, fields[i].size ) );
+        break;
+
+      case kConfigTLVFormat_Container:
+        err = TLV16BeginContainer( buf, bufSize, ioLen, fields[i].type, &container );
+        require_noerr( err, exit );
+        err = _ConfigTLVReadList( config, fields[i].children, fields[i].childCount, buf, bufSize, ioLen );
+        require_noerr( err, exit );
+        err = TLV16EndContainer( buf, *ioLen, container );
+        break;
+
+      default:
+        break;
+    }
+    require_noerr( err, exit );
+  }
+
+exit:
+  return err;
+}
+
+OSStatus MICOConfigTLVCreateReport( mico_Context_t * const inContext, uint8_t **outData, size_t *outLen )
+{
+  OSStatus err = kNoErr;
+  mico_config_tlv_field_t root[2];
+  size_t len = 0;
+  uint8_t *buf = NULL;
+
+  _ConfigTLVRoot( root );
+
+  mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+  /* The first pass only measures */
+  err = _ConfigTLVReadList( &inContext->flashContentInRam, root, 2, NULL, 0, &len );
+  require_noerr( err, exit );
+  buf = malloc( len );
+  require_action( buf, exit, err = kNoMemoryErr );
+  *outLen = 0;
+  err = _ConfigTLVReadList( &inContext->flashContentInRam, root, 2, buf, len, outLen );
+  require_noerr( err, exit );
+  *outData = buf;
+  buf = NULL;
+
+exit:
+  mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+  if( buf ) free( buf );
+  return err;
+}
@@ -0,0 +1,107 @@
+/**
+******************************************************************************
+* @file    MICOConfigTLV.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide function prototypes for the binary TLV16
+*          configuration protocol served next to the JSON config endpoints.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MICOCONFIGTLV_H__
+#define __MICOCONFIGTLV_H__
+
+#include <stddef.h>
+#include "Common.h"
+#include "MICODefine.h"
+#include "TLVUtils.h"
+
+/* A message is a TLV16 list (see TLVUtils.h) of containers. Container kConfigTLVSystem holds
+   the MICO system fields below, container kConfigTLVApp the fields the application describes
+   with appConfigTLVSchema. Every field is a schema entry pointing straight into
+   flash_content_t, so a write is a table lookup and a copy per item.
+
+   Value encodings:
+     kConfigTLVFormat_Bool      1 byte, 0 or 1
+     kConfigTLVFormat_UInt      1 to 4 bytes little endian, written as the field size
+     kConfigTLVFormat_String    UTF-8 without terminator, at most the field size
+     kConfigTLVFormat_Container TLV16 list of the children
+
+   Unknown types are skipped so older firmware accepts messages of newer tools. A write is
+   applied completely or not at all. */
+
+#define kConfigTLVSystem                0x01
+#define kConfigTLVApp                   0x02
+
+/* Items of kConfigTLVSystem */
+#define kConfigTLVSystemName            0x01
+#define kConfigTLVSystemSSID            0x02
+#define kConfigTLVSystemPassword        0x03
+#define kConfigTLVSystemDHCP            0x04
+#define kConfigTLVSystemIP              0x05
+#define kConfigTLVSystemNetMask         0x06
+#define kConfigTLVSystemGateway         0x07
+#define kConfigTLVSystemDNSServer       0x08
+#define kConfigTLVSystemRFPowerSave     0x09
+#define kConfigTLVSystemMCUPowerSave    0x0A
+#define kConfigTLVSystemBonjour         0x0B
+
+#define kMIMEType_MXCHIP_TLV            "application/x-mxchip-tlv"
+
+enum
+{
+  kConfigTLVFormat_Bool,
+  kConfigTLVFormat_UInt,
+  kConfigTLVFormat_String,
+  kConfigTLVFormat_Container,
+};
+
+typedef struct _mico_config_tlv_field_t
+{
+  uint8_t         type;
+  uint8_t         format;
+  uint16_t        offset;               /**< offsetof( flash_content_t, ... ) */
+  uint16_t        size;
+  void            (*changed)( flash_content_t *config ); /**< Called once after a write that changed this field, or NULL */
+  const struct _mico_config_tlv_field_t *children;       /**< Items of a container */
+  uint8_t         childCount;
+} mico_config_tlv_field_t;
+
+#define CONFIG_TLV_FIELD( type, format, member, changed ) \
+  { (type), (format), offsetof( flash_content_t, member ), sizeof( ((flash_content_t *)0)->member ), (changed), NULL, 0 }
+
+#define CONFIG_TLV_CONTAINER( type, children ) \
+  { (type), kConfigTLVFormat_Container, 0, 0, NULL, (children), sizeof( children ) / sizeof( (children)[0] ) }
+
+/* Applies a message to flashContentInRam, the caller saves it with MICOUpdateConfiguration */
+OSStatus MICOConfigTLVApply( const uint8_t *inData, size_t inLen, mico_Context_t * const inContext );
+
+/* Creates a message with every field of the schema, free outData when done */
+OSStatus MICOConfigTLVCreateReport( mico_Context_t * const inContext, uint8_t **outData, size_t *outLen );
+
+/* Implemented by the application to make its configuration available, returns NULL by default */
+const mico_config_tlv_field_t *appConfigTLVSchema( size_t *outCount );
+
+#endif
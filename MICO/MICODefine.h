@@ -60,14 +60,20 @@
   #define STACK_SIZE_LOCAL_CONFIG_CLIENT_THREAD   0x420
   #define STACK_SIZE_NTP_CLIENT_THREAD            0x400
   #define STACK_SIZE_MICO_SYSTEM_MONITOR_THREAD   0x300
+  #define STACK_SIZE_MICO_WORK_QUEUE_THREAD       0x500
+  #define STACK_SIZE_MICO_LOG_THREAD              0x400
 #else
   #define STACK_SIZE_LOCAL_CONFIG_SERVER_THREAD   0x180
   #define STACK_SIZE_LOCAL_CONFIG_CLIENT_THREAD   0x3C0
   #define STACK_SIZE_NTP_CLIENT_THREAD            0x3A0
-  #define STACK_SIZE_MICO_SYSTEM_MONITOR_THREAD   0x120
+  #define STACK_SIZE_MICO_SYSTEM_MONITOR_THREAD   0x200
+  #define STACK_SIZE_MICO_WORK_QUEUE_THREAD       0x400
+  #define STACK_SIZE_MICO_LOG_THREAD              0x300
 #endif
 
 #define CONFIG_SERVICE_PORT     8000
+#define CONFIG_SERVICE_IDLE_TIMEOUT       30    /**< Seconds a persistent connection may stay idle. */
+#define CONFIG_SERVICE_MAX_REQUESTS       100   /**< Requests served on one connection before it is closed. */
 
 #define APPLICATION_WATCHDOG_TIMEOUT_SECONDS  5 /**< Watch-dog enabled by MICO's main thread:
                                                      5 seconds to reload. */
@@ -37,6 +37,10 @@
 
 #include "MICONotificationCenter.h"
 #include "MICOSystemMonitor.h"
+#include "MICOWorkQueue.h"
+#include "MICOLog.h"
+#include "MICOTrace.h"
+#include "MICOConfigReport.h"
 #include "MicoCli.h"
 #include "EasyLink/EasyLink.h"
 #include "SoftAP/EasyLinkSoftAP.h"
@@ -158,6 +162,7 @@ void micoNotify_DHCPCompleteHandler(IPStatusTypedef *pnet, mico_Context_t * cons
   strcpy((char *)inContext->micoStatus.gateWay, pnet->gate);
   strcpy((char *)inContext->micoStatus.dnsServer, pnet->dns);
   mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
+  MICOConfigReportInvalidate();
 exit:
   return;
 }
@@ -277,6 +282,11 @@ int application_start(void)
   struct tm currentTime;
   mico_rtc_time_t time;
   char wifi_ver[64] = {0};
+
+  /*Start printing deferred logs, does nothing unless MICO_LOG_DEFERRED is defined*/
+  MicoLogInit();
+  /*Start recording trace points, does nothing unless MICO_TRACE_ENABLE is defined*/
+  MicoTraceStart();
   mico_log_trace(); 
 
   /*Read current configurations*/
@@ -288,6 +298,10 @@ int application_start(void)
 
   MICOReadConfiguration( context );
 
+  /*Start the worker threads shared by MICO services, asynchronous notifications run there*/
+  err = MICOStartWorkQueue();
+  require_noerr_action( err, exit, mico_log("ERROR: Unable to start the work queue.") );
+
   err = MICOInitNotificationCenter  ( context );
 
   err = MICOAddNotification( mico_notify_READ_APP_INFO, (void *)micoNotify_ReadAppInfoHandler );
@@ -320,7 +334,7 @@ int application_start(void)
   err = MICOStartSystemMonitor(context);
   require_noerr_action( err, exit, mico_log("ERROR: Unable to start the system monitor.") );
 
-  err = MICORegisterSystemMonitor(&mico_monitor, APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000);
+  err = MICORegisterSystemMonitorNamed(&mico_monitor, "MICO timer", APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000);
   require_noerr( err, exit );
   mico_init_timer(&_watchdog_reload_timer,APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000/2, _watchdog_reload_timer_handler, NULL);
   mico_start_timer(&_watchdog_reload_timer);
@@ -369,7 +383,8 @@ int application_start(void)
   WAC_Params = calloc(1, sizeof(WACPlatformParameters_t));
   require(WAC_Params, exit);
 
-  str2hex((unsigned char *)para.mac, WAC_Params->macAddress, 6);
+  err = HexStringToData( para.mac, kSizeCString, WAC_Params->macAddress, sizeof( WAC_Params->macAddress ), NULL );
+  require_noerr_action( err, exit, free( WAC_Params ) );
   WAC_Params->isUnconfigured          = 1;
   WAC_Params->supportsAirPlay         = 0;
   WAC_Params->supportsAirPrint        = 0;
@@ -406,7 +421,9 @@ int application_start(void)
   else{
     mico_log("Available configuration. Starting Wi-Fi connection...");
     
-    err = MICOAddNotification( mico_notify_WiFI_PARA_CHANGED, (void *)micoNotify_WiFIParaChangedHandler );
+    /* Saving the new AP info writes flash, keep that out of the Wi-Fi driver thread */
+    err = MICOAddNotificationEx( mico_notify_WiFI_PARA_CHANGED, (void *)micoNotify_WiFIParaChangedHandler, context,
+                                 MICO_NOTIFY_PRIORITY_NORMAL, MICO_NOTIFY_ASYNC );
     require_noerr( err, exit ); 
 
     err = MICOAddNotification( mico_notify_DHCP_COMPLETED, (void *)micoNotify_DHCPCompleteHandler );
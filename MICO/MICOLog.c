@@ -0,0 +1,622 @@
+/**
+******************************************************************************
+* @file    MICOLog.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Deferred log backend: custom_log records its raw arguments into a
+*          RAM ring that a low priority thread formats and prints.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "MICODefine.h"
+#include "MICOLog.h"
+
+#if DEBUG && defined(MICO_LOG_DEFERRED) && !defined(MICO_DISABLE_STDIO) && !defined(NO_MICO_RTOS)
+
+#include "stdarg.h"
+
+#define LOG_MODULE_CACHE_SIZE   16
+
+#define LOG_RECORD_PADDING      0x01    /* Fills the end of the ring, not a record */
+#define LOG_RECORD_TRUNCATED    0x02
+
+#define LOG_LINE_SIZE           160
+
+enum {
+  LOG_ARG_NONE,
+  LOG_ARG_INT,
+  LOG_ARG_INT64,
+  LOG_ARG_DOUBLE,
+  LOG_ARG_POINTER,
+  LOG_ARG_STRING,
+};
+
+/* Followed by the arguments: 32 bit for ints and '*' widths, 64 bit for long long and double,
+   and strings as a length byte, the characters and a NUL */
+typedef struct
+{
+  uint16_t    size;                 /* Header and arguments, multiple of 4 */
+  uint8_t     level;
+  uint8_t     flags;
+  uint32_t    time;
+  const char  *module;
+  const char  *file;
+  const char  *format;
+  uint32_t    line;
+} log_record_t;
+
+typedef struct
+{
+  const char  *name;
+  int8_t      level;
+} log_module_t;
+
+static uint32_t log_ring[MICO_LOG_BUFFER_SIZE/4];
+static uint32_t ring_head = 0;
+static uint32_t ring_tail = 0;
+static uint32_t ring_used = 0;
+
+static log_module_t log_modules[MICO_LOG_MAX_MODULES];
+static log_module_t *log_module_cache[LOG_MODULE_CACHE_SIZE];
+static int log_module_count = 0;
+static int8_t log_default_level = MICO_LOG_INFO;
+
+static mico_log_stats_t log_stats;
+static uint32_t log_cycles_total = 0;
+static uint32_t log_dropped_reported = 0;
+
+static bool log_initialized = false;
+static volatile bool log_wake_pending = false;
+static mico_semaphore_t log_drain_sem;
+static mico_mutex_t log_drain_mutex;
+
+/* Only used with log_drain_mutex held */
+static uint32_t log_drain_buffer[MICO_LOG_MAX_RECORD/4];
+static char log_line[LOG_LINE_SIZE];
+
+/* Module levels */
+
+static log_module_t *_log_module_find( const char *name )
+{
+  int i;
+
+  for( i = 0; i < log_module_count; i++ ){
+    if( log_modules[i].name == name || strcmp( log_modules[i].name, name ) == 0 )
+      return &log_modules[i];
+  }
+  return NULL;
+}
+
+/* Module names are string literals, so the pointer is a good cache key. The same name can have
+   different pointers in different files, each of them gets its own cache slot. */
+static log_module_t *_log_module_get( const char *name )
+{
+  log_module_t **slot = &log_module_cache[((uintptr_t)name >> 2) % LOG_MODULE_CACHE_SIZE];
+  log_module_t *module = *slot;
+
+  if( module && module->name == name )
+    return module;
+
+  mico_rtos_suspend_all_thread();
+  module = _log_module_find( name );
+  if( module == NULL && log_module_count < MICO_LOG_MAX_MODULES ){
+    module = &log_modules[log_module_count];
+    module->name = name;
+    module->level = log_default_level;
+    log_module_count++;
+  }
+  if( module && module->name == name )
+    *slot = module;
+  mico_rtos_resume_all_thread();
+
+  return module;
+}
+
+/* Format strings */
+
+/* Parses a conversion after its '%', returns the character after it */
+static const char *_log_parse_spec( const char *p, int *stars, int *type )
+{
+  int longs = 0;
+
+  *stars = 0;
+  *type = LOG_ARG_NONE;
+
+  while( *p && strchr( "-+ #0", *p ) ) p++;
+  if( *p == '*' ){
+    (*stars)++;
+    p++;
+  }else{
+    while( *p >= '0' && *p <= '9' ) p++;
+  }
+  if( *p == '.' ){
+    p++;
+    if( *p == '*' ){
+      (*stars)++;
+      p++;
+    }else{
+      while( *p >= '0' && *p <= '9' ) p++;
+    }
+  }
+  while( *p && strchr( "hlLqjzt", *p ) ){
+    if( *p == 'l' ) longs += ( sizeof(long) == 8 )? 2 : 1;
+    if( *p == 'q' || *p == 'j' ) longs += 2;
+    p++;
+  }
+
+  switch( *p ){
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+      *type = ( longs >= 2 )? LOG_ARG_INT64 : LOG_ARG_INT;
+      break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      *type = LOG_ARG_DOUBLE;
+      break;
+    case 'p': case 'n':
+      *type = LOG_ARG_POINTER;
+      break;
+    case 's':
+      *type = LOG_ARG_STRING;
+      break;
+    case '\0':
+      return p;
+    default:
+      break;
+  }
+  return p + 1;
+}
+
+/* Copies the arguments, strings by value since they may live on the caller's stack */
+static size_t _log_pack_args( uint8_t *buf, size_t bufLen, const char *format, va_list args, bool *truncated )
+{
+  const char *p = format;
+  size_t used = 0, len;
+  int stars, type, i;
+  int32_t value32;
+  int64_t value64;
+  double valueDouble;
+  void *pointer;
+  const char *str;
+
+  *truncated = false;
+  while( ( p = strchr( p, '%' ) ) != NULL ){
+    p = _log_parse_spec( p + 1, &stars, &type );
+
+    for( i = 0; i < stars; i++ ){
+      value32 = va_arg( args, int );
+      if( used + sizeof(int32_t) > bufLen ) goto full;
+      memcpy( buf + used, &value32, sizeof(int32_t) );
+      used += sizeof(int32_t);
+    }
+
+    switch( type ){
+      case LOG_ARG_INT:
+        value32 = va_arg( args, int );
+        if( used + sizeof(int32_t) > bufLen ) goto full;
+        memcpy( buf + used, &value32, sizeof(int32_t) );
+        used += sizeof(int32_t);
+        break;
+      case LOG_ARG_INT64:
+        value64 = va_arg( args, long long );
+        if( used + sizeof(int64_t) > bufLen ) goto full;
+        memcpy( buf + used, &value64, sizeof(int64_t) );
+        used += sizeof(int64_t);
+        break;
+      case LOG_ARG_DOUBLE:
+        valueDouble = va_arg( args, double );
+        if( used + sizeof(double) > bufLen ) goto full;
+        memcpy( buf + used, &valueDouble, sizeof(double) );
+        used += sizeof(double);
+        break;
+      case LOG_ARG_POINTER:
+        pointer = va_arg( args, void * );
+        if( used + sizeof(void *) > bufLen ) goto full;
+        memcpy( buf + used, &pointer, sizeof(void *) );
+        used += sizeof(void *);
+        break;
+      case LOG_ARG_STRING:
+        str = va_arg( args, const char * );
+        if( str == NULL ) str = "(null)";
+        if( used + 2 > bufLen ) goto full;
+        len = strlen( str );
+        if( len > bufLen - used - 2 || len > 0xFF ){
+          len = Min( bufLen - used - 2, 0xFF );
+          *truncated = true;
+        }
+        buf[used++] = (uint8_t)len;
+        memcpy( buf + used, str, len );
+        used += len;
+        buf[used++] = 0x0;
+        break;
+      default:
+        break;
+    }
+  }
+  return used;
+
+full:
+  *truncated = true;
+  return used;
+}
+
+#define LOG_SNPRINTF( VALUE ) \
+  ( ( stars == 0 )? snprintf( out + pos, outLen - pos, spec, VALUE ) : \
+    ( stars == 1 )? snprintf( out + pos, outLen - pos, spec, star[0], VALUE ) : \
+                    snprintf( out + pos, outLen - pos, spec, star[0], star[1], VALUE ) )
+
+static void _log_format( char *out, size_t outLen, const char *format, const uint8_t *args, size_t argsLen )
+{
+  const char *p = format, *end;
+  char spec[16];
+  size_t pos = 0, used = 0, need;
+  int stars, type, star[2], i, written;
+  int32_t value32;
+  int64_t value64;
+  double valueDouble;
+  void *pointer;
+
+  while( *p && pos + 1 < outLen ){
+    if( *p != '%' ){
+      out[pos++] = *p++;
+      continue;
+    }
+
+    end = _log_parse_spec( p + 1, &stars, &type );
+    if( type == LOG_ARG_NONE ){
+      if( p[1] == '%' )
+        out[pos++] = '%';
+      p = end;
+      continue;
+    }
+
+    need = stars * sizeof(int32_t);
+    switch( type ){
+      case LOG_ARG_INT:     need += sizeof(int32_t); break;
+      case LOG_ARG_INT64:   need += sizeof(int64_t); break;
+      case LOG_ARG_DOUBLE:  need += sizeof(double); break;
+      case LOG_ARG_POINTER: need += sizeof(void *); break;
+      case LOG_ARG_STRING:
+        need += 2;
+        if( used + need <= argsLen )
+          need += args[used + stars * sizeof(int32_t)];
+        break;
+    }
+    if( used + need > argsLen || (size_t)( end - p ) >= sizeof(spec) ){
+      /* Arguments were cut when recording */
+      snprintf( out + pos, outLen - pos, "..." );
+      pos += strlen( out + pos );
+      break;
+    }
+
+    memcpy( spec, p, end - p );
+    spec[end - p] = 0x0;
+    for( i = 0; i < stars; i++ ){
+      memcpy( &star[i], args + used, sizeof(int32_t) );
+      used += sizeof(int32_t);
+    }
+
+    written = 0;
+    switch( type ){
+      case LOG_ARG_INT:
+        memcpy( &value32, args + used, sizeof(int32_t) );
+        written = LOG_SNPRINTF( value32 );
+        break;
+      case LOG_ARG_INT64:
+        memcpy( &value64, args + used, sizeof(int64_t) );
+        written = LOG_SNPRINTF( value64 );
+        break;
+      case LOG_ARG_DOUBLE:
+        memcpy( &valueDouble, args + used, sizeof(double) );
+        written = LOG_SNPRINTF( valueDouble );
+        break;
+      case LOG_ARG_POINTER:
+        memcpy( &pointer, args + used, sizeof(void *) );
+        if( end[-1] != 'n' )
+          written = LOG_SNPRINTF( pointer );
+        break;
+      case LOG_ARG_STRING:
+        written = LOG_SNPRINTF( (const char *)( args + used + 1 ) );
+        break;
+    }
+    used += need - stars * sizeof(int32_t);
+    if( written > 0 )
+      pos += Min( (size_t)written, outLen - pos - 1 );
+    p = end;
+  }
+  out[pos] = 0x0;
+}
+
+/* Ring */
+
+/* Call with the scheduler suspended */
+static void *_log_ring_reserve( uint32_t size )
+{
+  log_record_t *padding;
+  uint32_t tail_room = MICO_LOG_BUFFER_SIZE - ring_head;
+  void *record;
+
+  if( size > tail_room ){
+    /* Records are never split, the end of the ring is skipped */
+    if( ring_used + tail_room + size > MICO_LOG_BUFFER_SIZE )
+      return NULL;
+    padding = (log_record_t *)( (uint8_t *)log_ring + ring_head );
+    padding->size = tail_room;
+    padding->flags = LOG_RECORD_PADDING;
+    ring_used += tail_room;
+    ring_head = 0;
+  }
+  if( ring_used + size > MICO_LOG_BUFFER_SIZE )
+    return NULL;
+
+  record = (uint8_t *)log_ring + ring_head;
+  ring_head = ( ring_head + size ) % MICO_LOG_BUFFER_SIZE;
+  ring_used += size;
+  return record;
+}
+
+/* Copies the oldest record into log_drain_buffer */
+static bool _log_ring_take( void )
+{
+  log_record_t *record;
+  bool found = false;
+
+  mico_rtos_suspend_all_thread();
+  while( ring_used > 0 ){
+    record = (log_record_t *)( (uint8_t *)log_ring + ring_tail );
+    ring_tail = ( ring_tail + record->size ) % MICO_LOG_BUFFER_SIZE;
+    ring_used -= record->size;
+    if( record->flags & LOG_RECORD_PADDING )
+      continue;
+    memcpy( log_drain_buffer, record, record->size );
+    found = true;
+    break;
+  }
+  mico_rtos_resume_all_thread();
+
+  return found;
+}
+
+void MicoLogRecord( const char *module, int level, const char *file, int line, const char *format, ... )
+{
+  uint32_t start = mico_cycle_counter();
+  uint32_t buffer[MICO_LOG_MAX_RECORD/4];
+  log_record_t *record = (log_record_t *)buffer;
+  log_module_t *entry;
+  void *dest;
+  bool truncated, wake = false;
+  uint32_t size, cycles;
+  va_list args;
+
+  entry = _log_module_get( module );
+  if( level > ( entry? entry->level : log_default_level ) ){
+    log_stats.filtered++;
+    return;
+  }
+
+  record->level = level;
+  record->flags = 0;
+  record->time = mico_get_time();
+  record->module = module;
+  record->file = file;
+  record->format = format;
+  record->line = line;
+
+  va_start( args, format );
+  size = sizeof(log_record_t) + _log_pack_args( (uint8_t *)( record + 1 ), MICO_LOG_MAX_RECORD - sizeof(log_record_t), format, args, &truncated );
+  va_end( args );
+  size = ( size + 3 ) & ~3;
+  record->size = size;
+  if( truncated )
+    record->flags |= LOG_RECORD_TRUNCATED;
+
+  mico_rtos_suspend_all_thread();
+  dest = _log_ring_reserve( size );
+  if( dest ){
+    memcpy( dest, record, size );
+    log_stats.records++;
+    if( truncated )
+      log_stats.truncated++;
+    if( ring_used > log_stats.buffer_high_water )
+      log_stats.buffer_high_water = ring_used;
+    if( ring_used > MICO_LOG_BUFFER_SIZE/2 && log_wake_pending == false ){
+      log_wake_pending = true;
+      wake = true;
+    }
+    cycles = mico_cycle_counter() - start;
+    log_cycles_total += cycles;
+    if( cycles > log_stats.cycles_max )
+      log_stats.cycles_max = cycles;
+  }else{
+    log_stats.dropped++;
+  }
+  mico_rtos_resume_all_thread();
+
+  if( wake && log_initialized )
+    mico_rtos_set_semaphore( &log_drain_sem );
+}
+
+/* Drain */
+
+static void _log_drain( void )
+{
+  log_record_t *record = (log_record_t *)log_drain_buffer;
+  const char *file;
+  uint32_t dropped;
+
+  if( log_initialized )
+    mico_rtos_lock_mutex( &log_drain_mutex );
+
+  while( _log_ring_take() ){
+    _log_format( log_line, sizeof(log_line), record->format, (uint8_t *)( record + 1 ), record->size - sizeof(log_record_t) );
+    file = strrchr( record->file, '\\' );
+    if( file == NULL )
+      file = strrchr( record->file, '/' );
+    file = file? file + 1 : record->file;
+
+    mico_rtos_lock_mutex( &stdio_tx_mutex );
+    printf( "[%d][%s: %s:%4d] %s\r\n", record->time, record->module, file, record->line, log_line );
+    mico_rtos_unlock_mutex( &stdio_tx_mutex );
+  }
+
+  dropped = log_stats.dropped;
+  if( dropped != log_dropped_reported ){
+    mico_rtos_lock_mutex( &stdio_tx_mutex );
+    printf( "[%d][LOG] %d records dropped, ring full\r\n", mico_get_time(), dropped - log_dropped_reported );
+    mico_rtos_unlock_mutex( &stdio_tx_mutex );
+    log_dropped_reported = dropped;
+  }
+
+  if( log_initialized )
+    mico_rtos_unlock_mutex( &log_drain_mutex );
+}
+
+static void _log_drain_thread( void *arg )
+{
+  UNUSED_PARAMETER( arg );
+
+  while( 1 ){
+    mico_rtos_get_semaphore( &log_drain_sem, MICO_LOG_DRAIN_INTERVAL );
+    log_wake_pending = false;
+    _log_drain();
+  }
+}
+
+OSStatus MicoLogInit( void )
+{
+  OSStatus err = kNoErr;
+
+  require_action( log_initialized == false, exit, err = kAlreadyInitializedErr );
+
+  mico_cycle_counter_enable();
+  err = mico_rtos_init_semaphore( &log_drain_sem, 1 );
+  require_noerr( err, exit );
+  err = mico_rtos_init_mutex( &log_drain_mutex );
+  require_noerr( err, exit );
+  log_initialized = true;
+
+  err = mico_rtos_create_thread( NULL, MICO_LOG_DRAIN_PRIORITY, "Log", _log_drain_thread, STACK_SIZE_MICO_LOG_THREAD, NULL );
+  require_noerr( err, exit );
+
+exit:
+  return err;
+}
+
+void MicoLogFlush( void )
+{
+  _log_drain();
+}
+
+OSStatus MicoLogSetLevel( const char *module, int level )
+{
+  OSStatus err = kNoErr;
+  log_module_t *entry;
+  int i;
+
+  require_action( level >= MICO_LOG_OFF && level <= MICO_LOG_DEBUG, exit, err = kParamErr );
+
+  mico_rtos_suspend_all_thread();
+  if( module == NULL ){
+    log_default_level = level;
+    for( i = 0; i < log_module_count; i++ )
+      log_modules[i].level = level;
+  }else{
+    entry = _log_module_find( module );
+    if( entry )
+      entry->level = level;
+    else
+      err = kNotFoundErr;
+  }
+  mico_rtos_resume_all_thread();
+
+exit:
+  return err;
+}
+
+int MicoLogGetLevel( const char *module )
+{
+  log_module_t *entry;
+  int level;
+
+  mico_rtos_suspend_all_thread();
+  entry = _log_module_find( module );
+  level = entry? entry->level : log_default_level;
+  mico_rtos_resume_all_thread();
+
+  return level;
+}
+
+void MicoLogForEachModule( void (*function)( const char *module, int level, void *arg ), void *arg )
+{
+  int i, count = log_module_count;
+
+  /* Entries are only ever appended */
+  for( i = 0; i < count; i++ )
+    function( log_modules[i].name, log_modules[i].level, arg );
+}
+
+void MicoLogGetStats( mico_log_stats_t *outStats )
+{
+  mico_rtos_suspend_all_thread();
+  memcpy( outStats, &log_stats, sizeof(mico_log_stats_t) );
+  outStats->cycles_avg = log_stats.records? log_cycles_total/log_stats.records : 0;
+  mico_rtos_resume_all_thread();
+}
+
+#else
+
+OSStatus MicoLogInit( void )
+{
+  return kNoErr;
+}
+
+void MicoLogFlush( void )
+{
+}
+
+OSStatus MicoLogSetLevel( const char *module, int level )
+{
+  UNUSED_PARAMETER( module );
+  UNUSED_PARAMETER( level );
+  return kUnsupportedErr;
+}
+
+int MicoLogGetLevel( const char *module )
+{
+  UNUSED_PARAMETER( module );
+  return MICO_LOG_INFO;
+}
+
+void MicoLogForEachModule( void (*function)( const char *module, int level, void *arg ), void *arg )
+{
+  UNUSED_PARAMETER( function );
+  UNUSED_PARAMETER( arg );
+}
+
+void MicoLogGetStats( mico_log_stats_t *outStats )
+{
+  memset( outStats, 0, sizeof(mico_log_stats_t) );
+}
+
+#endif
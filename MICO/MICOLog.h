@@ -0,0 +1,97 @@
+/**
+******************************************************************************
+* @file    MICOLog.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide function prototypes for the deferred log backend
+*          and the per module log levels.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MICOLOG_H__
+#define __MICOLOG_H__
+
+#include "Common.h"
+
+/* With MICO_LOG_DEFERRED defined in MicoDefaults.h, custom_log no longer formats and prints on the
+   caller's thread. The call copies the format string pointer, module, file, line and raw arguments
+   into a RAM ring, %s arguments by value, and returns. A thread at MICO_LOG_DRAIN_PRIORITY formats
+   and prints the records later, so a log call costs a few hundred cycles instead of a printf over
+   the UART, and no longer takes stdio_tx_mutex.
+
+   Records that do not fit into the ring are dropped and counted. The drain thread wakes up every
+   MICO_LOG_DRAIN_INTERVAL ms, or as soon as the ring is half full.
+
+   Every module, the first argument of custom_log, has a runtime level. Records above it are
+   dropped before anything is copied. New modules start at the default level, MICO_LOG_INFO. */
+
+#ifndef MICO_LOG_BUFFER_SIZE
+#define MICO_LOG_BUFFER_SIZE        2048
+#endif
+
+#ifndef MICO_LOG_MAX_RECORD
+#define MICO_LOG_MAX_RECORD         128     /* Header and arguments of one call, longer strings are cut */
+#endif
+
+#ifndef MICO_LOG_MAX_MODULES
+#define MICO_LOG_MAX_MODULES        32
+#endif
+
+#ifndef MICO_LOG_DRAIN_INTERVAL
+#define MICO_LOG_DRAIN_INTERVAL     100
+#endif
+
+#ifndef MICO_LOG_DRAIN_PRIORITY
+#define MICO_LOG_DRAIN_PRIORITY     8
+#endif
+
+typedef struct
+{
+  uint32_t records;                 /**< Calls recorded into the ring */
+  uint32_t dropped;                 /**< Calls lost because the ring was full */
+  uint32_t filtered;                /**< Calls below the level of their module */
+  uint32_t truncated;               /**< Records cut to MICO_LOG_MAX_RECORD */
+  uint32_t buffer_high_water;       /**< Most bytes used in the ring */
+  uint32_t cycles_avg;              /**< CPU cycles spent in one recorded call */
+  uint32_t cycles_max;
+} mico_log_stats_t;
+
+/* Starts the drain thread, records made before are kept and printed then */
+OSStatus MicoLogInit( void );
+
+/* Prints every record in the ring from the calling thread */
+void     MicoLogFlush( void );
+
+/* module NULL sets the level of every module and the default level of new ones */
+OSStatus MicoLogSetLevel( const char *module, int level );
+
+int      MicoLogGetLevel( const char *module );
+
+/* Calls function for every module that has logged or had its level set */
+void     MicoLogForEachModule( void (*function)( const char *module, int level, void *arg ), void *arg );
+
+void     MicoLogGetStats( mico_log_stats_t *outStats );
+
+#endif //__MICOLOG_H__
@@ -31,7 +31,10 @@
 
 #include "MICOAppDefine.h"
 #include "MICODefine.h"
+#include "MICONTPClient.h"
 #include "SocketUtils.h"
+#include "DNSUtils.h"
+#include "RandomUtils.h"
 #include "MICONotificationCenter.h"
 #include "time.h"
 #include "MicoPlatform.h"
@@ -39,39 +42,60 @@
 #define ntp_log(M, ...) custom_log("NTP client", M, ##__VA_ARGS__)
 #define ntp_log_trace() custom_log_trace("NTP client")
 
-
-#define UNIX_OFFSET 		         2208960000U
-#define NTP_Server               "time.asia.apple.com"
+#define UNIX_OFFSET              2208988800U  /* 1900-01-01 to 1970-01-01 */
 #define NTP_Port                 123
-#define NTP_Flags                0xdb 
-#define NTP_Stratum              0x0
-#define NTP_Poll                 0x0a
-#define NTP_Precision            0xfa
-#define NTP_Root_Delay           0x8000
-#define NTP_Root_Dispersion      0xa00b0000
+#define NTP_PACKET_SIZE          48
+
+#define NTP_LI_UNSYNCHRONIZED    3
+#define NTP_VERSION              4
+#define NTP_MODE_CLIENT          3
+#define NTP_MODE_SERVER          4
+#define NTP_MODE_BROADCAST       5
+
+#define NTP_MAX_SLEW_PPM         500
+#define NTP_MAX_DRIFT_PPB        500000
+#define NTP_MIN_DRIFT_INTERVAL   ( 15 * 60 * 1000 )  /* Shorter intervals give too noisy a frequency estimate */
+#define NTP_KOD_BACKOFF          ( 60 * 60 * 1000 )  /* A server that sent a kiss-o'-death is left alone this long */
+
+/* Offsets of the fields used in a packet */
+#define NTP_OFFSET_FLAGS         0
+#define NTP_OFFSET_STRATUM       1
+#define NTP_OFFSET_ORIGIN        24
+#define NTP_OFFSET_RECEIVE       32
+#define NTP_OFFSET_TRANSMIT      40
+
+typedef struct
+{
+  uint32_t  ip;
+  uint64_t  transmit;         /* Transmit timestamp of the outstanding request, 0 if none */
+  int64_t   t1;               /* us, local clock when it was sent */
+  int64_t   offset;           /* us, best sample so far */
+  int64_t   delay;            /* us, best sample so far, -1 if none */
+  uint32_t  kod_time;         /* mico_get_time of the last kiss-o'-death */
+  bool      kod;
+} ntp_server_t;
+
+/* UTC clock on top of mico_get_time, corrected for frequency and slewed towards NTP */
+typedef struct
+{
+  bool      synchronized;
+  uint32_t  tick_last;        /* Extends mico_get_time to 64 bits */
+  uint32_t  tick_high;
+  uint64_t  base_tick;        /* ms */
+  int64_t   base_utc;         /* us since 1970 at base_tick */
+  int64_t   slew;             /* us still to be applied */
+  int32_t   drift_ppb;
+  int64_t   floor;            /* us, latest time handed out */
+  uint64_t  last_sync_tick;
+} ntp_clock_t;
 
 static volatile bool _wifiConnected = false;
 static mico_semaphore_t  _wifiConnected_sem = NULL;
 
-
-struct NtpPacket
-{
-	uint8_t flags;
-	uint8_t stratum;
-	uint8_t poll;
-	uint8_t precision;
-	uint32_t root_delay;
-	uint32_t root_dispersion;
-	uint8_t referenceID;
-	uint32_t ref_ts_sec;
-	uint32_t ref_ts_frac;
-	uint32_t origin_ts_sec;
-	uint32_t origin_ts_frac;
-	uint32_t recv_ts_sec;
-	uint32_t recv_ts_frac;
-	uint32_t trans_ts_sec;
-	uint32_t trans_ts_frac;
-};
+static const char *ntp_servers[] = { NTP_SERVER_POOL };
+static ntp_server_t _servers[NTP_MAX_SERVERS];
+static ntp_clock_t _clock;
+static mico_ntp_stats_t _stats;
 
 void ntpNotify_WifiStatusHandler(int event, mico_Context_t * const inContext)
 {
@@ -84,6 +108,7 @@ void ntpNotify_WifiStatusHandler(int event, mico_Context_t * const inContext)
       mico_rtos_set_semaphore(&_wifiConnected_sem);
     break;
   case NOTIFY_STATION_DOWN:
+    _wifiConnected = false;
     break;
   default:
     break;
@@ -91,6 +116,337 @@ void ntpNotify_WifiStatusHandler(int event, mico_Context_t * const inContext)
   return;
 }
 
+/* Disciplined clock, all of these run with the scheduler suspended */
+
+static uint64_t _clock_tick(void)
+{
+  uint32_t now = mico_get_time();
+
+  if (now < _clock.tick_last)
+    _clock.tick_high++;
+  _clock.tick_last = now;
+  return ((uint64_t)_clock.tick_high << 32) | now;
+}
+
+/* Moves the base to now, applying the frequency correction and part of the slew */
+static int64_t _clock_advance(void)
+{
+  uint64_t tick = _clock_tick();
+  int64_t elapsed = (int64_t)(tick - _clock.base_tick);
+  int64_t max_slew = elapsed * NTP_MAX_SLEW_PPM / 1000;
+  int64_t slew = _clock.slew;
+
+  if (slew > max_slew) slew = max_slew;
+  if (slew < -max_slew) slew = -max_slew;
+  _clock.slew -= slew;
+  _clock.base_utc += elapsed * 1000 + elapsed * _clock.drift_ppb / 1000000 + slew;
+  _clock.base_tick = tick;
+  return _clock.base_utc;
+}
+
+static int64_t _clock_now(void)
+{
+  int64_t now = _clock_advance();
+
+  if (now < _clock.floor)
+    return _clock.floor;
+  _clock.floor = now;
+  return now;
+}
+
+/* Returns true if the clock was stepped rather than slewed */
+static bool _clock_correct(int64_t offset)
+{
+  int64_t error, interval;
+  bool step = false;
+
+  _clock_advance();
+  if (_clock.synchronized == false || offset > (int64_t)NTP_STEP_THRESHOLD * 1000 || offset < -(int64_t)NTP_STEP_THRESHOLD * 1000) {
+    if (_clock.synchronized) _stats.step_count++;
+    _clock.base_utc += offset;
+    _clock.floor = _clock.base_utc;
+    _clock.slew = 0;
+    _clock.synchronized = true;
+    step = true;
+  } else {
+    /* What slewing has not fixed since the last synchronisation is frequency error */
+    interval = (int64_t)(_clock.base_tick - _clock.last_sync_tick);
+    if (interval >= NTP_MIN_DRIFT_INTERVAL) {
+      error = (offset - _clock.slew) * 1000000 / interval;
+      _clock.drift_ppb += (int32_t)error;
+      if (_clock.drift_ppb > NTP_MAX_DRIFT_PPB) _clock.drift_ppb = NTP_MAX_DRIFT_PPB;
+      if (_clock.drift_ppb < -NTP_MAX_DRIFT_PPB) _clock.drift_ppb = -NTP_MAX_DRIFT_PPB;
+    }
+    _clock.slew = offset;
+  }
+  _clock.last_sync_tick = _clock.base_tick;
+  return step;
+}
+
+static int64_t _local_time(void)
+{
+  int64_t now;
+
+  mico_rtos_suspend_all_thread();
+  now = _clock_advance();
+  mico_rtos_resume_all_thread();
+  return now;
+}
+
+/* NTP timestamps, 32.32 fixed point seconds since 1900 */
+
+static uint64_t _us_to_ntp(int64_t us)
+{
+  uint64_t sec = (uint64_t)(us / 1000000) + UNIX_OFFSET;
+  uint64_t frac = ((uint64_t)(us % 1000000) << 32) / 1000000;
+  return ((sec & 0xFFFFFFFF) << 32) | frac;
+}
+
+/* Difference of two timestamps in us, correct across the 2036 era rollover */
+static int64_t _ntp_diff(uint64_t a, uint64_t b)
+{
+  int64_t diff = (int64_t)(a - b);
+  int64_t sec = diff >> 32;
+  return sec * 1000000 + (int64_t)(((diff & 0xFFFFFFFF) * 1000000) >> 32);
+}
+
+/* SNTP exchange, RFC 4330 */
+
+static void _ntp_send_request(int fd, ntp_server_t *server)
+{
+  uint8_t packet[NTP_PACKET_SIZE];
+  struct sockaddr_t addr;
+
+  memset(packet, 0, sizeof(packet));
+  packet[NTP_OFFSET_FLAGS] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+
+  /* The server echoes the transmit timestamp as origin, the bits below 1 us are random so
+     replies to an older request or forged ones are recognised */
+  server->t1 = _local_time();
+  server->transmit = (_us_to_ntp(server->t1) & ~(uint64_t)0xFFF) | (RandomUInt32() & 0xFFF);
+  WriteBig64(packet + NTP_OFFSET_TRANSMIT, server->transmit);
+
+  addr.s_ip = server->ip;
+  addr.s_port = NTP_Port;
+  sendto(fd, packet, sizeof(packet), 0, &addr, sizeof(addr));
+  _stats.requests_sent++;
+}
+
+static void _ntp_receive_reply(int fd)
+{
+  uint8_t packet[NTP_PACKET_SIZE];
+  struct sockaddr_t addr;
+  socklen_t addrLen = sizeof(addr);
+  ntp_server_t *server = NULL;
+  uint64_t t2, t3;
+  int64_t t4, offset, delay;
+  uint8_t mode, version, leap;
+  int len, i;
+
+  len = recvfrom(fd, packet, sizeof(packet), 0, &addr, &addrLen);
+  t4 = _local_time();
+  if (len < NTP_PACKET_SIZE) return;
+
+  for (i = 0; i < NTP_MAX_SERVERS; i++) {
+    if (_servers[i].transmit && _servers[i].ip == addr.s_ip && addr.s_port == NTP_Port) {
+      server = &_servers[i];
+      break;
+    }
+  }
+  if (server == NULL || ReadBig64(packet + NTP_OFFSET_ORIGIN) != server->transmit) goto rejected;
+
+  leap = packet[NTP_OFFSET_FLAGS] >> 6;
+  version = (packet[NTP_OFFSET_FLAGS] >> 3) & 0x7;
+  mode = packet[NTP_OFFSET_FLAGS] & 0x7;
+  if ((mode != NTP_MODE_SERVER && mode != NTP_MODE_BROADCAST) || version < 3 || version > 4) goto rejected;
+  server->transmit = 0;
+
+  if (packet[NTP_OFFSET_STRATUM] == 0) {
+    /* Kiss-o'-death, stop asking this server */
+    ntp_log("Kiss-o'-death %.4s from %s", packet + 12, ntp_servers[i]);
+    server->kod = true;
+    server->kod_time = mico_get_time();
+    _stats.kiss_of_death++;
+    return;
+  }
+  t2 = ReadBig64(packet + NTP_OFFSET_RECEIVE);
+  t3 = ReadBig64(packet + NTP_OFFSET_TRANSMIT);
+  if (leap == NTP_LI_UNSYNCHRONIZED || packet[NTP_OFFSET_STRATUM] > 15 || t3 == 0) goto rejected;
+
+  /* offset = ((T2 - T1) + (T3 - T4)) / 2, delay = (T4 - T1) - (T3 - T2) */
+  delay = (t4 - server->t1) - _ntp_diff(t3, t2);
+  offset = (_ntp_diff(t2, _us_to_ntp(server->t1)) + _ntp_diff(t3, _us_to_ntp(t4))) / 2;
+  if (delay < 0) delay = 0;  /* Server and local clock resolution */
+  if (delay > (int64_t)NTP_MAX_DELAY * 1000) goto rejected;
+
+  _stats.replies_accepted++;
+  if (server->delay < 0 || delay < server->delay) {
+    server->delay = delay;
+    server->offset = offset;
+  }
+  return;
+
+rejected:
+  _stats.replies_rejected++;
+}
+
+static void _ntp_sort(int64_t *values, int count)
+{
+  int64_t value;
+  int i, j;
+
+  for (i = 1; i < count; i++) {
+    value = values[i];
+    for (j = i; j > 0 && values[j - 1] > value; j--)
+      values[j] = values[j - 1];
+    values[j] = value;
+  }
+}
+
+/* Drops servers far from the median and averages the rest, weighted by 1 / round trip */
+static OSStatus _ntp_combine(int64_t *outOffset, int64_t *outDelay, int *outUsed)
+{
+  int64_t offsets[NTP_MAX_SERVERS], deviations[NTP_MAX_SERVERS];
+  int64_t median, threshold, deviation, weight;
+  int64_t sum = 0, weights = 0, delay_sum = 0;
+  int count = 0, used = 0, i;
+
+  for (i = 0; i < NTP_MAX_SERVERS; i++) {
+    if (_servers[i].delay >= 0)
+      offsets[count++] = _servers[i].offset;
+  }
+  if (count == 0) return kTimeoutErr;
+
+  _ntp_sort(offsets, count);
+  median = (count & 1) ? offsets[count / 2] : (offsets[count / 2 - 1] + offsets[count / 2]) / 2;
+  for (i = 0; i < count; i++)
+    deviations[i] = (offsets[i] > median) ? offsets[i] - median : median - offsets[i];
+  _ntp_sort(deviations, count);
+  threshold = 3 * ((count & 1) ? deviations[count / 2] : (deviations[count / 2 - 1] + deviations[count / 2]) / 2);
+  if (threshold < (int64_t)NTP_OUTLIER_THRESHOLD * 1000) threshold = (int64_t)NTP_OUTLIER_THRESHOLD * 1000;
+
+  for (i = 0; i < NTP_MAX_SERVERS; i++) {
+    if (_servers[i].delay < 0) continue;
+    deviation = _servers[i].offset - median;
+    if (deviation > threshold || deviation < -threshold) {
+      ntp_log("Outlier %s, %d ms from the median", ntp_servers[i], (int)(deviation / 1000));
+      _stats.outliers_rejected++;
+      continue;
+    }
+    /* Deviations are small, the sum cannot overflow */
+    weight = 1000000000 / (_servers[i].delay + 1000);
+    sum += deviation * weight;
+    weights += weight;
+    delay_sum += _servers[i].delay;
+    used++;
+  }
+  if (used == 0) return kResponseErr;
+
+  *outOffset = median + sum / weights;
+  *outDelay = delay_sum / used;
+  *outUsed = used;
+  return kNoErr;
+}
+
+static void _ntp_set_rtc(void)
+{
+  mico_rtc_time_t time;
+  struct tm *currentTime;
+  uint64_t utc;
+  time_t current;
+
+  if (MICONTPGetTime(&utc) != kNoErr) return;
+  current = (time_t)(utc / 1000) + NTP_RTC_TIME_ZONE;
+  currentTime = localtime(&current);
+  ntp_log("Time Synchronoused, %s",asctime(currentTime));
+
+  time.sec = currentTime->tm_sec;
+  time.min = currentTime->tm_min ;
+  time.hr = currentTime->tm_hour;
+
+  time.date = currentTime->tm_mday;
+  time.weekday = currentTime->tm_wday;
+  time.month = currentTime->tm_mon + 1;
+  time.year = (currentTime->tm_year + 1900)%100;
+
+  MicoRtcSetTime( &time );
+}
+
+/* One synchronisation: a burst of requests to every server, then the combined offset is applied */
+static OSStatus _ntp_synchronize(int fd)
+{
+  OSStatus err;
+  fd_set readfds;
+  struct timeval_t t;
+  uint32_t ip, deadline, now;
+  int64_t offset, delay;
+  int used = 0, active = 0;
+  int i, j, sample;
+  bool step;
+
+  for (i = 0; i < NTP_MAX_SERVERS; i++) {
+    _servers[i].ip = 0;
+    _servers[i].transmit = 0;
+    _servers[i].delay = -1;
+    if (i >= (int)(sizeof(ntp_servers) / sizeof(ntp_servers[0]))) continue;
+    if (_servers[i].kod && mico_get_time() - _servers[i].kod_time < NTP_KOD_BACKOFF) continue;
+    _servers[i].kod = false;
+    if (DNSResolve(ntp_servers[i], &ip) != kNoErr) continue;
+    /* Pool names can resolve to the same server */
+    for (j = 0; j < i && _servers[j].ip != ip; j++);
+    if (j < i) continue;
+    _servers[i].ip = ip;
+    active++;
+  }
+  require_action(active, exit, err = kNotFoundErr);
+
+  for (sample = 0; sample < NTP_SAMPLES_PER_SERVER; sample++) {
+    for (i = 0; i < NTP_MAX_SERVERS; i++) {
+      if (_servers[i].ip && !_servers[i].kod)
+        _ntp_send_request(fd, &_servers[i]);
+    }
+
+    deadline = mico_get_time() + NTP_SAMPLE_INTERVAL;
+    while ((int32_t)(deadline - (now = mico_get_time())) > 0) {
+      t.tv_sec = (deadline - now) / 1000;
+      t.tv_usec = ((deadline - now) % 1000) * 1000;
+      FD_ZERO(&readfds);
+      FD_SET(fd, &readfds);
+      select(1, &readfds, NULL, NULL, &t);
+      if (FD_ISSET(fd, &readfds))
+        _ntp_receive_reply(fd);
+    }
+    for (i = 0; i < NTP_MAX_SERVERS; i++)
+      _servers[i].transmit = 0;
+  }
+
+  err = _ntp_combine(&offset, &delay, &used);
+  require_noerr(err, exit);
+
+  mico_rtos_suspend_all_thread();
+  step = _clock_correct(offset);
+  _stats.sync_count++;
+  _stats.servers_used = used;
+  _stats.last_offset = (offset > INT32_MAX) ? INT32_MAX : (offset < INT32_MIN) ? INT32_MIN : (int32_t)offset;
+  _stats.last_delay = (uint32_t)delay;
+  _stats.drift_ppb = _clock.drift_ppb;
+  _stats.last_sync = mico_get_time();
+  mico_rtos_resume_all_thread();
+
+  if (step)
+    ntp_log("Clock stepped by %d s, delay %d ms, %d servers", (int)(offset / 1000000), (int)(delay / 1000), used);
+  else
+    ntp_log("Offset %d ms, delay %d ms, %d servers, drift %d ppb", (int)(offset / 1000), (int)(delay / 1000), used, (int)_clock.drift_ppb);
+  _ntp_set_rtc();
+
+exit:
+  if (err != kNoErr) {
+    _stats.sync_failures++;
+    ntp_log("Synchronisation failed, err = %d", err);
+  }
+  return err;
+}
+
 void NTPClient_thread(void *inContext)
 {
   ntp_log_trace();
@@ -98,88 +454,34 @@ void NTPClient_thread(void *inContext)
   (void)inContext;
   
   int  Ntp_fd = -1;
-  fd_set readfds;
-  struct timeval_t t ;
   struct sockaddr_t addr;
-  socklen_t addrLen;	
-  char ipstr[16];
-  unsigned int trans_sec, current;
-  struct NtpPacket outpacket ,inpacket;
-  struct tm *currentTime;
-  mico_rtc_time_t time;
+  uint32_t wait;
   
   /* Regisist notifications */
   err = MICOAddNotification( mico_notify_WIFI_STATUS_CHANGED, (void *)ntpNotify_WifiStatusHandler );
   require_noerr( err, exit ); 
- 
-  memset(&outpacket,0x0,sizeof(outpacket));
-  memset(&inpacket,0x0,sizeof(inpacket));
-
-  outpacket.flags = NTP_Flags;
-  outpacket.stratum = NTP_Stratum;
-  outpacket.poll = NTP_Poll;
-  outpacket.precision = NTP_Precision;
-  outpacket.root_delay = NTP_Root_Delay;
-  outpacket.root_dispersion = NTP_Root_Dispersion;
-
-  if(_wifiConnected == false)
-    mico_rtos_get_semaphore(&_wifiConnected_sem, MICO_WAIT_FOREVER);
-  
+
   Ntp_fd = socket(AF_INET, SOCK_DGRM, IPPROTO_UDP);
   require_action(IsValidSocket( Ntp_fd ), exit, err = kNoResourcesErr );
+  /* A random source port makes forged replies harder to aim */
   addr.s_ip = INADDR_ANY; 
-  addr.s_port = 45000;
+  addr.s_port = 49152 + RandomUInt32() % 16384;
   err = bind(Ntp_fd, &addr, sizeof(addr));
-  err = kNoErr;
   require_noerr(err, exit);
 
-   while(1) {
-     err = gethostbyname(NTP_Server, (uint8_t *)ipstr, 16);
-     require_noerr(err, ReConnWithDelay);
-     ntp_log("NTP server address: %s",ipstr);
-     break;
-
-   ReConnWithDelay:
-     mico_thread_sleep(5);
-   }
+  while(1) {
+    while(_wifiConnected == false)
+      mico_rtos_get_semaphore(&_wifiConnected_sem, MICO_WAIT_FOREVER);
 
-  addr.s_ip = inet_addr(ipstr);
-  addr.s_port = NTP_Port;
+    if (_ntp_synchronize(Ntp_fd) == kNoErr)
+      wait = NTP_SYNC_INTERVAL;
+    else
+      wait = NTP_RETRY_INTERVAL;
 
-  t.tv_sec = 5;
-  t.tv_usec = 0;
-  
-  while(1) {
-    require_action(sendto(Ntp_fd, &outpacket,sizeof(outpacket), 0, &addr, sizeof(addr)), exit, err = kNotWritableErr);
-
-    FD_ZERO(&readfds);
-    FD_SET(Ntp_fd, &readfds);
-
-    select(1, &readfds, NULL, NULL, &t);
-    
-    if(FD_ISSET(Ntp_fd, &readfds))
-    {
-      require_action(recvfrom(Ntp_fd, &inpacket, sizeof(struct NtpPacket), 0, &addr, &addrLen)>=0, exit, err = kNotReadableErr);
-
-      trans_sec = inpacket.trans_ts_sec;
-      trans_sec = ntohl(trans_sec);
-      current = trans_sec - UNIX_OFFSET;
-      ntp_log("Time Synchronoused, %s",asctime(localtime(&current)));
-
-      currentTime = localtime(&current);
-      time.sec = currentTime->tm_sec;
-      time.min = currentTime->tm_min ;
-      time.hr = currentTime->tm_hour;
-
-      time.date = currentTime->tm_mday;
-      time.weekday = currentTime->tm_wday;
-      time.month = currentTime->tm_mon + 1;
-      time.year = (currentTime->tm_year + 1900)%100;
-
-      MicoRtcSetTime( &time );
-      goto exit;
-    }
+    /* MICONTPRequestSync and a new connection end the wait early */
+    mico_rtos_get_semaphore(&_wifiConnected_sem, wait * 1000);
   }
+
 exit:
     if( err!=kNoErr )ntp_log("Exit: NTP client exit with err = %d", err);
     MICORemoveNotification( mico_notify_WIFI_STATUS_CHANGED, (void *)ntpNotify_WifiStatusHandler );
@@ -189,9 +491,41 @@ exit:
     return;
 }
 
+OSStatus MICONTPGetTime( uint64_t *outUTCTime )
+{
+  OSStatus err = kNotPreparedErr;
+  int64_t now;
+
+  mico_rtos_suspend_all_thread();
+  if (_clock.synchronized) {
+    now = _clock_now();
+    *outUTCTime = (uint64_t)(now / 1000);
+    err = kNoErr;
+  }
+  mico_rtos_resume_all_thread();
+  return err;
+}
+
+bool MICONTPIsSynchronized( void )
+{
+  return _clock.synchronized;
+}
+
+void MICONTPRequestSync( void )
+{
+  if(_wifiConnected_sem)
+    mico_rtos_set_semaphore(&_wifiConnected_sem);
+}
+
+void MICONTPGetStats( mico_ntp_stats_t *outStats )
+{
+  mico_rtos_suspend_all_thread();
+  memcpy(outStats, &_stats, sizeof(mico_ntp_stats_t));
+  mico_rtos_resume_all_thread();
+}
+
 OSStatus MICOStartNTPClient ( mico_Context_t * const inContext )
 {
   mico_rtos_init_semaphore(&_wifiConnected_sem, 1);
   return mico_rtos_create_thread(NULL, MICO_APPLICATION_PRIORITY, "NTP Client", NTPClient_thread, STACK_SIZE_NTP_CLIENT_THREAD, (void*)inContext );
 }
-
@@ -0,0 +1,116 @@
+/**
+******************************************************************************
+* @file    MICONTPClient.h 
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   SNTP client that disciplines a UTC clock built on mico_get_time
+*          and keeps the RTC in step.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MICONTPCLIENT_H__
+#define __MICONTPCLIENT_H__
+
+#include "Common.h"
+#include "MICODefine.h"
+
+/* Servers are queried in parallel, each one answers NTP_SAMPLES_PER_SERVER requests per
+   synchronisation and the sample with the shortest round trip is kept (RFC 4330). Servers that
+   disagree with the median of the others are dropped before the offsets are averaged. */
+#if !defined NTP_SERVER_POOL
+#define NTP_SERVER_POOL               "time.asia.apple.com", "cn.pool.ntp.org", "time.windows.com", "pool.ntp.org"
+#endif
+
+#if !defined NTP_MAX_SERVERS
+#define NTP_MAX_SERVERS               4
+#endif
+
+#if !defined NTP_SAMPLES_PER_SERVER
+#define NTP_SAMPLES_PER_SERVER        4
+#endif
+
+/* ms between samples of one server, and how long to wait for the answers */
+#if !defined NTP_SAMPLE_INTERVAL
+#define NTP_SAMPLE_INTERVAL           2000
+#endif
+
+/* Samples with a longer round trip are ignored, ms */
+#if !defined NTP_MAX_DELAY
+#define NTP_MAX_DELAY                 1000
+#endif
+
+/* Smallest distance from the median at which a server counts as an outlier, ms */
+#if !defined NTP_OUTLIER_THRESHOLD
+#define NTP_OUTLIER_THRESHOLD         100
+#endif
+
+/* Seconds between synchronisations, and after one that failed (RFC 4330 asks for 15 s at least) */
+#if !defined NTP_SYNC_INTERVAL
+#define NTP_SYNC_INTERVAL             ( 60 * 60 )
+#endif
+
+#if !defined NTP_RETRY_INTERVAL
+#define NTP_RETRY_INTERVAL            60
+#endif
+
+/* Larger offsets are stepped, smaller ones are slewed at up to 500 ppm so the clock never runs backwards, ms */
+#if !defined NTP_STEP_THRESHOLD
+#define NTP_STEP_THRESHOLD            1000
+#endif
+
+/* The RTC keeps local time, seconds east of UTC */
+#if !defined NTP_RTC_TIME_ZONE
+#define NTP_RTC_TIME_ZONE             ( 8 * 60 * 60 )
+#endif
+
+typedef struct
+{
+  uint32_t sync_count;
+  uint32_t sync_failures;
+  uint32_t step_count;            /* Corrections too large to slew */
+  uint32_t requests_sent;
+  uint32_t replies_accepted;
+  uint32_t replies_rejected;      /* Wrong source, origin, mode, version or leap indicator */
+  uint32_t kiss_of_death;
+  uint32_t outliers_rejected;
+  uint32_t servers_used;          /* In the last synchronisation */
+  int32_t  last_offset;           /* us, clamped to the int32_t range */
+  uint32_t last_delay;            /* us, round trip of the samples used */
+  int32_t  drift_ppb;             /* Frequency correction applied to mico_get_time */
+  uint32_t last_sync;             /* mico_get_time of the last synchronisation */
+} mico_ntp_stats_t;
+
+/* Milliseconds since 1970-01-01 UTC, kNotPreparedErr until the first synchronisation.
+   Successive calls never go backwards unless a correction beyond NTP_STEP_THRESHOLD is stepped */
+OSStatus MICONTPGetTime( uint64_t *outUTCTime );
+
+bool MICONTPIsSynchronized( void );
+
+/* Wakes the client for a synchronisation now instead of at the next interval */
+void MICONTPRequestSync( void );
+
+void MICONTPGetStats( mico_ntp_stats_t *outStats );
+
+#endif //__MICONTPCLIENT_H__
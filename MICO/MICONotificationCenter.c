@@ -30,20 +30,59 @@
 ******************************************************************************
 */
 
-
 #include "MICONotificationCenter.h"
 #include "Common.h"
 #include "Mico.h"
+#include "MICOWorkQueue.h"
+
+#define MICO_NOTIFY_TYPE_MAX      20
+#define _NOTIFY_DEFAULT_CONTEXT   (1<<7)    /* Added by MICOAddNotification, gets _Context */
+#define _NOTIFY_KEY_COPY_LEN      64        /* Handlers compare the whole key buffer, not only key_len bytes */
+
+/* Exported by the FreeRTOS based RTOS library */
+extern void *xTaskGetCurrentTaskHandle( void );
 
 typedef struct _Notify_list{
   void  *function;
   struct _Notify_list *next;
   void  *contex;
+  uint8_t priority;
+  uint8_t flags;
+  uint8_t refs;       /* Dispatches still holding this entry */
+  bool    removed;    /* Unlinked, freed by the last dispatch holding it */
 } _Notify_list_t;
 
+/* A handler call in progress, on the stack of the dispatching thread */
+typedef struct _notify_call {
+  _Notify_list_t *notify;
+  void  *thread;
+  struct _notify_call *next;
+} _notify_call_t;
+
+/* Arguments of one notification. Synchronous delivery points at the caller's data, asynchronous
+   delivery at a copy allocated together with the event. */
+typedef struct _notify_event {
+  mico_notify_types_t type;
+  struct _notify_event *next;
+  uint32_t  time;
+  int       value;
+  void      *data;
+  void      *data2;
+} _notify_event_t;
+
 static void * _Context;
 
-_Notify_list_t* Notify_list[20] = {NULL};
+_Notify_list_t* Notify_list[MICO_NOTIFY_TYPE_MAX] = {NULL};
+static uint8_t _async_handlers[MICO_NOTIFY_TYPE_MAX];
+
+/* Copies waiting for the work queue, FIFO */
+static _notify_event_t *_async_head = NULL;
+static _notify_event_t *_async_tail = NULL;
+static _notify_call_t *_calls = NULL;
+static uint32_t _queue_depth = 0;
+static mico_work_t _notify_work;
+static uint32_t _async_latency_total = 0;
+static mico_notify_stats_t _stats;
 
 /* MICO system defined notifications */
 typedef void (*mico_notify_WIFI_SCAN_COMPLETE_function)           ( ScanResult *pApList, void * inContext );
@@ -63,186 +102,345 @@ typedef void (*mico_notify_STACK_OVERFLOW_ERROR_function)         ( char *taskna
 
 /* User defined notifications */
 
-void ApListCallback(ScanResult *pApList)
+static void _notify_call(_Notify_list_t *notify, const _notify_event_t *event)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_SCAN_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_SCAN_COMPLETE_function)(temp->function))(pApList, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
+  void *context = (notify->flags & _NOTIFY_DEFAULT_CONTEXT)? _Context : notify->contex;
+
+  switch(event->type){
+  case mico_notify_WIFI_SCAN_COMPLETED:
+    ((mico_notify_WIFI_SCAN_COMPLETE_function)(notify->function))((ScanResult *)event->data, context);
+    break;
+  case mico_notify_WIFI_SCAN_ADV_COMPLETED:
+    ((mico_notify_WIFI_SCAN_ADV_COMPLETE_function)(notify->function))((ScanResult_adv *)event->data, context);
+    break;
+  case mico_notify_WIFI_STATUS_CHANGED:
+    ((mico_notify_WIFI_STATUS_CHANGED_function)(notify->function))((WiFiEvent)event->value, context);
+    break;
+  case mico_notify_WiFI_PARA_CHANGED:
+    ((mico_notify_WiFI_PARA_CHANGED_function)(notify->function))((apinfo_adv_t *)event->data, (char *)event->data2, event->value, context);
+    break;
+  case mico_notify_DHCP_COMPLETED:
+    ((mico_notify_DHCP_COMPLETE_function)(notify->function))((IPStatusTypedef *)event->data, context);
+    break;
+  case mico_notify_EASYLINK_WPS_COMPLETED:
+    ((mico_notify_EASYLINK_COMPLETE_function)(notify->function))((network_InitTypeDef_st *)event->data, context);
+    break;
+  case mico_notify_EASYLINK_GET_EXTRA_DATA:
+    ((mico_notify_EASYLINK_GET_EXTRA_DATA_function)(notify->function))(event->value, (char *)event->data, context);
+    break;
+  case mico_notify_TCP_CLIENT_CONNECTED:
+    ((mico_notify_TCP_CLIENT_CONNECTED_function)(notify->function))(event->value, context);
+    break;
+  case mico_notify_DNS_RESOLVE_COMPLETED:
+    ((mico_notify_DNS_RESOLVE_COMPLETED_function)(notify->function))((uint8_t *)event->data, (uint32_t)event->value, context);
+    break;
+  case mico_notify_READ_APP_INFO:
+    ((mico_notify_READ_APP_INFO_function)(notify->function))((char *)event->data, event->value, context);
+    break;
+  case mico_notify_SYS_WILL_POWER_OFF:
+    ((mico_notify_SYS_WILL_POWER_OFF_function)(notify->function))(context);
+    break;
+  case mico_notify_WIFI_CONNECT_FAILED:
+    ((mico_notify_WIFI_CONNECT_FAILED_function)(notify->function))((OSStatus)event->value, context);
+    break;
+  case mico_notify_WIFI_Fatal_ERROR:
+    ((mico_notify_WIFI_FATAL_ERROR_function)(notify->function))(context);
+    break;
+  case mico_notify_Stack_Overflow_ERROR:
+    ((mico_notify_STACK_OVERFLOW_ERROR_function)(notify->function))((char *)event->data, context);
+    break;
+  default:
+    break;
   }
 }
 
-void ApListAdvCallback(ScanResult_adv *pApAdvList)
+/* The handler list is only walked with the scheduler suspended, long enough to take a reference on
+   every entry. Handlers are called without any lock held, so they may add or remove notifications,
+   and an entry removed meanwhile is skipped and freed here once the last reference is dropped.
+   Each call is registered in _calls in the same suspended section that checks the entry is still
+   there, so a remove either prevents the call or sees it and waits for it to return. */
+static void _notify_dispatch(const _notify_event_t *event, bool async)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_SCAN_ADV_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_SCAN_ADV_COMPLETE_function)(temp->function))(pApAdvList, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
+  _Notify_list_t *handlers[MICO_NOTIFY_MAX_HANDLERS];
+  _Notify_list_t *temp;
+  _notify_call_t call, **link;
+  void *slowest = NULL;
+  uint32_t start, elapsed, slowest_time = 0;
+  int count = 0, i;
+
+  mico_rtos_suspend_all_thread();
+  for(temp = Notify_list[event->type]; temp != NULL && count < MICO_NOTIFY_MAX_HANDLERS; temp = temp->next){
+    if(((temp->flags & MICO_NOTIFY_ASYNC) != 0) != async)
+      continue;
+    temp->refs++;
+    handlers[count++] = temp;
+  }
+  mico_rtos_resume_all_thread();
+
+  call.thread = xTaskGetCurrentTaskHandle();
+  for(i = 0; i < count; i++){
+    mico_rtos_suspend_all_thread();
+    if(handlers[i]->removed){
+      mico_rtos_resume_all_thread();
+      continue;
+    }
+    call.notify = handlers[i];
+    call.next = _calls;
+    _calls = &call;
+    mico_rtos_resume_all_thread();
+
+    start = mico_get_time();
+    _notify_call(handlers[i], event);
+    elapsed = mico_get_time() - start;
+
+    mico_rtos_suspend_all_thread();
+    for(link = &_calls; *link != &call; link = &(*link)->next);
+    *link = call.next;
+    mico_rtos_resume_all_thread();
+
+    if(elapsed >= slowest_time){
+      slowest_time = elapsed;
+      slowest = handlers[i]->function;
+    }
+  }
+
+  mico_rtos_suspend_all_thread();
+  for(i = 0; i < count; i++){
+    if(--handlers[i]->refs != 0 || handlers[i]->removed == false)
+      handlers[i] = NULL;
+  }
+  if(async == false && slowest && slowest_time >= _stats.handler_time_max){
+    _stats.handler_time_max = slowest_time;
+    _stats.slowest_handler = slowest;
+  }
+  mico_rtos_resume_all_thread();
+
+  for(i = 0; i < count; i++){
+    if(handlers[i])
+      free(handlers[i]);
   }
 }
 
-void WifiStatusHandler(WiFiEvent status)
+/* One allocation holds the event and a copy of everything its arguments point to */
+static _notify_event_t *_notify_event_copy(const _notify_event_t *event)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_STATUS_CHANGED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_STATUS_CHANGED_function)(temp->function))(status, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
+  _notify_event_t *copy;
+  size_t len = 0, len2 = 0, item;
+  uint8_t *p;
+
+  switch(event->type){
+  case mico_notify_WIFI_SCAN_COMPLETED:
+    item = sizeof(*((ScanResult *)event->data)->ApList);
+    len = sizeof(ScanResult) + (uint8_t)((ScanResult *)event->data)->ApNum * item;
+    break;
+  case mico_notify_WIFI_SCAN_ADV_COMPLETED:
+    item = sizeof(*((ScanResult_adv *)event->data)->ApList);
+    len = sizeof(ScanResult_adv) + (uint8_t)((ScanResult_adv *)event->data)->ApNum * item;
+    break;
+  case mico_notify_WiFI_PARA_CHANGED:
+    len = sizeof(apinfo_adv_t);
+    len2 = Max(event->value, _NOTIFY_KEY_COPY_LEN) + 1;
+    break;
+  case mico_notify_DHCP_COMPLETED:
+    len = sizeof(IPStatusTypedef);
+    break;
+  case mico_notify_EASYLINK_WPS_COMPLETED:
+    len = sizeof(network_InitTypeDef_st);
+    break;
+  case mico_notify_EASYLINK_GET_EXTRA_DATA:
+    len = event->value + 1;
+    break;
+  case mico_notify_DNS_RESOLVE_COMPLETED:
+  case mico_notify_Stack_Overflow_ERROR:
+    len = strlen((char *)event->data) + 1;
+    break;
+  default:
+    break;
+  }
+
+  copy = (_notify_event_t *)malloc(sizeof(_notify_event_t) + len + len2);
+  if(copy == NULL)
+    return NULL;
+  memcpy(copy, event, sizeof(_notify_event_t));
+  p = (uint8_t *)(copy + 1);
+  memset(p, 0x0, len + len2);
+
+  switch(event->type){
+  case mico_notify_WIFI_SCAN_COMPLETED:
+    memcpy(p, event->data, sizeof(ScanResult));
+    memcpy(p + sizeof(ScanResult), ((ScanResult *)event->data)->ApList, len - sizeof(ScanResult));
+    ((ScanResult *)p)->ApList = (void *)(p + sizeof(ScanResult));
+    break;
+  case mico_notify_WIFI_SCAN_ADV_COMPLETED:
+    memcpy(p, event->data, sizeof(ScanResult_adv));
+    memcpy(p + sizeof(ScanResult_adv), ((ScanResult_adv *)event->data)->ApList, len - sizeof(ScanResult_adv));
+    ((ScanResult_adv *)p)->ApList = (void *)(p + sizeof(ScanResult_adv));
+    break;
+  case mico_notify_WiFI_PARA_CHANGED:
+    memcpy(p, event->data, len);
+    memcpy(p + len, event->data2, event->value);
+    copy->data2 = p + len;
+    break;
+  case mico_notify_EASYLINK_GET_EXTRA_DATA:
+    memcpy(p, event->data, event->value);
+    break;
+  default:
+    if(len)
+      memcpy(p, event->data, len);
+    break;
   }
+  if(len)
+    copy->data = p;
+  return copy;
 }
 
-void connected_ap_info(apinfo_adv_t *ap_info, char *key, int key_len)
+static void _notify_raise(mico_notify_types_t type, int value, void *data, void *data2)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WiFI_PARA_CHANGED];
-  if(temp == NULL)
+  _notify_event_t event, *copy;
+  OSStatus err = kNoErr;
+
+  event.type = type;
+  event.time = mico_get_time();
+  event.value = value;
+  event.data = data;
+  event.data2 = data2;
+
+  mico_rtos_suspend_all_thread();
+  _stats.dispatch_count++;
+  mico_rtos_resume_all_thread();
+
+  _notify_dispatch(&event, false);
+
+  if(_async_handlers[type] == 0)
     return;
-  else{
-    do{
-      ((mico_notify_WiFI_PARA_CHANGED_function)(temp->function))(ap_info, key, key_len, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
+
+  copy = _notify_event_copy(&event);
+  require_action(copy, exit, err = kNoMemoryErr);
+  copy->next = NULL;
+
+  /* Never block the thread that raised the notification */
+  mico_rtos_suspend_all_thread();
+  if(_queue_depth < MICO_NOTIFY_QUEUE_LENGTH){
+    if(_async_tail)
+      _async_tail->next = copy;
+    else
+      _async_head = copy;
+    _async_tail = copy;
+    _stats.async_queued++;
+    if(++_queue_depth > _stats.queue_high_water)
+      _stats.queue_high_water = _queue_depth;
+  }else{
+    err = kNoResourcesErr;
+  }
+  mico_rtos_resume_all_thread();
+  require_noerr_action(err, exit, free(copy));
+
+  MICOQueueWork(&_notify_work);
+
+exit:
+  if(err != kNoErr){
+    mico_rtos_suspend_all_thread();
+    _stats.async_dropped++;
+    mico_rtos_resume_all_thread();
   }
 }
 
-void NetCallback(IPStatusTypedef *pnet)
+/* Runs on the MICO work queue, delivers everything queued so far */
+static void _notify_async_work(void *arg)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_DHCP_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_DHCP_COMPLETE_function)(temp->function))(pnet, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
+  _notify_event_t *event;
+  uint32_t latency;
+  (void)arg;
+
+  while(1){
+    mico_rtos_suspend_all_thread();
+    event = _async_head;
+    if(event == NULL){
+      mico_rtos_resume_all_thread();
+      break;
+    }
+    _async_head = event->next;
+    if(_async_head == NULL)
+      _async_tail = NULL;
+    _queue_depth--;
+    latency = mico_get_time() - event->time;
+    _async_latency_total += latency;
+    if(latency > _stats.async_latency_max)
+      _stats.async_latency_max = latency;
+    mico_rtos_resume_all_thread();
+
+    _notify_dispatch(event, true);
+    free(event);
   }
 }
 
+void ApListCallback(ScanResult *pApList)
+{
+  _notify_raise(mico_notify_WIFI_SCAN_COMPLETED, 0, pApList, NULL);
+}
+
+void ApListAdvCallback(ScanResult_adv *pApAdvList)
+{
+  _notify_raise(mico_notify_WIFI_SCAN_ADV_COMPLETED, 0, pApAdvList, NULL);
+}
+
+void WifiStatusHandler(WiFiEvent status)
+{
+  _notify_raise(mico_notify_WIFI_STATUS_CHANGED, status, NULL, NULL);
+}
+
+void connected_ap_info(apinfo_adv_t *ap_info, char *key, int key_len)
+{
+  _notify_raise(mico_notify_WiFI_PARA_CHANGED, key_len, ap_info, key);
+}
+
+void NetCallback(IPStatusTypedef *pnet)
+{
+  _notify_raise(mico_notify_DHCP_COMPLETED, 0, pnet, NULL);
+}
+
 void RptConfigmodeRslt(network_InitTypeDef_st *nwkpara)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_EASYLINK_WPS_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_EASYLINK_COMPLETE_function)(temp->function))(nwkpara, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  _notify_raise(mico_notify_EASYLINK_WPS_COMPLETED, 0, nwkpara, NULL);
 }
 
 void easylink_user_data_result(int datalen, char*data)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_EASYLINK_GET_EXTRA_DATA];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_EASYLINK_GET_EXTRA_DATA_function)(temp->function))(datalen, data, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }  
+  _notify_raise(mico_notify_EASYLINK_GET_EXTRA_DATA, datalen, data, NULL);
 }
 
 void socket_connected(int fd)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_TCP_CLIENT_CONNECTED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_TCP_CLIENT_CONNECTED_function)(temp->function))(fd, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  _notify_raise(mico_notify_TCP_CLIENT_CONNECTED, fd, NULL, NULL);
 }
 
 void dns_ip_set(uint8_t *hostname, uint32_t ip)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_DNS_RESOLVE_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_DNS_RESOLVE_COMPLETED_function)(temp->function))(hostname, ip, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  _notify_raise(mico_notify_DNS_RESOLVE_COMPLETED, (int)ip, hostname, NULL);
 }
 
-
 void system_version(char *str, int len){
-  _Notify_list_t *temp =  Notify_list[mico_notify_READ_APP_INFO];
-  if(Notify_list[mico_notify_READ_APP_INFO] == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_READ_APP_INFO_function)(temp->function))(str, len, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  _notify_raise(mico_notify_READ_APP_INFO, len, str, NULL);
 }
 
 void sendNotifySYSWillPowerOff(void)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_SYS_WILL_POWER_OFF];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_SYS_WILL_POWER_OFF_function)(temp->function))(_Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  _notify_raise(mico_notify_SYS_WILL_POWER_OFF, 0, NULL, NULL);
 }
 
 void join_fail(OSStatus err)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_CONNECT_FAILED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_CONNECT_FAILED_function)(temp->function))(err, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  _notify_raise(mico_notify_WIFI_CONNECT_FAILED, err, NULL, NULL);
 }
 
 void wifi_reboot_event(void)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_Fatal_ERROR];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_FATAL_ERROR_function)(temp->function))(_Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  _notify_raise(mico_notify_WIFI_Fatal_ERROR, 0, NULL, NULL);
 }
 
 void mico_rtos_stack_overflow(char *taskname)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_Stack_Overflow_ERROR];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_STACK_OVERFLOW_ERROR_function)(temp->function))(taskname, _Context);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  _notify_raise(mico_notify_Stack_Overflow_ERROR, 0, taskname, NULL);
 }
 
 
@@ -251,92 +449,133 @@ OSStatus MICOInitNotificationCenter  ( void * const inContext )
   OSStatus err = kNoErr;
   require_action(inContext, exit, err = kParamErr);
   _Context = inContext;
+  MICOInitWork(&_notify_work, _notify_async_work, NULL);
 exit:
   return err;
 }
 
 OSStatus MICOAddNotification( mico_notify_types_t notify_type, void *functionAddress )
+{
+  return MICOAddNotificationEx(notify_type, functionAddress, NULL, MICO_NOTIFY_PRIORITY_NORMAL, _NOTIFY_DEFAULT_CONTEXT);
+}
+
+OSStatus MICOAddNotificationEx( mico_notify_types_t notify_type, void *functionAddress, void *context,
+                                mico_notify_priority_t priority, uint32_t flags )
 {
   OSStatus err = kNoErr;
-  _Notify_list_t *temp =  Notify_list[notify_type];
-  _Notify_list_t *notify = (_Notify_list_t *)malloc(sizeof(_Notify_list_t));
+  _Notify_list_t **link;
+  _Notify_list_t *temp;
+  _Notify_list_t *notify = NULL;
+  int count = 0;
+
+  require_action(notify_type < MICO_NOTIFY_TYPE_MAX && functionAddress, exit, err = kParamErr);
+  if(flags & MICO_NOTIFY_ASYNC){
+    /* These need their handlers to finish before the caller goes on */
+    require_action(notify_type != mico_notify_READ_APP_INFO && notify_type != mico_notify_SYS_WILL_POWER_OFF, exit, err = kUnsupportedErr);
+  }
+
+  notify = (_Notify_list_t *)malloc(sizeof(_Notify_list_t));
   require_action(notify, exit, err = kNoMemoryErr);
+  memset(notify, 0x0, sizeof(_Notify_list_t));
   notify->function = functionAddress;
-  notify->next = NULL;
-  if(Notify_list[notify_type] == NULL){
-    Notify_list[notify_type] = notify;
-    notify->next = NULL;
-  }else{
-    if(temp->function == functionAddress)
-        return kNoErr;   //Nodify already exist
-    while(temp->next!=NULL){
-      temp = temp->next;
-      if(temp->function == functionAddress)
-        return kNoErr;   //Nodify already exist
-    }
-    temp->next = notify;
+  notify->contex = context;
+  notify->priority = (uint8_t)priority;
+  notify->flags = (uint8_t)flags;
+
+  mico_rtos_suspend_all_thread();
+  for(temp = Notify_list[notify_type]; temp != NULL; temp = temp->next){
+    if(temp->function == functionAddress && temp->contex == context && (temp->flags & _NOTIFY_DEFAULT_CONTEXT) == (flags & _NOTIFY_DEFAULT_CONTEXT))
+      break;   //Nodify already exist
+    count++;
+  }
+  if(temp != NULL || count >= MICO_NOTIFY_MAX_HANDLERS){
+    mico_rtos_resume_all_thread();
+    free(notify);
+    if(temp == NULL)
+      err = kNoResourcesErr;
+    goto exit;
   }
-exit:
-  return err;
-}
 
-OSStatus MICORemoveNotification( mico_notify_types_t notify_type, void *functionAddress )
-{
-  OSStatus err = kNoErr;
-  _Notify_list_t *temp2;
-  _Notify_list_t *temp = Notify_list[notify_type];
-  require_action(Notify_list[notify_type], exit, err = kDeletedErr);
-  do{
-    if(temp->function == functionAddress){
-      if(temp == Notify_list[notify_type]){  //first element
-        Notify_list[notify_type] = Notify_list[notify_type]->next;
-        free(temp);
-      }else{
-        temp2->next = temp->next;
-        free(temp);
-      }
-       break;
-    }
-    require_action(temp->next!=NULL, exit, err = kNotFoundErr);
-    temp2 = temp;
-    temp = temp->next;
-  }while(temp != NULL);
+  /* After every handler of the same or a higher priority */
+  for(link = &Notify_list[notify_type]; *link != NULL && (*link)->priority <= notify->priority; link = &(*link)->next);
+  notify->next = *link;
+  *link = notify;
+  if(flags & MICO_NOTIFY_ASYNC)
+    _async_handlers[notify_type]++;
+  mico_rtos_resume_all_thread();
 
 exit:
   return err;
 }
 
+/* True while another thread is still running a handler that has been removed */
+static bool _notify_removed_running(void *functionAddress, void *thread)
+{
+  _notify_call_t *call;
+  bool running = false;
+
+  mico_rtos_suspend_all_thread();
+  for(call = _calls; call != NULL && running == false; call = call->next)
+    running = call->notify->removed && call->notify->function == functionAddress && call->thread != thread;
+  mico_rtos_resume_all_thread();
+  return running;
+}
 
+static OSStatus _notify_remove(mico_notify_types_t notify_type, void *functionAddress, void *context, bool anyContext)
+{
+  OSStatus err = kNotFoundErr;
+  _Notify_list_t *freeList[MICO_NOTIFY_MAX_HANDLERS];
+  _Notify_list_t **link;
+  _Notify_list_t *temp;
+  int count = 0, i;
+
+  if(notify_type >= MICO_NOTIFY_TYPE_MAX)
+    return kParamErr;
+  if(Notify_list[notify_type] == NULL)
+    return kDeletedErr;
+
+  mico_rtos_suspend_all_thread();
+  link = &Notify_list[notify_type];
+  while((temp = *link) != NULL){
+    if(temp->function != functionAddress || (anyContext == false && (temp->contex != context || (temp->flags & _NOTIFY_DEFAULT_CONTEXT)))){
+      link = &temp->next;
+      continue;
+    }
+    *link = temp->next;
+    temp->removed = true;
+    if(temp->flags & MICO_NOTIFY_ASYNC)
+      _async_handlers[notify_type]--;
+    /* A dispatch that still holds the entry frees it */
+    if(temp->refs == 0)
+      freeList[count++] = temp;
+    err = kNoErr;
+  }
+  mico_rtos_resume_all_thread();
 
+  for(i = 0; i < count; i++)
+    free(freeList[i]);
 
-// void WatchDog(void)
-// {
-  
-// }
-
-
-// void RptConfigmodeRslt(network_InitTypeDef_st *nwkpara)
-// {
-
-// }
-
-
-// void NetCallback(net_para_st *pnet)
-// {
-
-// }
-
-
-
-
-
-// void dns_ip_set(u8 *hostname, u32 ip)
-// {
-
-// }
+  /* A handler removing itself only returns to its own dispatch, which is not waited for */
+  while(err == kNoErr && _notify_removed_running(functionAddress, xTaskGetCurrentTaskHandle()))
+    mico_thread_msleep(1);
+  return err;
+}
 
+OSStatus MICORemoveNotification( mico_notify_types_t notify_type, void *functionAddress )
+{
+  return _notify_remove(notify_type, functionAddress, NULL, true);
+}
 
-// void socket_connected(int fd)
-// {
+OSStatus MICORemoveNotificationEx( mico_notify_types_t notify_type, void *functionAddress, void *context )
+{
+  return _notify_remove(notify_type, functionAddress, context, false);
+}
 
-// }
\ No newline at end of file
+void MICONotificationGetStats( mico_notify_stats_t *outStats )
+{
+  mico_rtos_suspend_all_thread();
+  memcpy(outStats, &_stats, sizeof(mico_notify_stats_t));
+  outStats->async_latency_avg = (_stats.async_queued > _queue_depth)? _async_latency_total/(_stats.async_queued - _queue_depth) : 0;
+  outStats->queue_depth = _queue_depth;
+  mico_rtos_resume_all_thread();
+}
@@ -66,12 +66,56 @@ typedef enum{
 
 } mico_notify_types_t;
 
+/* Handlers of one notification are called in priority order, then in the order they were added */
+typedef enum {
+  MICO_NOTIFY_PRIORITY_HIGH = 0,
+  MICO_NOTIFY_PRIORITY_NORMAL,
+  MICO_NOTIFY_PRIORITY_LOW,
+} mico_notify_priority_t;
+
+/* Flags for MICOAddNotificationEx */
+#define MICO_NOTIFY_ASYNC               (1<<0)  /* Called from the MICO work queue with a copy of the arguments,
+                                                   so a slow handler does not stall the Wi-Fi driver.
+                                                   Not allowed for mico_notify_READ_APP_INFO and
+                                                   mico_notify_SYS_WILL_POWER_OFF. */
+
+#ifndef MICO_NOTIFY_MAX_HANDLERS
+#define MICO_NOTIFY_MAX_HANDLERS        8       /* Per notification type */
+#endif
+
+#ifndef MICO_NOTIFY_QUEUE_LENGTH
+#define MICO_NOTIFY_QUEUE_LENGTH        8       /* Notifications waiting for the work queue, more are dropped */
+#endif
+
+typedef struct {
+  uint32_t  dispatch_count;         /* Notifications raised */
+  uint32_t  async_queued;
+  uint32_t  async_dropped;          /* Queue full or out of memory */
+  uint32_t  queue_depth;            /* Notifications waiting for asynchronous delivery right now */
+  uint32_t  queue_high_water;
+  uint32_t  async_latency_avg;      /* ms from raising a notification to its asynchronous delivery */
+  uint32_t  async_latency_max;
+  uint32_t  handler_time_max;       /* ms, slowest handler call in the thread that raised the notification */
+  void      *slowest_handler;
+} mico_notify_stats_t;
+
 OSStatus MICOInitNotificationCenter   ( void * const inContext );
 
+/* Handlers added by MICOAddNotification get the context passed to MICOInitNotificationCenter,
+   have normal priority and are called synchronously */
 OSStatus MICOAddNotification          ( mico_notify_types_t notify_type, void *functionAddress );
 
+OSStatus MICOAddNotificationEx        ( mico_notify_types_t notify_type, void *functionAddress, void *context,
+                                        mico_notify_priority_t priority, uint32_t flags );
+
+/* No call to the handler starts after these return, and calls already running in other threads
+   have returned. Do not call them while holding something the handler waits for. */
 OSStatus MICORemoveNotification       ( mico_notify_types_t notify_type, void *functionAddress );
 
+OSStatus MICORemoveNotificationEx     ( mico_notify_types_t notify_type, void *functionAddress, void *context );
+
+void MICONotificationGetStats         ( mico_notify_stats_t *outStats );
+
 void sendNotifySYSWillPowerOff(void);
 void system_version(char *str, int len);
 
@@ -34,6 +34,7 @@
 #include "MICO.h"
 #include "platform_config.h"
 #include "MicoPlatform.h"
+#include "MICOConfigReport.h"
 
 /* Update seed number every time*/
 static int32_t seedNum = 0;
@@ -75,6 +76,7 @@ OSStatus MICORestoreDefault(mico_Context_t *inContext)
   require_noerr(err, exit);
 
 exit:
+  MICOConfigReportInvalidate();
   return err;
 }
 
@@ -104,6 +106,7 @@ OSStatus MICORestoreMFG(mico_Context_t *inContext)
   require_noerr(err, exit);
 
 exit:
+  MICOConfigReportInvalidate();
   return err;
 }
 #endif
@@ -162,6 +165,7 @@ OSStatus MICOUpdateConfiguration(mico_Context_t *inContext)
   require_noerr(err, exit);
 
 exit:
+  MICOConfigReportInvalidate();
   return err;
 }
 
@@ -33,21 +33,133 @@
 #include "MICO.h"
 #include "MicoSystemMonitor.h"
 #include "MicoPlatform.h"
+#include "MICOWorkQueue.h"
+#include "MICONotificationCenter.h"
+#include "MICOLog.h"
 
-
+#define monitor_log(M, ...) custom_log("SYS MONITOR", M, ##__VA_ARGS__)
 
 #define DEFAULT_SYSTEM_MONITOR_PERIOD   (2000)
 
-#ifndef MAXIMUM_NUMBER_OF_SYSTEM_MONITORS
-#define MAXIMUM_NUMBER_OF_SYSTEM_MONITORS    (5)
-#endif
+#define SYSTEM_MONITOR_RESET_MAGIC      (0x4D4F4E52)  /* "MONR" */
+
+typedef struct
+{
+  uint32_t magic;
+  mico_system_monitor_reset_t reset;
+  uint32_t checksum;
+} system_monitor_reset_record_t;
 
 static mico_system_monitor_t* system_monitors[MAXIMUM_NUMBER_OF_SYSTEM_MONITORS];
+
+static mico_system_sample_t samples[MICO_SYSTEM_MONITOR_HISTORY];
+static uint32_t sample_count = 0;
+static uint32_t heap_min_free = 0xFFFFFFFF;
+static uint32_t last_idle_time;
+static OSStatus last_idle_err = kNotPreparedErr;
+
+/* Survives the watchdog reset, checked and cleared by MICOStartSystemMonitor */
+static NOINIT system_monitor_reset_record_t reset_record;
+static mico_system_monitor_reset_t last_reset;
+static bool last_reset_valid = false;
+
 void mico_system_monitor_thread_main( void* arg );
 
+static uint32_t system_monitor_checksum( const void *data, size_t len )
+{
+  const uint8_t *ptr = data;
+  uint32_t sum = SYSTEM_MONITOR_RESET_MAGIC;
+
+  while( len-- )
+    sum = ( ( sum << 5 ) | ( sum >> 27 ) ) + *ptr++;
+  return sum;
+}
+
+static void system_monitor_check_last_reset( void )
+{
+  if( reset_record.magic == SYSTEM_MONITOR_RESET_MAGIC
+   && reset_record.checksum == system_monitor_checksum( &reset_record.reset, sizeof(mico_system_monitor_reset_t) ) )
+  {
+    memcpy( &last_reset, &reset_record.reset, sizeof(mico_system_monitor_reset_t) );
+    last_reset.name[MICO_SYSTEM_MONITOR_NAME_LEN - 1] = 0x0;
+    last_reset_valid = true;
+    monitor_log( "Last reset: monitor \"%s\" was %d ms late after %d ms uptime, free heap %d",
+                 last_reset.name, last_reset.overdue, last_reset.uptime, last_reset.last_sample.heap_free );
+  }
+  memset( &reset_record, 0, sizeof(system_monitor_reset_record_t) );
+}
+
+static void system_monitor_take_sample( void )
+{
+  mico_system_sample_t sample;
+  micoMemInfo_t *mem_info = MicoGetMemoryInfo();
+  mico_work_queue_stats_t work_stats;
+  mico_notify_stats_t notify_stats;
+  uint32_t idle_time, elapsed, idle;
+  OSStatus idle_err;
+
+  memset( &sample, 0, sizeof(mico_system_sample_t) );
+  idle_err = MicoMcuGetIdleTime( &idle_time );
+  sample.time = mico_get_time();
+
+  if( mem_info ){
+    sample.heap_free = mem_info->free_memory;
+    sample.heap_chunks = mem_info->num_of_chunks;
+    if( sample.heap_free < heap_min_free )
+      heap_min_free = sample.heap_free;
+  }
+  sample.heap_min_free = heap_min_free;
+
+  /* Load is the share of the time since the previous sample not spent in the idle hooks */
+  sample.cpu_load = MICO_SYSTEM_MONITOR_NO_CPU_LOAD;
+  if( idle_err == kNoErr && last_idle_err == kNoErr && sample_count > 0 ){
+    elapsed = sample.time - samples[(sample_count - 1) % MICO_SYSTEM_MONITOR_HISTORY].time;
+    idle = idle_time - last_idle_time;
+    if( elapsed > 0 ){
+      if( idle > elapsed * 1000 )
+        idle = elapsed * 1000;
+      sample.cpu_load = 1000 - idle / elapsed;
+    }
+  }
+  last_idle_time = idle_time;
+  last_idle_err = idle_err;
+
+  MICOWorkQueueGetStats( &work_stats );
+  sample.work_pending = work_stats.pending;
+  MICONotificationGetStats( &notify_stats );
+  sample.notify_pending = notify_stats.queue_depth;
+
+  mico_rtos_suspend_all_thread();
+  memcpy( &samples[sample_count % MICO_SYSTEM_MONITOR_HISTORY], &sample, sizeof(mico_system_sample_t) );
+  sample_count++;
+  mico_rtos_resume_all_thread();
+}
+
+static void system_monitor_failed( mico_system_monitor_t* system_monitor, uint32_t current_time )
+{
+  mico_system_monitor_reset_t *reset = &reset_record.reset;
+
+  memset( &reset_record, 0, sizeof(system_monitor_reset_record_t) );
+  if( system_monitor->name )
+    strncpy( reset->name, system_monitor->name, MICO_SYSTEM_MONITOR_NAME_LEN - 1 );
+  reset->overdue = current_time - system_monitor->last_update - system_monitor->longest_permitted_delay;
+  reset->uptime = current_time;
+  system_monitor_take_sample();
+  memcpy( &reset->last_sample, &samples[(sample_count - 1) % MICO_SYSTEM_MONITOR_HISTORY], sizeof(mico_system_sample_t) );
+  reset_record.checksum = system_monitor_checksum( reset, sizeof(mico_system_monitor_reset_t) );
+  reset_record.magic = SYSTEM_MONITOR_RESET_MAGIC;
+
+  monitor_log( "Monitor \"%s\" missed its deadline by %d ms, waiting for watchdog reset", reset->name, reset->overdue );
+  /* Nothing below this thread's priority runs any more */
+  MicoLogFlush();
+  /* A system monitor update period has been missed */
+  while(1);
+}
+
 OSStatus MICOStartSystemMonitor ( mico_Context_t * const inContext )
 {
   OSStatus err = kNoErr;
+  system_monitor_check_last_reset();
   require_noerr(MicoWdgInitialize( DEFAULT_SYSTEM_MONITOR_PERIOD + 1000 ), exit);
   memset(system_monitors, 0, sizeof(system_monitors));
 
@@ -59,8 +171,12 @@ exit:
 
 void mico_system_monitor_thread_main( void* arg )
 {
+  uint32_t last_sample_time;
   (void)arg;
-  
+
+  system_monitor_take_sample();
+  last_sample_time = mico_get_time();
+
   while (1)
   {
     int a;
@@ -70,14 +186,21 @@ void mico_system_monitor_thread_main( void* arg )
     {
       if (system_monitors[a] != NULL)
       {
-        if ((current_time - system_monitors[a]->last_update) > system_monitors[a]->longest_permitted_delay)
+        /* last_update may be newer than current_time if the monitor was updated after reading the time */
+        if ((int32_t)(current_time - system_monitors[a]->last_update) > 0 &&
+            (current_time - system_monitors[a]->last_update) > system_monitors[a]->longest_permitted_delay)
         {
-          /* A system monitor update period has been missed */
-          while(1);
+          system_monitor_failed(system_monitors[a], current_time);
         }
       }
     }
     
+    if ((current_time - last_sample_time) >= MICO_SYSTEM_MONITOR_SAMPLE_PERIOD)
+    {
+      system_monitor_take_sample();
+      last_sample_time = current_time;
+    }
+
     MicoWdgReload();
     mico_thread_msleep(DEFAULT_SYSTEM_MONITOR_PERIOD);
   }
@@ -85,8 +208,15 @@ void mico_system_monitor_thread_main( void* arg )
 
 OSStatus MICORegisterSystemMonitor(mico_system_monitor_t* system_monitor, uint32_t initial_permitted_delay)
 {
+  return MICORegisterSystemMonitorNamed(system_monitor, NULL, initial_permitted_delay);
+}
+
+OSStatus MICORegisterSystemMonitorNamed(mico_system_monitor_t* system_monitor, const char *name, uint32_t initial_permitted_delay)
+{
+  OSStatus err = kUnknownErr;
   int a;
   
+  mico_rtos_suspend_all_thread();
   /* Find spare entry and add the new system monitor */
   for ( a = 0; a < MAXIMUM_NUMBER_OF_SYSTEM_MONITORS; ++a )
   {
@@ -94,23 +224,69 @@ OSStatus MICORegisterSystemMonitor(mico_system_monitor_t* system_monitor, uint32
     {
       system_monitor->last_update = mico_get_time();
       system_monitor->longest_permitted_delay = initial_permitted_delay;
+      system_monitor->name = name;
+      system_monitor->longest_checkin = 0;
       system_monitors[a] = system_monitor;
-      return kNoErr;
+      err = kNoErr;
+      break;
     }
   }
+  mico_rtos_resume_all_thread();
   
-  return kUnknownErr;
+  return err;
 }
 
 OSStatus MICOUpdateSystemMonitor(mico_system_monitor_t* system_monitor, uint32_t permitted_delay)
 {
   uint32_t current_time = mico_get_time();
+  uint32_t checkin = current_time - system_monitor->last_update;
   /* Update the system monitor if it hasn't already passed it's permitted delay */
-  if ((current_time - system_monitor->last_update) <= system_monitor->longest_permitted_delay)
+  if (checkin <= system_monitor->longest_permitted_delay)
   {
+    if (checkin > system_monitor->longest_checkin)
+      system_monitor->longest_checkin = checkin;
     system_monitor->last_update             = current_time;
     system_monitor->longest_permitted_delay = permitted_delay;
   }
   
   return kNoErr;
 }
+
+uint32_t MICOSystemMonitorGetSamples( mico_system_sample_t *samples_out, uint32_t max_samples )
+{
+  uint32_t count, i;
+
+  mico_rtos_suspend_all_thread();
+  count = ( sample_count < MICO_SYSTEM_MONITOR_HISTORY )? sample_count : MICO_SYSTEM_MONITOR_HISTORY;
+  if( count > max_samples )
+    count = max_samples;
+  for( i = 0; i < count; i++ )
+    memcpy( &samples_out[i], &samples[(sample_count - count + i) % MICO_SYSTEM_MONITOR_HISTORY], sizeof(mico_system_sample_t) );
+  mico_rtos_resume_all_thread();
+
+  return count;
+}
+
+uint32_t MICOSystemMonitorGetMonitors( mico_system_monitor_t *monitors, uint32_t max_monitors )
+{
+  uint32_t count = 0;
+  int a;
+
+  mico_rtos_suspend_all_thread();
+  for( a = 0; a < MAXIMUM_NUMBER_OF_SYSTEM_MONITORS && count < max_monitors; ++a )
+  {
+    if( system_monitors[a] != NULL )
+      memcpy( &monitors[count++], system_monitors[a], sizeof(mico_system_monitor_t) );
+  }
+  mico_rtos_resume_all_thread();
+
+  return count;
+}
+
+OSStatus MICOSystemMonitorGetLastReset( mico_system_monitor_reset_t *outReset )
+{
+  if( last_reset_valid == false )
+    return kNotFoundErr;
+  memcpy( outReset, &last_reset, sizeof(mico_system_monitor_reset_t) );
+  return kNoErr;
+}
@@ -36,13 +36,58 @@
 #include "Common.h"
 #include "MICODefine.h"
 
+/* The monitor thread reloads the watchdog every DEFAULT_SYSTEM_MONITOR_PERIOD ms as long as every registered
+   monitor is updated in time. It also samples the system every MICO_SYSTEM_MONITOR_SAMPLE_PERIOD ms into a ring
+   of the last MICO_SYSTEM_MONITOR_HISTORY samples.
+   When a monitor misses its deadline, its name, how late it is and the last sample are saved in no-init RAM before
+   the watchdog is left to reset the system, and MICOSystemMonitorGetLastReset reports them after the reboot. */
+
+#ifndef MAXIMUM_NUMBER_OF_SYSTEM_MONITORS
+#define MAXIMUM_NUMBER_OF_SYSTEM_MONITORS   (5)
+#endif
+
+#ifndef MICO_SYSTEM_MONITOR_SAMPLE_PERIOD
+#define MICO_SYSTEM_MONITOR_SAMPLE_PERIOD   (10000)
+#endif
+
+#ifndef MICO_SYSTEM_MONITOR_HISTORY
+#define MICO_SYSTEM_MONITOR_HISTORY         (12)
+#endif
+
+#define MICO_SYSTEM_MONITOR_NAME_LEN        (16)
+
+#define MICO_SYSTEM_MONITOR_NO_CPU_LOAD     (0xFFFF)
+
 /** Structure to hold information about a system monitor item */
 typedef struct
 {
     uint32_t last_update;              /**< Time of the last system monitor update */
     uint32_t longest_permitted_delay;  /**< Longest permitted delay between checkins with the system monitor */
+    const char *name;                  /**< Reported when the deadline is missed, may be NULL */
+    uint32_t longest_checkin;          /**< Longest time seen between two checkins */
 } mico_system_monitor_t;
 
+/** Structure to hold one sample of the system state */
+typedef struct
+{
+    uint32_t time;                     /**< mico_get_time() when the sample was taken */
+    uint32_t heap_free;                /**< Free heap in bytes */
+    uint32_t heap_min_free;            /**< Lowest free heap seen by any sample since boot */
+    uint16_t heap_chunks;              /**< Free heap chunks, more chunks for the same free heap means more fragmentation */
+    uint16_t cpu_load;                 /**< Per mille since the previous sample, or MICO_SYSTEM_MONITOR_NO_CPU_LOAD */
+    uint16_t work_pending;             /**< Items waiting in the shared work queue */
+    uint16_t notify_pending;           /**< Notifications waiting for asynchronous delivery */
+} mico_system_sample_t;
+
+/** Structure to hold the cause of a reset forced by the system monitor */
+typedef struct
+{
+    char     name[MICO_SYSTEM_MONITOR_NAME_LEN]; /**< Monitor that missed its deadline, "" if it had no name */
+    uint32_t overdue;                  /**< ms past the permitted delay */
+    uint32_t uptime;                   /**< mico_get_time() when the deadline was found missed */
+    mico_system_sample_t last_sample;  /**< Newest sample before the reset */
+} mico_system_monitor_reset_t;
+
 
 OSStatus MICOStartSystemMonitor (mico_Context_t * const inContext);
 
@@ -50,6 +95,18 @@ OSStatus MICOUpdateSystemMonitor( mico_system_monitor_t* system_monitor, uint32_
 
 OSStatus MICORegisterSystemMonitor( mico_system_monitor_t* system_monitor, uint32_t initial_permitted_delay );
 
+/* Same as MICORegisterSystemMonitor, name is not copied and must stay valid */
+OSStatus MICORegisterSystemMonitorNamed( mico_system_monitor_t* system_monitor, const char *name, uint32_t initial_permitted_delay );
+
+/* Copies up to max_samples samples, oldest first, and returns how many were copied */
+uint32_t MICOSystemMonitorGetSamples( mico_system_sample_t *samples, uint32_t max_samples );
+
+/* Copies the registered monitors, returns how many were copied */
+uint32_t MICOSystemMonitorGetMonitors( mico_system_monitor_t *monitors, uint32_t max_monitors );
+
+/* kNotFoundErr if the last reset was not forced by the system monitor */
+OSStatus MICOSystemMonitorGetLastReset( mico_system_monitor_reset_t *outReset );
+
 
 #endif //__MICO_SYSTEM_MONITOR_H__
 
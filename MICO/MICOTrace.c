@@ -0,0 +1,267 @@
+/**
+******************************************************************************
+* @file    MICOTrace.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Trace point ring, latency histograms and their export as Chrome
+*          trace JSON.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "MICOTrace.h"
+
+#define trace_log(M, ...) custom_log("TRACE", M, ##__VA_ARGS__)
+
+#define TRACE_LINE_SIZE         128
+
+static mico_trace_histogram_t *trace_histograms = NULL;
+
+#ifdef MICO_TRACE_ENABLE
+
+/* Exported by the FreeRTOS based RTOS library */
+extern void *xTaskGetCurrentTaskHandle( void );
+extern uint32_t SystemCoreClock;
+
+static mico_trace_event_t trace_events[MICO_TRACE_BUFFER_EVENTS];
+static uint32_t trace_event_count = 0;  /* Events recorded since the last clear, the newest is at (count - 1) */
+static volatile bool trace_running = false;
+static bool trace_counter_enabled = false;
+
+void MicoTraceRecord( const char *name, mico_trace_event_type_t type, int32_t value )
+{
+  mico_trace_event_t *event;
+
+  if( trace_running == false )
+    return;
+
+  mico_rtos_suspend_all_thread();
+  event = &trace_events[trace_event_count % MICO_TRACE_BUFFER_EVENTS];
+  event->cycles = mico_cycle_counter();
+  trace_event_count++;
+  mico_rtos_resume_all_thread();
+
+  /* The slot belongs to this thread now, unless the ring wraps around before the fields are written */
+  event->name = name;
+  event->thread = xTaskGetCurrentTaskHandle();
+  event->time = mico_get_time();
+  event->value = value;
+  event->type = type;
+}
+
+void MicoTraceHistogramAdd( mico_trace_histogram_t *histogram, uint32_t start_cycles )
+{
+  uint32_t us = ( mico_cycle_counter() - start_cycles ) / MICO_TRACE_CYCLES_PER_US;
+  uint32_t bucket = 0;
+
+  while( bucket < MICO_TRACE_HISTOGRAM_BUCKETS - 1 && ( us >> ( bucket + 1 ) ) != 0 )
+    bucket++;
+
+  mico_rtos_suspend_all_thread();
+  if( histogram->registered == false ){
+    histogram->registered = true;
+    histogram->next = trace_histograms;
+    trace_histograms = histogram;
+  }
+  histogram->count++;
+  histogram->total += us;
+  if( us > histogram->max )
+    histogram->max = us;
+  histogram->buckets[bucket]++;
+  mico_rtos_resume_all_thread();
+}
+
+void MicoTraceStart( void )
+{
+  if( trace_counter_enabled == false ){
+    mico_cycle_counter_enable();
+    trace_counter_enabled = true;
+  }
+  trace_running = true;
+}
+
+bool MicoTraceStop( void )
+{
+  bool running = trace_running;
+
+  trace_running = false;
+  return running;
+}
+
+void MicoTraceClear( void )
+{
+  mico_rtos_suspend_all_thread();
+  trace_event_count = 0;
+  mico_rtos_resume_all_thread();
+}
+
+uint32_t MicoTraceGetEvents( mico_trace_event_t *events, uint32_t max_events )
+{
+  uint32_t count, first, i;
+
+  mico_rtos_suspend_all_thread();
+  count = ( trace_event_count < MICO_TRACE_BUFFER_EVENTS )? trace_event_count : MICO_TRACE_BUFFER_EVENTS;
+  if( count > max_events )
+    count = max_events;
+  first = trace_event_count - count;
+  for( i = 0; i < count; i++ )
+    memcpy( &events[i], &trace_events[(first + i) % MICO_TRACE_BUFFER_EVENTS], sizeof(mico_trace_event_t) );
+  mico_rtos_resume_all_thread();
+
+  return count;
+}
+
+OSStatus MicoTraceExportChromeJson( mico_trace_writer_t writer, void *context )
+{
+  OSStatus err = kNoErr;
+  mico_trace_event_t *event, *previous = NULL;
+  char line[TRACE_LINE_SIZE];
+  uint32_t count, first, i, ts = 0, elapsed_us, elapsed_ms;
+  uint32_t cycles_per_us = MICO_TRACE_CYCLES_PER_US;
+  bool running = MicoTraceStop();
+  static const char phases[] = { 'B', 'E', 'i', 'C' };
+
+  err = writer( context, "{\"traceEvents\":[", strlen("{\"traceEvents\":[") );
+  require_noerr( err, exit );
+
+  count = ( trace_event_count < MICO_TRACE_BUFFER_EVENTS )? trace_event_count : MICO_TRACE_BUFFER_EVENTS;
+  first = trace_event_count - count;
+  for( i = 0; i < count; i++ ){
+    event = &trace_events[(first + i) % MICO_TRACE_BUFFER_EVENTS];
+
+    /* Timestamps are us from the first event. The cycle counter is exact but wraps every few seconds,
+       so the millisecond time is used when the two disagree by more than a wrap can explain. */
+    if( previous ){
+      elapsed_us = ( event->cycles - previous->cycles ) / cycles_per_us;
+      elapsed_ms = event->time - previous->time;
+      ts += ( elapsed_ms > elapsed_us / 1000 + 2 )? elapsed_ms * 1000 : elapsed_us;
+    }
+    previous = event;
+
+    snprintf( line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":1,\"tid\":%u",
+              ( i == 0 )? "" : ",", event->name, phases[event->type], (unsigned int)ts, (unsigned int)(uintptr_t)event->thread );
+    if( event->type == MICO_TRACE_EVENT_INSTANT )
+      snprintf( line + strlen(line), sizeof(line) - strlen(line), ",\"s\":\"t\",\"args\":{\"value\":%d}}", (int)event->value );
+    else if( event->type == MICO_TRACE_EVENT_COUNTER )
+      snprintf( line + strlen(line), sizeof(line) - strlen(line), ",\"args\":{\"value\":%d}}", (int)event->value );
+    else
+      snprintf( line + strlen(line), sizeof(line) - strlen(line), "}" );
+
+    err = writer( context, line, strlen(line) );
+    require_noerr( err, exit );
+  }
+
+  err = writer( context, "]}", 2 );
+
+exit:
+  if( running )
+    MicoTraceStart();
+  return err;
+}
+
+#else
+
+void MicoTraceStart( void )
+{
+}
+
+bool MicoTraceStop( void )
+{
+  return false;
+}
+
+void MicoTraceClear( void )
+{
+}
+
+uint32_t MicoTraceGetEvents( mico_trace_event_t *events, uint32_t max_events )
+{
+  UNUSED_PARAMETER( events );
+  UNUSED_PARAMETER( max_events );
+  return 0;
+}
+
+OSStatus MicoTraceExportChromeJson( mico_trace_writer_t writer, void *context )
+{
+  return writer( context, "{\"traceEvents\":[]}", strlen("{\"traceEvents\":[]}") );
+}
+
+#endif
+
+uint32_t MicoTraceGetHistograms( mico_trace_histogram_t *histograms, uint32_t max )
+{
+  mico_trace_histogram_t *histogram;
+  uint32_t count = 0;
+
+  mico_rtos_suspend_all_thread();
+  for( histogram = trace_histograms; histogram && count < max; histogram = histogram->next )
+    memcpy( &histograms[count++], histogram, sizeof(mico_trace_histogram_t) );
+  mico_rtos_resume_all_thread();
+
+  return count;
+}
+
+OSStatus MicoTraceExportHistogramJson( mico_trace_writer_t writer, void *context )
+{
+  OSStatus err = kNoErr;
+  mico_trace_histogram_t histogram;
+  mico_trace_histogram_t *next;
+  char line[TRACE_LINE_SIZE];
+  uint32_t i, b;
+
+  err = writer( context, "[", 1 );
+  require_noerr( err, exit );
+
+  /* Histograms are never unregistered, so the list can be walked while copying one at a time */
+  mico_rtos_suspend_all_thread();
+  next = trace_histograms;
+  mico_rtos_resume_all_thread();
+
+  for( i = 0; next; i++ ){
+    mico_rtos_suspend_all_thread();
+    memcpy( &histogram, next, sizeof(mico_trace_histogram_t) );
+    mico_rtos_resume_all_thread();
+    next = histogram.next;
+
+    snprintf( line, sizeof(line), "%s{\"name\":\"%s\",\"count\":%u,\"avg\":%u,\"max\":%u,\"buckets\":[",
+              ( i == 0 )? "" : ",", histogram.name, (unsigned int)histogram.count,
+              (unsigned int)( histogram.count? histogram.total/histogram.count : 0 ), (unsigned int)histogram.max );
+    err = writer( context, line, strlen(line) );
+    require_noerr( err, exit );
+
+    for( b = 0; b < MICO_TRACE_HISTOGRAM_BUCKETS; b++ ){
+      snprintf( line, sizeof(line), "%s%u", ( b == 0 )? "" : ",", (unsigned int)histogram.buckets[b] );
+      err = writer( context, line, strlen(line) );
+      require_noerr( err, exit );
+    }
+    err = writer( context, "]}", 2 );
+    require_noerr( err, exit );
+  }
+
+  err = writer( context, "]", 1 );
+
+exit:
+  return err;
+}
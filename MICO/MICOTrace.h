@@ -0,0 +1,148 @@
+/**
+******************************************************************************
+* @file    MICOTrace.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide the trace point and latency histogram macros,
+*          and the functions to dump them.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MICOTRACE_H__
+#define __MICOTRACE_H__
+
+#include "Common.h"
+#include "Debug.h"
+
+/* Trace points and latency histograms are compiled in when MICO_TRACE_ENABLE is defined in
+   MicoDefaults.h, otherwise every macro below expands to nothing.
+
+   MICO_TRACE_BEGIN/END/INSTANT/COUNTER record an event with the cycle counter, the current thread
+   and mico_get_time() into a ring of the last MICO_TRACE_BUFFER_EVENTS events. Names must be string
+   literals. Trace points take a few dozen cycles and can be placed on hot paths, but not in
+   interrupt handlers.
+
+   A histogram is a static variable counting durations in power of two microsecond buckets, from
+   [0,2) us to [2^(MICO_TRACE_HISTOGRAM_BUCKETS-1),...) us. It is registered by name the first time
+   a duration is added.
+
+       MICO_TRACE_HISTOGRAM( uart_to_tcp, "uart to tcp" );
+       uint32_t start = MICO_TRACE_TIMESTAMP();
+       ...
+       MICO_TRACE_HISTOGRAM_ADD( uart_to_tcp, start );
+
+   The "trace" CLI command prints the histograms and events, the config server returns the events
+   as Chrome trace JSON at /trace, to be loaded into chrome://tracing, and the histograms at
+   /trace-histograms. */
+
+#ifndef MICO_TRACE_BUFFER_EVENTS
+#define MICO_TRACE_BUFFER_EVENTS        128
+#endif
+
+#ifndef MICO_TRACE_HISTOGRAM_BUCKETS
+#define MICO_TRACE_HISTOGRAM_BUCKETS    20      /* The last bucket starts at 2^19 us, about half a second */
+#endif
+
+#ifndef MICO_TRACE_CYCLES_PER_US
+#define MICO_TRACE_CYCLES_PER_US        ( SystemCoreClock / 1000000 )
+#endif
+
+typedef enum {
+  MICO_TRACE_EVENT_BEGIN,
+  MICO_TRACE_EVENT_END,
+  MICO_TRACE_EVENT_INSTANT,
+  MICO_TRACE_EVENT_COUNTER,
+} mico_trace_event_type_t;
+
+typedef struct
+{
+  const char  *name;
+  void        *thread;
+  uint32_t    cycles;
+  uint32_t    time;                     /**< mico_get_time(), orders events further apart than a cycle counter wrap */
+  int32_t     value;                    /**< Instant and counter events */
+  uint8_t     type;
+} mico_trace_event_t;
+
+typedef struct _mico_trace_histogram_t
+{
+  const char  *name;
+  struct _mico_trace_histogram_t *next;
+  bool        registered;
+  uint32_t    count;
+  uint32_t    total;                    /**< us */
+  uint32_t    max;                      /**< us */
+  uint32_t    buckets[MICO_TRACE_HISTOGRAM_BUCKETS];
+} mico_trace_histogram_t;
+
+/* Called with every piece of a dump, returns kNoErr to continue */
+typedef OSStatus (*mico_trace_writer_t)( void *context, const char *data, size_t len );
+
+#ifdef MICO_TRACE_ENABLE
+
+void     MicoTraceRecord( const char *name, mico_trace_event_type_t type, int32_t value );
+void     MicoTraceHistogramAdd( mico_trace_histogram_t *histogram, uint32_t start_cycles );
+
+#define MICO_TRACE_BEGIN( NAME )                MicoTraceRecord( NAME, MICO_TRACE_EVENT_BEGIN, 0 )
+#define MICO_TRACE_END( NAME )                  MicoTraceRecord( NAME, MICO_TRACE_EVENT_END, 0 )
+#define MICO_TRACE_INSTANT( NAME, VALUE )       MicoTraceRecord( NAME, MICO_TRACE_EVENT_INSTANT, VALUE )
+#define MICO_TRACE_COUNTER( NAME, VALUE )       MicoTraceRecord( NAME, MICO_TRACE_EVENT_COUNTER, VALUE )
+
+#define MICO_TRACE_HISTOGRAM( VAR, NAME )       static mico_trace_histogram_t VAR = { NAME }
+#define MICO_TRACE_TIMESTAMP()                  mico_cycle_counter()
+#define MICO_TRACE_HISTOGRAM_ADD( VAR, START )  MicoTraceHistogramAdd( &VAR, START )
+
+#else
+
+#define MICO_TRACE_BEGIN( NAME )
+#define MICO_TRACE_END( NAME )
+#define MICO_TRACE_INSTANT( NAME, VALUE )
+#define MICO_TRACE_COUNTER( NAME, VALUE )
+
+#define MICO_TRACE_HISTOGRAM( VAR, NAME )       extern int mico_trace_disabled
+#define MICO_TRACE_TIMESTAMP()                  0
+#define MICO_TRACE_HISTOGRAM_ADD( VAR, START )  UNUSED_PARAMETER( START )
+
+#endif
+
+/* MICOEntrance starts recording at boot. Stop returns whether it was running. */
+void     MicoTraceStart( void );
+bool     MicoTraceStop( void );
+void     MicoTraceClear( void );
+
+/* Copies up to max_events events, oldest first, and returns how many were copied */
+uint32_t MicoTraceGetEvents( mico_trace_event_t *events, uint32_t max_events );
+
+/* Copies up to max histograms, most recently registered first, returns how many were copied */
+uint32_t MicoTraceGetHistograms( mico_trace_histogram_t *histograms, uint32_t max );
+
+/* Writes the events in Chrome trace event format, recording is paused while writing.
+   Stop recording around several exports to get the same events each time. */
+OSStatus MicoTraceExportChromeJson( mico_trace_writer_t writer, void *context );
+
+/* Writes the histograms as a JSON array */
+OSStatus MicoTraceExportHistogramJson( mico_trace_writer_t writer, void *context );
+
+#endif //__MICOTRACE_H__
@@ -0,0 +1,286 @@
+/**
+******************************************************************************
+* @file    MICOWorkQueue.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Work queue shared by MICO services, a small pool of worker threads
+*          running queued, delayed and periodic work items.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "MICO.h"
+#include "MICODefine.h"
+#include "MICOWorkQueue.h"
+
+#define work_log(M, ...) custom_log("Work queue", M, ##__VA_ARGS__)
+
+#define WORK_PENDING        (1<<0)    /* In the ready or the delayed list */
+#define WORK_RUNNING        (1<<1)
+#define WORK_CANCELLED      (1<<2)    /* Cancelled while running, do not rearm a periodic item */
+
+#define WORK_SEM_MAX_COUNT  32
+
+/* Both lists, the item states and the statistics are only touched with the scheduler suspended.
+   The ready list is FIFO, the delayed list is sorted by due time. */
+static mico_work_t *_ready_head = NULL;
+static mico_work_t *_ready_tail = NULL;
+static mico_work_t *_delayed = NULL;
+static uint32_t _pending = 0;
+
+static mico_semaphore_t _work_sem = NULL;
+static mico_thread_t _workers[MICO_WORK_QUEUE_THREADS];
+static uint32_t _started = 0;
+static uint32_t _latency_total = 0;
+static mico_work_queue_stats_t _stats;
+
+static void _work_add_ready(mico_work_t *work, uint32_t now)
+{
+  work->next = NULL;
+  work->ready = now;
+  if(_ready_tail)
+    _ready_tail->next = work;
+  else
+    _ready_head = work;
+  _ready_tail = work;
+}
+
+static void _work_add_delayed(mico_work_t *work)
+{
+  mico_work_t **link;
+
+  for(link = &_delayed; *link != NULL && (int32_t)((*link)->due - work->due) <= 0; link = &(*link)->next);
+  work->next = *link;
+  *link = work;
+}
+
+static bool _work_unlink(mico_work_t *work)
+{
+  mico_work_t **link;
+  mico_work_t *prev = NULL;
+
+  for(link = &_ready_head; *link != NULL; prev = *link, link = &(*link)->next){
+    if(*link == work){
+      *link = work->next;
+      if(_ready_tail == work)
+        _ready_tail = prev;
+      return true;
+    }
+  }
+  for(link = &_delayed; *link != NULL; link = &(*link)->next){
+    if(*link == work){
+      *link = work->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Takes the first ready item that is not running on another worker */
+static mico_work_t *_work_take_ready(void)
+{
+  mico_work_t **link;
+  mico_work_t *work, *prev = NULL;
+
+  for(link = &_ready_head; (work = *link) != NULL; prev = work, link = &work->next){
+    if(work->state & WORK_RUNNING)
+      continue;
+    *link = work->next;
+    if(_ready_tail == work)
+      _ready_tail = prev;
+    return work;
+  }
+  return NULL;
+}
+
+static OSStatus _work_queue(mico_work_t *work, uint32_t delay_ms, uint32_t period_ms)
+{
+  uint32_t now = mico_get_time();
+  bool signal = false;
+
+  if(work == NULL || work->function == NULL)
+    return kParamErr;
+  if(_work_sem == NULL)
+    return kNotPreparedErr;
+
+  mico_rtos_suspend_all_thread();
+  if(work->state & WORK_PENDING){
+    _stats.coalesced++;
+  }else{
+    work->state = (work->state & WORK_RUNNING) | WORK_PENDING;
+    work->period = period_ms;
+    if(delay_ms == 0){
+      _work_add_ready(work, now);
+    }else{
+      work->due = now + delay_ms;
+      _work_add_delayed(work);
+    }
+    /* The first delayed item changes how long idle workers sleep */
+    signal = (delay_ms == 0 || _delayed == work);
+    _stats.queued++;
+    if(++_pending > _stats.pending_max)
+      _stats.pending_max = _pending;
+  }
+  mico_rtos_resume_all_thread();
+
+  if(signal)
+    mico_rtos_set_semaphore(&_work_sem);
+  return kNoErr;
+}
+
+static void _work_thread(void *arg)
+{
+  uint8_t index = (uint8_t)(uintptr_t)arg;
+  mico_work_t *work;
+  uint32_t now, timeout, latency, elapsed;
+
+  while(1){
+    mico_rtos_suspend_all_thread();
+    now = mico_get_time();
+    while(_delayed && (int32_t)(_delayed->due - now) <= 0){
+      work = _delayed;
+      _delayed = work->next;
+      _work_add_ready(work, work->due);
+    }
+    work = _work_take_ready();
+    if(work){
+      _pending--;
+      work->state = WORK_RUNNING;
+      work->worker = index;
+      latency = now - work->ready;
+      _started++;
+      _latency_total += latency;
+      if(latency > _stats.latency_max)
+        _stats.latency_max = latency;
+    }
+    timeout = _delayed? _delayed->due - now : MICO_WAIT_FOREVER;
+    mico_rtos_resume_all_thread();
+
+    if(work == NULL){
+      mico_rtos_get_semaphore(&_work_sem, timeout);
+      continue;
+    }
+
+    work->function(work->arg);
+
+    mico_rtos_suspend_all_thread();
+    elapsed = mico_get_time() - now;
+    _stats.executed++;
+    if(elapsed >= _stats.run_time_max){
+      _stats.run_time_max = elapsed;
+      _stats.slowest_function = (void *)work->function;
+    }
+    if(work->period && (work->state & (WORK_PENDING|WORK_CANCELLED)) == 0){
+      /* Keep the period if the item ran late, but never catch up with a burst */
+      work->due = work->ready + work->period;
+      if((int32_t)(work->due - now - elapsed) <= 0)
+        work->due = now + elapsed + work->period;
+      work->state |= WORK_PENDING;
+      _work_add_delayed(work);
+      _pending++;
+    }
+    work->state &= ~(WORK_RUNNING|WORK_CANCELLED);
+    mico_rtos_resume_all_thread();
+  }
+}
+
+OSStatus MICOStartWorkQueue( void )
+{
+  OSStatus err = kNoErr;
+  uint32_t i;
+
+  require_action(_work_sem == NULL, exit, err = kAlreadyInitializedErr);
+  err = mico_rtos_init_semaphore(&_work_sem, WORK_SEM_MAX_COUNT);
+  require_noerr(err, exit);
+
+  for(i = 0; i < MICO_WORK_QUEUE_THREADS; i++){
+    err = mico_rtos_create_thread(&_workers[i], MICO_WORK_QUEUE_PRIORITY, "Work queue", _work_thread, STACK_SIZE_MICO_WORK_QUEUE_THREAD, (void *)(uintptr_t)i);
+    require_noerr_action(err, exit, work_log("ERROR: Unable to start worker %d", i));
+  }
+
+exit:
+  return err;
+}
+
+void MICOInitWork( mico_work_t *work, mico_work_function_t function, void *arg )
+{
+  memset(work, 0x0, sizeof(mico_work_t));
+  work->function = function;
+  work->arg = arg;
+}
+
+OSStatus MICOQueueWork( mico_work_t *work )
+{
+  return _work_queue(work, 0, 0);
+}
+
+OSStatus MICOQueueDelayedWork( mico_work_t *work, uint32_t delay_ms )
+{
+  return _work_queue(work, delay_ms, 0);
+}
+
+OSStatus MICOQueuePeriodicWork( mico_work_t *work, uint32_t period_ms )
+{
+  if(period_ms == 0)
+    return kParamErr;
+  return _work_queue(work, period_ms, period_ms);
+}
+
+OSStatus MICOCancelWork( mico_work_t *work, bool wait )
+{
+  OSStatus err = kNotFoundErr;
+  bool running;
+
+  mico_rtos_suspend_all_thread();
+  if((work->state & WORK_PENDING) && _work_unlink(work)){
+    _pending--;
+    _stats.cancelled++;
+    err = kNoErr;
+  }
+  work->state &= ~WORK_PENDING;
+  if(work->state & WORK_RUNNING)
+    work->state |= WORK_CANCELLED;
+  running = (work->state & WORK_RUNNING) && !mico_rtos_is_current_thread(&_workers[work->worker]);
+  mico_rtos_resume_all_thread();
+
+  while(wait && running){
+    mico_thread_msleep(1);
+    running = (work->state & WORK_RUNNING) != 0;
+  }
+  return err;
+}
+
+bool MICOWorkIsPending( mico_work_t *work )
+{
+  return (work->state & WORK_PENDING) != 0;
+}
+
+void MICOWorkQueueGetStats( mico_work_queue_stats_t *outStats )
+{
+  mico_rtos_suspend_all_thread();
+  memcpy(outStats, &_stats, sizeof(mico_work_queue_stats_t));
+  outStats->latency_avg = _started? _latency_total/_started : 0;
+  outStats->pending = _pending;
+  mico_rtos_resume_all_thread();
+}
@@ -0,0 +1,107 @@
+/**
+******************************************************************************
+* @file    MICOWorkQueue.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide function prototypes for the work queue shared by
+*          MICO services: a small pool of worker threads running queued,
+*          delayed and periodic work items.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy 
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights 
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MICOWORKQUEUE_H__
+#define __MICOWORKQUEUE_H__
+
+#include "Common.h"
+
+/* A service that only waits for an event or a timeout can run as a work item instead of owning a
+   thread and its stack. Work items are allocated by the caller and must stay valid until they have
+   been cancelled or have finished. One item never runs on two workers at the same time, queueing
+   it again while it runs makes it run once more afterwards.
+
+   Work functions share MICO_WORK_QUEUE_THREADS threads, so they should not block for long: a
+   function that waits on a socket or semaphore holds a worker for that time. */
+
+#ifndef MICO_WORK_QUEUE_THREADS
+#define MICO_WORK_QUEUE_THREADS           1
+#endif
+
+#ifndef MICO_WORK_QUEUE_PRIORITY
+#define MICO_WORK_QUEUE_PRIORITY          MICO_APPLICATION_PRIORITY
+#endif
+
+typedef void (*mico_work_function_t)( void *arg );
+
+/** Structure to hold a work item, initialize it with MICOInitWork */
+typedef struct _mico_work_t
+{
+  mico_work_function_t function;
+  void                 *arg;
+  struct _mico_work_t  *next;
+  uint32_t             due;           /**< mico_get_time when a delayed item becomes ready */
+  uint32_t             ready;         /**< mico_get_time when it became ready, for the dispatch latency */
+  uint32_t             period;        /**< Interval of a periodic item in ms, 0 for a one-shot item */
+  uint8_t              state;
+  uint8_t              worker;        /**< Worker running it */
+} mico_work_t;
+
+typedef struct
+{
+  uint32_t executed;
+  uint32_t queued;                    /**< Items queued, delayed or not, coalesced requests not included */
+  uint32_t coalesced;                 /**< Requests for an item that was already queued */
+  uint32_t cancelled;
+  uint32_t pending;                   /**< Items waiting right now */
+  uint32_t pending_max;               /**< Most items waiting at the same time */
+  uint32_t latency_avg;               /**< ms from becoming ready to starting to run */
+  uint32_t latency_max;
+  uint32_t run_time_max;              /**< ms, longest work function */
+  void     *slowest_function;
+} mico_work_queue_stats_t;
+
+OSStatus MICOStartWorkQueue       ( void );
+
+void     MICOInitWork             ( mico_work_t *work, mico_work_function_t function, void *arg );
+
+/* Runs the item as soon as a worker is free, does nothing if it is already waiting to run */
+OSStatus MICOQueueWork            ( mico_work_t *work );
+
+/* Runs the item once after delay_ms, does nothing if it is already waiting to run */
+OSStatus MICOQueueDelayedWork     ( mico_work_t *work, uint32_t delay_ms );
+
+/* Runs the item every period_ms until it is cancelled, the first time after period_ms */
+OSStatus MICOQueuePeriodicWork    ( mico_work_t *work, uint32_t period_ms );
+
+/* Removes the item if it is waiting to run. With wait set, also waits until a run in progress has
+   finished, unless called from the work function itself. Returns kNoErr if the item was removed
+   before running, kNotFoundErr otherwise. */
+OSStatus MICOCancelWork           ( mico_work_t *work, bool wait );
+
+bool     MICOWorkIsPending        ( mico_work_t *work );
+
+void     MICOWorkQueueGetStats    ( mico_work_queue_stats_t *outStats );
+
+#endif //__MICOWORKQUEUE_H__
+
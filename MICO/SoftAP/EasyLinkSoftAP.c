@@ -39,6 +39,7 @@
 #include "HTTPUtils.h"
 #include "SocketUtils.h"
 #include "MDNSUtils.h"
+#include "MICOConfigReport.h"
 
 #include "EasyLinkSoftAP.h"
   
@@ -57,7 +58,6 @@
 static int _bonjourStarted = false;
 
 extern OSStatus     ConfigIncommingJsonMessage    ( const char *input, mico_Context_t * const inContext );
-extern json_object* ConfigCreateReportJsonMessage ( mico_Context_t * const inContext );
 extern void         ConfigWillStart               ( mico_Context_t * const inContext );
 extern void         ConfigWillStop                ( mico_Context_t * const inContext );
 extern void         ConfigEasyLinkIsSuccess       ( mico_Context_t * const inContext );
@@ -130,6 +130,7 @@ static void _EasyLinkNotify_DHCPCompleteHandler(IPStatusTypedef *pnet, mico_Cont
   strcpy((char *)inContext->micoStatus.netMask, pnet->mask);
   strcpy((char *)inContext->micoStatus.gateWay, pnet->gate);
   strcpy((char *)inContext->micoStatus.dnsServer, pnet->dns);
+  MICOConfigReportInvalidate();
 exit:
   return;
 }
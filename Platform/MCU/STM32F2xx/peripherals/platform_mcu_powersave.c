@@ -103,6 +103,9 @@ static unsigned long rtc_timeout_start_time       = 0;
 static int32_t       stm32f2_clock_needed_counter = 0;
 #endif /* #ifndef MICO_DISABLE_MCU_POWERSAVE */
 
+/* Core clock cycles spent in wfi or in STOP mode since boot */
+static volatile uint64_t idle_cycles              = 0;
+
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -297,13 +300,71 @@ static OSStatus select_wut_prescaler_calculate_wakeup_time( unsigned long* wakeu
 #endif
 
 
+OSStatus platform_mcu_get_idle_time( uint32_t* idle_us )
+{
+    uint64_t cycles;
+
+    DISABLE_INTERRUPTS;
+    cycles = idle_cycles;
+    ENABLE_INTERRUPTS;
+
+    *idle_us = (uint32_t)( cycles / ( SystemCoreClock / 1000000 ) );
+    return kNoErr;
+}
+
+/* Must be called with interrupts disabled, returns with them still disabled.
+ * The sleep is measured with SysTick so it is exact even when it is much shorter than a tick.
+ * wfi returns on the first pending interrupt, so SysTick can wrap at most once. */
+static void platform_idle_wfi( void )
+{
+    uint32_t start;
+    uint32_t end;
+    bool     wrapped;
+
+    if ( ( SysTick->CTRL & SysTick_CTRL_ENABLE_Msk ) == 0 )
+    {
+        __asm("wfi");
+        return;
+    }
+
+    start = SysTick->VAL;
+    if ( ( SCB->ICSR & SCB_ICSR_PENDSTSET_Msk ) != 0 )
+    {
+        /* A tick is already waiting, wfi would not sleep */
+        return;
+    }
+
+    __asm("wfi");
+
+    wrapped = ( ( SCB->ICSR & SCB_ICSR_PENDSTSET_Msk ) != 0 );
+    end = SysTick->VAL;
+    if ( wrapped == false && ( SCB->ICSR & SCB_ICSR_PENDSTSET_Msk ) != 0 )
+    {
+        /* Wrapped between the two reads */
+        wrapped = true;
+        end = SysTick->VAL;
+    }
+
+    if ( wrapped == true )
+    {
+        idle_cycles += start + ( SysTick->LOAD + 1 ) - end;
+    }
+    else
+    {
+        idle_cycles += start - end;
+    }
+}
+
+
 /******************************************************
  *               RTOS Powersave Hooks
  ******************************************************/
 
 void platform_idle_hook( void )
 {
-    __asm("wfi");
+    DISABLE_INTERRUPTS;
+    platform_idle_wfi( );
+    ENABLE_INTERRUPTS;
 }
 
 uint32_t platform_power_down_hook( uint32_t sleep_ms )
@@ -324,8 +385,8 @@ uint32_t platform_power_down_hook( uint32_t sleep_ms )
 static unsigned long idle_power_down_hook( unsigned long sleep_ms  )
 {
     UNUSED_PARAMETER( sleep_ms );
+    platform_idle_wfi( );
     WICED_ENABLE_INTERRUPTS( );
-    __asm("wfi");
     return 0;
 }
 #else
@@ -340,7 +401,7 @@ static unsigned long stop_mode_power_down_hook( unsigned long sleep_ms )
   
   if ( ( ( SCB->SCR & (unsigned long)SCB_SCR_SLEEPDEEP_Msk) != 0) && sleep_ms < 5 ){
     SCB->SCR &= (~((unsigned long)SCB_SCR_SLEEPDEEP_Msk));
-    __asm("wfi");
+    platform_idle_wfi( );
     SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
     /* Note: We return 0 ticks passed because system tick is still going when wfi instruction gets executed */
     ENABLE_INTERRUPTS;
@@ -392,6 +453,7 @@ static unsigned long stop_mode_power_down_hook( unsigned long sleep_ms )
     wut_ticks_passed = rtc_timeout_start_time - RTC_GetWakeUpCounter();
     UNUSED_VARIABLE(wut_ticks_passed);
     platform_rtc_exit_powersave( sleep_ms, (uint32_t *)&retval );
+    idle_cycles += (uint64_t)retval * ( SystemCoreClock / 1000 );
     /* as soon as interrupts are enabled, we will go and execute the interrupt handler */
     /* which triggered a wake up event */
     ENABLE_INTERRUPTS;
@@ -401,8 +463,8 @@ static unsigned long stop_mode_power_down_hook( unsigned long sleep_ms )
   else
   {
     UNUSED_PARAMETER(wut_ticks_passed);
+    platform_idle_wfi( );
     ENABLE_INTERRUPTS;
-    __asm("wfi");
     
     /* Note: We return 0 ticks passed because system tick is still going when wfi instruction gets executed */
     return 0;
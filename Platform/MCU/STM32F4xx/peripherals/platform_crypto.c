@@ -0,0 +1,206 @@
+/**
+******************************************************************************
+* @file    platform_crypto.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   This file provide the CRYP/HASH engine crypto provider.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+
+#include "MICOPlatform.h"
+#include "MICORTOS.h"
+#include "Common.h"
+#include "Debug.h"
+
+#include "platform.h"
+#include "platform_config.h"
+#include "platform_peripheral.h"
+#include "CryptoProvider.h"
+#include "SecurityUtils.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/* Below this size the engine setup and key schedule cost more than software AES */
+#define CRYPTO_ENGINE_MIN_LENGTH    ( 64 )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+#ifdef MICO_PLATFORM_HAS_CRYPTO_ENGINE
+static OSStatus crypto_engine_submit( const CryptoProvider *provider, CryptoRequest *request );
+#endif
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+#ifdef MICO_PLATFORM_HAS_CRYPTO_ENGINE
+static volatile bool crypto_engine_busy = false;
+
+static const CryptoProvider crypto_engine_provider =
+{
+    .name       = "STM32F4 CRYP",
+    .ops        = CryptoOpMask( kCryptoOp_AES_ECB ) | CryptoOpMask( kCryptoOp_AES_CBC ) |
+                  CryptoOpMask( kCryptoOp_AES_CTR ) |
+#if defined( STM32F427_437xx ) || defined( STM32F429_439xx )
+                  CryptoOpMask( kCryptoOp_AES_GCM ) |
+#endif
+                  CryptoOpMask( kCryptoOp_SHA1 ),
+    .priority   = 10,
+    .minLength  = CRYPTO_ENGINE_MIN_LENGTH,
+    .submit     = crypto_engine_submit,
+    .context    = NULL,
+};
+#endif
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+OSStatus platform_crypto_init( void )
+{
+#ifdef MICO_PLATFORM_HAS_CRYPTO_ENGINE
+  RCC_AHB2PeriphClockCmd( RCC_AHB2Periph_CRYP | RCC_AHB2Periph_HASH, ENABLE );
+  return CryptoProviderRegister( &crypto_engine_provider );
+#else
+  return kUnsupportedErr;
+#endif
+}
+
+#ifdef MICO_PLATFORM_HAS_CRYPTO_ENGINE
+static void crypto_engine_counter_add( uint8_t counter[16], uint32_t blocks )
+{
+  int i;
+
+  for ( i = 15; ( i >= 0 ) && ( blocks != 0 ); i-- )
+  {
+    blocks += counter[i];
+    counter[i] = (uint8_t)( blocks & 0xFF );
+    blocks >>= 8;
+  }
+}
+
+static OSStatus crypto_engine_submit( const CryptoProvider *provider, CryptoRequest *request )
+{
+  OSStatus    err = kNoErr;
+  ErrorStatus result = SUCCESS;
+  uint8_t     mode = request->encrypt ? MODE_ENCRYPT : MODE_DECRYPT;
+  uint8_t*    src = (uint8_t*) request->src;
+  uint8_t*    dst = (uint8_t*) request->dst;
+  uint32_t    len = (uint32_t) request->srcLen;
+  uint8_t     iv[16];
+
+  UNUSED_PARAMETER( provider );
+
+  /* The engine is a single shared resource, let the caller fall back to software while it is in use */
+  mico_rtos_suspend_all_thread( );
+  if ( crypto_engine_busy == true )
+  {
+    mico_rtos_resume_all_thread( );
+    return kNoResourcesErr;
+  }
+  crypto_engine_busy = true;
+  mico_rtos_resume_all_thread( );
+
+  switch ( request->op )
+  {
+    case kCryptoOp_AES_ECB:
+      require_action( ( len % kCryptoAESBlockSize ) == 0, exit, err = kSizeErr );
+      result = CRYP_AES_ECB( mode, (uint8_t*) request->key, 128, src, len, dst );
+      break;
+
+    case kCryptoOp_AES_CBC:
+      require_action( ( len % kCryptoAESBlockSize ) == 0, exit, err = kSizeErr );
+      /* Next IV is the last ciphertext block, which is in src when decrypting in place */
+      if ( request->encrypt == false && len >= kCryptoAESBlockSize )
+        memcpy( iv, src + len - kCryptoAESBlockSize, kCryptoAESBlockSize );
+      result = CRYP_AES_CBC( mode, request->iv, (uint8_t*) request->key, 128, src, len, dst );
+      if ( len >= kCryptoAESBlockSize )
+        memcpy( request->iv, request->encrypt ? dst + len - kCryptoAESBlockSize : iv, kCryptoAESBlockSize );
+      break;
+
+    case kCryptoOp_AES_CTR:
+      /* CRYP processes whole blocks only, leave ragged tails to software */
+      require_action_quiet( ( len % kCryptoAESBlockSize ) == 0, exit, err = kUnsupportedErr );
+      result = CRYP_AES_CTR( mode, request->iv, (uint8_t*) request->key, 128, src, len, dst );
+      crypto_engine_counter_add( request->iv, len / kCryptoAESBlockSize );
+      break;
+
+#if defined( STM32F427_437xx ) || defined( STM32F429_439xx )
+    case kCryptoOp_AES_GCM:
+    {
+      uint8_t tag[kCryptoGCMTagSize];
+
+      memcpy( iv, request->iv, kCryptoGCMNonceSize );
+      iv[12] = 0; iv[13] = 0; iv[14] = 0; iv[15] = 2;
+      result = CRYP_AES_GCM( mode, iv, (uint8_t*) request->key, 128, src, len,
+                             (uint8_t*) request->aad, (uint32_t) request->aadLen, dst, tag );
+      if ( request->encrypt == true )
+        memcpy( request->tag, tag, kCryptoGCMTagSize );
+      else if ( memcmp_constant_time( tag, request->tag, kCryptoGCMTagSize ) != 0 )
+      {
+        /* The engine decrypts and authenticates in one pass, do not hand out the forged plaintext */
+        memzero_secure( dst, len );
+        err = kAuthenticationErr;
+      }
+      break;
+    }
+#endif
+
+    case kCryptoOp_SHA1:
+      require_action( dst != NULL, exit, err = kParamErr );
+      result = HASH_SHA1( src, len, dst );
+      break;
+
+    default:
+      err = kUnsupportedErr;
+      break;
+  }
+
+  if ( err == kNoErr && result != SUCCESS )
+    err = kTimeoutErr;
+
+exit:
+  crypto_engine_busy = false;
+  return err;
+}
+#endif
+
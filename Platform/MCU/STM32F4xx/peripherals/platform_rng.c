@@ -34,11 +34,34 @@
 #include "MICORTOS.h"
 
 #include "platform.h"
+#include "platform_peripheral.h"
+#include "PlatformLogging.h"
 
 /******************************************************
  *                   Macros
  ******************************************************/
 
+/* STM32F401/F411 have no RNG peripheral */
+#if defined( STM32F40_41xxx ) || defined( STM32F427_437xx ) || defined( STM32F429_439xx )
+#define PLATFORM_HAS_HW_RNG
+#endif
+
+/* A new word is ready every 40 RNG clocks, a generator that stays busy this long has stopped */
+#define RNG_READY_TIMEOUT_LOOPS     ( 100000 )
+
+/* Without the RNG peripheral every output byte folds the low bits of this many conversions of the
+   temperature sensor, with the sampling time as short as possible so that the ADC thermal noise
+   dominates. Assuming at least 1 bit of min-entropy per conversion, a byte carries the 4 bits the
+   health tests in RandomUtils are set for with a margin of 2. */
+#define ADC_NOISE_SAMPLES_PER_BYTE  ( 8 )
+
+/* Repetition count test on the raw conversions (SP 800-90B 4.4.1 with H = 1, false positive
+   probability 2^-20), a sensor or ADC that stopped converting fails it */
+#define ADC_NOISE_RCT_CUTOFF        ( 21 )
+
+/* A conversion takes less than 20 ADC clocks, one that is not done after this has stopped */
+#define ADC_NOISE_EOC_TIMEOUT_LOOPS ( 10000 )
+
 
 /******************************************************
  *                   Enumerations
@@ -57,35 +80,156 @@
  *                     Variables
  ******************************************************/
 
+static bool rng_initialized = false;
+#ifndef PLATFORM_HAS_HW_RNG
+static uint16_t adc_noise_last;
+static uint32_t adc_noise_repeat = 0;
+#endif
+
 /******************************************************
  *               Function Declarations
  ******************************************************/
 
+#ifdef PLATFORM_HAS_HW_RNG
+static OSStatus rng_wait_ready( void )
+{
+  uint32_t counter = RNG_READY_TIMEOUT_LOOPS;
+
+  while ( RNG_GetFlagStatus( RNG_FLAG_DRDY ) != SET )
+  {
+    if ( --counter == 0 )
+      return kTimeoutErr;
+  }
+  return kNoErr;
+}
+
 OSStatus platform_random_number_read( void *inBuffer, int inByteCount )
 {
-    // PLATFORM_TO_DO
-     // PLATFORM_TO_DO
-    int idx;
-    uint32_t *pWord = inBuffer;
-    uint32_t tempRDM;
-    uint8_t *pByte = NULL;
-    int inWordCount;
-    int remainByteCount;
-
-    inWordCount = inByteCount/4;
-    remainByteCount = inByteCount%4;
-    pByte = (uint8_t *)pWord+inWordCount*4;
-
-    for(idx = 0; idx<inWordCount; idx++, pWord++){
-        srand(mico_get_time());
-        *pWord = rand();
+  uint8_t  *pByte = inBuffer;
+  uint32_t tempRDM;
+  int      len;
+  OSStatus err;
+
+  /* The RNG keeps running between calls, it is only read to seed and reseed the DRBG in RandomUtils */
+  if ( rng_initialized == false )
+  {
+    RCC_AHB2PeriphClockCmd( RCC_AHB2Periph_RNG, ENABLE );
+    RNG_Cmd( ENABLE );
+    rng_initialized = true;
+  }
+
+  while ( inByteCount > 0 )
+  {
+    if ( RNG_GetFlagStatus( RNG_FLAG_SECS ) == SET || RNG_GetFlagStatus( RNG_FLAG_CECS ) == SET )
+    {
+      /* Seed or clock error, restart the generator and discard the pending word */
+      RNG_Cmd( DISABLE );
+      RNG_ClearFlag( RNG_FLAG_SECS );
+      RNG_ClearFlag( RNG_FLAG_CECS );
+      RNG_Cmd( ENABLE );
+      err = rng_wait_ready( );
+      require_noerr_string( err, exit, "RNG did not restart" );
+      (void) RNG_GetRandomNumber( );
+      continue;
     }
+    err = rng_wait_ready( );
+    require_noerr_string( err, exit, "RNG timed out" );
+    tempRDM = RNG_GetRandomNumber( );
+    len = ( inByteCount < 4 ) ? inByteCount : 4;
+    memcpy( pByte, &tempRDM, (size_t) len );
+    pByte += len;
+    inByteCount -= len;
+  }
+  err = kNoErr;
+
+exit:
+  return err;
+}
+#else
+/* Converts the temperature sensor on an injected channel of ADC1, so the regular channel that
+   platform_adc_init sets up for the board is left alone */
+static void adc_noise_init( void )
+{
+  ADC_InitTypeDef       adc_init_structure;
+  ADC_CommonInitTypeDef adc_common_init_structure;
+
+  RCC_APB2PeriphClockCmd( RCC_APB2Periph_ADC1, ENABLE );
 
-    if(remainByteCount){
-        srand(mico_get_time());
-        tempRDM = rand();
-        memcpy(pByte, &tempRDM, (size_t)remainByteCount);
+  if ( ( ADC1->CR2 & ADC_CR2_ADON ) == 0 )
+  {
+    ADC_StructInit( &adc_init_structure );
+    ADC_Init( ADC1, &adc_init_structure );
+
+    ADC_CommonStructInit( &adc_common_init_structure );
+    adc_common_init_structure.ADC_Prescaler = ADC_Prescaler_Div4;
+    ADC_CommonInit( &adc_common_init_structure );
+
+    ADC_Cmd( ADC1, ENABLE );
+  }
+
+  ADC_TempSensorVrefintCmd( ENABLE );
+  ADC_InjectedSequencerLengthConfig( ADC1, 1 );
+  ADC_InjectedChannelConfig( ADC1, ADC_Channel_TempSensor, 1, ADC_SampleTime_3Cycles );
+}
+
+static OSStatus adc_noise_sample( uint16_t *output )
+{
+  uint32_t counter = ADC_NOISE_EOC_TIMEOUT_LOOPS;
+
+  ADC_ClearFlag( ADC1, ADC_FLAG_JEOC );
+  ADC_SoftwareStartInjectedConv( ADC1 );
+  while ( ADC_GetFlagStatus( ADC1, ADC_FLAG_JEOC ) == RESET )
+  {
+    if ( --counter == 0 )
+      return kTimeoutErr;
+  }
+  *output = ADC_GetInjectedConversionValue( ADC1, ADC_InjectedChannel_1 );
+
+  if ( adc_noise_repeat > 0 && *output == adc_noise_last )
+  {
+    if ( ++adc_noise_repeat >= ADC_NOISE_RCT_CUTOFF )
+      return kIntegrityErr;
+  }
+  else
+  {
+    adc_noise_last   = *output;
+    adc_noise_repeat = 1;
+  }
+  return kNoErr;
+}
+
+OSStatus platform_random_number_read( void *inBuffer, int inByteCount )
+{
+  uint8_t  *pByte = inBuffer;
+  uint8_t  byte;
+  uint16_t sample;
+  int      i;
+  OSStatus err = kNoErr;
+
+  /* Only read to seed and reseed the DRBG in RandomUtils, which runs its own health tests on these bytes */
+  if ( rng_initialized == false )
+  {
+    platform_log( "No hardware RNG, seeding from ADC noise" );
+    adc_noise_init( );
+    rng_initialized = true;
+  }
+
+  while ( inByteCount > 0 )
+  {
+    byte = 0;
+    for ( i = 0; i < ADC_NOISE_SAMPLES_PER_BYTE; i++ )
+    {
+      err = adc_noise_sample( &sample );
+      require_noerr_string( err, exit, "ADC noise source failed" );
+      /* The clock jitter between the conversions goes in as well, it can only add entropy */
+      byte = (uint8_t) ( ( byte << 3 ) | ( byte >> 5 ) );
+      byte ^= (uint8_t) ( sample ^ ( sample >> 8 ) ^ SysTick->VAL );
     }
-    
-    return kNoErr;
+    *pByte++ = byte;
+    inByteCount--;
+  }
+
+exit:
+  return err;
 }
+#endif
@@ -267,6 +267,9 @@ void init_architecture( void )
   
   /* Initialise RTC */
   platform_rtc_init( );
+
+  /* Offload AES/SHA to the CRYP/HASH engine when the MCU has one */
+  platform_crypto_init( );
   
 #ifndef MICO_DISABLE_MCU_POWERSAVE
   /* Initialise MCU powersave */
@@ -287,6 +287,17 @@ void MicoSystemStandBy( uint32_t secondsToWakeup )
   platform_mcu_enter_standby( secondsToWakeup );
 }
 
+WEAK OSStatus platform_mcu_get_idle_time( uint32_t* idle_us )
+{
+  UNUSED_PARAMETER( idle_us );
+  return kUnsupportedErr;
+}
+
+OSStatus MicoMcuGetIdleTime( uint32_t* idle_us )
+{
+  return platform_mcu_get_idle_time( idle_us );
+}
+
 
 OSStatus MicoPwmInitialize(mico_pwm_t pwm, uint32_t frequency, float duty_cycle)
 {
@@ -426,6 +426,16 @@ void platform_mcu_enter_standby( uint32_t secondsToWakeup );
 void platform_mcu_powersave_exit_notify( void );
 
 
+/**
+ * Get the time the MCU has spent sleeping in the RTOS idle and power-down hooks
+ *
+ * @param[out] idle_us : microseconds since boot, wraps around after about 71 minutes
+ *
+ * @return @ref OSStatus, kUnsupportedErr if the platform does not measure it
+ */
+OSStatus platform_mcu_get_idle_time( uint32_t* idle_us );
+
+
 OSStatus platform_watchdog_init( uint32_t timeout_ms );
 
 /**
@@ -804,6 +814,12 @@ void platform_init_nanosecond_clock( void );
  */
 OSStatus platform_random_number_read( void *inBuffer, int inByteCount );
 
+/**
+ * Register the MCU crypto engine as a crypto provider, if the MCU has one
+ *
+ */
+OSStatus platform_crypto_init( void );
+
 /**
  * Init flash 
  *
@@ -548,6 +548,7 @@ OSStatus    AES_ECB_Init( AES_ECB_Context *inContext, uint32_t inMode, const uin
 #elif( AES_UTILS_USE_MICO_AES )
     if( inMode == kAES_ECB_Mode_Encrypt )   AesSetKey( &inContext->ctx, inKey, kAES_ECB_Size, NULL, AES_ENCRYPTION );
     else                                    AesSetKey( &inContext->ctx, inKey, kAES_ECB_Size, NULL, AES_DECRYPTION );
+    inContext->mode = inMode;
 #elif( AES_UTILS_USE_USSL )
     if( inMode == kAES_ECB_Mode_Encrypt )   aes_setkey_enc( &inContext->ctx, (unsigned char *) inKey, kAES_ECB_Size * 8 );
     else                                    aes_setkey_dec( &inContext->ctx, (unsigned char *) inKey, kAES_ECB_Size * 8 );
@@ -591,7 +592,8 @@ OSStatus    AES_ECB_Update( AES_ECB_Context *inContext, const void *inSrc, size_
             if( inContext->encrypt )    aes_ecb_encrypt( src, dst, kAES_ECB_Size, &inContext->ctx.encrypt );
             else                        aes_ecb_decrypt( src, dst, kAES_ECB_Size, &inContext->ctx.decrypt );
         #elif( AES_UTILS_USE_MICO_AES )
-            AesEncryptDirect( &inContext->ctx, dst, src );
+            if( inContext->mode == kAES_ECB_Mode_Encrypt )  AesEncryptDirect( &inContext->ctx, dst, src );
+            else                                            AesDecryptDirect( &inContext->ctx, dst, src );
         #elif( AES_UTILS_USE_USSL )
             aes_crypt_ecb( &inContext->ctx, inContext->mode, (unsigned char *) src, dst );
         #else
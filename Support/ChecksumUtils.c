@@ -0,0 +1,178 @@
+/**
+  ******************************************************************************
+  * @file    ChecksumUtils.c
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This file provide the RFC 1071 Internet checksum.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#include "ChecksumUtils.h"
+
+#define ChecksumSwap( X )       ( ( ( (X) & 0xFF ) << 8 ) | ( (X) >> 8 ) )
+
+//===========================================================================================================================
+//  _ChecksumFold
+//
+//  2^16 and 2^32 are both 1 modulo 0xFFFF, so adding the high half to the low half keeps the one's complement sum.
+//===========================================================================================================================
+
+static uint32_t _ChecksumFold( uint64_t inSum )
+{
+    uint32_t        sum;
+
+    inSum = ( inSum & 0xFFFFFFFF ) + ( inSum >> 32 );
+    inSum = ( inSum & 0xFFFFFFFF ) + ( inSum >> 32 );
+    sum   = (uint32_t) inSum;
+    sum   = ( sum & 0xFFFF ) + ( sum >> 16 );
+    sum   = ( sum & 0xFFFF ) + ( sum >> 16 );
+    return( sum );
+}
+
+//===========================================================================================================================
+//  _ChecksumSum
+//
+//  Folded, not complemented sum with inData[ 0 ] as the first byte of a 16-bit word.
+//===========================================================================================================================
+
+static uint32_t _ChecksumSum( const uint8_t *inData, size_t inLen )
+{
+    uint64_t            sum = 0;
+    const uint32_t *    words;
+    bool                odd;
+    uint32_t            result;
+
+    if( inLen == 0 ) return( 0 );
+
+    // Words are read from the next even address, which puts every byte in the other half of its word. The byte
+    // before is added the same way and the folded sum is swapped back.
+    odd = ( ( (uintptr_t) inData ) & 1 ) != 0;
+    if( odd )
+    {
+#if( TARGET_RT_BIG_ENDIAN )
+        sum = *inData;
+#else
+        sum = (uint32_t) *inData << 8;
+#endif
+        ++inData;
+        --inLen;
+    }
+    if( ( ( (uintptr_t) inData ) & 2 ) && ( inLen >= 2 ) )
+    {
+        sum += *(const uint16_t *) inData;
+        inData += 2;
+        inLen  -= 2;
+    }
+
+    words = (const uint32_t *) inData;
+    while( inLen >= 32 )
+    {
+        sum += words[ 0 ];
+        sum += words[ 1 ];
+        sum += words[ 2 ];
+        sum += words[ 3 ];
+        sum += words[ 4 ];
+        sum += words[ 5 ];
+        sum += words[ 6 ];
+        sum += words[ 7 ];
+        words += 8;
+        inLen -= 32;
+    }
+    while( inLen >= 4 )
+    {
+        sum += *words++;
+        inLen -= 4;
+    }
+
+    inData = (const uint8_t *) words;
+    if( inLen >= 2 )
+    {
+        sum += *(const uint16_t *) inData;
+        inData += 2;
+        inLen  -= 2;
+    }
+    if( inLen )
+    {
+#if( TARGET_RT_BIG_ENDIAN )
+        sum += (uint32_t) *inData << 8;
+#else
+        sum += *inData;
+#endif
+    }
+
+    result = _ChecksumFold( sum );
+    if( odd ) result = ChecksumSwap( result );
+    return( result );
+}
+
+//===========================================================================================================================
+//  InternetChecksum
+//===========================================================================================================================
+
+uint16_t InternetChecksum( const void *inData, size_t inLen )
+{
+    return( (uint16_t) ~_ChecksumSum( (const uint8_t *) inData, inLen ) );
+}
+
+//===========================================================================================================================
+//  ChecksumAdjust16
+//
+//  RFC 1624 equation 3: HC' = ~( ~HC + ~m + m' ).
+//===========================================================================================================================
+
+uint16_t ChecksumAdjust16( uint16_t inChecksum, uint16_t inOldWord, uint16_t inNewWord )
+{
+    uint32_t        sum;
+
+    sum = (uint16_t) ~inChecksum + (uint16_t) ~inOldWord + inNewWord;
+    return( (uint16_t) ~_ChecksumFold( sum ) );
+}
+
+//===========================================================================================================================
+//  ChecksumInit
+//===========================================================================================================================
+
+void ChecksumInit( ChecksumContext *inContext )
+{
+    inContext->sum = 0;
+    inContext->len = 0;
+}
+
+//===========================================================================================================================
+//  ChecksumUpdate
+//===========================================================================================================================
+
+void ChecksumUpdate( ChecksumContext *inContext, const void *inData, size_t inLen )
+{
+    uint32_t        sum;
+
+    sum = _ChecksumSum( (const uint8_t *) inData, inLen );
+    if( inContext->len & 1 ) sum = ChecksumSwap( sum );
+    inContext->sum  = _ChecksumFold( inContext->sum + sum );
+    inContext->len += inLen;
+}
+
+//===========================================================================================================================
+//  ChecksumFinal
+//===========================================================================================================================
+
+uint16_t ChecksumFinal( ChecksumContext *inContext )
+{
+    uint16_t        checksum;
+
+    checksum = (uint16_t) ~inContext->sum;
+    ChecksumInit( inContext );
+    return( checksum );
+}
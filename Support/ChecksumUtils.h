@@ -0,0 +1,66 @@
+/**
+  ******************************************************************************
+  * @file    ChecksumUtils.h
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This header contains function prototypes for the RFC 1071 Internet
+  *          checksum.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#ifndef __ChecksumUtils_h__
+#define __ChecksumUtils_h__
+
+#include "Common.h"
+
+#ifdef  __cplusplus
+    extern "C" {
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @group      Internet Checksum API
+    @abstract   One's complement sum of 16-bit words (RFC 1071), as used by IP, UDP, TCP and the MXCHIP HA protocol.
+    @discussion
+
+    Data is summed 32 bits at a time into a 64-bit accumulator and folded to 16 bits once at the end. Any alignment
+    and length is accepted, a leading odd byte is summed one position off and the result swapped back.
+
+    Checksums are in host byte order, i.e. the sum of the 16-bit words as they are read from memory. Storing one with
+    WriteHost16 gives the RFC 1071 bytes, on this little endian target that is the same as WriteLittle16.
+
+    A ChecksumContext sums data that arrives in pieces of any length, the result is the same as one InternetChecksum
+    over all of it. ChecksumAdjust16 updates a checksum after one 16-bit word at an even offset has changed (RFC 1624),
+    without summing the data again.
+*/
+
+typedef struct
+{
+    uint32_t        sum;                        // Folded sum of the data so far, not complemented.
+    size_t          len;                        // After an odd length the next byte is a low order byte.
+
+}   ChecksumContext;
+
+uint16_t    InternetChecksum( const void *inData, size_t inLen );
+uint16_t    ChecksumAdjust16( uint16_t inChecksum, uint16_t inOldWord, uint16_t inNewWord );
+
+void        ChecksumInit( ChecksumContext *inContext );
+void        ChecksumUpdate( ChecksumContext *inContext, const void *inData, size_t inLen );
+uint16_t    ChecksumFinal( ChecksumContext *inContext );
+
+#ifdef  __cplusplus
+    }
+#endif
+
+#endif // __ChecksumUtils_h__
@@ -0,0 +1,476 @@
+/**
+  ******************************************************************************
+  * @file    CryptoProvider.c
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This file contains the crypto provider registry and the built-in
+  *          software provider.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#include "CryptoProvider.h"
+
+#include "Debug.h"
+#include "AESUtils.h"
+#include "SHAUtils.h"
+#include "SHAUtils/sha.h"
+#include "SecurityUtils.h"
+#include "MicoPlatform.h"
+
+#define crypto_log(M, ...) custom_log("Crypto", M, ##__VA_ARGS__)
+#define crypto_log_trace() custom_log_trace("Crypto")
+
+static OSStatus _CryptoSoftwareSubmit( const CryptoProvider *inProvider, CryptoRequest *inRequest );
+
+const CryptoProvider kCryptoSoftwareProvider =
+{
+    .name       = "Software",
+    .ops        = kCryptoOpMask_AES | kCryptoOpMask_Hash | CryptoOpMask( kCryptoOp_Random ),
+    .priority   = 0,
+    .minLength  = 0,
+    .submit     = _CryptoSoftwareSubmit,
+    .context    = NULL,
+};
+
+// Registered providers, sorted by descending priority. Only modified with the scheduler suspended.
+static const CryptoProvider *   gCryptoProviders[ kCryptoProviderMax ];
+static int                      gCryptoProviderCount = 0;
+
+//===========================================================================================================================
+//  CryptoProviderRegister
+//===========================================================================================================================
+
+OSStatus CryptoProviderRegister( const CryptoProvider *inProvider )
+{
+    OSStatus    err = kNoErr;
+    int         i;
+
+    require_action( inProvider && inProvider->submit, exit, err = kParamErr );
+
+    mico_rtos_suspend_all_thread();
+    for( i = 0; i < gCryptoProviderCount; ++i )
+    {
+        if( gCryptoProviders[ i ] == inProvider ) { err = kDuplicateErr; goto resume; }
+    }
+    if( gCryptoProviderCount >= kCryptoProviderMax ) { err = kNoResourcesErr; goto resume; }
+
+    for( i = gCryptoProviderCount; ( i > 0 ) && ( gCryptoProviders[ i - 1 ]->priority < inProvider->priority ); --i )
+    {
+        gCryptoProviders[ i ] = gCryptoProviders[ i - 1 ];
+    }
+    gCryptoProviders[ i ] = inProvider;
+    gCryptoProviderCount += 1;
+
+resume:
+    mico_rtos_resume_all_thread();
+    if( err == kNoErr ) crypto_log( "Registered provider %s, ops 0x%02X", inProvider->name, (unsigned int) inProvider->ops );
+
+exit:
+    return err;
+}
+
+//===========================================================================================================================
+//  CryptoProviderDeregister
+//===========================================================================================================================
+
+OSStatus CryptoProviderDeregister( const CryptoProvider *inProvider )
+{
+    OSStatus    err = kNotFoundErr;
+    int         i;
+
+    mico_rtos_suspend_all_thread();
+    for( i = 0; i < gCryptoProviderCount; ++i )
+    {
+        if( gCryptoProviders[ i ] != inProvider ) continue;
+
+        for( ; i < gCryptoProviderCount - 1; ++i )
+        {
+            gCryptoProviders[ i ] = gCryptoProviders[ i + 1 ];
+        }
+        gCryptoProviderCount -= 1;
+        gCryptoProviders[ gCryptoProviderCount ] = NULL;
+        err = kNoErr;
+        break;
+    }
+    mico_rtos_resume_all_thread();
+    return err;
+}
+
+//===========================================================================================================================
+//  CryptoProviderSelect
+//===========================================================================================================================
+
+const CryptoProvider * CryptoProviderSelect( CryptoOp inOp, size_t inLen )
+{
+    const CryptoProvider *  provider;
+    int                     i;
+
+    for( i = 0; i < gCryptoProviderCount; ++i )
+    {
+        provider = gCryptoProviders[ i ];
+        if( !provider ) break;
+        if( !( provider->ops & CryptoOpMask( inOp ) ) ) continue;
+        if( inLen < provider->minLength ) continue;
+        return provider;
+    }
+    return &kCryptoSoftwareProvider;
+}
+
+//===========================================================================================================================
+//  CryptoSubmit
+//===========================================================================================================================
+
+OSStatus CryptoSubmit( CryptoRequest *inRequest )
+{
+    OSStatus                err;
+    const CryptoProvider *  provider;
+
+    require_action( inRequest, exit, err = kParamErr );
+    require_action( inRequest->op < kCryptoOp_Count, exit, err = kUnsupportedErr );
+    require_action( inRequest->dst || ( ( inRequest->srcLen == 0 ) && !( CryptoOpMask( inRequest->op ) & kCryptoOpMask_Hash ) ),
+                    exit, err = kParamErr );
+
+    provider = CryptoProviderSelect( inRequest->op, inRequest->srcLen );
+    inRequest->provider = provider;
+    inRequest->status   = kInProgressErr;
+
+    err = provider->submit( provider, inRequest );
+    if( ( err == kNoResourcesErr || err == kUnsupportedErr ) && ( provider != &kCryptoSoftwareProvider ) )
+    {
+        // Hardware engine is busy or rejected this request (e.g. unsupported key size), so do it in software.
+        provider = &kCryptoSoftwareProvider;
+        inRequest->provider = provider;
+        err = provider->submit( provider, inRequest );
+    }
+    if( err != kAsyncNoErr )
+    {
+        CryptoRequestComplete( inRequest, err );
+    }
+
+exit:
+    return err;
+}
+
+//===========================================================================================================================
+//  CryptoPerform
+//===========================================================================================================================
+
+OSStatus CryptoPerform( CryptoRequest *inRequest )
+{
+    OSStatus    err;
+
+    require_action( inRequest, exit, err = kParamErr );
+
+    inRequest->doneSem = NULL;
+    err = CryptoSubmit( inRequest );
+    if( err != kAsyncNoErr ) goto exit;
+
+    // Only wait on a semaphore if the provider really went asynchronous.
+
+    mico_rtos_suspend_all_thread();
+    if( inRequest->status == kInProgressErr )
+    {
+        mico_rtos_init_semaphore( &inRequest->doneSem, 1 );
+    }
+    mico_rtos_resume_all_thread();
+
+    if( inRequest->doneSem )
+    {
+        mico_rtos_get_semaphore( &inRequest->doneSem, MICO_WAIT_FOREVER );
+        mico_rtos_deinit_semaphore( &inRequest->doneSem );
+        inRequest->doneSem = NULL;
+    }
+    err = inRequest->status;
+
+exit:
+    return err;
+}
+
+//===========================================================================================================================
+//  CryptoRequestComplete
+//
+//  The completion runs before the status is published, a CryptoPerform caller that sees the final status may
+//  return and release the request right away.
+//===========================================================================================================================
+
+void CryptoRequestComplete( CryptoRequest *inRequest, OSStatus inStatus )
+{
+    mico_semaphore_t    sem;
+
+    if( inStatus == kAsyncNoErr ) inStatus = kNoErr;
+
+    if( inRequest->completion ) inRequest->completion( inRequest, inStatus, inRequest->context );
+
+    mico_rtos_suspend_all_thread();
+    inRequest->status = inStatus;
+    sem = inRequest->doneSem;
+    mico_rtos_resume_all_thread();
+
+    if( sem ) mico_rtos_set_semaphore( &sem );
+}
+
+#if 0
+#pragma mark -
+#pragma mark == Software Provider ==
+#endif
+
+//===========================================================================================================================
+//  _CryptoGHASHMultiply
+//
+//  X = X * H in GF(2^128), SP 800-38D algorithm 1. Masks instead of branches so the time does not depend on the data.
+//===========================================================================================================================
+
+static void _CryptoGHASHMultiply( uint8_t ioX[ kCryptoAESBlockSize ], const uint8_t inH[ kCryptoAESBlockSize ] )
+{
+    uint8_t     z[ kCryptoAESBlockSize ];
+    uint8_t     v[ kCryptoAESBlockSize ];
+    uint8_t     mask;
+    int         i, j, k;
+
+    memset( z, 0, sizeof( z ) );
+    memcpy( v, inH, sizeof( v ) );
+    for( i = 0; i < kCryptoAESBlockSize; ++i )
+    {
+        for( j = 7; j >= 0; --j )
+        {
+            mask = (uint8_t) -( ( ioX[ i ] >> j ) & 1 );
+            for( k = 0; k < kCryptoAESBlockSize; ++k ) z[ k ] ^= v[ k ] & mask;
+
+            mask = (uint8_t) -( v[ kCryptoAESBlockSize - 1 ] & 1 );
+            for( k = kCryptoAESBlockSize - 1; k > 0; --k ) v[ k ] = (uint8_t)( ( v[ k ] >> 1 ) | ( v[ k - 1 ] << 7 ) );
+            v[ 0 ] = (uint8_t)( ( v[ 0 ] >> 1 ) ^ ( 0xE1 & mask ) );
+        }
+    }
+    memcpy( ioX, z, sizeof( z ) );
+    memzero_secure( z, sizeof( z ) );
+    memzero_secure( v, sizeof( v ) );
+}
+
+//===========================================================================================================================
+//  _CryptoGHASHUpdate
+//
+//  Absorbs one AAD or ciphertext segment, zero padded to a whole block.
+//===========================================================================================================================
+
+static void _CryptoGHASHUpdate( uint8_t ioX[ kCryptoAESBlockSize ], const uint8_t inH[ kCryptoAESBlockSize ],
+                                const uint8_t *inData, size_t inLen )
+{
+    size_t      i, n;
+
+    while( inLen > 0 )
+    {
+        n = ( inLen < kCryptoAESBlockSize ) ? inLen : kCryptoAESBlockSize;
+        for( i = 0; i < n; ++i ) ioX[ i ] ^= inData[ i ];
+        _CryptoGHASHMultiply( ioX, inH );
+        inData += n;
+        inLen  -= n;
+    }
+}
+
+//===========================================================================================================================
+//  _CryptoGCMTag
+//
+//  Closes GHASH with the bit lengths of the AAD and the ciphertext and masks it with E( K, J0 ).
+//===========================================================================================================================
+
+static void _CryptoGCMTag( uint8_t ioX[ kCryptoAESBlockSize ], const uint8_t inH[ kCryptoAESBlockSize ],
+                           AES_ECB_Context *inECB, const uint8_t inJ0[ kCryptoAESBlockSize ],
+                           size_t inAADLen, size_t inLen, uint8_t outTag[ kCryptoGCMTagSize ] )
+{
+    uint8_t     block[ kCryptoAESBlockSize ];
+    uint64_t    aadBits = (uint64_t) inAADLen * 8;
+    uint64_t    bits    = (uint64_t) inLen * 8;
+    int         i;
+
+    for( i = 0; i < 8; ++i )
+    {
+        block[ i ]     = (uint8_t)( aadBits >> ( 56 - ( 8 * i ) ) );
+        block[ 8 + i ] = (uint8_t)( bits    >> ( 56 - ( 8 * i ) ) );
+    }
+    _CryptoGHASHUpdate( ioX, inH, block, sizeof( block ) );
+
+    AES_ECB_Update( inECB, inJ0, kCryptoAESBlockSize, block );
+    for( i = 0; i < kCryptoGCMTagSize; ++i ) outTag[ i ] = ioX[ i ] ^ block[ i ];
+    memzero_secure( block, sizeof( block ) );
+}
+
+//===========================================================================================================================
+//  _CryptoSoftwareGCM
+//
+//  AES-128 GCM with a 96-bit nonce on top of AES_ECB. A decrypt checks the tag over the ciphertext before anything is
+//  written to dst, so src and dst may be the same and a forged message never yields plaintext.
+//===========================================================================================================================
+
+static OSStatus _CryptoSoftwareGCM( CryptoRequest *inRequest )
+{
+    OSStatus            err;
+    AES_ECB_Context     ecb;
+    const uint8_t *     src = (const uint8_t *) inRequest->src;
+    uint8_t *           dst = (uint8_t *) inRequest->dst;
+    size_t              len = inRequest->srcLen;
+    uint8_t             h[ kCryptoAESBlockSize ];
+    uint8_t             j0[ kCryptoAESBlockSize ];
+    uint8_t             counter[ kCryptoAESBlockSize ];
+    uint8_t             block[ kCryptoAESBlockSize ];
+    uint8_t             x[ kCryptoAESBlockSize ];
+    uint8_t             tag[ kCryptoGCMTagSize ];
+    size_t              i, n, k;
+
+    err = AES_ECB_Init( &ecb, kAES_ECB_Mode_Encrypt, inRequest->key );
+    require_noerr( err, exit );
+
+    memset( h, 0, sizeof( h ) );
+    AES_ECB_Update( &ecb, h, sizeof( h ), h );
+
+    memcpy( j0, inRequest->iv, kCryptoGCMNonceSize );
+    j0[ 12 ] = 0; j0[ 13 ] = 0; j0[ 14 ] = 0; j0[ 15 ] = 1;
+
+    memset( x, 0, sizeof( x ) );
+    if( inRequest->aad ) _CryptoGHASHUpdate( x, h, inRequest->aad, inRequest->aadLen );
+    if( !inRequest->encrypt )
+    {
+        _CryptoGHASHUpdate( x, h, src, len );
+        _CryptoGCMTag( x, h, &ecb, j0, inRequest->aadLen, len, tag );
+        if( memcmp_constant_time( tag, inRequest->tag, kCryptoGCMTagSize ) != 0 )
+        {
+            if( dst ) memzero_secure( dst, len );
+            err = kAuthenticationErr;
+            goto exit;
+        }
+    }
+
+    // Counter blocks start at J0 + 1, only the low 32 bits count.
+
+    memcpy( counter, j0, sizeof( counter ) );
+    for( i = 0; i < len; i += n )
+    {
+        for( k = kCryptoAESBlockSize - 1; ( k >= kCryptoGCMNonceSize ) && ( ++counter[ k ] == 0 ); --k ) {}
+        AES_ECB_Update( &ecb, counter, sizeof( counter ), block );
+        n = ( ( len - i ) < kCryptoAESBlockSize ) ? ( len - i ) : kCryptoAESBlockSize;
+        for( k = 0; k < n; ++k ) dst[ i + k ] = src[ i + k ] ^ block[ k ];
+    }
+
+    if( inRequest->encrypt )
+    {
+        _CryptoGHASHUpdate( x, h, dst, len );
+        _CryptoGCMTag( x, h, &ecb, j0, inRequest->aadLen, len, inRequest->tag );
+    }
+
+exit:
+    AES_ECB_Final( &ecb );
+    memzero_secure( h, sizeof( h ) );
+    memzero_secure( block, sizeof( block ) );
+    memzero_secure( x, sizeof( x ) );
+    return( err );
+}
+
+//===========================================================================================================================
+//  _CryptoSoftwareSubmit
+//===========================================================================================================================
+
+static OSStatus _CryptoSoftwareSubmit( const CryptoProvider *inProvider, CryptoRequest *inRequest )
+{
+    OSStatus            err;
+    const uint8_t *     src = (const uint8_t *) inRequest->src;
+    uint8_t *           dst = (uint8_t *) inRequest->dst;
+    size_t              len = inRequest->srcLen;
+
+    UNUSED_PARAMETER( inProvider );
+
+    switch( inRequest->op )
+    {
+        case kCryptoOp_AES_ECB:
+        {
+            AES_ECB_Context     ecb;
+
+            require_action( inRequest->key, exit, err = kParamErr );
+            require_action( ( len % kCryptoAESBlockSize ) == 0, exit, err = kSizeErr );
+            err = AES_ECB_Init( &ecb, inRequest->encrypt ? kAES_ECB_Mode_Encrypt : kAES_ECB_Mode_Decrypt, inRequest->key );
+            require_noerr( err, exit );
+            err = AES_ECB_Update( &ecb, src, len, dst );
+            AES_ECB_Final( &ecb );
+            require_noerr( err, exit );
+            break;
+        }
+
+        case kCryptoOp_AES_CBC:
+        {
+            Aes     aes;
+
+            require_action( inRequest->key, exit, err = kParamErr );
+            require_action( ( len % kCryptoAESBlockSize ) == 0, exit, err = kSizeErr );
+            AesSetKey( &aes, inRequest->key, kCryptoAESKeySize, inRequest->iv,
+                       inRequest->encrypt ? AES_ENCRYPTION : AES_DECRYPTION );
+            if( inRequest->encrypt ) AesCbcEncrypt( &aes, dst, src, (word32) len );
+            else                     AesCbcDecrypt( &aes, dst, src, (word32) len );
+            memcpy( inRequest->iv, aes.reg, kCryptoAESBlockSize );
+            memzero_secure( &aes, sizeof( aes ) );
+            break;
+        }
+
+        case kCryptoOp_AES_CTR:
+        {
+            AES_CTR_Context     ctr;
+
+            require_action( inRequest->key, exit, err = kParamErr );
+            err = AES_CTR_Init( &ctr, inRequest->key, inRequest->iv );
+            require_noerr( err, exit );
+            err = AES_CTR_Update( &ctr, src, len, dst );
+            memcpy( inRequest->iv, ctr.ctr, kCryptoAESBlockSize );
+            AES_CTR_Final( &ctr );
+            require_noerr( err, exit );
+            break;
+        }
+
+        case kCryptoOp_AES_GCM:
+            require_action( inRequest->key, exit, err = kParamErr );
+            err = _CryptoSoftwareGCM( inRequest );
+            require_noerr_quiet( err, exit );
+            break;
+
+        case kCryptoOp_SHA1:
+        {
+            SHA_CTX_compat      sha1;
+
+            SHA1_Init_compat( &sha1 );
+            SHA1_Update_compat( &sha1, src, len );
+            SHA1_Final_compat( dst, &sha1 );
+            break;
+        }
+
+        case kCryptoOp_SHA256:
+        {
+            SHA256Context       sha256;
+
+            require_action( SHA256Reset( &sha256 ) == shaSuccess, exit, err = kUnknownErr );
+            require_action( SHA256Input( &sha256, src, (unsigned int) len ) == shaSuccess, exit, err = kUnknownErr );
+            require_action( SHA256Result( &sha256, dst ) == shaSuccess, exit, err = kUnknownErr );
+            break;
+        }
+
+        case kCryptoOp_Random:
+            err = MicoRandomNumberRead( dst, (int) len );
+            require_noerr( err, exit );
+            break;
+
+        default:
+            err = kUnsupportedErr;
+            goto exit;
+    }
+    err = kNoErr;
+
+exit:
+    return err;
+}
@@ -0,0 +1,137 @@
+/**
+  ******************************************************************************
+  * @file    CryptoProvider.h
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This header contains the runtime crypto provider interface used to
+  *          offload AES, SHA and RNG operations to a hardware engine with a
+  *          software fallback.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#ifndef __CryptoProvider_h__
+#define __CryptoProvider_h__
+
+#include "Common.h"
+#include "MICORTOS.h"
+
+#ifdef  __cplusplus
+    extern "C" {
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @group      Crypto Provider API
+    @abstract   Dispatches crypto requests to the best registered provider.
+    @discussion
+
+    A provider is a table of capabilities plus a submit function. Platforms with a crypto engine register a provider
+    during system init with CryptoProviderRegister. Every request falls back to the built-in software provider
+    (AESUtils, SHAUtils, MicoRandomNumberRead) when no registered provider supports the operation, when the payload is
+    shorter than the provider's minimum length, or when the provider is busy.
+
+    A provider's submit function either completes the request before returning (returns kNoErr or an error), or
+    starts it (e.g. by programming a DMA transfer) and returns kAsyncNoErr. An asynchronous provider must call
+    CryptoRequestComplete exactly once when the operation is finished. CryptoRequestComplete must be called from a
+    task context, not from an interrupt handler. A provider that is busy or cannot handle a request returns
+    kNoResourcesErr or kUnsupportedErr and the request is done in software instead.
+
+    Call CryptoSubmit to start a request and receive the result through the request's completion callback.
+    CryptoSubmit returns kAsyncNoErr if the completion is still to come, anything else means the completion has
+    already been called with that status. Call CryptoPerform to run a request and block until it is done.
+
+    A GCM decrypt whose tag does not match fails with kAuthenticationErr and leaves dst zeroed, no unauthenticated
+    plaintext is ever returned.
+*/
+
+typedef enum
+{
+    kCryptoOp_AES_ECB   = 0,    //! AES-128 ECB. srcLen must be a multiple of 16.
+    kCryptoOp_AES_CBC   = 1,    //! AES-128 CBC. srcLen must be a multiple of 16. iv is updated for chaining.
+    kCryptoOp_AES_CTR   = 2,    //! AES-128 CTR. iv is the big endian counter block and is updated for chaining.
+    kCryptoOp_AES_GCM   = 3,    //! AES-128 GCM. iv holds the 12 byte nonce. tag is output on encrypt, input on decrypt.
+    kCryptoOp_SHA1      = 4,    //! SHA-1 of src. dst receives 20 bytes and must not be NULL.
+    kCryptoOp_SHA256    = 5,    //! SHA-256 of src. dst receives 32 bytes and must not be NULL.
+    kCryptoOp_Random    = 6,    //! Fill dst with srcLen random bytes. src is ignored.
+    kCryptoOp_Count
+
+}   CryptoOp;
+
+#define CryptoOpMask( OP )          ( 1U << (OP) )
+#define kCryptoOpMask_AES           ( CryptoOpMask( kCryptoOp_AES_ECB ) | CryptoOpMask( kCryptoOp_AES_CBC ) | \
+                                      CryptoOpMask( kCryptoOp_AES_CTR ) | CryptoOpMask( kCryptoOp_AES_GCM ) )
+#define kCryptoOpMask_Hash          ( CryptoOpMask( kCryptoOp_SHA1 ) | CryptoOpMask( kCryptoOp_SHA256 ) )
+
+#define kCryptoAESKeySize           16
+#define kCryptoAESBlockSize         16
+#define kCryptoGCMNonceSize         12
+#define kCryptoGCMTagSize           16
+#define kCryptoSHA1DigestSize       20
+#define kCryptoSHA256DigestSize     32
+
+#define kCryptoProviderMax          4
+
+typedef struct CryptoRequest    CryptoRequest;
+typedef struct CryptoProvider   CryptoProvider;
+
+typedef void ( *CryptoCompletionFunc )( CryptoRequest *inRequest, OSStatus inStatus, void *inContext );
+
+struct CryptoRequest
+{
+    CryptoOp                op;                             //! Operation to perform.
+    Boolean                 encrypt;                        //! true=encrypt, false=decrypt. Ignored for hash/RNG.
+    const uint8_t *         key;                            //! 128-bit AES key.
+    uint8_t                 iv[ kCryptoAESBlockSize ];      //! CBC IV, CTR counter block or GCM nonce.
+    const uint8_t *         aad;                            //! GCM additional authenticated data (may be NULL).
+    size_t                  aadLen;
+    const void *            src;                            //! Input data. May be the same as dst for AES.
+    size_t                  srcLen;
+    void *                  dst;                            //! Output data, digest or random bytes.
+    uint8_t                 tag[ kCryptoGCMTagSize ];       //! GCM authentication tag.
+
+    CryptoCompletionFunc    completion;                     //! Called when the request finishes (may be NULL).
+    void *                  context;                        //! Passed to the completion function.
+
+    // PRIVATE: don't touch any of these fields.
+    OSStatus                status;
+    const CryptoProvider *  provider;
+    mico_semaphore_t        doneSem;
+};
+
+struct CryptoProvider
+{
+    const char *            name;                           //! Name for logging.
+    uint32_t                ops;                            //! Supported operations (CryptoOpMask bits).
+    uint8_t                 priority;                       //! Higher is preferred. Software provider is 0.
+    size_t                  minLength;                      //! Payloads shorter than this go to a lower provider.
+    OSStatus             ( *submit )( const CryptoProvider *inProvider, CryptoRequest *inRequest );
+    void *                  context;                        //! Provider private data.
+};
+
+extern const CryptoProvider     kCryptoSoftwareProvider;
+
+OSStatus    CryptoProviderRegister( const CryptoProvider *inProvider );
+OSStatus    CryptoProviderDeregister( const CryptoProvider *inProvider );
+const CryptoProvider *  CryptoProviderSelect( CryptoOp inOp, size_t inLen );
+
+OSStatus    CryptoSubmit( CryptoRequest *inRequest );
+OSStatus    CryptoPerform( CryptoRequest *inRequest );
+void        CryptoRequestComplete( CryptoRequest *inRequest, OSStatus inStatus );
+
+#ifdef  __cplusplus
+    }
+#endif
+
+#endif // __CryptoProvider_h__
+
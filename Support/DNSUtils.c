@@ -0,0 +1,969 @@
+/**
+  ******************************************************************************
+  * @file    DNSUtils.c
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This file provide the asynchronous DNS resolver with a TTL cache.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#include "DNSUtils.h"
+
+#include "MICO.h"
+#include "RandomUtils.h"
+#include "SocketUtils.h"
+#include "StringUtils.h"
+
+#define dns_log(M, ...) custom_log("DNS", M, ##__VA_ARGS__)
+#define dns_log_trace() custom_log_trace("DNS")
+
+#define kDNSServerPort              53
+#define kDNSHeaderLen               12
+#define kDNSMaxQueryLen             ( kDNSHeaderLen + 1 + kDNSMaxHostnameLen + 4 )
+#define kDNSMaxResponseLen          512
+#define kDNSMaxServers              2
+#define kDNSRequestQueueLen         8
+#define kDNSIdleTimeout             ( 60 * 1000 )
+
+#define kDNSFlagResponse            0x8000
+#define kDNSFlagOpcodeMask          0x7800
+#define kDNSFlagRecursionDesired    0x0100
+#define kDNSRCodeMask               0x000F
+#define kDNSRCodeNoError            0
+#define kDNSRCodeNameError          3
+
+#define kDNSTypeA                   1
+#define kDNSClassIN                 1
+
+#define ToLowerASCII( C )   ( ( ( (C) >= 'A' ) && ( (C) <= 'Z' ) ) ? ( (C) + ( 'a' - 'A' ) ) : (C) )
+
+#if 0
+#pragma mark == Structures ==
+#endif
+
+typedef enum
+{
+    kDNSStateIdle       = 0,
+    kDNSStateStarting   = 1,
+    kDNSStateRunning    = 2
+
+}   DNSResolverState;
+
+typedef struct
+{
+    bool            valid;
+    bool            negative;                   // The name does not exist or has no A record.
+    char            hostname[ kDNSMaxHostnameLen ];
+    uint32_t        ip;
+    uint32_t        storeTime;
+    uint32_t        ttl;                        // ms
+    uint32_t        lastUsed;
+
+}   DNSCacheEntry;
+
+typedef struct
+{
+    DNSResolveCallback  callback;
+    void *              context;
+
+}   DNSWaiter;
+
+// Message passed from DNSResolveAsync to the resolver thread.
+typedef struct
+{
+    char                hostname[ kDNSMaxHostnameLen ];
+    DNSResolveCallback  callback;
+    void *              context;
+
+}   DNSRequest;
+
+typedef struct
+{
+    bool            inUse;
+    char            hostname[ kDNSMaxHostnameLen ];
+    uint16_t        id;
+    uint32_t        startTime;
+    uint32_t        nextSendTime;
+    uint32_t        interval;
+    int             retries;
+    uint32_t        servers[ kDNSMaxServers ];
+    int             serverCount;
+    uint8_t         failedServers;              // Bit per server that answered SERVFAIL or REFUSED.
+    uint8_t         packet[ kDNSMaxQueryLen ];
+    size_t          packetLen;
+    DNSWaiter       waiters[ DNS_RESOLVER_MAX_WAITERS ];
+    int             waiterCount;
+
+}   DNSQuery;
+
+typedef struct
+{
+    volatile DNSResolverState   state;
+    mico_mutex_t                mutex;          // Protects cache and stats, everything else belongs to the thread.
+    mico_queue_t                requestQueue;
+    int                         eventFd;
+    int                         sock;
+    RandomContext               random;
+    DNSQuery                    queries[ DNS_RESOLVER_MAX_QUERIES ];
+    DNSCacheEntry               cache[ DNS_CACHE_SIZE ];
+    uint8_t                     response[ kDNSMaxResponseLen ];
+    DNSResolverStats            stats;
+    uint32_t                    resolveTimeTotal;
+    uint32_t                    resolveCount;
+
+}   DNSResolver;
+
+static DNSResolver      gDNS = { .state = kDNSStateIdle, .eventFd = -1, .sock = -1 };
+
+static void _DNSResolverThread( void *inArg );
+
+#if 0
+#pragma mark == Helpers ==
+#endif
+
+//===========================================================================================================================
+//  _DNSIsIPv4Literal
+//===========================================================================================================================
+
+static bool _DNSIsIPv4Literal( const char *inHostname )
+{
+    const char *        ptr;
+    int                 dots = 0;
+    int                 digits = 0;
+
+    for( ptr = inHostname; *ptr != '\0'; ++ptr )
+    {
+        if( *ptr == '.' )
+        {
+            if( digits == 0 ) return( false );
+            ++dots;
+            digits = 0;
+        }
+        else if( ( *ptr >= '0' ) && ( *ptr <= '9' ) )
+        {
+            if( ++digits > 3 ) return( false );
+        }
+        else
+        {
+            return( false );
+        }
+    }
+    return( ( dots == 3 ) && ( digits > 0 ) );
+}
+
+//===========================================================================================================================
+//  _DNSBuildQuery
+//
+//  Standard recursive query for the A record of inHostname. Empty labels are rejected.
+//===========================================================================================================================
+
+static OSStatus _DNSBuildQuery( uint16_t inID, const char *inHostname, uint8_t *outPacket, size_t *outLen )
+{
+    OSStatus            err = kNoErr;
+    uint8_t *           dst;
+    const char *        label;
+    const char *        ptr;
+    size_t              labelLen;
+
+    memset( outPacket, 0, kDNSHeaderLen );
+    outPacket[ 0 ] = (uint8_t)( inID >> 8 );
+    outPacket[ 1 ] = (uint8_t)( inID & 0xFF );
+    outPacket[ 2 ] = (uint8_t)( kDNSFlagRecursionDesired >> 8 );
+    outPacket[ 5 ] = 1;                                         // QDCOUNT
+
+    dst = outPacket + kDNSHeaderLen;
+    label = inHostname;
+    while( *label != '\0' )
+    {
+        for( ptr = label; ( *ptr != '\0' ) && ( *ptr != '.' ); ++ptr ) {}
+        labelLen = (size_t)( ptr - label );
+        require_action_quiet( ( labelLen > 0 ) && ( labelLen <= 63 ), exit, err = kNameErr );
+
+        *dst++ = (uint8_t) labelLen;
+        memcpy( dst, label, labelLen );
+        dst += labelLen;
+
+        label = ( *ptr == '.' ) ? ( ptr + 1 ) : ptr;
+    }
+    require_action_quiet( dst > ( outPacket + kDNSHeaderLen ), exit, err = kNameErr );
+    *dst++ = 0;
+
+    *dst++ = 0; *dst++ = kDNSTypeA;
+    *dst++ = 0; *dst++ = kDNSClassIN;
+    *outLen = (size_t)( dst - outPacket );
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  _DNSMatchName
+//
+//  Compares an uncompressed name in a packet with inHostname, case-insensitive. Returns a pointer past the name or NULL.
+//===========================================================================================================================
+
+static const uint8_t * _DNSMatchName( const uint8_t *inSrc, const uint8_t *inEnd, const char *inHostname )
+{
+    const char *        host = inHostname;
+    size_t              labelLen;
+    size_t              i;
+
+    while( inSrc < inEnd )
+    {
+        labelLen = *inSrc++;
+        if( labelLen == 0 )
+        {
+            return( ( *host == '\0' ) ? inSrc : NULL );
+        }
+        if( ( labelLen > 63 ) || ( (size_t)( inEnd - inSrc ) < labelLen ) ) return( NULL );
+
+        if( host != inHostname )
+        {
+            if( *host != '.' ) return( NULL );
+            ++host;
+        }
+        for( i = 0; i < labelLen; ++i )
+        {
+            if( ( host[ i ] == '\0' ) || ( ToLowerASCII( inSrc[ i ] ) != ToLowerASCII( (uint8_t) host[ i ] ) ) ) return( NULL );
+        }
+        if( ( host[ labelLen ] != '\0' ) && ( host[ labelLen ] != '.' ) ) return( NULL );
+
+        host += labelLen;
+        inSrc += labelLen;
+    }
+    return( NULL );
+}
+
+//===========================================================================================================================
+//  _DNSSkipName
+//
+//  Skips a possibly compressed name. Returns a pointer past the name or NULL if it runs past inEnd.
+//===========================================================================================================================
+
+static const uint8_t * _DNSSkipName( const uint8_t *inSrc, const uint8_t *inEnd )
+{
+    size_t              labelLen;
+
+    while( inSrc < inEnd )
+    {
+        labelLen = *inSrc;
+        if( labelLen == 0 )                 return( inSrc + 1 );
+        if( ( labelLen & 0xC0 ) == 0xC0 )   return( ( ( inEnd - inSrc ) >= 2 ) ? ( inSrc + 2 ) : NULL );
+        if( labelLen > 63 )                 return( NULL );
+        inSrc += 1 + labelLen;
+    }
+    return( NULL );
+}
+
+#if 0
+#pragma mark == Cache ==
+#endif
+
+//===========================================================================================================================
+//  _DNSCacheFind
+//
+//  Must be called with the mutex held. A fresh entry sets outStatus to kNoErr or kNotFoundErr (negative entry). If
+//  inAllowStale is set, a positive entry that expired no more than DNS_CACHE_STALE_TTL ago is returned as well.
+//===========================================================================================================================
+
+static bool _DNSCacheFind( const char *inHostname, bool inAllowStale, OSStatus *outStatus, uint32_t *outIP )
+{
+    DNSCacheEntry *     entry;
+    uint32_t            now = mico_get_time();
+    uint32_t            age;
+    int                 i;
+
+    for( i = 0; i < DNS_CACHE_SIZE; ++i )
+    {
+        entry = &gDNS.cache[ i ];
+        if( !entry->valid || ( strnicmp( entry->hostname, inHostname, kDNSMaxHostnameLen ) != 0 ) ) continue;
+
+        age = now - entry->storeTime;
+        if( age < entry->ttl )
+        {
+            entry->lastUsed = now;
+            *outStatus = entry->negative ? kNotFoundErr : kNoErr;
+            *outIP = entry->ip;
+            return( true );
+        }
+        if( inAllowStale && !entry->negative && ( ( age - entry->ttl ) <= ( DNS_CACHE_STALE_TTL * 1000UL ) ) )
+        {
+            entry->lastUsed = now;
+            *outStatus = kNoErr;
+            *outIP = entry->ip;
+            return( true );
+        }
+        return( false );
+    }
+    return( false );
+}
+
+//===========================================================================================================================
+//  _DNSCacheStore
+//
+//  Replaces the entry for the name, otherwise uses a free entry or evicts the least recently used one.
+//===========================================================================================================================
+
+static void _DNSCacheStore( const char *inHostname, bool inNegative, uint32_t inIP, uint32_t inTTL )
+{
+    DNSCacheEntry *     entry = NULL;
+    uint32_t            now = mico_get_time();
+    int                 i;
+
+    if( !inNegative )
+    {
+        if( inTTL < DNS_CACHE_MIN_TTL ) inTTL = DNS_CACHE_MIN_TTL;
+        if( inTTL > DNS_CACHE_MAX_TTL ) inTTL = DNS_CACHE_MAX_TTL;
+    }
+
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    for( i = 0; i < DNS_CACHE_SIZE; ++i )
+    {
+        if( gDNS.cache[ i ].valid && ( strnicmp( gDNS.cache[ i ].hostname, inHostname, kDNSMaxHostnameLen ) == 0 ) )
+        {
+            entry = &gDNS.cache[ i ];
+            break;
+        }
+    }
+    for( i = 0; ( entry == NULL ) && ( i < DNS_CACHE_SIZE ); ++i )
+    {
+        if( !gDNS.cache[ i ].valid ) entry = &gDNS.cache[ i ];
+    }
+    if( entry == NULL )
+    {
+        entry = &gDNS.cache[ 0 ];
+        for( i = 1; i < DNS_CACHE_SIZE; ++i )
+        {
+            if( ( now - gDNS.cache[ i ].lastUsed ) > ( now - entry->lastUsed ) ) entry = &gDNS.cache[ i ];
+        }
+    }
+
+    // A failed lookup must not throw away an address that can still be served stale.
+    if( !( inNegative && entry->valid && !entry->negative ) )
+    {
+        entry->valid     = true;
+        entry->negative  = inNegative;
+        strncpy( entry->hostname, inHostname, kDNSMaxHostnameLen - 1 );
+        entry->hostname[ kDNSMaxHostnameLen - 1 ] = '\0';
+        entry->ip        = inIP;
+        entry->storeTime = now;
+        entry->ttl       = inTTL * 1000UL;
+        entry->lastUsed  = now;
+    }
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+}
+
+//===========================================================================================================================
+//  DNSCacheLookup
+//===========================================================================================================================
+
+bool DNSCacheLookup( const char *inHostname, uint32_t *outIP )
+{
+    OSStatus            status = kNotFoundErr;
+    bool                found = false;
+
+    if( gDNS.state != kDNSStateRunning ) return( false );
+
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    found = _DNSCacheFind( inHostname, false, &status, outIP );
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+
+    return( found && ( status == kNoErr ) );
+}
+
+//===========================================================================================================================
+//  DNSCacheRemove
+//===========================================================================================================================
+
+void DNSCacheRemove( const char *inHostname )
+{
+    int                 i;
+
+    if( gDNS.state != kDNSStateRunning ) return;
+
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    for( i = 0; i < DNS_CACHE_SIZE; ++i )
+    {
+        if( gDNS.cache[ i ].valid && ( strnicmp( gDNS.cache[ i ].hostname, inHostname, kDNSMaxHostnameLen ) == 0 ) )
+        {
+            memset( &gDNS.cache[ i ], 0, sizeof( DNSCacheEntry ) );
+        }
+    }
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+}
+
+//===========================================================================================================================
+//  DNSCacheFlush
+//===========================================================================================================================
+
+void DNSCacheFlush( void )
+{
+    if( gDNS.state != kDNSStateRunning ) return;
+
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    memset( gDNS.cache, 0, sizeof( gDNS.cache ) );
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+}
+
+//===========================================================================================================================
+//  DNSResolverGetStats
+//===========================================================================================================================
+
+void DNSResolverGetStats( DNSResolverStats *outStats )
+{
+    if( gDNS.state != kDNSStateRunning )
+    {
+        memset( outStats, 0, sizeof( DNSResolverStats ) );
+        return;
+    }
+
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    memcpy( outStats, &gDNS.stats, sizeof( DNSResolverStats ) );
+    outStats->resolveTimeAvg = gDNS.resolveCount ? ( gDNS.resolveTimeTotal / gDNS.resolveCount ) : 0;
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+}
+
+#if 0
+#pragma mark == Resolver ==
+#endif
+
+//===========================================================================================================================
+//  _DNSResolverStart
+//
+//  Starts the resolver thread on first use. Threads that call in while it is being started wait for the result.
+//===========================================================================================================================
+
+static OSStatus _DNSResolverStart( void )
+{
+    OSStatus            err = kNoErr;
+    bool                doStart = false;
+    struct sockaddr_t   addr;
+
+    mico_rtos_suspend_all_thread();
+    if( gDNS.state == kDNSStateIdle )
+    {
+        gDNS.state = kDNSStateStarting;
+        doStart = true;
+    }
+    mico_rtos_resume_all_thread();
+
+    if( !doStart )
+    {
+        while( gDNS.state == kDNSStateStarting ) mico_thread_msleep( 10 );
+        return( ( gDNS.state == kDNSStateRunning ) ? kNoErr : kNotPreparedErr );
+    }
+
+    err = mico_rtos_init_mutex( &gDNS.mutex );
+    require_noerr( err, exit );
+
+    err = mico_rtos_init_queue( &gDNS.requestQueue, "DNS requests", sizeof( DNSRequest ), kDNSRequestQueueLen );
+    require_noerr( err, exit );
+
+    gDNS.eventFd = mico_create_event_fd( gDNS.requestQueue );
+    require_action( gDNS.eventFd >= 0, exit, err = kNoResourcesErr );
+
+    err = RandomContextInit( &gDNS.random );
+    require_noerr( err, exit );
+
+    gDNS.sock = socket( AF_INET, SOCK_DGRM, IPPROTO_UDP );
+    require_action( IsValidSocket( gDNS.sock ), exit, err = kNoResourcesErr );
+
+    // Random source port in the dynamic range, together with the random ID this makes answers hard to spoof.
+    addr.s_ip = INADDR_ANY;
+    addr.s_port = (uint16_t)( 49152 + ( RandomContextUInt32( &gDNS.random ) % 16384 ) );
+    err = bind( gDNS.sock, &addr, sizeof( addr ) );
+    require_noerr( err, exit );
+
+    err = mico_rtos_create_thread( NULL, MICO_APPLICATION_PRIORITY, "DNS Resolver", _DNSResolverThread,
+                                   DNS_RESOLVER_STACK_SIZE, NULL );
+    require_noerr( err, exit );
+
+    gDNS.state = kDNSStateRunning;
+
+exit:
+    if( err )
+    {
+        dns_log( "Start resolver failed, err = %d", err );
+        SocketClose( &gDNS.sock );
+        if( gDNS.eventFd >= 0 )     { mico_delete_event_fd( gDNS.eventFd ); gDNS.eventFd = -1; }
+        if( gDNS.requestQueue )     { mico_rtos_deinit_queue( &gDNS.requestQueue ); gDNS.requestQueue = NULL; }
+        if( gDNS.mutex )            { mico_rtos_deinit_mutex( &gDNS.mutex ); gDNS.mutex = NULL; }
+        RandomContextFree( &gDNS.random );
+        gDNS.state = kDNSStateIdle;
+    }
+    return( err );
+}
+
+//===========================================================================================================================
+//  _DNSCompleteQuery
+//
+//  Caches the result, reports it to every waiter and frees the query.
+//===========================================================================================================================
+
+static void _DNSCompleteQuery( DNSQuery *inQuery, OSStatus inStatus, uint32_t inIP, uint32_t inTTL )
+{
+    uint32_t            elapsed = mico_get_time() - inQuery->startTime;
+    char                ipstr[ 16 ];
+    int                 i;
+
+    if( inStatus == kNoErr )
+    {
+        _DNSCacheStore( inQuery->hostname, false, inIP, inTTL );
+        dns_log( "%s is %s, ttl %u s, %u ms", inQuery->hostname, inet_ntoa( ipstr, inIP ), inTTL, elapsed );
+    }
+    else if( inStatus == kNotFoundErr )
+    {
+        _DNSCacheStore( inQuery->hostname, true, 0, DNS_CACHE_NEGATIVE_TTL );
+    }
+
+    if( inStatus == kTimeoutErr )
+    {
+        // Serve the last known address rather than nothing while the DNS server is unreachable.
+        mico_rtos_lock_mutex( &gDNS.mutex );
+        if( _DNSCacheFind( inQuery->hostname, true, &inStatus, &inIP ) ) gDNS.stats.staleHitCount++;
+        else                                                              gDNS.stats.timeoutCount++;
+        mico_rtos_unlock_mutex( &gDNS.mutex );
+        dns_log( "%s timed out%s", inQuery->hostname, ( inStatus == kNoErr ) ? ", using stale address" : "" );
+    }
+    else
+    {
+        mico_rtos_lock_mutex( &gDNS.mutex );
+        if( inStatus == kNoErr )
+        {
+            gDNS.resolveCount++;
+            gDNS.resolveTimeTotal += elapsed;
+            if( elapsed > gDNS.stats.resolveTimeMax ) gDNS.stats.resolveTimeMax = elapsed;
+        }
+        else
+        {
+            gDNS.stats.failureCount++;
+        }
+        mico_rtos_unlock_mutex( &gDNS.mutex );
+    }
+
+    for( i = 0; i < inQuery->waiterCount; ++i )
+    {
+        inQuery->waiters[ i ].callback( inQuery->hostname, inStatus, inIP, inQuery->waiters[ i ].context );
+    }
+    memset( inQuery, 0, sizeof( DNSQuery ) );
+}
+
+//===========================================================================================================================
+//  _DNSSendQuery
+//
+//  Sends the query to every server that has not failed yet, all at once.
+//===========================================================================================================================
+
+static void _DNSSendQuery( DNSQuery *inQuery )
+{
+    struct sockaddr_t   addr;
+    int                 i;
+
+    for( i = 0; i < inQuery->serverCount; ++i )
+    {
+        if( inQuery->failedServers & ( 1 << i ) ) continue;
+
+        addr.s_ip = inQuery->servers[ i ];
+        addr.s_port = kDNSServerPort;
+        sendto( gDNS.sock, inQuery->packet, inQuery->packetLen, 0, &addr, sizeof( addr ) );
+
+        mico_rtos_lock_mutex( &gDNS.mutex );
+        gDNS.stats.querySentCount++;
+        mico_rtos_unlock_mutex( &gDNS.mutex );
+    }
+}
+
+//===========================================================================================================================
+//  _DNSStartQuery
+//
+//  Attaches the request to the query for the same name, or starts a new query.
+//===========================================================================================================================
+
+static void _DNSStartQuery( const DNSRequest *inRequest )
+{
+    OSStatus            err;
+    DNSQuery *          query = NULL;
+    IPStatusTypedef     para;
+    OSStatus            status;
+    uint32_t            ip = 0;
+    bool                found;
+    char                ipstr[ 16 ];
+    int                 i;
+
+    // The answer may have arrived since DNSResolveAsync checked the cache.
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    found = _DNSCacheFind( inRequest->hostname, false, &status, &ip );
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+    if( found )
+    {
+        inRequest->callback( inRequest->hostname, status, ip, inRequest->context );
+        return;
+    }
+
+    for( i = 0; i < DNS_RESOLVER_MAX_QUERIES; ++i )
+    {
+        if( gDNS.queries[ i ].inUse && ( strnicmp( gDNS.queries[ i ].hostname, inRequest->hostname, kDNSMaxHostnameLen ) == 0 ) )
+        {
+            query = &gDNS.queries[ i ];
+            break;
+        }
+    }
+    if( query )
+    {
+        require_action_quiet( query->waiterCount < DNS_RESOLVER_MAX_WAITERS, exit, err = kNoResourcesErr );
+        query->waiters[ query->waiterCount ].callback = inRequest->callback;
+        query->waiters[ query->waiterCount ].context  = inRequest->context;
+        query->waiterCount++;
+
+        mico_rtos_lock_mutex( &gDNS.mutex );
+        gDNS.stats.coalescedCount++;
+        mico_rtos_unlock_mutex( &gDNS.mutex );
+        return;
+    }
+
+    for( i = 0; i < DNS_RESOLVER_MAX_QUERIES; ++i )
+    {
+        if( !gDNS.queries[ i ].inUse )
+        {
+            query = &gDNS.queries[ i ];
+            break;
+        }
+    }
+    require_action_quiet( query, exit, err = kNoResourcesErr );
+
+    memset( query, 0, sizeof( DNSQuery ) );
+    strncpy( query->hostname, inRequest->hostname, kDNSMaxHostnameLen - 1 );
+    query->waiters[ 0 ].callback = inRequest->callback;
+    query->waiters[ 0 ].context  = inRequest->context;
+    query->waiterCount = 1;
+    query->inUse = true;
+    query->startTime = mico_get_time();
+
+    // IDs only have to be unique among the queries in flight.
+    do
+    {
+        query->id = (uint16_t) RandomContextUInt32( &gDNS.random );
+        for( i = 0; i < DNS_RESOLVER_MAX_QUERIES; ++i )
+        {
+            if( gDNS.queries[ i ].inUse && ( &gDNS.queries[ i ] != query ) && ( gDNS.queries[ i ].id == query->id ) ) break;
+        }
+    }   while( i < DNS_RESOLVER_MAX_QUERIES );
+
+    err = _DNSBuildQuery( query->id, query->hostname, query->packet, &query->packetLen );
+    if( err )
+    {
+        _DNSCompleteQuery( query, err, 0, 0 );
+        return;
+    }
+
+    micoWlanGetIPStatus( &para, Station );
+    ip = inet_addr( para.dns );
+    if( ( ip != 0 ) && ( ip != 0xFFFFFFFF ) ) query->servers[ query->serverCount++ ] = ip;
+#if( defined( DNS_RESOLVER_SECONDARY_SERVER ) )
+    ip = inet_addr( DNS_RESOLVER_SECONDARY_SERVER );
+    if( ( query->serverCount == 0 ) || ( ip != query->servers[ 0 ] ) ) query->servers[ query->serverCount++ ] = ip;
+#endif
+
+    if( query->serverCount == 0 )
+    {
+        // No server address from DHCP or the static configuration, let the network stack find one.
+        err = gethostbyname( query->hostname, (uint8_t *) ipstr, sizeof( ipstr ) );
+        _DNSCompleteQuery( query, err ? kTimeoutErr : kNoErr, err ? 0 : inet_addr( ipstr ), DNS_CACHE_MIN_TTL );
+        return;
+    }
+
+    query->interval = DNS_RESOLVER_RETRY_INTERVAL;
+    query->nextSendTime = query->startTime + query->interval;
+    _DNSSendQuery( query );
+    return;
+
+exit:
+    dns_log( "Resolve %s failed, err = %d", inRequest->hostname, err );
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    gDNS.stats.failureCount++;
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+    inRequest->callback( inRequest->hostname, err, 0, inRequest->context );
+}
+
+//===========================================================================================================================
+//  _DNSProcessResponse
+//===========================================================================================================================
+
+static void _DNSProcessResponse( const uint8_t *inPacket, size_t inLen, const struct sockaddr_t *inFrom )
+{
+    const uint8_t *     src = inPacket + kDNSHeaderLen;
+    const uint8_t *     end = inPacket + inLen;
+    DNSQuery *          query = NULL;
+    uint16_t            id, flags, qdCount, anCount, type, rrClass, rdLen;
+    uint32_t            ttl, minTTL = 0xFFFFFFFF;
+    int                 serverIndex;
+    int                 i;
+
+    require_quiet( inLen >= kDNSHeaderLen, exit );
+    require_quiet( inFrom->s_port == kDNSServerPort, exit );
+
+    id      = ReadBig16( inPacket );
+    flags   = ReadBig16( inPacket + 2 );
+    qdCount = ReadBig16( inPacket + 4 );
+    anCount = ReadBig16( inPacket + 6 );
+
+    for( i = 0; i < DNS_RESOLVER_MAX_QUERIES; ++i )
+    {
+        if( gDNS.queries[ i ].inUse && ( gDNS.queries[ i ].id == id ) )
+        {
+            query = &gDNS.queries[ i ];
+            break;
+        }
+    }
+    require_quiet( query, exit );
+
+    for( serverIndex = 0; serverIndex < query->serverCount; ++serverIndex )
+    {
+        if( query->servers[ serverIndex ] == inFrom->s_ip ) break;
+    }
+    require_quiet( serverIndex < query->serverCount, exit );
+    require_quiet( ( flags & kDNSFlagResponse ) && ( ( flags & kDNSFlagOpcodeMask ) == 0 ), exit );
+
+    // The question must be echoed back unchanged.
+    require_quiet( qdCount == 1, exit );
+    src = _DNSMatchName( src, end, query->hostname );
+    require_quiet( src && ( ( end - src ) >= 4 ), exit );
+    require_quiet( ( ReadBig16( src ) == kDNSTypeA ) && ( ReadBig16( src + 2 ) == kDNSClassIN ), exit );
+    src += 4;
+
+    if( ( flags & kDNSRCodeMask ) == kDNSRCodeNameError )
+    {
+        _DNSCompleteQuery( query, kNotFoundErr, 0, 0 );
+        goto exit;
+    }
+    if( ( flags & kDNSRCodeMask ) != kDNSRCodeNoError )
+    {
+        // Another server may still answer.
+        query->failedServers |= ( 1 << serverIndex );
+        if( query->failedServers == ( ( 1 << query->serverCount ) - 1 ) ) _DNSCompleteQuery( query, kResponseErr, 0, 0 );
+        goto exit;
+    }
+
+    // Answers for a CNAME chain come first, the address is good for the shortest TTL on the way.
+    for( i = 0; i < anCount; ++i )
+    {
+        src = _DNSSkipName( src, end );
+        require_quiet( src && ( ( end - src ) >= 10 ), exit );
+        type  = ReadBig16( src );
+        rrClass = ReadBig16( src + 2 );
+        ttl   = ReadBig32( src + 4 );
+        rdLen = ReadBig16( src + 8 );
+        src += 10;
+        require_quiet( ( end - src ) >= rdLen, exit );
+
+        if( ttl < minTTL ) minTTL = ttl;
+        if( ( type == kDNSTypeA ) && ( ( rrClass & 0x7FFF ) == kDNSClassIN ) && ( rdLen == 4 ) )
+        {
+            _DNSCompleteQuery( query, kNoErr, ReadBig32( src ), minTTL );
+            goto exit;
+        }
+        src += rdLen;
+    }
+
+    // The name exists but has no address.
+    _DNSCompleteQuery( query, kNotFoundErr, 0, 0 );
+
+exit:
+    return;
+}
+
+//===========================================================================================================================
+//  _DNSCheckTimeouts
+//
+//  Retransmits or times out queries that are due and returns the ms until the next one is due.
+//===========================================================================================================================
+
+static uint32_t _DNSCheckTimeouts( void )
+{
+    uint32_t            now = mico_get_time();
+    uint32_t            wait = kDNSIdleTimeout;
+    DNSQuery *          query;
+    int                 i;
+
+    for( i = 0; i < DNS_RESOLVER_MAX_QUERIES; ++i )
+    {
+        query = &gDNS.queries[ i ];
+        if( !query->inUse ) continue;
+
+        if( (int32_t)( now - query->nextSendTime ) >= 0 )
+        {
+            if( query->retries >= DNS_RESOLVER_MAX_RETRIES )
+            {
+                _DNSCompleteQuery( query, kTimeoutErr, 0, 0 );
+                continue;
+            }
+            query->retries++;
+            query->interval *= 2;
+            query->nextSendTime = now + query->interval;
+            _DNSSendQuery( query );
+        }
+        if( ( query->nextSendTime - now ) < wait ) wait = query->nextSendTime - now;
+    }
+    return( wait );
+}
+
+//===========================================================================================================================
+//  _DNSResolverThread
+//===========================================================================================================================
+
+static void _DNSResolverThread( void *inArg )
+{
+    fd_set              readfds;
+    struct timeval_t    t;
+    struct sockaddr_t   from;
+    socklen_t           fromLen;
+    DNSRequest          request;
+    uint32_t            wait;
+    int                 len;
+
+    (void) inArg;
+
+    while( 1 )
+    {
+        wait = _DNSCheckTimeouts();
+        t.tv_sec  = wait / 1000;
+        t.tv_usec = ( wait % 1000 ) * 1000;
+
+        FD_ZERO( &readfds );
+        FD_SET( gDNS.sock, &readfds );
+        FD_SET( gDNS.eventFd, &readfds );
+        select( 1, &readfds, NULL, NULL, &t );
+
+        if( FD_ISSET( gDNS.eventFd, &readfds ) )
+        {
+            while( mico_rtos_pop_from_queue( &gDNS.requestQueue, &request, 0 ) == kNoErr )
+            {
+                _DNSStartQuery( &request );
+            }
+        }
+
+        if( FD_ISSET( gDNS.sock, &readfds ) )
+        {
+            fromLen = sizeof( from );
+            len = recvfrom( gDNS.sock, gDNS.response, sizeof( gDNS.response ), 0, &from, &fromLen );
+            if( len > 0 ) _DNSProcessResponse( gDNS.response, (size_t) len, &from );
+        }
+    }
+}
+
+#if 0
+#pragma mark == API ==
+#endif
+
+//===========================================================================================================================
+//  DNSResolveAsync
+//===========================================================================================================================
+
+OSStatus DNSResolveAsync( const char *inHostname, DNSResolveCallback inCallback, void *inContext )
+{
+    OSStatus            err = kNoErr;
+    OSStatus            status = kNoErr;
+    DNSRequest          request;
+    uint32_t            ip;
+    size_t              len;
+    bool                found;
+
+    require_action( inHostname && inCallback, exit, err = kParamErr );
+    len = strlen( inHostname );
+    if( ( len > 1 ) && ( inHostname[ len - 1 ] == '.' ) ) --len;       // "example.com." and "example.com" share a cache entry.
+    require_action( ( len > 0 ) && ( len < kDNSMaxHostnameLen ), exit, err = kSizeErr );
+
+    memcpy( request.hostname, inHostname, len );
+    request.hostname[ len ] = '\0';
+    request.callback = inCallback;
+    request.context  = inContext;
+
+    if( _DNSIsIPv4Literal( request.hostname ) )
+    {
+        inCallback( request.hostname, kNoErr, inet_addr( request.hostname ), inContext );
+        goto exit;
+    }
+
+    err = _DNSResolverStart();
+    require_noerr( err, exit );
+
+    mico_rtos_lock_mutex( &gDNS.mutex );
+    gDNS.stats.lookupCount++;
+    found = _DNSCacheFind( request.hostname, false, &status, &ip );
+    if( found ) gDNS.stats.cacheHitCount++;
+    mico_rtos_unlock_mutex( &gDNS.mutex );
+
+    if( found )
+    {
+        inCallback( request.hostname, status, ip, inContext );
+        goto exit;
+    }
+
+    err = mico_rtos_push_to_queue( &gDNS.requestQueue, &request, MICO_NO_WAIT );
+    require_noerr_action( err, exit, err = kNoResourcesErr );
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  DNSResolve
+//
+//  Blocking lookup on top of DNSResolveAsync. Must not be called from a resolver callback.
+//===========================================================================================================================
+
+typedef struct
+{
+    mico_semaphore_t    done;
+    OSStatus            status;
+    uint32_t            ip;
+
+}   DNSResolveSyncContext;
+
+static void _DNSResolveSyncCallback( const char *inHostname, OSStatus inStatus, uint32_t inIP, void *inContext )
+{
+    DNSResolveSyncContext * const       context = (DNSResolveSyncContext *) inContext;
+
+    (void) inHostname;
+
+    context->status = inStatus;
+    context->ip     = inIP;
+    mico_rtos_set_semaphore( &context->done );
+}
+
+OSStatus DNSResolve( const char *inHostname, uint32_t *outIP )
+{
+    OSStatus                    err;
+    DNSResolveSyncContext       context;
+
+    require_action( outIP, exit, err = kParamErr );
+
+    context.status = kUnknownErr;
+    context.ip = 0;
+    err = mico_rtos_init_semaphore( &context.done, 1 );
+    require_noerr( err, exit );
+
+    err = DNSResolveAsync( inHostname, _DNSResolveSyncCallback, &context );
+    if( err == kNoErr )
+    {
+        mico_rtos_get_semaphore( &context.done, MICO_WAIT_FOREVER );
+        err = context.status;
+        *outIP = context.ip;
+    }
+    mico_rtos_deinit_semaphore( &context.done );
+
+exit:
+    return( err );
+}
@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file    DNSUtils.h
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This header contains function prototypes for the asynchronous
+  *          DNS resolver with a TTL cache.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#ifndef __DNSUtils_h__
+#define __DNSUtils_h__
+
+#include "Common.h"
+
+#ifdef  __cplusplus
+    extern "C" {
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @group      DNS Resolver API
+    @abstract   Non-blocking A record lookups with a TTL cache, shared by every thread.
+    @discussion
+
+    One resolver thread owns a UDP socket and every outstanding query. Callers hand it a hostname with
+    DNSResolveAsync and get the result through a callback, or use DNSResolve which waits for that callback.
+    Queries for different names run in parallel; a lookup for a name that already has a query outstanding is
+    attached to that query instead of sending another one.
+
+    Queries go to the DNS server of the station interface and to DNS_RESOLVER_SECONDARY_SERVER (if defined) at the
+    same time, and are retransmitted with exponential backoff starting at DNS_RESOLVER_RETRY_INTERVAL. Replies are
+    only accepted from a queried server with the expected random ID, port and question.
+
+    Answers are cached for their TTL, clamped to [DNS_CACHE_MIN_TTL, DNS_CACHE_MAX_TTL] seconds. Names that do not
+    exist are cached for DNS_CACHE_NEGATIVE_TTL seconds. If a query times out, an expired entry of the same name no
+    older than DNS_CACHE_STALE_TTL seconds is returned instead, so a reconnect still works while the server is down.
+
+    Cache hits and IPv4 literals are reported from the calling thread before DNSResolveAsync returns. All other
+    results are reported from the resolver thread, so callbacks must not block. IP addresses are in the same byte
+    order as inet_addr returns them, ready for sockaddr_t.s_ip and inet_ntoa.
+
+    The resolver thread is started by the first lookup.
+*/
+
+#if( !defined( DNS_CACHE_SIZE ) )
+    #define DNS_CACHE_SIZE                      8
+#endif
+
+#if( !defined( DNS_RESOLVER_MAX_QUERIES ) )
+    #define DNS_RESOLVER_MAX_QUERIES            4       // Different names resolved at the same time.
+#endif
+
+#if( !defined( DNS_RESOLVER_MAX_WAITERS ) )
+    #define DNS_RESOLVER_MAX_WAITERS            4       // Callbacks attached to one query.
+#endif
+
+#if( !defined( DNS_RESOLVER_RETRY_INTERVAL ) )
+    #define DNS_RESOLVER_RETRY_INTERVAL         1000    // ms before the first retransmission.
+#endif
+
+#if( !defined( DNS_RESOLVER_MAX_RETRIES ) )
+    #define DNS_RESOLVER_MAX_RETRIES            3       // 1 + 2 + 4 + 8 seconds in total.
+#endif
+
+#if( !defined( DNS_CACHE_MIN_TTL ) )
+    #define DNS_CACHE_MIN_TTL                   30
+#endif
+
+#if( !defined( DNS_CACHE_MAX_TTL ) )
+    #define DNS_CACHE_MAX_TTL                   ( 24 * 60 * 60 )
+#endif
+
+#if( !defined( DNS_CACHE_NEGATIVE_TTL ) )
+    #define DNS_CACHE_NEGATIVE_TTL              10
+#endif
+
+#if( !defined( DNS_CACHE_STALE_TTL ) )
+    #define DNS_CACHE_STALE_TTL                 ( 24 * 60 * 60 )
+#endif
+
+#if( !defined( DNS_RESOLVER_STACK_SIZE ) )
+    #define DNS_RESOLVER_STACK_SIZE             0x500
+#endif
+
+#define kDNSMaxHostnameLen                      64      // Including the terminating NUL, same as remoteServerDomain.
+
+typedef void ( *DNSResolveCallback )( const char *inHostname, OSStatus inStatus, uint32_t inIP, void *inContext );
+
+typedef struct
+{
+    uint32_t        lookupCount;
+    uint32_t        cacheHitCount;
+    uint32_t        staleHitCount;              // Expired entries returned because the query failed.
+    uint32_t        coalescedCount;             // Lookups attached to a query already in flight.
+    uint32_t        querySentCount;             // Query packets, including retransmissions.
+    uint32_t        timeoutCount;
+    uint32_t        failureCount;               // NXDOMAIN, SERVFAIL, no A record, no resources.
+    uint32_t        resolveTimeAvg;             // ms from the first query to the answer.
+    uint32_t        resolveTimeMax;
+
+}   DNSResolverStats;
+
+OSStatus    DNSResolveAsync( const char *inHostname, DNSResolveCallback inCallback, void *inContext );
+OSStatus    DNSResolve( const char *inHostname, uint32_t *outIP );
+bool        DNSCacheLookup( const char *inHostname, uint32_t *outIP );
+void        DNSCacheRemove( const char *inHostname );
+void        DNSCacheFlush( void );
+void        DNSResolverGetStats( DNSResolverStats *outStats );
+
+#ifdef  __cplusplus
+    }
+#endif
+
+#endif // __DNSUtils_h__
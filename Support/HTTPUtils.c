@@ -22,6 +22,7 @@
 
 #include "MICO.h"
 #include "StringUtils.h"
+#include "SocketUtils.h"
 #include "HTTPUtils.h"
 #include "MicoPlatform.h"
 #include "platform.h"
@@ -141,8 +142,8 @@ bool findHeader ( HTTPHeader_t *inHeader,  char **  outHeaderEnd)
   *outHeaderEnd = dst;
   for( ;; )
   {
-    while( ( src < *outHeaderEnd ) && ( *src != '\n' ) ) ++src;
-    if( src >= *outHeaderEnd ) break;
+    src = memchr( src, '\n', (size_t)( *outHeaderEnd - src ) );
+    if( src == NULL ) break;
     
     len = (size_t)( *outHeaderEnd - src );
     if( ( len >= 3 ) && ( src[ 1 ] == '\r' ) && ( src[ 2 ] == '\n' ) ) // CRLFCRLF or LFCRLF.
@@ -502,30 +503,13 @@ exit:
 
 int findCRLF( const char *inDataPtr , size_t inDataLen, char **  nextDataPtr ) //find CRLF
 {
-  char *dst = (char *)inDataPtr + inDataLen;
-  char *src = (char *)inDataPtr;
-  size_t          len;
+  char *src;
   
   // Find an empty line (separates the length and data).
-  for( ;; )
-  {
-    while( ( src < dst ) && ( *src != '\r' ) ) ++src;
-    if( src >= dst ) break;
-    
-    len = (size_t)( dst - src );
-
-    if( ( len >= 2 ) && ( src[ 1 ] == '\n' ) ) // CRLF
-    {
-       *nextDataPtr = src + 2;
-      return true;
-    }
-    else if( len <= 1 )
-    {
-      break;
-    }
-    ++src;
-  }
-  return false;  
+  src = memmem( (void *)inDataPtr, inDataLen, "\r\n", 2 );
+  if( src == NULL ) return false;
+  *nextDataPtr = src + 2;
+  return true;
 }
 
 int findChunkedDataLength( const char *inChunkPtr , size_t inChunkLen, char **  chunkedDataPtr, const char *inFormat, ... )
@@ -730,10 +714,13 @@ void HTTPHeaderClear( HTTPHeader_t *inHeader )
   }else{
 
     /* We get some data belongs to next http package, this only could happen two or more
-      packages are received by SocketReadHTTPHeader */ 
-    if( inHeader->extraDataLen > inHeader->contentLength ){ 
+      packages are received by SocketReadHTTPHeader. The body is read up to contentLength,
+      so these bytes are still in buf after this header and its body */ 
+    if( inHeader->extraDataLen > inHeader->contentLength
+       && inHeader->len + inHeader->contentLength < sizeof( inHeader->buf )
+       && inHeader->extraDataLen - inHeader->contentLength <= sizeof( inHeader->buf ) - inHeader->len - inHeader->contentLength ){ 
+      memmove(inHeader->buf, inHeader->buf + inHeader->len + inHeader->contentLength, inHeader->extraDataLen - inHeader->contentLength);
       inHeader->len = inHeader->extraDataLen - inHeader->contentLength;
-      memcpy(inHeader->buf, inHeader->extraDataPtr + inHeader->contentLength, inHeader->len);
     } else
       inHeader->len = 0;
 
@@ -835,6 +822,8 @@ char * getStatusString(int status)
     return "No Content";
   else if(status == kStatusPartialContent)
     return "Multi0Status";
+  else if(status == kStatusNotModified)
+    return "Not Modified";
   else if(status == kStatusBadRequest)
     return "Bad Request";
   else if(status == kStatusNotFound)
@@ -881,6 +870,17 @@ exit:
 }
 
 
+OSStatus SocketSendHTTPMessage( int fd, const uint8_t *inHeader, size_t inHeaderLen, const uint8_t *inBody, size_t inBodyLen )
+{
+  iovec_t iov[2];
+
+  iov[0].iov_base = inHeader;
+  iov[0].iov_len  = inHeaderLen;
+  iov[1].iov_base = inBody;
+  iov[1].iov_len  = inBodyLen;
+  return SocketSendv( fd, iov, ( inBody && inBodyLen ) ? 2 : 1 );
+}
+
 OSStatus CreateHTTPMessage( const char *methold, const char *url, const char *contentType, uint8_t *inData, size_t inDataLen, uint8_t **outMessage, size_t *outMessageSize )
 {
   uint8_t *endOfHTTPHeader;  
@@ -62,6 +62,7 @@
 #define kStatusOK                   200
 #define kStatusNoConetnt            204
 #define kStatusPartialContent       206
+#define kStatusNotModified          304
 #define kStatusBadRequest           400
 #define kStatusNotFound             404
 #define kStatusMethodNotAllowed     405
@@ -172,8 +173,13 @@ int CreateSimpleHTTPOKMessage( uint8_t **outMessage, size_t *outMessageSize );
 OSStatus CreateSimpleHTTPMessage      ( const char *contentType, uint8_t *inData, size_t inDataLen, uint8_t **outMessage, size_t *outMessageSize );
 OSStatus CreateSimpleHTTPMessageNoCopy( const char *contentType, size_t inDataLen, uint8_t **outMessage, size_t *outMessageSize );
 
+char * getStatusString(int status);
+
 OSStatus CreateHTTPRespondMessageNoCopy( int status, const char *contentType, size_t inDataLen, uint8_t **outMessage, size_t *outMessageSize );
 
+/* Send a header created by one of the NoCopy functions above together with its body, in one segment if they fit */
+OSStatus SocketSendHTTPMessage( int fd, const uint8_t *inHeader, size_t inHeaderLen, const uint8_t *inBody, size_t inBodyLen );
+
 
 OSStatus CreateHTTPMessage( const char *methold, const char *url, const char *contentType, uint8_t *inData, size_t inDataLen, uint8_t **outMessage, size_t *outMessageSize );
 
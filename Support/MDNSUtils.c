@@ -21,607 +21,1437 @@
 */ 
 
 #include "MDNSUtils.h"
+#include "RandomUtils.h"
+#include "StringUtils.h"
 
-static int mDNS_fd = -1;
+#define mdns_utils_log(M, ...) custom_log("mDNS Utils", M, ##__VA_ARGS__)
+#define mdns_utils_log_trace() custom_log_trace("mDNS Utils")
 
+#define MDNS_PORT                     5353
+#define MDNS_MULTICAST_ADDR           0xE00000FB  /* 224.0.0.251 */
+#define MDNS_MAX_NAME_LEN             256         /* Uncompressed wire format */
+#define MDNS_MAX_NAMES                (4 + 5 * MDNS_MAX_SERVICES)
+#define MDNS_NO_NAME                  0xFF
+
+#define MDNS_HOST_TTL                 120         /* A and SRV, RFC 6762 section 10 */
+#define MDNS_SERVICE_TTL              4500        /* PTR and TXT */
+#define MDNS_LEGACY_TTL               10
+
+#define MDNS_PROBE_COUNT              3
+#define MDNS_PROBE_INTERVAL           250
+#define MDNS_PROBE_DEFER              1000        /* Lost a simultaneous probe tie-break */
+#define MDNS_CONFLICT_LIMIT           15          /* Conflicts within MDNS_CONFLICT_WINDOW before probing slows down */
+#define MDNS_CONFLICT_WINDOW          10000
+#define MDNS_CONFLICT_BACKOFF         5000
+#define MDNS_ANNOUNCE_COUNT           3           /* 1 s apart, then 2 s */
+#define MDNS_ANNOUNCE_INTERVAL        1000
+#define MDNS_RATE_LIMIT               1000        /* A record is multicast at most once per second */
+#define MDNS_SHARED_DELAY_MIN         20          /* Shared answers are delayed so they can be aggregated */
+#define MDNS_SHARED_DELAY_MAX         120
+#define MDNS_TRUNCATED_DELAY_MIN      400         /* More known answers follow a truncated query */
+#define MDNS_TRUNCATED_DELAY_MAX      500
+#define MDNS_POLL_INTERVAL            250
+
+/* Records published for every service, in the order they are announced */
+typedef enum
+{
+  MDNS_RECORD_SERVICES_PTR = 0,  /* _services._dns-sd._udp.local -> service */
+  MDNS_RECORD_SERVICE_PTR,       /* service -> instance */
+  MDNS_RECORD_TXT,               /* instance */
+  MDNS_RECORD_SRV,               /* instance -> host:port */
+  MDNS_RECORD_A,                 /* host -> ip */
+  MDNS_RECORD_COUNT
+} mdns_record_index_t;
+
+#define MDNS_MAX_RECORDS        (MDNS_MAX_SERVICES * MDNS_RECORD_COUNT)
+#define MDNS_ALL_RECORDS        ((1 << MDNS_RECORD_COUNT) - 1)
+
+/* Per record answer state for the message being processed or built */
+#define MDNS_ANSWER_MULTICAST   0x01
+#define MDNS_ANSWER_UNICAST     0x02
+#define MDNS_ANSWER_LEGACY      0x04
+#define MDNS_ANSWER_WRITTEN     0x08    /* In the answer section */
+#define MDNS_ANSWER_ADDITIONAL  0x10    /* In the additional section */
+#define MDNS_ANSWER_SKIP        0x20    /* Not wanted as an additional record */
+
+/* Names are shared between services and stored once, as the first label plus the pool
+   index of the rest, so a message can compress them without comparing any bytes */
+typedef struct
+{
+  uint8_t*  wire;           /* Uncompressed, NULL if the slot is free */
+  uint8_t   prefix;         /* Length of the first label, including its length byte */
+  uint8_t   suffix;         /* Rest of the name, MDNS_NO_NAME for a single label */
+  uint8_t   refs;
+} mdns_name_t;
+
+/* A record is kept in wire format: owner name, the fixed 10 byte header, the fixed part of rdata
+   and a name at the end of rdata, so writing it is a few memcpy calls */
 typedef struct
 {
-  char* hostname;
-  char* instance_name;
-  char* service_name;
-  char* txt_att;
-  uint16_t	port;
-  char	instance_name_suffix[4]; // This variable should only be modified by the DNS-SD library
-} dns_sd_service_record_t;
+  bool      valid;
+  int8_t    primary;        /* Identical record of another service that is sent instead, or -1 */
+  uint8_t   owner;          /* Name pool index */
+  uint8_t   rdata_name;     /* Name pool index at the end of rdata, or MDNS_NO_NAME */
+  uint16_t  type;
+  uint16_t  rr_class;       /* RR_CLASS_IN, plus RR_CACHE_FLUSH for unique records */
+  uint32_t  ttl;
+  uint8_t   header[10];     /* Type, class, TTL and a placeholder for the rdata length */
+  uint8_t*  rdata;
+  uint16_t  rdata_len;      /* Without rdata_name */
+  uint8_t   answer;
+  bool      pending;        /* A multicast answer is scheduled at send_time */
+  bool      multicast;      /* last_multicast is valid */
+  uint32_t  send_time;
+  uint32_t  last_multicast;
+} mdns_record_t;
+
+typedef enum
+{
+  MDNS_STATE_IDLE = 0,      /* Suspended */
+  MDNS_STATE_PROBING,
+  MDNS_STATE_ANNOUNCING,
+  MDNS_STATE_RUNNING
+} mdns_state_t;
 
-static WiFi_Interface _interface;
+typedef struct
+{
+  bool            in_use;
+  WiFi_Interface  interface;
+  /* As registered, names are rebuilt from these after a conflict */
+  char*           service_name;
+  char*           host_name;
+  char*           instance_name;
+  int             host_suffix;
+  int             instance_suffix;
+  uint8_t         service;        /* Name pool indexes */
+  uint8_t         instance;
+  uint8_t         host;
+  uint8_t         srv_rdata[6];   /* Priority, weight, port */
+  uint8_t*        txt;
+  uint16_t        txt_len;
+  uint8_t         a_rdata[4];
+  mdns_state_t    state;
+  uint8_t         announce;       /* Records still to announce, bit per mdns_record_index_t */
+  int             state_count;
+  uint32_t        state_time;
+  int             conflict_count;
+  uint32_t        conflict_time;
+} mdns_service_t;
 
+typedef struct
+{
+  uint8_t*  buf;
+  int       size;
+  int       len;
+  uint16_t  counts[4];      /* Questions, answers, authorities, additionals */
+  uint16_t  name_offset[MDNS_MAX_NAMES];  /* Where a pool name was written, 0 if it was not */
+} mdns_message_t;
 
-#define APP_Available_Offset               0
-#define Support_TLV_Config_Offset          2
+typedef struct
+{
+  uint16_t  type;
+  uint16_t  rr_class;
+  uint32_t  ttl;
+  int       rdata_offset;
+  uint16_t  rdata_len;
+} mdns_rr_t;
+
+#define MDNS_SECTION_QUESTION    0
+#define MDNS_SECTION_ANSWER      1
+#define MDNS_SECTION_AUTHORITY   2
+#define MDNS_SECTION_ADDITIONAL  3
+
+static const uint8_t services_query_name[] = "\x09_services\x07_dns-sd\x04_udp\x05local";
+
+/* Records that go into the additional section with an answer, RFC 6763 section 12 */
+static const uint8_t additional_records[MDNS_RECORD_COUNT] =
+{
+  0,
+  (1 << MDNS_RECORD_TXT) | (1 << MDNS_RECORD_SRV) | (1 << MDNS_RECORD_A),
+  0,
+  (1 << MDNS_RECORD_A),
+  0
+};
 
-#define Problem_Detected_Offset            0
-#define Not_Configured_Offset              1
+static int mDNS_fd = -1;
 
+static mico_mutex_t bonjour_mutex = NULL;
+static mico_thread_t mfi_bonjour_thread_handler;
+static void _bonjour_thread(void *arg);
 
-#define MFi_SERVICE_QUERY_NAME             "_services._dns-sd._udp.local."
+static mdns_name_t    names[MDNS_MAX_NAMES];
+static mdns_service_t services[MDNS_MAX_SERVICES];
+static mdns_record_t  records[MDNS_MAX_RECORDS];
+static uint8_t        services_query = MDNS_NO_NAME;
+static int            default_service = -1;   /* Used by bonjour_service_init */
+static bool           _suspended = true;
 
+static bonjour_stats_t _stats;
 
-static bool _suspend_MFi_bonjour;
-static int _bonjour_announce_time = 0;
-static int _bonjour_announce = 0;
+/* Scratch space, only used with bonjour_mutex held */
+static uint8_t   tx_buf[MDNS_MAX_MESSAGE_LEN];
+static uint8_t   scratch_name[MDNS_MAX_NAME_LEN];
+static uint8_t   scratch_rdata[MDNS_MAX_NAME_LEN + 6];
 
+static uint32_t mdns_random_delay(uint32_t min, uint32_t max)
+{
+  return min + RandomUInt32() % (max - min + 1);
+}
 
-//#define  debug_out 
+/* Names and TXT strings */
 
-//#ifdef debug_out
-//#define  _debug_out debug_out
-//#else
-#define _debug_out(format, ...) do {;}while(0)
+/* "a.b.local." to wire format, '/' escapes the next character (e.g. a dot inside a label) */
+static int mdns_name_from_string(const char *src, uint8_t *dst, int size, bool single_label)
+{
+  int len = 0;
+  int label;
+
+  while (*src != 0) {
+    label = len++;
+    if (len >= size) return -1;
+    dst[label] = 0;
+    while (*src != 0 && (single_label || *src != '.')) {
+      if (*src == '/' && src[1] != 0) src++;
+      if (len >= size || dst[label] == 63) return -1;
+      dst[len++] = *src++;
+      dst[label]++;
+    }
+    if (dst[label] == 0) return -1;
+    if (*src == '.') src++;
+  }
+  if (len >= size) return -1;
+  dst[len++] = 0;
+  return len;
+}
 
-#define mdns_utils_log(M, ...) custom_log("mDNS Utils", M, ##__VA_ARGS__)
-#define mdns_utils_log_trace() custom_log_trace("mDNS Utils")
-//#endif
-
-static dns_sd_service_record_t*   available_services	= NULL;
-static uint8_t	available_service_count;
-
-static int dns_get_next_question( dns_message_iterator_t* iter, dns_question_t* q, dns_name_t* name );
-static int dns_compare_name_to_string( dns_name_t* name, const char* string, const char* fun, const int line );
-static int dns_create_message( dns_message_iterator_t* message, uint16_t size );
-static void dns_write_header( dns_message_iterator_t* iter, uint16_t id, uint16_t flags, uint16_t question_count, uint16_t answer_count, uint16_t authorative_count );
-static void dns_write_record( dns_message_iterator_t* iter, const char* name, uint16_t record_class, uint16_t record_type, uint32_t ttl, uint8_t* rdata );
-static void mdns_send_message(int fd, dns_message_iterator_t* message );
-static void dns_free_message( dns_message_iterator_t* message );
-static void mdns_process_query(int fd, dns_name_t* name, dns_question_t* question, dns_message_iterator_t* source );
-static void dns_write_record( dns_message_iterator_t* iter, const char* name, uint16_t record_class, uint16_t record_type, uint32_t ttl, uint8_t* rdata );
-static void dns_write_uint16( dns_message_iterator_t* iter, uint16_t data );
-static void dns_write_uint32( dns_message_iterator_t* iter, uint32_t data );
-static void dns_write_bytes( dns_message_iterator_t* iter, uint8_t* data, uint16_t length );
-static uint16_t dns_read_uint16( dns_message_iterator_t* iter );
-static void dns_skip_name( dns_message_iterator_t* iter );
-static void dns_write_name( dns_message_iterator_t* iter, const char* src );
+/* TXT strings are separated by '.', '/' escapes a dot inside a string */
+static int mdns_txt_from_string(const char *src, uint8_t *dst, int size)
+{
+  int len = 0;
+  int string;
+
+  while (src && *src != 0) {
+    string = len++;
+    if (len > size) return -1;
+    dst[string] = 0;
+    while (*src != 0 && *src != '.') {
+      if (*src == '/' && src[1] != 0) src++;
+      if (len >= size || dst[string] == 255) return -1;
+      dst[len++] = *src++;
+      dst[string]++;
+    }
+    if (*src == '.') src++;
+  }
+  if (len == 0 && size > 0) dst[len++] = 0; /* An empty TXT record still holds one empty string */
+  return len;
+}
 
-static mico_mutex_t bonjour_mutex = NULL;
-static mico_thread_t mfi_bonjour_thread_handler;
-static void _bonjour_thread(void *arg);
+static int mdns_name_length(const uint8_t *name)
+{
+  const uint8_t *p = name;
+  while (*p) p += *p + 1;
+  return p - name + 1;
+}
 
-static char *__strdup(char *src)
+static uint8_t mdns_tolower(uint8_t c)
 {
-  int len;
-  char *dst;
-  
-  if (src == NULL)
-    return NULL;
-  
-  if (src[0] == 0)
-    return NULL;
-  
-  len = strlen(src) + 1;
-  dst = (char*)malloc(len);
-  if (dst) 
-    memcpy(dst, src, len);
-  return dst;
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
 }
 
-void process_dns_questions(int fd, dns_message_iterator_t* iter )
+static bool mdns_label_equal(const uint8_t *a, const uint8_t *b)
 {
-  dns_name_t name;
-  dns_question_t question;
-  dns_message_iterator_t response;
-  IPStatusTypedef para;
-  int a = 0;
-  int question_processed;
-  uint32_t myip;
-  
-  micoWlanGetIPStatus(&para, _interface);
-  myip = htonl(inet_addr(para.ip));
-  if(myip == 0) {
-    _debug_out("UDP multicast test: IP error.\r\n");
-    return;
+  int i;
+  if (*a != *b) return false;
+  for (i = 1; i <= *a; i++)
+    if (mdns_tolower(a[i]) != mdns_tolower(b[i])) return false;
+  return true;
+}
+
+static bool mdns_name_equal(const uint8_t *a, const uint8_t *b)
+{
+  while (*a) {
+    if (!mdns_label_equal(a, b)) return false;
+    b += *b + 1;
+    a += *a + 1;
   }
-  
-  memset( &response, 0, sizeof(dns_message_iterator_t) );
-  
-  for ( a = 0; a < htons(iter->header->question_count); ++a )
-  {
-    if (iter->iter > iter->end)
-      break;
-    if(dns_get_next_question( iter, &question, &name )==0)
-      break;
-    question_processed = 0;
-    switch ( question.question_type ){
-    case RR_TYPE_PTR:
-      if ( available_services != NULL ){
-        // Check if its a query for all available services  
-        if ( dns_compare_name_to_string( &name, MFi_SERVICE_QUERY_NAME, __FUNCTION__, __LINE__ ) ){
-          int b = 0;
-          _debug_out("UDP multicast test: Recv a SERVICE QUERY request.\r\n");
-          if(dns_create_message( &response, 512 )) {
-            dns_write_header(&response, iter->header->id, 0x8400, 0, available_service_count, 0 );          
-            for ( b = 0; b < available_service_count; ++b ){
-              dns_write_record( &response, MFi_SERVICE_QUERY_NAME, RR_CLASS_IN, RR_TYPE_PTR, 1500, (uint8_t*) available_services[b].service_name );
-            }
-            mdns_send_message(fd, &response );
-            dns_free_message( &response );
-            question_processed = 1;
-          }
-        }
-        // else check if its one of our records
-        else {
-          int b = 0;
-          for ( b = 0; b < available_service_count; ++b ){
-            //printf("UDP multicast test: Recv a SERVICE Detail request: %s.\r\n", name);
-            if ( dns_compare_name_to_string( &name, available_services[b].service_name, __FUNCTION__, __LINE__ )){
-              // Send the PTR, TXT, SRV and A records
-              if(dns_create_message( &response, 512 )){
-                dns_write_header( &response, iter->header->id, 0x8400, 0, 4, 0 );
-                //dns_write_record( &response, MFi_SERVICE_QUERY_NAME, RR_CLASS_IN, RR_TYPE_PTR, 1500, (u8*) available_services[b].service_name );
-                dns_write_record( &response, available_services[b].service_name, RR_CLASS_IN, RR_TYPE_PTR, 1500, (uint8_t*) available_services[b].instance_name );
-                dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_TXT, 1500, (uint8_t*) available_services[b].txt_att );
-                dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_SRV, 1500, (uint8_t*) &available_services[b]);
-                dns_write_record( &response, available_services[b].hostname, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_A, 1500, (uint8_t*) &myip);
-                mdns_send_message(fd, &response );
-                dns_free_message( &response );
-                question_processed = 1;
-              }
-              else{
-                _debug_out("UDP multicast test: Send error.\r\n");
-              }
-            }
-          }
-        }
-      }
-      break;
+  return *b == 0;
+}
+
+static void mdns_name_release(uint8_t index)
+{
+  while (index != MDNS_NO_NAME && --names[index].refs == 0) {
+    free(names[index].wire);
+    names[index].wire = NULL;
+    index = names[index].suffix;
+  }
+}
+
+/* Returns the pool index of the name, adding it and its suffixes if needed */
+static uint8_t mdns_name_intern(const uint8_t *wire)
+{
+  uint8_t suffix = MDNS_NO_NAME;
+  int len = mdns_name_length(wire);
+  int i;
+
+  for (i = 0; i < MDNS_MAX_NAMES; i++) {
+    if (names[i].wire && mdns_name_equal(names[i].wire, wire)) {
+      names[i].refs++;
+      return i;
     }
-    if (!question_processed ){
-      _debug_out("UDP multicast test: Recv a mDNS request.\r\n");
-      mdns_process_query(fd, &name, &question, iter);
+  }
+
+  if (wire[wire[0] + 1] != 0) {
+    suffix = mdns_name_intern(wire + wire[0] + 1);
+    if (suffix == MDNS_NO_NAME) return MDNS_NO_NAME;
+  }
+  for (i = 0; i < MDNS_MAX_NAMES; i++) {
+    if (names[i].wire == NULL) break;
+  }
+  if (i == MDNS_MAX_NAMES || (names[i].wire = malloc(len)) == NULL) {
+    mdns_name_release(suffix);
+    return MDNS_NO_NAME;
+  }
+  memcpy(names[i].wire, wire, len);
+  names[i].prefix = wire[0] + 1;
+  names[i].suffix = suffix;
+  names[i].refs = 1;
+  return i;
+}
+
+/* Packet parsing */
+
+/* Decompress the name at offset into out, returns the offset after the name or -1 */
+static int mdns_read_name(const uint8_t *pkt, int len, int offset, uint8_t *out, int size)
+{
+  int next = -1;
+  int out_len = 0;
+  int hops = 0;
+  uint8_t label;
+
+  while (offset < len) {
+    label = pkt[offset];
+    if ((label & 0xC0) == 0xC0) {
+      if (offset + 1 >= len || ++hops > 16) return -1;
+      if (next < 0) next = offset + 2;
+      offset = ((label & 0x3F) << 8) | pkt[offset + 1];
+      continue;
     }
+    if (label & 0xC0) return -1;
+    if (offset + 1 + label > len || out_len + 1 + label >= size) return -1;
+    memcpy(out + out_len, pkt + offset, 1 + label);
+    out_len += 1 + label;
+    offset += 1 + label;
+    if (label == 0)
+      return (next < 0) ? offset : next;
   }
+  return -1;
 }
 
-static void mdns_process_query(int fd, dns_name_t* name, 
-                               dns_question_t* question, dns_message_iterator_t* source )
+/* Reads a resource record header, returns the offset after the record or -1 */
+static int mdns_read_rr(const uint8_t *pkt, int len, int offset, uint8_t *name, mdns_rr_t *rr)
 {
-  dns_message_iterator_t response;
-  IPStatusTypedef para;
-  uint32_t myip;
-  
-  micoWlanGetIPStatus(&para, _interface);
-  myip = htonl(inet_addr(para.ip));
-  
-  memset( &response, 0, sizeof(dns_message_iterator_t) );
-  
-  switch ( question->question_type )
-  {
-  case RR_QTYPE_ANY:
-  case RR_TYPE_A:
-    if ( dns_compare_name_to_string( name, available_services->hostname, __FUNCTION__, __LINE__) ){				
-      _debug_out("UDP multicast test: Recv RR_TYPE_A.\r\n");
-      if(dns_create_message( &response, 256 )){
-        dns_write_header( &response, source->header->id, 0x8400, 0, 1, 0 );
-        dns_write_record( &response, available_services->hostname, RR_CLASS_IN | RR_CACHE_FLUSH, RR_TYPE_A, 300, (uint8_t *)&myip);
-        mdns_send_message(fd, &response );
-        dns_free_message( &response );
-        return;
-      }
-    }    
-  default:
-    _debug_out("UDP multicast test: Request not support type: %d.---------------------\r\n", question->question_type);
+  offset = mdns_read_name(pkt, len, offset, name, MDNS_MAX_NAME_LEN);
+  if (offset < 0 || offset + 10 > len) return -1;
+  rr->type = ReadBig16(pkt + offset);
+  rr->rr_class = ReadBig16(pkt + offset + 2);
+  rr->ttl = ReadBig32(pkt + offset + 4);
+  rr->rdata_len = ReadBig16(pkt + offset + 8);
+  rr->rdata_offset = offset + 10;
+  if (rr->rdata_offset + rr->rdata_len > len) return -1;
+  return rr->rdata_offset + rr->rdata_len;
+}
+
+/* Uncompressed rdata of a received record, so it can be compared with ours byte by byte */
+static int mdns_read_rdata(const uint8_t *pkt, int len, const mdns_rr_t *rr, uint8_t *out, int size)
+{
+  int prefix = (rr->type == RR_TYPE_SRV) ? 6 : 0;
+
+  if (rr->type != RR_TYPE_PTR && rr->type != RR_TYPE_SRV) {
+    if (rr->rdata_len > size) return -1;
+    memcpy(out, pkt + rr->rdata_offset, rr->rdata_len);
+    return rr->rdata_len;
   }
+  if (rr->rdata_len < prefix + 1) return -1;
+  memcpy(out, pkt + rr->rdata_offset, prefix);
+  if (mdns_read_name(pkt, len, rr->rdata_offset + prefix, out + prefix, size - prefix) < 0) return -1;
+  return prefix + mdns_name_length(out + prefix);
 }
 
+static bool mdns_rdata_equal(const mdns_record_t *record, const uint8_t *rdata, int rdata_len)
+{
+  if (rdata_len < record->rdata_len || memcmp(rdata, record->rdata, record->rdata_len) != 0)
+    return false;
+  if (record->rdata_name == MDNS_NO_NAME)
+    return rdata_len == record->rdata_len;
+  return mdns_name_equal(rdata + record->rdata_len, names[record->rdata_name].wire);
+}
 
-static int dns_get_next_question( dns_message_iterator_t* iter, dns_question_t* q, dns_name_t* name )
+/* RFC 6762 section 8.2 lexicographical order: class, type, then uncompressed rdata */
+static int mdns_record_compare(const mdns_record_t *record, const mdns_rr_t *rr, const uint8_t *rdata, int rdata_len)
 {
-  // Set the name pointers and then skip it
-  name->start_of_name   = (uint8_t*) iter->iter;
-  name->start_of_packet = (uint8_t*) iter->header;
-  dns_skip_name( iter );
-  if (iter->iter > iter->end)
-    return 0;
-  
-  // Read the type and class
-  q->question_type  = dns_read_uint16( iter );
-  q->question_class = dns_read_uint16( iter );
-  return 1;
+  const uint8_t *name = (record->rdata_name == MDNS_NO_NAME) ? NULL : names[record->rdata_name].wire;
+  int own_len = record->rdata_len + (name ? mdns_name_length(name) : 0);
+  int i;
+  uint8_t c;
+
+  if ((record->rr_class & 0x7FFF) != (rr->rr_class & 0x7FFF))
+    return (record->rr_class & 0x7FFF) - (rr->rr_class & 0x7FFF);
+  if (record->type != rr->type)
+    return record->type - rr->type;
+  for (i = 0; i < own_len && i < rdata_len; i++) {
+    c = (i < record->rdata_len) ? record->rdata[i] : name[i - record->rdata_len];
+    if (c != rdata[i]) return c - rdata[i];
+  }
+  return own_len - rdata_len;
 }
 
-static int dns_compare_name_to_string( dns_name_t* name, const char* string, const char* fun, int line )
+/* Message writer */
+
+static void mdns_message_init(mdns_message_t *msg, uint16_t id, uint16_t flags)
 {
-  uint8_t section_length;
-  int finished = 0;
-  int result   = 1;
-  uint8_t* buffer 	  = name->start_of_name;
-  _debug_out("UDP multicast test: CMP called by %s@%d.\r\n", fun, line );
-  char *temp;
-  
-  while ( !finished )
-  {
-    // Check if the name is compressed. If so, find the uncompressed version
-    while ( *buffer & 0xC0 )
-    {
-      uint16_t offset = ( *buffer++ ) << 8;
-      offset += *buffer;
-      offset &= 0x3FFF;
-      buffer = name->start_of_packet + offset;
-      _debug_out("UDP multicast test: Recv a compressed name.\r\n");
-    }
-    
-    // Compare section
-    section_length = *( buffer++ );
-    temp = malloc(section_length+1);
-    temp[section_length] = 0;
-    memcpy(temp, buffer, section_length );
-    _debug_out("UDP multicast test: Recv a name: %s.\r\n", temp);
-    free(temp);
-    if ( strncmp( (char*) buffer, string, section_length ) )
-    {
-      result	 = 0;
-      finished = 1;
-    }
-    string += section_length + 1;
-    buffer += section_length;
-    
-    // Check if we've finished comparing
-    if ( *buffer == 0 || *string == 0 )
-    {
-      finished = 1;
-      // Check if one of the strings has more data
-      if ( *buffer != 0 || *string != 0 )
-      {
-        result = 0;
-      }
+  memset(msg, 0, sizeof(mdns_message_t));
+  msg->buf = tx_buf;
+  msg->size = sizeof(tx_buf);
+  msg->len = sizeof(dns_message_header_t);
+  msg->buf[0] = id >> 8;
+  msg->buf[1] = id & 0xFF;
+  msg->buf[2] = flags >> 8;
+  msg->buf[3] = flags & 0xFF;
+}
+
+/* Labels not in the message yet are copied, the rest becomes a pointer */
+static bool mdns_message_write_name(mdns_message_t *msg, uint8_t index)
+{
+  while (index != MDNS_NO_NAME) {
+    if (msg->name_offset[index]) {
+      if (msg->len + 2 > msg->size) return false;
+      msg->buf[msg->len++] = 0xC0 | (msg->name_offset[index] >> 8);
+      msg->buf[msg->len++] = msg->name_offset[index] & 0xFF;
+      return true;
     }
+    if (msg->len + names[index].prefix + 1 > msg->size) return false;
+    if (msg->len < 0x3FFF)
+      msg->name_offset[index] = msg->len;
+    memcpy(msg->buf + msg->len, names[index].wire, names[index].prefix);
+    msg->len += names[index].prefix;
+    index = names[index].suffix;
   }
-  
-  return result;
+  msg->buf[msg->len++] = 0;
+  return true;
 }
 
-static int dns_create_message( dns_message_iterator_t* message, uint16_t size )
+static bool mdns_message_write_question(mdns_message_t *msg, uint8_t index, const uint8_t *wire, uint16_t type, uint16_t rr_class)
 {
-  message->header = (dns_message_header_t*) malloc( size );
-  if ( message->header == NULL )
-  {
-    return 0;
+  int start = msg->len;
+  int len;
+
+  if (wire) {
+    /* Not one of our names, copied uncompressed */
+    len = mdns_name_length(wire);
+    if (msg->len + len > msg->size) goto overflow;
+    memcpy(msg->buf + msg->len, wire, len);
+    msg->len += len;
+  } else if (!mdns_message_write_name(msg, index)) {
+    goto overflow;
   }
-  
-  message->iter = (uint8_t *) message->header + sizeof(dns_message_header_t);
-  return 1;
+  if (msg->len + 4 > msg->size) goto overflow;
+  WriteBig16(msg->buf + msg->len, type);
+  WriteBig16(msg->buf + msg->len + 2, rr_class);
+  msg->len += 4;
+  msg->counts[MDNS_SECTION_QUESTION]++;
+  return true;
+
+overflow:
+  msg->len = start;
+  return false;
 }
 
-static void dns_free_message( dns_message_iterator_t* message )
+static bool mdns_message_write_record(mdns_message_t *msg, int section, const mdns_record_t *record, uint16_t rr_class, uint32_t ttl)
 {
-  free(message->header);
-  message->header = NULL;
+  uint16_t name_offset[MDNS_MAX_NAMES];
+  int start = msg->len;
+  int rdata_start;
+  uint8_t *header;
+
+  memcpy(name_offset, msg->name_offset, sizeof(name_offset));
+  if (!mdns_message_write_name(msg, record->owner) || msg->len + 10 + record->rdata_len > msg->size)
+    goto overflow;
+  header = msg->buf + msg->len;
+  memcpy(header, record->header, 10);
+  if (rr_class != record->rr_class) WriteBig16(header + 2, rr_class);
+  if (ttl != record->ttl) WriteBig32(header + 4, ttl);
+  msg->len += 10;
+  rdata_start = msg->len;
+
+  memcpy(msg->buf + msg->len, record->rdata, record->rdata_len);
+  msg->len += record->rdata_len;
+  if (record->rdata_name != MDNS_NO_NAME && !mdns_message_write_name(msg, record->rdata_name))
+    goto overflow;
+  WriteBig16(header + 8, msg->len - rdata_start);
+  msg->counts[section]++;
+  return true;
+
+overflow:
+  msg->len = start;
+  memcpy(msg->name_offset, name_offset, sizeof(name_offset));
+  return false;
 }
 
-static void dns_write_string( dns_message_iterator_t* iter, const char* src )
+static int mdns_message_finish(mdns_message_t *msg)
 {
-  uint8_t* segment_length_pointer;
-  uint8_t  segment_length;
-  
-  while ( *src != 0 && *src != 0xC0)
-  {
-    /* Remember where we need to store the segment length and reset the counter*/
-    segment_length_pointer = iter->iter++;
-    segment_length = 0;
-    
-    /* Copy bytes until '.' or end of string*/
-    while ( *src != '.' && *src != 0 && *src != 0xC0)
-    {
-      if (*src == '/')
-        src++; // skip '/'
-      
-      *iter->iter++ = *src++;
-      ++segment_length;
-    }
-    
-    /* Store the length of the segment*/
-    *segment_length_pointer = segment_length;
-    
-    /* Check if we stopped because of a '.', if so, skip it*/
-    if ( *src == '.' )
-    {
-      ++src;
-    }
-    
-  }
-  
-  if (*src == 0xC0) { // compress name
-    *iter->iter++ = *src++;
-    *iter->iter++ = *src++;
+  int i;
+  for (i = 0; i < 4; i++)
+    WriteBig16(msg->buf + 4 + 2 * i, msg->counts[i]);
+  return msg->len;
+}
+
+/* The stack picks the interface for multicast, the message goes out once either way */
+static void mdns_send_message(mdns_message_t *msg, const struct sockaddr_t *to)
+{
+  struct sockaddr_t addr;
+  int len = mdns_message_finish(msg);
+
+  if (to) {
+    sendto(mDNS_fd, msg->buf, len, 0, to, sizeof(struct sockaddr_t));
   } else {
-    /* Add the ending null */
-    *iter->iter++ = 0;
+    addr.s_ip = MDNS_MULTICAST_ADDR;
+    addr.s_port = MDNS_PORT;
+    sendto(mDNS_fd, msg->buf, len, 0, &addr, sizeof(addr));
+#if MDNS_SEND_BROADCAST_COPY
+    addr.s_ip = inet_addr("255.255.255.255");
+    sendto(mDNS_fd, msg->buf, len, 0, &addr, sizeof(addr));
+#endif
   }
+  _stats.packets_sent++;
+  _stats.bytes_sent += len;
+  _stats.records_sent += msg->counts[MDNS_SECTION_ANSWER] + msg->counts[MDNS_SECTION_AUTHORITY] + msg->counts[MDNS_SECTION_ADDITIONAL];
 }
 
+/* Registry */
 
-static void dns_write_header( dns_message_iterator_t* iter, uint16_t id, uint16_t flags, uint16_t question_count, uint16_t answer_count, uint16_t authorative_count )
+static mdns_record_t *mdns_service_record(int service, mdns_record_index_t index)
 {
-  memset( iter->header, 0, sizeof(dns_message_header_t) );
-  iter->header->id				= htons(id);
-  iter->header->flags 			= htons(flags);
-  iter->header->question_count	= htons(question_count);
-  iter->header->name_server_count = htons(authorative_count);
-  iter->header->answer_count		= htons(answer_count);
+  mdns_record_t *record = &records[service * MDNS_RECORD_COUNT + index];
+  return (record->primary >= 0) ? &records[record->primary] : record;
 }
 
+static bool mdns_service_active(const mdns_service_t *service)
+{
+  return service->in_use && (service->state == MDNS_STATE_ANNOUNCING || service->state == MDNS_STATE_RUNNING);
+}
 
-static void dns_write_record( dns_message_iterator_t* iter, const char* name, uint16_t record_class, uint16_t record_type, uint32_t ttl, uint8_t* rdata )
+static void mdns_set_record(mdns_record_t *record, uint8_t owner, uint16_t type, uint16_t rr_class, uint32_t ttl,
+                            uint8_t *rdata, uint16_t rdata_len, uint8_t rdata_name)
 {
-  uint8_t* rd_length;
-  uint8_t* temp_ptr;
-  
-  /* Write the name, type, class, TTL*/
-  dns_write_name	( iter, name );
-  dns_write_uint16( iter, record_type );
-  dns_write_uint16( iter, record_class );
-  dns_write_uint32( iter, ttl );
-  
-  /* Keep track of where we store the rdata length*/
-  rd_length	= iter->iter;
-  iter->iter += 2;
-  temp_ptr	= iter->iter;
-  
-  switch ( record_type )
-  {
-  case RR_TYPE_A:
-    dns_write_bytes( iter, rdata, 4 );
-    break;
-    
-  case RR_TYPE_PTR:
-  case RR_TYPE_TXT:
-    dns_write_name( iter, (const char*) rdata );
-    break;
-    
-  case RR_TYPE_SRV:
-    /* Set priority and weight to 0*/
-    dns_write_uint16( iter, 0 );
-    dns_write_uint16( iter, 0 );
-    
-    /* Write the port*/
-    dns_write_uint16( iter, ( (dns_sd_service_record_t*) rdata )->port );
-    
-    /* Write the hostname*/
-    dns_write_string( iter, ( (dns_sd_service_record_t*) rdata )->hostname );
-    break;
-  default:
-    break;
+  memset(record, 0, sizeof(mdns_record_t));
+  record->valid = true;
+  record->primary = -1;
+  record->owner = owner;
+  record->type = type;
+  record->rr_class = rr_class;
+  record->ttl = ttl;
+  WriteBig16(record->header, type);
+  WriteBig16(record->header + 2, rr_class);
+  WriteBig32(record->header + 4, ttl);
+  record->rdata = rdata;
+  record->rdata_len = rdata_len;
+  record->rdata_name = rdata_name;
+}
+
+/* Identical records of services on the same interface are only sent once */
+static void mdns_update_aliases(void)
+{
+  mdns_record_t *a, *b;
+  int i, j;
+
+  for (i = 0; i < MDNS_MAX_RECORDS; i++)
+    records[i].primary = -1;
+  for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+    a = &records[i];
+    if (!a->valid) continue;
+    for (j = 0; j < i; j++) {
+      b = &records[j];
+      if (!b->valid || b->primary >= 0) continue;
+      if (services[i / MDNS_RECORD_COUNT].interface != services[j / MDNS_RECORD_COUNT].interface) continue;
+      if (a->owner == b->owner && a->type == b->type && a->rdata_name == b->rdata_name &&
+          a->rdata_len == b->rdata_len && memcmp(a->rdata, b->rdata, a->rdata_len) == 0) {
+        a->primary = j;
+        break;
+      }
+    }
   }
-  // Write the rdata length
-  rd_length[0] = ( iter->iter - temp_ptr ) >> 8;
-  rd_length[1] = ( iter->iter - temp_ptr ) & 0xFF;
 }
 
-static void mdns_send_message(int fd, dns_message_iterator_t* message )
+static void mdns_service_release_names(mdns_service_t *service)
 {
-  struct sockaddr_t addr;
-  if(_suspend_MFi_bonjour == true)
-    return;
-  
-  addr.s_ip = inet_addr("224.0.0.251");
-  addr.s_port = 5353;
-  _debug_out("UDP multicast test: Send a mDNS respond!+++++++++++++++++++++++++++\r\n");
-  sendto(fd, message->header, message->iter - (uint8_t*)message->header, 0, &addr, sizeof(addr));
-  addr.s_ip = inet_addr("255.255.255.255");
-  addr.s_port = 5353;
-  sendto(fd, message->header, message->iter - (uint8_t*)message->header, 0, &addr, sizeof(addr));
+  mdns_name_release(service->service);
+  mdns_name_release(service->instance);
+  mdns_name_release(service->host);
+  service->service = service->instance = service->host = MDNS_NO_NAME;
 }
 
-static void dns_write_uint16( dns_message_iterator_t* iter, uint16_t data )
+/* Builds the names and records of a service from its strings and conflict suffixes */
+static OSStatus mdns_service_build(int index)
 {
-  // We cannot assume the u8 alignment of iter->iter so we can't just typecast and assign
-  iter->iter[0] = data >> 8;
-  iter->iter[1] = data & 0xFF;
-  iter->iter += 2;
+  OSStatus err = kNoErr;
+  mdns_service_t *service = &services[index];
+  mdns_record_t *record = &records[index * MDNS_RECORD_COUNT];
+  uint8_t *name = scratch_name;
+  char label[64 + 8];
+  int len, first_len;
+  int i;
+
+  for (i = 0; i < MDNS_RECORD_COUNT; i++)
+    record[i].valid = false;
+  mdns_service_release_names(service);
+  require_action(service->service_name && service->host_name && service->instance_name, exit, err = kParamErr);
+
+  len = mdns_name_from_string(service->service_name, name, MDNS_MAX_NAME_LEN, false);
+  require_action(len > 1, exit, err = kNameErr);
+  service->service = mdns_name_intern(name);
+  require_action(service->service != MDNS_NO_NAME, exit, err = kNoResourcesErr);
+
+  /* The instance name is a single label, "Name (2)" after a conflict */
+  if (service->instance_suffix > 1) snprintf(label, sizeof(label), "%.56s (%d)", service->instance_name, service->instance_suffix);
+  else                              snprintf(label, sizeof(label), "%.63s", service->instance_name);
+  first_len = mdns_name_from_string(label, name, MDNS_MAX_NAME_LEN, true) - 1;
+  require_action(first_len > 0, exit, err = kNameErr);
+  len = mdns_name_length(names[service->service].wire);
+  require_action(first_len + len <= MDNS_MAX_NAME_LEN, exit, err = kNameErr);
+  memcpy(name + first_len, names[service->service].wire, len);
+  service->instance = mdns_name_intern(name);
+  require_action(service->instance != MDNS_NO_NAME, exit, err = kNoResourcesErr);
+
+  /* "name-2.local" after a conflict */
+  len = mdns_name_from_string(service->host_name, name, MDNS_MAX_NAME_LEN, false);
+  require_action(len > 1, exit, err = kNameErr);
+  if (service->host_suffix > 1) {
+    first_len = name[0];
+    snprintf(label, sizeof(label), "-%d", service->host_suffix);
+    require_action(first_len + strlen(label) <= 63 && len + strlen(label) <= MDNS_MAX_NAME_LEN, exit, err = kNameErr);
+    memmove(name + 1 + first_len + strlen(label), name + 1 + first_len, len - 1 - first_len);
+    memcpy(name + 1 + first_len, label, strlen(label));
+    name[0] += strlen(label);
+  }
+  service->host = mdns_name_intern(name);
+  require_action(service->host != MDNS_NO_NAME, exit, err = kNoResourcesErr);
+
+  mdns_set_record(&record[MDNS_RECORD_SERVICES_PTR], services_query, RR_TYPE_PTR, RR_CLASS_IN, MDNS_SERVICE_TTL,
+                  NULL, 0, service->service);
+  mdns_set_record(&record[MDNS_RECORD_SERVICE_PTR], service->service, RR_TYPE_PTR, RR_CLASS_IN, MDNS_SERVICE_TTL,
+                  NULL, 0, service->instance);
+  mdns_set_record(&record[MDNS_RECORD_TXT], service->instance, RR_TYPE_TXT, RR_CACHE_FLUSH | RR_CLASS_IN, MDNS_SERVICE_TTL,
+                  service->txt, service->txt_len, MDNS_NO_NAME);
+  mdns_set_record(&record[MDNS_RECORD_SRV], service->instance, RR_TYPE_SRV, RR_CACHE_FLUSH | RR_CLASS_IN, MDNS_HOST_TTL,
+                  service->srv_rdata, 6, service->host);
+  mdns_set_record(&record[MDNS_RECORD_A], service->host, RR_TYPE_A, RR_CACHE_FLUSH | RR_CLASS_IN, MDNS_HOST_TTL,
+                  service->a_rdata, 4, MDNS_NO_NAME);
+
+exit:
+  if (err != kNoErr) {
+    mdns_utils_log("Build mDNS records failed, err = %d", err);
+    for (i = 0; i < MDNS_RECORD_COUNT; i++)
+      record[i].valid = false;
+    mdns_service_release_names(service);
+  }
+  mdns_update_aliases();
+  return err;
 }
 
-static void dns_write_uint32( dns_message_iterator_t* iter, uint32_t data )
+static void mdns_service_free(int index)
 {
-  iter->iter[0] = data >> 24;
-  iter->iter[1] = data >> 16;
-  iter->iter[2] = data >> 8;
-  iter->iter[3] = data & 0xFF;
-  iter->iter += 4;
+  mdns_service_t *service = &services[index];
+  int i;
+
+  for (i = 0; i < MDNS_RECORD_COUNT; i++)
+    records[index * MDNS_RECORD_COUNT + i].valid = false;
+  mdns_service_release_names(service);
+  if (service->service_name)  free(service->service_name);
+  if (service->host_name)     free(service->host_name);
+  if (service->instance_name) free(service->instance_name);
+  if (service->txt)           free(service->txt);
+  memset(service, 0, sizeof(mdns_service_t));
+  service->service = service->instance = service->host = MDNS_NO_NAME;
+  mdns_update_aliases();
 }
 
-static void dns_write_bytes( dns_message_iterator_t* iter, uint8_t* data, uint16_t length )
+static bool mdns_interface_address(WiFi_Interface interface, uint32_t *ip, uint32_t *mask)
 {
-  int a = 0;
-  
-  for ( a = 0; a < length; ++a )
-  {
-    iter->iter[a] = data[a];
+  IPStatusTypedef para;
+
+  micoWlanGetIPStatus(&para, interface);
+  *ip = inet_addr(para.ip);
+  if (mask) *mask = inet_addr(para.mask);
+  return *ip != 0 && *ip != 0xFFFFFFFF;
+}
+
+/* Refresh the A record, returns false if the interface has no address to publish */
+static bool mdns_update_address(mdns_service_t *service)
+{
+  uint32_t myip;
+
+  if (!mdns_interface_address(service->interface, &myip, NULL))
+    return false;
+  WriteBig32(service->a_rdata, myip);
+  return true;
+}
+
+/* Probing, announcing and goodbye */
+
+static void mdns_start_probing(int index, uint32_t delay)
+{
+  mdns_service_t *service = &services[index];
+  int i;
+
+  service->state = MDNS_STATE_PROBING;
+  service->state_count = 0;
+  service->state_time = mico_get_time() + delay;
+  for (i = 0; i < MDNS_RECORD_COUNT; i++)
+    records[index * MDNS_RECORD_COUNT + i].pending = false;
+}
+
+static void mdns_conflict(int index, bool host, bool instance)
+{
+  mdns_service_t *service = &services[index];
+  uint32_t now = mico_get_time();
+
+  if (now - service->conflict_time > MDNS_CONFLICT_WINDOW) {
+    service->conflict_time = now;
+    service->conflict_count = 0;
   }
-  iter->iter += length;
+  service->conflict_count++;
+  _stats.conflicts++;
+
+  if (host) service->host_suffix++;
+  if (instance) service->instance_suffix++;
+  mdns_utils_log("Name conflict, renamed to host suffix %d, instance suffix %d", service->host_suffix, service->instance_suffix);
+
+  if (mdns_service_build(index) == kNoErr)
+    mdns_start_probing(index, (service->conflict_count > MDNS_CONFLICT_LIMIT) ? MDNS_CONFLICT_BACKOFF : 0);
+  else
+    service->state = MDNS_STATE_IDLE;
 }
 
-static uint16_t dns_read_uint16( dns_message_iterator_t* iter )
+static void mdns_send_probe(int index)
 {
-  uint16_t temp = (uint16_t) ( *iter->iter++ ) << 8;
-  temp += (uint16_t) ( *iter->iter++ );
-  return temp;
+  mdns_service_t *service = &services[index];
+  mdns_message_t msg;
+  mdns_record_t *record;
+
+  mdns_message_init(&msg, 0, 0);
+  mdns_message_write_question(&msg, service->instance, NULL, RR_QTYPE_ANY, RR_CLASS_IN | RR_UNICAST_RESPONSE);
+  mdns_message_write_question(&msg, service->host, NULL, RR_QTYPE_ANY, RR_CLASS_IN | RR_UNICAST_RESPONSE);
+  record = mdns_service_record(index, MDNS_RECORD_TXT);
+  mdns_message_write_record(&msg, MDNS_SECTION_AUTHORITY, record, RR_CLASS_IN, record->ttl);
+  record = mdns_service_record(index, MDNS_RECORD_SRV);
+  mdns_message_write_record(&msg, MDNS_SECTION_AUTHORITY, record, RR_CLASS_IN, record->ttl);
+  record = mdns_service_record(index, MDNS_RECORD_A);
+  mdns_message_write_record(&msg, MDNS_SECTION_AUTHORITY, record, RR_CLASS_IN, record->ttl);
+  mdns_send_message(&msg, NULL);
 }
 
-static void dns_skip_name( dns_message_iterator_t* iter )
+/* Sends the records of a service selected by mask, with TTL 0 this says goodbye */
+static void mdns_send_service_records(int index, uint8_t mask, bool goodbye)
 {
-  while ( *iter->iter != 0 )
-  {
-    // Check if the name is compressed
-    if ( *iter->iter & 0xC0 )
-    {
-      iter->iter += 1; // Normally this should be 2, but we have a ++ outside the while loop
+  mdns_message_t msg;
+  mdns_record_t *record;
+  uint32_t now = mico_get_time();
+  int i;
+
+  mdns_message_init(&msg, 0, DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_AUTHORITATIVE);
+  for (i = 0; i < MDNS_RECORD_COUNT; i++) {
+    if (!(mask & (1 << i))) continue;
+    record = mdns_service_record(index, i);
+    if (!mdns_message_write_record(&msg, MDNS_SECTION_ANSWER, record, record->rr_class, goodbye ? 0 : record->ttl))
       break;
+    record->pending = false;
+    record->multicast = true;
+    record->last_multicast = now;
+  }
+  if (msg.counts[MDNS_SECTION_ANSWER])
+    mdns_send_message(&msg, NULL);
+}
+
+/* Runs the probe and announce schedule of a service, returns ms until its next step is due */
+static uint32_t mdns_run_state(int index, uint32_t now)
+{
+  mdns_service_t *service = &services[index];
+
+  if (!service->in_use || (service->state != MDNS_STATE_PROBING && service->state != MDNS_STATE_ANNOUNCING))
+    return MDNS_POLL_INTERVAL;
+  if ((int32_t)(service->state_time - now) > 0)
+    return service->state_time - now;
+  if (!mdns_update_address(service))
+    return MDNS_POLL_INTERVAL;
+
+  if (service->state == MDNS_STATE_PROBING) {
+    if (service->state_count < MDNS_PROBE_COUNT) {
+      mdns_send_probe(index);
+      service->state_count++;
+      service->state_time = now + MDNS_PROBE_INTERVAL;
+      return MDNS_PROBE_INTERVAL;
     }
-    else
-    {
-      iter->iter += (uint32_t) *iter->iter + 1;
+    /* Nobody objected, the names are ours */
+    service->state = MDNS_STATE_ANNOUNCING;
+    service->announce = MDNS_ALL_RECORDS;
+    service->state_count = 0;
+  }
+
+  mdns_send_service_records(index, service->announce, false);
+  service->state_count++;
+  if (service->state_count >= MDNS_ANNOUNCE_COUNT) {
+    service->state = MDNS_STATE_RUNNING;
+    service->announce = 0;
+    return MDNS_POLL_INTERVAL;
+  }
+  service->state_time = now + (MDNS_ANNOUNCE_INTERVAL << (service->state_count - 1));
+  return service->state_time - now;
+}
+
+/* Only the records in mask are announced again, e.g. just TXT after an update */
+static void mdns_announce(int index, uint8_t mask)
+{
+  mdns_service_t *service = &services[index];
+
+  if (service->state == MDNS_STATE_ANNOUNCING) {
+    service->announce |= mask;
+  } else if (service->state == MDNS_STATE_RUNNING) {
+    service->state = MDNS_STATE_ANNOUNCING;
+    service->announce = mask;
+    service->state_count = 0;
+    service->state_time = mico_get_time();
+  }
+}
+
+/* Takes ownership of txt */
+static void mdns_service_set_txt(int index, uint8_t *txt, uint16_t txt_len)
+{
+  mdns_service_t *service = &services[index];
+  mdns_record_t *record = &records[index * MDNS_RECORD_COUNT + MDNS_RECORD_TXT];
+
+  if (service->txt && txt_len == service->txt_len && memcmp(txt, service->txt, txt_len) == 0) {
+    free(txt);
+    return;
+  }
+  if (service->txt) free(service->txt);
+  service->txt = txt;
+  service->txt_len = txt_len;
+  record->rdata = txt;
+  record->rdata_len = txt_len;
+  record->pending = false;
+  record->multicast = false;
+  _stats.txt_updates++;
+  mdns_announce(index, 1 << MDNS_RECORD_TXT);
+}
+
+/* Answers */
+
+static void mdns_clear_answers(void)
+{
+  int i;
+  for (i = 0; i < MDNS_MAX_RECORDS; i++)
+    records[i].answer = 0;
+}
+
+/* Adds the records that belong with the answers that were written */
+static void mdns_write_additionals(mdns_message_t *msg)
+{
+  mdns_record_t *record;
+  uint8_t wanted;
+  int i, j;
+
+  for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+    if (!(records[i].answer & MDNS_ANSWER_WRITTEN)) continue;
+    wanted = additional_records[i % MDNS_RECORD_COUNT];
+    for (j = 0; j < MDNS_RECORD_COUNT; j++) {
+      if (!(wanted & (1 << j))) continue;
+      record = mdns_service_record(i / MDNS_RECORD_COUNT, j);
+      if (record->answer & (MDNS_ANSWER_WRITTEN | MDNS_ANSWER_ADDITIONAL | MDNS_ANSWER_SKIP)) continue;
+      if (mdns_message_write_record(msg, MDNS_SECTION_ADDITIONAL, record, record->rr_class, record->ttl))
+        record->answer |= MDNS_ANSWER_ADDITIONAL;
     }
-    if (iter->iter > iter->end)
+  }
+}
+
+/* Sends every scheduled multicast answer that is due, aggregated into as few packets as possible */
+static uint32_t mdns_send_pending(uint32_t now)
+{
+  mdns_message_t msg;
+  mdns_record_t *record;
+  uint32_t wait = MDNS_POLL_INTERVAL;
+  bool due = false;
+  bool more;
+  int written;
+  int i;
+
+  for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+    record = &records[i];
+    if (!record->pending) continue;
+    if (!mdns_update_address(&services[i / MDNS_RECORD_COUNT])) {
+      record->pending = false;
+      continue;
+    }
+    if ((int32_t)(record->send_time - now) <= 0) due = true;
+    else if (record->send_time - now < wait) wait = record->send_time - now;
+  }
+  if (!due) return wait;
+
+  /* Everything scheduled goes out now, answers that were due later just lose some of their delay */
+  do {
+    more = false;
+    written = 0;
+    mdns_message_init(&msg, 0, DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_AUTHORITATIVE);
+    mdns_clear_answers();
+    for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+      record = &records[i];
+      /* Additional records are multicast too, skip the ones that were just sent */
+      if (record->valid && record->multicast && now - record->last_multicast < MDNS_RATE_LIMIT)
+        record->answer |= MDNS_ANSWER_SKIP;
+      if (!record->pending) continue;
+      if (record->answer & MDNS_ANSWER_SKIP) {
+        /* Multicast by an announcement since it was scheduled */
+        record->pending = false;
+        _stats.rate_limited++;
+        continue;
+      }
+      if (!mdns_message_write_record(&msg, MDNS_SECTION_ANSWER, record, record->rr_class, record->ttl)) {
+        more = true;
+        continue;
+      }
+      record->answer |= MDNS_ANSWER_WRITTEN;
+      written++;
+    }
+    if (written == 0) {
+      /* Too large for a single message, drop it rather than retry forever */
+      for (i = 0; i < MDNS_MAX_RECORDS; i++) records[i].pending = false;
       break;
+    }
+
+    mdns_write_additionals(&msg);
+    mdns_send_message(&msg, NULL);
+
+    for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+      record = &records[i];
+      if (record->answer & MDNS_ANSWER_WRITTEN) record->pending = false;
+      if (record->answer & (MDNS_ANSWER_WRITTEN | MDNS_ANSWER_ADDITIONAL)) {
+        record->multicast = true;
+        record->last_multicast = now;
+      }
+    }
+  } while (more);
+
+  return MDNS_POLL_INTERVAL;
+}
+
+static void mdns_send_direct(const uint8_t *pkt, int len, uint8_t answer, const struct sockaddr_t *to)
+{
+  mdns_message_t msg;
+  mdns_record_t *record;
+  bool legacy = (answer == MDNS_ANSWER_LEGACY);
+  uint16_t rr_class;
+  uint32_t ttl;
+  int offset, qd, i;
+  mdns_rr_t rr;
+
+  mdns_message_init(&msg, legacy ? ReadBig16(pkt) : 0, DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_AUTHORITATIVE);
+
+  /* Legacy resolvers want their questions back */
+  if (legacy) {
+    qd = ReadBig16(pkt + 4);
+    offset = sizeof(dns_message_header_t);
+    for (i = 0; i < qd; i++) {
+      offset = mdns_read_name(pkt, len, offset, scratch_name, MDNS_MAX_NAME_LEN);
+      if (offset < 0 || offset + 4 > len) return;
+      rr.type = ReadBig16(pkt + offset);
+      rr.rr_class = ReadBig16(pkt + offset + 2);
+      offset += 4;
+      if (!mdns_message_write_question(&msg, MDNS_NO_NAME, scratch_name, rr.type, rr.rr_class & 0x7FFF)) return;
+    }
+  }
+
+  for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+    record = &records[i];
+    record->answer &= ~(MDNS_ANSWER_WRITTEN | MDNS_ANSWER_ADDITIONAL);
+    if (!(record->answer & answer)) continue;
+    rr_class = legacy ? (record->rr_class & ~RR_CACHE_FLUSH) : record->rr_class;
+    ttl = (legacy && record->ttl > MDNS_LEGACY_TTL) ? MDNS_LEGACY_TTL : record->ttl;
+    if (mdns_message_write_record(&msg, MDNS_SECTION_ANSWER, record, rr_class, ttl))
+      record->answer |= MDNS_ANSWER_WRITTEN;
   }
-  // Skip the null u8
-  ++iter->iter;
+  if (msg.counts[MDNS_SECTION_ANSWER] == 0) return;
+  if (!legacy) mdns_write_additionals(&msg);
+  mdns_send_message(&msg, to);
 }
 
-static void dns_write_name( dns_message_iterator_t* iter, const char* src )
+/* Services that can be reached from the sender, all of them if no interface subnet matches */
+static uint8_t mdns_reachable_interfaces(uint32_t from)
 {
-  dns_write_string( iter, src );
+  uint32_t ip, mask;
+  uint8_t result = 0;
+
+  if (mdns_interface_address(Station, &ip, &mask) && (ip & mask) == (from & mask))
+    result |= (1 << Station);
+  if (mdns_interface_address(Soft_AP, &ip, &mask) && (ip & mask) == (from & mask))
+    result |= (1 << Soft_AP);
+  return result ? result : 0xFF;
 }
 
+static void mdns_process_query(const uint8_t *pkt, int len, const struct sockaddr_t *from)
+{
+  uint16_t flags = ReadBig16(pkt + 2);
+  uint16_t qd = ReadBig16(pkt + 4);
+  uint16_t an = ReadBig16(pkt + 6);
+  uint16_t ns = ReadBig16(pkt + 8);
+  bool legacy = (from->s_port != MDNS_PORT);
+  uint8_t interfaces = mdns_reachable_interfaces(from->s_ip);
+  uint32_t now = mico_get_time();
+  uint32_t delay;
+  uint16_t qtype, qclass;
+  uint8_t unicast = 0, multicast = 0;
+  int offset = sizeof(dns_message_header_t);
+  int rdata_len;
+  int i, j, s;
+  mdns_record_t *record;
+  mdns_service_t *service;
+  mdns_rr_t rr;
+
+  _stats.queries_received++;
+  mdns_clear_answers();
+
+  for (i = 0; i < qd; i++) {
+    offset = mdns_read_name(pkt, len, offset, scratch_name, MDNS_MAX_NAME_LEN);
+    if (offset < 0 || offset + 4 > len) return;
+    qtype = ReadBig16(pkt + offset);
+    qclass = ReadBig16(pkt + offset + 2);
+    offset += 4;
+    if ((qclass & 0x7FFF) != RR_CLASS_IN && (qclass & 0x7FFF) != RR_CLASS_ALL) continue;
+
+    for (j = 0; j < MDNS_MAX_RECORDS; j++) {
+      record = &records[j];
+      service = &services[j / MDNS_RECORD_COUNT];
+      /* Nothing is answered until our names are confirmed */
+      if (!record->valid || record->primary >= 0 || !mdns_service_active(service) || !(interfaces & (1 << service->interface)))
+        continue;
+      if ((qtype == RR_QTYPE_ANY || qtype == record->type) && mdns_name_equal(names[record->owner].wire, scratch_name))
+        record->answer |= legacy ? MDNS_ANSWER_LEGACY : ((qclass & RR_UNICAST_RESPONSE) ? MDNS_ANSWER_UNICAST : MDNS_ANSWER_MULTICAST);
+    }
+  }
 
-void bonjour_service_init(bonjour_init_t init)
+  /* Known-answer suppression, RFC 6762 section 7.1 */
+  for (i = 0; i < an; i++) {
+    offset = mdns_read_rr(pkt, len, offset, scratch_name, &rr);
+    if (offset < 0) return;
+    for (j = 0; j < MDNS_MAX_RECORDS; j++) {
+      record = &records[j];
+      if (!record->answer || record->type != rr.type || rr.ttl < record->ttl / 2) continue;
+      if (!mdns_name_equal(names[record->owner].wire, scratch_name)) continue;
+      rdata_len = mdns_read_rdata(pkt, len, &rr, scratch_rdata, sizeof(scratch_rdata));
+      if (rdata_len >= 0 && mdns_rdata_equal(record, scratch_rdata, rdata_len)) {
+        record->answer = 0;
+        _stats.known_answer_suppressed++;
+      }
+    }
+  }
+
+  /* Simultaneous probe tie-break, RFC 6762 section 8.2: compare with our first record of the same name */
+  for (i = 0; i < ns; i++) {
+    offset = mdns_read_rr(pkt, len, offset, scratch_name, &rr);
+    if (offset < 0) return;
+    rdata_len = mdns_read_rdata(pkt, len, &rr, scratch_rdata, sizeof(scratch_rdata));
+    if (rdata_len < 0) continue;
+    for (s = 0; s < MDNS_MAX_SERVICES; s++) {
+      service = &services[s];
+      if (!service->in_use || service->state != MDNS_STATE_PROBING) continue;
+      for (j = 0; j < MDNS_RECORD_COUNT; j++) {
+        record = mdns_service_record(s, j);
+        if (!(record->rr_class & RR_CACHE_FLUSH) || !mdns_name_equal(names[record->owner].wire, scratch_name)) continue;
+        if (mdns_record_compare(record, &rr, scratch_rdata, rdata_len) < 0) {
+          mdns_utils_log("Lost simultaneous probe, probing again");
+          mdns_start_probing(s, MDNS_PROBE_DEFER);
+        }
+        break;
+      }
+    }
+  }
+
+  for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+    record = &records[i];
+    /* A unicast reply is only worth it if the record was multicast within a quarter of its TTL */
+    if ((record->answer & MDNS_ANSWER_UNICAST) &&
+        !(record->multicast && now - record->last_multicast < record->ttl * 250)) {
+      record->answer = (record->answer & ~MDNS_ANSWER_UNICAST) | MDNS_ANSWER_MULTICAST;
+    }
+    if (record->answer && !mdns_update_address(&services[i / MDNS_RECORD_COUNT]))
+      record->answer = 0;
+    unicast |= record->answer & (MDNS_ANSWER_UNICAST | MDNS_ANSWER_LEGACY);
+    multicast |= record->answer & MDNS_ANSWER_MULTICAST;
+  }
+
+  if (unicast & MDNS_ANSWER_LEGACY) mdns_send_direct(pkt, len, MDNS_ANSWER_LEGACY, from);
+  if (unicast & MDNS_ANSWER_UNICAST) {
+    struct sockaddr_t to = *from;
+    to.s_port = MDNS_PORT;
+    mdns_send_direct(pkt, len, MDNS_ANSWER_UNICAST, &to);
+  }
+
+  if (multicast) {
+    for (i = 0; i < MDNS_MAX_RECORDS; i++) {
+      record = &records[i];
+      if (!(record->answer & MDNS_ANSWER_MULTICAST)) continue;
+      if (flags & DNS_MESSAGE_TRUNCATION)
+        delay = mdns_random_delay(MDNS_TRUNCATED_DELAY_MIN, MDNS_TRUNCATED_DELAY_MAX);
+      else if (record->rr_class & RR_CACHE_FLUSH)
+        delay = 0;
+      else
+        delay = mdns_random_delay(MDNS_SHARED_DELAY_MIN, MDNS_SHARED_DELAY_MAX);
+
+      /* At most one multicast per record per second */
+      if (record->multicast && now + delay - record->last_multicast < MDNS_RATE_LIMIT) {
+        delay = record->last_multicast + MDNS_RATE_LIMIT - now;
+        _stats.rate_limited++;
+      }
+      if (!record->pending || (int32_t)(record->send_time - (now + delay)) > 0) {
+        record->send_time = now + delay;
+        record->pending = true;
+      }
+    }
+  }
+}
+
+static void mdns_process_response(const uint8_t *pkt, int len)
 {
-  int len;
-  IPStatusTypedef para;
+  int count = ReadBig16(pkt + 6) + ReadBig16(pkt + 8) + ReadBig16(pkt + 10);
+  int offset = sizeof(dns_message_header_t);
+  int rdata_len;
+  int i, j;
+  mdns_record_t *record;
+  mdns_service_t *service;
+  mdns_rr_t rr;
+
+  /* Skip questions, responses normally have none */
+  for (i = ReadBig16(pkt + 4); i > 0; i--) {
+    offset = mdns_read_name(pkt, len, offset, scratch_name, MDNS_MAX_NAME_LEN);
+    if (offset < 0 || offset + 4 > len) return;
+    offset += 4;
+  }
 
-  _interface = init.interface;
+  for (i = 0; i < count; i++) {
+    offset = mdns_read_rr(pkt, len, offset, scratch_name, &rr);
+    if (offset < 0) return;
+    rdata_len = mdns_read_rdata(pkt, len, &rr, scratch_rdata, sizeof(scratch_rdata));
+    if (rdata_len < 0) continue;
+
+    for (j = 0; j < MDNS_MAX_RECORDS; j++) {
+      record = &records[j];
+      service = &services[j / MDNS_RECORD_COUNT];
+      if (!record->valid || !service->in_use || service->state == MDNS_STATE_IDLE) continue;
+      if (!mdns_name_equal(names[record->owner].wire, scratch_name)) continue;
+
+      if (record->rr_class & RR_CACHE_FLUSH) {
+        if (service->state == MDNS_STATE_PROBING) {
+          /* Someone already owns this name */
+          mdns_conflict(j / MDNS_RECORD_COUNT, record->owner == service->host, record->owner == service->instance);
+          continue;
+        }
+        if (record->type == rr.type && !mdns_rdata_equal(record, scratch_rdata, rdata_len)) {
+          /* Different data for one of our unique records, probe again to find out who is right */
+          mdns_utils_log("Conflicting record received, probing again");
+          _stats.conflicts++;
+          mdns_start_probing(j / MDNS_RECORD_COUNT, 0);
+          continue;
+        }
+      }
 
-  if(bonjour_mutex == NULL)
-    mico_rtos_init_mutex( &bonjour_mutex );
+      /* Duplicate answer suppression, RFC 6762 section 7.4 */
+      if (record->pending && record->type == rr.type && rr.ttl >= record->ttl / 2 &&
+          mdns_rdata_equal(record, scratch_rdata, rdata_len)) {
+        record->pending = false;
+        _stats.duplicate_suppressed++;
+      }
+    }
+  }
+}
 
+static void mfi_mdns_handler(int fd, uint8_t* pkt, int pkt_len, struct sockaddr_t *from)
+{
+  uint32_t ip;
+  (void)fd;
 
-  mico_rtos_lock_mutex( &bonjour_mutex );
-  if(available_services) {
-    //suspend_bonjour_service(ENABLE);
-    if(available_services->service_name)  free(available_services->service_name);
-    if(available_services->hostname)  free(available_services->hostname);
-    if(available_services->instance_name)  free(available_services->instance_name);
-    if(available_services->txt_att)  free(available_services->txt_att);
-    free(available_services);
+  if (pkt_len < (int)sizeof(dns_message_header_t) || _suspended)
+    return;
+  if (ReadBig16(pkt + 2) & DNS_MESSAGE_OPCODE)
+    return;
+
+  if (ReadBig16(pkt + 2) & DNS_MESSAGE_IS_A_RESPONSE) {
+    /* Our own multicasts loop back */
+    if ((mdns_interface_address(Station, &ip, NULL) && from->s_ip == ip) ||
+        (mdns_interface_address(Soft_AP, &ip, NULL) && from->s_ip == ip))
+      return;
+    mdns_process_response(pkt, pkt_len);
+  } else {
+    mdns_process_query(pkt, pkt_len, from);
+  }
+}
+
+/* Goodbye for the records of a service, unless shared is false and another service still publishes them.
+   Returns false if nothing was sent */
+static bool mdns_service_goodbye(int index, bool shared)
+{
+  mdns_record_t *record;
+  uint8_t mask = 0;
+  int i, j;
+
+  if (!mdns_service_active(&services[index]) || !IsValidSocket(mDNS_fd) || !mdns_update_address(&services[index]))
+    return false;
+  for (i = 0; i < MDNS_RECORD_COUNT; i++) {
+    record = &records[index * MDNS_RECORD_COUNT + i];
+    if (record->primary >= 0) continue;
+    for (j = 0; !shared && j < MDNS_MAX_RECORDS; j++) {
+      if (records[j].primary == index * MDNS_RECORD_COUNT + i) break;
+    }
+    if (shared || j == MDNS_MAX_RECORDS) mask |= (1 << i);
   }
+  if (mask == 0) return false;
 
-  micoWlanGetIPStatus(&para, _interface);
+  mdns_send_service_records(index, mask, true);
+  return true;
+}
+
+static void mdns_init(void)
+{
+  int i;
 
-  available_service_count = 1;
-  available_services = (void *)malloc(sizeof(dns_sd_service_record_t) * 1);
-  memset(available_services, 0x0, sizeof(dns_sd_service_record_t) * 1);
+  if (bonjour_mutex != NULL)
+    return;
+  mico_rtos_init_mutex( &bonjour_mutex );
+  for (i = 0; i < MDNS_MAX_SERVICES; i++)
+    services[i].service = services[i].instance = services[i].host = MDNS_NO_NAME;
+  services_query = mdns_name_intern(services_query_name);
+}
 
-  available_services->service_name = (char*)__strdup(init.service_name);
+OSStatus bonjour_service_register(bonjour_init_t init, int *handle)
+{
+  OSStatus err = kNoErr;
+  mdns_service_t *service = NULL;
+  uint8_t *txt = NULL;
+  int index;
+  int len;
 
-  available_services->hostname = (char*)__strdup(init.host_name);
+  mdns_init();
+  mico_rtos_lock_mutex( &bonjour_mutex );
+  for (index = 0; index < MDNS_MAX_SERVICES; index++) {
+    if (!services[index].in_use) break;
+  }
+  require_action(index < MDNS_MAX_SERVICES, exit, err = kNoResourcesErr);
+  service = &services[index];
+
+  len = mdns_txt_from_string(init.txt_record, tx_buf, sizeof(tx_buf));
+  require_action(len > 0, exit, err = kSizeErr);
+  txt = malloc(len);
+  require_action(txt, exit, err = kNoMemoryErr);
+  memcpy(txt, tx_buf, len);
+
+  service->in_use = true;
+  service->interface = init.interface;
+  service->service_name = (char*)__strdup(init.service_name);
+  service->host_name = (char*)__strdup(init.host_name);
+  service->txt = txt;
+  service->txt_len = len;
+  WriteBig16(service->srv_rdata + 4, init.service_port);
+  service->host_suffix = 1;
+  service->instance_suffix = 1;
+
+  /* Callers used to end the instance name with '.' */
+  service->instance_name = (char*)__strdup(init.instance_name);
+  if (service->instance_name) {
+    len = strlen(service->instance_name);
+    if (len > 1 && service->instance_name[len - 1] == '.') service->instance_name[len - 1] = 0;
+  }
 
-  len = strlen(init.instance_name);
-  available_services->instance_name = (char*)malloc(len+3);//// 0xc00c+\0
-  memcpy(available_services->instance_name, init.instance_name, len);
-  available_services->instance_name[len]= 0xc0;
-  available_services->instance_name[len+1]= 0x0c;
-  available_services->instance_name[len+2]= 0;
-  
-  available_services->txt_att = (char*)__strdup(init.txt_record);
+  err = mdns_service_build(index);
+  require_noerr(err, exit);
+  if (!_suspended)
+    mdns_start_probing(index, mdns_random_delay(0, MDNS_PROBE_INTERVAL));
+  if (handle) *handle = index;
 
-  available_services->port = init.service_port;
+exit:
+  if (err != kNoErr && service) {
+    if (service->in_use) mdns_service_free(index);
+    else if (txt) free(txt);
+  }
   mico_rtos_unlock_mutex( &bonjour_mutex );
+  return err;
 }
 
-void bonjour_update_txt_record(char *txt_record)
+void bonjour_service_unregister(int handle)
 {
-  
+  if (handle < 0 || handle >= MDNS_MAX_SERVICES || bonjour_mutex == NULL)
+    return;
   mico_rtos_lock_mutex( &bonjour_mutex );
-  if(available_services->txt_att)  free(available_services->txt_att);
-  
-  available_services->txt_att = (char*)__strdup(txt_record);
-
-  _bonjour_announce = 1;
+  if (services[handle].in_use) {
+    /* Sent twice as there is no retry */
+    if (mdns_service_goodbye(handle, false)) {
+      mico_thread_msleep(20);
+      mdns_service_goodbye(handle, false);
+    }
+    mdns_service_free(handle);
+  }
+  if (handle == default_service)
+    default_service = -1;
   mico_rtos_unlock_mutex( &bonjour_mutex );
+}
 
+OSStatus bonjour_service_update_txt(int handle, char *txt_record)
+{
+  OSStatus err = kNoErr;
+  uint8_t *txt = NULL;
+  int len;
+
+  require_action(handle >= 0 && handle < MDNS_MAX_SERVICES && bonjour_mutex, exit_unlocked, err = kParamErr);
+  mico_rtos_lock_mutex( &bonjour_mutex );
+  require_action(services[handle].in_use, exit, err = kNotFoundErr);
+
+  len = mdns_txt_from_string(txt_record, tx_buf, sizeof(tx_buf));
+  require_action(len > 0, exit, err = kSizeErr);
+  txt = malloc(len);
+  require_action(txt, exit, err = kNoMemoryErr);
+  memcpy(txt, tx_buf, len);
+  mdns_service_set_txt(handle, txt, len);
+
+exit:
+  mico_rtos_unlock_mutex( &bonjour_mutex );
+exit_unlocked:
+  return err;
 }
 
-void mfi_mdns_handler(int fd, uint8_t* pkt, int pkt_len)
+OSStatus bonjour_service_set_txt_value(int handle, const char *key, const char *value)
 {
+  OSStatus err = kNoErr;
+  mdns_service_t *service;
+  uint8_t *txt = NULL;
+  const uint8_t *string;
+  int key_len, entry_len;
+  int len = 0, offset;
+  bool found = false;
+
+  require_action(handle >= 0 && handle < MDNS_MAX_SERVICES && bonjour_mutex && key, exit_unlocked, err = kParamErr);
+  key_len = strlen(key);
+  entry_len = key_len + (value ? 1 + strlen(value) : 0);
+  require_action(key_len > 0 && entry_len <= 255, exit_unlocked, err = kSizeErr);
 
-  dns_message_iterator_t iter;
-  
-  iter.header = (dns_message_header_t*) pkt;
-  iter.iter   = (uint8_t*) iter.header + sizeof(dns_message_header_t);
-  iter.end = pkt+pkt_len;
-  
-  // Check if the message is a response (otherwise its a query)
-  if ( ntohs(iter.header->flags) & DNS_MESSAGE_IS_A_RESPONSE )
-  {
+  mico_rtos_lock_mutex( &bonjour_mutex );
+  service = &services[handle];
+  require_action(service->in_use, exit, err = kNotFoundErr);
+
+  txt = malloc(service->txt_len + 1 + entry_len);
+  require_action(txt, exit, err = kNoMemoryErr);
+
+  /* Copy the other strings as they are, the key keeps its position */
+  for (offset = 0; offset < service->txt_len; offset += 1 + string[0]) {
+    string = service->txt + offset;
+    if (string[0] == 0) continue;
+    if (string[0] >= key_len && strnicmp((const char *)string + 1, key, key_len) == 0 &&
+        (string[0] == key_len || string[1 + key_len] == '=')) {
+      if (found) continue;
+      found = true;
+    } else {
+      memcpy(txt + len, string, 1 + string[0]);
+      len += 1 + string[0];
+      continue;
+    }
+    txt[len++] = entry_len;
+    memcpy(txt + len, key, key_len);
+    if (value) {
+      txt[len + key_len] = '=';
+      memcpy(txt + len + key_len + 1, value, entry_len - key_len - 1);
+    }
+    len += entry_len;
   }
-  else
-  {
-    process_dns_questions(fd, &iter );
+  if (!found) {
+    txt[len++] = entry_len;
+    memcpy(txt + len, key, key_len);
+    if (value) {
+      txt[len + key_len] = '=';
+      memcpy(txt + len + key_len + 1, value, entry_len - key_len - 1);
+    }
+    len += entry_len;
   }
+  mdns_service_set_txt(handle, txt, len);
+
+exit:
+  mico_rtos_unlock_mutex( &bonjour_mutex );
+exit_unlocked:
+  return err;
 }
 
-void mfi_bonjour_send(int fd)
+void bonjour_service_init(bonjour_init_t init)
 {
-  dns_message_iterator_t response;
-  uint32_t myip;
-  IPStatusTypedef para;
-  micoWlanGetIPStatus(&para, _interface);
-  myip = htonl(inet_addr(para.ip));
-  if(myip == 0) return;
-  int b = 0;
-    
-  if(dns_create_message( &response, 512 )) {
-    dns_write_header(&response, 0x0, 0x8400, 0, available_service_count, 0 );          
-    for ( b = 0; b < available_service_count; ++b ){
-      dns_write_record( &response, MFi_SERVICE_QUERY_NAME, RR_CLASS_IN, RR_TYPE_PTR, 1500, (uint8_t*) available_services[b].service_name );
-    }
-    mdns_send_message(fd, &response );
-    dns_free_message( &response );
-  }
-
-  for ( b = 0; b < available_service_count; ++b ){
-      if(dns_create_message( &response, 512 )){
-        dns_write_header( &response, 0x0, 0x8400, 0, 4, 0 );
-        dns_write_record( &response, available_services[b].service_name, RR_CLASS_IN, RR_TYPE_PTR, 1500, (uint8_t*) available_services[b].instance_name );
-        dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_TXT, 1500, (uint8_t*) available_services[b].txt_att );
-        dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_SRV, 1500, (uint8_t*) &available_services[b]);
-        dns_write_record( &response, available_services[b].hostname, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_A, 1500, (uint8_t*) &myip);
-        mdns_send_message(fd, &response );
-        dns_free_message( &response );
-      }
+  int handle;
+
+  /* Replaces the service of the previous call, names are probed again */
+  if (default_service >= 0) {
+    mico_rtos_lock_mutex( &bonjour_mutex );
+    mdns_service_free(default_service);
+    default_service = -1;
+    mico_rtos_unlock_mutex( &bonjour_mutex );
   }
+  if (bonjour_service_register(init, &handle) == kNoErr)
+    default_service = handle;
 }
 
+void bonjour_update_txt_record(char *txt_record)
+{
+  bonjour_service_update_txt(default_service, txt_record);
+}
 
-void mfi_bonjour_remove_record(int fd)
+void bonjour_update_txt_value(const char *key, const char *value)
 {
-  dns_message_iterator_t response;
-  uint32_t myip;
-  IPStatusTypedef para;
-  micoWlanGetIPStatus(&para, _interface);
-  myip = htonl(inet_addr(para.ip));
-  int b = 0;
-
-  for ( b = 0; b < available_service_count; ++b ){
-    if(dns_create_message( &response, 512 )){
-      dns_write_header( &response, 0x0, 0x8400, 0, 4, 0 );
-      dns_write_record( &response, available_services[b].service_name, RR_CLASS_IN, RR_TYPE_PTR, 0, (uint8_t*) available_services[b].instance_name );
-      dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_TXT, 0, (uint8_t*) available_services[b].txt_att );
-      dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_SRV, 0, (uint8_t*) &available_services[b]);
-      dns_write_record( &response, available_services[b].hostname, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_A, 0, (uint8_t*) &myip);
-      mdns_send_message(fd, &response );
-      mico_thread_msleep(20);
-      mdns_send_message(fd, &response );
-      dns_free_message( &response );
-    }
+  bonjour_service_set_txt_value(default_service, key, value);
+}
+
+void bonjour_get_stats(bonjour_stats_t *stats)
+{
+  if(bonjour_mutex == NULL) {
+    memset(stats, 0, sizeof(bonjour_stats_t));
+    return;
   }
+  mico_rtos_lock_mutex( &bonjour_mutex );
+  memcpy(stats, &_stats, sizeof(bonjour_stats_t));
+  mico_rtos_unlock_mutex( &bonjour_mutex );
 }
 
 int start_bonjour_service(void)
 {
+  mdns_init();
+  suspend_bonjour_service(false);
   return mico_rtos_create_thread(&mfi_bonjour_thread_handler, MICO_APPLICATION_PRIORITY, "Bonjour", _bonjour_thread, 0x500, NULL );
 }
 
 void suspend_bonjour_service(bool state)
 {
+  bool sent = false;
+  int i;
+
+  mdns_init();
   mico_rtos_lock_mutex( &bonjour_mutex );
-  if(state == true){
-    _bonjour_announce = 0;
-    mfi_bonjour_remove_record(mDNS_fd);
+  if (state == true) {
+    /* Goodbye packets, sent twice as there is no retry */
+    for (i = 0; i < MDNS_MAX_SERVICES; i++)
+      sent |= mdns_service_goodbye(i, true);
+    if (sent) mico_thread_msleep(20);
+    for (i = 0; i < MDNS_MAX_SERVICES; i++) {
+      if (sent) mdns_service_goodbye(i, true);
+      services[i].state = MDNS_STATE_IDLE;
+    }
   }
-  else{
-    _bonjour_announce = 1;
-    _bonjour_announce_time = 0;
+  else {
+    /* The network may have changed, the names have to be confirmed again */
+    for (i = 0; i < MDNS_MAX_SERVICES; i++) {
+      if (services[i].in_use)
+        mdns_start_probing(i, mdns_random_delay(0, MDNS_PROBE_INTERVAL));
+    }
   }
+  _suspended = state;
   mico_rtos_unlock_mutex( &bonjour_mutex );
 }
 
@@ -634,50 +1464,51 @@ void _bonjour_thread(void *arg)
   struct sockaddr_t addr;
   socklen_t addrLen;
   uint32_t opt;
+  uint32_t now, wait, next;
+  int i;
   (void)arg;
   OSStatus err;
   
-  buf = malloc(1500);
-  
-  t.tv_sec = 1;
-  t.tv_usec = 0;
+  buf = malloc(MDNS_MAX_MESSAGE_LEN);
+  require_action(buf, exit, err = kNoMemoryErr);
   
   mDNS_fd = socket(AF_INET, SOCK_DGRM, IPPROTO_UDP);
   require_action(IsValidSocket( mDNS_fd ), exit, err = kNoResourcesErr );
-  opt = 0xE00000FB; //"224.0.0.251"
+  opt = MDNS_MULTICAST_ADDR; //"224.0.0.251"
   setsockopt(mDNS_fd, SOL_SOCKET, IP_ADD_MEMBERSHIP, &opt, 4);
-  addr.s_port = 5353;
+  addr.s_port = MDNS_PORT;
   addr.s_ip = INADDR_ANY;
   err = bind(mDNS_fd, &addr, sizeof(addr));
   require_noerr(err, exit);
 
-  _bonjour_announce = 1;
-  
   while(1) {
-    /*Send bonjour info when wifi is connected */
-    if(_bonjour_announce){
-      mico_rtos_lock_mutex( &bonjour_mutex );
-      mfi_bonjour_send(mDNS_fd);
-     
-      _bonjour_announce_time ++;
-      if(_bonjour_announce_time > 1){
-        _bonjour_announce_time = 0;
-        _bonjour_announce = 0;
-      }
-      mico_rtos_unlock_mutex( &bonjour_mutex );
+    /* Probe and announce schedules, then answers that are due */
+    mico_rtos_lock_mutex( &bonjour_mutex );
+    now = mico_get_time();
+    wait = mdns_send_pending(now);
+    for (i = 0; i < MDNS_MAX_SERVICES; i++) {
+      next = mdns_run_state(i, now);
+      if (next < wait) wait = next;
     }
+    mico_rtos_unlock_mutex( &bonjour_mutex );
+
+    t.tv_sec = wait / 1000;
+    t.tv_usec = (wait % 1000) * 1000;
 
     /*Check status on erery sockets on bonjour query */
     FD_ZERO(&readfds);
     FD_SET(mDNS_fd, &readfds);
     select(mDNS_fd+1, &readfds, NULL, NULL, &t);
     
-    /*Read data from udp and send data back */ 
+    /*Read data from udp and answer it */ 
     if (FD_ISSET(mDNS_fd, &readfds)) {
-      con = recvfrom(mDNS_fd, buf, 1500, 0, &addr, &addrLen); 
-      mico_rtos_lock_mutex( &bonjour_mutex );
-      mfi_mdns_handler(mDNS_fd, (uint8_t *)buf, con);
-      mico_rtos_unlock_mutex( &bonjour_mutex );
+      addrLen = sizeof(addr);
+      con = recvfrom(mDNS_fd, buf, MDNS_MAX_MESSAGE_LEN, 0, &addr, &addrLen); 
+      if (con > 0) {
+        mico_rtos_lock_mutex( &bonjour_mutex );
+        mfi_mdns_handler(mDNS_fd, (uint8_t *)buf, con, &addr);
+        mico_rtos_unlock_mutex( &bonjour_mutex );
+      }
     }
   }
 exit:
@@ -685,6 +1516,3 @@ exit:
   if(buf) free(buf);
   mico_rtos_delete_thread(NULL);
 }
-
-
-
@@ -83,18 +83,28 @@ typedef enum
     RR_CLASS_ALL = 255
 } dns_resource_record_class_t;
 
-#define RR_CACHE_FLUSH   0x8000
+#define RR_CACHE_FLUSH        0x8000    // In the class of a record
+#define RR_UNICAST_RESPONSE   0x8000    // In the class of a question
+
+/* Largest message sent or received, fits an Ethernet MTU */
+#if !defined MDNS_MAX_MESSAGE_LEN
+#define MDNS_MAX_MESSAGE_LEN  1472
+#endif
+
+/* Services that can be registered at the same time, on any interface */
+#if !defined MDNS_MAX_SERVICES
+#define MDNS_MAX_SERVICES     4
+#endif
+
+/* Multicast responses are also sent to 255.255.255.255 for stations that drop multicast */
+#if !defined MDNS_SEND_BROADCAST_COPY
+#define MDNS_SEND_BROADCAST_COPY  1
+#endif
 
 /**************************************************************************************************************
  * STRUCTURES
  **************************************************************************************************************/
 
-typedef struct
-{
-  uint8_t* start_of_name;
-  uint8_t* start_of_packet; // Used for compressed names;
-} dns_name_t;
-
 typedef struct
 {
   uint16_t id;
@@ -105,28 +115,6 @@ typedef struct
   uint16_t additional_record_count;
 } dns_message_header_t;
 
-typedef struct
-{
-    dns_message_header_t* header; // Also used as start of packet for compressed names
-    uint8_t* iter;
-    uint8_t* end;
-} dns_message_iterator_t;
-
-typedef struct
-{
-  uint16_t question_type;
-  uint16_t question_class;
-} dns_question_t;
-
-typedef struct
-{
-  uint16_t record_type;
-  uint16_t record_class;
-  uint32_t ttl;
-  uint16_t rd_length;
-  dns_message_iterator_t rdata;
-} dns_record_t;
-
 
 typedef struct
 {
@@ -139,14 +127,42 @@ typedef struct
   WiFi_Interface interface;
 } bonjour_init_t;
 
+typedef struct
+{
+  uint32_t queries_received;
+  uint32_t packets_sent;
+  uint32_t bytes_sent;
+  uint32_t records_sent;            // Answers, authority and additional records
+  uint32_t known_answer_suppressed; // Answers the querier already had
+  uint32_t duplicate_suppressed;    // Scheduled answers another responder sent first
+  uint32_t rate_limited;            // Multicasts delayed or dropped by the one second limit
+  uint32_t conflicts;
+  uint32_t txt_updates;             // TXT changes, each one re-announces only the TXT record
+} bonjour_stats_t;
+
+/* Registers or replaces the default service */
 void bonjour_service_init(bonjour_init_t init);
 
 void bonjour_update_txt_record(char *txt_record);
 
+void bonjour_update_txt_value(const char *key, const char *value);
+
+/* Additional services, each one is probed and announced on its own interface */
+OSStatus bonjour_service_register(bonjour_init_t init, int *handle);
+
+void bonjour_service_unregister(int handle);
+
+OSStatus bonjour_service_update_txt(int handle, char *txt_record);
+
+/* Replaces the "key=value" string of the TXT record, or adds it. A NULL value publishes a boolean key */
+OSStatus bonjour_service_set_txt_value(int handle, const char *key, const char *value);
+
 int start_bonjour_service(void);
 
 void suspend_bonjour_service(bool state);
 
+void bonjour_get_stats(bonjour_stats_t *stats);
+
 void stop_bonjour_service(void);
 
 
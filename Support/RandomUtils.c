@@ -0,0 +1,492 @@
+/**
+  ******************************************************************************
+  * @file    RandomUtils.c
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This file provide the ChaCha20 based random number generator
+  *          seeded from MicoRandomNumberRead.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#include "RandomUtils.h"
+
+#include "Debug.h"
+#include "SecurityUtils.h"
+#include "CryptoProvider.h"
+#include "MicoPlatform.h"
+#include "MICORTOS.h"
+
+#define random_log(M, ...) custom_log("Random", M, ##__VA_ARGS__)
+#define random_log_trace() custom_log_trace("Random")
+
+#define kRandomSeedBytes            32
+#define kRandomStartupTestBytes     1024
+#define kRandomRCTCutoff            6       // 1 + ceil( 20 / H ) with H = 4 bits of min-entropy per byte.
+#define kRandomAPTWindow            512
+#define kRandomAPTCutoff            62      // Binomial( 511, 2^-4 ) only exceeds this with probability < 2^-20.
+
+#define ChaCha20QuarterRound( A, B, C, D ) \
+    do \
+    { \
+        A += B; D ^= A; D = ROTL32( D, 16 ); \
+        C += D; B ^= C; B = ROTL32( B, 12 ); \
+        A += B; D ^= A; D = ROTL32( D,  8 ); \
+        C += D; B ^= C; B = ROTL32( B,  7 ); \
+    \
+    }   while( 0 )
+
+#if 0
+#pragma mark == Structures ==
+#endif
+
+typedef struct
+{
+    bool            seeded;
+    bool            failed;                     // A health test failed, no more output until reboot.
+    uint32_t        key[ 8 ];
+    uint32_t        bytesSinceReseed;
+    uint32_t        reseedTime;
+
+    // Continuous health tests on the raw platform RNG output, they carry on across reseeds.
+    uint8_t         rctLast;
+    uint32_t        rctCount;
+    uint8_t         aptFirst;
+    uint32_t        aptCount;
+    uint32_t        aptIndex;
+
+    RandomStats     stats;
+
+}   RandomState;
+
+static RandomState      gRandom;
+
+// RFC 7539 section 2.3.2: key 00..1f, nonce 00:00:00:09:00:00:00:4a:00:00:00:00, block counter 1.
+static const uint32_t   kChaCha20TestNonce[ 3 ] = { 0x09000000, 0x4A000000, 0x00000000 };
+static const uint32_t   kChaCha20TestBlock[ 16 ] =
+{
+    0xE4E7F110, 0x15593BD1, 0x1FDD0F50, 0xC47120A3, 0xC7F4D1C7, 0x0368C033, 0x9AAA2204, 0x4E6CD4C3,
+    0x466482D2, 0x09AA9F07, 0x05D7C214, 0xA2028BD9, 0xD19C12B5, 0xB94E16DE, 0xE883D0CB, 0x4E3C50A2
+};
+
+#if 0
+#pragma mark == ChaCha20 ==
+#endif
+
+//===========================================================================================================================
+//  _ChaCha20Block
+//
+//  One 64 byte ChaCha20 block (RFC 7539 layout). A NULL nonce is all zeros, which is fine here because every key is
+//  used for a single request only.
+//===========================================================================================================================
+
+static void _ChaCha20Block( const uint32_t inKey[ 8 ], uint32_t inCounter, const uint32_t *inNonce, uint32_t outBlock[ 16 ] )
+{
+    uint32_t        x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+    uint32_t        n0, n1, n2;
+    int             i;
+
+    n0 = inNonce ? inNonce[ 0 ] : 0;
+    n1 = inNonce ? inNonce[ 1 ] : 0;
+    n2 = inNonce ? inNonce[ 2 ] : 0;
+
+    x0  = 0x61707865; x1  = 0x3320646E; x2  = 0x79622D32; x3  = 0x6B206574;
+    x4  = inKey[ 0 ]; x5  = inKey[ 1 ]; x6  = inKey[ 2 ]; x7  = inKey[ 3 ];
+    x8  = inKey[ 4 ]; x9  = inKey[ 5 ]; x10 = inKey[ 6 ]; x11 = inKey[ 7 ];
+    x12 = inCounter;  x13 = n0;         x14 = n1;         x15 = n2;
+
+    for( i = 0; i < 10; ++i )
+    {
+        ChaCha20QuarterRound( x0, x4, x8,  x12 );
+        ChaCha20QuarterRound( x1, x5, x9,  x13 );
+        ChaCha20QuarterRound( x2, x6, x10, x14 );
+        ChaCha20QuarterRound( x3, x7, x11, x15 );
+        ChaCha20QuarterRound( x0, x5, x10, x15 );
+        ChaCha20QuarterRound( x1, x6, x11, x12 );
+        ChaCha20QuarterRound( x2, x7, x8,  x13 );
+        ChaCha20QuarterRound( x3, x4, x9,  x14 );
+    }
+
+    // Key words are read before outBlock is written so inKey may point into outBlock.
+    x4  += inKey[ 0 ]; x5  += inKey[ 1 ]; x6  += inKey[ 2 ]; x7  += inKey[ 3 ];
+    x8  += inKey[ 4 ]; x9  += inKey[ 5 ]; x10 += inKey[ 6 ]; x11 += inKey[ 7 ];
+
+    outBlock[  0 ] = x0  + 0x61707865;  outBlock[  1 ] = x1  + 0x3320646E;
+    outBlock[  2 ] = x2  + 0x79622D32;  outBlock[  3 ] = x3  + 0x6B206574;
+    outBlock[  4 ] = x4;                outBlock[  5 ] = x5;
+    outBlock[  6 ] = x6;                outBlock[  7 ] = x7;
+    outBlock[  8 ] = x8;                outBlock[  9 ] = x9;
+    outBlock[ 10 ] = x10;               outBlock[ 11 ] = x11;
+    outBlock[ 12 ] = x12 + inCounter;   outBlock[ 13 ] = x13 + n0;
+    outBlock[ 14 ] = x14 + n1;          outBlock[ 15 ] = x15 + n2;
+}
+
+//===========================================================================================================================
+//  _ChaCha20Generate
+//
+//  Keystream for one request. Aligned output is written in place, only the tail goes through a stack block.
+//===========================================================================================================================
+
+static void _ChaCha20Generate( const uint32_t inKey[ 8 ], uint8_t *inBuffer, size_t inLen )
+{
+    uint32_t        block[ 16 ];
+    uint32_t        counter = 0;
+
+    if( ( (uintptr_t) inBuffer & 3 ) == 0 )
+    {
+        for( ; inLen >= sizeof( block ); inLen -= sizeof( block ), inBuffer += sizeof( block ) )
+        {
+            _ChaCha20Block( inKey, counter++, NULL, (uint32_t *) inBuffer );
+        }
+    }
+    while( inLen > 0 )
+    {
+        size_t      len = ( inLen < sizeof( block ) ) ? inLen : sizeof( block );
+
+        _ChaCha20Block( inKey, counter++, NULL, block );
+        memcpy( inBuffer, block, len );
+        inBuffer += len;
+        inLen    -= len;
+    }
+    memzero_secure( block, sizeof( block ) );
+}
+
+#if 0
+#pragma mark == Entropy ==
+#endif
+
+//===========================================================================================================================
+//  _RandomHealthTest
+//
+//  SP 800-90B section 4.4 repetition count and adaptive proportion tests over the raw bytes. Called with the
+//  scheduler suspended.
+//===========================================================================================================================
+
+static bool _RandomHealthTest( const uint8_t *inBuf, size_t inLen )
+{
+    size_t          i;
+    uint8_t         b;
+
+    for( i = 0; i < inLen; ++i )
+    {
+        b = inBuf[ i ];
+
+        if( ( gRandom.rctCount > 0 ) && ( b == gRandom.rctLast ) )
+        {
+            if( ++gRandom.rctCount >= kRandomRCTCutoff ) return( false );
+        }
+        else
+        {
+            gRandom.rctLast  = b;
+            gRandom.rctCount = 1;
+        }
+
+        if( gRandom.aptIndex == 0 )
+        {
+            gRandom.aptFirst = b;
+            gRandom.aptCount = 1;
+        }
+        else if( b == gRandom.aptFirst )
+        {
+            if( ++gRandom.aptCount >= kRandomAPTCutoff ) return( false );
+        }
+        if( ++gRandom.aptIndex >= kRandomAPTWindow ) gRandom.aptIndex = 0;
+    }
+    return( true );
+}
+
+//===========================================================================================================================
+//  _RandomReadEntropy
+//===========================================================================================================================
+
+static OSStatus _RandomReadEntropy( uint8_t *outBuf, size_t inLen )
+{
+    OSStatus        err;
+    CryptoRequest   request;
+    uint32_t        startTime = mico_get_time();
+    bool            healthy;
+
+    // Through the crypto providers so a platform with its own entropy engine can supply it.
+
+    memset( &request, 0, sizeof( request ) );
+    request.op     = kCryptoOp_Random;
+    request.dst    = outBuf;
+    request.srcLen = inLen;
+    err = CryptoPerform( &request );
+    require_noerr( err, exit );
+
+    mico_rtos_suspend_all_thread();
+    gRandom.stats.entropyBytes    += inLen;
+    gRandom.stats.entropyReadTime += mico_get_time() - startTime;
+    healthy = _RandomHealthTest( outBuf, inLen );
+    if( !healthy )
+    {
+        gRandom.failed = true;
+        gRandom.stats.healthFailures++;
+    }
+    mico_rtos_resume_all_thread();
+
+    require_action( healthy, exit, err = kIntegrityErr; random_log( "Platform RNG failed health test" ) );
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  _RandomSeed
+//
+//  Mixes fresh platform RNG output into the key: key = first half of ChaCha20( key xor seed ). The start-up path
+//  runs the known answer test and discards kRandomStartupTestBytes through the health tests first.
+//===========================================================================================================================
+
+static OSStatus _RandomSeed( bool inStartup )
+{
+    OSStatus        err;
+    uint8_t         seed[ 64 ];
+    uint32_t        block[ 16 ];
+    uint32_t        key[ 8 ];
+    int             i;
+
+    require_action_quiet( !gRandom.failed, exit, err = kIntegrityErr );
+
+    if( inStartup )
+    {
+        for( i = 0; i < 8; ++i ) key[ i ] = 0x03020100 + ( 0x04040404 * (uint32_t) i );
+        _ChaCha20Block( key, 1, kChaCha20TestNonce, block );
+        if( memcmp( block, kChaCha20TestBlock, sizeof( block ) ) != 0 )
+        {
+            gRandom.failed = true;
+            gRandom.stats.healthFailures++;
+            random_log( "ChaCha20 self test failed" );
+            err = kIntegrityErr;
+            goto exit;
+        }
+
+        for( i = 0; i < kRandomStartupTestBytes; i += sizeof( seed ) )
+        {
+            err = _RandomReadEntropy( seed, sizeof( seed ) );
+            require_noerr( err, exit );
+        }
+    }
+
+    err = _RandomReadEntropy( seed, kRandomSeedBytes );
+    require_noerr( err, exit );
+
+    mico_rtos_suspend_all_thread();
+    if( !gRandom.failed )
+    {
+        memcpy( key, seed, sizeof( key ) );
+        for( i = 0; i < 8; ++i ) key[ i ] ^= gRandom.key[ i ];
+        _ChaCha20Block( key, 0, NULL, block );
+        memcpy( gRandom.key, block, sizeof( gRandom.key ) );
+        gRandom.seeded           = true;
+        gRandom.bytesSinceReseed = 0;
+        gRandom.reseedTime       = mico_get_time();
+        gRandom.stats.reseedCount++;
+    }
+    else
+    {
+        err = kIntegrityErr;
+    }
+    mico_rtos_resume_all_thread();
+
+exit:
+    memzero_secure( seed, sizeof( seed ) );
+    memzero_secure( block, sizeof( block ) );
+    memzero_secure( key, sizeof( key ) );
+    return( err );
+}
+
+#if 0
+#pragma mark == Random Number API ==
+#endif
+
+//===========================================================================================================================
+//  RandomBytes
+//===========================================================================================================================
+
+OSStatus RandomBytes( void *inBuffer, size_t inLen )
+{
+    OSStatus        err;
+    uint32_t        block[ 16 ];
+
+    require_action( inBuffer || ( inLen == 0 ), exit, err = kParamErr );
+
+    if( !gRandom.seeded )
+    {
+        err = _RandomSeed( true );
+        require_noerr( err, exit );
+    }
+    else if( ( gRandom.bytesSinceReseed >= RANDOM_RESEED_BYTES ) ||
+             ( (uint32_t)( mico_get_time() - gRandom.reseedTime ) >= RANDOM_RESEED_INTERVAL ) )
+    {
+        err = _RandomSeed( false );
+        require_noerr( err, exit );
+    }
+
+    // Words 0-7 become the key of this request, words 8-15 replace the global key.
+    mico_rtos_suspend_all_thread();
+    if( gRandom.failed )
+    {
+        mico_rtos_resume_all_thread();
+        err = kIntegrityErr;
+        goto exit;
+    }
+    _ChaCha20Block( gRandom.key, 0, NULL, block );
+    memcpy( gRandom.key, &block[ 8 ], sizeof( gRandom.key ) );
+    gRandom.bytesSinceReseed     += inLen;
+    gRandom.stats.bytesGenerated += inLen;
+    gRandom.stats.requestCount++;
+    mico_rtos_resume_all_thread();
+
+    _ChaCha20Generate( block, (uint8_t *) inBuffer, inLen );
+    err = kNoErr;
+
+exit:
+    memzero_secure( block, sizeof( block ) );
+    return( err );
+}
+
+//===========================================================================================================================
+//  RandomUInt32
+//
+//  Returns 0 if the generator is in the error state.
+//===========================================================================================================================
+
+uint32_t RandomUInt32( void )
+{
+    uint32_t        value = 0;
+
+    if( RandomBytes( &value, sizeof( value ) ) != kNoErr ) value = 0;
+    return( value );
+}
+
+//===========================================================================================================================
+//  RandomReseed
+//===========================================================================================================================
+
+OSStatus RandomReseed( void )
+{
+    return( _RandomSeed( !gRandom.seeded ) );
+}
+
+//===========================================================================================================================
+//  RandomGetStats
+//===========================================================================================================================
+
+void RandomGetStats( RandomStats *outStats )
+{
+    mico_rtos_suspend_all_thread();
+    memcpy( outStats, &gRandom.stats, sizeof( *outStats ) );
+    mico_rtos_resume_all_thread();
+}
+
+#if 0
+#pragma mark == Random Context ==
+#endif
+
+//===========================================================================================================================
+//  RandomContextInit
+//===========================================================================================================================
+
+OSStatus RandomContextInit( RandomContext *inContext )
+{
+    OSStatus        err;
+
+    memset( inContext, 0, sizeof( *inContext ) );
+    inContext->bufferUsed = sizeof( inContext->buffer );
+    err = RandomBytes( inContext->key, sizeof( inContext->key ) );
+    return( err );
+}
+
+//===========================================================================================================================
+//  RandomContextBytes
+//
+//  Each ChaCha20 block gives 32 bytes of buffered output and the next key. Handed out bytes are wiped from the
+//  buffer so a later copy of the context does not reveal earlier output.
+//===========================================================================================================================
+
+OSStatus RandomContextBytes( RandomContext *inContext, void *inBuffer, size_t inLen )
+{
+    OSStatus        err;
+    uint8_t *       dst = (uint8_t *) inBuffer;
+    uint32_t        block[ 16 ];
+    uint32_t        seed[ 8 ];
+    size_t          len;
+    int             i;
+
+    require_action( inContext && ( inBuffer || ( inLen == 0 ) ), exit, err = kParamErr );
+
+    if( inContext->bytesSinceReseed >= RANDOM_CONTEXT_RESEED_BYTES )
+    {
+        err = RandomBytes( seed, sizeof( seed ) );
+        require_noerr( err, exit );
+        for( i = 0; i < 8; ++i ) inContext->key[ i ] ^= seed[ i ];
+        inContext->bytesSinceReseed = 0;
+    }
+    inContext->bytesSinceReseed += inLen;
+
+    if( inLen > sizeof( inContext->buffer ) )
+    {
+        _ChaCha20Block( inContext->key, 0, NULL, block );
+        memcpy( inContext->key, &block[ 8 ], sizeof( inContext->key ) );
+        _ChaCha20Generate( block, dst, inLen );
+        inLen = 0;
+    }
+
+    while( inLen > 0 )
+    {
+        if( inContext->bufferUsed >= sizeof( inContext->buffer ) )
+        {
+            _ChaCha20Block( inContext->key, 0, NULL, block );
+            memcpy( inContext->buffer, block, sizeof( inContext->buffer ) );
+            memcpy( inContext->key, &block[ 8 ], sizeof( inContext->key ) );
+            inContext->bufferUsed = 0;
+        }
+        len = sizeof( inContext->buffer ) - inContext->bufferUsed;
+        if( len > inLen ) len = inLen;
+        memcpy( dst, (uint8_t *) inContext->buffer + inContext->bufferUsed, len );
+        memzero_secure( (uint8_t *) inContext->buffer + inContext->bufferUsed, len );
+        inContext->bufferUsed += len;
+        dst   += len;
+        inLen -= len;
+    }
+    err = kNoErr;
+
+exit:
+    memzero_secure( block, sizeof( block ) );
+    memzero_secure( seed, sizeof( seed ) );
+    return( err );
+}
+
+//===========================================================================================================================
+//  RandomContextUInt32
+//===========================================================================================================================
+
+uint32_t RandomContextUInt32( RandomContext *inContext )
+{
+    uint32_t        value = 0;
+
+    if( RandomContextBytes( inContext, &value, sizeof( value ) ) != kNoErr ) value = 0;
+    return( value );
+}
+
+//===========================================================================================================================
+//  RandomContextFree
+//===========================================================================================================================
+
+void RandomContextFree( RandomContext *inContext )
+{
+    if( inContext ) memzero_secure( inContext, sizeof( *inContext ) );
+}
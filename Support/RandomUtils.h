@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file    RandomUtils.h
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This header contains function prototypes for the ChaCha20 based
+  *          random number generator seeded from MicoRandomNumberRead.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#ifndef __RandomUtils_h__
+#define __RandomUtils_h__
+
+#include "Common.h"
+
+#ifdef  __cplusplus
+    extern "C" {
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @group      Random Number API
+    @abstract   ChaCha20 deterministic random bit generator on top of MicoRandomNumberRead.
+    @discussion
+
+    The platform RNG is only used to seed the generator and to reseed it every RANDOM_RESEED_BYTES bytes or
+    RANDOM_RESEED_INTERVAL milliseconds, whichever comes first. Everything else is ChaCha20 keystream, so callers
+    never wait for the hardware.
+
+    Every request uses "fast key erasure": one ChaCha20 block under the global key yields a one-time key for the
+    request and the next global key, so output that was already handed out cannot be reconstructed from the state.
+    Only that block is computed with the scheduler suspended, the request itself is generated outside the lock.
+
+    Raw platform RNG bytes go through the SP 800-90B repetition count and adaptive proportion tests, a 1024 byte
+    start-up test and a ChaCha20 known answer test before the first seed. A failure latches the generator into an
+    error state and every later request returns kIntegrityErr.
+
+    Threads that need many small values (IDs, ports, backoff jitter) can own a RandomContext. It is seeded from the
+    global generator and then runs without any locking, buffering half a ChaCha20 block at a time. A context must
+    only be used by one thread.
+*/
+
+#if( !defined( RANDOM_RESEED_BYTES ) )
+    #define RANDOM_RESEED_BYTES                 ( 1024 * 1024 )
+#endif
+
+#if( !defined( RANDOM_RESEED_INTERVAL ) )
+    #define RANDOM_RESEED_INTERVAL              ( 10 * 60 * 1000 )
+#endif
+
+#if( !defined( RANDOM_CONTEXT_RESEED_BYTES ) )
+    #define RANDOM_CONTEXT_RESEED_BYTES         ( 64 * 1024 )
+#endif
+
+typedef struct
+{
+    uint32_t        key[ 8 ];
+    uint32_t        buffer[ 8 ];
+    size_t          bufferUsed;                 // Bytes of buffer already handed out.
+    uint32_t        bytesSinceReseed;
+
+}   RandomContext;
+
+typedef struct
+{
+    uint32_t        bytesGenerated;             // Output of the global generator, including context seeds.
+    uint32_t        requestCount;
+    uint32_t        reseedCount;
+    uint32_t        entropyBytes;               // Bytes read from MicoRandomNumberRead.
+    uint32_t        entropyReadTime;            // Total ms spent in MicoRandomNumberRead.
+    uint32_t        healthFailures;
+
+}   RandomStats;
+
+OSStatus    RandomBytes( void *inBuffer, size_t inLen );
+uint32_t    RandomUInt32( void );
+OSStatus    RandomReseed( void );
+void        RandomGetStats( RandomStats *outStats );
+
+OSStatus    RandomContextInit( RandomContext *inContext );
+OSStatus    RandomContextBytes( RandomContext *inContext, void *inBuffer, size_t inLen );
+uint32_t    RandomContextUInt32( RandomContext *inContext );
+void        RandomContextFree( RandomContext *inContext );
+
+#ifdef  __cplusplus
+    }
+#endif
+
+#endif // __RandomUtils_h__
+
@@ -0,0 +1,882 @@
+/**
+  ******************************************************************************
+  * @file    SRPUtils.c
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This file contains the SRP-6a server used by HomeKit pair setup.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#include "SRPUtils.h"
+
+#include "Debug.h"
+#include "SHAUtils.h"
+#include "SecurityUtils.h"
+#include "RandomUtils.h"
+#include "MicoPlatform.h"
+
+#define srp_log(M, ...) custom_log("SRP", M, ##__VA_ARGS__)
+#define srp_log_trace() custom_log_trace("SRP")
+
+#define kSRPMaxWords            ( kSRPMaxModulusBytes / 4 )
+#define kSRPMaxSaltBytes        64
+#define kSRPWindowEntries       ( 1 << SRP_EXP_WINDOW_BITS )
+
+#if( ( SRP_EXP_WINDOW_BITS < 1 ) || ( SRP_EXP_WINDOW_BITS > 6 ) )
+    #error "SRP_EXP_WINDOW_BITS must be between 1 and 6"
+#endif
+
+#if 0
+#pragma mark == Structures ==
+#endif
+
+// Montgomery constants of a group. Numbers are little endian arrays of 32-bit words.
+typedef struct
+{
+    int             words;                      // Number of 32-bit words in N.
+    size_t          bytes;                      // Size of N in bytes (PAD length).
+    uint32_t        n0inv;                      // -N^-1 mod 2^32.
+    uint32_t        N[ kSRPMaxWords ];
+    uint32_t        RR[ kSRPMaxWords ];         // R^2 mod N, R = 2^(32*words).
+    uint32_t        oneM[ kSRPMaxWords ];       // 1 in Montgomery form (R mod N).
+    uint32_t        gM[ kSRPMaxWords ];         // g in Montgomery form.
+    const uint8_t * NBytes;
+    uint8_t         g;
+
+}   SRPModulus;
+
+struct SRPVerifierPrivate
+{
+    SRPModulus      mod;
+    SRPHashType     hash;
+    size_t          hashLen;
+    uint32_t        vM[ kSRPMaxWords ];         // v in Montgomery form.
+    uint32_t        kvM[ kSRPMaxWords ];        // k*v in Montgomery form, the constant part of B.
+    uint8_t         v[ kSRPMaxModulusBytes ];   // PAD(v).
+    uint8_t         salt[ kSRPMaxSaltBytes ];
+    size_t          saltLen;
+    uint8_t         HNxorHg[ kSRPMaxHashBytes ];// H(N) xor H(g), the constant prefix of M.
+    uint8_t         HI[ kSRPMaxHashBytes ];     // H(I).
+};
+
+struct SRPServerPrivate
+{
+    SRPVerifierRef  verifier;
+    uint8_t         b[ kSRPPrivateKeyBytes ];
+    uint8_t         B[ kSRPMaxModulusBytes ];   // PAD(B).
+    uint8_t         K[ kSRPMaxHashBytes ];
+    uint8_t         M[ kSRPMaxHashBytes ];      // Expected client proof.
+    uint8_t         HAMK[ kSRPMaxHashBytes ];
+    Boolean         haveClientKey;
+    Boolean         verified;
+};
+
+// Digest context for either hash, so the protocol code does not care which one is in use.
+typedef struct
+{
+    SRPHashType             type;
+    union
+    {
+        SHA_CTX_compat      sha1;
+        SHA512_CTX_compat   sha512;
+
+    }   u;
+
+}   SRPHashContext;
+
+#if 0
+#pragma mark == Constants ==
+#endif
+
+// RFC 5054 3072-bit group (same prime as the RFC 3526 3072-bit MODP group), g = 5.
+static const uint8_t kSRP_N3072[ 384 ] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xC9, 0x0F, 0xDA, 0xA2,
+    0x21, 0x68, 0xC2, 0x34, 0xC4, 0xC6, 0x62, 0x8B, 0x80, 0xDC, 0x1C, 0xD1,
+    0x29, 0x02, 0x4E, 0x08, 0x8A, 0x67, 0xCC, 0x74, 0x02, 0x0B, 0xBE, 0xA6,
+    0x3B, 0x13, 0x9B, 0x22, 0x51, 0x4A, 0x08, 0x79, 0x8E, 0x34, 0x04, 0xDD,
+    0xEF, 0x95, 0x19, 0xB3, 0xCD, 0x3A, 0x43, 0x1B, 0x30, 0x2B, 0x0A, 0x6D,
+    0xF2, 0x5F, 0x14, 0x37, 0x4F, 0xE1, 0x35, 0x6D, 0x6D, 0x51, 0xC2, 0x45,
+    0xE4, 0x85, 0xB5, 0x76, 0x62, 0x5E, 0x7E, 0xC6, 0xF4, 0x4C, 0x42, 0xE9,
+    0xA6, 0x37, 0xED, 0x6B, 0x0B, 0xFF, 0x5C, 0xB6, 0xF4, 0x06, 0xB7, 0xED,
+    0xEE, 0x38, 0x6B, 0xFB, 0x5A, 0x89, 0x9F, 0xA5, 0xAE, 0x9F, 0x24, 0x11,
+    0x7C, 0x4B, 0x1F, 0xE6, 0x49, 0x28, 0x66, 0x51, 0xEC, 0xE4, 0x5B, 0x3D,
+    0xC2, 0x00, 0x7C, 0xB8, 0xA1, 0x63, 0xBF, 0x05, 0x98, 0xDA, 0x48, 0x36,
+    0x1C, 0x55, 0xD3, 0x9A, 0x69, 0x16, 0x3F, 0xA8, 0xFD, 0x24, 0xCF, 0x5F,
+    0x83, 0x65, 0x5D, 0x23, 0xDC, 0xA3, 0xAD, 0x96, 0x1C, 0x62, 0xF3, 0x56,
+    0x20, 0x85, 0x52, 0xBB, 0x9E, 0xD5, 0x29, 0x07, 0x70, 0x96, 0x96, 0x6D,
+    0x67, 0x0C, 0x35, 0x4E, 0x4A, 0xBC, 0x98, 0x04, 0xF1, 0x74, 0x6C, 0x08,
+    0xCA, 0x18, 0x21, 0x7C, 0x32, 0x90, 0x5E, 0x46, 0x2E, 0x36, 0xCE, 0x3B,
+    0xE3, 0x9E, 0x77, 0x2C, 0x18, 0x0E, 0x86, 0x03, 0x9B, 0x27, 0x83, 0xA2,
+    0xEC, 0x07, 0xA2, 0x8F, 0xB5, 0xC5, 0x5D, 0xF0, 0x6F, 0x4C, 0x52, 0xC9,
+    0xDE, 0x2B, 0xCB, 0xF6, 0x95, 0x58, 0x17, 0x18, 0x39, 0x95, 0x49, 0x7C,
+    0xEA, 0x95, 0x6A, 0xE5, 0x15, 0xD2, 0x26, 0x18, 0x98, 0xFA, 0x05, 0x10,
+    0x15, 0x72, 0x8E, 0x5A, 0x8A, 0xAA, 0xC4, 0x2D, 0xAD, 0x33, 0x17, 0x0D,
+    0x04, 0x50, 0x7A, 0x33, 0xA8, 0x55, 0x21, 0xAB, 0xDF, 0x1C, 0xBA, 0x64,
+    0xEC, 0xFB, 0x85, 0x04, 0x58, 0xDB, 0xEF, 0x0A, 0x8A, 0xEA, 0x71, 0x57,
+    0x5D, 0x06, 0x0C, 0x7D, 0xB3, 0x97, 0x0F, 0x85, 0xA6, 0xE1, 0xE4, 0xC7,
+    0xAB, 0xF5, 0xAE, 0x8C, 0xDB, 0x09, 0x33, 0xD7, 0x1E, 0x8C, 0x94, 0xE0,
+    0x4A, 0x25, 0x61, 0x9D, 0xCE, 0xE3, 0xD2, 0x26, 0x1A, 0xD2, 0xEE, 0x6B,
+    0xF1, 0x2F, 0xFA, 0x06, 0xD9, 0x8A, 0x08, 0x64, 0xD8, 0x76, 0x02, 0x73,
+    0x3E, 0xC8, 0x6A, 0x64, 0x52, 0x1F, 0x2B, 0x18, 0x17, 0x7B, 0x20, 0x0C,
+    0xBB, 0xE1, 0x17, 0x57, 0x7A, 0x61, 0x5D, 0x6C, 0x77, 0x09, 0x88, 0xC0,
+    0xBA, 0xD9, 0x46, 0xE2, 0x08, 0xE2, 0x4F, 0xA0, 0x74, 0xE5, 0xAB, 0x31,
+    0x43, 0xDB, 0x5B, 0xFC, 0xE0, 0xFD, 0x10, 0x8E, 0x4B, 0x82, 0xD1, 0x20,
+    0xA9, 0x3A, 0xD2, 0xCA, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#if 0
+#pragma mark == Big Numbers ==
+#endif
+
+//===========================================================================================================================
+//  _BNFromBytes / _BNToBytes
+//
+//  Convert between big endian byte strings and little endian word arrays of inWords words.
+//===========================================================================================================================
+
+static void _BNFromBytes( uint32_t *outBN, int inWords, const uint8_t *inPtr, size_t inLen )
+{
+    int     i;
+    size_t  pos;
+
+    memset( outBN, 0, inWords * sizeof( uint32_t ) );
+    for( pos = 0; pos < inLen; ++pos )
+    {
+        i = (int)( pos / 4 );
+        if( i >= inWords ) break;
+        outBN[ i ] |= ( (uint32_t) inPtr[ inLen - 1 - pos ] ) << ( 8 * ( pos % 4 ) );
+    }
+}
+
+static void _BNToBytes( const uint32_t *inBN, int inWords, uint8_t *outPtr )
+{
+    int     i;
+
+    for( i = 0; i < inWords; ++i )
+    {
+        uint32_t    w = inBN[ inWords - 1 - i ];
+
+        outPtr[ 4 * i + 0 ] = (uint8_t)( w >> 24 );
+        outPtr[ 4 * i + 1 ] = (uint8_t)( w >> 16 );
+        outPtr[ 4 * i + 2 ] = (uint8_t)( w >>  8 );
+        outPtr[ 4 * i + 3 ] = (uint8_t)( w       );
+    }
+}
+
+//===========================================================================================================================
+//  _BNCompare / _BNSub / _BNIsZero
+//===========================================================================================================================
+
+static int _BNCompare( const uint32_t *inA, const uint32_t *inB, int inWords )
+{
+    int     i;
+
+    for( i = inWords - 1; i >= 0; --i )
+    {
+        if( inA[ i ] != inB[ i ] ) return( ( inA[ i ] > inB[ i ] ) ? 1 : -1 );
+    }
+    return( 0 );
+}
+
+// outR = inA - inB, returns the borrow. outR may alias inA.
+static uint32_t _BNSub( uint32_t *outR, const uint32_t *inA, const uint32_t *inB, int inWords )
+{
+    uint64_t    t;
+    uint32_t    borrow = 0;
+    int         i;
+
+    for( i = 0; i < inWords; ++i )
+    {
+        t = (uint64_t) inA[ i ] - inB[ i ] - borrow;
+        outR[ i ] = (uint32_t) t;
+        borrow = (uint32_t)( t >> 32 ) & 1;
+    }
+    return( borrow );
+}
+
+static Boolean _BNIsZero( const uint32_t *inA, int inWords )
+{
+    uint32_t    x = 0;
+    int         i;
+
+    for( i = 0; i < inWords; ++i ) x |= inA[ i ];
+    return( x == 0 );
+}
+
+#if 0
+#pragma mark == Montgomery Arithmetic ==
+#endif
+
+//===========================================================================================================================
+//  _MontMul
+//
+//  outR = inA * inB * R^-1 mod N (CIOS). Inputs must be < N. outR may alias either input.
+//  inScratch must hold words + 2 words. The final reduction always subtracts N and adds it back under a mask, so the
+//  time does not depend on the operands.
+//===========================================================================================================================
+
+static void _MontMul( uint32_t *outR, const uint32_t *inA, const uint32_t *inB, const SRPModulus *inMod, uint32_t *inScratch )
+{
+    const int           n   = inMod->words;
+    const uint32_t *    N   = inMod->N;
+    uint32_t *          t   = inScratch;
+    uint64_t            sum;
+    uint32_t            carry, m, bi, mask;
+    int                 i, j;
+
+    memset( t, 0, ( n + 2 ) * sizeof( uint32_t ) );
+    for( i = 0; i < n; ++i )
+    {
+        bi = inB[ i ];
+        carry = 0;
+        for( j = 0; j < n; ++j )
+        {
+            sum = (uint64_t) inA[ j ] * bi + t[ j ] + carry;
+            t[ j ]  = (uint32_t) sum;
+            carry   = (uint32_t)( sum >> 32 );
+        }
+        sum = (uint64_t) t[ n ] + carry;
+        t[ n ]      = (uint32_t) sum;
+        t[ n + 1 ]  = (uint32_t)( sum >> 32 );
+
+        m = t[ 0 ] * inMod->n0inv;
+        sum = (uint64_t) m * N[ 0 ] + t[ 0 ];
+        carry = (uint32_t)( sum >> 32 );
+        for( j = 1; j < n; ++j )
+        {
+            sum = (uint64_t) m * N[ j ] + t[ j ] + carry;
+            t[ j - 1 ]  = (uint32_t) sum;
+            carry       = (uint32_t)( sum >> 32 );
+        }
+        sum = (uint64_t) t[ n ] + carry;
+        t[ n - 1 ]  = (uint32_t) sum;
+        t[ n ]      = t[ n + 1 ] + (uint32_t)( sum >> 32 );
+    }
+
+    // t < 2N, so t[ n ] is 0 or 1 and N is added back only when t[ n ] is 0 and the subtraction borrowed.
+    mask = (uint32_t) 0 - ( _BNSub( t, t, N, n ) & ( t[ n ] ^ 1 ) );
+    carry = 0;
+    for( j = 0; j < n; ++j )
+    {
+        sum = (uint64_t) t[ j ] + ( N[ j ] & mask ) + carry;
+        t[ j ]  = (uint32_t) sum;
+        carry   = (uint32_t)( sum >> 32 );
+    }
+    memcpy( outR, t, n * sizeof( uint32_t ) );
+}
+
+//===========================================================================================================================
+//  _ModAdd
+//
+//  outR = ( inA + inB ) mod N for inputs < N. Works the same in and out of the Montgomery domain.
+//===========================================================================================================================
+
+static void _ModAdd( uint32_t *outR, const uint32_t *inA, const uint32_t *inB, const SRPModulus *inMod )
+{
+    uint64_t    sum;
+    uint32_t    carry = 0;
+    int         i;
+
+    for( i = 0; i < inMod->words; ++i )
+    {
+        sum = (uint64_t) inA[ i ] + inB[ i ] + carry;
+        outR[ i ] = (uint32_t) sum;
+        carry = (uint32_t)( sum >> 32 );
+    }
+    if( ( carry != 0 ) || ( _BNCompare( outR, inMod->N, inMod->words ) >= 0 ) )
+    {
+        _BNSub( outR, outR, inMod->N, inMod->words );
+    }
+}
+
+//===========================================================================================================================
+//  _ModToMont / _ModFromMont
+//===========================================================================================================================
+
+static void _ModToMont( uint32_t *outR, const uint32_t *inA, const SRPModulus *inMod, uint32_t *inScratch )
+{
+    _MontMul( outR, inA, inMod->RR, inMod, inScratch );
+}
+
+static void _ModFromMont( uint32_t *outR, const uint32_t *inA, const SRPModulus *inMod, uint32_t *inScratch )
+{
+    uint32_t * const    one = inScratch + inMod->words + 2;
+
+    memset( one, 0, inMod->words * sizeof( uint32_t ) );
+    one[ 0 ] = 1;
+    _MontMul( outR, inA, one, inMod, inScratch );
+}
+
+//===========================================================================================================================
+//  _ModExp
+//
+//  outR = inBase ^ inExp mod N with both outR and inBase in Montgomery form. inExp is a big endian byte string.
+//  Uses a fixed window of SRP_EXP_WINDOW_BITS over every bit of the exponent, leading zeros included, with a heap
+//  table of base^0 to base^( 2^bits - 1 ). Every window does the same squarings and one multiplication, and its
+//  table entry is picked by a masked scan of the whole table, so neither the timing nor the memory accesses depend
+//  on the exponent. A 512-bit exponent takes 512 squarings plus 512 / bits multiplications.
+//===========================================================================================================================
+
+#define _ExpBit( EXP, LEN, BIT )    ( ( (EXP)[ (LEN) - 1 - ( (BIT) / 8 ) ] >> ( (BIT) % 8 ) ) & 1 )
+
+static void _ModExpSelect( uint32_t *outR, const uint32_t *inTable, unsigned int inIndex, int inWords )
+{
+    uint32_t        mask;
+    unsigned int    k;
+    int             i;
+
+    memset( outR, 0, inWords * sizeof( uint32_t ) );
+    for( k = 0; k < kSRPWindowEntries; ++k )
+    {
+        // All ones only for the wanted entry: ( k ^ inIndex ) - 1 wraps to 0xFFFFFFFF only when they are equal.
+        mask = (uint32_t) 0 - ( ( (uint32_t)( k ^ inIndex ) - 1 ) >> 31 );
+        for( i = 0; i < inWords; ++i ) outR[ i ] |= inTable[ k * inWords + i ] & mask;
+    }
+}
+
+static OSStatus _ModExp( uint32_t *outR, const uint32_t *inBase, const uint8_t *inExp, size_t inExpLen, const SRPModulus *inMod )
+{
+    OSStatus        err;
+    const int       n = inMod->words;
+    const int       bits = (int)( inExpLen * 8 );
+    uint32_t *      mem;
+    uint32_t *      table;
+    uint32_t *      acc;
+    uint32_t *      entry;
+    uint32_t *      scratch;
+    int             bit, k;
+    unsigned int    value;
+
+    // Layout: power table, accumulator, selected entry, scratch (2 * words + 2 for _MontMul and _ModFromMont).
+    mem = (uint32_t *) malloc( ( ( kSRPWindowEntries + 2 ) * n + ( 2 * n + 2 ) ) * sizeof( uint32_t ) );
+    require_action( mem, exit, err = kNoMemoryErr );
+    table   = mem;
+    acc     = table + kSRPWindowEntries * n;
+    entry   = acc + n;
+    scratch = entry + n;
+
+    // table[ i ] = base^i.
+    memcpy( table, inMod->oneM, n * sizeof( uint32_t ) );
+    for( k = 1; k < kSRPWindowEntries; ++k )
+    {
+        _MontMul( &table[ k * n ], &table[ ( k - 1 ) * n ], inBase, inMod, scratch );
+    }
+
+    // Windows start at the top of the exponent rounded up to a whole window, bits past its length read as zero.
+    memcpy( acc, inMod->oneM, n * sizeof( uint32_t ) );
+    for( bit = ( ( bits + SRP_EXP_WINDOW_BITS - 1 ) / SRP_EXP_WINDOW_BITS ) * SRP_EXP_WINDOW_BITS - 1; bit >= 0;
+         bit -= SRP_EXP_WINDOW_BITS )
+    {
+        value = 0;
+        for( k = bit; k > bit - SRP_EXP_WINDOW_BITS; --k )
+        {
+            value = ( value << 1 ) | ( ( k < bits ) ? _ExpBit( inExp, inExpLen, k ) : 0 );
+            _MontMul( acc, acc, acc, inMod, scratch );
+        }
+        _ModExpSelect( entry, table, value, n );
+        _MontMul( acc, acc, entry, inMod, scratch );
+    }
+
+    memcpy( outR, acc, n * sizeof( uint32_t ) );
+    memzero_secure( mem, ( ( kSRPWindowEntries + 2 ) * n ) * sizeof( uint32_t ) );
+    free( mem );
+    err = kNoErr;
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  _SRPModulusInit
+//===========================================================================================================================
+
+static OSStatus _SRPModulusInit( SRPModulus *inMod, SRPGroupType inGroup, uint32_t *inScratch )
+{
+    OSStatus        err;
+    uint32_t        inv;
+    int             n, i;
+
+    require_action( inGroup == kSRPGroup_3072, exit, err = kUnsupportedErr );
+    inMod->NBytes   = kSRP_N3072;
+    inMod->bytes    = sizeof( kSRP_N3072 );
+    inMod->g        = 5;
+    inMod->words    = n = (int)( inMod->bytes / 4 );
+    _BNFromBytes( inMod->N, n, inMod->NBytes, inMod->bytes );
+
+    // Newton iteration for N^-1 mod 2^32: each step doubles the number of correct low bits.
+    inv = 1;
+    for( i = 0; i < 5; ++i ) inv *= 2 - inMod->N[ 0 ] * inv;
+    inMod->n0inv = (uint32_t)( 0 - inv );
+
+    // R mod N = 2^(32n) - N since the top bit of N is set, then double it 32n more times to get R^2 mod N.
+    memset( inMod->RR, 0, n * sizeof( uint32_t ) );
+    _BNSub( inMod->RR, inMod->RR, inMod->N, n );
+    memcpy( inMod->oneM, inMod->RR, n * sizeof( uint32_t ) );
+    for( i = 0; i < 32 * n; ++i )
+    {
+        _ModAdd( inMod->RR, inMod->RR, inMod->RR, inMod );
+    }
+
+    memset( inScratch, 0, n * sizeof( uint32_t ) );
+    inScratch[ 0 ] = inMod->g;
+    _ModToMont( inMod->gM, inScratch, inMod, inScratch + n );
+    err = kNoErr;
+
+exit:
+    return( err );
+}
+
+#if 0
+#pragma mark == Hashing ==
+#endif
+
+static size_t _SRPHashLength( SRPHashType inType )
+{
+    return( ( inType == kSRPHash_SHA1 ) ? 20 : 64 );
+}
+
+static void _SRPHashInit( SRPHashContext *ctx, SRPHashType inType )
+{
+    ctx->type = inType;
+    if( inType == kSRPHash_SHA1 )   SHA1_Init_compat( &ctx->u.sha1 );
+    else                            SHA512_Init_compat( &ctx->u.sha512 );
+}
+
+static void _SRPHashUpdate( SRPHashContext *ctx, const void *inData, size_t inLen )
+{
+    if( ctx->type == kSRPHash_SHA1 )    SHA1_Update_compat( &ctx->u.sha1, inData, inLen );
+    else                                SHA512_Update_compat( &ctx->u.sha512, inData, inLen );
+}
+
+static void _SRPHashFinal( SRPHashContext *ctx, uint8_t *outDigest )
+{
+    if( ctx->type == kSRPHash_SHA1 )    SHA1_Final_compat( outDigest, &ctx->u.sha1 );
+    else                                SHA512_Final_compat( outDigest, &ctx->u.sha512 );
+}
+
+// Hashes a number after left padding it with zeros to the size of N.
+static void _SRPHashUpdatePadded( SRPHashContext *ctx, const uint8_t *inData, size_t inLen, size_t inPadLen )
+{
+    static const uint8_t    kZeros[ 16 ] = { 0 };
+    size_t                  pad, len;
+
+    for( pad = ( inPadLen > inLen ) ? ( inPadLen - inLen ) : 0; pad > 0; pad -= len )
+    {
+        len = Min( pad, sizeof( kZeros ) );
+        _SRPHashUpdate( ctx, kZeros, len );
+    }
+    _SRPHashUpdate( ctx, inData, inLen );
+}
+
+#if 0
+#pragma mark == Verifier ==
+#endif
+
+//===========================================================================================================================
+//  _SRPVerifierSetup
+//
+//  Computes everything about a verifier that does not change between sessions: v and k*v in Montgomery form,
+//  H(N) xor H(g) and H(I).
+//===========================================================================================================================
+
+static OSStatus _SRPVerifierSetup( SRPVerifierRef inVerifier, const char *inUsername, uint32_t *inScratch )
+{
+    SRPModulus * const  mod = &inVerifier->mod;
+    const int           n = mod->words;
+    SRPHashContext      ctx;
+    uint8_t             digest[ kSRPMaxHashBytes ];
+    uint32_t *          k = inScratch;
+    size_t              i;
+
+    // k = H(N | PAD(g))
+    _SRPHashInit( &ctx, inVerifier->hash );
+    _SRPHashUpdate( &ctx, mod->NBytes, mod->bytes );
+    _SRPHashUpdatePadded( &ctx, &mod->g, 1, mod->bytes );
+    _SRPHashFinal( &ctx, digest );
+    _BNFromBytes( k, n, digest, inVerifier->hashLen );
+
+    _BNFromBytes( inVerifier->vM, n, inVerifier->v, mod->bytes );
+    _ModToMont( inVerifier->vM, inVerifier->vM, mod, inScratch + n );
+    _ModToMont( k, k, mod, inScratch + n );
+    _MontMul( inVerifier->kvM, k, inVerifier->vM, mod, inScratch + n );
+
+    // H(N) xor H(g)
+    _SRPHashInit( &ctx, inVerifier->hash );
+    _SRPHashUpdate( &ctx, mod->NBytes, mod->bytes );
+    _SRPHashFinal( &ctx, inVerifier->HNxorHg );
+    _SRPHashInit( &ctx, inVerifier->hash );
+    _SRPHashUpdate( &ctx, &mod->g, 1 );
+    _SRPHashFinal( &ctx, digest );
+    for( i = 0; i < inVerifier->hashLen; ++i ) inVerifier->HNxorHg[ i ] ^= digest[ i ];
+
+    _SRPHashInit( &ctx, inVerifier->hash );
+    _SRPHashUpdate( &ctx, inUsername, strlen( inUsername ) );
+    _SRPHashFinal( &ctx, inVerifier->HI );
+
+    return( kNoErr );
+}
+
+//===========================================================================================================================
+//  SRPVerifierCreate
+//===========================================================================================================================
+
+OSStatus
+    SRPVerifierCreate(
+        SRPGroupType        inGroup,
+        SRPHashType         inHash,
+        const char *        inUsername,
+        const uint8_t *     inSalt,
+        size_t              inSaltLen,
+        const uint8_t *     inVerifier,
+        size_t              inVerifierLen,
+        SRPVerifierRef *    outVerifier )
+{
+    OSStatus            err;
+    SRPVerifierRef      obj = NULL;
+    uint32_t *          scratch = NULL;
+
+    require_action( inUsername && inSalt && inVerifier && outVerifier, exit, err = kParamErr );
+    require_action( ( inSaltLen > 0 ) && ( inSaltLen <= kSRPMaxSaltBytes ), exit, err = kSizeErr );
+    require_action( ( inHash == kSRPHash_SHA1 ) || ( inHash == kSRPHash_SHA512 ), exit, err = kUnsupportedErr );
+
+    obj = (SRPVerifierRef) calloc( 1, sizeof( *obj ) );
+    require_action( obj, exit, err = kNoMemoryErr );
+    scratch = (uint32_t *) malloc( ( 3 * kSRPMaxWords + 2 ) * sizeof( uint32_t ) );
+    require_action( scratch, exit, err = kNoMemoryErr );
+
+    err = _SRPModulusInit( &obj->mod, inGroup, scratch );
+    require_noerr( err, exit );
+    require_action( ( inVerifierLen > 0 ) && ( inVerifierLen <= obj->mod.bytes ), exit, err = kSizeErr );
+
+    obj->hash       = inHash;
+    obj->hashLen    = _SRPHashLength( inHash );
+    memcpy( obj->salt, inSalt, inSaltLen );
+    obj->saltLen    = inSaltLen;
+    memcpy( &obj->v[ obj->mod.bytes - inVerifierLen ], inVerifier, inVerifierLen );
+
+    _BNFromBytes( scratch, obj->mod.words, obj->v, obj->mod.bytes );
+    require_action( _BNCompare( scratch, obj->mod.N, obj->mod.words ) < 0, exit, err = kRangeErr );
+
+    err = _SRPVerifierSetup( obj, inUsername, scratch );
+    require_noerr( err, exit );
+
+    *outVerifier = obj;
+    obj = NULL;
+
+exit:
+    if( scratch ) free( scratch );
+    if( obj )     free( obj );
+    return( err );
+}
+
+//===========================================================================================================================
+//  SRPVerifierCreateWithPassword
+//
+//  x = H(s | H(I | ":" | P)), v = g^x with a random salt.
+//===========================================================================================================================
+
+OSStatus
+    SRPVerifierCreateWithPassword(
+        SRPGroupType        inGroup,
+        SRPHashType         inHash,
+        const char *        inUsername,
+        const uint8_t *     inPassword,
+        size_t              inPasswordLen,
+        SRPVerifierRef *    outVerifier )
+{
+    OSStatus            err;
+    SRPModulus *        mod = NULL;
+    uint32_t *          scratch = NULL;
+    SRPHashContext      ctx;
+    uint8_t             salt[ kSRPSaltBytes ];
+    uint8_t             x[ kSRPMaxHashBytes ];
+    uint8_t *           v = NULL;
+
+    require_action( inUsername && inPassword && outVerifier, exit, err = kParamErr );
+    require_action( ( inHash == kSRPHash_SHA1 ) || ( inHash == kSRPHash_SHA512 ), exit, err = kUnsupportedErr );
+
+    mod = (SRPModulus *) malloc( sizeof( *mod ) );
+    require_action( mod, exit, err = kNoMemoryErr );
+    scratch = (uint32_t *) malloc( ( 3 * kSRPMaxWords + 2 ) * sizeof( uint32_t ) );
+    require_action( scratch, exit, err = kNoMemoryErr );
+    v = (uint8_t *) malloc( kSRPMaxModulusBytes );
+    require_action( v, exit, err = kNoMemoryErr );
+
+    err = _SRPModulusInit( mod, inGroup, scratch );
+    require_noerr( err, exit );
+
+    err = RandomBytes( salt, sizeof( salt ) );
+    require_noerr( err, exit );
+
+    _SRPHashInit( &ctx, inHash );
+    _SRPHashUpdate( &ctx, inUsername, strlen( inUsername ) );
+    _SRPHashUpdate( &ctx, ":", 1 );
+    _SRPHashUpdate( &ctx, inPassword, inPasswordLen );
+    _SRPHashFinal( &ctx, x );
+
+    _SRPHashInit( &ctx, inHash );
+    _SRPHashUpdate( &ctx, salt, sizeof( salt ) );
+    _SRPHashUpdate( &ctx, x, _SRPHashLength( inHash ) );
+    _SRPHashFinal( &ctx, x );
+
+    err = _ModExp( scratch, mod->gM, x, _SRPHashLength( inHash ), mod );
+    require_noerr( err, exit );
+    _ModFromMont( scratch, scratch, mod, scratch + mod->words );
+    _BNToBytes( scratch, mod->words, v );
+
+    err = SRPVerifierCreate( inGroup, inHash, inUsername, salt, sizeof( salt ), v, mod->bytes, outVerifier );
+
+exit:
+    memzero_secure( x, sizeof( x ) );
+    if( v )       free( v );
+    if( scratch ) free( scratch );
+    if( mod )     free( mod );
+    return( err );
+}
+
+//===========================================================================================================================
+//  SRPVerifierGetSalt
+//===========================================================================================================================
+
+const uint8_t * SRPVerifierGetSalt( SRPVerifierRef inVerifier, size_t *outLen )
+{
+    if( outLen ) *outLen = inVerifier->saltLen;
+    return( inVerifier->salt );
+}
+
+//===========================================================================================================================
+//  SRPVerifierCopyVerifier
+//===========================================================================================================================
+
+OSStatus SRPVerifierCopyVerifier( SRPVerifierRef inVerifier, uint8_t *outVerifier, size_t *ioLen )
+{
+    OSStatus        err;
+
+    require_action( inVerifier && outVerifier && ioLen, exit, err = kParamErr );
+    require_action( *ioLen >= inVerifier->mod.bytes, exit, err = kSizeErr );
+
+    memcpy( outVerifier, inVerifier->v, inVerifier->mod.bytes );
+    *ioLen = inVerifier->mod.bytes;
+    err = kNoErr;
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  SRPVerifierDelete
+//===========================================================================================================================
+
+void SRPVerifierDelete( SRPVerifierRef inVerifier )
+{
+    if( inVerifier )
+    {
+        memzero_secure( inVerifier, sizeof( *inVerifier ) );
+        free( inVerifier );
+    }
+}
+
+#if 0
+#pragma mark == Server ==
+#endif
+
+//===========================================================================================================================
+//  SRPServerCreate
+//
+//  B = k*v + g^b. k*v is cached in the verifier, so this is one exponentiation and a modular add.
+//  The verifier must stay valid until the server is deleted.
+//===========================================================================================================================
+
+OSStatus SRPServerCreate( SRPVerifierRef inVerifier, SRPServerRef *outServer )
+{
+    OSStatus            err;
+    SRPServerRef        obj = NULL;
+    const SRPModulus *  mod;
+    uint32_t *          scratch = NULL;
+
+    require_action( inVerifier && outServer, exit, err = kParamErr );
+    mod = &inVerifier->mod;
+
+    obj = (SRPServerRef) calloc( 1, sizeof( *obj ) );
+    require_action( obj, exit, err = kNoMemoryErr );
+    scratch = (uint32_t *) malloc( ( 3 * kSRPMaxWords + 2 ) * sizeof( uint32_t ) );
+    require_action( scratch, exit, err = kNoMemoryErr );
+
+    obj->verifier = inVerifier;
+    err = RandomBytes( obj->b, sizeof( obj->b ) );
+    require_noerr( err, exit );
+
+    err = _ModExp( scratch, mod->gM, obj->b, sizeof( obj->b ), mod );
+    require_noerr( err, exit );
+    _ModAdd( scratch, scratch, inVerifier->kvM, mod );
+    _ModFromMont( scratch, scratch, mod, scratch + mod->words );
+    _BNToBytes( scratch, mod->words, obj->B );
+
+    *outServer = obj;
+    obj = NULL;
+
+exit:
+    if( scratch ) free( scratch );
+    SRPServerDelete( obj );
+    return( err );
+}
+
+//===========================================================================================================================
+//  SRPServerGetPublicKey
+//===========================================================================================================================
+
+const uint8_t * SRPServerGetPublicKey( SRPServerRef inServer, size_t *outLen )
+{
+    if( outLen ) *outLen = inServer->verifier->mod.bytes;
+    return( inServer->B );
+}
+
+//===========================================================================================================================
+//  SRPServerSetClientPublicKey
+//
+//  u = H(PAD(A) | PAD(B)), S = (A * v^u)^b, K = H(PAD(S)).
+//  Also precomputes the expected client proof M and the server proof H(PAD(A) | M | K).
+//===========================================================================================================================
+
+OSStatus SRPServerSetClientPublicKey( SRPServerRef inServer, const uint8_t *inA, size_t inALen )
+{
+    OSStatus            err;
+    SRPVerifierRef      ver;
+    const SRPModulus *  mod;
+    int                 n;
+    uint32_t *          mem = NULL;
+    uint32_t *          A;
+    uint32_t *          S;
+    uint32_t *          scratch;
+    uint8_t *           buf;
+    uint8_t             u[ kSRPMaxHashBytes ];
+    SRPHashContext      ctx;
+
+    require_action( inServer && inA, exit, err = kParamErr );
+    ver = inServer->verifier;
+    mod = &ver->mod;
+    n   = mod->words;
+    require_action( ( inALen > 0 ) && ( inALen <= mod->bytes ), exit, err = kSizeErr );
+
+    mem = (uint32_t *) malloc( ( 4 * n + 2 ) * sizeof( uint32_t ) + mod->bytes );
+    require_action( mem, exit, err = kNoMemoryErr );
+    A       = mem;
+    S       = A + n;
+    scratch = S + n;
+    buf     = (uint8_t *)( scratch + 2 * n + 2 );
+
+    // Reject A mod N == 0, which would let the client force S = 0. A < 2^3072 < 2N, so one subtraction reduces it.
+    _BNFromBytes( A, n, inA, inALen );
+    if( _BNCompare( A, mod->N, n ) >= 0 ) _BNSub( A, A, mod->N, n );
+    require_action( !_BNIsZero( A, n ), exit, err = kParamErr );
+
+    // PAD(A) as used in every hash below.
+    memset( buf, 0, mod->bytes - inALen );
+    memcpy( &buf[ mod->bytes - inALen ], inA, inALen );
+
+    _SRPHashInit( &ctx, ver->hash );
+    _SRPHashUpdate( &ctx, buf, mod->bytes );
+    _SRPHashUpdate( &ctx, inServer->B, mod->bytes );
+    _SRPHashFinal( &ctx, u );
+
+    // S = ( A * v^u )^b
+    err = _ModExp( S, ver->vM, u, ver->hashLen, mod );
+    require_noerr( err, exit );
+    _ModToMont( A, A, mod, scratch );
+    _MontMul( S, S, A, mod, scratch );
+    err = _ModExp( S, S, inServer->b, sizeof( inServer->b ), mod );
+    require_noerr( err, exit );
+    _ModFromMont( S, S, mod, scratch );
+    _BNToBytes( S, n, (uint8_t *) scratch );
+
+    _SRPHashInit( &ctx, ver->hash );
+    _SRPHashUpdate( &ctx, scratch, mod->bytes );
+    _SRPHashFinal( &ctx, inServer->K );
+
+    // M = H( H(N) xor H(g) | H(I) | s | PAD(A) | PAD(B) | K )
+    _SRPHashInit( &ctx, ver->hash );
+    _SRPHashUpdate( &ctx, ver->HNxorHg, ver->hashLen );
+    _SRPHashUpdate( &ctx, ver->HI, ver->hashLen );
+    _SRPHashUpdate( &ctx, ver->salt, ver->saltLen );
+    _SRPHashUpdate( &ctx, buf, mod->bytes );
+    _SRPHashUpdate( &ctx, inServer->B, mod->bytes );
+    _SRPHashUpdate( &ctx, inServer->K, ver->hashLen );
+    _SRPHashFinal( &ctx, inServer->M );
+
+    // HAMK = H( PAD(A) | M | K )
+    _SRPHashInit( &ctx, ver->hash );
+    _SRPHashUpdate( &ctx, buf, mod->bytes );
+    _SRPHashUpdate( &ctx, inServer->M, ver->hashLen );
+    _SRPHashUpdate( &ctx, inServer->K, ver->hashLen );
+    _SRPHashFinal( &ctx, inServer->HAMK );
+
+    inServer->haveClientKey = true;
+    inServer->verified      = false;
+
+exit:
+    if( mem )
+    {
+        memzero_secure( mem, ( 4 * n + 2 ) * sizeof( uint32_t ) );
+        free( mem );
+    }
+    return( err );
+}
+
+//===========================================================================================================================
+//  SRPServerVerifyProof
+//===========================================================================================================================
+
+OSStatus SRPServerVerifyProof( SRPServerRef inServer, const uint8_t *inM, size_t inMLen, const uint8_t **outHAMK, size_t *outHAMKLen )
+{
+    OSStatus        err;
+
+    require_action( inServer && inM, exit, err = kParamErr );
+    require_action( inServer->haveClientKey, exit, err = kStateErr );
+    require_action_quiet( inMLen == inServer->verifier->hashLen, exit, err = kAuthenticationErr );
+    require_action_quiet( memcmp_constant_time( inM, inServer->M, inMLen ) == 0, exit, err = kAuthenticationErr );
+
+    inServer->verified = true;
+    if( outHAMK )    *outHAMK    = inServer->HAMK;
+    if( outHAMKLen ) *outHAMKLen = inServer->verifier->hashLen;
+    err = kNoErr;
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  SRPServerGetSessionKey
+//===========================================================================================================================
+
+const uint8_t * SRPServerGetSessionKey( SRPServerRef inServer, size_t *outLen )
+{
+    if( !inServer->verified ) return( NULL );
+    if( outLen ) *outLen = inServer->verifier->hashLen;
+    return( inServer->K );
+}
+
+//===========================================================================================================================
+//  SRPServerDelete
+//===========================================================================================================================
+
+void SRPServerDelete( SRPServerRef inServer )
+{
+    if( inServer )
+    {
+        memzero_secure( inServer, sizeof( *inServer ) );
+        free( inServer );
+    }
+}
@@ -0,0 +1,118 @@
+/**
+  ******************************************************************************
+  * @file    SRPUtils.h
+  * @author  William Xu
+  * @version V1.0.0
+  * @date    19-Oct-2026
+  * @brief   This header contains function prototypes for the SRP-6a server
+  *          used by HomeKit pair setup.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#ifndef __SRPUtils_h__
+#define __SRPUtils_h__
+
+#include "Common.h"
+
+#ifdef  __cplusplus
+    extern "C" {
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @group      SRP-6a Server API
+    @abstract   SRP-6a (RFC 5054) server using the 3072-bit group with Montgomery multiplication.
+    @discussion
+
+    A verifier holds everything that only depends on the stored password verifier: the Montgomery constants of N,
+    v and k*v in Montgomery form and the salt. Create it once (e.g. from HKSetVerifier) and reuse it for every pair
+    setup attempt, so each session only pays for g^b, v^u and the final exponentiation.
+
+    Per session:
+        SRPServerCreate (generates b and B = k*v + g^b).
+        SRPServerGetPublicKey (B to send to the client, always padded to the size of N).
+        SRPServerSetClientPublicKey (A from the client; computes u, S, K and the expected client proof).
+        SRPServerVerifyProof (checks M from the client and returns H(A, M, K) to send back).
+        SRPServerGetSessionKey (K, once verified).
+        SRPServerDelete.
+
+    Values are hashed as in RFC 5054: k = H(N | PAD(g)), u = H(PAD(A) | PAD(B)), K = H(PAD(S)),
+    M = H(H(N) xor H(g) | H(I) | s | PAD(A) | PAD(B) | K).
+
+    SRP_EXP_WINDOW_BITS selects the fixed window size of the modular exponentiation. Each extra bit cuts the
+    number of multiplications but doubles the table of precomputed powers (2^bits * 384 bytes on the heap for
+    the 3072-bit group), which is scanned in full for every window.
+*/
+
+#if( !defined( SRP_EXP_WINDOW_BITS ) )
+    #define SRP_EXP_WINDOW_BITS         4
+#endif
+
+#define kSRPMaxModulusBytes             384     // 3072-bit group.
+#define kSRPMaxHashBytes                64      // SHA-512.
+#define kSRPSaltBytes                   16
+#define kSRPPrivateKeyBytes             32
+
+typedef enum
+{
+    kSRPGroup_3072  = 0     //! RFC 5054 3072-bit group, g = 5.
+
+}   SRPGroupType;
+
+typedef enum
+{
+    kSRPHash_SHA1   = 0,
+    kSRPHash_SHA512 = 1
+
+}   SRPHashType;
+
+typedef struct SRPVerifierPrivate *     SRPVerifierRef;
+typedef struct SRPServerPrivate *       SRPServerRef;
+
+OSStatus
+    SRPVerifierCreate(
+        SRPGroupType        inGroup,
+        SRPHashType         inHash,
+        const char *        inUsername,
+        const uint8_t *     inSalt,
+        size_t              inSaltLen,
+        const uint8_t *     inVerifier,
+        size_t              inVerifierLen,
+        SRPVerifierRef *    outVerifier );
+
+OSStatus
+    SRPVerifierCreateWithPassword(
+        SRPGroupType        inGroup,
+        SRPHashType         inHash,
+        const char *        inUsername,
+        const uint8_t *     inPassword,
+        size_t              inPasswordLen,
+        SRPVerifierRef *    outVerifier );
+
+const uint8_t * SRPVerifierGetSalt( SRPVerifierRef inVerifier, size_t *outLen );
+OSStatus        SRPVerifierCopyVerifier( SRPVerifierRef inVerifier, uint8_t *outVerifier, size_t *ioLen );
+void            SRPVerifierDelete( SRPVerifierRef inVerifier );
+
+OSStatus        SRPServerCreate( SRPVerifierRef inVerifier, SRPServerRef *outServer );
+const uint8_t * SRPServerGetPublicKey( SRPServerRef inServer, size_t *outLen );
+OSStatus        SRPServerSetClientPublicKey( SRPServerRef inServer, const uint8_t *inA, size_t inALen );
+OSStatus        SRPServerVerifyProof( SRPServerRef inServer, const uint8_t *inM, size_t inMLen, const uint8_t **outHAMK, size_t *outHAMKLen );
+const uint8_t * SRPServerGetSessionKey( SRPServerRef inServer, size_t *outLen );
+void            SRPServerDelete( SRPServerRef inServer );
+
+#ifdef  __cplusplus
+    }
+#endif
+
+#endif // __SRPUtils_h__
+
@@ -30,16 +30,63 @@
 
 int memcmp_constant_time( const void *inA, const void *inB, size_t inLen )
 {
-    const uint8_t * const       a = (const uint8_t *) inA; 
-    const uint8_t * const       b = (const uint8_t *) inB; 
-    int                         result = 0; 
-    size_t                      i;   
-    
-    for( i = 0; i < inLen; ++i )
-    {    
-        result |= ( a[ i ] ^ b[ i ] ); 
-    }    
-    return( result );
+    const uint8_t *             a = (const uint8_t *) inA;
+    const uint8_t *             b = (const uint8_t *) inB;
+    uintptr_t                   result = 0;
+
+    // Compare a word at a time when both buffers have the same alignment, which is the usual case for digests,
+    // tags and keys. The number of iterations only depends on the length and the alignment, never on the data.
+    if( ( ( (uintptr_t) a ^ (uintptr_t) b ) & ( sizeof( uintptr_t ) - 1 ) ) == 0 )
+    {
+        while( ( inLen > 0 ) && ( ( (uintptr_t) a & ( sizeof( uintptr_t ) - 1 ) ) != 0 ) )
+        {
+            result |= ( *a++ ^ *b++ );
+            --inLen;
+        }
+        while( inLen >= sizeof( uintptr_t ) )
+        {
+            result |= ( *( (const uintptr_t *) a ) ^ *( (const uintptr_t *) b ) );
+            a     += sizeof( uintptr_t );
+            b     += sizeof( uintptr_t );
+            inLen -= sizeof( uintptr_t );
+        }
+    }
+    while( inLen > 0 )
+    {
+        result |= ( *a++ ^ *b++ );
+        --inLen;
+    }
+    return( result != 0 );
+}
+
+//===========================================================================================================================
+//  memzero_secure
+//
+//  Zeros memory in a way that the compiler can't optimize away, e.g. keys on the stack right before returning.
+//===========================================================================================================================
+
+void memzero_secure( void *inPtr, size_t inLen )
+{
+    volatile uint8_t *          p = (volatile uint8_t *) inPtr;
+    volatile uintptr_t *        w;
+
+    while( ( inLen > 0 ) && ( ( (uintptr_t) p & ( sizeof( uintptr_t ) - 1 ) ) != 0 ) )
+    {
+        *p++ = 0;
+        --inLen;
+    }
+    w = (volatile uintptr_t *) p;
+    while( inLen >= sizeof( uintptr_t ) )
+    {
+        *w++ = 0;
+        inLen -= sizeof( uintptr_t );
+    }
+    p = (volatile uint8_t *) w;
+    while( inLen > 0 )
+    {
+        *p++ = 0;
+        --inLen;
+    }
 }
 
 
@@ -31,9 +31,17 @@
 //
 //  Compares memory so that the time it takes does not depend on the data being compared.
 //  This is needed to avoid certain timing attacks in cryptographic software.
+//  Returns 0 if the buffers are equal and 1 otherwise.
 //===========================================================================================================================
 int memcmp_constant_time( const void *inA, const void *inB, size_t inLen );
 
+//===========================================================================================================================
+//  memzero_secure
+//
+//  Zeros memory in a way that the compiler can't optimize away, e.g. keys on the stack right before returning.
+//===========================================================================================================================
+void memzero_secure( void *inPtr, size_t inLen );
+
 #endif // __SecurityUtils_h__
 
 
@@ -72,6 +72,96 @@ exit:
     return err;
 }
 
+/* There is no writev in the MICO socket layer, so small pieces are copied into one
+   segment sized buffer and anything of a segment or more is written in place */
+OSStatus SocketSendv( int fd, const iovec_t *inVec, int inVecCount )
+{
+    OSStatus err = kParamErr;
+    socket_cork_t cork;
+    size_t total = 0;
+    int i;
+
+    require( inVec, exit );
+    require( inVecCount > 0, exit );
+
+    if( inVecCount == 1 )
+      return SocketSend( fd, inVec[0].iov_base, inVec[0].iov_len );
+
+    for( i = 0; i < inVecCount; i++ )
+      total += inVec[i].iov_len;
+
+    SocketCorkInit( &cork, fd, Min( total, SOCKET_SEGMENT_SIZE ) );
+    for( i = 0; i < inVecCount; i++ )
+      SocketCorkWrite( &cork, inVec[i].iov_base, inVec[i].iov_len );
+    err = SocketCorkFlush( &cork );
+    SocketCorkFree( &cork );
+
+exit:
+    return err;
+}
+
+void SocketCorkInit( socket_cork_t *cork, int fd, size_t bufferSize )
+{
+    cork->fd = fd;
+    cork->buf = NULL;
+    cork->len = 0;
+    cork->size = bufferSize ? bufferSize : SOCKET_SEGMENT_SIZE;
+    cork->err = kNoErr;
+}
+
+OSStatus SocketCorkWrite( socket_cork_t *cork, const void *inBuf, size_t inBufLen )
+{
+    const uint8_t *src = inBuf;
+    size_t n;
+
+    require_noerr_quiet( cork->err, exit );
+
+    while( inBufLen > 0 )
+    {
+        if( cork->len == 0 && inBufLen >= cork->size )
+        {
+            cork->err = SocketSend( cork->fd, src, inBufLen );
+            break;
+        }
+
+        if( cork->buf == NULL )
+        {
+            cork->buf = malloc( cork->size );
+            require_action( cork->buf, exit, cork->err = kNoMemoryErr );
+        }
+
+        n = Min( cork->size - cork->len, inBufLen );
+        memcpy( cork->buf + cork->len, src, n );
+        cork->len += n;
+        src += n;
+        inBufLen -= n;
+
+        if( cork->len == cork->size )
+        {
+            SocketCorkFlush( cork );
+            require_noerr_quiet( cork->err, exit );
+        }
+    }
+
+exit:
+    return cork->err;
+}
+
+OSStatus SocketCorkFlush( socket_cork_t *cork )
+{
+    if( cork->err == kNoErr && cork->len > 0 )
+      cork->err = SocketSend( cork->fd, cork->buf, cork->len );
+    cork->len = 0;
+    return cork->err;
+}
+
+void SocketCorkFree( socket_cork_t *cork )
+{
+    if( cork->buf ) free( cork->buf );
+    cork->buf = NULL;
+    cork->len = 0;
+}
+
 void SocketClose(int* fd)
 {
     int tempFd = *fd;
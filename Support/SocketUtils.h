@@ -24,8 +24,40 @@
 
 #include "Common.h"
 
+/* Data gathered into one write by SocketSendv and the cork functions, one TCP segment on Wi-Fi */
+#ifndef SOCKET_SEGMENT_SIZE
+#define SOCKET_SEGMENT_SIZE   1460
+#endif
+
+typedef struct
+{
+  const void *  iov_base;
+  size_t        iov_len;
+} iovec_t;
+
+/* Data written through a cork is held back until a full segment is collected or
+   SocketCorkFlush is called, large writes go straight from the caller's buffer */
+typedef struct
+{
+  int           fd;
+  uint8_t *     buf;
+  size_t        len;
+  size_t        size;
+  OSStatus      err;      /* First error, later writes are dropped */
+} socket_cork_t;
+
 OSStatus SocketSend( int fd, const uint8_t *inBuf, size_t inBufLen );
 
+OSStatus SocketSendv( int fd, const iovec_t *inVec, int inVecCount );
+
+void SocketCorkInit( socket_cork_t *cork, int fd, size_t bufferSize );
+
+OSStatus SocketCorkWrite( socket_cork_t *cork, const void *inBuf, size_t inBufLen );
+
+OSStatus SocketCorkFlush( socket_cork_t *cork );
+
+void SocketCorkFree( socket_cork_t *cork );
+
 void SocketClose(int* fd);
 
 void SocketCloseForOSEvent(int* fd);
@@ -32,6 +32,29 @@
 #define CONVERTHEX_alpha(c)  (IS_AF(c) ? (c - 'A'+10) : (c - 'a'+10))
 #define CONVERTHEX(c)   (IS_09(c) ? (c - '0') : CONVERTHEX_alpha(c))
 
+static const char kHexDigitsUppercase[] = "0123456789ABCDEF";
+
+/* Value of each ASCII hex digit, 0xFF for anything else */
+static const uint8_t kHexCharValue[ 256 ] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
 //===========================================================================================================================
 //  formatMACAddr
 //
@@ -292,20 +315,30 @@ exit:
     return err;
 }
 
+/* Writes 2*inBufLen uppercase hex digits and a null terminator to outStr, returns outStr */
+static char* DataToHexBuffer( const uint8_t *inBuf, size_t inBufLen, char *outStr )
+{
+    char* buf_ptr = outStr;
+    size_t i;
+
+    for (i = 0; i < inBufLen; i++)
+    {
+        *buf_ptr++ = kHexDigitsUppercase[ inBuf[i] >> 4 ];
+        *buf_ptr++ = kHexDigitsUppercase[ inBuf[i] & 0x0F ];
+    }
+    *buf_ptr = '\0';
+    return outStr;
+}
+
 char* DataToHexString( const uint8_t *inBuf, size_t inBufLen )
 {
     char* buf_str = NULL;
-    char* buf_ptr;
     require_quiet(inBuf, error);
     require_quiet(inBufLen > 0, error);
 
     buf_str = (char*) malloc (2*inBufLen + 1);
     require(buf_str, error);
-    buf_ptr = buf_str;
-    uint32_t i;
-    for (i = 0; i < inBufLen; i++) buf_ptr += sprintf(buf_ptr, "%02X", inBuf[i]);
-    *buf_ptr = '\0';
-    return buf_str;
+    return DataToHexBuffer( inBuf, inBufLen, buf_str );
 
 error:
     if ( buf_str ) free( buf_str );
@@ -323,7 +356,12 @@ char* DataToHexStringWithSpaces( const uint8_t *inBuf, size_t inBufLen )
     require(buf_str, error);
     buf_ptr = buf_str;
     uint32_t i;
-    for (i = 0; i < inBufLen; i++) buf_ptr += sprintf(buf_ptr, "%02X ", inBuf[i]);
+    for (i = 0; i < inBufLen; i++)
+    {
+        *buf_ptr++ = kHexDigitsUppercase[ inBuf[i] >> 4 ];
+        *buf_ptr++ = kHexDigitsUppercase[ inBuf[i] & 0x0F ];
+        *buf_ptr++ = ' ';
+    }
     *buf_ptr = '\0';
     return buf_str;
 
@@ -345,10 +383,10 @@ char* DataToHexStringWithColons( const uint8_t *inBuf, size_t inBufLen )
     uint32_t i;
     for (i = 0; i < inBufLen; i++)
     {
-        if ( i == inBufLen - 1 )
-            buf_ptr += sprintf(buf_ptr, "%02X", inBuf[i]);
-        else
-            buf_ptr += sprintf(buf_ptr, "%02X:", inBuf[i]);
+        *buf_ptr++ = kHexDigitsUppercase[ inBuf[i] >> 4 ];
+        *buf_ptr++ = kHexDigitsUppercase[ inBuf[i] & 0x0F ];
+        if ( i != inBufLen - 1 )
+            *buf_ptr++ = ':';
     }
     *buf_ptr = '\0';
     return buf_str;
@@ -358,6 +396,38 @@ error:
     return NULL;
 }
 
+//===========================================================================================================================
+//  HexStringToData
+//
+//  Parses hex text (e.g. "00a1FF") into bytes. The text must have an even number of hex digits and nothing else.
+//===========================================================================================================================
+
+OSStatus HexStringToData( const char *inStr, size_t inLen, uint8_t *outBuf, size_t inMaxLen, size_t *outLen )
+{
+    OSStatus            err;
+    const uint8_t *     src = (const uint8_t *) inStr;
+    uint8_t             hi, lo;
+    size_t              i;
+
+    require_action( inStr && outBuf, exit, err = kParamErr );
+    if( inLen == kSizeCString ) inLen = strlen( inStr );
+    require_action( ( inLen % 2 ) == 0, exit, err = kMalformedErr );
+    require_action( inLen / 2 <= inMaxLen, exit, err = kSizeErr );
+
+    for( i = 0; i < inLen / 2; ++i )
+    {
+        hi = kHexCharValue[ src[ 2 * i ] ];
+        lo = kHexCharValue[ src[ 2 * i + 1 ] ];
+        require_action_quiet( ( hi | lo ) <= 0x0F, exit, err = kMalformedErr );
+        outBuf[ i ] = (uint8_t)( ( hi << 4 ) | lo );
+    }
+    if( outLen ) *outLen = inLen / 2;
+    err = kNoErr;
+
+exit:
+    return err;
+}
+
 char* DataToCString( const uint8_t *inBuf, size_t inBufLen )
 {
     char* cString = NULL;
@@ -923,24 +993,54 @@ char * strnstr_suffix( const char *inStr, size_t inMaxLen, const char *inSuffix)
 }
 
 
+//===========================================================================================================================
+//  memmem
+//
+//  Horspool search: compares the last byte of the window first and on a mismatch shifts the window by the distance
+//  of that byte from the end of the pattern, so most of the haystack is never looked at. Shifts are kept in bytes
+//  (capped at 255) so the table stays small enough for thread stacks. 1 and 2 byte patterns use memchr instead.
+//===========================================================================================================================
+
 void *memmem(void *start, unsigned int s_len, void *find, unsigned int f_len)
 {
-    char                *p, *q;
-    unsigned int        len;
-
-    p = start, q = find;
-    len = 0;
-    while((p - (char *)start + f_len) <= s_len){
-        while(*p++ == *q++){
-            len++;
-            if(len == f_len)
-                return(p - f_len);
-        };
-        q = find;
-        len = 0;
-    };
-
-    return(NULL);
+    const uint8_t *     src = (const uint8_t *) start;
+    const uint8_t *     pat = (const uint8_t *) find;
+    const uint8_t *     ptr;
+    const uint8_t *     end;
+    uint8_t             skip[ 256 ];
+    unsigned int        last, pos, i;
+    uint8_t             c;
+
+    if( f_len == 0 ) return( start );
+    if( f_len > s_len ) return( NULL );
+
+    if( f_len < 3 )
+    {
+        end = src + ( s_len - f_len );
+        while( src <= end )
+        {
+            ptr = (const uint8_t *) memchr( src, pat[ 0 ], (size_t)( end - src ) + 1 );
+            if( ptr == NULL ) return( NULL );
+            if( ( f_len == 1 ) || ( ptr[ 1 ] == pat[ 1 ] ) ) return( (void *) ptr );
+            src = ptr + 1;
+        }
+        return( NULL );
+    }
+
+    last = f_len - 1;
+    memset( skip, ( f_len > 255 ) ? 255 : f_len, sizeof( skip ) );
+    for( i = 0; i < last; ++i )
+    {
+        skip[ pat[ i ] ] = ( last - i > 255 ) ? 255 : (uint8_t)( last - i );
+    }
+
+    for( pos = 0; pos <= s_len - f_len; pos += skip[ c ] )
+    {
+        c = src[ pos + last ];
+        if( ( c == pat[ last ] ) && ( memcmp( src + pos, pat, last ) == 0 ) )
+            return( (void *)( src + pos ) );
+    }
+    return( NULL );
 }
 
 
@@ -88,6 +88,9 @@ char* DataToHexStringWithSpaces( const uint8_t *inBuf, size_t inBufLen );
 
 char* DataToHexStringWithColons( const uint8_t *inBuf, size_t inBufLen );
 
+/* Parse hex digits (upper or lower case, even count) into bytes. inLen may be kSizeCString */
+OSStatus HexStringToData( const char *inStr, size_t inLen, uint8_t *outBuf, size_t inMaxLen, size_t *outLen );
+
 // ==== STRING COMPARE UTILS ====
 int strnicmp_suffix( const void *inStr, size_t inMaxLen, const char *inSuffix );
 
@@ -99,6 +102,7 @@ char * strnstr_suffix( const char *inStr, size_t inMaxLen, const char *inSuffix)
 
 int VSNScanF( const void *inString, size_t inSize, const char *inFormat, va_list inArgs );
 
+/* Find the first occurrence of find in start, Horspool search for patterns of 3 bytes or more */
 void *memmem(void *start, unsigned int s_len, void *find, unsigned int f_len);
 
 #if defined (__CC_ARM)
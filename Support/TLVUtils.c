@@ -55,3 +55,260 @@ OSStatus TLVGetNext( const uint8_t *    inSrc,
     return( kNoErr );
 }
 
+OSStatus TLVGetNextInPlace( uint8_t *          inSrc, 
+                            uint8_t *          inEnd, 
+                            uint8_t *          outID, 
+                            uint8_t **         outData, 
+                            size_t *           outLen, 
+                            uint8_t **         outNext )
+{
+    OSStatus            err;
+    uint8_t             id;
+    const uint8_t *     ptr;
+    size_t              len;
+    const uint8_t *     next;
+    uint8_t             fragID;
+    const uint8_t *     fragPtr;
+    size_t              fragLen;
+    const uint8_t *     fragNext;
+    uint8_t *           dst;
+
+    err = TLVGetNext( inSrc, inEnd, &id, &ptr, &len, &next );
+    if( err != kNoErr )
+        return( err );
+    
+    fragLen = len;
+    dst = (uint8_t *) ptr + len;
+    while( fragLen == kTLV8MaxFragmentLen )
+    {
+        if( TLVGetNext( next, inEnd, &fragID, &fragPtr, &fragLen, &fragNext ) != kNoErr )
+            break;
+        if( fragID != id )
+            break;
+        memmove( dst, fragPtr, fragLen );
+        dst  += fragLen;
+        len  += fragLen;
+        next  = fragNext;
+    }
+    
+    *outID   = id;
+    *outData = (uint8_t *) ptr;
+    *outLen  = len;
+    if( outNext )
+        *outNext = (uint8_t *) next;
+
+    return( kNoErr );
+}
+
+OSStatus TLVFind( const uint8_t *    inSrc, 
+                  const uint8_t *    inEnd, 
+                  uint8_t            inID, 
+                  const uint8_t **   outData, 
+                  size_t *           outLen )
+{
+    OSStatus            err;
+    uint8_t             id;
+
+    while( ( err = TLVGetNext( inSrc, inEnd, &id, outData, outLen, &inSrc ) ) == kNoErr )
+    {
+        if( id == inID )
+            break;
+    }
+
+    return( err );
+}
+
+OSStatus TLVCopy( const uint8_t *    inSrc, 
+                  const uint8_t *    inEnd, 
+                  uint8_t            inID, 
+                  void *             outBuf, 
+                  size_t             inBufSize, 
+                  size_t *           outLen )
+{
+    OSStatus            err;
+    uint8_t             id;
+    const uint8_t *     ptr;
+    size_t              len;
+    size_t              total = 0;
+
+    while( ( err = TLVGetNext( inSrc, inEnd, &id, &ptr, &len, &inSrc ) ) == kNoErr )
+    {
+        if( id == inID )
+            break;
+    }
+    if( err != kNoErr )
+        return( err );
+
+    for( ;; )
+    {
+        if( outBuf )
+        {
+            if( ( total + len ) > inBufSize )
+                return( kNoSpaceErr );
+            memcpy( (uint8_t *) outBuf + total, ptr, len );
+        }
+        total += len;
+        if( len != kTLV8MaxFragmentLen )
+            break;
+        if( TLVGetNext( inSrc, inEnd, &id, &ptr, &len, &inSrc ) != kNoErr )
+            break;
+        if( id != inID )
+            break;
+    }
+    *outLen = total;
+
+    return( kNoErr );
+}
+
+OSStatus TLVAppend( uint8_t *         inBuf, 
+                    size_t            inBufSize, 
+                    size_t *          ioLen, 
+                    uint8_t           inID, 
+                    const void *      inData, 
+                    size_t            inLen )
+{
+    const uint8_t *     src = (const uint8_t *) inData;
+    uint8_t *           dst;
+    size_t              len;
+
+    if( inBuf && ( ( *ioLen + TLV8ItemSize( inLen ) ) > inBufSize ) )
+        return( kNoSpaceErr );
+    do
+    {
+        len = ( inLen > kTLV8MaxFragmentLen ) ? kTLV8MaxFragmentLen : inLen;
+        if( inBuf )
+        {
+            dst = inBuf + *ioLen;
+            dst[ 0 ] = inID;
+            dst[ 1 ] = (uint8_t) len;
+            if( len )
+                memcpy( dst + kTLV8HeaderLen, src, len );
+        }
+        *ioLen += kTLV8HeaderLen + len;
+        src    += len;
+        inLen  -= len;
+    } while( inLen > 0 );
+
+    return( kNoErr );
+}
+
+OSStatus TLVAppendUInt8( uint8_t *         inBuf, 
+                         size_t            inBufSize, 
+                         size_t *          ioLen, 
+                         uint8_t           inID, 
+                         uint8_t           inValue )
+{
+    return( TLVAppend( inBuf, inBufSize, ioLen, inID, &inValue, sizeof( inValue ) ) );
+}
+
+OSStatus TLVAppendReserve( uint8_t *         inBuf, 
+                           size_t            inBufSize, 
+                           size_t *          ioLen, 
+                           uint8_t           inID, 
+                           size_t            inLen, 
+                           uint8_t **        outData )
+{
+    uint8_t *           dst = NULL;
+
+    if( inLen > kTLV8MaxFragmentLen )
+        return( kSizeErr );
+    if( inBuf )
+    {
+        if( ( *ioLen + kTLV8HeaderLen + inLen ) > inBufSize )
+            return( kNoSpaceErr );
+        dst = inBuf + *ioLen;
+        dst[ 0 ] = inID;
+        dst[ 1 ] = (uint8_t) inLen;
+        dst += kTLV8HeaderLen;
+    }
+    *ioLen += kTLV8HeaderLen + inLen;
+    *outData = dst;
+
+    return( kNoErr );
+}
+
+OSStatus TLV16GetNext( const uint8_t *    inSrc, 
+                       const uint8_t *    inEnd, 
+                       uint8_t *          outID, 
+                       const uint8_t **   outData, 
+                       size_t *           outLen, 
+                       const uint8_t **   outNext )
+{
+    const uint8_t *     ptr;
+    size_t              len;
+    const uint8_t *     next;
+
+    len = (size_t)( inEnd - inSrc );
+    if( len < kTLV16HeaderLen )
+        return( kNotFoundErr );
+
+    len  = (size_t)( inSrc[ 1 ] | ( inSrc[ 2 ] << 8 ) );
+    ptr  = inSrc + kTLV16HeaderLen;
+    next = ptr + len;
+    if( ( next < inSrc ) || ( next > inEnd ) )
+        return( kUnderrunErr );
+    
+    *outID   = inSrc[ 0 ];
+    *outData = ptr;
+    *outLen  = len;
+    if( outNext )
+        *outNext = next;
+
+    return( kNoErr );
+}
+
+OSStatus TLV16Append( uint8_t *         inBuf, 
+                      size_t            inBufSize, 
+                      size_t *          ioLen, 
+                      uint8_t           inID, 
+                      const void *      inData, 
+                      size_t            inLen )
+{
+    uint8_t *           dst;
+
+    if( inLen > kTLV16MaxLen )
+        return( kSizeErr );
+    if( inBuf )
+    {
+        if( ( *ioLen + kTLV16HeaderLen + inLen ) > inBufSize )
+            return( kNoSpaceErr );
+        dst = inBuf + *ioLen;
+        dst[ 0 ] = inID;
+        dst[ 1 ] = (uint8_t)( inLen & 0xFF );
+        dst[ 2 ] = (uint8_t)( inLen >> 8 );
+        if( inLen )
+            memcpy( dst + kTLV16HeaderLen, inData, inLen );
+    }
+    *ioLen += kTLV16HeaderLen + inLen;
+
+    return( kNoErr );
+}
+
+OSStatus TLV16BeginContainer( uint8_t *         inBuf, 
+                              size_t            inBufSize, 
+                              size_t *          ioLen, 
+                              uint8_t           inID, 
+                              size_t *          outContainer )
+{
+    *outContainer = *ioLen;
+    return( TLV16Append( inBuf, inBufSize, ioLen, inID, NULL, 0 ) );
+}
+
+OSStatus TLV16EndContainer( uint8_t *       inBuf, 
+                            size_t          inLen, 
+                            size_t          inContainer )
+{
+    size_t              len;
+
+    len = inLen - inContainer - kTLV16HeaderLen;
+    if( len > kTLV16MaxLen )
+        return( kSizeErr );
+    if( inBuf )
+    {
+        inBuf[ inContainer + 1 ] = (uint8_t)( len & 0xFF );
+        inBuf[ inContainer + 2 ] = (uint8_t)( len >> 8 );
+    }
+
+    return( kNoErr );
+}
+
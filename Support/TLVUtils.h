@@ -35,5 +35,102 @@ OSStatus TLVGetNext(
         size_t *            outLen, 
         const uint8_t **    outNext );
 
+/* TLV8 values longer than kTLV8MaxFragmentLen bytes are split into consecutive items of the same type,
+   every one but the last kTLV8MaxFragmentLen bytes long. TLVGetNext returns single fragments. */
+
+#define kTLV8HeaderLen          2
+#define kTLV8MaxFragmentLen     255
+#define TLV8ItemSize( LEN )     ( ( (LEN) ? ( ( (LEN) + kTLV8MaxFragmentLen - 1 ) / kTLV8MaxFragmentLen ) : 1 ) * kTLV8HeaderLen + (LEN) )
+
+/* Same as TLVGetNext, but the fragments of a value are joined in place by moving them over the headers
+   in between, so outData holds the whole value. The items before outNext can not be parsed again. */
+OSStatus TLVGetNextInPlace( 
+        uint8_t *           inSrc, 
+        uint8_t *           inEnd, 
+        uint8_t *           outID, 
+        uint8_t **          outData, 
+        size_t *            outLen, 
+        uint8_t **          outNext );
+
+/* Returns the first fragment of the first item with type inID, without copying. */
+OSStatus TLVFind( 
+        const uint8_t *     inSrc, 
+        const uint8_t *     inEnd, 
+        uint8_t             inID, 
+        const uint8_t **    outData, 
+        size_t *            outLen );
+
+/* Copies the value of the first item with type inID, all fragments joined, to outBuf. With a NULL
+   outBuf only the length of the value is returned. */
+OSStatus TLVCopy( 
+        const uint8_t *     inSrc, 
+        const uint8_t *     inEnd, 
+        uint8_t             inID, 
+        void *              outBuf, 
+        size_t              inBufSize, 
+        size_t *            outLen );
+
+/* The writers follow the rules of TLV16Append below. TLVAppend fragments values longer than
+   kTLV8MaxFragmentLen, TLVAppendReserve adds a single fragment and returns where its value goes,
+   so it can be written in place, e.g. by an encryption routine. */
+OSStatus TLVAppend( 
+        uint8_t *           inBuf, 
+        size_t              inBufSize, 
+        size_t *            ioLen, 
+        uint8_t             inID, 
+        const void *        inData, 
+        size_t              inLen );
+
+OSStatus TLVAppendUInt8( 
+        uint8_t *           inBuf, 
+        size_t              inBufSize, 
+        size_t *            ioLen, 
+        uint8_t             inID, 
+        uint8_t             inValue );
+
+OSStatus TLVAppendReserve( 
+        uint8_t *           inBuf, 
+        size_t              inBufSize, 
+        size_t *            ioLen, 
+        uint8_t             inID, 
+        size_t              inLen, 
+        uint8_t **          outData );
+
+/* TLV16 items have a 1 byte type and a 2 byte little endian length, so values up to 65535 bytes
+   fit in one item. A container is an item whose value is a TLV16 list itself. */
+
+#define kTLV16HeaderLen     3
+#define kTLV16MaxLen        0xFFFF
+
+OSStatus TLV16GetNext( 
+        const uint8_t *     inSrc, 
+        const uint8_t *     inEnd, 
+        uint8_t *           outID, 
+        const uint8_t **    outData, 
+        size_t *            outLen, 
+        const uint8_t **    outNext );
+
+/* The writers append at *ioLen and advance it. With a NULL inBuf they only advance *ioLen,
+   which sizes the buffer for a second pass. */
+OSStatus TLV16Append( 
+        uint8_t *           inBuf, 
+        size_t              inBufSize, 
+        size_t *            ioLen, 
+        uint8_t             inID, 
+        const void *        inData, 
+        size_t              inLen );
+
+OSStatus TLV16BeginContainer( 
+        uint8_t *           inBuf, 
+        size_t              inBufSize, 
+        size_t *            ioLen, 
+        uint8_t             inID, 
+        size_t *            outContainer );
+
+OSStatus TLV16EndContainer( 
+        uint8_t *           inBuf, 
+        size_t              inLen, 
+        size_t              inContainer );
+
 #endif // __TLVUtils_h__
 
@@ -0,0 +1,430 @@
+/**
+******************************************************************************
+* @file    CryptoProviderTest.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Host test of the crypto provider registry, the software provider
+*          and an asynchronous engine simulated on a worker thread.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*
+* Build and run from the repository root:
+*
+*   cc -std=c99 -DDEBUG=0 -ISupport/Test/Host -Iinclude -ISupport -IExternal -o CryptoProviderTest \
+*       Support/Test/CryptoProviderTest.c Support/Test/Host/HostStubs.c Support/Test/Host/HostAES.c \
+*       Support/CryptoProvider.c Support/AESUtils.c Support/SHAUtils.c Support/SecurityUtils.c \
+*       External/SHAUtils/sha1.c External/SHAUtils/sha224-256.c -lpthread
+*   ./CryptoProviderTest
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "CryptoProvider.h"
+#include "HostStubs.h"
+
+// NIST SP 800-38A F.1.1, F.2.1 and F.5.1: AES-128 with the same key and plaintext.
+
+static const uint8_t kKey[ 16 ] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static const uint8_t kPlaintext[ 64 ] =
+{
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+};
+
+static const uint8_t kECBCiphertext[ 64 ] =
+{
+    0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60, 0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97,
+    0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D, 0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF,
+    0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23, 0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88,
+    0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4
+};
+
+static const uint8_t kCBCIV[ 16 ] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+static const uint8_t kCBCCiphertext[ 64 ] =
+{
+    0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46, 0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+    0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE, 0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+    0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B, 0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+    0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09, 0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7
+};
+
+static const uint8_t kCTRCounter[ 16 ] =
+{
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+static const uint8_t kCTRCiphertext[ 64 ] =
+{
+    0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26, 0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+    0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF, 0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+    0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E, 0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+    0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1, 0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE
+};
+
+// GCM specification (McGrew/Viega) test case 4: 60 byte message with 20 bytes of AAD.
+
+static const uint8_t kGCMKey[ 16 ] =
+{
+    0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C, 0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08
+};
+
+static const uint8_t kGCMNonce[ 12 ] =
+{
+    0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD, 0xDE, 0xCA, 0xF8, 0x88
+};
+
+static const uint8_t kGCMAAD[ 20 ] =
+{
+    0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+    0xAB, 0xAD, 0xDA, 0xD2
+};
+
+static const uint8_t kGCMPlaintext[ 60 ] =
+{
+    0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5, 0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+    0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA, 0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+    0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+    0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57, 0xBA, 0x63, 0x7B, 0x39
+};
+
+static const uint8_t kGCMCiphertext[ 60 ] =
+{
+    0x42, 0x83, 0x1E, 0xC2, 0x21, 0x77, 0x74, 0x24, 0x4B, 0x72, 0x21, 0xB7, 0x84, 0xD0, 0xD4, 0x9C,
+    0xE3, 0xAA, 0x21, 0x2F, 0x2C, 0x02, 0xA4, 0xE0, 0x35, 0xC1, 0x7E, 0x23, 0x29, 0xAC, 0xA1, 0x2E,
+    0x21, 0xD5, 0x14, 0xB2, 0x54, 0x66, 0x93, 0x1C, 0x7D, 0x8F, 0x6A, 0x5A, 0xAC, 0x84, 0xAA, 0x05,
+    0x1B, 0xA3, 0x0B, 0x39, 0x6A, 0x0A, 0xAC, 0x97, 0x3D, 0x58, 0xE0, 0x91
+};
+
+static const uint8_t kGCMTag[ 16 ] =
+{
+    0x5B, 0xC9, 0x4F, 0xBC, 0x32, 0x21, 0xA5, 0xDB, 0x94, 0xFA, 0xE9, 0x5A, 0xE7, 0x12, 0x1A, 0x47
+};
+
+// FIPS 180-2 "abc" examples.
+
+static const uint8_t kSHA1abc[ 20 ] =
+{
+    0xA9, 0x99, 0x3E, 0x36, 0x47, 0x06, 0x81, 0x6A, 0xBA, 0x3E, 0x25, 0x71, 0x78, 0x50, 0xC2, 0x6C,
+    0x9C, 0xD0, 0xD8, 0x9D
+};
+
+static const uint8_t kSHA256abc[ 32 ] =
+{
+    0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+    0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+};
+
+//===========================================================================================================================
+//  Simulated engine
+//
+//  Takes one request at a time and finishes it on a worker thread, like a DMA driven engine finishing from its
+//  completion task. The work itself is done by the software provider so the results can be checked against the KATs.
+//===========================================================================================================================
+
+static pthread_mutex_t  gEngineLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   gEngineCond = PTHREAD_COND_INITIALIZER;
+static CryptoRequest *  gEngineRequest = NULL;
+static bool             gEngineHold = false;
+static int              gEngineCount = 0;
+
+static void * _EngineWorker( void *inArg )
+{
+    CryptoRequest *     request;
+    OSStatus            err;
+
+    (void) inArg;
+    pthread_mutex_lock( &gEngineLock );
+    while( gEngineHold ) pthread_cond_wait( &gEngineCond, &gEngineLock );
+    request = gEngineRequest;
+    pthread_mutex_unlock( &gEngineLock );
+
+    mico_thread_msleep( 1 );
+    err = kCryptoSoftwareProvider.submit( &kCryptoSoftwareProvider, request );
+
+    pthread_mutex_lock( &gEngineLock );
+    gEngineRequest = NULL;
+    gEngineCount  += 1;
+    pthread_mutex_unlock( &gEngineLock );
+
+    CryptoRequestComplete( request, err );
+    return( NULL );
+}
+
+static OSStatus _EngineSubmit( const CryptoProvider *inProvider, CryptoRequest *inRequest )
+{
+    pthread_t   thread;
+
+    (void) inProvider;
+    pthread_mutex_lock( &gEngineLock );
+    if( gEngineRequest )
+    {
+        pthread_mutex_unlock( &gEngineLock );
+        return( kNoResourcesErr );
+    }
+    gEngineRequest = inRequest;
+    pthread_mutex_unlock( &gEngineLock );
+
+    pthread_create( &thread, NULL, _EngineWorker, NULL );
+    pthread_detach( thread );
+    return( kAsyncNoErr );
+}
+
+static void _EngineRelease( void )
+{
+    pthread_mutex_lock( &gEngineLock );
+    gEngineHold = false;
+    pthread_cond_broadcast( &gEngineCond );
+    pthread_mutex_unlock( &gEngineLock );
+}
+
+static const CryptoProvider kEngineProvider =
+{
+    .name       = "Simulated engine",
+    .ops        = kCryptoOpMask_AES,
+    .priority   = 10,
+    .minLength  = 64,
+    .submit     = _EngineSubmit,
+    .context    = NULL,
+};
+
+//===========================================================================================================================
+//  Helpers
+//===========================================================================================================================
+
+typedef struct
+{
+    int             calls;
+    OSStatus        status;
+
+}   Completion;
+
+static void _Completion( CryptoRequest *inRequest, OSStatus inStatus, void *inContext )
+{
+    Completion *    completion = (Completion *) inContext;
+
+    (void) inRequest;
+    completion->calls += 1;
+    completion->status = inStatus;
+}
+
+static void _RequestInit( CryptoRequest *outRequest, CryptoOp inOp, Boolean inEncrypt, const uint8_t *inKey,
+                          const uint8_t *inIV, size_t inIVLen, const void *inSrc, size_t inLen, void *inDst,
+                          Completion *inCompletion )
+{
+    memset( outRequest, 0, sizeof( *outRequest ) );
+    outRequest->op          = inOp;
+    outRequest->encrypt     = inEncrypt;
+    outRequest->key         = inKey;
+    if( inIV ) memcpy( outRequest->iv, inIV, inIVLen );
+    outRequest->src         = inSrc;
+    outRequest->srcLen      = inLen;
+    outRequest->dst         = inDst;
+    outRequest->completion  = inCompletion ? _Completion : NULL;
+    outRequest->context     = inCompletion;
+}
+
+//===========================================================================================================================
+//  Software provider KATs
+//===========================================================================================================================
+
+static void _TestSoftwareKATs( void )
+{
+    CryptoRequest   request;
+    Completion      completion;
+    uint8_t         buf[ 64 ];
+    uint8_t         zero[ 64 ];
+    size_t          i;
+
+    // ECB both ways.
+
+    memset( &completion, 0, sizeof( completion ) );
+    _RequestInit( &request, kCryptoOp_AES_ECB, true, kKey, NULL, 0, kPlaintext, 64, buf, &completion );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kECBCiphertext, 64 ) == 0 );
+    host_check( completion.calls == 1 && completion.status == kNoErr );
+    host_check( request.provider == &kCryptoSoftwareProvider );
+
+    _RequestInit( &request, kCryptoOp_AES_ECB, false, kKey, NULL, 0, buf, 64, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kPlaintext, 64 ) == 0 );
+
+    // CBC in two chained requests, the IV carries over.
+
+    _RequestInit( &request, kCryptoOp_AES_CBC, true, kKey, kCBCIV, 16, kPlaintext, 32, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    request.src = kPlaintext + 32;
+    request.dst = buf + 32;
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kCBCCiphertext, 64 ) == 0 );
+    host_check( memcmp( request.iv, kCBCCiphertext + 48, 16 ) == 0 );
+
+    _RequestInit( &request, kCryptoOp_AES_CBC, false, kKey, kCBCIV, 16, buf, 64, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kPlaintext, 64 ) == 0 );
+
+    // CTR with a ragged first request, the counter carries over.
+
+    _RequestInit( &request, kCryptoOp_AES_CTR, true, kKey, kCTRCounter, 16, kPlaintext, 16, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    request.src    = kPlaintext + 16;
+    request.dst    = buf + 16;
+    request.srcLen = 48;
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kCTRCiphertext, 64 ) == 0 );
+
+    // GCM seal and open, in place.
+
+    _RequestInit( &request, kCryptoOp_AES_GCM, true, kGCMKey, kGCMNonce, 12, kGCMPlaintext, 60, buf, NULL );
+    request.aad    = kGCMAAD;
+    request.aadLen = sizeof( kGCMAAD );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kGCMCiphertext, 60 ) == 0 );
+    host_check( memcmp( request.tag, kGCMTag, 16 ) == 0 );
+
+    _RequestInit( &request, kCryptoOp_AES_GCM, false, kGCMKey, kGCMNonce, 12, buf, 60, buf, NULL );
+    request.aad    = kGCMAAD;
+    request.aadLen = sizeof( kGCMAAD );
+    memcpy( request.tag, kGCMTag, 16 );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kGCMPlaintext, 60 ) == 0 );
+
+    // A forged tag fails and no plaintext is left behind.
+
+    memcpy( buf, kGCMCiphertext, 60 );
+    memset( zero, 0, sizeof( zero ) );
+    memset( &completion, 0, sizeof( completion ) );
+    _RequestInit( &request, kCryptoOp_AES_GCM, false, kGCMKey, kGCMNonce, 12, buf, 60, buf, &completion );
+    request.aad    = kGCMAAD;
+    request.aadLen = sizeof( kGCMAAD );
+    memcpy( request.tag, kGCMTag, 16 );
+    request.tag[ 15 ] ^= 0x01;
+    host_check( CryptoPerform( &request ) == kAuthenticationErr );
+    host_check( memcmp( buf, zero, 60 ) == 0 );
+    host_check( completion.calls == 1 && completion.status == kAuthenticationErr );
+
+    // Hashes, and the NULL digest pointer that used to be written through.
+
+    _RequestInit( &request, kCryptoOp_SHA1, false, NULL, NULL, 0, "abc", 3, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kSHA1abc, 20 ) == 0 );
+
+    _RequestInit( &request, kCryptoOp_SHA256, false, NULL, NULL, 0, "abc", 3, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( memcmp( buf, kSHA256abc, 32 ) == 0 );
+
+    _RequestInit( &request, kCryptoOp_SHA1, false, NULL, NULL, 0, "abc", 3, NULL, NULL );
+    host_check( CryptoPerform( &request ) == kParamErr );
+
+    // RNG.
+
+    memset( buf, 0, sizeof( buf ) );
+    _RequestInit( &request, kCryptoOp_Random, false, NULL, NULL, 0, NULL, 64, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    for( i = 0; ( i < sizeof( buf ) ) && ( buf[ i ] == 0 ); ++i ) {}
+    host_check( i < sizeof( buf ) );
+}
+
+//===========================================================================================================================
+//  Engine routing, asynchronous completion and busy fallback
+//===========================================================================================================================
+
+static void _TestEngine( void )
+{
+    CryptoRequest   asyncRequest;
+    CryptoRequest   request;
+    Completion      asyncCompletion;
+    Completion      completion;
+    uint8_t         asyncBuf[ 64 ];
+    uint8_t         buf[ 64 ];
+    OSStatus        err;
+    int             i;
+
+    host_check( CryptoProviderRegister( &kEngineProvider ) == kNoErr );
+    host_check( CryptoProviderRegister( &kEngineProvider ) == kDuplicateErr );
+    host_check( CryptoProviderSelect( kCryptoOp_AES_CTR, 64 ) == &kEngineProvider );
+    host_check( CryptoProviderSelect( kCryptoOp_AES_CTR, 63 ) == &kCryptoSoftwareProvider );
+    host_check( CryptoProviderSelect( kCryptoOp_SHA256, 1024 ) == &kCryptoSoftwareProvider );
+
+    // Long enough for the engine: CryptoPerform blocks until the worker completes it.
+
+    memset( &completion, 0, sizeof( completion ) );
+    _RequestInit( &request, kCryptoOp_AES_CTR, true, kKey, kCTRCounter, 16, kPlaintext, 64, buf, &completion );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( request.provider == &kEngineProvider );
+    host_check( gEngineCount == 1 );
+    host_check( completion.calls == 1 && completion.status == kNoErr );
+    host_check( memcmp( buf, kCTRCiphertext, 64 ) == 0 );
+
+    // Too short for the engine, done in software.
+
+    _RequestInit( &request, kCryptoOp_AES_ECB, true, kKey, NULL, 0, kPlaintext, 16, buf, NULL );
+    host_check( CryptoPerform( &request ) == kNoErr );
+    host_check( request.provider == &kCryptoSoftwareProvider );
+    host_check( gEngineCount == 1 );
+    host_check( memcmp( buf, kECBCiphertext, 16 ) == 0 );
+
+    // CryptoSubmit returns right away while the engine holds the request.
+
+    gEngineHold = true;
+    memset( &asyncCompletion, 0, sizeof( asyncCompletion ) );
+    _RequestInit( &asyncRequest, kCryptoOp_AES_CBC, true, kKey, kCBCIV, 16, kPlaintext, 64, asyncBuf, &asyncCompletion );
+    err = CryptoSubmit( &asyncRequest );
+    host_check( err == kAsyncNoErr );
+    host_check( asyncCompletion.calls == 0 );
+
+    // The engine is busy, so this one falls back to software and completes before CryptoSubmit returns.
+
+    memset( &completion, 0, sizeof( completion ) );
+    _RequestInit( &request, kCryptoOp_AES_ECB, true, kKey, NULL, 0, kPlaintext, 64, buf, &completion );
+    err = CryptoSubmit( &request );
+    host_check( err == kNoErr );
+    host_check( request.provider == &kCryptoSoftwareProvider );
+    host_check( completion.calls == 1 && completion.status == kNoErr );
+    host_check( memcmp( buf, kECBCiphertext, 64 ) == 0 );
+
+    _EngineRelease();
+    for( i = 0; ( i < 1000 ) && ( asyncCompletion.calls == 0 ); ++i ) mico_thread_msleep( 1 );
+    mico_thread_msleep( 10 );
+    host_check( asyncCompletion.calls == 1 && asyncCompletion.status == kNoErr );
+    host_check( asyncRequest.provider == &kEngineProvider );
+    host_check( memcmp( asyncBuf, kCBCCiphertext, 64 ) == 0 );
+    host_check( gEngineCount == 2 );
+
+    host_check( CryptoProviderDeregister( &kEngineProvider ) == kNoErr );
+    host_check( CryptoProviderDeregister( &kEngineProvider ) == kNotFoundErr );
+    host_check( CryptoProviderSelect( kCryptoOp_AES_CTR, 64 ) == &kCryptoSoftwareProvider );
+}
+
+int main( void )
+{
+    _TestSoftwareKATs();
+    _TestEngine();
+
+    printf( "CryptoProviderTest: %s (%d failures)\n", gHostTestFailures ? "FAILED" : "PASSED", gHostTestFailures );
+    return( gHostTestFailures ? 1 : 0 );
+}
@@ -0,0 +1,205 @@
+/**
+******************************************************************************
+* @file    HostAES.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Plain C AES-128 behind the MicoAES API so the Support modules can
+*          be tested on a host without the MICO library.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include <string.h>
+
+#include "MICOAES.h"
+
+// Only AES-128 is needed by the Support modules. The round keys are kept as bytes in aes->key, aes->reg holds the
+// CBC chaining block like the CyaSSL implementation the MICO library is built from.
+
+static const byte kSBox[ 256 ] =
+{
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static byte gInvSBox[ 256 ];
+
+static byte _xtime( byte inX )
+{
+    return (byte)( ( inX << 1 ) ^ ( ( inX & 0x80 ) ? 0x1B : 0x00 ) );
+}
+
+static byte _mul( byte inA, byte inB )
+{
+    byte    r = 0;
+
+    while( inB )
+    {
+        if( inB & 1 ) r ^= inA;
+        inA = _xtime( inA );
+        inB >>= 1;
+    }
+    return( r );
+}
+
+int AesSetKey( Aes *aes, const byte *userKey, word32 keylen, const byte *iv, int dir )
+{
+    byte *      rk = (byte *) aes->key;
+    byte        rcon = 0x01;
+    byte        t[ 4 ];
+    int         i, j;
+
+    (void) dir;
+    if( keylen != 16 ) return( -1 );
+
+    for( i = 0; i < 256; ++i ) gInvSBox[ kSBox[ i ] ] = (byte) i;
+
+    memcpy( rk, userKey, 16 );
+    for( i = 16; i < 176; i += 4 )
+    {
+        memcpy( t, &rk[ i - 4 ], 4 );
+        if( ( i % 16 ) == 0 )
+        {
+            byte tmp = t[ 0 ];
+            t[ 0 ] = (byte)( kSBox[ t[ 1 ] ] ^ rcon );
+            t[ 1 ] = kSBox[ t[ 2 ] ];
+            t[ 2 ] = kSBox[ t[ 3 ] ];
+            t[ 3 ] = kSBox[ tmp ];
+            rcon = _xtime( rcon );
+        }
+        for( j = 0; j < 4; ++j ) rk[ i + j ] = (byte)( rk[ i - 16 + j ] ^ t[ j ] );
+    }
+    aes->rounds = 10;
+    return( AesSetIV( aes, iv ) );
+}
+
+int AesSetKeyDirect( Aes *aes, const byte *userKey, word32 keylen, const byte *iv, int dir )
+{
+    return( AesSetKey( aes, userKey, keylen, iv, dir ) );
+}
+
+int AesSetIV( Aes *aes, const byte *iv )
+{
+    if( iv ) memcpy( aes->reg, iv, AES_BLOCK_SIZE );
+    else     memset( aes->reg, 0, AES_BLOCK_SIZE );
+    return( 0 );
+}
+
+void AesEncryptDirect( Aes *aes, byte *out, const byte *in )
+{
+    const byte *    rk = (const byte *) aes->key;
+    byte            s[ 16 ], t[ 16 ];
+    word32          r;
+    int             i, c;
+
+    for( i = 0; i < 16; ++i ) s[ i ] = (byte)( in[ i ] ^ rk[ i ] );
+    for( r = 1; r <= aes->rounds; ++r )
+    {
+        for( i = 0; i < 16; ++i ) t[ i ] = kSBox[ s[ ( i + 4 * ( i % 4 ) ) % 16 ] ];
+        if( r != aes->rounds )
+        {
+            for( c = 0; c < 16; c += 4 )
+            {
+                byte a0 = t[ c ], a1 = t[ c + 1 ], a2 = t[ c + 2 ], a3 = t[ c + 3 ];
+                s[ c ]     = (byte)( _xtime( a0 ) ^ _xtime( a1 ) ^ a1 ^ a2 ^ a3 );
+                s[ c + 1 ] = (byte)( a0 ^ _xtime( a1 ) ^ _xtime( a2 ) ^ a2 ^ a3 );
+                s[ c + 2 ] = (byte)( a0 ^ a1 ^ _xtime( a2 ) ^ _xtime( a3 ) ^ a3 );
+                s[ c + 3 ] = (byte)( _xtime( a0 ) ^ a0 ^ a1 ^ a2 ^ _xtime( a3 ) );
+            }
+        }
+        else
+        {
+            memcpy( s, t, 16 );
+        }
+        for( i = 0; i < 16; ++i ) s[ i ] ^= rk[ 16 * r + i ];
+    }
+    memcpy( out, s, 16 );
+}
+
+void AesDecryptDirect( Aes *aes, byte *out, const byte *in )
+{
+    const byte *    rk = (const byte *) aes->key;
+    byte            s[ 16 ], t[ 16 ];
+    word32          r;
+    int             i, c;
+
+    for( i = 0; i < 16; ++i ) s[ i ] = (byte)( in[ i ] ^ rk[ 16 * aes->rounds + i ] );
+    for( r = aes->rounds; r > 0; --r )
+    {
+        for( i = 0; i < 16; ++i ) t[ ( i + 4 * ( i % 4 ) ) % 16 ] = gInvSBox[ s[ i ] ];
+        for( i = 0; i < 16; ++i ) t[ i ] ^= rk[ 16 * ( r - 1 ) + i ];
+        if( r != 1 )
+        {
+            for( c = 0; c < 16; c += 4 )
+            {
+                byte a0 = t[ c ], a1 = t[ c + 1 ], a2 = t[ c + 2 ], a3 = t[ c + 3 ];
+                s[ c ]     = (byte)( _mul( a0, 14 ) ^ _mul( a1, 11 ) ^ _mul( a2, 13 ) ^ _mul( a3, 9 ) );
+                s[ c + 1 ] = (byte)( _mul( a0, 9 ) ^ _mul( a1, 14 ) ^ _mul( a2, 11 ) ^ _mul( a3, 13 ) );
+                s[ c + 2 ] = (byte)( _mul( a0, 13 ) ^ _mul( a1, 9 ) ^ _mul( a2, 14 ) ^ _mul( a3, 11 ) );
+                s[ c + 3 ] = (byte)( _mul( a0, 11 ) ^ _mul( a1, 13 ) ^ _mul( a2, 9 ) ^ _mul( a3, 14 ) );
+            }
+        }
+        else
+        {
+            memcpy( s, t, 16 );
+        }
+    }
+    memcpy( out, s, 16 );
+}
+
+int AesCbcEncrypt( Aes *aes, byte *out, const byte *in, word32 sz )
+{
+    byte *      reg = (byte *) aes->reg;
+    word32      i;
+    int         j;
+
+    for( i = 0; i + AES_BLOCK_SIZE <= sz; i += AES_BLOCK_SIZE )
+    {
+        for( j = 0; j < AES_BLOCK_SIZE; ++j ) reg[ j ] ^= in[ i + j ];
+        AesEncryptDirect( aes, reg, reg );
+        memcpy( &out[ i ], reg, AES_BLOCK_SIZE );
+    }
+    return( 0 );
+}
+
+int AesCbcDecrypt( Aes *aes, byte *out, const byte *in, word32 sz )
+{
+    byte *      reg = (byte *) aes->reg;
+    byte        c[ AES_BLOCK_SIZE ];
+    word32      i;
+    int         j;
+
+    for( i = 0; i + AES_BLOCK_SIZE <= sz; i += AES_BLOCK_SIZE )
+    {
+        memcpy( c, &in[ i ], AES_BLOCK_SIZE );
+        AesDecryptDirect( aes, &out[ i ], c );
+        for( j = 0; j < AES_BLOCK_SIZE; ++j ) out[ i + j ] ^= reg[ j ];
+        memcpy( reg, c, AES_BLOCK_SIZE );
+    }
+    return( 0 );
+}
@@ -0,0 +1,159 @@
+/**
+******************************************************************************
+* @file    HostStubs.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   MICO RTOS and driver calls implemented on POSIX threads for the
+*          host tests of the Support modules.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "HostStubs.h"
+#include "MICORTOS.h"
+
+HostRandomFunc      gHostRandomSource = NULL;
+int                 gHostTestFailures = 0;
+
+// Common.h routes printf to tinyprintf, on the host it goes to the C library.
+void tfp_printf( const char *fmt, ... )
+{
+    va_list     args;
+
+    va_start( args, fmt );
+    vprintf( fmt, args );
+    va_end( args );
+}
+
+// The scheduler lock is a recursive mutex, like vTaskSuspendAll it may nest.
+static pthread_mutex_t  gSchedulerLock;
+static pthread_once_t   gSchedulerOnce = PTHREAD_ONCE_INIT;
+
+static void _SchedulerLockInit( void )
+{
+    pthread_mutexattr_t     attr;
+
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &gSchedulerLock, &attr );
+    pthread_mutexattr_destroy( &attr );
+}
+
+void vTaskSuspendAll( void )
+{
+    pthread_once( &gSchedulerOnce, _SchedulerLockInit );
+    pthread_mutex_lock( &gSchedulerLock );
+}
+
+long xTaskResumeAll( void )
+{
+    pthread_mutex_unlock( &gSchedulerLock );
+    return( 0 );
+}
+
+uint32_t mico_get_time( void )
+{
+    struct timeval      tv;
+
+    gettimeofday( &tv, NULL );
+    return( (uint32_t)( ( tv.tv_sec * 1000 ) + ( tv.tv_usec / 1000 ) ) );
+}
+
+void mico_thread_msleep( uint32_t milliseconds )
+{
+    struct timespec     ts;
+
+    ts.tv_sec  = milliseconds / 1000;
+    ts.tv_nsec = (long)( milliseconds % 1000 ) * 1000000;
+    nanosleep( &ts, NULL );
+}
+
+typedef struct
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    int                 count;
+    int                 max;
+
+}   HostSemaphore;
+
+OSStatus mico_rtos_init_semaphore( mico_semaphore_t *semaphore, int count )
+{
+    HostSemaphore *     sem;
+
+    sem = (HostSemaphore *) calloc( 1, sizeof( *sem ) );
+    if( !sem ) return( kNoMemoryErr );
+    pthread_mutex_init( &sem->lock, NULL );
+    pthread_cond_init( &sem->cond, NULL );
+    sem->max = count;
+    *semaphore = sem;
+    return( kNoErr );
+}
+
+OSStatus mico_rtos_set_semaphore( mico_semaphore_t *semaphore )
+{
+    HostSemaphore *     sem = (HostSemaphore *) *semaphore;
+
+    pthread_mutex_lock( &sem->lock );
+    if( sem->count < sem->max ) sem->count += 1;
+    pthread_cond_signal( &sem->cond );
+    pthread_mutex_unlock( &sem->lock );
+    return( kNoErr );
+}
+
+OSStatus mico_rtos_get_semaphore( mico_semaphore_t *semaphore, uint32_t timeout_ms )
+{
+    HostSemaphore *     sem = (HostSemaphore *) *semaphore;
+
+    (void) timeout_ms;
+    pthread_mutex_lock( &sem->lock );
+    while( sem->count == 0 ) pthread_cond_wait( &sem->cond, &sem->lock );
+    sem->count -= 1;
+    pthread_mutex_unlock( &sem->lock );
+    return( kNoErr );
+}
+
+OSStatus mico_rtos_deinit_semaphore( mico_semaphore_t *semaphore )
+{
+    HostSemaphore *     sem = (HostSemaphore *) *semaphore;
+
+    pthread_cond_destroy( &sem->cond );
+    pthread_mutex_destroy( &sem->lock );
+    free( sem );
+    *semaphore = NULL;
+    return( kNoErr );
+}
+
+// Kept open, so the benchmarks time the reads and not the open.
+OSStatus MicoRandomNumberRead( void *inBuffer, int inByteCount )
+{
+    static FILE *   sFile = NULL;
+    size_t          n;
+
+    if( gHostRandomSource ) return( gHostRandomSource( inBuffer, inByteCount ) );
+
+    if( !sFile ) sFile = fopen( "/dev/urandom", "rb" );
+    if( !sFile ) return( kOpenErr );
+    n = fread( inBuffer, 1, (size_t) inByteCount, sFile );
+    return( ( n == (size_t) inByteCount ) ? kNoErr : kReadErr );
+}
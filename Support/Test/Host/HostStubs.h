@@ -0,0 +1,45 @@
+/**
+******************************************************************************
+* @file    HostStubs.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   MICO RTOS and driver calls implemented on POSIX threads for the
+*          host tests of the Support modules.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#ifndef __HostStubs_h__
+#define __HostStubs_h__
+
+#include "Common.h"
+
+// Replaces the platform RNG behind MicoRandomNumberRead, NULL reads /dev/urandom.
+typedef OSStatus ( *HostRandomFunc )( void *inBuffer, int inByteCount );
+extern HostRandomFunc   gHostRandomSource;
+
+// Simple test bookkeeping shared by the test programs.
+extern int              gHostTestFailures;
+
+#define host_check( X )                                                                     \
+    do                                                                                      \
+    {                                                                                       \
+        if( !( X ) )                                                                        \
+        {                                                                                   \
+            printf( "FAIL %s:%d: %s\n", __FILE__, __LINE__, #X );                           \
+            gHostTestFailures += 1;                                                         \
+        }                                                                                   \
+    }   while( 0 )
+
+#endif // __HostStubs_h__
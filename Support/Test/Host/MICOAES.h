@@ -0,0 +1,2 @@
+// Host builds run on case sensitive file systems, forward to include/MicoAES.h.
+#include "../../../include/MicoAES.h"
@@ -0,0 +1,2 @@
+// Application defaults for the host tests, the Support modules under test don't need any.
+#pragma once
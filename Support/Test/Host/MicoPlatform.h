@@ -0,0 +1,7 @@
+// Host stand-in for include/MicoPlatform.h, only the driver calls the Support modules under test use.
+#pragma once
+
+#include "Common.h"
+#include "MICORTOS.h"
+
+OSStatus MicoRandomNumberRead( void *inBuffer, int inByteCount );
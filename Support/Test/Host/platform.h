@@ -0,0 +1,2 @@
+// Host platform, nothing to configure.
+#pragma once
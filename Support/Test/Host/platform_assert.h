@@ -0,0 +1,3 @@
+// Host platform, a failed check just returns like a release build.
+#pragma once
+#define MICO_ASSERTION_FAIL_ACTION()
@@ -0,0 +1,308 @@
+/**
+******************************************************************************
+* @file    RandomUtilsTest.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Host test of the ChaCha20 DRBG: known answers, the health tests on
+*          the platform RNG and a throughput comparison with the raw driver.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*
+* Build and run from the repository root:
+*
+*   cc -std=c99 -O2 -DDEBUG=0 -ISupport/Test/Host -Iinclude -ISupport -IExternal -o RandomUtilsTest \
+*       Support/Test/RandomUtilsTest.c Support/Test/Host/HostStubs.c Support/Test/Host/HostAES.c \
+*       Support/CryptoProvider.c Support/AESUtils.c Support/SHAUtils.c Support/SecurityUtils.c \
+*       External/SHAUtils/sha1.c External/SHAUtils/sha224-256.c -lpthread
+*   ./RandomUtilsTest
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Small enough that the reseed path runs during the test.
+#define RANDOM_RESEED_BYTES     4096
+
+// Built into this file so the test can reach the ChaCha20 block and reset the generator between cases.
+#include "RandomUtils.c"
+
+#include "HostStubs.h"
+
+// RFC 7539 appendix A.1 test vector #1: all zero key, nonce and block counter.
+static const uint8_t kChaCha20Zero[ 64 ] =
+{
+    0x76, 0xB8, 0xE0, 0xAD, 0xA0, 0xF1, 0x3D, 0x90, 0x40, 0x5D, 0x6A, 0xE5, 0x53, 0x86, 0xBD, 0x28,
+    0xBD, 0xD2, 0x19, 0xB8, 0xA0, 0x8D, 0xED, 0x1A, 0xA8, 0x36, 0xEF, 0xCC, 0x8B, 0x77, 0x0D, 0xC7,
+    0xDA, 0x41, 0x59, 0x7C, 0x51, 0x57, 0x48, 0x8D, 0x77, 0x24, 0xE0, 0x3F, 0xB8, 0xD8, 0x4A, 0x37,
+    0x6A, 0x43, 0xB8, 0xF4, 0x15, 0x18, 0xA1, 0x1C, 0xC3, 0x87, 0xB6, 0x69, 0xB2, 0xEE, 0x65, 0x86
+};
+
+// DRBG output for the counter source below (byte i of the raw stream is i mod 256): 1024 start-up bytes are
+// discarded, the next 32 seed the key, then a 100 byte and a 16 byte request. Computed with an independent Python
+// ChaCha20 following the construction in RandomUtils.h.
+static const uint8_t kDRBGRequest1[ 100 ] =
+{
+    0xED, 0xF8, 0xDD, 0xC3, 0x25, 0xD4, 0x5F, 0xC8, 0x26, 0x2A, 0x0B, 0x35, 0x76, 0x1B, 0xFC, 0x13,
+    0xC6, 0xFF, 0x33, 0x43, 0x5F, 0x1D, 0x9E, 0x34, 0x7C, 0x02, 0x6C, 0xE7, 0xBC, 0x04, 0xFE, 0x52,
+    0x5F, 0xD8, 0x44, 0xAF, 0x20, 0xC3, 0x8D, 0xDC, 0xD7, 0x9C, 0xB9, 0x34, 0xB6, 0xAC, 0x59, 0xC9,
+    0x70, 0xEC, 0x0E, 0xEA, 0x9E, 0xFC, 0x46, 0x49, 0x1E, 0x2D, 0xA0, 0xE6, 0x63, 0xD7, 0x4B, 0xB5,
+    0x85, 0x98, 0x8A, 0x44, 0x76, 0x72, 0x3A, 0x94, 0xED, 0x84, 0x63, 0x6D, 0xCD, 0x70, 0x90, 0x55,
+    0xB9, 0xEB, 0xAD, 0xA5, 0x81, 0xA4, 0xE2, 0x07, 0xB9, 0xAF, 0x57, 0x74, 0xE7, 0x7E, 0x2A, 0xD2,
+    0x95, 0xAC, 0x60, 0xDB
+};
+
+static const uint8_t kDRBGRequest2[ 16 ] =
+{
+    0x1B, 0x63, 0x70, 0x64, 0xAE, 0x23, 0xF0, 0x7A, 0xB6, 0x19, 0xBD, 0x04, 0x6C, 0x45, 0xF9, 0x9B
+};
+
+//===========================================================================================================================
+//  Raw sources
+//
+//  Stand-ins for the platform RNG. Every byte read goes through the software crypto provider into
+//  MicoRandomNumberRead, which HostStubs forwards to gHostRandomSource.
+//===========================================================================================================================
+
+static uint32_t     gSourcePos;
+static uint8_t      gSourceValue;
+static uint32_t     gSourcePeriod;
+
+static void _RandomReset( HostRandomFunc inSource )
+{
+    memset( &gRandom, 0, sizeof( gRandom ) );
+    gSourcePos        = 0;
+    gHostRandomSource = inSource;
+}
+
+// i mod 256, passes both health tests.
+static OSStatus _CounterSource( void *inBuffer, int inByteCount )
+{
+    uint8_t *   p = (uint8_t *) inBuffer;
+    int         i;
+
+    for( i = 0; i < inByteCount; ++i ) p[ i ] = (uint8_t)( gSourcePos++ );
+    return( kNoErr );
+}
+
+// A dead RNG returning the same byte forever.
+static OSStatus _StuckSource( void *inBuffer, int inByteCount )
+{
+    memset( inBuffer, 0x07, (size_t) inByteCount );
+    return( kNoErr );
+}
+
+// Scrambled counter bytes with a run of gSourcePeriod copies of gSourceValue inside the start-up bytes.
+static OSStatus _RunSource( void *inBuffer, int inByteCount )
+{
+    uint8_t *   p = (uint8_t *) inBuffer;
+    int         i;
+
+    for( i = 0; i < inByteCount; ++i, ++gSourcePos )
+    {
+        if( ( gSourcePos >= 100 ) && ( gSourcePos < 100 + gSourcePeriod ) ) p[ i ] = gSourceValue;
+        else                                                                 p[ i ] = (uint8_t)( gSourcePos * 37 );
+    }
+    return( kNoErr );
+}
+
+// Scrambled counter bytes where every gSourcePeriod-th byte, starting with the first of each window, is gSourceValue.
+static OSStatus _BiasedSource( void *inBuffer, int inByteCount )
+{
+    uint8_t *   p = (uint8_t *) inBuffer;
+    int         i;
+
+    for( i = 0; i < inByteCount; ++i, ++gSourcePos )
+    {
+        if( ( ( gSourcePos % kRandomAPTWindow ) % gSourcePeriod ) == 0 )
+        {
+            p[ i ] = gSourceValue;
+        }
+        else
+        {
+            p[ i ] = (uint8_t)( gSourcePos * 37 );
+            if( p[ i ] == gSourceValue ) p[ i ] ^= 0x80;
+        }
+    }
+    return( kNoErr );
+}
+
+static OSStatus _FailingSource( void *inBuffer, int inByteCount )
+{
+    (void) inBuffer;
+    (void) inByteCount;
+    return( kTimeoutErr );
+}
+
+//===========================================================================================================================
+//  _TestKnownAnswers
+//===========================================================================================================================
+
+static void _WordsToBytes( const uint32_t *inWords, int inCount, uint8_t *outBytes )
+{
+    int     i;
+
+    for( i = 0; i < 4 * inCount; ++i ) outBytes[ i ] = (uint8_t)( inWords[ i / 4 ] >> ( 8 * ( i % 4 ) ) );
+}
+
+static void _TestKnownAnswers( void )
+{
+    uint32_t        key[ 8 ];
+    uint32_t        block[ 16 ];
+    uint32_t        aligned[ 32 ];
+    uint8_t         bytes[ 128 ];
+    RandomStats     stats;
+    int             i;
+
+    memset( key, 0, sizeof( key ) );
+    _ChaCha20Block( key, 0, NULL, block );
+    _WordsToBytes( block, 16, bytes );
+    host_check( memcmp( bytes, kChaCha20Zero, 64 ) == 0 );
+
+    // The RFC 7539 2.3.2 block the start-up self test uses.
+    for( i = 0; i < 8; ++i ) key[ i ] = 0x03020100 + ( 0x04040404 * (uint32_t) i );
+    _ChaCha20Block( key, 1, kChaCha20TestNonce, block );
+    host_check( memcmp( block, kChaCha20TestBlock, sizeof( block ) ) == 0 );
+
+    // Whole DRBG, once into an aligned buffer and once unaligned to cover both _ChaCha20Generate paths.
+    _RandomReset( _CounterSource );
+    host_check( RandomBytes( aligned, 100 ) == kNoErr );
+    host_check( memcmp( aligned, kDRBGRequest1, 100 ) == 0 );
+    host_check( RandomBytes( bytes + 1, 16 ) == kNoErr );
+    host_check( memcmp( bytes + 1, kDRBGRequest2, 16 ) == 0 );
+
+    _RandomReset( _CounterSource );
+    host_check( RandomBytes( bytes + 3, 100 ) == kNoErr );
+    host_check( memcmp( bytes + 3, kDRBGRequest1, 100 ) == 0 );
+
+    RandomGetStats( &stats );
+    host_check( stats.entropyBytes == 1024 + 32 );
+    host_check( stats.reseedCount == 1 );
+    host_check( stats.healthFailures == 0 );
+}
+
+//===========================================================================================================================
+//  _TestHealth
+//===========================================================================================================================
+
+static void _TestHealth( void )
+{
+    uint8_t         buf[ 64 ];
+    RandomStats     stats;
+    size_t          total;
+
+    // Stuck source: caught during start-up and latched.
+    _RandomReset( _StuckSource );
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kIntegrityErr );
+    host_check( RandomUInt32() == 0 );
+    gHostRandomSource = _CounterSource;
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kIntegrityErr );
+    host_check( RandomReseed() == kIntegrityErr );
+    RandomGetStats( &stats );
+    host_check( stats.healthFailures == 1 );
+
+    // Repetition count: a run one byte short of the cutoff passes, a run of the cutoff fails.
+    _RandomReset( _RunSource );
+    gSourceValue  = 0x5A;
+    gSourcePeriod = kRandomRCTCutoff - 1;
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kNoErr );
+
+    _RandomReset( _RunSource );
+    gSourcePeriod = kRandomRCTCutoff;
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kIntegrityErr );
+
+    // Adaptive proportion: the first byte of a window showing up kRandomAPTCutoff times fails, a bit less passes.
+    _RandomReset( _BiasedSource );
+    gSourceValue  = 0xA5;
+    gSourcePeriod = ( kRandomAPTWindow / kRandomAPTCutoff ) + 1;
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kNoErr );
+
+    _RandomReset( _BiasedSource );
+    gSourcePeriod = kRandomAPTWindow / kRandomAPTCutoff;
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kIntegrityErr );
+
+    // A driver error is passed up and does not latch the generator.
+    _RandomReset( _FailingSource );
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kTimeoutErr );
+    gHostRandomSource = _CounterSource;
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kNoErr );
+
+    // Reseed after RANDOM_RESEED_BYTES.
+    _RandomReset( _CounterSource );
+    for( total = 0; total <= RANDOM_RESEED_BYTES; total += sizeof( buf ) ) RandomBytes( buf, sizeof( buf ) );
+    host_check( RandomBytes( buf, sizeof( buf ) ) == kNoErr );
+    RandomGetStats( &stats );
+    host_check( stats.reseedCount == 2 );
+    host_check( stats.entropyBytes == 1024 + 32 + 32 );
+}
+
+//===========================================================================================================================
+//  _Benchmark
+//
+//  Bytes per second of RandomBytes and RandomContextBytes against reading the same amount straight from
+//  MicoRandomNumberRead, which on the host is /dev/urandom. Printed only, the numbers depend on the machine.
+//===========================================================================================================================
+
+static double _Now( void )
+{
+    struct timespec     ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec + ( ts.tv_nsec / 1e9 ) );
+}
+
+static void _Benchmark( void )
+{
+    static const size_t     kSizes[] = { 4, 32, 256, 4096 };
+    static uint8_t          buf[ 4096 ];
+    const size_t            total = 4 * 1024 * 1024;
+    RandomContext           context;
+    double                  start, drbg, ctx, raw;
+    size_t                  i, n;
+
+    _RandomReset( NULL );
+    host_check( RandomContextInit( &context ) == kNoErr );
+
+    printf( "request   RandomBytes   RandomContextBytes   MicoRandomNumberRead\n" );
+    for( i = 0; i < sizeof( kSizes ) / sizeof( kSizes[ 0 ] ); ++i )
+    {
+        start = _Now();
+        for( n = 0; n < total; n += kSizes[ i ] ) RandomBytes( buf, kSizes[ i ] );
+        drbg = _Now() - start;
+
+        start = _Now();
+        for( n = 0; n < total; n += kSizes[ i ] ) RandomContextBytes( &context, buf, kSizes[ i ] );
+        ctx = _Now() - start;
+
+        start = _Now();
+        for( n = 0; n < total / 16; n += kSizes[ i ] ) MicoRandomNumberRead( buf, (int) kSizes[ i ] );
+        raw = ( _Now() - start ) * 16;
+
+        printf( "%5u B   %7.1f MB/s   %12.1f MB/s   %14.1f MB/s\n", (unsigned int) kSizes[ i ],
+                total / drbg / 1e6, total / ctx / 1e6, total / raw / 1e6 );
+    }
+    RandomContextFree( &context );
+}
+
+int main( void )
+{
+    _TestKnownAnswers();
+    _TestHealth();
+    _Benchmark();
+
+    printf( "RandomUtilsTest: %s (%d failures)\n", gHostTestFailures ? "FAILED" : "PASSED", gHostTestFailures );
+    return( gHostTestFailures ? 1 : 0 );
+}
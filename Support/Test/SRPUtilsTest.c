@@ -0,0 +1,668 @@
+/**
+******************************************************************************
+* @file    SRPUtilsTest.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Host test of the SRP-6a server against fixed vectors and of the
+*          Montgomery exponentiation against a plain reference bignum.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*
+* Build and run from the repository root:
+*
+*   cc -std=c99 -O2 -finstrument-functions -DDEBUG=0 -ISupport/Test/Host -Iinclude -ISupport -IExternal -o SRPUtilsTest \
+*       Support/Test/SRPUtilsTest.c Support/Test/Host/HostStubs.c Support/SHAUtils.c Support/SecurityUtils.c \
+*       External/SHAUtils/sha1.c External/SHAUtils/sha384-512.c -lpthread
+*   ./SRPUtilsTest
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Built into this file so the test can reach _ModExp and the modulus setup directly.
+#include "SRPUtils.c"
+
+#include "HostStubs.h"
+
+// RFC 5054 appendix B inputs (I, P, s, a, b) run through the 3072-bit group with SHA-512, which is what HomeKit
+// pair setup uses. The expected values were computed with Python's arbitrary precision integers and hashlib, and
+// _TestVectors re-derives them with the reference bignum below before they are used against the server.
+
+static const uint8_t kSRPTest_s[ 16 ] =
+{
+    0xBE, 0xB2, 0x53, 0x79, 0xD1, 0xA8, 0x58, 0x1E, 0xB5, 0xA7, 0x27, 0x67, 0x3A, 0x24, 0x41, 0xEE
+};
+
+static const uint8_t kSRPTest_a[ 32 ] =
+{
+    0x60, 0x97, 0x55, 0x27, 0x03, 0x5C, 0xF2, 0xAD, 0x19, 0x89, 0x80, 0x6F, 0x04, 0x07, 0x21, 0x0B,
+    0xC8, 0x1E, 0xDC, 0x04, 0xE2, 0x76, 0x2A, 0x56, 0xAF, 0xD5, 0x29, 0xDD, 0xDA, 0x2D, 0x43, 0x93
+};
+
+static const uint8_t kSRPTest_b[ 32 ] =
+{
+    0xE4, 0x87, 0xCB, 0x59, 0xD3, 0x1A, 0xC5, 0x50, 0x47, 0x1E, 0x81, 0xF0, 0x0F, 0x69, 0x28, 0xE0,
+    0x1D, 0xDA, 0x08, 0xE9, 0x74, 0xA0, 0x04, 0xF4, 0x9E, 0x61, 0xF5, 0xD1, 0x05, 0x28, 0x4D, 0x20
+};
+
+static const uint8_t kSRPTest_k[ 64 ] =
+{
+    0xA9, 0xC2, 0xE2, 0x55, 0x9B, 0xF0, 0xEB, 0xB5, 0x3F, 0x0C, 0xBB, 0xF6, 0x22, 0x82, 0x90, 0x6B,
+    0xED, 0xE7, 0xF2, 0x18, 0x2F, 0x00, 0x67, 0x82, 0x11, 0xFB, 0xD5, 0xBD, 0xE5, 0xB2, 0x85, 0x03,
+    0x3A, 0x49, 0x93, 0x50, 0x3B, 0x87, 0x39, 0x7F, 0x9B, 0xE5, 0xEC, 0x02, 0x08, 0x0F, 0xED, 0xBC,
+    0x08, 0x35, 0x58, 0x7A, 0xD0, 0x39, 0x06, 0x08, 0x79, 0xB8, 0x62, 0x1E, 0x8C, 0x36, 0x59, 0xE0
+};
+
+static const uint8_t kSRPTest_x[ 64 ] =
+{
+    0xB1, 0x49, 0xEC, 0xB0, 0x94, 0x6B, 0x0B, 0x20, 0x6D, 0x77, 0xE7, 0x3D, 0x95, 0xDE, 0xB7, 0xC4,
+    0x1B, 0xD1, 0x2E, 0x86, 0xA5, 0xE2, 0xEE, 0xA3, 0x89, 0x3D, 0x54, 0x16, 0x59, 0x1A, 0x00, 0x2F,
+    0xF9, 0x4B, 0xFE, 0xA3, 0x84, 0xDC, 0x0E, 0x1C, 0x55, 0x0F, 0x7E, 0xD4, 0xD5, 0xA9, 0xD2, 0xAD,
+    0x1F, 0x15, 0x26, 0xF0, 0x1C, 0x56, 0xB5, 0xC1, 0x05, 0x77, 0x73, 0x0C, 0xC4, 0xA4, 0xD7, 0x09
+};
+
+static const uint8_t kSRPTest_v[ 384 ] =
+{
+    0x9B, 0x5E, 0x06, 0x17, 0x01, 0xEA, 0x7A, 0xEB, 0x39, 0xCF, 0x6E, 0x35, 0x19, 0x65, 0x5A, 0x85,
+    0x3C, 0xF9, 0x4C, 0x75, 0xCA, 0xF2, 0x55, 0x5E, 0xF1, 0xFA, 0xF7, 0x59, 0xBB, 0x79, 0xCB, 0x47,
+    0x70, 0x14, 0xE0, 0x4A, 0x88, 0xD6, 0x8F, 0xFC, 0x05, 0x32, 0x38, 0x91, 0xD4, 0xC2, 0x05, 0xB8,
+    0xDE, 0x81, 0xC2, 0xF2, 0x03, 0xD8, 0xFA, 0xD1, 0xB2, 0x4D, 0x2C, 0x10, 0x97, 0x37, 0xF1, 0xBE,
+    0xBB, 0xD7, 0x1F, 0x91, 0x24, 0x47, 0xC4, 0xA0, 0x3C, 0x26, 0xB9, 0xFA, 0xD8, 0xED, 0xB3, 0xE7,
+    0x80, 0x77, 0x8E, 0x30, 0x25, 0x29, 0xED, 0x1E, 0xE1, 0x38, 0xCC, 0xFC, 0x36, 0xD4, 0xBA, 0x31,
+    0x3C, 0xC4, 0x8B, 0x14, 0xEA, 0x8C, 0x22, 0xA0, 0x18, 0x6B, 0x22, 0x2E, 0x65, 0x5F, 0x2D, 0xF5,
+    0x60, 0x3F, 0xD7, 0x5D, 0xF7, 0x6B, 0x3B, 0x08, 0xFF, 0x89, 0x50, 0x06, 0x9A, 0xDD, 0x03, 0xA7,
+    0x54, 0xEE, 0x4A, 0xE8, 0x85, 0x87, 0xCC, 0xE1, 0xBF, 0xDE, 0x36, 0x79, 0x4D, 0xBA, 0xE4, 0x59,
+    0x2B, 0x7B, 0x90, 0x4F, 0x44, 0x2B, 0x04, 0x1C, 0xB1, 0x7A, 0xEB, 0xAD, 0x1E, 0x3A, 0xEB, 0xE3,
+    0xCB, 0xE9, 0x9D, 0xE6, 0x5F, 0x4B, 0xB1, 0xFA, 0x00, 0xB0, 0xE7, 0xAF, 0x06, 0x86, 0x3D, 0xB5,
+    0x3B, 0x02, 0x25, 0x4E, 0xC6, 0x6E, 0x78, 0x1E, 0x3B, 0x62, 0xA8, 0x21, 0x2C, 0x86, 0xBE, 0xB0,
+    0xD5, 0x0B, 0x5B, 0xA6, 0xD0, 0xB4, 0x78, 0xD8, 0xC4, 0xE9, 0xBB, 0xCE, 0xC2, 0x17, 0x65, 0x32,
+    0x6F, 0xBD, 0x14, 0x05, 0x8D, 0x2B, 0xBD, 0xE2, 0xC3, 0x30, 0x45, 0xF0, 0x38, 0x73, 0xE5, 0x39,
+    0x48, 0xD7, 0x8B, 0x79, 0x4F, 0x07, 0x90, 0xE4, 0x8C, 0x36, 0xAE, 0xD6, 0xE8, 0x80, 0xF5, 0x57,
+    0x42, 0x7B, 0x2F, 0xC0, 0x6D, 0xB5, 0xE1, 0xE2, 0xE1, 0xD7, 0xE6, 0x61, 0xAC, 0x48, 0x2D, 0x18,
+    0xE5, 0x28, 0xD7, 0x29, 0x5E, 0xF7, 0x43, 0x72, 0x95, 0xFF, 0x1A, 0x72, 0xD4, 0x02, 0x77, 0x17,
+    0x13, 0xF1, 0x68, 0x76, 0xDD, 0x05, 0x0A, 0xE5, 0xB7, 0xAD, 0x53, 0xCC, 0xB9, 0x08, 0x55, 0xC9,
+    0x39, 0x56, 0x64, 0x83, 0x58, 0xAD, 0xFD, 0x96, 0x64, 0x22, 0xF5, 0x24, 0x98, 0x73, 0x2D, 0x68,
+    0xD1, 0xD7, 0xFB, 0xEF, 0x10, 0xD7, 0x80, 0x34, 0xAB, 0x8D, 0xCB, 0x6F, 0x0F, 0xCF, 0x88, 0x5C,
+    0xC2, 0xB2, 0xEA, 0x2C, 0x3E, 0x6A, 0xC8, 0x66, 0x09, 0xEA, 0x05, 0x8A, 0x9D, 0xA8, 0xCC, 0x63,
+    0x53, 0x1D, 0xC9, 0x15, 0x41, 0x4D, 0xF5, 0x68, 0xB0, 0x94, 0x82, 0xDD, 0xAC, 0x19, 0x54, 0xDE,
+    0xC7, 0xEB, 0x71, 0x4F, 0x6F, 0xF7, 0xD4, 0x4C, 0xD5, 0xB8, 0x6F, 0x6B, 0xD1, 0x15, 0x81, 0x09,
+    0x30, 0x63, 0x7C, 0x01, 0xD0, 0xF6, 0x01, 0x3B, 0xC9, 0x74, 0x0F, 0xA2, 0xC6, 0x33, 0xBA, 0x89
+};
+
+static const uint8_t kSRPTest_A[ 384 ] =
+{
+    0xFA, 0xB6, 0xF5, 0xD2, 0x61, 0x5D, 0x1E, 0x32, 0x35, 0x12, 0xE7, 0x99, 0x1C, 0xC3, 0x74, 0x43,
+    0xF4, 0x87, 0xDA, 0x60, 0x4C, 0xA8, 0xC9, 0x23, 0x0F, 0xCB, 0x04, 0xE5, 0x41, 0xDC, 0xE6, 0x28,
+    0x0B, 0x27, 0xCA, 0x46, 0x80, 0xB0, 0x37, 0x4F, 0x17, 0x9D, 0xC3, 0xBD, 0xC7, 0x55, 0x3F, 0xE6,
+    0x24, 0x59, 0x79, 0x8C, 0x70, 0x1A, 0xD8, 0x64, 0xA9, 0x13, 0x90, 0xA2, 0x8C, 0x93, 0xB6, 0x44,
+    0xAD, 0xBF, 0x9C, 0x00, 0x74, 0x5B, 0x94, 0x2B, 0x79, 0xF9, 0x01, 0x2A, 0x21, 0xB9, 0xB7, 0x87,
+    0x82, 0x31, 0x9D, 0x83, 0xA1, 0xF8, 0x36, 0x28, 0x66, 0xFB, 0xD6, 0xF4, 0x6B, 0xFC, 0x0D, 0xDB,
+    0x2E, 0x1A, 0xB6, 0xE4, 0xB4, 0x5A, 0x99, 0x06, 0xB8, 0x2E, 0x37, 0xF0, 0x5D, 0x6F, 0x97, 0xF6,
+    0xA3, 0xEB, 0x6E, 0x18, 0x20, 0x79, 0x75, 0x9C, 0x4F, 0x68, 0x47, 0x83, 0x7B, 0x62, 0x32, 0x1A,
+    0xC1, 0xB4, 0xFA, 0x68, 0x64, 0x1F, 0xCB, 0x4B, 0xB9, 0x8D, 0xD6, 0x97, 0xA0, 0xC7, 0x36, 0x41,
+    0x38, 0x5F, 0x4B, 0xAB, 0x25, 0xB7, 0x93, 0x58, 0x4C, 0xC3, 0x9F, 0xC8, 0xD4, 0x8D, 0x4B, 0xD8,
+    0x67, 0xA9, 0xA3, 0xC1, 0x0F, 0x8E, 0xA1, 0x21, 0x70, 0x26, 0x8E, 0x34, 0xFE, 0x3B, 0xBE, 0x6F,
+    0xF8, 0x99, 0x98, 0xD6, 0x0D, 0xA2, 0xF3, 0xE4, 0x28, 0x3C, 0xBE, 0xC1, 0x39, 0x3D, 0x52, 0xAF,
+    0x72, 0x4A, 0x57, 0x23, 0x0C, 0x60, 0x4E, 0x9F, 0xBC, 0xE5, 0x83, 0xD7, 0x61, 0x3E, 0x6B, 0xFF,
+    0xD6, 0x75, 0x96, 0xAD, 0x12, 0x1A, 0x87, 0x07, 0xEE, 0xC4, 0x69, 0x44, 0x95, 0x70, 0x33, 0x68,
+    0x6A, 0x15, 0x5F, 0x64, 0x4D, 0x5C, 0x58, 0x63, 0xB4, 0x8F, 0x61, 0xBD, 0xBF, 0x19, 0xA5, 0x3E,
+    0xAB, 0x6D, 0xAD, 0x0A, 0x18, 0x6B, 0x8C, 0x15, 0x2E, 0x5F, 0x5D, 0x8C, 0xAD, 0x4B, 0x0E, 0xF8,
+    0xAA, 0x4E, 0xA5, 0x00, 0x88, 0x34, 0xC3, 0xCD, 0x34, 0x2E, 0x5E, 0x0F, 0x16, 0x7A, 0xD0, 0x45,
+    0x92, 0xCD, 0x8B, 0xD2, 0x79, 0x63, 0x93, 0x98, 0xEF, 0x9E, 0x11, 0x4D, 0xFA, 0xAA, 0xB9, 0x19,
+    0xE1, 0x4E, 0x85, 0x09, 0x89, 0x22, 0x4D, 0xDD, 0x98, 0x57, 0x6D, 0x79, 0x38, 0x5D, 0x22, 0x10,
+    0x90, 0x2E, 0x9F, 0x9B, 0x1F, 0x2D, 0x86, 0xCF, 0xA4, 0x7E, 0xE2, 0x44, 0x63, 0x54, 0x65, 0xF7,
+    0x10, 0x58, 0x42, 0x1A, 0x01, 0x84, 0xBE, 0x51, 0xDD, 0x10, 0xCC, 0x9D, 0x07, 0x9E, 0x6F, 0x16,
+    0x04, 0xE7, 0xAA, 0x9B, 0x7C, 0xF7, 0x88, 0x3C, 0x7D, 0x4C, 0xE1, 0x2B, 0x06, 0xEB, 0xE1, 0x60,
+    0x81, 0xE2, 0x3F, 0x27, 0xA2, 0x31, 0xD1, 0x84, 0x32, 0xD7, 0xD1, 0xBB, 0x55, 0xC2, 0x8A, 0xE2,
+    0x1F, 0xFC, 0xF0, 0x05, 0xF5, 0x75, 0x28, 0xD1, 0x5A, 0x88, 0x88, 0x1B, 0xB3, 0xBB, 0xB7, 0xFE
+};
+
+static const uint8_t kSRPTest_B[ 384 ] =
+{
+    0x40, 0xF5, 0x70, 0x88, 0xA4, 0x82, 0xD4, 0xC7, 0x73, 0x33, 0x84, 0xFE, 0x0D, 0x30, 0x1F, 0xDD,
+    0xCA, 0x90, 0x80, 0xAD, 0x7D, 0x4F, 0x6F, 0xDF, 0x09, 0xA0, 0x10, 0x06, 0xC3, 0xCB, 0x6D, 0x56,
+    0x2E, 0x41, 0x63, 0x9A, 0xE8, 0xFA, 0x21, 0xDE, 0x3B, 0x5D, 0xBA, 0x75, 0x85, 0xB2, 0x75, 0x58,
+    0x9B, 0xDB, 0x27, 0x98, 0x63, 0xC5, 0x62, 0x80, 0x7B, 0x2B, 0x99, 0x08, 0x3C, 0xD1, 0x42, 0x9C,
+    0xDB, 0xE8, 0x9E, 0x25, 0xBF, 0xBD, 0x7E, 0x3C, 0xAD, 0x31, 0x73, 0xB2, 0xE3, 0xC5, 0xA0, 0xB1,
+    0x74, 0xDA, 0x6D, 0x53, 0x91, 0xE6, 0xA0, 0x6E, 0x46, 0x5F, 0x03, 0x7A, 0x40, 0x06, 0x25, 0x48,
+    0x39, 0xA5, 0x6B, 0xF7, 0x6D, 0xA8, 0x4B, 0x1C, 0x94, 0xE0, 0xAE, 0x20, 0x85, 0x76, 0x15, 0x6F,
+    0xE5, 0xC1, 0x40, 0xA4, 0xBA, 0x4F, 0xFC, 0x9E, 0x38, 0xC3, 0xB0, 0x7B, 0x88, 0x84, 0x5F, 0xC6,
+    0xF7, 0xDD, 0xDA, 0x93, 0x38, 0x1F, 0xE0, 0xCA, 0x60, 0x84, 0xC4, 0xCD, 0x2D, 0x33, 0x6E, 0x54,
+    0x51, 0xC4, 0x64, 0xCC, 0xB6, 0xEC, 0x65, 0xE7, 0xD1, 0x6E, 0x54, 0x8A, 0x27, 0x3E, 0x82, 0x62,
+    0x84, 0xAF, 0x25, 0x59, 0xB6, 0x26, 0x42, 0x74, 0x21, 0x59, 0x60, 0xFF, 0xF4, 0x7B, 0xDD, 0x63,
+    0xD3, 0xAF, 0xF0, 0x64, 0xD6, 0x13, 0x7A, 0xF7, 0x69, 0x66, 0x1C, 0x9D, 0x4F, 0xEE, 0x47, 0x38,
+    0x26, 0x03, 0xC8, 0x8E, 0xAA, 0x09, 0x80, 0x58, 0x1D, 0x07, 0x75, 0x84, 0x61, 0xB7, 0x77, 0xE4,
+    0x35, 0x6D, 0xDA, 0x58, 0x35, 0x19, 0x8B, 0x51, 0xFE, 0xEA, 0x30, 0x8D, 0x70, 0xF7, 0x54, 0x50,
+    0xB7, 0x16, 0x75, 0xC0, 0x8C, 0x7D, 0x83, 0x02, 0xFD, 0x75, 0x39, 0xDD, 0x1F, 0xF2, 0xA1, 0x1C,
+    0xB4, 0x25, 0x8A, 0xA7, 0x0D, 0x23, 0x44, 0x36, 0xAA, 0x42, 0xB6, 0xA0, 0x61, 0x5F, 0x3F, 0x91,
+    0x5D, 0x55, 0xCC, 0x3B, 0x96, 0x6B, 0x27, 0x16, 0xB3, 0x6E, 0x4D, 0x1A, 0x06, 0xCE, 0x5E, 0x5D,
+    0x2E, 0xA3, 0xBE, 0xE5, 0xA1, 0x27, 0x0E, 0x87, 0x51, 0xDA, 0x45, 0xB6, 0x0B, 0x99, 0x7B, 0x0F,
+    0xFD, 0xB0, 0xF9, 0x96, 0x2F, 0xEE, 0x4F, 0x03, 0xBE, 0xE7, 0x80, 0xBA, 0x0A, 0x84, 0x5B, 0x1D,
+    0x92, 0x71, 0x42, 0x17, 0x83, 0xAE, 0x66, 0x01, 0xA6, 0x1E, 0xA2, 0xE3, 0x42, 0xE4, 0xF2, 0xE8,
+    0xBC, 0x93, 0x5A, 0x40, 0x9E, 0xAD, 0x19, 0xF2, 0x21, 0xBD, 0x1B, 0x74, 0xE2, 0x96, 0x4D, 0xD1,
+    0x9F, 0xC8, 0x45, 0xF6, 0x0E, 0xFC, 0x09, 0x33, 0x8B, 0x60, 0xB6, 0xB2, 0x56, 0xD8, 0xCA, 0xC8,
+    0x89, 0xCC, 0xA3, 0x06, 0xCC, 0x37, 0x0A, 0x0B, 0x18, 0xC8, 0xB8, 0x86, 0xE9, 0x5D, 0xA0, 0xAF,
+    0x52, 0x35, 0xFE, 0xF4, 0x39, 0x30, 0x20, 0xD2, 0xB7, 0xF3, 0x05, 0x69, 0x04, 0x75, 0x90, 0x42
+};
+
+static const uint8_t kSRPTest_u[ 64 ] =
+{
+    0x03, 0xAE, 0x5F, 0x3C, 0x3F, 0xA9, 0xEF, 0xF1, 0xA5, 0x0D, 0x7D, 0xBB, 0x8D, 0x2F, 0x60, 0xA1,
+    0xEA, 0x66, 0xEA, 0x71, 0x2D, 0x50, 0xAE, 0x97, 0x6E, 0xE3, 0x46, 0x41, 0xA1, 0xCD, 0x0E, 0x51,
+    0xC4, 0x68, 0x3D, 0xA3, 0x83, 0xE8, 0x59, 0x5D, 0x6C, 0xB5, 0x6A, 0x15, 0xD5, 0xFB, 0xC7, 0x54,
+    0x3E, 0x07, 0xFB, 0xDD, 0xD3, 0x16, 0x21, 0x7E, 0x01, 0xA3, 0x91, 0xA1, 0x8E, 0xF0, 0x6D, 0xFF
+};
+
+static const uint8_t kSRPTest_S[ 384 ] =
+{
+    0xF1, 0x03, 0x6F, 0xEC, 0xD0, 0x17, 0xC8, 0x23, 0x9C, 0x0D, 0x5A, 0xF7, 0xE0, 0xFC, 0xF0, 0xD4,
+    0x08, 0xB0, 0x09, 0xE3, 0x64, 0x11, 0x61, 0x8A, 0x60, 0xB2, 0x3A, 0xAB, 0xBF, 0xC3, 0x83, 0x39,
+    0x72, 0x68, 0x23, 0x12, 0x14, 0xBA, 0xAC, 0xDC, 0x94, 0xCA, 0x1C, 0x53, 0xF4, 0x42, 0xFB, 0x51,
+    0xC1, 0xB0, 0x27, 0xC3, 0x18, 0xAE, 0x23, 0x8E, 0x16, 0x41, 0x4D, 0x60, 0xD1, 0x88, 0x1B, 0x66,
+    0x48, 0x6A, 0xDE, 0x10, 0xED, 0x02, 0xBA, 0x33, 0xD0, 0x98, 0xF6, 0xCE, 0x9B, 0xCF, 0x1B, 0xB0,
+    0xC4, 0x6C, 0xA2, 0xC4, 0x7F, 0x2F, 0x17, 0x4C, 0x59, 0xA9, 0xC6, 0x1E, 0x25, 0x60, 0x89, 0x9B,
+    0x83, 0xEF, 0x61, 0x13, 0x1E, 0x6F, 0xB3, 0x0B, 0x71, 0x4F, 0x4E, 0x43, 0xB7, 0x35, 0xC9, 0xFE,
+    0x60, 0x80, 0x47, 0x7C, 0x1B, 0x83, 0xE4, 0x09, 0x3E, 0x4D, 0x45, 0x6B, 0x9B, 0xCA, 0x49, 0x2C,
+    0xF9, 0x33, 0x9D, 0x45, 0xBC, 0x42, 0xE6, 0x7C, 0xE6, 0xC0, 0x2C, 0x24, 0x3E, 0x49, 0xF5, 0xDA,
+    0x42, 0xA8, 0x69, 0xEC, 0x85, 0x57, 0x80, 0xE8, 0x42, 0x07, 0xB8, 0xA1, 0xEA, 0x65, 0x01, 0xC4,
+    0x78, 0xAA, 0xC0, 0xDF, 0xD3, 0xD2, 0x26, 0x14, 0xF5, 0x31, 0xA0, 0x0D, 0x82, 0x6B, 0x79, 0x54,
+    0xAE, 0x8B, 0x14, 0xA9, 0x85, 0xA4, 0x29, 0x31, 0x5E, 0x6D, 0xD3, 0x66, 0x4C, 0xF4, 0x71, 0x81,
+    0x49, 0x6A, 0x94, 0x32, 0x9C, 0xDE, 0x80, 0x05, 0xCA, 0xE6, 0x3C, 0x2F, 0x9C, 0xA4, 0x96, 0x9B,
+    0xFE, 0x84, 0x00, 0x19, 0x24, 0x03, 0x7C, 0x44, 0x65, 0x59, 0xBD, 0xBB, 0x9D, 0xB9, 0xD4, 0xDD,
+    0x14, 0x2F, 0xBC, 0xD7, 0x5E, 0xEF, 0x2E, 0x16, 0x2C, 0x84, 0x30, 0x65, 0xD9, 0x9E, 0x8F, 0x05,
+    0x76, 0x2C, 0x4D, 0xB7, 0xAB, 0xD9, 0xDB, 0x20, 0x3D, 0x41, 0xAC, 0x85, 0xA5, 0x8C, 0x05, 0xBD,
+    0x4E, 0x2D, 0xBF, 0x82, 0x2A, 0x93, 0x45, 0x23, 0xD5, 0x4E, 0x06, 0x53, 0xD3, 0x76, 0xCE, 0x8B,
+    0x56, 0xDC, 0xB4, 0x52, 0x7D, 0xDD, 0xC1, 0xB9, 0x94, 0xDC, 0x75, 0x09, 0x46, 0x3A, 0x74, 0x68,
+    0xD7, 0xF0, 0x2B, 0x1B, 0xEB, 0x16, 0x85, 0x71, 0x4C, 0xE1, 0xDD, 0x1E, 0x71, 0x80, 0x8A, 0x13,
+    0x7F, 0x78, 0x88, 0x47, 0xB7, 0xC6, 0xB7, 0xBF, 0xA1, 0x36, 0x44, 0x74, 0xB3, 0xB7, 0xE8, 0x94,
+    0x78, 0x95, 0x4F, 0x6A, 0x8E, 0x68, 0xD4, 0x5B, 0x85, 0xA8, 0x8E, 0x4E, 0xBF, 0xEC, 0x13, 0x36,
+    0x8E, 0xC0, 0x89, 0x1C, 0x3B, 0xC8, 0x6C, 0xF5, 0x00, 0x97, 0x88, 0x01, 0x78, 0xD8, 0x61, 0x35,
+    0xE7, 0x28, 0x72, 0x34, 0x58, 0x53, 0x88, 0x58, 0xD7, 0x15, 0xB7, 0xB2, 0x47, 0x40, 0x62, 0x22,
+    0xC1, 0x01, 0x9F, 0x53, 0x60, 0x3F, 0x01, 0x69, 0x52, 0xD4, 0x97, 0x10, 0x08, 0x58, 0x82, 0x4C
+};
+
+static const uint8_t kSRPTest_K[ 64 ] =
+{
+    0x5C, 0xBC, 0x21, 0x9D, 0xB0, 0x52, 0x13, 0x8E, 0xE1, 0x14, 0x8C, 0x71, 0xCD, 0x44, 0x98, 0x96,
+    0x3D, 0x68, 0x25, 0x49, 0xCE, 0x91, 0xCA, 0x24, 0xF0, 0x98, 0x46, 0x8F, 0x06, 0x01, 0x5B, 0xEB,
+    0x6A, 0xF2, 0x45, 0xC2, 0x09, 0x3F, 0x98, 0xC3, 0x65, 0x1B, 0xCA, 0x83, 0xAB, 0x8C, 0xAB, 0x2B,
+    0x58, 0x0B, 0xBF, 0x02, 0x18, 0x4F, 0xEF, 0xDF, 0x26, 0x14, 0x2F, 0x73, 0xDF, 0x95, 0xAC, 0x50
+};
+
+static const uint8_t kSRPTest_M1[ 64 ] =
+{
+    0x5F, 0x7C, 0x14, 0xAB, 0x57, 0xED, 0x0E, 0x94, 0xFD, 0x1D, 0x78, 0xC6, 0xB4, 0xDD, 0x09, 0xED,
+    0x7E, 0x34, 0x0B, 0x7E, 0x05, 0xD4, 0x19, 0xA9, 0xFD, 0x76, 0x0F, 0x6B, 0x35, 0xE5, 0x23, 0xD1,
+    0x31, 0x07, 0x77, 0xA1, 0xAE, 0x1D, 0x28, 0x26, 0xF5, 0x96, 0xF3, 0xA8, 0x51, 0x16, 0xCC, 0x45,
+    0x7C, 0x7C, 0x96, 0x4D, 0x4F, 0x44, 0xDE, 0xD5, 0x55, 0x9D, 0xA8, 0x18, 0xC8, 0x8B, 0x61, 0x7F
+};
+
+static const uint8_t kSRPTest_M2[ 64 ] =
+{
+    0x2F, 0xA0, 0xE8, 0x1F, 0x5C, 0xB7, 0x3B, 0x88, 0xFA, 0x09, 0x64, 0x27, 0x0F, 0x32, 0x1D, 0xD6,
+    0x41, 0xF2, 0x22, 0x7A, 0x5D, 0x80, 0x5C, 0x40, 0xF1, 0xBF, 0xE9, 0x6A, 0xAF, 0x6A, 0x19, 0xFF,
+    0xCE, 0x8E, 0x23, 0x28, 0x79, 0x65, 0xA3, 0x9E, 0xAB, 0x9D, 0x5A, 0x02, 0x21, 0x5F, 0x89, 0xE1,
+    0x28, 0x17, 0x7E, 0xD2, 0xC4, 0xF1, 0x03, 0xE6, 0x55, 0xA0, 0x45, 0x53, 0x1B, 0xCB, 0xF7, 0xAD
+};
+
+//===========================================================================================================================
+//  RandomBytes
+//
+//  Replaces RandomUtils so the salt and b come from the vectors.
+//===========================================================================================================================
+
+static const uint8_t *  gRandomPtr  = NULL;
+static size_t           gRandomLeft = 0;
+
+static void _RandomQueue( const uint8_t *inPtr, size_t inLen )
+{
+    gRandomPtr  = inPtr;
+    gRandomLeft = inLen;
+}
+
+OSStatus RandomBytes( void *inBuffer, size_t inLen )
+{
+    if( inLen > gRandomLeft ) return( kNoResourcesErr );
+    memcpy( inBuffer, gRandomPtr, inLen );
+    gRandomPtr  += inLen;
+    gRandomLeft -= inLen;
+    return( kNoErr );
+}
+
+//===========================================================================================================================
+//  Reference bignum
+//
+//  Little endian words like SRPUtils, but nothing shared with it: multiplication is shift and add with a compare and
+//  subtract after every step. Slow and variable time, and simple enough to be obviously right.
+//===========================================================================================================================
+
+#define kRefWords       ( 384 / 4 )
+
+typedef struct
+{
+    uint32_t        w[ kRefWords ];
+
+}   RefNum;
+
+static RefNum   gRefN;
+
+static void _RefFromBytes( RefNum *outR, const uint8_t *inPtr, size_t inLen )
+{
+    size_t      i;
+
+    memset( outR, 0, sizeof( *outR ) );
+    for( i = 0; i < inLen; ++i ) outR->w[ i / 4 ] |= ( (uint32_t) inPtr[ inLen - 1 - i ] ) << ( 8 * ( i % 4 ) );
+}
+
+static void _RefToBytes( const RefNum *inA, uint8_t outPtr[ 384 ] )
+{
+    int     i;
+
+    for( i = 0; i < 384; ++i ) outPtr[ 383 - i ] = (uint8_t)( inA->w[ i / 4 ] >> ( 8 * ( i % 4 ) ) );
+}
+
+static int _RefGE( const RefNum *inA, const RefNum *inB )
+{
+    int     i;
+
+    for( i = kRefWords - 1; i >= 0; --i )
+    {
+        if( inA->w[ i ] != inB->w[ i ] ) return( inA->w[ i ] > inB->w[ i ] );
+    }
+    return( 1 );
+}
+
+static void _RefSubN( RefNum *ioA )
+{
+    uint64_t    t;
+    uint32_t    borrow = 0;
+    int         i;
+
+    for( i = 0; i < kRefWords; ++i )
+    {
+        t = (uint64_t) ioA->w[ i ] - gRefN.w[ i ] - borrow;
+        ioA->w[ i ] = (uint32_t) t;
+        borrow = (uint32_t)( t >> 63 );
+    }
+}
+
+// ioA = ( ioA + inB ) mod N for inputs < N.
+static void _RefModAdd( RefNum *ioA, const RefNum *inB )
+{
+    uint64_t    t;
+    uint32_t    carry = 0;
+    int         i;
+
+    for( i = 0; i < kRefWords; ++i )
+    {
+        t = (uint64_t) ioA->w[ i ] + inB->w[ i ] + carry;
+        ioA->w[ i ] = (uint32_t) t;
+        carry = (uint32_t)( t >> 32 );
+    }
+    if( carry || _RefGE( ioA, &gRefN ) ) _RefSubN( ioA );
+}
+
+static void _RefModMul( RefNum *outR, const RefNum *inA, const RefNum *inB )
+{
+    RefNum      r;
+    int         bit;
+
+    memset( &r, 0, sizeof( r ) );
+    for( bit = 32 * kRefWords - 1; bit >= 0; --bit )
+    {
+        _RefModAdd( &r, &r );
+        if( ( inB->w[ bit / 32 ] >> ( bit % 32 ) ) & 1 ) _RefModAdd( &r, inA );
+    }
+    *outR = r;
+}
+
+static void _RefModExp( RefNum *outR, const RefNum *inBase, const uint8_t *inExp, size_t inExpLen )
+{
+    RefNum      r;
+    size_t      i;
+    int         bit;
+
+    memset( &r, 0, sizeof( r ) );
+    r.w[ 0 ] = 1;
+    for( i = 0; i < inExpLen; ++i )
+    {
+        for( bit = 7; bit >= 0; --bit )
+        {
+            _RefModMul( &r, &r, &r );
+            if( ( inExp[ i ] >> bit ) & 1 ) _RefModMul( &r, &r, inBase );
+        }
+    }
+    *outR = r;
+}
+
+static void _RefModExpBytes( uint8_t outR[ 384 ], const uint8_t *inBase, size_t inBaseLen, const uint8_t *inExp, size_t inExpLen )
+{
+    RefNum      base, r;
+
+    _RefFromBytes( &base, inBase, inBaseLen );
+    _RefModExp( &r, &base, inExp, inExpLen );
+    _RefToBytes( &r, outR );
+}
+
+static void _SHA512( uint8_t outDigest[ 64 ], const void *inA, size_t inALen, const void *inB, size_t inBLen )
+{
+    SHA512_CTX_compat   ctx;
+
+    SHA512_Init_compat( &ctx );
+    SHA512_Update_compat( &ctx, inA, inALen );
+    if( inB ) SHA512_Update_compat( &ctx, inB, inBLen );
+    SHA512_Final_compat( outDigest, &ctx );
+}
+
+//===========================================================================================================================
+//  _TestVectors
+//
+//  Checks every vector against its definition, so a typo in the tables cannot make the server tests meaningless.
+//===========================================================================================================================
+
+static void _TestVectors( void )
+{
+    static const uint8_t    kG = 5;
+    uint8_t                 buf[ 384 ];
+    uint8_t                 pad[ 384 ];
+    uint8_t                 digest[ 64 ];
+    uint8_t                 hng[ 64 ];
+    SHA512_CTX_compat       ctx;
+    RefNum                  a, b, r;
+    int                     i;
+
+    // k = H(N | PAD(g))
+    memset( pad, 0, sizeof( pad ) );
+    pad[ 383 ] = kG;
+    _SHA512( digest, kSRP_N3072, 384, pad, 384 );
+    host_check( memcmp( digest, kSRPTest_k, 64 ) == 0 );
+
+    // x = H(s | H(I | ":" | P))
+    _SHA512( digest, "alice:password123", 17, NULL, 0 );
+    _SHA512( digest, kSRPTest_s, 16, digest, 64 );
+    host_check( memcmp( digest, kSRPTest_x, 64 ) == 0 );
+
+    // v = g^x, A = g^a
+    _RefModExpBytes( buf, &kG, 1, kSRPTest_x, 64 );
+    host_check( memcmp( buf, kSRPTest_v, 384 ) == 0 );
+    _RefModExpBytes( buf, &kG, 1, kSRPTest_a, 32 );
+    host_check( memcmp( buf, kSRPTest_A, 384 ) == 0 );
+
+    // B = k*v + g^b
+    _RefFromBytes( &a, kSRPTest_k, 64 );
+    _RefFromBytes( &b, kSRPTest_v, 384 );
+    _RefModMul( &r, &a, &b );
+    _RefModExpBytes( buf, &kG, 1, kSRPTest_b, 32 );
+    _RefFromBytes( &a, buf, 384 );
+    _RefModAdd( &r, &a );
+    _RefToBytes( &r, buf );
+    host_check( memcmp( buf, kSRPTest_B, 384 ) == 0 );
+
+    // u = H(PAD(A) | PAD(B))
+    _SHA512( digest, kSRPTest_A, 384, kSRPTest_B, 384 );
+    host_check( memcmp( digest, kSRPTest_u, 64 ) == 0 );
+
+    // S = (A * v^u)^b, the server side formula
+    _RefModExpBytes( buf, kSRPTest_v, 384, kSRPTest_u, 64 );
+    _RefFromBytes( &a, buf, 384 );
+    _RefFromBytes( &b, kSRPTest_A, 384 );
+    _RefModMul( &r, &a, &b );
+    _RefToBytes( &r, buf );
+    _RefModExpBytes( buf, buf, 384, kSRPTest_b, 32 );
+    host_check( memcmp( buf, kSRPTest_S, 384 ) == 0 );
+
+    // K = H(PAD(S))
+    _SHA512( digest, kSRPTest_S, 384, NULL, 0 );
+    host_check( memcmp( digest, kSRPTest_K, 64 ) == 0 );
+
+    // M1 = H(H(N) xor H(g) | H(I) | s | PAD(A) | PAD(B) | K)
+    _SHA512( hng, kSRP_N3072, 384, NULL, 0 );
+    _SHA512( digest, &kG, 1, NULL, 0 );
+    for( i = 0; i < 64; ++i ) hng[ i ] ^= digest[ i ];
+    SHA512_Init_compat( &ctx );
+    SHA512_Update_compat( &ctx, hng, 64 );
+    _SHA512( digest, "alice", 5, NULL, 0 );
+    SHA512_Update_compat( &ctx, digest, 64 );
+    SHA512_Update_compat( &ctx, kSRPTest_s, 16 );
+    SHA512_Update_compat( &ctx, kSRPTest_A, 384 );
+    SHA512_Update_compat( &ctx, kSRPTest_B, 384 );
+    SHA512_Update_compat( &ctx, kSRPTest_K, 64 );
+    SHA512_Final_compat( digest, &ctx );
+    host_check( memcmp( digest, kSRPTest_M1, 64 ) == 0 );
+
+    // M2 = H(PAD(A) | M1 | K)
+    SHA512_Init_compat( &ctx );
+    SHA512_Update_compat( &ctx, kSRPTest_A, 384 );
+    SHA512_Update_compat( &ctx, kSRPTest_M1, 64 );
+    SHA512_Update_compat( &ctx, kSRPTest_K, 64 );
+    SHA512_Final_compat( digest, &ctx );
+    host_check( memcmp( digest, kSRPTest_M2, 64 ) == 0 );
+}
+
+//===========================================================================================================================
+//  _TestServer
+//===========================================================================================================================
+
+static void _TestServer( void )
+{
+    uint8_t             random[ 16 + 32 ];
+    uint8_t             buf[ 384 ];
+    uint8_t             M[ 64 ];
+    SRPVerifierRef      verifier = NULL;
+    SRPServerRef        server = NULL;
+    const uint8_t *     ptr;
+    size_t              len;
+    OSStatus            err;
+
+    // Verifier from the password: the salt is drawn first, then b for the session.
+    memcpy( random, kSRPTest_s, 16 );
+    memcpy( random + 16, kSRPTest_b, 32 );
+    _RandomQueue( random, sizeof( random ) );
+
+    err = SRPVerifierCreateWithPassword( kSRPGroup_3072, kSRPHash_SHA512, "alice", (const uint8_t *) "password123", 11,
+                                         &verifier );
+    host_check( err == kNoErr );
+    if( err ) return;
+    ptr = SRPVerifierGetSalt( verifier, &len );
+    host_check( ( len == 16 ) && ( memcmp( ptr, kSRPTest_s, 16 ) == 0 ) );
+    len = sizeof( buf );
+    host_check( SRPVerifierCopyVerifier( verifier, buf, &len ) == kNoErr );
+    host_check( ( len == 384 ) && ( memcmp( buf, kSRPTest_v, 384 ) == 0 ) );
+
+    err = SRPServerCreate( verifier, &server );
+    host_check( err == kNoErr );
+    if( err ) goto exit;
+    ptr = SRPServerGetPublicKey( server, &len );
+    host_check( ( len == 384 ) && ( memcmp( ptr, kSRPTest_B, 384 ) == 0 ) );
+
+    // A = 0 and A = N would force S = 0.
+    memset( buf, 0, sizeof( buf ) );
+    host_check( SRPServerSetClientPublicKey( server, buf, sizeof( buf ) ) == kParamErr );
+    host_check( SRPServerSetClientPublicKey( server, kSRP_N3072, sizeof( kSRP_N3072 ) ) == kParamErr );
+    host_check( SRPServerVerifyProof( server, kSRPTest_M1, 64, NULL, NULL ) == kStateErr );
+
+    host_check( SRPServerSetClientPublicKey( server, kSRPTest_A, 384 ) == kNoErr );
+
+    memcpy( M, kSRPTest_M1, 64 );
+    M[ 63 ] ^= 0x01;
+    host_check( SRPServerVerifyProof( server, M, 64, &ptr, &len ) == kAuthenticationErr );
+    host_check( SRPServerVerifyProof( server, kSRPTest_M1, 32, &ptr, &len ) == kAuthenticationErr );
+
+    ptr = NULL;
+    host_check( SRPServerVerifyProof( server, kSRPTest_M1, 64, &ptr, &len ) == kNoErr );
+    host_check( ptr && ( len == 64 ) && ( memcmp( ptr, kSRPTest_M2, 64 ) == 0 ) );
+    ptr = SRPServerGetSessionKey( server, &len );
+    host_check( ptr && ( len == 64 ) && ( memcmp( ptr, kSRPTest_K, 64 ) == 0 ) );
+    SRPServerDelete( server );
+    server = NULL;
+    SRPVerifierDelete( verifier );
+    verifier = NULL;
+
+    // Same session from a stored salt and verifier, as HKSetVerifier does.
+    _RandomQueue( kSRPTest_b, 32 );
+    err = SRPVerifierCreate( kSRPGroup_3072, kSRPHash_SHA512, "alice", kSRPTest_s, 16, kSRPTest_v, 384, &verifier );
+    host_check( err == kNoErr );
+    if( err ) goto exit;
+    err = SRPServerCreate( verifier, &server );
+    host_check( err == kNoErr );
+    if( err ) goto exit;
+    host_check( memcmp( SRPServerGetPublicKey( server, NULL ), kSRPTest_B, 384 ) == 0 );
+    host_check( SRPServerSetClientPublicKey( server, kSRPTest_A, 384 ) == kNoErr );
+    host_check( SRPServerVerifyProof( server, kSRPTest_M1, 64, &ptr, &len ) == kNoErr );
+    host_check( memcmp( SRPServerGetSessionKey( server, NULL ), kSRPTest_K, 64 ) == 0 );
+
+exit:
+    if( server )   SRPServerDelete( server );
+    if( verifier ) SRPVerifierDelete( verifier );
+}
+
+//===========================================================================================================================
+//  _TestModExp
+//
+//  _ModExp must match the reference for any exponent, and do the same work whatever the exponent bits are. The work
+//  is checked with -finstrument-functions: every function entered during an exponentiation, inlined ones included,
+//  goes into a running hash, and all exponents must produce the same sequence. Square and multiply, or a window
+//  that skips the multiplication for a zero digit, gives a different sequence. Wall clock times are printed for
+//  reference only, a host is too noisy to assert on them.
+//===========================================================================================================================
+
+#define kModExpRuns         15
+#define kModExpClasses      4
+
+static Boolean      gTraceOn    = false;
+static uint32_t     gTraceCount = 0;
+static uint64_t     gTraceHash  = 0;
+
+void __cyg_profile_func_enter( void *inFunc, void *inCaller ) __attribute__( ( no_instrument_function ) );
+void __cyg_profile_func_exit( void *inFunc, void *inCaller ) __attribute__( ( no_instrument_function ) );
+
+void __cyg_profile_func_enter( void *inFunc, void *inCaller )
+{
+    (void) inCaller;
+    if( !gTraceOn ) return;
+    gTraceCount += 1;
+    gTraceHash   = ( gTraceHash ^ (uintptr_t) inFunc ) * UINT64_C( 0x100000001B3 );
+}
+
+void __cyg_profile_func_exit( void *inFunc, void *inCaller )
+{
+    (void) inFunc;
+    (void) inCaller;
+}
+
+static double _ModExpTime( const uint32_t *inBase, const uint8_t *inExp, const SRPModulus *inMod, uint32_t *outR )
+{
+    struct timespec     start, end;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    _ModExp( outR, inBase, inExp, 32, inMod );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    return( ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) / 1e9 );
+}
+
+static void _TestModExp( void )
+{
+    static const uint8_t    kG = 5;
+    SRPModulus *            mod;
+    uint32_t *              scratch;
+    uint32_t *              base;
+    uint32_t *              r;
+    uint8_t                 exp[ kModExpClasses ][ 32 ];
+    uint8_t                 got[ 384 ], want[ 384 ];
+    uint32_t                count[ kModExpClasses ];
+    uint64_t                hash[ kModExpClasses ];
+    double                  t[ kModExpClasses ], d;
+    int                     c, i;
+
+    mod     = (SRPModulus *) malloc( sizeof( *mod ) );
+    scratch = (uint32_t *) malloc( ( 3 * kSRPMaxWords + 2 ) * sizeof( uint32_t ) );
+    base    = (uint32_t *) malloc( kSRPMaxWords * sizeof( uint32_t ) );
+    r       = (uint32_t *) malloc( kSRPMaxWords * sizeof( uint32_t ) );
+    host_check( mod && scratch && base && r );
+    if( !mod || !scratch || !base || !r ) goto exit;
+    host_check( _SRPModulusInit( mod, kSRPGroup_3072, scratch ) == kNoErr );
+
+    // All zeros, all ones, a single top bit and the RFC 5054 b.
+    memset( exp[ 0 ], 0x00, 32 );
+    memset( exp[ 1 ], 0xFF, 32 );
+    memset( exp[ 2 ], 0x00, 32 );
+    exp[ 2 ][ 0 ] = 0x80;
+    memcpy( exp[ 3 ], kSRPTest_b, 32 );
+
+    // Base v, converted like the server does.
+    _BNFromBytes( base, mod->words, kSRPTest_v, 384 );
+    _ModToMont( base, base, mod, scratch );
+
+    for( c = 0; c < kModExpClasses; ++c )
+    {
+        gTraceCount = 0;
+        gTraceHash  = UINT64_C( 0xCBF29CE484222325 );
+        gTraceOn    = true;
+        host_check( _ModExp( r, base, exp[ c ], 32, mod ) == kNoErr );
+        gTraceOn    = false;
+        count[ c ]  = gTraceCount;
+        hash[ c ]   = gTraceHash;
+
+        _ModFromMont( r, r, mod, scratch );
+        _BNToBytes( r, mod->words, got );
+        _RefModExpBytes( want, kSRPTest_v, 384, exp[ c ], 32 );
+        host_check( memcmp( got, want, 384 ) == 0 );
+    }
+
+    // The generator path used for B and v.
+    host_check( _ModExp( r, mod->gM, kSRPTest_x, 64, mod ) == kNoErr );
+    _ModFromMont( r, r, mod, scratch );
+    _BNToBytes( r, mod->words, got );
+    _RefModExpBytes( want, &kG, 1, kSRPTest_x, 64 );
+    host_check( memcmp( got, want, 384 ) == 0 );
+
+    // A zero count means the test was built without -finstrument-functions and checked nothing.
+    host_check( count[ 0 ] > 0 );
+    for( c = 1; c < kModExpClasses; ++c )
+    {
+        host_check( ( count[ c ] == count[ 0 ] ) && ( hash[ c ] == hash[ 0 ] ) );
+    }
+
+    for( i = 0; i < kModExpRuns; ++i )
+    {
+        for( c = 0; c < kModExpClasses; ++c )
+        {
+            d = _ModExpTime( base, exp[ c ], mod, r );
+            if( ( i == 0 ) || ( d < t[ c ] ) ) t[ c ] = d;
+        }
+    }
+    printf( "_ModExp 256-bit exponent, %u calls: zeros %.3f ms, ones %.3f ms, top bit %.3f ms, b %.3f ms\n",
+            (unsigned int) count[ 0 ], t[ 0 ] * 1e3, t[ 1 ] * 1e3, t[ 2 ] * 1e3, t[ 3 ] * 1e3 );
+
+exit:
+    if( r )       free( r );
+    if( base )    free( base );
+    if( scratch ) free( scratch );
+    if( mod )     free( mod );
+}
+
+int main( void )
+{
+    _RefFromBytes( &gRefN, kSRP_N3072, sizeof( kSRP_N3072 ) );
+
+    _TestVectors();
+    _TestServer();
+    _TestModExp();
+
+    printf( "SRPUtilsTest: %s (%d failures)\n", gHostTestFailures ? "FAILED" : "PASSED", gHostTestFailures );
+    return( gHostTestFailures ? 1 : 0 );
+}
@@ -37,15 +37,20 @@ extern "C" {
 
 #define TARGET_RT_LITTLE_ENDIAN
 
+/* NOINIT variables keep their content across a software or watchdog reset,
+   as long as the linker file leaves the .noinit section out of startup initialization */
 #ifdef __GNUC__
 #define WEAK __attribute__ ((weak))
 #define USED __attribute__ ((used))
+#define NOINIT __attribute__ ((section(".noinit")))
 #elif defined ( __ICCARM__ )
 #define WEAK __weak
 #define USED __root
+#define NOINIT __no_init
 #elif defined ( __CC_ARM ) //KEIL
 #define WEAK __attribute__ ((weak))
 #define USED __attribute__ ((used))
+#define NOINIT __attribute__ ((section(".noinit"), zero_init))
 #endif 
 
 /* Use this macro to define an RTOS-aware interrupt handler where RTOS
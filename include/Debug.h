@@ -33,12 +33,43 @@
 
 #define YesOrNo(x) (x ? "YES" : "NO")
 
+/* Log levels for custom_log_level, custom_log logs at MICO_LOG_INFO */
+#define MICO_LOG_OFF    0
+#define MICO_LOG_ERROR  1
+#define MICO_LOG_WARN   2
+#define MICO_LOG_INFO   3
+#define MICO_LOG_DEBUG  4
+
 #if DEBUG
 #ifndef MICO_DISABLE_STDIO
 #ifndef NO_MICO_RTOS
    extern int mico_debug_enabled;
    extern mico_mutex_t stdio_tx_mutex;
 
+#ifdef MICO_LOG_DEFERRED
+   /* Logs are recorded unformatted into a RAM ring and printed later by a low priority thread,
+      see MICOLog.h. Asserts flush the ring and are still printed synchronously. */
+   void MicoLogRecord( const char *module, int level, const char *file, int line, const char *format, ... );
+   void MicoLogFlush( void );
+
+    #define custom_log(N, M, ...) custom_log_level(N, MICO_LOG_INFO, M, ##__VA_ARGS__)
+
+    #define custom_log_level(N, L, M, ...) do {if (mico_debug_enabled==0)break;\
+                                               MicoLogRecord(N, L, __FILE__, __LINE__, M, ##__VA_ARGS__);}while(0==1)
+                                        
+    #define debug_print_assert(A,B,C,D,E,F, ...) do {if (mico_debug_enabled==0)break;\
+                                                     MicoLogFlush();\
+                                                     mico_rtos_lock_mutex( &stdio_tx_mutex );\
+                                                     printf("[%d][MICO:%s:%s:%4d] **ASSERT** %s""\r\n", mico_get_time(), (D!=NULL) ? D : "", F, E, (C!=NULL) ? C : "", ##__VA_ARGS__);\
+                                                     mico_rtos_unlock_mutex( &stdio_tx_mutex );}while(0==1)
+    #if TRACE
+        #define custom_log_trace(N) custom_log_level(N, MICO_LOG_DEBUG, "[TRACE] %s()", __PRETTY_FUNCTION__)
+    #else  // !TRACE
+        #define custom_log_trace(N)
+    #endif // TRACE  
+#else // !MICO_LOG_DEFERRED
+    #define custom_log_level(N, L, M, ...) custom_log(N, M, ##__VA_ARGS__)
+
     #define custom_log(N, M, ...) do {if (mico_debug_enabled==0)break;\
                                       mico_rtos_lock_mutex( &stdio_tx_mutex );\
                                       printf("[%d][%s: %s:%4d] " M "\r\n", mico_get_time(), N, SHORT_FILE, __LINE__, ##__VA_ARGS__);\
@@ -56,7 +87,10 @@
     #else  // !TRACE
         #define custom_log_trace(N)
     #endif // TRACE  
+#endif // MICO_LOG_DEFERRED
 #else // NO_MICO_RTOS  
+    #define custom_log_level(N, L, M, ...) custom_log(N, M, ##__VA_ARGS__)
+
     #define custom_log(N, M, ...) do {printf("[%s: %s:%4d] " M "\r\n",  N, SHORT_FILE, __LINE__, ##__VA_ARGS__);}while(0==1)
                                         
     #define debug_print_assert(A,B,C,D,E,F, ...) do {printf("[MICO:%s:%s:%4d] **ASSERT** %s""\r\n", (D!=NULL) ? D : "", F, E, (C!=NULL) ? C : "", ##__VA_ARGS__);}while(0==1)
@@ -69,6 +103,8 @@
 #else
     #define custom_log(N, M, ...)
 
+    #define custom_log_level(N, L, M, ...)
+
     #define custom_log_trace(N)
 
     #define debug_print_assert(A,B,C,D,E,F, ...)                                           
@@ -77,11 +113,22 @@
     // IF !DEBUG, make the logs NO-OP
     #define custom_log(N, M, ...)
 
+    #define custom_log_level(N, L, M, ...)
+
     #define custom_log_trace(N)
 
     #define debug_print_assert(A,B,C,D,E,F, ...)
 #endif // DEBUG
 
+// ==== CYCLE COUNTER ====
+/* DWT cycle counter of Cortex-M3 and M4, it wraps around every 2^32 core clock cycles */
+#if( !defined( mico_cycle_counter ) )
+    #define mico_cycle_counter()            ( *(volatile uint32_t *)0xE0001004 )
+
+    #define mico_cycle_counter_enable()     do { *(volatile uint32_t *)0xE000EDFC |= ( 1UL << 24 );  /* DEMCR.TRCENA */    \
+                                                 *(volatile uint32_t *)0xE0001000 |= 1; } while( 1==0 )  /* DWT_CTRL.CYCCNTENA */
+#endif
+
 // ==== PLATFORM TIMEING FUNCTIONS ====
 #if TIME_PLATFORM
     #define function_timer_log(M, N, ...) fprintf(stderr, "[FUNCTION TIMER: " N "()] " M "\n", ##__VA_ARGS__)
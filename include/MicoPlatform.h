@@ -121,6 +121,15 @@ void MicoSystemStandBy(uint32_t secondsToWakeup);
   */
 void MicoMcuPowerSaveConfig( int enable );
 
+/** @brief    Gets the time the MCU has spent idle, sleeping in wfi or in a powersave mode.
+  *
+  * @note:    Sampling it twice gives the CPU load over the interval between the samples.
+  *
+  * @param    idle_us : microseconds since boot, wraps around after about 71 minutes
+  * @return   kNoErr, or kUnsupportedErr if the platform does not measure idle time
+  */
+OSStatus MicoMcuGetIdleTime( uint32_t* idle_us );
+
 
 
 void MicoSysLed(bool onoff);